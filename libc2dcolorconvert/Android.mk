@@ -3,7 +3,9 @@ LOCAL_PATH := $(call my-dir)
 include $(CLEAR_VARS)
 
 LOCAL_SRC_FILES := \
-        C2DColorConverter.cpp
+        C2DColorConverter.cpp \
+        ColorConvertLayout.cpp \
+        CPUColorConverter.cpp
 
 LOCAL_C_INCLUDES := \
     $(TARGET_OUT_HEADERS)/qcom/display
@@ -19,3 +21,20 @@ LOCAL_MODULE := libc2dcolorconvert
 LOCAL_ADDITIONAL_DEPENDENCIES := $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr
 
 include $(BUILD_SHARED_LIBRARY)
+
+# CPU-only converter without the C2D dependency, used by the host benchmark
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+        ColorConvertLayout.cpp \
+        CPUColorConverter.cpp
+
+LOCAL_CFLAGS := -DC2D_CPU_ONLY
+
+LOCAL_SHARED_LIBRARIES := liblog
+
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_MODULE := libc2dcolorconvert_cpu
+
+include $(BUILD_HOST_STATIC_LIBRARY)
@@ -28,6 +28,8 @@
  */
 
 #include <C2DColorConverter.h>
+#include "ColorConvertLayout.h"
+#include "C2DMapCache.h"
 #include <stdlib.h>
 #include <fcntl.h>
 #include <linux/msm_kgsl.h>
@@ -37,43 +39,53 @@
 #include <string.h>
 #include <errno.h>
 
+/* LRU order has to keep the mappings of every conversion in flight */
+#if C2D_MAP_CACHE_SIZE <= 2 * C2D_MAX_INFLIGHT
+#error "C2D_MAP_CACHE_SIZE too small for C2D_MAX_INFLIGHT"
+#endif
+
 #undef LOG_TAG
 #define LOG_TAG "C2DColorConvert"
-#define ALIGN( num, to ) (((num) + (to-1)) & (~(to-1)))
-#define ALIGN8K 8192
-#define ALIGN4K 4096
-#define ALIGN2K 2048
-#define ALIGN128 128
-#define ALIGN32 32
-#define ALIGN16 16
 
 //-----------------------------------------------------
 namespace android {
 
-class C2DColorConverter : public C2DColorConverterBase {
+class C2DColorConverter : public C2DColorConverterBase, private ColorConvertLayout {
 
 public:
     C2DColorConverter(size_t srcWidth, size_t srcHeight, size_t dstWidth, size_t dstHeight, ColorConvertFormat srcFormat, ColorConvertFormat dstFormat, int32_t flags,size_t srcStride);
     int32_t getBuffReq(int32_t port, C2DBuffReq *req);
     int32_t dumpOutput(char * filename, char mode);
+    int32_t releaseBuffer(int fd, void *base);
+    int32_t getMapStats(C2DMapStats *stats);
+    bool isValid() { return !mError; }
 protected:
     virtual ~C2DColorConverter();
     virtual int convertC2D(int srcFd, void *srcBase, void * srcData, int dstFd, void *dstBase, void * dstData);
+    virtual int submitC2D(int srcFd, void *srcBase, void * srcData, int dstFd, void *dstBase, void * dstData, C2DFence *fence);
+    virtual int waitC2D(C2DFence fence);
+    virtual int pollC2D(C2DFence fence);
 
 private:
-    bool isYUVSurface(ColorConvertFormat format);
-    void *getDummySurfaceDef(ColorConvertFormat format, size_t width, size_t height, bool isSource);
+    /* Every conversion in flight owns a surface pair, so queueing the next
+     * one never rewrites a definition the GPU has yet to read */
+    struct Slot {
+        uint32_t srcSurface, dstSurface;
+        void * srcSurfaceDef;
+        void * dstSurfaceDef;
+        c2d_ts_handle timestamp;
+        C2DFence fence;
+    };
+
+    void *getDummySurfaceDef(ColorConvertFormat format, size_t width, size_t height, bool isSource, uint32_t *surface);
+    void retireOldest();
     C2D_STATUS updateYUVSurfaceDef(int fd, void *base, void * data, bool isSource);
     C2D_STATUS updateRGBSurfaceDef(int fd, void * data, bool isSource);
     uint32_t getC2DFormat(ColorConvertFormat format);
-    size_t calcStride(ColorConvertFormat format, size_t width);
-    size_t calcYSize(ColorConvertFormat format, size_t width, size_t height);
-    size_t calcSize(ColorConvertFormat format, size_t width, size_t height);
     void *getMappedGPUAddr(int bufFD, void *bufPtr, size_t bufLen);
     bool unmapGPUAddr(unsigned long gAddr);
-    size_t calcLumaAlign(ColorConvertFormat format);
-    size_t calcSizeAlign(ColorConvertFormat format);
-    C2DBytesPerPixel calcBytesPerPixel(ColorConvertFormat format);
+    static void *mapBuffer(void *ctx, int fd, void *ptr, size_t len);
+    static bool unmapBuffer(void *ctx, void *gpuAddr);
 
     void *mC2DLibHandle;
     LINK_c2dCreateSurface mC2DCreateSurface;
@@ -87,30 +99,29 @@ private:
     LINK_c2dMapAddr mC2DMapAddr;
     LINK_c2dUnMapAddr mC2DUnMapAddr;
 
-    uint32_t mSrcSurface, mDstSurface;
-    void * mSrcSurfaceDef;
-    void * mDstSurfaceDef;
+    Slot mSlots[C2D_MAX_INFLIGHT];
+    Slot *mCur;
+    size_t mOldest;
+    size_t mInFlight;
+    C2DFence mSubmitted;
+    C2DFence mCompleted;
 
     C2D_OBJECT mBlit;
-    size_t mSrcWidth;
-    size_t mSrcHeight;
-    size_t mSrcStride;
-    size_t mDstWidth;
-    size_t mDstHeight;
     size_t mSrcSize;
     size_t mDstSize;
     size_t mSrcYSize;
     size_t mDstYSize;
-    enum ColorConvertFormat mSrcFormat;
-    enum ColorConvertFormat mDstFormat;
     int32_t mFlags;
+    C2DMapCache *mMapCache;
 
     int mError;
 };
 
 C2DColorConverter::C2DColorConverter(size_t srcWidth, size_t srcHeight, size_t dstWidth, size_t dstHeight, ColorConvertFormat srcFormat, ColorConvertFormat dstFormat, int32_t flags, size_t srcStride)
+    : ColorConvertLayout(srcWidth, srcHeight, dstWidth, dstHeight, srcFormat, dstFormat, srcStride)
 {
      mError = 0;
+     mMapCache = NULL;
      mC2DLibHandle = dlopen("libC2D2.so", RTLD_NOW);
      if (!mC2DLibHandle) {
          ALOGE("FATAL ERROR: could not dlopen libc2d2.so: %s", dlerror());
@@ -136,22 +147,24 @@ C2DColorConverter::C2DColorConverter(size_t srcWidth, size_t srcHeight, size_t d
          return;
      }
 
-    mSrcWidth = srcWidth;
-    mSrcHeight = srcHeight;
-    mSrcStride = srcStride;;
-    mDstWidth = dstWidth;
-    mDstHeight = dstHeight;
-    mSrcFormat = srcFormat;
-    mDstFormat = dstFormat;
     mSrcSize = calcSize(srcFormat, srcWidth, srcHeight);
     mDstSize = calcSize(dstFormat, dstWidth, dstHeight);
     mSrcYSize = calcYSize(srcFormat, srcWidth, srcHeight);
     mDstYSize = calcYSize(dstFormat, dstWidth, dstHeight);
 
     mFlags = flags; // can be used for rotation
+    mMapCache = new C2DMapCache(mapBuffer, unmapBuffer, this);
 
-    mSrcSurfaceDef = getDummySurfaceDef(srcFormat, srcWidth, srcHeight, true);
-    mDstSurfaceDef = getDummySurfaceDef(dstFormat, dstWidth, dstHeight, false);
+    memset(mSlots, 0, sizeof(mSlots));
+    for (size_t i = 0; i < C2D_MAX_INFLIGHT; i++) {
+        mSlots[i].srcSurfaceDef = getDummySurfaceDef(srcFormat, srcWidth, srcHeight, true, &mSlots[i].srcSurface);
+        mSlots[i].dstSurfaceDef = getDummySurfaceDef(dstFormat, dstWidth, dstHeight, false, &mSlots[i].dstSurface);
+    }
+    mCur = &mSlots[0];
+    mOldest = 0;
+    mInFlight = 0;
+    mSubmitted = 0;
+    mCompleted = 0;
 
     memset((void*)&mBlit,0,sizeof(C2D_OBJECT));
     mBlit.source_rect.x = 0 << 16;
@@ -163,7 +176,7 @@ C2DColorConverter::C2DColorConverter(size_t srcWidth, size_t srcHeight, size_t d
     mBlit.target_rect.width = dstWidth << 16;
     mBlit.target_rect.height = dstHeight << 16;
     mBlit.config_mask = C2D_ALPHA_BLEND_NONE | C2D_NO_BILINEAR_BIT | C2D_NO_ANTIALIASING_BIT | C2D_TARGET_RECT_BIT;
-    mBlit.surface_id = mSrcSurface;
+    mBlit.surface_id = mCur->srcSurface;
 }
 
 C2DColorConverter::~C2DColorConverter()
@@ -175,27 +188,61 @@ C2DColorConverter::~C2DColorConverter()
         return;
     }
 
-    mC2DDestroySurface(mDstSurface);
-    mC2DDestroySurface(mSrcSurface);
-    if (isYUVSurface(mSrcFormat)) {
-        delete ((C2D_YUV_SURFACE_DEF *)mSrcSurfaceDef);
-    } else {
-        delete ((C2D_RGB_SURFACE_DEF *)mSrcSurfaceDef);
-    }
+    while (mInFlight)
+        retireOldest();
 
-    if (isYUVSurface(mDstFormat)) {
-        delete ((C2D_YUV_SURFACE_DEF *)mDstSurfaceDef);
-    } else {
-        delete ((C2D_RGB_SURFACE_DEF *)mDstSurfaceDef);
+    const C2DMapStats &stats = mMapCache->stats();
+    ALOGI("GPU mappings: %llu hits, %llu misses, %llu evictions, %llu invalidations",
+            (unsigned long long)stats.hits, (unsigned long long)stats.misses,
+            (unsigned long long)stats.evictions, (unsigned long long)stats.invalidations);
+    delete mMapCache;
+
+    for (size_t i = 0; i < C2D_MAX_INFLIGHT; i++) {
+        Slot *slot = &mSlots[i];
+
+        mC2DDestroySurface(slot->dstSurface);
+        mC2DDestroySurface(slot->srcSurface);
+        if (isYUVSurface(mSrcFormat)) {
+            delete ((C2D_YUV_SURFACE_DEF *)slot->srcSurfaceDef);
+        } else {
+            delete ((C2D_RGB_SURFACE_DEF *)slot->srcSurfaceDef);
+        }
+
+        if (isYUVSurface(mDstFormat)) {
+            delete ((C2D_YUV_SURFACE_DEF *)slot->dstSurfaceDef);
+        } else {
+            delete ((C2D_RGB_SURFACE_DEF *)slot->dstSurfaceDef);
+        }
     }
 
     dlclose(mC2DLibHandle);
 }
 
 int C2DColorConverter::convertC2D(int srcFd, void *srcBase, void * srcData, int dstFd, void *dstBase, void * dstData)
+{
+    C2DFence fence;
+    int ret = submitC2D(srcFd, srcBase, srcData, dstFd, dstBase, dstData, &fence);
+
+    if (ret < 0)
+        return ret;
+    return waitC2D(fence);
+}
+
+/*
+ * Draws into the next free slot and flushes it with a timestamp instead of
+ * blocking in c2dFinish. With all slots busy the oldest conversion is waited
+ * for first, so at most C2D_MAX_INFLIGHT are queued to the GPU.
+ */
+int C2DColorConverter::submitC2D(int srcFd, void *srcBase, void * srcData, int dstFd, void *dstBase, void * dstData, C2DFence *fence)
 {
     C2D_STATUS ret;
 
+    if (!fence) {
+        ALOGE("Incorrect input parameters\n");
+        return -1;
+    }
+    *fence = 0;
+
     if (mError) {
         ALOGE("C2D library initialization failed\n");
         return mError;
@@ -206,6 +253,10 @@ int C2DColorConverter::convertC2D(int srcFd, void *srcBase, void * srcData, int
         return -1;
     }
 
+    if (mInFlight == C2D_MAX_INFLIGHT)
+        retireOldest();
+    mCur = &mSlots[(mOldest + mInFlight) % C2D_MAX_INFLIGHT];
+
     if (isYUVSurface(mSrcFormat)) {
         ret = updateYUVSurfaceDef(srcFd, srcBase, srcData, true);
     } else {
@@ -228,54 +279,70 @@ int C2DColorConverter::convertC2D(int srcFd, void *srcBase, void * srcData, int
         return -ret;
     }
 
-    mBlit.surface_id = mSrcSurface;
-    ret = mC2DDraw(mDstSurface, C2D_TARGET_ROTATE_0, 0, 0, 0, &mBlit, 1);
-    mC2DFinish(mDstSurface);
-
-    bool unmappedSrcSuccess;
-    if (isYUVSurface(mSrcFormat)) {
-        unmappedSrcSuccess = unmapGPUAddr((unsigned long)((C2D_YUV_SURFACE_DEF *)mSrcSurfaceDef)->phys0);
-    } else {
-        unmappedSrcSuccess = unmapGPUAddr((unsigned long)((C2D_RGB_SURFACE_DEF *)mSrcSurfaceDef)->phys);
+    mBlit.surface_id = mCur->srcSurface;
+    ret = mC2DDraw(mCur->dstSurface, C2D_TARGET_ROTATE_0, 0, 0, 0, &mBlit, 1);
+    if (ret != C2D_STATUS_OK) {
+        ALOGE("C2D Draw failed\n");
+        mC2DFinish(mCur->dstSurface);
+        return -ret; //c2d err values are positive
     }
 
-    bool unmappedDstSuccess;
-    if (isYUVSurface(mDstFormat)) {
-        unmappedDstSuccess = unmapGPUAddr((unsigned long)((C2D_YUV_SURFACE_DEF *)mDstSurfaceDef)->phys0);
-    } else {
-        unmappedDstSuccess = unmapGPUAddr((unsigned long)((C2D_RGB_SURFACE_DEF *)mDstSurfaceDef)->phys);
+    // Both buffers stay mapped in mMapCache until evicted or released
+    mCur->fence = ++mSubmitted;
+    if (mC2DFlush(mCur->dstSurface, &mCur->timestamp) != C2D_STATUS_OK) {
+        ALOGE("C2D flush failed, waiting for the draw\n");
+        mC2DFinish(mCur->dstSurface);
+        /* mCompleted covers every older fence too, retire those first */
+        while (mInFlight)
+            retireOldest();
+        mCompleted = mCur->fence;
+        *fence = mCur->fence;
+        return 0;
     }
+    mInFlight++;
+    *fence = mCur->fence;
+    return 0;
+}
 
-    if (ret != C2D_STATUS_OK) {
-        ALOGE("C2D Draw failed\n");
-        return -ret; //c2d err values are positive
-    } else {
-        if (!unmappedSrcSuccess || !unmappedDstSuccess) {
-            ALOGE("unmapping GPU address failed\n");
-            return -1;
-        }
-        return ret;
+void C2DColorConverter::retireOldest()
+{
+    Slot *slot = &mSlots[mOldest];
+    C2D_STATUS status = mC2DWaitTimestamp(slot->timestamp);
+
+    if (status != C2D_STATUS_OK) {
+        ALOGE("c2dWaitTimestamp failed: status %d, finishing the surface\n", status);
+        mC2DFinish(slot->dstSurface);
     }
+    mCompleted = slot->fence;
+    mOldest = (mOldest + 1) % C2D_MAX_INFLIGHT;
+    mInFlight--;
 }
 
-bool C2DColorConverter::isYUVSurface(ColorConvertFormat format)
+int C2DColorConverter::waitC2D(C2DFence fence)
 {
-    switch (format) {
-        case YCbCr420Tile:
-        case YCbCr420SP:
-        case YCbCr420P:
-        case YCrCb420P:
-        case NV12_2K:
-        case NV12_128m:
-            return true;
-        case RGB565:
-        case RGBA8888:
-        default:
-            return false;
+    if (mError)
+        return mError;
+    if (!fence || fence > mSubmitted) {
+        ALOGE("waiting for unknown fence %llu\n", (unsigned long long)fence);
+        return -1;
     }
+    while (mCompleted < fence && mInFlight)
+        retireOldest();
+    return 0;
 }
 
-void* C2DColorConverter::getDummySurfaceDef(ColorConvertFormat format, size_t width, size_t height, bool isSource)
+/* The link table has no non-blocking timestamp query, so this reports the
+ * conversions already retired by waitC2D or by a later submitC2D */
+int C2DColorConverter::pollC2D(C2DFence fence)
+{
+    if (mError)
+        return mError;
+    if (!fence || fence > mSubmitted)
+        return -1;
+    return fence <= mCompleted ? 1 : 0;
+}
+
+void* C2DColorConverter::getDummySurfaceDef(ColorConvertFormat format, size_t width, size_t height, bool isSource, uint32_t *surface)
 {
     if (isYUVSurface(format)) {
         C2D_YUV_SURFACE_DEF * surfaceDef = new C2D_YUV_SURFACE_DEF;
@@ -296,7 +363,7 @@ void* C2DColorConverter::getDummySurfaceDef(ColorConvertFormat format, size_t wi
           surfaceDef->phys2 = (void *)0xaaaaaaaa;
           surfaceDef->stride2 = calcStride(format, width) / 2;
         }
-        mC2DCreateSurface(isSource ? &mSrcSurface : &mDstSurface, isSource ? C2D_SOURCE : C2D_TARGET,
+        mC2DCreateSurface(surface, isSource ? C2D_SOURCE : C2D_TARGET,
                         (C2D_SURFACE_TYPE)(C2D_SURFACE_YUV_HOST | C2D_SURFACE_WITH_PHYS | C2D_SURFACE_WITH_PHYS_DUMMY),
                         &(*surfaceDef));
         return ((void *)surfaceDef);
@@ -308,7 +375,7 @@ void* C2DColorConverter::getDummySurfaceDef(ColorConvertFormat format, size_t wi
         surfaceDef->buffer = (void *)0xaaaaaaaa;
         surfaceDef->phys = (void *)0xaaaaaaaa;
         surfaceDef->stride = calcStride(format, width);
-        mC2DCreateSurface(isSource ? &mSrcSurface : &mDstSurface, isSource ? C2D_SOURCE : C2D_TARGET,
+        mC2DCreateSurface(surface, isSource ? C2D_SOURCE : C2D_TARGET,
                         (C2D_SURFACE_TYPE)(C2D_SURFACE_RGB_HOST | C2D_SURFACE_WITH_PHYS | C2D_SURFACE_WITH_PHYS_DUMMY),
                         &(*surfaceDef));
         return ((void *)surfaceDef);
@@ -318,27 +385,27 @@ void* C2DColorConverter::getDummySurfaceDef(ColorConvertFormat format, size_t wi
 C2D_STATUS C2DColorConverter::updateYUVSurfaceDef(int fd, void *base, void *data, bool isSource)
 {
     if (isSource) {
-        C2D_YUV_SURFACE_DEF * srcSurfaceDef = (C2D_YUV_SURFACE_DEF *)mSrcSurfaceDef;
+        C2D_YUV_SURFACE_DEF * srcSurfaceDef = (C2D_YUV_SURFACE_DEF *)mCur->srcSurfaceDef;
         srcSurfaceDef->plane0 = data;
-        srcSurfaceDef->phys0  = (uint8_t *)getMappedGPUAddr(fd, data, mSrcSize) + ((uint8_t *)data - (uint8_t *)base);
+        srcSurfaceDef->phys0  = (uint8_t *)mMapCache->get(fd, data, mSrcSize) + ((uint8_t *)data - (uint8_t *)base);
         srcSurfaceDef->plane1 = (uint8_t *)data + mSrcYSize;
         srcSurfaceDef->phys1  = (uint8_t *)srcSurfaceDef->phys0 + mSrcYSize;
         srcSurfaceDef->plane2 = (uint8_t *)srcSurfaceDef->plane1 + mSrcYSize/4;
         srcSurfaceDef->phys2  = (uint8_t *)srcSurfaceDef->phys1 + mSrcYSize/4;
 
-        return mC2DUpdateSurface(mSrcSurface, C2D_SOURCE,
+        return mC2DUpdateSurface(mCur->srcSurface, C2D_SOURCE,
                         (C2D_SURFACE_TYPE)(C2D_SURFACE_YUV_HOST | C2D_SURFACE_WITH_PHYS),
                         &(*srcSurfaceDef));
     } else {
-        C2D_YUV_SURFACE_DEF * dstSurfaceDef = (C2D_YUV_SURFACE_DEF *)mDstSurfaceDef;
+        C2D_YUV_SURFACE_DEF * dstSurfaceDef = (C2D_YUV_SURFACE_DEF *)mCur->dstSurfaceDef;
         dstSurfaceDef->plane0 = data;
-        dstSurfaceDef->phys0  = (uint8_t *)getMappedGPUAddr(fd, data, mDstSize) + ((uint8_t *)data - (uint8_t *)base);
+        dstSurfaceDef->phys0  = (uint8_t *)mMapCache->get(fd, data, mDstSize) + ((uint8_t *)data - (uint8_t *)base);
         dstSurfaceDef->plane1 = (uint8_t *)data + mDstYSize;
         dstSurfaceDef->phys1  = (uint8_t *)dstSurfaceDef->phys0 + mDstYSize;
         dstSurfaceDef->plane2 = (uint8_t *)dstSurfaceDef->plane1 + mDstYSize/4;
         dstSurfaceDef->phys2  = (uint8_t *)dstSurfaceDef->phys1 + mDstYSize/4;
 
-        return mC2DUpdateSurface(mDstSurface, C2D_TARGET,
+        return mC2DUpdateSurface(mCur->dstSurface, C2D_TARGET,
                         (C2D_SURFACE_TYPE)(C2D_SURFACE_YUV_HOST | C2D_SURFACE_WITH_PHYS),
                         &(*dstSurfaceDef));
     }
@@ -347,18 +414,18 @@ C2D_STATUS C2DColorConverter::updateYUVSurfaceDef(int fd, void *base, void *data
 C2D_STATUS C2DColorConverter::updateRGBSurfaceDef(int fd, void * data, bool isSource)
 {
     if (isSource) {
-        C2D_RGB_SURFACE_DEF * srcSurfaceDef = (C2D_RGB_SURFACE_DEF *)mSrcSurfaceDef;
+        C2D_RGB_SURFACE_DEF * srcSurfaceDef = (C2D_RGB_SURFACE_DEF *)mCur->srcSurfaceDef;
         srcSurfaceDef->buffer = data;
-        srcSurfaceDef->phys = getMappedGPUAddr(fd, data, mSrcSize);
-        return  mC2DUpdateSurface(mSrcSurface, C2D_SOURCE,
+        srcSurfaceDef->phys = mMapCache->get(fd, data, mSrcSize);
+        return  mC2DUpdateSurface(mCur->srcSurface, C2D_SOURCE,
                         (C2D_SURFACE_TYPE)(C2D_SURFACE_RGB_HOST | C2D_SURFACE_WITH_PHYS),
                         &(*srcSurfaceDef));
     } else {
-        C2D_RGB_SURFACE_DEF * dstSurfaceDef = (C2D_RGB_SURFACE_DEF *)mDstSurfaceDef;
+        C2D_RGB_SURFACE_DEF * dstSurfaceDef = (C2D_RGB_SURFACE_DEF *)mCur->dstSurfaceDef;
         dstSurfaceDef->buffer = data;
         ALOGV("dstSurfaceDef->buffer = %p\n", data);
-        dstSurfaceDef->phys = getMappedGPUAddr(fd, data, mDstSize);
-        return mC2DUpdateSurface(mDstSurface, C2D_TARGET,
+        dstSurfaceDef->phys = mMapCache->get(fd, data, mDstSize);
+        return mC2DUpdateSurface(mCur->dstSurface, C2D_TARGET,
                         (C2D_SURFACE_TYPE)(C2D_SURFACE_RGB_HOST | C2D_SURFACE_WITH_PHYS),
                         &(*dstSurfaceDef));
     }
@@ -387,109 +454,6 @@ uint32_t C2DColorConverter::getC2DFormat(ColorConvertFormat format)
     }
 }
 
-size_t C2DColorConverter::calcStride(ColorConvertFormat format, size_t width)
-{
-    switch (format) {
-        case RGB565:
-            return ALIGN(width, ALIGN32) * 2; // RGB565 has width as twice
-        case RGBA8888:
-	if (mSrcStride)
-		return mSrcStride * 4;
-	else
-		return ALIGN(width, ALIGN32) * 4;
-        case YCbCr420Tile:
-            return ALIGN(width, ALIGN128);
-        case YCbCr420SP:
-            return ALIGN(width, ALIGN16);
-        case NV12_2K:
-            return ALIGN(width, ALIGN16);
-        case NV12_128m:
-            return ALIGN(width, ALIGN128);
-        case YCbCr420P:
-            return ALIGN(width, ALIGN16);
-        case YCrCb420P:
-            return ALIGN(width, ALIGN16);
-        default:
-            return 0;
-    }
-}
-
-size_t C2DColorConverter::calcYSize(ColorConvertFormat format, size_t width, size_t height)
-{
-    switch (format) {
-        case YCbCr420SP:
-            return (ALIGN(width, ALIGN16) * height);
-        case YCbCr420P:
-            return ALIGN(width, ALIGN16) * height;
-        case YCrCb420P:
-            return ALIGN(width, ALIGN16) * height;
-        case YCbCr420Tile:
-            return ALIGN(ALIGN(width, ALIGN128) * ALIGN(height, ALIGN32), ALIGN8K);
-        case NV12_2K: {
-            size_t alignedw = ALIGN(width, ALIGN16);
-            size_t lumaSize = ALIGN(alignedw * height, ALIGN2K);
-            return lumaSize;
-        }
-        case NV12_128m:
-            return ALIGN(width, ALIGN128) * ALIGN(height, ALIGN32);
-        default:
-            return 0;
-    }
-}
-
-size_t C2DColorConverter::calcSize(ColorConvertFormat format, size_t width, size_t height)
-{
-    int32_t alignedw = 0;
-    int32_t alignedh = 0;
-    int32_t size = 0;
-
-    switch (format) {
-        case RGB565:
-            size = ALIGN(width, ALIGN32) * ALIGN(height, ALIGN32) * 2;
-            size = ALIGN(size, ALIGN4K);
-            break;
-        case RGBA8888:
-            if (mSrcStride)
-              size = mSrcStride *  ALIGN(height, ALIGN32) * 4;
-            else
-              size = ALIGN(width, ALIGN32) * ALIGN(height, ALIGN32) * 4;
-            size = ALIGN(size, ALIGN4K);
-            break;
-        case YCbCr420SP:
-            alignedw = ALIGN(width, ALIGN16);
-            size = ALIGN((alignedw * height) + (ALIGN(width/2, ALIGN32) * (height/2) * 2), ALIGN4K);
-            break;
-        case YCbCr420P:
-            alignedw = ALIGN(width, ALIGN16);
-            size = ALIGN((alignedw * height) + (ALIGN(width/2, ALIGN16) * (height/2) * 2), ALIGN4K);
-            break;
-        case YCrCb420P:
-            alignedw = ALIGN(width, ALIGN16);
-            size = ALIGN((alignedw * height) + (ALIGN(width/2, ALIGN16) * (height/2) * 2), ALIGN4K);
-            break;
-        case YCbCr420Tile:
-            alignedw = ALIGN(width, ALIGN128);
-            alignedh = ALIGN(height, ALIGN32);
-            size = ALIGN(alignedw * alignedh, ALIGN8K) + ALIGN(alignedw * ALIGN(height/2, ALIGN32), ALIGN8K);
-            break;
-        case NV12_2K: {
-            alignedw = ALIGN(width, ALIGN16);
-            size_t lumaSize = ALIGN(alignedw * height, ALIGN2K);
-            size_t chromaSize = ALIGN((alignedw * height)/2, ALIGN2K);
-            size = ALIGN(lumaSize + chromaSize, ALIGN4K);
-            ALOGV("NV12_2k, width = %d, height = %d, size = %d", width, height, size);
-            }
-            break;
-        case NV12_128m:
-            alignedw = ALIGN(width, ALIGN128);
-            alignedh = ALIGN(height, ALIGN32);
-            size = ALIGN(alignedw * alignedh + (alignedw * ALIGN(height/2, ALIGN16)), ALIGN4K);
-            break;
-        default:
-            break;
-    }
-    return size;
-}
 /*
  * Tells GPU to map given buffer and returns a physical address of mapped buffer
  */
@@ -522,90 +486,45 @@ bool C2DColorConverter::unmapGPUAddr(unsigned long gAddr)
     return (status == C2D_STATUS_OK);
 }
 
-int32_t C2DColorConverter::getBuffReq(int32_t port, C2DBuffReq *req) {
-    if (!req) return -1;
-
-    if (port != C2D_INPUT && port != C2D_OUTPUT) return -1;
-
-    memset(req, 0, sizeof(C2DBuffReq));
-    if (port == C2D_INPUT) {
-        req->width = mSrcWidth;
-        req->height = mSrcHeight;
-        req->stride = calcStride(mSrcFormat, mSrcWidth);
-        req->sliceHeight = mSrcHeight;
-        req->lumaAlign = calcLumaAlign(mSrcFormat);
-        req->sizeAlign = calcSizeAlign(mSrcFormat);
-        req->size = calcSize(mSrcFormat, mSrcWidth, mSrcHeight);
-        req->bpp = calcBytesPerPixel(mSrcFormat);
-        ALOGV("input req->size = %d\n", req->size);
-    } else if (port == C2D_OUTPUT) {
-        req->width = mDstWidth;
-        req->height = mDstHeight;
-        req->stride = calcStride(mDstFormat, mDstWidth);
-        req->sliceHeight = mDstHeight;
-        req->lumaAlign = calcLumaAlign(mDstFormat);
-        req->sizeAlign = calcSizeAlign(mDstFormat);
-        req->size = calcSize(mDstFormat, mDstWidth, mDstHeight);
-        req->bpp = calcBytesPerPixel(mDstFormat);
-        ALOGV("output req->size = %d\n", req->size);
-    }
-    return 0;
+void *C2DColorConverter::mapBuffer(void *ctx, int fd, void *ptr, size_t len)
+{
+    return ((C2DColorConverter *)ctx)->getMappedGPUAddr(fd, ptr, len);
 }
 
-size_t C2DColorConverter::calcLumaAlign(ColorConvertFormat format) {
-    if (!isYUVSurface(format)) return 1; //no requirement
-
-    switch (format) {
-        case NV12_2K:
-          return ALIGN2K;
-        case NV12_128m:
-          return 1;
-        default:
-          ALOGD("unknown format passed for luma alignment number");
-          return 1;
-    }
+bool C2DColorConverter::unmapBuffer(void *ctx, void *gpuAddr)
+{
+    return ((C2DColorConverter *)ctx)->unmapGPUAddr((unsigned long)gpuAddr);
 }
 
-size_t C2DColorConverter::calcSizeAlign(ColorConvertFormat format) {
-    if (!isYUVSurface(format)) return 1; //no requirement
+int32_t C2DColorConverter::releaseBuffer(int fd, void *base)
+{
+    if (mError)
+        return mError;
 
-    switch (format) {
-        case YCbCr420SP: //OR NV12
-        case YCbCr420P:
-        case NV12_2K:
-        case NV12_128m:
-          return ALIGN4K;
-        default:
-          ALOGD("unknown format passed for size alignment number");
-          return 1;
-    }
-}
+    /* The buffer may still be read or written by a queued conversion */
+    while (mInFlight)
+        retireOldest();
 
-C2DBytesPerPixel C2DColorConverter::calcBytesPerPixel(ColorConvertFormat format) {
-    C2DBytesPerPixel bpp;
-    bpp.numerator = 0;
-    bpp.denominator = 1;
+    /* Mappings are keyed by the data pointer, which may sit past base */
+    if (mMapCache->release(fd, NULL))
+        ALOGV("released GPU mappings of fd %d base %p", fd, base);
+    return 0;
+}
 
-    switch (format) {
-        case RGB565:
-            bpp.numerator = 2;
-            break;
-        case RGBA8888:
-            bpp.numerator = 4;
-            break;
-        case YCbCr420SP:
-        case YCbCr420P:
-        case YCrCb420P:
-        case YCbCr420Tile:
-        case NV12_2K:
-        case NV12_128m:
-            bpp.numerator = 3;
-            bpp.denominator = 2;
-            break;
-        default:
-            break;
+int32_t C2DColorConverter::getMapStats(C2DMapStats *stats)
+{
+    if (!stats)
+        return -1;
+    if (mError) {
+        memset(stats, 0, sizeof(*stats));
+        return mError;
     }
-    return bpp;
+    *stats = mMapCache->stats();
+    return 0;
+}
+
+int32_t C2DColorConverter::getBuffReq(int32_t port, C2DBuffReq *req) {
+    return fillBuffReq(port, req);
 }
 
 int32_t C2DColorConverter::dumpOutput(char * filename, char mode) {
@@ -625,7 +544,7 @@ int32_t C2DColorConverter::dumpOutput(char * filename, char mode) {
 
     int ret = 0;
     if (isYUVSurface(mDstFormat)) {
-      C2D_YUV_SURFACE_DEF * dstSurfaceDef = (C2D_YUV_SURFACE_DEF *)mDstSurfaceDef;
+      C2D_YUV_SURFACE_DEF * dstSurfaceDef = (C2D_YUV_SURFACE_DEF *)mCur->dstSurfaceDef;
       uint8_t * base = (uint8_t *)dstSurfaceDef->plane0;
       stride = dstSurfaceDef->stride0;
       sliceHeight = dstSurfaceDef->height;
@@ -669,7 +588,7 @@ int32_t C2DColorConverter::dumpOutput(char * filename, char mode) {
           }
       }
     } else {
-      C2D_RGB_SURFACE_DEF * dstSurfaceDef = (C2D_RGB_SURFACE_DEF *)mDstSurfaceDef;
+      C2D_RGB_SURFACE_DEF * dstSurfaceDef = (C2D_RGB_SURFACE_DEF *)mCur->dstSurfaceDef;
       uint8_t * base = (uint8_t *)dstSurfaceDef->buffer;
       stride = dstSurfaceDef->stride;
       sliceHeight = dstSurfaceDef->height;
@@ -706,7 +625,14 @@ int32_t C2DColorConverter::dumpOutput(char * filename, char mode) {
 
 extern "C" C2DColorConverterBase* createC2DColorConverter(size_t srcWidth, size_t srcHeight, size_t dstWidth, size_t dstHeight, ColorConvertFormat srcFormat, ColorConvertFormat dstFormat, int32_t flags, size_t srcStride)
 {
-    return new C2DColorConverter(srcWidth, srcHeight, dstWidth, dstHeight, srcFormat, dstFormat, flags, srcStride);
+    if (!(flags & C2D_FLAG_CPU)) {
+        C2DColorConverter *converter = new C2DColorConverter(srcWidth, srcHeight, dstWidth, dstHeight, srcFormat, dstFormat, flags, srcStride);
+        if (converter->isValid())
+            return converter;
+        ALOGW("GPU color conversion unavailable, falling back to the CPU");
+        delete (C2DColorConverterBase *)converter;
+    }
+    return createCPUColorConverter(srcWidth, srcHeight, dstWidth, dstHeight, srcFormat, dstFormat, flags, srcStride);
 }
 
 extern "C" void destroyC2DColorConverter(C2DColorConverterBase* C2DCC)
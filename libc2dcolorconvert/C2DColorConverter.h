@@ -30,8 +30,12 @@
 #ifndef C2D_ColorConverter_H_
 #define C2D_ColorConverter_H_
 
-#include <c2d2.h>
 #include <sys/types.h>
+#include <stdint.h>
+
+/* Host builds of the CPU converter have no GPU headers */
+#ifndef C2D_CPU_ONLY
+#include <c2d2.h>
 
 typedef C2D_STATUS (*LINK_c2dCreateSurface)( uint32 *surface_id,
         uint32 surface_bits,
@@ -64,6 +68,7 @@ typedef C2D_STATUS (*LINK_c2dDestroySurface)( uint32 surface_id );
 typedef C2D_STATUS (*LINK_c2dMapAddr)( int mem_fd, void * hostptr, uint32 len, uint32 offset, uint32 flags, void ** gpuaddr);
 
 typedef C2D_STATUS (*LINK_c2dUnMapAddr)(void * gpuaddr);
+#endif
 
 namespace android {
 
@@ -95,23 +100,61 @@ typedef struct {
   C2DBytesPerPixel bpp;
 } C2DBuffReq;
 
+/* Completion handle of an asynchronous conversion, 0 is never a valid one.
+ * Fences of one converter complete in submission order. */
+typedef uint64_t C2DFence;
+
+/* Conversions a converter keeps in flight before submitC2D blocks */
+#define C2D_MAX_INFLIGHT 3
+
+/* GPU mapping cache counters of a converter, all zero on the CPU path */
+typedef struct {
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t evictions;
+  uint64_t invalidations;
+  uint64_t unmapErrors;
+} C2DMapStats;
+
 typedef enum {
   C2D_INPUT = 0,
   C2D_OUTPUT,
 } C2D_PORT;
 
+/* createC2DColorConverter flags: convert on the CPU instead of the GPU,
+ * with an optional worker thread count (0 picks one per online core). The
+ * CPU path is also taken when the GPU C2D library cannot be loaded. */
+#define C2D_FLAG_CPU                    0x100
+#define C2D_FLAG_CPU_THREADS(n)         (((n) & 0xff) << 16)
+#define C2D_FLAG_GET_CPU_THREADS(flags) (((flags) >> 16) & 0xff)
+
 class C2DColorConverterBase {
 
 public:
     virtual ~C2DColorConverterBase(){};
     virtual int convertC2D(int srcFd, void *srcBase, void * srcData, int dstFd, void *dstBase, void * dstData) = 0;
+    /* Queues a conversion without waiting for it. Neither buffer may be
+     * touched by the CPU until waitC2D or pollC2D reports the fence done. */
+    virtual int submitC2D(int srcFd, void *srcBase, void * srcData, int dstFd, void *dstBase, void * dstData, C2DFence *fence) = 0;
+    virtual int waitC2D(C2DFence fence) = 0;
+    /* 1 once the fence is done, 0 while it is still pending */
+    virtual int pollC2D(C2DFence fence) = 0;
     virtual int32_t getBuffReq(int32_t port, C2DBuffReq *req) = 0;
     virtual int32_t dumpOutput(char * filename, char mode) = 0;
+    /* Converters may keep buffers mapped between calls; this must be called
+     * before a buffer passed to convertC2D is freed, and right after the
+     * conversion for buffers that are only mapped for one call */
+    virtual int32_t releaseBuffer(int fd, void *base) = 0;
+    virtual int32_t getMapStats(C2DMapStats *stats) = 0;
 };
 
 typedef C2DColorConverterBase* createC2DColorConverter_t(size_t srcWidth, size_t srcHeight, size_t dstWidth, size_t dstHeight, ColorConvertFormat srcFormat, ColorConvertFormat dstFormat, int32_t flags, size_t srcStride);
 typedef void destroyC2DColorConverter_t(C2DColorConverterBase*);
 
+/* The CPU converter on its own, for callers that never want the GPU. It is
+ * released like the GPU one, through the C2DColorConverterBase destructor. */
+extern "C" createC2DColorConverter_t createCPUColorConverter;
+
 }
 
 #endif  // C2D_ColorConverter_H_
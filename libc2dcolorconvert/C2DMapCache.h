@@ -0,0 +1,195 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * this software is provided "as is" and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability, fitness for a particular purpose and non-infringement
+ * are disclaimed.  in no event shall the copyright owner or contributors
+ * be liable for any direct, indirect, incidental, special, exemplary, or
+ * consequential damages (including, but not limited to, procurement of
+ * substitute goods or services; loss of use, data, or profits; or
+ * business interruption) however caused and on any theory of liability,
+ * whether in contract, strict liability, or tort (including negligence
+ * or otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef C2D_MapCache_H_
+#define C2D_MapCache_H_
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <C2DColorConverter.h>
+
+namespace android {
+
+/* Source and destination pools of a typical encoder session. Every cached
+ * mapping pins its buffer, so this also bounds what a client that cycles
+ * through new buffers can keep alive until the converter is closed. */
+#define C2D_MAP_CACHE_SIZE 32
+
+/*
+ * Keeps GPU mappings of converter buffers alive across convertC2D calls
+ * instead of mapping and unmapping both buffers every frame. Entries are
+ * keyed by (fd, host pointer, length) and evicted least recently used.
+ *
+ * The fd number alone does not identify a buffer once the client frees it
+ * and a new one is opened, so each entry also records the file behind the
+ * fd (device and inode, pinned by a dup of the fd so the inode cannot be
+ * recycled) and a lookup whose file changed drops the stale mapping. Kernels
+ * that back every dma-buf with one anonymous inode defeat that check, which
+ * is why owners must call release() before freeing a buffer. Buffers the
+ * caller does not own, such as client buffers mmapped for one conversion,
+ * must be released as soon as that conversion is done: the same fd number
+ * and address may name a different buffer on the next call.
+ *
+ * The map and unmap operations are passed in so the cache can be driven by
+ * a stubbed link table. Not thread safe, callers serialize access. An entry
+ * may only be evicted once the GPU is done with it; every conversion in
+ * flight maps two buffers, so the 2 * C2D_MAX_INFLIGHT most recently used
+ * entries are never the LRU victim while the capacity is larger than that.
+ */
+class C2DMapCache {
+
+public:
+    typedef void *(*MapFn)(void *ctx, int fd, void *ptr, size_t len);
+    typedef bool (*UnmapFn)(void *ctx, void *gpuAddr);
+
+    C2DMapCache(MapFn map, UnmapFn unmap, void *ctx, size_t capacity = C2D_MAP_CACHE_SIZE)
+        : mMap(map), mUnmap(unmap), mCtx(ctx), mClock(0) {
+        mCapacity = capacity > C2D_MAP_CACHE_SIZE ? C2D_MAP_CACHE_SIZE : capacity;
+        /* The source mapping must survive the destination lookup */
+        if (mCapacity < 2)
+            mCapacity = 2;
+        memset(mEntries, 0, sizeof(mEntries));
+        memset(&mStats, 0, sizeof(mStats));
+    }
+
+    ~C2DMapCache() {
+        clear();
+    }
+
+    /* Returns the GPU address of the buffer, mapping it on a miss */
+    void *get(int fd, void *ptr, size_t len) {
+        struct stat st;
+        Entry *victim = NULL;
+
+        if (fstat(fd, &st))
+            memset(&st, 0, sizeof(st));
+
+        for (size_t i = 0; i < mCapacity; i++) {
+            Entry *e = &mEntries[i];
+            if (!e->gpuAddr) {
+                if (!victim || victim->gpuAddr)
+                    victim = e;
+                continue;
+            }
+            if (e->fd == fd && e->ptr == ptr && e->len == len) {
+                if (e->dev == st.st_dev && e->ino == st.st_ino) {
+                    e->lastUse = ++mClock;
+                    mStats.hits++;
+                    return e->gpuAddr;
+                }
+                /* Same fd number, different buffer */
+                drop(e);
+                mStats.invalidations++;
+                victim = e;
+                continue;
+            }
+            if (!victim || (victim->gpuAddr && e->lastUse < victim->lastUse))
+                victim = e;
+        }
+
+        void *gpuAddr = mMap(mCtx, fd, ptr, len);
+        mStats.misses++;
+        if (!gpuAddr)
+            return NULL;
+        if (victim->gpuAddr) {
+            drop(victim);
+            mStats.evictions++;
+        }
+        victim->fd = fd;
+        victim->pinFd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+        victim->dev = st.st_dev;
+        victim->ino = st.st_ino;
+        victim->ptr = ptr;
+        victim->len = len;
+        victim->gpuAddr = gpuAddr;
+        victim->lastUse = ++mClock;
+        return gpuAddr;
+    }
+
+    /* Unmaps every cached mapping of fd; ptr NULL matches any address */
+    size_t release(int fd, void *ptr) {
+        size_t count = 0;
+
+        for (size_t i = 0; i < mCapacity; i++) {
+            Entry *e = &mEntries[i];
+            if (e->gpuAddr && e->fd == fd && (!ptr || e->ptr == ptr)) {
+                drop(e);
+                count++;
+            }
+        }
+        mStats.invalidations += count;
+        return count;
+    }
+
+    void clear() {
+        for (size_t i = 0; i < mCapacity; i++)
+            if (mEntries[i].gpuAddr)
+                drop(&mEntries[i]);
+    }
+
+    const C2DMapStats &stats() const {
+        return mStats;
+    }
+
+private:
+    struct Entry {
+        int fd;
+        int pinFd;
+        dev_t dev;
+        ino_t ino;
+        void *ptr;
+        size_t len;
+        void *gpuAddr;
+        uint64_t lastUse;
+    };
+
+    void drop(Entry *e) {
+        if (!mUnmap(mCtx, e->gpuAddr))
+            mStats.unmapErrors++;
+        if (e->pinFd >= 0)
+            close(e->pinFd);
+        e->gpuAddr = NULL;
+    }
+
+    MapFn mMap;
+    UnmapFn mUnmap;
+    void *mCtx;
+    size_t mCapacity;
+    uint64_t mClock;
+    Entry mEntries[C2D_MAP_CACHE_SIZE];
+    C2DMapStats mStats;
+};
+
+}
+
+#endif  // C2D_MapCache_H_
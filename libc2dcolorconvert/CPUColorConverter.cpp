@@ -0,0 +1,795 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * this software is provided "as is" and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability, fitness for a particular purpose and non-infringement
+ * are disclaimed.  in no event shall the copyright owner or contributors
+ * be liable for any direct, indirect, incidental, special, exemplary, or
+ * consequential damages (including, but not limited to, procurement of
+ * substitute goods or services; loss of use, data, or profits; or
+ * business interruption) however caused and on any theory of liability,
+ * whether in contract, strict liability, or tort (including negligence
+ * or otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+/*
+ * CPU implementation of C2DColorConverterBase, used when the GPU C2D library
+ * is not available or C2D_FLAG_CPU is passed. Buffers use the same layouts
+ * as the GPU converter. Pictures are split into bands of whole chroma rows
+ * that a small pool of worker threads converts in parallel; the calling
+ * thread takes the first band. NV12 <-> RGBA8888, the paths the decoder and
+ * encoder use, have NEON and SSE2 kernels, everything else runs through the
+ * scalar kernels which also finish the row tails. Both produce identical
+ * output: BT.601 limited range in 6 bit (to RGB) and 8 bit (to YUV) fixed
+ * point.
+ */
+
+#include <C2DColorConverter.h>
+#include "ColorConvertLayout.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <utils/Log.h>
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define CPU_CC_NEON
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define CPU_CC_SSE2
+#endif
+
+#undef LOG_TAG
+#define LOG_TAG "C2DColorConvert"
+
+#define CPU_CC_MAX_THREADS 4
+/* Fewer rows than this per band are not worth a thread wakeup */
+#define CPU_CC_MIN_BAND_ROWS 32
+
+namespace android {
+
+/* One 4:2:0 picture. The two chroma samples of a pixel pair are cStep
+ * bytes apart, 2 for semi planar and 1 for planar. */
+struct YUVPlanes {
+    uint8_t *y;
+    size_t yStride;
+    uint8_t *u;
+    uint8_t *v;
+    size_t cStride;
+    size_t cStep;
+};
+
+struct RGBPlane {
+    uint8_t *buf;
+    size_t stride;
+};
+
+class CPUColorConverter : public C2DColorConverterBase, private ColorConvertLayout {
+
+public:
+    CPUColorConverter(size_t srcWidth, size_t srcHeight, size_t dstWidth, size_t dstHeight, ColorConvertFormat srcFormat, ColorConvertFormat dstFormat, int32_t flags, size_t srcStride);
+    int32_t getBuffReq(int32_t port, C2DBuffReq *req);
+    int32_t dumpOutput(char * filename, char mode);
+    int32_t releaseBuffer(int fd, void *base);
+    int32_t getMapStats(C2DMapStats *stats);
+protected:
+    virtual ~CPUColorConverter();
+    virtual int convertC2D(int srcFd, void *srcBase, void * srcData, int dstFd, void *dstBase, void * dstData);
+    virtual int submitC2D(int srcFd, void *srcBase, void * srcData, int dstFd, void *dstBase, void * dstData, C2DFence *fence);
+    virtual int waitC2D(C2DFence fence);
+    virtual int pollC2D(C2DFence fence);
+
+private:
+    struct Worker {
+        CPUColorConverter *converter;
+        unsigned int band;
+        pthread_t thread;
+    };
+
+    bool isSemiPlanar(ColorConvertFormat format);
+    bool getYUVPlanes(ColorConvertFormat format, size_t width, size_t height, uint8_t *data, YUVPlanes *planes);
+    void convertBand(unsigned int band);
+    void convertRows(size_t first, size_t last);
+    static void *workerThread(void *arg);
+    void startWorkers(unsigned int count);
+    void stopWorkers();
+
+    YUVPlanes mSrcYUV;
+    YUVPlanes mDstYUV;
+    RGBPlane mSrcRGB;
+    RGBPlane mDstRGB;
+    uint8_t *mDstData;
+
+    Worker *mWorkers;
+    unsigned int mNumBands;
+    size_t mBandRows;
+    pthread_mutex_t mLock;
+    pthread_cond_t mStartCond;
+    pthread_cond_t mDoneCond;
+    unsigned int mGeneration;
+    unsigned int mPending;
+    bool mExit;
+    C2DFence mSubmitted;
+
+    int mError;
+};
+
+static inline uint8_t clamp255(int v)
+{
+    return v < 0 ? 0 : (v > 255 ? 255 : v);
+}
+
+static inline void yuvToRGB(int y, int u, int v, int &r, int &g, int &b)
+{
+    int y1 = (y - 16) * 74 + 32;
+
+    u -= 128;
+    v -= 128;
+    r = clamp255((y1 + 102 * v) >> 6);
+    g = clamp255((y1 - 25 * u - 52 * v) >> 6);
+    b = clamp255((y1 + 129 * u) >> 6);
+}
+
+static inline uint8_t rgbToY(int r, int g, int b)
+{
+    return ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+}
+
+static inline uint8_t rgbToU(int r, int g, int b)
+{
+    return ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
+}
+
+static inline uint8_t rgbToV(int r, int g, int b)
+{
+    return ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
+}
+
+static inline void readRGB(const uint8_t *src, ColorConvertFormat format, size_t x, int &r, int &g, int &b)
+{
+    if (format == RGBA8888) {
+        r = src[4 * x];
+        g = src[4 * x + 1];
+        b = src[4 * x + 2];
+    } else {
+        uint16_t p = ((const uint16_t *)src)[x];
+        r = (p >> 11) & 0x1f;
+        g = (p >> 5) & 0x3f;
+        b = p & 0x1f;
+        r = (r << 3) | (r >> 2);
+        g = (g << 2) | (g >> 4);
+        b = (b << 3) | (b >> 2);
+    }
+}
+
+static inline void writeRGB(uint8_t *dst, ColorConvertFormat format, size_t x, int r, int g, int b)
+{
+    if (format == RGBA8888) {
+        dst[4 * x] = r;
+        dst[4 * x + 1] = g;
+        dst[4 * x + 2] = b;
+        dst[4 * x + 3] = 0xff;
+    } else {
+        ((uint16_t *)dst)[x] = ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3);
+    }
+}
+
+//-----------------------------------------------------
+// SIMD kernels. Each returns how many pixels it converted, always a
+// multiple of two; the scalar kernels convert the rest of the row.
+
+#if defined(CPU_CC_NEON)
+
+static size_t nv12ToRGBARowSIMD(const uint8_t *y, const uint8_t *uv, uint8_t *dst, size_t width)
+{
+    size_t x;
+
+    for (x = 0; x + 16 <= width; x += 16) {
+        uint8x16_t yv = vld1q_u8(y + x);
+        uint8x8x2_t uvv = vld2_u8(uv + x);
+        int16x8_t u = vreinterpretq_s16_u16(vsubl_u8(uvv.val[0], vdup_n_u8(128)));
+        int16x8_t v = vreinterpretq_s16_u16(vsubl_u8(uvv.val[1], vdup_n_u8(128)));
+        int16x8x2_t rv = vzipq_s16(vmulq_n_s16(v, 102), vmulq_n_s16(v, 102));
+        int16x8_t guv = vmlaq_n_s16(vmulq_n_s16(u, 25), v, 52);
+        int16x8x2_t gu = vzipq_s16(guv, guv);
+        int16x8x2_t bu = vzipq_s16(vmulq_n_s16(u, 129), vmulq_n_s16(u, 129));
+        int16x8_t yh[2];
+        uint8x8x4_t px;
+
+        yh[0] = vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(yv)));
+        yh[1] = vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(yv)));
+        px.val[3] = vdup_n_u8(0xff);
+        for (int i = 0; i < 2; i++) {
+            int16x8_t y1 = vaddq_s16(vmulq_n_s16(vsubq_s16(yh[i], vdupq_n_s16(16)), 74),
+                    vdupq_n_s16(32));
+            px.val[0] = vqshrun_n_s16(vqaddq_s16(y1, rv.val[i]), 6);
+            px.val[1] = vqshrun_n_s16(vqsubq_s16(y1, gu.val[i]), 6);
+            px.val[2] = vqshrun_n_s16(vqaddq_s16(y1, bu.val[i]), 6);
+            vst4_u8(dst + 4 * (x + 8 * i), px);
+        }
+    }
+    return x;
+}
+
+static inline uint8x8_t rgbaToYNEON(uint8x8_t r, uint8x8_t g, uint8x8_t b)
+{
+    uint16x8_t y = vmull_u8(r, vdup_n_u8(66));
+
+    y = vmlal_u8(y, g, vdup_n_u8(129));
+    y = vmlal_u8(y, b, vdup_n_u8(25));
+    y = vaddq_u16(y, vdupq_n_u16(128));
+    return vadd_u8(vshrn_n_u16(y, 8), vdup_n_u8(16));
+}
+
+static inline uint8x8_t rgbaToCNEON(int16x8_t r, int16x8_t g, int16x8_t b, int16_t cr, int16_t cg, int16_t cb)
+{
+    int16x8_t c = vmulq_n_s16(r, cr);
+
+    c = vmlaq_n_s16(c, g, cg);
+    c = vmlaq_n_s16(c, b, cb);
+    c = vshrq_n_s16(vaddq_s16(c, vdupq_n_s16(128)), 8);
+    return vqmovun_s16(vaddq_s16(c, vdupq_n_s16(128)));
+}
+
+static size_t rgbaToNV12RowsSIMD(const uint8_t *src0, const uint8_t *src1, uint8_t *y0, uint8_t *y1, uint8_t *uv, size_t width)
+{
+    size_t x;
+
+    for (x = 0; x + 16 <= width; x += 16) {
+        uint8x16x4_t p0 = vld4q_u8(src0 + 4 * x);
+        uint8x16x4_t p1 = vld4q_u8(src1 + 4 * x);
+        int16x8_t avg[3];
+        uint8x8x2_t c;
+
+        vst1q_u8(y0 + x, vcombine_u8(
+                    rgbaToYNEON(vget_low_u8(p0.val[0]), vget_low_u8(p0.val[1]), vget_low_u8(p0.val[2])),
+                    rgbaToYNEON(vget_high_u8(p0.val[0]), vget_high_u8(p0.val[1]), vget_high_u8(p0.val[2]))));
+        vst1q_u8(y1 + x, vcombine_u8(
+                    rgbaToYNEON(vget_low_u8(p1.val[0]), vget_low_u8(p1.val[1]), vget_low_u8(p1.val[2])),
+                    rgbaToYNEON(vget_high_u8(p1.val[0]), vget_high_u8(p1.val[1]), vget_high_u8(p1.val[2]))));
+        for (int i = 0; i < 3; i++) {
+            uint16x8_t sum = vpadalq_u8(vpaddlq_u8(p0.val[i]), p1.val[i]);
+            avg[i] = vreinterpretq_s16_u16(vrshrq_n_u16(sum, 2));
+        }
+        c.val[0] = rgbaToCNEON(avg[0], avg[1], avg[2], -38, -74, 112);
+        c.val[1] = rgbaToCNEON(avg[0], avg[1], avg[2], 112, -94, -18);
+        vst2_u8(uv + x, c);
+    }
+    return x;
+}
+
+#elif defined(CPU_CC_SSE2)
+
+static size_t nv12ToRGBARowSIMD(const uint8_t *y, const uint8_t *uv, uint8_t *dst, size_t width)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i alpha = _mm_set1_epi8((char)0xff);
+    size_t x;
+
+    for (x = 0; x + 8 <= width; x += 8) {
+        __m128i yv = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(y + x)), zero);
+        __m128i c = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(uv + x)), zero);
+        __m128i u, v, r, g, b, rg, ba;
+
+        c = _mm_sub_epi16(c, _mm_set1_epi16(128));
+        u = _mm_shufflehi_epi16(_mm_shufflelo_epi16(c, _MM_SHUFFLE(2, 2, 0, 0)), _MM_SHUFFLE(2, 2, 0, 0));
+        v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(c, _MM_SHUFFLE(3, 3, 1, 1)), _MM_SHUFFLE(3, 3, 1, 1));
+        yv = _mm_add_epi16(_mm_mullo_epi16(_mm_sub_epi16(yv, _mm_set1_epi16(16)), _mm_set1_epi16(74)),
+                _mm_set1_epi16(32));
+        r = _mm_srai_epi16(_mm_adds_epi16(yv, _mm_mullo_epi16(v, _mm_set1_epi16(102))), 6);
+        g = _mm_srai_epi16(_mm_subs_epi16(yv, _mm_add_epi16(_mm_mullo_epi16(u, _mm_set1_epi16(25)),
+                        _mm_mullo_epi16(v, _mm_set1_epi16(52)))), 6);
+        b = _mm_srai_epi16(_mm_adds_epi16(yv, _mm_mullo_epi16(u, _mm_set1_epi16(129))), 6);
+        rg = _mm_unpacklo_epi8(_mm_packus_epi16(r, r), _mm_packus_epi16(g, g));
+        ba = _mm_unpacklo_epi8(_mm_packus_epi16(b, b), alpha);
+        _mm_storeu_si128((__m128i *)(dst + 4 * x), _mm_unpacklo_epi16(rg, ba));
+        _mm_storeu_si128((__m128i *)(dst + 4 * x + 16), _mm_unpackhi_epi16(rg, ba));
+    }
+    return x;
+}
+
+/* Eight RGBA pixels to 16 bit r, g, b lanes */
+static inline void splitRGBASSE2(const uint8_t *src, __m128i &r, __m128i &g, __m128i &b)
+{
+    const __m128i mask = _mm_set1_epi32(0xff);
+    __m128i p0 = _mm_loadu_si128((const __m128i *)src);
+    __m128i p1 = _mm_loadu_si128((const __m128i *)(src + 16));
+
+    r = _mm_packs_epi32(_mm_and_si128(p0, mask), _mm_and_si128(p1, mask));
+    g = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 8), mask),
+            _mm_and_si128(_mm_srli_epi32(p1, 8), mask));
+    b = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 16), mask),
+            _mm_and_si128(_mm_srli_epi32(p1, 16), mask));
+}
+
+static inline void storeYSSE2(uint8_t *dst, __m128i r, __m128i g, __m128i b)
+{
+    /* The sum fits in 16 bits unsigned, so wrapping adds are fine */
+    __m128i y = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(66)),
+                _mm_mullo_epi16(g, _mm_set1_epi16(129))),
+            _mm_add_epi16(_mm_mullo_epi16(b, _mm_set1_epi16(25)), _mm_set1_epi16(128)));
+
+    y = _mm_add_epi16(_mm_srli_epi16(y, 8), _mm_set1_epi16(16));
+    _mm_storel_epi64((__m128i *)dst, _mm_packus_epi16(y, y));
+}
+
+/* 2x2 average of two rows of eight, in the low four lanes */
+static inline __m128i average2x2SSE2(__m128i a, __m128i b)
+{
+    __m128i sum = _mm_madd_epi16(_mm_add_epi16(a, b), _mm_set1_epi16(1));
+
+    sum = _mm_srai_epi32(_mm_add_epi32(sum, _mm_set1_epi32(2)), 2);
+    return _mm_packs_epi32(sum, sum);
+}
+
+static inline __m128i rgbToCSSE2(__m128i r, __m128i g, __m128i b, int16_t cr, int16_t cg, int16_t cb)
+{
+    __m128i c = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(cr)),
+                _mm_mullo_epi16(g, _mm_set1_epi16(cg))),
+            _mm_add_epi16(_mm_mullo_epi16(b, _mm_set1_epi16(cb)), _mm_set1_epi16(128)));
+
+    return _mm_add_epi16(_mm_srai_epi16(c, 8), _mm_set1_epi16(128));
+}
+
+static size_t rgbaToNV12RowsSIMD(const uint8_t *src0, const uint8_t *src1, uint8_t *y0, uint8_t *y1, uint8_t *uv, size_t width)
+{
+    size_t x;
+
+    for (x = 0; x + 8 <= width; x += 8) {
+        __m128i r0, g0, b0, r1, g1, b1, r, g, b, c;
+
+        splitRGBASSE2(src0 + 4 * x, r0, g0, b0);
+        splitRGBASSE2(src1 + 4 * x, r1, g1, b1);
+        storeYSSE2(y0 + x, r0, g0, b0);
+        storeYSSE2(y1 + x, r1, g1, b1);
+        r = average2x2SSE2(r0, r1);
+        g = average2x2SSE2(g0, g1);
+        b = average2x2SSE2(b0, b1);
+        c = _mm_unpacklo_epi16(rgbToCSSE2(r, g, b, -38, -74, 112),
+                rgbToCSSE2(r, g, b, 112, -94, -18));
+        _mm_storel_epi64((__m128i *)(uv + x), _mm_packus_epi16(c, c));
+    }
+    return x;
+}
+
+#else
+
+static size_t nv12ToRGBARowSIMD(const uint8_t *, const uint8_t *, uint8_t *, size_t)
+{
+    return 0;
+}
+
+static size_t rgbaToNV12RowsSIMD(const uint8_t *, const uint8_t *, uint8_t *, uint8_t *, uint8_t *, size_t)
+{
+    return 0;
+}
+
+#endif
+
+//-----------------------------------------------------
+// Scalar kernels, starting at pixel x (even)
+
+static void yuvToRGBRowC(const uint8_t *y, const uint8_t *u, const uint8_t *v, size_t cStep,
+        uint8_t *dst, ColorConvertFormat format, size_t x, size_t width)
+{
+    int r, g, b;
+
+    for (; x < width; x++) {
+        size_t c = (x >> 1) * cStep;
+        yuvToRGB(y[x], u[c], v[c], r, g, b);
+        writeRGB(dst, format, x, r, g, b);
+    }
+}
+
+static void rgbToYUVRowsC(const uint8_t *src0, const uint8_t *src1, ColorConvertFormat format,
+        uint8_t *y0, uint8_t *y1, uint8_t *u, uint8_t *v, size_t cStep, size_t x, size_t width)
+{
+    int r[4], g[4], b[4];
+
+    for (; x < width; x += 2) {
+        /* Odd widths and heights replicate the last column and row */
+        size_t x1 = x + 1 < width ? x + 1 : x;
+        size_t c = (x >> 1) * cStep;
+
+        readRGB(src0, format, x, r[0], g[0], b[0]);
+        readRGB(src0, format, x1, r[1], g[1], b[1]);
+        readRGB(src1, format, x, r[2], g[2], b[2]);
+        readRGB(src1, format, x1, r[3], g[3], b[3]);
+        y0[x] = rgbToY(r[0], g[0], b[0]);
+        y0[x1] = rgbToY(r[1], g[1], b[1]);
+        if (y1) {
+            y1[x] = rgbToY(r[2], g[2], b[2]);
+            y1[x1] = rgbToY(r[3], g[3], b[3]);
+        }
+        if (!u)
+            continue;
+        r[0] = (r[0] + r[1] + r[2] + r[3] + 2) >> 2;
+        g[0] = (g[0] + g[1] + g[2] + g[3] + 2) >> 2;
+        b[0] = (b[0] + b[1] + b[2] + b[3] + 2) >> 2;
+        u[c] = rgbToU(r[0], g[0], b[0]);
+        v[c] = rgbToV(r[0], g[0], b[0]);
+    }
+}
+
+//-----------------------------------------------------
+
+CPUColorConverter::CPUColorConverter(size_t srcWidth, size_t srcHeight, size_t dstWidth, size_t dstHeight, ColorConvertFormat srcFormat, ColorConvertFormat dstFormat, int32_t flags, size_t srcStride)
+    : ColorConvertLayout(srcWidth, srcHeight, dstWidth, dstHeight, srcFormat, dstFormat, srcStride)
+{
+    unsigned int threads = C2D_FLAG_GET_CPU_THREADS(flags);
+    bool srcYUV = isYUVSurface(srcFormat);
+    bool dstYUV = isYUVSurface(dstFormat);
+
+    mError = 0;
+    mDstData = NULL;
+    mWorkers = NULL;
+    mNumBands = 1;
+    mBandRows = srcHeight;
+    mGeneration = 0;
+    mPending = 0;
+    mExit = false;
+    mSubmitted = 0;
+    pthread_mutex_init(&mLock, NULL);
+    pthread_cond_init(&mStartCond, NULL);
+    pthread_cond_init(&mDoneCond, NULL);
+
+    if (srcWidth != dstWidth || srcHeight != dstHeight) {
+        ALOGE("CPU color conversion does not scale: %zux%zu -> %zux%zu",
+                srcWidth, srcHeight, dstWidth, dstHeight);
+        mError = -1;
+    } else if (srcWidth < 2 || srcHeight < 2) {
+        ALOGE("CPU color conversion needs at least 2x2 pixels");
+        mError = -1;
+    } else if ((!srcYUV && !dstYUV) || srcFormat == YCbCr420Tile || dstFormat == YCbCr420Tile) {
+        ALOGE("CPU color conversion from %d to %d not supported", srcFormat, dstFormat);
+        mError = -1;
+    }
+    if (mError)
+        return;
+
+    if (!threads) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cores < 1 ? 1 : (cores > CPU_CC_MAX_THREADS ? CPU_CC_MAX_THREADS : cores);
+    }
+    if (threads > srcHeight / CPU_CC_MIN_BAND_ROWS)
+        threads = srcHeight / CPU_CC_MIN_BAND_ROWS;
+    if (!threads)
+        threads = 1;
+
+    /* Bands start on even rows so a chroma row is never shared */
+    mBandRows = ALIGN((srcHeight + threads - 1) / threads, 2);
+    mNumBands = (srcHeight + mBandRows - 1) / mBandRows;
+    if (mNumBands > 1)
+        startWorkers(mNumBands - 1);
+    ALOGV("CPU color convert %d -> %d %zux%zu, %u bands of %zu rows",
+            srcFormat, dstFormat, srcWidth, srcHeight, mNumBands, mBandRows);
+}
+
+CPUColorConverter::~CPUColorConverter()
+{
+    stopWorkers();
+    pthread_cond_destroy(&mDoneCond);
+    pthread_cond_destroy(&mStartCond);
+    pthread_mutex_destroy(&mLock);
+}
+
+void CPUColorConverter::startWorkers(unsigned int count)
+{
+    mWorkers = new Worker[count];
+    for (unsigned int i = 0; i < count; i++) {
+        mWorkers[i].converter = this;
+        mWorkers[i].band = i + 1;
+        if (pthread_create(&mWorkers[i].thread, NULL, workerThread, &mWorkers[i])) {
+            ALOGE("Failed to start color convert worker %u, using %u bands", i, i + 1);
+            mNumBands = i + 1;
+            mBandRows = ALIGN((mSrcHeight + mNumBands - 1) / mNumBands, 2);
+            break;
+        }
+    }
+}
+
+void CPUColorConverter::stopWorkers()
+{
+    if (!mWorkers)
+        return;
+    pthread_mutex_lock(&mLock);
+    mExit = true;
+    pthread_cond_broadcast(&mStartCond);
+    pthread_mutex_unlock(&mLock);
+    for (unsigned int i = 0; i + 1 < mNumBands; i++)
+        pthread_join(mWorkers[i].thread, NULL);
+    delete[] mWorkers;
+    mWorkers = NULL;
+}
+
+void *CPUColorConverter::workerThread(void *arg)
+{
+    Worker *worker = (Worker *)arg;
+    CPUColorConverter *cc = worker->converter;
+    unsigned int seen = 0;
+
+    pthread_mutex_lock(&cc->mLock);
+    for (;;) {
+        while (cc->mGeneration == seen && !cc->mExit)
+            pthread_cond_wait(&cc->mStartCond, &cc->mLock);
+        if (cc->mExit)
+            break;
+        seen = cc->mGeneration;
+        pthread_mutex_unlock(&cc->mLock);
+
+        cc->convertBand(worker->band);
+
+        pthread_mutex_lock(&cc->mLock);
+        if (--cc->mPending == 0)
+            pthread_cond_signal(&cc->mDoneCond);
+    }
+    pthread_mutex_unlock(&cc->mLock);
+    return NULL;
+}
+
+bool CPUColorConverter::isSemiPlanar(ColorConvertFormat format)
+{
+    return format == YCbCr420SP || format == NV12_2K || format == NV12_128m;
+}
+
+bool CPUColorConverter::getYUVPlanes(ColorConvertFormat format, size_t width, size_t height, uint8_t *data, YUVPlanes *planes)
+{
+    size_t stride = calcStride(format, width);
+    size_t ySize = calcYSize(format, width, height);
+
+    planes->y = data;
+    planes->yStride = stride;
+    if (isSemiPlanar(format)) {
+        planes->u = data + ySize;
+        planes->v = planes->u + 1;
+        planes->cStride = stride;
+        planes->cStep = 2;
+    } else if (format == YCbCr420P || format == YCrCb420P) {
+        uint8_t *first = data + ySize;
+        uint8_t *second = first + ySize / 4;
+        planes->u = format == YCbCr420P ? first : second;
+        planes->v = format == YCbCr420P ? second : first;
+        planes->cStride = stride / 2;
+        planes->cStep = 1;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void CPUColorConverter::convertBand(unsigned int band)
+{
+    size_t first = band * mBandRows;
+    size_t last = first + mBandRows;
+
+    if (last > mSrcHeight)
+        last = mSrcHeight;
+    if (first < last)
+        convertRows(first, last);
+}
+
+void CPUColorConverter::convertRows(size_t first, size_t last)
+{
+    size_t width = mSrcWidth;
+    /* The layouts hold height / 2 chroma rows; an odd last row reuses the
+     * chroma above it and writes none */
+    size_t chromaRows = mSrcHeight >> 1;
+
+    for (size_t row = first; row < last; row += 2) {
+        bool pair = row + 1 < last;
+        size_t crow = row >> 1;
+        bool chroma = crow < chromaRows;
+
+        if (!chroma)
+            crow = chromaRows - 1;
+
+        if (isYUVSurface(mSrcFormat) && !isYUVSurface(mDstFormat)) {
+            const YUVPlanes &s = mSrcYUV;
+            const uint8_t *u = s.u + crow * s.cStride;
+            const uint8_t *v = s.v + crow * s.cStride;
+            bool simd = mDstFormat == RGBA8888 && s.cStep == 2 && v == u + 1;
+
+            for (size_t r = row; r < row + (pair ? 2 : 1); r++) {
+                const uint8_t *y = s.y + r * s.yStride;
+                uint8_t *dst = mDstRGB.buf + r * mDstRGB.stride;
+                size_t x = simd ? nv12ToRGBARowSIMD(y, u, dst, width) : 0;
+                yuvToRGBRowC(y, u, v, s.cStep, dst, mDstFormat, x, width);
+            }
+        } else if (!isYUVSurface(mSrcFormat)) {
+            const YUVPlanes &d = mDstYUV;
+            const uint8_t *src0 = mSrcRGB.buf + row * mSrcRGB.stride;
+            const uint8_t *src1 = pair ? src0 + mSrcRGB.stride : src0;
+            uint8_t *y0 = d.y + row * d.yStride;
+            uint8_t *y1 = pair ? y0 + d.yStride : NULL;
+            uint8_t *u = chroma ? d.u + crow * d.cStride : NULL;
+            uint8_t *v = chroma ? d.v + crow * d.cStride : NULL;
+            size_t x = 0;
+
+            if (pair && mSrcFormat == RGBA8888 && d.cStep == 2 && v == u + 1)
+                x = rgbaToNV12RowsSIMD(src0, src1, y0, y1, u, width);
+            rgbToYUVRowsC(src0, src1, mSrcFormat, y0, y1, u, v, d.cStep, x, width);
+        } else {
+            const YUVPlanes &s = mSrcYUV;
+            const YUVPlanes &d = mDstYUV;
+            const uint8_t *su = s.u + crow * s.cStride;
+            const uint8_t *sv = s.v + crow * s.cStride;
+            uint8_t *du = d.u + crow * d.cStride;
+            uint8_t *dv = d.v + crow * d.cStride;
+            size_t cw = (width + 1) >> 1;
+
+            memcpy(d.y + row * d.yStride, s.y + row * s.yStride, width);
+            if (pair)
+                memcpy(d.y + (row + 1) * d.yStride, s.y + (row + 1) * s.yStride, width);
+            if (!chroma) {
+                continue;
+            } else if (s.cStep == 2 && d.cStep == 2) {
+                memcpy(du, su, 2 * cw);
+            } else if (s.cStep == 1 && d.cStep == 1) {
+                memcpy(du, su, cw);
+                memcpy(dv, sv, cw);
+            } else {
+                for (size_t c = 0; c < cw; c++) {
+                    du[c * d.cStep] = su[c * s.cStep];
+                    dv[c * d.cStep] = sv[c * s.cStep];
+                }
+            }
+        }
+    }
+}
+
+int CPUColorConverter::convertC2D(int srcFd, void *srcBase, void * srcData, int dstFd, void *dstBase, void * dstData)
+{
+    (void)srcFd;
+    (void)srcBase;
+    (void)dstFd;
+    (void)dstBase;
+
+    if (mError) {
+        ALOGE("CPU color converter initialization failed\n");
+        return mError;
+    }
+
+    if (srcData == NULL || dstData == NULL) {
+        ALOGE("Incorrect input parameters\n");
+        return -1;
+    }
+
+    if (isYUVSurface(mSrcFormat)) {
+        getYUVPlanes(mSrcFormat, mSrcWidth, mSrcHeight, (uint8_t *)srcData, &mSrcYUV);
+    } else {
+        mSrcRGB.buf = (uint8_t *)srcData;
+        mSrcRGB.stride = calcStride(mSrcFormat, mSrcWidth);
+    }
+    if (isYUVSurface(mDstFormat)) {
+        getYUVPlanes(mDstFormat, mDstWidth, mDstHeight, (uint8_t *)dstData, &mDstYUV);
+    } else {
+        mDstRGB.buf = (uint8_t *)dstData;
+        mDstRGB.stride = calcStride(mDstFormat, mDstWidth);
+    }
+    mDstData = (uint8_t *)dstData;
+
+    if (mNumBands > 1) {
+        pthread_mutex_lock(&mLock);
+        mPending = mNumBands - 1;
+        mGeneration++;
+        pthread_cond_broadcast(&mStartCond);
+        pthread_mutex_unlock(&mLock);
+    }
+
+    convertBand(0);
+
+    if (mNumBands > 1) {
+        pthread_mutex_lock(&mLock);
+        while (mPending)
+            pthread_cond_wait(&mDoneCond, &mLock);
+        pthread_mutex_unlock(&mLock);
+    }
+    return 0;
+}
+
+int32_t CPUColorConverter::getBuffReq(int32_t port, C2DBuffReq *req) {
+    return fillBuffReq(port, req);
+}
+
+/* The calling thread takes part in every conversion, so a submitted one is
+ * already complete when submitC2D returns */
+int CPUColorConverter::submitC2D(int srcFd, void *srcBase, void * srcData, int dstFd, void *dstBase, void * dstData, C2DFence *fence) {
+    int ret;
+
+    if (!fence)
+        return -1;
+    *fence = 0;
+    ret = convertC2D(srcFd, srcBase, srcData, dstFd, dstBase, dstData);
+    if (ret < 0)
+        return ret;
+    *fence = ++mSubmitted;
+    return 0;
+}
+
+int CPUColorConverter::waitC2D(C2DFence fence) {
+    return (!fence || fence > mSubmitted) ? -1 : 0;
+}
+
+int CPUColorConverter::pollC2D(C2DFence fence) {
+    return (!fence || fence > mSubmitted) ? -1 : 1;
+}
+
+/* Buffers are only touched through their host pointers, nothing is mapped */
+int32_t CPUColorConverter::releaseBuffer(int fd, void *base) {
+    (void)fd;
+    (void)base;
+    return 0;
+}
+
+int32_t CPUColorConverter::getMapStats(C2DMapStats *stats) {
+    if (!stats)
+        return -1;
+    memset(stats, 0, sizeof(*stats));
+    return 0;
+}
+
+int32_t CPUColorConverter::dumpOutput(char * filename, char mode) {
+    int fd;
+    int ret = 0;
+    if (!filename || !mDstData) return -1;
+
+    int flags = O_RDWR | O_CREAT;
+    if (mode == 'a') {
+      flags |= O_APPEND;
+    }
+
+    if ((fd = open(filename, flags, 0644)) < 0) {
+        ALOGE("open dump file failed w/ errno %s", strerror(errno));
+        return -1;
+    }
+
+    if (isYUVSurface(mDstFormat)) {
+      const YUVPlanes &d = mDstYUV;
+      for (size_t i = 0; i < mDstHeight && ret >= 0; i++)
+        ret = write(fd, d.y + i * d.yStride, mDstWidth);
+      if (d.cStep == 2) {
+        for (size_t i = 0; i < mDstHeight / 2 && ret >= 0; i++)
+          ret = write(fd, d.u + i * d.cStride, mDstWidth);
+      } else {
+        for (size_t i = 0; i < mDstHeight / 2 && ret >= 0; i++)
+          ret = write(fd, d.u + i * d.cStride, mDstWidth / 2);
+        for (size_t i = 0; i < mDstHeight / 2 && ret >= 0; i++)
+          ret = write(fd, d.v + i * d.cStride, mDstWidth / 2);
+      }
+    } else {
+      int bpp = mDstFormat == RGB565 ? 2 : 4;
+      for (size_t i = 0; i < mDstHeight && ret >= 0; i++)
+        ret = write(fd, mDstRGB.buf + i * mDstRGB.stride, mDstWidth * bpp);
+    }
+
+    if (ret < 0) {
+      ALOGE("file write failed w/ errno %s", strerror(errno));
+    }
+    close(fd);
+    return ret < 0 ? ret : 0;
+}
+
+extern "C" C2DColorConverterBase* createCPUColorConverter(size_t srcWidth, size_t srcHeight, size_t dstWidth, size_t dstHeight, ColorConvertFormat srcFormat, ColorConvertFormat dstFormat, int32_t flags, size_t srcStride)
+{
+    return new CPUColorConverter(srcWidth, srcHeight, dstWidth, dstHeight, srcFormat, dstFormat, flags, srcStride);
+}
+
+}
@@ -0,0 +1,257 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * this software is provided "as is" and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability, fitness for a particular purpose and non-infringement
+ * are disclaimed.  in no event shall the copyright owner or contributors
+ * be liable for any direct, indirect, incidental, special, exemplary, or
+ * consequential damages (including, but not limited to, procurement of
+ * substitute goods or services; loss of use, data, or profits; or
+ * business interruption) however caused and on any theory of liability,
+ * whether in contract, strict liability, or tort (including negligence
+ * or otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include "ColorConvertLayout.h"
+#include <string.h>
+#include <utils/Log.h>
+
+#undef LOG_TAG
+#define LOG_TAG "C2DColorConvert"
+
+namespace android {
+
+ColorConvertLayout::ColorConvertLayout(size_t srcWidth, size_t srcHeight, size_t dstWidth, size_t dstHeight, ColorConvertFormat srcFormat, ColorConvertFormat dstFormat, size_t srcStride)
+{
+    mSrcWidth = srcWidth;
+    mSrcHeight = srcHeight;
+    mSrcStride = srcStride;
+    mDstWidth = dstWidth;
+    mDstHeight = dstHeight;
+    mSrcFormat = srcFormat;
+    mDstFormat = dstFormat;
+}
+
+bool ColorConvertLayout::isYUVSurface(ColorConvertFormat format)
+{
+    switch (format) {
+        case YCbCr420Tile:
+        case YCbCr420SP:
+        case YCbCr420P:
+        case YCrCb420P:
+        case NV12_2K:
+        case NV12_128m:
+            return true;
+        case RGB565:
+        case RGBA8888:
+        default:
+            return false;
+    }
+}
+
+size_t ColorConvertLayout::calcStride(ColorConvertFormat format, size_t width)
+{
+    switch (format) {
+        case RGB565:
+            return ALIGN(width, ALIGN32) * 2; // RGB565 has width as twice
+        case RGBA8888:
+	if (mSrcStride)
+		return mSrcStride * 4;
+	else
+		return ALIGN(width, ALIGN32) * 4;
+        case YCbCr420Tile:
+            return ALIGN(width, ALIGN128);
+        case YCbCr420SP:
+            return ALIGN(width, ALIGN16);
+        case NV12_2K:
+            return ALIGN(width, ALIGN16);
+        case NV12_128m:
+            return ALIGN(width, ALIGN128);
+        case YCbCr420P:
+            return ALIGN(width, ALIGN16);
+        case YCrCb420P:
+            return ALIGN(width, ALIGN16);
+        default:
+            return 0;
+    }
+}
+
+size_t ColorConvertLayout::calcYSize(ColorConvertFormat format, size_t width, size_t height)
+{
+    switch (format) {
+        case YCbCr420SP:
+            return (ALIGN(width, ALIGN16) * height);
+        case YCbCr420P:
+            return ALIGN(width, ALIGN16) * height;
+        case YCrCb420P:
+            return ALIGN(width, ALIGN16) * height;
+        case YCbCr420Tile:
+            return ALIGN(ALIGN(width, ALIGN128) * ALIGN(height, ALIGN32), ALIGN8K);
+        case NV12_2K: {
+            size_t alignedw = ALIGN(width, ALIGN16);
+            size_t lumaSize = ALIGN(alignedw * height, ALIGN2K);
+            return lumaSize;
+        }
+        case NV12_128m:
+            return ALIGN(width, ALIGN128) * ALIGN(height, ALIGN32);
+        default:
+            return 0;
+    }
+}
+
+size_t ColorConvertLayout::calcSize(ColorConvertFormat format, size_t width, size_t height)
+{
+    int32_t alignedw = 0;
+    int32_t alignedh = 0;
+    int32_t size = 0;
+
+    switch (format) {
+        case RGB565:
+            size = ALIGN(width, ALIGN32) * ALIGN(height, ALIGN32) * 2;
+            size = ALIGN(size, ALIGN4K);
+            break;
+        case RGBA8888:
+            if (mSrcStride)
+              size = mSrcStride *  ALIGN(height, ALIGN32) * 4;
+            else
+              size = ALIGN(width, ALIGN32) * ALIGN(height, ALIGN32) * 4;
+            size = ALIGN(size, ALIGN4K);
+            break;
+        case YCbCr420SP:
+            alignedw = ALIGN(width, ALIGN16);
+            size = ALIGN((alignedw * height) + (ALIGN(width/2, ALIGN32) * (height/2) * 2), ALIGN4K);
+            break;
+        case YCbCr420P:
+            alignedw = ALIGN(width, ALIGN16);
+            size = ALIGN((alignedw * height) + (ALIGN(width/2, ALIGN16) * (height/2) * 2), ALIGN4K);
+            break;
+        case YCrCb420P:
+            alignedw = ALIGN(width, ALIGN16);
+            size = ALIGN((alignedw * height) + (ALIGN(width/2, ALIGN16) * (height/2) * 2), ALIGN4K);
+            break;
+        case YCbCr420Tile:
+            alignedw = ALIGN(width, ALIGN128);
+            alignedh = ALIGN(height, ALIGN32);
+            size = ALIGN(alignedw * alignedh, ALIGN8K) + ALIGN(alignedw * ALIGN(height/2, ALIGN32), ALIGN8K);
+            break;
+        case NV12_2K: {
+            alignedw = ALIGN(width, ALIGN16);
+            size_t lumaSize = ALIGN(alignedw * height, ALIGN2K);
+            size_t chromaSize = ALIGN((alignedw * height)/2, ALIGN2K);
+            size = ALIGN(lumaSize + chromaSize, ALIGN4K);
+            ALOGV("NV12_2k, width = %d, height = %d, size = %d", width, height, size);
+            }
+            break;
+        case NV12_128m:
+            alignedw = ALIGN(width, ALIGN128);
+            alignedh = ALIGN(height, ALIGN32);
+            size = ALIGN(alignedw * alignedh + (alignedw * ALIGN(height/2, ALIGN16)), ALIGN4K);
+            break;
+        default:
+            break;
+    }
+    return size;
+}
+
+size_t ColorConvertLayout::calcLumaAlign(ColorConvertFormat format) {
+    if (!isYUVSurface(format)) return 1; //no requirement
+
+    switch (format) {
+        case NV12_2K:
+          return ALIGN2K;
+        case NV12_128m:
+          return 1;
+        default:
+          ALOGD("unknown format passed for luma alignment number");
+          return 1;
+    }
+}
+
+size_t ColorConvertLayout::calcSizeAlign(ColorConvertFormat format) {
+    if (!isYUVSurface(format)) return 1; //no requirement
+
+    switch (format) {
+        case YCbCr420SP: //OR NV12
+        case YCbCr420P:
+        case NV12_2K:
+        case NV12_128m:
+          return ALIGN4K;
+        default:
+          ALOGD("unknown format passed for size alignment number");
+          return 1;
+    }
+}
+
+C2DBytesPerPixel ColorConvertLayout::calcBytesPerPixel(ColorConvertFormat format) {
+    C2DBytesPerPixel bpp;
+    bpp.numerator = 0;
+    bpp.denominator = 1;
+
+    switch (format) {
+        case RGB565:
+            bpp.numerator = 2;
+            break;
+        case RGBA8888:
+            bpp.numerator = 4;
+            break;
+        case YCbCr420SP:
+        case YCbCr420P:
+        case YCrCb420P:
+        case YCbCr420Tile:
+        case NV12_2K:
+        case NV12_128m:
+            bpp.numerator = 3;
+            bpp.denominator = 2;
+            break;
+        default:
+            break;
+    }
+    return bpp;
+}
+
+int32_t ColorConvertLayout::fillBuffReq(int32_t port, C2DBuffReq *req) {
+    if (!req) return -1;
+
+    if (port != C2D_INPUT && port != C2D_OUTPUT) return -1;
+
+    memset(req, 0, sizeof(C2DBuffReq));
+    if (port == C2D_INPUT) {
+        req->width = mSrcWidth;
+        req->height = mSrcHeight;
+        req->stride = calcStride(mSrcFormat, mSrcWidth);
+        req->sliceHeight = mSrcHeight;
+        req->lumaAlign = calcLumaAlign(mSrcFormat);
+        req->sizeAlign = calcSizeAlign(mSrcFormat);
+        req->size = calcSize(mSrcFormat, mSrcWidth, mSrcHeight);
+        req->bpp = calcBytesPerPixel(mSrcFormat);
+        ALOGV("input req->size = %d\n", req->size);
+    } else if (port == C2D_OUTPUT) {
+        req->width = mDstWidth;
+        req->height = mDstHeight;
+        req->stride = calcStride(mDstFormat, mDstWidth);
+        req->sliceHeight = mDstHeight;
+        req->lumaAlign = calcLumaAlign(mDstFormat);
+        req->sizeAlign = calcSizeAlign(mDstFormat);
+        req->size = calcSize(mDstFormat, mDstWidth, mDstHeight);
+        req->bpp = calcBytesPerPixel(mDstFormat);
+        ALOGV("output req->size = %d\n", req->size);
+    }
+    return 0;
+}
+
+}
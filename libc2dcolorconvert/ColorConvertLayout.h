@@ -0,0 +1,76 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * this software is provided "as is" and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability, fitness for a particular purpose and non-infringement
+ * are disclaimed.  in no event shall the copyright owner or contributors
+ * be liable for any direct, indirect, incidental, special, exemplary, or
+ * consequential damages (including, but not limited to, procurement of
+ * substitute goods or services; loss of use, data, or profits; or
+ * business interruption) however caused and on any theory of liability,
+ * whether in contract, strict liability, or tort (including negligence
+ * or otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef COLOR_CONVERT_LAYOUT_H_
+#define COLOR_CONVERT_LAYOUT_H_
+
+#include <C2DColorConverter.h>
+
+#define ALIGN( num, to ) (((num) + (to-1)) & (~(to-1)))
+#define ALIGN8K 8192
+#define ALIGN4K 4096
+#define ALIGN2K 2048
+#define ALIGN128 128
+#define ALIGN32 32
+#define ALIGN16 16
+
+namespace android {
+
+/*
+ * Buffer geometry of the formats handled by the converters. The GPU and CPU
+ * converters share it so both agree on strides, plane offsets and the sizes
+ * reported through getBuffReq.
+ */
+class ColorConvertLayout {
+
+public:
+    ColorConvertLayout(size_t srcWidth, size_t srcHeight, size_t dstWidth, size_t dstHeight, ColorConvertFormat srcFormat, ColorConvertFormat dstFormat, size_t srcStride);
+
+    static bool isYUVSurface(ColorConvertFormat format);
+    size_t calcStride(ColorConvertFormat format, size_t width);
+    size_t calcYSize(ColorConvertFormat format, size_t width, size_t height);
+    size_t calcSize(ColorConvertFormat format, size_t width, size_t height);
+    size_t calcLumaAlign(ColorConvertFormat format);
+    size_t calcSizeAlign(ColorConvertFormat format);
+    C2DBytesPerPixel calcBytesPerPixel(ColorConvertFormat format);
+    int32_t fillBuffReq(int32_t port, C2DBuffReq *req);
+
+protected:
+    size_t mSrcWidth;
+    size_t mSrcHeight;
+    size_t mSrcStride;
+    size_t mDstWidth;
+    size_t mDstHeight;
+    enum ColorConvertFormat mSrcFormat;
+    enum ColorConvertFormat mDstFormat;
+};
+
+}
+
+#endif  // COLOR_CONVERT_LAYOUT_H_
@@ -533,6 +533,18 @@ enum OMX_QCOM_EXTN_INDEXTYPE
     /* Set Prefer-adaptive playback*/
     /* "OMX.QTI.index.param.video.PreferAdaptivePlayback" */
     OMX_QTIIndexParamVideoPreferAdaptivePlayback = 0x7F000054,
+
+    /* "OMX.QTI.index.param.video.LazyExtradata" */
+    OMX_QTIIndexParamVideoLazyExtradata = 0x7F000055,
+
+    /* "OMX.QTI.index.config.video.ExtradataQuery" */
+    OMX_QTIIndexConfigVideoExtradataQuery = 0x7F000056,
+
+    /* "OMX.QTI.index.param.video.ExtradataPassthrough" */
+    OMX_QTIIndexParamVideoExtradataPassthrough = 0x7F000057,
+
+    /* "OMX.QTI.index.config.video.DynamicBufferRefs" */
+    OMX_QTIIndexConfigVideoDynamicBufferRefs = 0x7F000058,
 };
 
 /**
@@ -1224,6 +1236,35 @@ typedef struct OMX_QCOM_EXTRADATA_MBINFO
    OMX_U8  data[0];
 } OMX_QCOM_EXTRADATA_MBINFO;
 
+/**
+ * Payload of OMX_ExtraDataVideoEncoderMBInfoRef, sent instead of
+ * OMX_ExtraDataVideoEncoderMBInfo when the encoder is in extradata
+ * passthrough mode (OMX_QTIIndexParamVideoExtradataPassthrough). The MB
+ * info stays in the driver's extradata buffer and is not copied behind the
+ * bitstream; the record references it instead.
+ *
+ * The data is valid from FillBufferDone until the buffer is passed to
+ * FillThisBuffer again. The fd belongs to the component's process and
+ * stays open until the output buffers are freed; clients map it (nMapSize
+ * bytes from offset 0) and must not close it.
+ *
+ * STRUCT MEMBERS
+ *
+ * nFormat   : Payload format, as nFormat of OMX_QCOM_EXTRADATA_MBINFO
+ * nFd       : ION fd of the encoder's extradata buffer
+ * nOffset   : Offset of the MB info payload from the start of the fd
+ * nDataSize : Size of the MB info payload in bytes
+ * nMapSize  : Size of the memory behind nFd
+ */
+typedef struct OMX_QCOM_EXTRADATA_MBINFO_REF
+{
+   OMX_U32 nFormat;
+   OMX_S32 nFd;
+   OMX_U32 nOffset;
+   OMX_U32 nDataSize;
+   OMX_U32 nMapSize;
+} OMX_QCOM_EXTRADATA_MBINFO_REF;
+
 typedef struct OMX_QCOM_EXTRADATA_VQZIPSEI {
     OMX_U32 nSize;
     OMX_U8 data[0];
@@ -1247,6 +1288,7 @@ typedef enum OMX_QCOM_EXTRADATATYPE
     OMX_ExtraDataInputBitsInfo =           0x7F00000e,
     OMX_ExtraDataVideoEncoderMBInfo =      0x7F00000f,
     OMX_ExtraDataVQZipSEI  =               0x7F000010,
+    OMX_ExtraDataVideoEncoderMBInfoRef =   0x7F000011,
 } OMX_QCOM_EXTRADATATYPE;
 
 typedef struct  OMX_STREAMINTERLACEFORMATTYPE {
@@ -1506,6 +1548,66 @@ typedef struct QOMX_VIDEO_CUSTOM_BUFFERSIZE {
         OMX_U32 nBufferSize;
 } QOMX_VIDEO_CUSTOM_BUFFERSIZE;
 
+/**
+ * Queries one extradata record of a decoded output buffer when lazy
+ * extradata is enabled with OMX_QTIIndexParamVideoLazyExtradata. Lazy mode
+ * stops appending extradata behind the frame on every FillBufferDone; the
+ * record is decoded from the driver's extradata only when asked for, in the
+ * same layout it would have had behind the frame.
+ *
+ * The buffer must be one the client got back in FillBufferDone and has not
+ * passed to FillThisBuffer since. Only the types the client enabled are
+ * available.
+ *
+ * STRUCT MEMBERS
+ *
+ * nSize          : Size of Structure in bytes
+ * nVersion       : OpenMAX IL specification version information
+ * nPortIndex     : Output port index
+ * pBufferHdr     : Output buffer the record belongs to
+ * nExtradataType : OMX_EXTRADATATYPE of the record, e.g. OMX_ExtraDataQP
+ * nDataSize      : In: bytes available at pData. Out: size of the record,
+ *                  or the size needed when OMX_ErrorOverflow is returned
+ * pData          : 4 byte aligned memory that receives one
+ *                  OMX_OTHER_EXTRADATATYPE record
+ *
+ * Returns OMX_ErrorNoMore when the frame carries no record of that type.
+ */
+typedef struct QOMX_VIDEO_EXTRADATA_QUERY {
+    OMX_U32 nSize;
+    OMX_VERSIONTYPE nVersion;
+    OMX_U32 nPortIndex;
+    OMX_BUFFERHEADERTYPE *pBufferHdr;
+    OMX_U32 nExtradataType;
+    OMX_U32 nDataSize;
+    OMX_U8 *pData;
+} QOMX_VIDEO_EXTRADATA_QUERY;
+
+/**
+ * Reports the references the decoder firmware holds on output buffers in
+ * dynamic buffer mode (OMX.google.android.index.storeMetaDataInBuffers on
+ * the output port). The firmware keeps reference frames after their
+ * FillBufferDone; each buffer is released once the firmware drops its
+ * last reference.
+ *
+ * STRUCT MEMBERS
+ *
+ * nSize        : Size of Structure in bytes
+ * nVersion     : OpenMAX IL specification version information
+ * nPortIndex   : Output port index
+ * nBuffersHeld : Out: output buffers with at least one reference
+ * nRefsHeld    : Out: sum of the references on those buffers
+ *
+ * Returns OMX_ErrorUnsupportedSetting when dynamic buffer mode is off.
+ */
+typedef struct QOMX_VIDEO_DYNAMIC_BUFFER_REFS {
+    OMX_U32 nSize;
+    OMX_VERSIONTYPE nVersion;
+    OMX_U32 nPortIndex;
+    OMX_U32 nBuffersHeld;
+    OMX_U32 nRefsHeld;
+} QOMX_VIDEO_DYNAMIC_BUFFER_REFS;
+
 #define OMX_QCOM_INDEX_PARAM_VIDEO_SYNCFRAMEDECODINGMODE "OMX.QCOM.index.param.video.SyncFrameDecodingMode"
 #define OMX_QCOM_INDEX_PARAM_INDEXEXTRADATA "OMX.QCOM.index.param.IndexExtraData"
 #define OMX_QCOM_INDEX_PARAM_VIDEO_SLICEDELIVERYMODE "OMX.QCOM.index.param.SliceDeliveryMode"
@@ -1542,6 +1644,10 @@ typedef struct QOMX_VIDEO_CUSTOM_BUFFERSIZE {
 #define OMX_QCOM_INDEX_PARAM_VIDEO_SAR "OMX.QCOM.index.param.video.sar"
 
 #define OMX_QTI_INDEX_PARAM_VIDEO_PREFER_ADAPTIVE_PLAYBACK "OMX.QTI.index.param.video.PreferAdaptivePlayback"
+#define OMX_QTI_INDEX_PARAM_VIDEO_LAZY_EXTRADATA "OMX.QTI.index.param.video.LazyExtradata"
+#define OMX_QTI_INDEX_CONFIG_VIDEO_EXTRADATA_QUERY "OMX.QTI.index.config.video.ExtradataQuery"
+#define OMX_QTI_INDEX_PARAM_VIDEO_EXTRADATA_PASSTHROUGH "OMX.QTI.index.param.video.ExtradataPassthrough"
+#define OMX_QTI_INDEX_CONFIG_VIDEO_DYNAMIC_BUFFER_REFS "OMX.QTI.index.config.video.DynamicBufferRefs"
 
 typedef enum {
     QOMX_VIDEO_FRAME_PACKING_CHECKERBOARD = 0,
@@ -16,6 +16,15 @@ libmm-vidc-def += -D_ANDROID_
 libmm-vidc-def += -Werror
 libmm-vidc-def += -D_ANDROID_ICS_
 
+ifeq ($(TARGET_USES_ION),true)
+libmm-vidc-def += -DUSE_ION
+endif
+
+# Debug levels compiled into the components, e.g. 0x3 drops DEBUG_PRINT_LOW
+ifneq ($(TARGET_VIDC_DEBUG_COMPILED_MASK),)
+libmm-vidc-def += -DVIDC_DEBUG_COMPILED_MASK=$(TARGET_VIDC_DEBUG_COMPILED_MASK)
+endif
+
 # ---------------------------------------------------------------------------------
 # 			Make the Shared library (libOmxVidcCommon)
 # ---------------------------------------------------------------------------------
@@ -37,6 +46,10 @@ LOCAL_SHARED_LIBRARIES    := liblog libutils libcutils libdl
 
 LOCAL_SRC_FILES   := src/extra_data_handler.cpp
 LOCAL_SRC_FILES   += src/vidc_color_converter.cpp
+LOCAL_SRC_FILES   += src/vidc_trace.cpp
+LOCAL_SRC_FILES   += src/vidc_log.cpp
+LOCAL_SRC_FILES   += src/vidc_stride_conv.cpp
+LOCAL_SRC_FILES   += src/vidc_ion_pool.cpp
 
 include $(BUILD_STATIC_LIBRARY)
 
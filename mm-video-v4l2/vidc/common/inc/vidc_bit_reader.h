@@ -0,0 +1,210 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2015, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+    * Neither the name of The Linux Foundation nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+#ifndef __VIDC_BIT_READER_H__
+#define __VIDC_BIT_READER_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* How the bytes given to a vidc_bit_reader turn into bits */
+enum vidc_bit_reader_mode {
+    VIDC_BITS_RAW,      // bytes are used as they are
+    VIDC_BITS_RBSP,     // emulation prevention bytes (00 00 03) are dropped
+    VIDC_BITS_NAL,      // as RBSP, and a start code prefix ends the data
+};
+
+/*
+ * MSB first bit reader for bitstream headers. Up to 64 bits are cached, so
+ * the bytes are only looked at once on refill, four at a time where they
+ * cannot hold an emulation prevention byte, and Exp-Golomb codes are
+ * decoded with one count-leading-zeros. The emulation prevention handling
+ * is chosen at compile time through the mode.
+ *
+ * Reading past the end of the data returns zero bits and sets overrun(),
+ * so callers check once after a run of reads instead of on every field.
+ */
+template <vidc_bit_reader_mode mode>
+class vidc_bit_reader
+{
+    public:
+        vidc_bit_reader() {
+            init(NULL, 0);
+        }
+        vidc_bit_reader(const uint8_t *data, uint32_t size) {
+            init(data, size);
+        }
+
+        void init(const uint8_t *data, uint32_t size) {
+            cur = data;
+            end = data ? data + size : data;
+            cache = 0;
+            cached = 0;
+            zeros = 0;
+            epb = 0;
+            past_end = false;
+        }
+
+        /* n is 0 to 32 */
+        inline uint32_t read_bits(uint32_t n) {
+            uint32_t value;
+
+            if (!n)
+                return 0;
+            if (cached < n)
+                refill();
+            value = (uint32_t)(cache >> (64 - n));
+            if (cached < n) {
+                past_end = true;
+                cache = 0;
+                cached = 0;
+                return value;
+            }
+            cache <<= n;
+            cached -= n;
+            return value;
+        }
+
+        inline uint32_t read_bit() {
+            return read_bits(1);
+        }
+
+        void skip_bits(uint32_t n) {
+            for (; n > 32; n -= 32)
+                read_bits(32);
+            read_bits(n);
+        }
+
+        /* ue(v). Codes with more than 31 leading zeros are not valid and
+           are reported like an overrun. */
+        inline uint32_t read_ue() {
+            uint32_t lz, len;
+
+            if (cached < 32)
+                refill();
+            if (!(cache >> 32)) {
+                past_end = true;
+                cache = 0;
+                cached = 0;
+                return 0;
+            }
+            lz = __builtin_clzll(cache);
+            len = 2 * lz + 1;
+            if (len <= cached) {
+                uint32_t code = (uint32_t)(cache >> (64 - len));
+                cache <<= len;
+                cached -= len;
+                return code - 1;
+            }
+            cache <<= lz + 1;
+            cached -= lz + 1;
+            return ((1u << lz) - 1) + read_bits(lz);
+        }
+
+        /* se(v) */
+        inline int32_t read_se() {
+            uint32_t code = read_ue();
+            if (code & 1)
+                return (int32_t)((code >> 1) + 1);
+            return -(int32_t)(code >> 1);
+        }
+
+        /* Bits left to read, not counting emulation prevention bytes that
+           have not been reached yet */
+        bool more_data() const {
+            return cached || cur < end;
+        }
+
+        bool overrun() const {
+            return past_end;
+        }
+
+        /* Emulation prevention bytes dropped since init() */
+        uint32_t epb_count() const {
+            return epb;
+        }
+
+        /* Byte holding the next bit to read. Exact in VIDC_BITS_RAW mode. */
+        const uint8_t *byte_position() const {
+            return cur - (cached + 7) / 8;
+        }
+
+    private:
+        /* 0x80 in each byte of w that is zero */
+        static inline uint32_t zero_bytes(uint32_t w) {
+            return ~(((w & 0x7F7F7F7Fu) + 0x7F7F7F7Fu) | w | 0x7F7F7F7Fu);
+        }
+
+        void refill() {
+            while (cached <= 56 && cur < end) {
+                if (cached <= 32 && end - cur >= 4) {
+                    uint32_t w = ((uint32_t)cur[0] << 24) | ((uint32_t)cur[1] << 16) |
+                        ((uint32_t)cur[2] << 8) | cur[3];
+                    uint32_t z = mode == VIDC_BITS_RAW ? 0 : zero_bytes(w);
+                    // No two zero bytes in a row, counting the ones before
+                    // w, so no emulation prevention byte or start code
+                    if (!(z & (z << 8)) && !(zeros && (z >> 31)) && zeros < 2) {
+                        cache |= (uint64_t)w << (32 - cached);
+                        cached += 32;
+                        cur += 4;
+                        zeros = z & 0x80 ? 1 : 0;
+                        continue;
+                    }
+                }
+                uint8_t b = *cur++;
+                if (mode != VIDC_BITS_RAW) {
+                    if (zeros >= 2 && b <= 3) {
+                        if (b == 3) {
+                            zeros = 0;
+                            epb++;
+                            continue;
+                        }
+                        if (mode == VIDC_BITS_NAL && b <= 1) {
+                            // 00 00 00 and 00 00 01 never occur inside a
+                            // NAL unit, this is the start of the next one
+                            end = --cur;
+                            break;
+                        }
+                    }
+                    zeros = b ? 0 : zeros + 1;
+                }
+                cache |= (uint64_t)b << (56 - cached);
+                cached += 8;
+            }
+        }
+
+        const uint8_t *cur;
+        const uint8_t *end;
+        uint64_t cache;         // next bits, MSB aligned
+        uint32_t cached;        // valid bits in cache
+        uint32_t zeros;         // zero bytes just before cur
+        uint32_t epb;
+        bool past_end;
+};
+
+#endif // __VIDC_BIT_READER_H__
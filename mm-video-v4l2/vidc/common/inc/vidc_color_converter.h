@@ -42,6 +42,11 @@ class omx_c2d_conv
                 ColorConvertFormat dest);
         bool convert(int src_fd, void *src_base, void *src_viraddr,
                 int dest_fd, void *dest_base, void *dest_viraddr);
+        bool submit(int src_fd, void *src_base, void *src_viraddr,
+                int dest_fd, void *dest_base, void *dest_viraddr, C2DFence &fence);
+        bool wait(C2DFence fence);
+        bool poll(C2DFence fence);
+        void release_buffer(int fd, void *base);
         bool get_buffer_size(int port,unsigned int &buf_size);
         bool get_output_filled_length(unsigned int &filled_length);
         int get_src_format();
@@ -31,6 +31,8 @@ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #ifdef _ANDROID_
 #include <cstdio>
+#include <stdint.h>
+#include <android/log.h>
 
 enum {
    PRIO_ERROR=0x1,
@@ -39,29 +41,88 @@ enum {
    PRIO_LOW=0x4
 };
 
+/*
+ * Levels that are compiled in. A call site whose level is outside the mask
+ * is a constant false branch: no code is generated for it and its arguments
+ * are never evaluated. Builds set it through VIDC_DEBUG_COMPILED_MASK in the
+ * make environment, e.g. 0x3 to drop PRIO_LOW from the per-NAL paths.
+ */
+#ifndef VIDC_DEBUG_COMPILED_MASK
+#define VIDC_DEBUG_COMPILED_MASK (PRIO_ERROR | PRIO_HIGH | PRIO_LOW)
+#endif
+
 extern int debug_level;
 
+#define VIDC_DEBUG_ENABLED(prio) \
+      (((VIDC_DEBUG_COMPILED_MASK) & (prio)) && (debug_level & (prio)))
+
+/* Same as VIDC_DEBUG_ENABLED, for levels that are off in normal operation */
+#define VIDC_DEBUG_VERBOSE(prio) \
+      (((VIDC_DEBUG_COMPILED_MASK) & (prio)) && __builtin_expect(debug_level & (prio), 0))
+
+/* State of one rate limited call site, zero initialized */
+struct vidc_log_ratelimit {
+    uint32_t window;
+    uint32_t printed;
+    uint32_t suppressed;
+};
+
+/*
+ * Debug priorities go to a binary ring that a background thread formats
+ * and writes when vidc.debug.log.async is set (or vidc_log_set_async() is
+ * called), everything else is written to the log before returning.
+ */
+void vidc_log_print(int prio, const char *tag, const char *fmt, ...)
+        __attribute__((format(printf, 3, 4)));
+void vidc_log_set_async(bool enable);
+void vidc_log_flush();
+bool vidc_log_ratelimit_pass(struct vidc_log_ratelimit *rl, int prio, const char *tag);
+
 #undef DEBUG_PRINT_ERROR
 #define DEBUG_PRINT_ERROR(fmt, args...) \
-      if (debug_level & PRIO_ERROR) \
-          ALOGE(fmt,##args)
+      if (VIDC_DEBUG_ENABLED(PRIO_ERROR)) \
+          vidc_log_print(ANDROID_LOG_ERROR, LOG_TAG, fmt, ##args)
 #undef DEBUG_PRINT_INFO
 #define DEBUG_PRINT_INFO(fmt, args...) \
-      if (debug_level & PRIO_INFO) \
-          ALOGI(fmt,##args)
+      if (VIDC_DEBUG_ENABLED(PRIO_INFO)) \
+          vidc_log_print(ANDROID_LOG_INFO, LOG_TAG, fmt, ##args)
 #undef DEBUG_PRINT_LOW
 #define DEBUG_PRINT_LOW(fmt, args...) \
-      if (debug_level & PRIO_LOW) \
-          ALOGD(fmt,##args)
+      if (VIDC_DEBUG_VERBOSE(PRIO_LOW)) \
+          vidc_log_print(ANDROID_LOG_DEBUG, LOG_TAG, fmt, ##args)
 #undef DEBUG_PRINT_HIGH
 #define DEBUG_PRINT_HIGH(fmt, args...) \
-      if (debug_level & PRIO_HIGH) \
-          ALOGD(fmt,##args)
+      if (VIDC_DEBUG_VERBOSE(PRIO_HIGH)) \
+          vidc_log_print(ANDROID_LOG_DEBUG, LOG_TAG, fmt, ##args)
+
+/*
+ * For messages that can repeat per frame or per NAL: each call site prints
+ * a burst of VIDC_LOG_RATELIMIT_BURST messages per interval and reports how
+ * many it dropped once the next interval opens.
+ */
+#define VIDC_LOG_RATELIMIT_INTERVAL_MS 1000
+#define VIDC_LOG_RATELIMIT_BURST 10
+
+#define VIDC_DEBUG_PRINT_RATELIMITED(enabled, prio, fmt, args...) \
+      do { \
+          static struct vidc_log_ratelimit vidc_ratelimit_state; \
+          if ((enabled) && vidc_log_ratelimit_pass(&vidc_ratelimit_state, prio, LOG_TAG)) \
+              vidc_log_print(prio, LOG_TAG, fmt, ##args); \
+      } while (0)
+#define DEBUG_PRINT_ERROR_RATELIMITED(fmt, args...) \
+      VIDC_DEBUG_PRINT_RATELIMITED(VIDC_DEBUG_ENABLED(PRIO_ERROR), ANDROID_LOG_ERROR, fmt, ##args)
+#define DEBUG_PRINT_HIGH_RATELIMITED(fmt, args...) \
+      VIDC_DEBUG_PRINT_RATELIMITED(VIDC_DEBUG_VERBOSE(PRIO_HIGH), ANDROID_LOG_DEBUG, fmt, ##args)
+#define DEBUG_PRINT_LOW_RATELIMITED(fmt, args...) \
+      VIDC_DEBUG_PRINT_RATELIMITED(VIDC_DEBUG_VERBOSE(PRIO_LOW), ANDROID_LOG_DEBUG, fmt, ##args)
 #else
 #define DEBUG_PRINT_ERROR printf
 #define DEBUG_PRINT_INFO printf
 #define DEBUG_PRINT_LOW printf
 #define DEBUG_PRINT_HIGH printf
+#define DEBUG_PRINT_ERROR_RATELIMITED printf
+#define DEBUG_PRINT_HIGH_RATELIMITED printf
+#define DEBUG_PRINT_LOW_RATELIMITED printf
 #endif
 
 #endif
@@ -0,0 +1,199 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2015, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+    * Neither the name of The Linux Foundation nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+#ifndef __VIDC_ION_POOL_H__
+#define __VIDC_ION_POOL_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+/* Blocks tracked at once, idle or handed out, by all users of a pool */
+#define VIDC_ION_POOL_MAX_BLOCKS 512
+/* Idle memory kept for the next allocation, about one 4K output set */
+#define VIDC_ION_POOL_MAX_IDLE_BYTES (256 * 1024 * 1024)
+/* Idle blocks older than this are freed on the next pool call */
+#define VIDC_ION_POOL_IDLE_MS 2000
+
+/* One backing allocation. len and align are what the backend allocated */
+struct vidc_pool_block {
+    size_t len;
+    size_t align;
+    unsigned int flags;
+    unsigned int heap_mask;
+    int dev_fd;             // allocator device, the memfd itself on hosts
+    unsigned long handle;   // backend handle, the ION handle
+    int fd;                 // shareable fd, owned by the pool
+};
+
+/*
+ * Where the memory comes from. alloc() gets len, align, flags and heap_mask
+ * filled in and sets up dev_fd, handle and fd. free() gets a block whose fd
+ * may be -1 when the owner already closed it.
+ */
+class vidc_pool_backend
+{
+    public:
+        virtual ~vidc_pool_backend() {}
+        virtual const char *name() const = 0;
+        virtual bool alloc(struct vidc_pool_block *blk) = 0;
+        virtual void free(struct vidc_pool_block *blk) = 0;
+        /* Blocks that must not be handed to another owner, e.g. secure */
+        virtual bool reusable(const struct vidc_pool_block &blk) const {
+            (void)blk;
+            return true;
+        }
+};
+
+/* /dev/ion, one ION client per block like the components always had */
+class vidc_ion_backend : public vidc_pool_backend
+{
+    public:
+        const char *name() const {
+            return "ion";
+        }
+        bool alloc(struct vidc_pool_block *blk);
+        void free(struct vidc_pool_block *blk);
+        bool reusable(const struct vidc_pool_block &blk) const;
+};
+
+/* Anonymous shared memory, for host builds and the benchmark */
+class vidc_memfd_backend : public vidc_pool_backend
+{
+    public:
+        const char *name() const {
+            return "memfd";
+        }
+        bool alloc(struct vidc_pool_block *blk);
+        void free(struct vidc_pool_block *blk);
+};
+
+struct vidc_pool_stats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t allocs;
+    uint64_t frees;
+    uint64_t trims;
+    size_t idle_blocks;
+    size_t idle_bytes;
+    size_t busy_bytes;
+    size_t peak_bytes;
+};
+
+/*
+ * Recycles buffer allocations across port reconfigurations. A port that
+ * frees its buffers and allocates a new set, same size or back to an
+ * earlier resolution, gets the blocks it just returned instead of another
+ * round of ION alloc, map and free.
+ *
+ * Requests are rounded up to size classes, page granular for small sizes
+ * and eight classes per power of two above that, so at most 1/8 is wasted.
+ * An idle block serves a request with the same flags and heap when its
+ * alignment is at least the requested one and it is no more than a quarter
+ * larger than the request's class; the smallest such block wins.
+ *
+ * Idle blocks are trimmed lazily: least recently used first once the idle
+ * bytes exceed the limit, blocks idle for longer than the timeout on the
+ * next acquire() or release(), and all of them when the last user detaches.
+ * Blocks the backend does not report reusable() are freed on release.
+ *
+ * acquire() returns the block's device fd and a dup of its shareable fd
+ * that the caller owns and closes as before; release() takes the device fd
+ * and handle back. Memory handed out again is not cleared. A device fd the
+ * pool does not know, e.g. after the block table filled up, is freed
+ * through the backend right away.
+ *
+ * Thread safe. instance() is shared by all components of a library.
+ */
+class vidc_buffer_pool
+{
+    public:
+        vidc_buffer_pool(vidc_pool_backend *backend,
+                size_t max_idle_bytes = VIDC_ION_POOL_MAX_IDLE_BYTES,
+                unsigned int idle_ms = VIDC_ION_POOL_IDLE_MS);
+        ~vidc_buffer_pool();
+
+        /* ION on targets built with USE_ION, memfd otherwise */
+        static vidc_buffer_pool *instance();
+
+        /* Components attach for their lifetime, the last detach trims */
+        void attach();
+        void detach();
+
+        int acquire(size_t len, size_t align, unsigned int flags,
+                unsigned int heap_mask, struct vidc_pool_block *blk, int *fd);
+        void release(int dev_fd, unsigned long handle);
+        void trim(size_t keep_bytes);
+
+        void get_stats(struct vidc_pool_stats *stats);
+        static size_t size_class(size_t len);
+
+    private:
+        enum slot_state {
+            SLOT_UNUSED,
+            SLOT_IDLE,
+            SLOT_BUSY,
+        };
+
+        struct slot {
+            struct vidc_pool_block blk;
+            enum slot_state state;
+            uint64_t last_use;
+        };
+
+        vidc_buffer_pool(const vidc_buffer_pool &);
+        vidc_buffer_pool &operator=(const vidc_buffer_pool &);
+
+        void free_slot_locked(struct slot *s);
+        void trim_locked(size_t keep_bytes, uint64_t now, bool expire);
+
+        vidc_pool_backend *m_backend;
+        size_t m_max_idle_bytes;
+        unsigned int m_idle_ms;
+        unsigned int m_users;
+        pthread_mutex_t m_lock;
+        struct vidc_pool_stats m_stats;
+        struct slot m_slots[VIDC_ION_POOL_MAX_BLOCKS];
+};
+
+#ifdef USE_ION
+#include <linux/msm_ion.h>
+
+/* Hands a pooled block out through the ION structs the components use */
+static inline void vidc_ion_pool_export(const struct vidc_pool_block &blk,
+        int fd, struct ion_allocation_data *alloc_data, struct ion_fd_data *fd_data)
+{
+    alloc_data->len = blk.len;
+    alloc_data->align = blk.align;
+    alloc_data->handle = (__typeof__(alloc_data->handle))blk.handle;
+    fd_data->handle = alloc_data->handle;
+    fd_data->fd = fd;
+}
+#endif
+
+#endif
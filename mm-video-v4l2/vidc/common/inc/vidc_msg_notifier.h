@@ -0,0 +1,120 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2015, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+    * Neither the name of The Linux Foundation nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+#ifndef __VIDC_MSG_NOTIFIER_H__
+#define __VIDC_MSG_NOTIFIER_H__
+
+#include <errno.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+/*
+ * Wakes a component message thread when commands or buffer events are
+ * queued. The message thread drains every queue on each wakeup, so posts
+ * made before it gets there are coalesced into a single eventfd write and
+ * read instead of one pipe write and read per event.
+ *
+ * notify() may be called from any thread after the event is queued, wait()
+ * from the message thread only. The queues themselves stay under the
+ * component lock, which also orders clearing the pending flag in wait()
+ * against the next insert.
+ */
+class vidc_msg_notifier
+{
+    public:
+        vidc_msg_notifier()
+            : m_fd(-1), m_pending(0), m_stop(0) {
+        }
+
+        ~vidc_msg_notifier() {
+            deinit();
+        }
+
+        bool init() {
+            m_pending = 0;
+            m_stop = 0;
+            m_fd = eventfd(0, EFD_CLOEXEC);
+            return m_fd >= 0;
+        }
+
+        void deinit() {
+            if (m_fd >= 0)
+                close(m_fd);
+            m_fd = -1;
+        }
+
+        /* Returns true if this call had to wake the message thread */
+        bool notify() {
+            if (!__sync_bool_compare_and_swap(&m_pending, 0, 1))
+                return false;
+            signal();
+            return true;
+        }
+
+        /* Blocks until events are pending. Returns false once stop() was
+         * called or the eventfd failed; the caller then exits. */
+        bool wait() {
+            uint64_t count;
+
+            for (;;) {
+                ssize_t n = read(m_fd, &count, sizeof(count));
+                if (n == (ssize_t)sizeof(count))
+                    break;
+                if (n < 0 && errno == EINTR)
+                    continue;
+                return false;
+            }
+            if (m_stop)
+                return false;
+            /* Posts after this point wake us again */
+            __sync_lock_test_and_set(&m_pending, 0);
+            __sync_synchronize();
+            return true;
+        }
+
+        /* Makes wait() return false so the message thread can be joined */
+        void stop() {
+            m_stop = 1;
+            __sync_synchronize();
+            signal();
+        }
+
+    private:
+        void signal() {
+            uint64_t one = 1;
+
+            while (write(m_fd, &one, sizeof(one)) < 0 && errno == EINTR);
+        }
+
+        int m_fd;
+        volatile int m_pending;
+        volatile int m_stop;
+};
+
+#endif /* __VIDC_MSG_NOTIFIER_H__ */
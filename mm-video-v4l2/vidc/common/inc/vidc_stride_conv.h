@@ -0,0 +1,114 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2015, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+    * Neither the name of The Linux Foundation nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+#ifndef __VIDC_STRIDE_CONV_H__
+#define __VIDC_STRIDE_CONV_H__
+
+#include <stddef.h>
+#include <pthread.h>
+#include "OMX_Types.h"
+
+#define VIDC_STRIDE_CONV_MAX_THREADS 4
+
+/* Destination layout of an NV12 picture, e.g. from the VENUS_* macros */
+struct vidc_nv12_layout {
+    OMX_U32 y_stride;
+    OMX_U32 y_scanlines;
+    OMX_U32 uv_stride;
+    OMX_U32 uv_scanlines;
+};
+
+/*
+ * Rearranges a packed NV12 picture (width byte rows, chroma right behind
+ * the luma) into a strided layout with padded scanlines.
+ *
+ * align() writes into a separate buffer. Rows are split into bands that a
+ * small pool of workers copies in parallel, the calling thread takes the
+ * first band. Large pictures are written with non-temporal stores where the
+ * CPU has them, so the source and the rest of the cache are not evicted by
+ * a destination that only the hardware reads.
+ *
+ * align_in_place() converts inside one buffer and stays on the calling
+ * thread: every row lands on top of the source of rows below it, so rows
+ * have to move bottom up. Planes that do not move are skipped and planes
+ * whose rows keep their stride move as one block.
+ *
+ * One conversion at a time per instance, callers serialize access.
+ */
+class vidc_stride_conv
+{
+    public:
+        /* threads 0 picks the online CPU count, capped to the maximum */
+        vidc_stride_conv(unsigned int threads = 0);
+        ~vidc_stride_conv();
+
+        static size_t buffer_size(const struct vidc_nv12_layout &layout);
+
+        bool align(const OMX_U8 *src, OMX_U8 *dst, size_t dst_len,
+                OMX_U32 width, OMX_U32 height, const struct vidc_nv12_layout &layout);
+        static bool align_in_place(OMX_U8 *buf, size_t len,
+                OMX_U32 width, OMX_U32 height, const struct vidc_nv12_layout &layout);
+
+        unsigned int threads() const {
+            return m_num_workers + 1;
+        }
+
+    private:
+        struct worker {
+            vidc_stride_conv *conv;
+            unsigned int band;
+            pthread_t thread;
+        };
+
+        vidc_stride_conv(const vidc_stride_conv &);
+        vidc_stride_conv &operator=(const vidc_stride_conv &);
+
+        static void *worker_thread(void *arg);
+        void copy_band(unsigned int band);
+
+        struct worker m_workers[VIDC_STRIDE_CONV_MAX_THREADS - 1];
+        unsigned int m_num_workers;
+        pthread_mutex_t m_lock;
+        pthread_cond_t m_start_cond;
+        pthread_cond_t m_done_cond;
+        unsigned int m_generation;
+        unsigned int m_pending;
+        bool m_exit;
+
+        /* Current job, rows are luma rows followed by chroma rows */
+        const OMX_U8 *m_src;
+        OMX_U8 *m_dst;
+        OMX_U32 m_width;
+        OMX_U32 m_height;
+        struct vidc_nv12_layout m_layout;
+        unsigned int m_num_bands;
+        OMX_U32 m_band_rows;
+        bool m_stream;
+};
+
+#endif
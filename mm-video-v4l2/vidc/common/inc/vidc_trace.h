@@ -0,0 +1,139 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2015, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+    * Neither the name of The Linux Foundation nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+#ifndef __VIDC_TRACE_H__
+#define __VIDC_TRACE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+/* Points a buffer passes through between the IL client and the driver */
+enum vidc_trace_stage {
+    VIDC_TRACE_ETB,         /* empty_this_buffer from the client */
+    VIDC_TRACE_ETB_PROXY,   /* picked up by the message thread */
+    VIDC_TRACE_QBUF_IN,     /* VIDIOC_QBUF on the OUTPUT_MPLANE port */
+    VIDC_TRACE_DQBUF_IN,    /* dequeued by the async thread */
+    VIDC_TRACE_EBD,         /* EmptyBufferDone to the client */
+    VIDC_TRACE_FTB,         /* fill_this_buffer from the client */
+    VIDC_TRACE_QBUF_OUT,    /* VIDIOC_QBUF on the CAPTURE_MPLANE port */
+    VIDC_TRACE_DQBUF_OUT,   /* dequeued by the async thread */
+    VIDC_TRACE_FBD,         /* FillBufferDone to the client */
+    VIDC_TRACE_STAGE_MAX
+};
+
+struct vidc_trace_record {
+    uint64_t time_ns;       /* CLOCK_MONOTONIC */
+    int64_t timestamp;      /* frame timestamp in us */
+    uint32_t buffer;        /* buffer index on its port */
+    uint32_t tid;
+    uint32_t stage;
+    uint32_t seq;           /* index + 1 once the record is complete */
+};
+
+/* Latency between two stages of the same frame or buffer, in us */
+struct vidc_trace_span_stats {
+    const char *name;
+    unsigned int count;
+    double p50, p99, max;
+};
+
+#define VIDC_TRACE_DEFAULT_SIZE 8192
+
+/*
+ * Per-instance ring of stage timestamps. record() may be called from any
+ * thread without a lock: each writer claims a slot with an atomic
+ * increment and publishes it by storing the sequence number last, so a
+ * reader skips slots that are being rewritten. The ring keeps the most
+ * recent records only.
+ *
+ * Off unless init() was called with a non-zero size, record() is then a
+ * single branch. dump() and summarize() read a snapshot and may run while
+ * the component is still streaming.
+ */
+class vidc_trace
+{
+    public:
+        vidc_trace()
+            : m_ring(NULL), m_mask(0), m_next(0) {
+        }
+
+        ~vidc_trace() {
+            free(m_ring);
+        }
+
+        /* size is rounded up to a power of two, 1 picks the default */
+        bool init(unsigned int size);
+
+        bool enabled() const {
+            return m_ring != NULL;
+        }
+
+        void record(vidc_trace_stage stage, unsigned int buffer, int64_t timestamp) {
+            struct timespec now;
+            vidc_trace_record *r;
+            uint32_t idx;
+
+            if (!m_ring)
+                return;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            idx = __sync_fetch_and_add(&m_next, 1);
+            r = &m_ring[idx & m_mask];
+            r->seq = 0;
+            __sync_synchronize();
+            r->time_ns = (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+            r->timestamp = timestamp;
+            r->buffer = buffer;
+            r->tid = (uint32_t)syscall(__NR_gettid);
+            r->stage = stage;
+            __sync_synchronize();
+            r->seq = idx + 1;
+        }
+
+        /* Writes the records as Chrome trace JSON (chrome://tracing, Perfetto) */
+        bool dump(const char *path, const char *name) const;
+
+        /* Fills up to max span statistics, returns how many were filled */
+        size_t summarize(vidc_trace_span_stats *stats, size_t max) const;
+
+        /* Logs the span statistics at DEBUG_PRINT_INFO */
+        void log_summary(const char *name) const;
+
+    private:
+        size_t snapshot(vidc_trace_record *out) const;
+
+        vidc_trace_record *m_ring;
+        uint32_t m_mask;
+        volatile uint32_t m_next;
+};
+
+#endif /* __VIDC_TRACE_H__ */
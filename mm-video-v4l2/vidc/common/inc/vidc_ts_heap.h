@@ -0,0 +1,166 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2015, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+    * Neither the name of The Linux Foundation nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+#ifndef __VIDC_TS_HEAP_H__
+#define __VIDC_TS_HEAP_H__
+
+#include <stddef.h>
+#include "OMX_Core.h"
+
+/* Enough for the deepest reorder we see (32 buffers per port) plus a
+ * second stream segment queued behind an EOS. */
+#define VIDC_TS_HEAP_SIZE 128
+
+/*
+ * Bounded min-heap of input timestamps used to restore presentation order
+ * on the output side. Entries are ordered by (generation, timestamp): a new
+ * generation is started at EOS so timestamps of the next segment never come
+ * out before the current one is drained. Storage is inline, nothing is
+ * allocated after construction. insert and pop_min are O(log n), remove is
+ * a linear lookup followed by an O(log n) fix up.
+ *
+ * Not thread safe, callers serialize access.
+ */
+class vidc_ts_heap
+{
+    public:
+        vidc_ts_heap() {
+            reset();
+        }
+
+        void reset() {
+            m_count = 0;
+            m_generation = 0;
+        }
+
+        /* Start a new segment, later inserts sort after all current entries */
+        void new_generation() {
+            m_generation++;
+        }
+
+        unsigned int size() const {
+            return m_count;
+        }
+
+        bool insert(OMX_TICKS ts) {
+            if (m_count == VIDC_TS_HEAP_SIZE)
+                return false;
+            m_heap[m_count].timestamp = ts;
+            m_heap[m_count].generation = m_generation;
+            sift_up(m_count++);
+            return true;
+        }
+
+        bool peek_min(OMX_TICKS &ts, OMX_U32 *generation = NULL) const {
+            if (!m_count)
+                return false;
+            ts = m_heap[0].timestamp;
+            if (generation)
+                *generation = m_heap[0].generation;
+            return true;
+        }
+
+        bool pop_min(OMX_TICKS &ts, OMX_U32 *generation = NULL) {
+            if (!peek_min(ts, generation))
+                return false;
+            remove_at(0);
+            return true;
+        }
+
+        /* Drop one entry of the oldest generation matching ts */
+        bool remove(OMX_TICKS ts) {
+            if (!m_count)
+                return false;
+            for (unsigned int i = 0; i < m_count; i++) {
+                if (m_heap[i].timestamp == ts &&
+                        m_heap[i].generation == m_heap[0].generation) {
+                    remove_at(i);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+    private:
+        struct entry {
+            OMX_TICKS timestamp;
+            OMX_U32 generation;
+        };
+
+        /* Generations compare modulo 2^32 so the counter may wrap */
+        static bool less(const entry &a, const entry &b) {
+            if (a.generation != b.generation)
+                return (OMX_S32)(a.generation - b.generation) < 0;
+            return a.timestamp < b.timestamp;
+        }
+
+        void sift_up(unsigned int i) {
+            entry e = m_heap[i];
+            while (i) {
+                unsigned int parent = (i - 1) / 2;
+                if (!less(e, m_heap[parent]))
+                    break;
+                m_heap[i] = m_heap[parent];
+                i = parent;
+            }
+            m_heap[i] = e;
+        }
+
+        void sift_down(unsigned int i) {
+            entry e = m_heap[i];
+            for (;;) {
+                unsigned int child = 2 * i + 1;
+                if (child >= m_count)
+                    break;
+                if (child + 1 < m_count && less(m_heap[child + 1], m_heap[child]))
+                    child++;
+                if (!less(m_heap[child], e))
+                    break;
+                m_heap[i] = m_heap[child];
+                i = child;
+            }
+            m_heap[i] = e;
+        }
+
+        void remove_at(unsigned int i) {
+            m_count--;
+            if (i == m_count)
+                return;
+            m_heap[i] = m_heap[m_count];
+            if (i && less(m_heap[i], m_heap[(i - 1) / 2]))
+                sift_up(i);
+            else
+                sift_down(i);
+        }
+
+        entry m_heap[VIDC_TS_HEAP_SIZE];
+        unsigned int m_count;
+        OMX_U32 m_generation;
+};
+
+#endif /* __VIDC_TS_HEAP_H__ */
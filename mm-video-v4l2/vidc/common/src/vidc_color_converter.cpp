@@ -92,6 +92,45 @@ bool omx_c2d_conv::convert(int src_fd, void *src_base, void *src_viraddr,
     return ((result < 0)?false:true);
 }
 
+/* Queues the conversion, the destination is valid once wait() returns true */
+bool omx_c2d_conv::submit(int src_fd, void *src_base, void *src_viraddr,
+        int dest_fd, void *dest_base, void *dest_viraddr, C2DFence &fence)
+{
+    int result;
+
+    fence = 0;
+    if (!src_viraddr || !dest_viraddr || !c2dcc || !dest_base || !src_base) {
+        DEBUG_PRINT_ERROR("Invalid arguments omx_c2d_conv::submit");
+        return false;
+    }
+
+    result = c2dcc->submitC2D(src_fd, src_base, src_viraddr,
+            dest_fd, dest_base, dest_viraddr, &fence);
+    DEBUG_PRINT_LOW("Color convert submit status %d fence %llu",
+            result, (unsigned long long)fence);
+    return ((result < 0)?false:true);
+}
+
+bool omx_c2d_conv::wait(C2DFence fence)
+{
+    if (!c2dcc || !fence)
+        return false;
+    return c2dcc->waitC2D(fence) >= 0;
+}
+
+bool omx_c2d_conv::poll(C2DFence fence)
+{
+    if (!c2dcc || !fence)
+        return false;
+    return c2dcc->pollC2D(fence) > 0;
+}
+
+void omx_c2d_conv::release_buffer(int fd, void *base)
+{
+    if (c2dcc)
+        c2dcc->releaseBuffer(fd, base);
+}
+
 bool omx_c2d_conv::open(unsigned int height,unsigned int width,
         ColorConvertFormat src, ColorConvertFormat dest)
 {
@@ -0,0 +1,429 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2015, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+    * Neither the name of The Linux Foundation nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+#define LOG_TAG "OMX_VIDC_ION_POOL"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <utils/Log.h>
+#include "vidc_ion_pool.h"
+#include "vidc_debug.h"
+
+#define VIDC_ION_POOL_PAGE 4096
+/* Page granular classes up to here, geometric above */
+#define VIDC_ION_POOL_SMALL (16 * VIDC_ION_POOL_PAGE)
+
+static uint64_t now_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+#ifdef USE_ION
+typedef __typeof__(((struct ion_allocation_data *)0)->handle) vidc_ion_handle_t;
+
+bool vidc_ion_backend::alloc(struct vidc_pool_block *blk)
+{
+    struct ion_allocation_data alloc_data;
+    struct ion_fd_data fd_data;
+    struct ion_handle_data handle_data;
+
+    int dev_fd = open("/dev/ion", O_RDONLY);
+    if (dev_fd < 0) {
+        DEBUG_PRINT_ERROR("opening ion device failed with fd = %d", dev_fd);
+        return false;
+    }
+
+    memset(&alloc_data, 0, sizeof(alloc_data));
+    alloc_data.len = blk->len;
+    alloc_data.align = blk->align;
+    alloc_data.flags = blk->flags;
+    alloc_data.heap_id_mask = blk->heap_mask;
+    if (ioctl(dev_fd, ION_IOC_ALLOC, &alloc_data) || !alloc_data.handle) {
+        DEBUG_PRINT_ERROR("ION ALLOC memory failed, len %zu", blk->len);
+        close(dev_fd);
+        return false;
+    }
+
+    memset(&fd_data, 0, sizeof(fd_data));
+    fd_data.handle = alloc_data.handle;
+    if (ioctl(dev_fd, ION_IOC_MAP, &fd_data)) {
+        DEBUG_PRINT_ERROR("ION MAP failed ");
+        handle_data.handle = alloc_data.handle;
+        ioctl(dev_fd, ION_IOC_FREE, &handle_data);
+        close(dev_fd);
+        return false;
+    }
+
+    blk->dev_fd = dev_fd;
+    blk->handle = (unsigned long)alloc_data.handle;
+    blk->fd = fd_data.fd;
+    return true;
+}
+
+void vidc_ion_backend::free(struct vidc_pool_block *blk)
+{
+    struct ion_handle_data handle_data;
+
+    if (blk->fd >= 0)
+        close(blk->fd);
+    handle_data.handle = (vidc_ion_handle_t)blk->handle;
+    if (ioctl(blk->dev_fd, ION_IOC_FREE, &handle_data))
+        DEBUG_PRINT_ERROR("ION: free failed");
+    close(blk->dev_fd);
+    blk->dev_fd = -1;
+    blk->fd = -1;
+    blk->handle = 0;
+}
+
+bool vidc_ion_backend::reusable(const struct vidc_pool_block &blk) const
+{
+    // Content protected heaps are scarce, give them back right away
+    return !(blk.flags & ION_SECURE);
+}
+#else
+bool vidc_ion_backend::alloc(struct vidc_pool_block *blk)
+{
+    (void)blk;
+    DEBUG_PRINT_ERROR("ION pool backend not built in");
+    return false;
+}
+
+void vidc_ion_backend::free(struct vidc_pool_block *blk)
+{
+    (void)blk;
+}
+
+bool vidc_ion_backend::reusable(const struct vidc_pool_block &blk) const
+{
+    (void)blk;
+    return false;
+}
+#endif
+
+bool vidc_memfd_backend::alloc(struct vidc_pool_block *blk)
+{
+#ifdef __NR_memfd_create
+    int fd = syscall(__NR_memfd_create, "vidc_pool", 0);
+    if (fd < 0) {
+        DEBUG_PRINT_ERROR("memfd_create failed, errno %d", errno);
+        return false;
+    }
+    if (ftruncate(fd, blk->len)) {
+        DEBUG_PRINT_ERROR("memfd resize to %zu failed, errno %d", blk->len, errno);
+        close(fd);
+        return false;
+    }
+    blk->fd = dup(fd);
+    if (blk->fd < 0) {
+        close(fd);
+        return false;
+    }
+    blk->dev_fd = fd;
+    blk->handle = 0;
+    return true;
+#else
+    (void)blk;
+    DEBUG_PRINT_ERROR("memfd not available");
+    return false;
+#endif
+}
+
+void vidc_memfd_backend::free(struct vidc_pool_block *blk)
+{
+    if (blk->fd >= 0)
+        close(blk->fd);
+    close(blk->dev_fd);
+    blk->dev_fd = -1;
+    blk->fd = -1;
+}
+
+vidc_buffer_pool::vidc_buffer_pool(vidc_pool_backend *backend,
+        size_t max_idle_bytes, unsigned int idle_ms)
+    : m_backend(backend),
+      m_max_idle_bytes(max_idle_bytes),
+      m_idle_ms(idle_ms),
+      m_users(0)
+{
+    pthread_mutex_init(&m_lock, NULL);
+    memset(&m_stats, 0, sizeof(m_stats));
+    memset(m_slots, 0, sizeof(m_slots));
+    for (int i = 0; i < VIDC_ION_POOL_MAX_BLOCKS; i++)
+        m_slots[i].state = SLOT_UNUSED;
+}
+
+vidc_buffer_pool::~vidc_buffer_pool()
+{
+    trim(0);
+    pthread_mutex_destroy(&m_lock);
+}
+
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+static vidc_buffer_pool *pool_instance;
+
+static void create_instance()
+{
+#ifdef USE_ION
+    static vidc_ion_backend backend;
+#else
+    static vidc_memfd_backend backend;
+#endif
+    // Never destroyed, components may still free buffers during exit
+    pool_instance = new vidc_buffer_pool(&backend);
+}
+
+vidc_buffer_pool *vidc_buffer_pool::instance()
+{
+    pthread_once(&pool_once, create_instance);
+    return pool_instance;
+}
+
+void vidc_buffer_pool::attach()
+{
+    pthread_mutex_lock(&m_lock);
+    m_users++;
+    pthread_mutex_unlock(&m_lock);
+}
+
+void vidc_buffer_pool::detach()
+{
+    pthread_mutex_lock(&m_lock);
+    if (m_users && !--m_users) {
+        DEBUG_PRINT_HIGH("%s pool: %llu hits %llu misses %llu allocs %llu frees, peak %zu bytes",
+                m_backend->name(), (unsigned long long)m_stats.hits,
+                (unsigned long long)m_stats.misses, (unsigned long long)m_stats.allocs,
+                (unsigned long long)m_stats.frees, m_stats.peak_bytes);
+        trim_locked(0, now_ms(), false);
+    }
+    pthread_mutex_unlock(&m_lock);
+}
+
+size_t vidc_buffer_pool::size_class(size_t len)
+{
+    len = (len + VIDC_ION_POOL_PAGE - 1) & ~((size_t)VIDC_ION_POOL_PAGE - 1);
+    if (len <= VIDC_ION_POOL_SMALL)
+        return len;
+
+    size_t step = VIDC_ION_POOL_SMALL / 8;
+    while (step * 16 < len)
+        step <<= 1;
+    return (len + step - 1) & ~(step - 1);
+}
+
+int vidc_buffer_pool::acquire(size_t len, size_t align, unsigned int flags,
+        unsigned int heap_mask, struct vidc_pool_block *blk, int *fd)
+{
+    struct vidc_pool_block want;
+    struct slot *best = NULL;
+
+    if (!len || !blk || !fd) {
+        DEBUG_PRINT_ERROR("Invalid arguments to pool acquire");
+        return -EINVAL;
+    }
+
+    memset(&want, 0, sizeof(want));
+    want.len = len;
+    want.align = align;
+    want.flags = flags;
+    want.heap_mask = heap_mask;
+    want.dev_fd = want.fd = -1;
+
+    bool reuse = m_backend->reusable(want);
+    if (reuse)
+        want.len = size_class(len);
+
+    pthread_mutex_lock(&m_lock);
+    uint64_t now = now_ms();
+    trim_locked(m_max_idle_bytes, now, true);
+
+    if (reuse) {
+        size_t max_len = want.len + want.len / 4;
+        for (int i = 0; i < VIDC_ION_POOL_MAX_BLOCKS; i++) {
+            struct slot *s = &m_slots[i];
+            if (s->state != SLOT_IDLE || s->blk.flags != flags ||
+                    s->blk.heap_mask != heap_mask || s->blk.align < align ||
+                    s->blk.len < want.len || s->blk.len > max_len)
+                continue;
+            if (!best || s->blk.len < best->blk.len ||
+                    (s->blk.len == best->blk.len && s->last_use > best->last_use))
+                best = s;
+        }
+        if (best) {
+            m_stats.hits++;
+            m_stats.idle_blocks--;
+            m_stats.idle_bytes -= best->blk.len;
+        } else {
+            m_stats.misses++;
+        }
+    }
+
+    if (best) {
+        best->state = SLOT_BUSY;
+        best->last_use = now;
+        *blk = best->blk;
+    } else {
+        pthread_mutex_unlock(&m_lock);
+        // Not under the lock, other ports keep recycling meanwhile
+        if (!m_backend->alloc(&want))
+            return -ENOMEM;
+        pthread_mutex_lock(&m_lock);
+        m_stats.allocs++;
+
+        for (int i = 0; i < VIDC_ION_POOL_MAX_BLOCKS && !best; i++) {
+            if (m_slots[i].state == SLOT_UNUSED)
+                best = &m_slots[i];
+        }
+        if (!best) {
+            // Untracked: the caller owns it all and frees it the old way
+            DEBUG_PRINT_HIGH("Pool table full, %zu bytes not pooled", want.len);
+            pthread_mutex_unlock(&m_lock);
+            *blk = want;
+            *fd = want.fd;
+            return want.dev_fd;
+        }
+        best->blk = want;
+        best->state = SLOT_BUSY;
+        best->last_use = now;
+        *blk = want;
+    }
+
+    m_stats.busy_bytes += blk->len;
+    if (m_stats.busy_bytes + m_stats.idle_bytes > m_stats.peak_bytes)
+        m_stats.peak_bytes = m_stats.busy_bytes + m_stats.idle_bytes;
+
+    *fd = dup(blk->fd);
+    if (*fd < 0) {
+        int err = errno;
+        DEBUG_PRINT_ERROR("Failed to dup pooled fd %d, errno %d", blk->fd, err);
+        m_stats.busy_bytes -= blk->len;
+        free_slot_locked(best);
+        pthread_mutex_unlock(&m_lock);
+        return -err;
+    }
+    pthread_mutex_unlock(&m_lock);
+
+    DEBUG_PRINT_LOW("Pool block: len %zu (class %zu) align %zu flags 0x%x -> dev fd %d",
+            len, blk->len, blk->align, flags, blk->dev_fd);
+    return blk->dev_fd;
+}
+
+void vidc_buffer_pool::release(int dev_fd, unsigned long handle)
+{
+    struct slot *s = NULL;
+
+    if (dev_fd < 0)
+        return;
+
+    pthread_mutex_lock(&m_lock);
+    for (int i = 0; i < VIDC_ION_POOL_MAX_BLOCKS && !s; i++) {
+        if (m_slots[i].state == SLOT_BUSY && m_slots[i].blk.dev_fd == dev_fd &&
+                m_slots[i].blk.handle == handle)
+            s = &m_slots[i];
+    }
+
+    if (!s) {
+        pthread_mutex_unlock(&m_lock);
+        struct vidc_pool_block blk;
+        memset(&blk, 0, sizeof(blk));
+        blk.dev_fd = dev_fd;
+        blk.handle = handle;
+        blk.fd = -1;
+        m_backend->free(&blk);
+        return;
+    }
+
+    uint64_t now = now_ms();
+    m_stats.busy_bytes -= s->blk.len;
+    if (m_backend->reusable(s->blk)) {
+        s->state = SLOT_IDLE;
+        s->last_use = now;
+        m_stats.idle_blocks++;
+        m_stats.idle_bytes += s->blk.len;
+    } else {
+        free_slot_locked(s);
+    }
+    trim_locked(m_max_idle_bytes, now, true);
+    pthread_mutex_unlock(&m_lock);
+}
+
+void vidc_buffer_pool::trim(size_t keep_bytes)
+{
+    pthread_mutex_lock(&m_lock);
+    trim_locked(keep_bytes, now_ms(), false);
+    pthread_mutex_unlock(&m_lock);
+}
+
+void vidc_buffer_pool::get_stats(struct vidc_pool_stats *stats)
+{
+    pthread_mutex_lock(&m_lock);
+    *stats = m_stats;
+    pthread_mutex_unlock(&m_lock);
+}
+
+void vidc_buffer_pool::free_slot_locked(struct slot *s)
+{
+    m_backend->free(&s->blk);
+    s->state = SLOT_UNUSED;
+    m_stats.frees++;
+}
+
+void vidc_buffer_pool::trim_locked(size_t keep_bytes, uint64_t now, bool expire)
+{
+    if (expire) {
+        for (int i = 0; i < VIDC_ION_POOL_MAX_BLOCKS && m_stats.idle_blocks; i++) {
+            struct slot *s = &m_slots[i];
+            if (s->state == SLOT_IDLE && now - s->last_use > m_idle_ms) {
+                m_stats.idle_blocks--;
+                m_stats.idle_bytes -= s->blk.len;
+                m_stats.trims++;
+                free_slot_locked(s);
+            }
+        }
+    }
+
+    while (m_stats.idle_bytes > keep_bytes) {
+        struct slot *lru = NULL;
+        for (int i = 0; i < VIDC_ION_POOL_MAX_BLOCKS; i++) {
+            struct slot *s = &m_slots[i];
+            if (s->state == SLOT_IDLE && (!lru || s->last_use < lru->last_use))
+                lru = s;
+        }
+        if (!lru)
+            break;
+        m_stats.idle_blocks--;
+        m_stats.idle_bytes -= lru->blk.len;
+        m_stats.trims++;
+        free_slot_locked(lru);
+    }
+}
@@ -0,0 +1,519 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2015, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+    * Neither the name of The Linux Foundation nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+#define LOG_TAG "OMX_VIDC_LOG"
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <cutils/properties.h>
+#include <utils/Log.h>
+#include "vidc_debug.h"
+
+/* Records in the ring, a power of two */
+#define VIDC_LOG_RING_SIZE 1024
+/* Conversions per message, including '*' widths and precisions */
+#define VIDC_LOG_MAX_ARGS 12
+/* Bytes of %s arguments kept per message, longer strings are truncated */
+#define VIDC_LOG_STR_SIZE 64
+/* Longest formatted line */
+#define VIDC_LOG_LINE_SIZE 1024
+/* How long queued messages may wait when the ring is not filling up */
+#define VIDC_LOG_DRAIN_MS 20
+
+union vidc_log_arg {
+    long long i;
+    double d;
+    const void *p;
+};
+
+/* A message as captured by the caller: the format is kept by pointer, it is
+ * a literal at every call site, the arguments by value. */
+struct vidc_log_record {
+    volatile uint32_t seq;
+    int prio;
+    pid_t tid;
+    const char *tag;
+    const char *fmt;
+    unsigned int nargs;
+    union vidc_log_arg args[VIDC_LOG_MAX_ARGS];
+    char str[VIDC_LOG_STR_SIZE];
+};
+
+enum {
+    LEN_NONE,
+    LEN_HH,
+    LEN_H,
+    LEN_L,
+    LEN_LL,
+    LEN_J,
+    LEN_Z,
+    LEN_T,
+    LEN_BIG_L,
+};
+
+/* One conversion of a printf format */
+struct fmt_spec {
+    const char *start;
+    size_t len;
+    int length;
+    int stars;
+    char conv;
+};
+
+static struct vidc_log_record *ring;
+static volatile uint32_t ring_head;
+static volatile uint32_t ring_tail;
+static volatile uint32_t ring_dropped;
+static volatile bool async_enabled;
+static pthread_mutex_t drain_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t wake_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wake_cond = PTHREAD_COND_INITIALIZER;
+static pthread_once_t init_once = PTHREAD_ONCE_INIT;
+
+/* Finds the next conversion at or after p, returns NULL at the end */
+static const char *next_spec(const char *p, struct fmt_spec *spec)
+{
+    const char *q;
+
+    p = strchr(p, '%');
+    if (!p)
+        return NULL;
+    q = p + 1;
+    spec->start = p;
+    spec->stars = 0;
+    spec->length = LEN_NONE;
+    while (*q && strchr("-+ #0'", *q))
+        q++;
+    if (*q == '*') {
+        spec->stars++;
+        q++;
+    }
+    while (*q >= '0' && *q <= '9')
+        q++;
+    if (*q == '.') {
+        q++;
+        if (*q == '*') {
+            spec->stars++;
+            q++;
+        }
+        while (*q >= '0' && *q <= '9')
+            q++;
+    }
+    switch (*q) {
+        case 'h':
+            spec->length = (q[1] == 'h') ? LEN_HH : LEN_H;
+            q += (q[1] == 'h') ? 2 : 1;
+            break;
+        case 'l':
+            spec->length = (q[1] == 'l') ? LEN_LL : LEN_L;
+            q += (q[1] == 'l') ? 2 : 1;
+            break;
+        case 'q':
+            spec->length = LEN_LL;
+            q++;
+            break;
+        case 'j':
+            spec->length = LEN_J;
+            q++;
+            break;
+        case 'z':
+            spec->length = LEN_Z;
+            q++;
+            break;
+        case 't':
+            spec->length = LEN_T;
+            q++;
+            break;
+        case 'L':
+            spec->length = LEN_BIG_L;
+            q++;
+            break;
+    }
+    spec->conv = *q;
+    if (*q)
+        q++;
+    spec->len = q - p;
+    return q;
+}
+
+static bool is_signed_conv(char conv)
+{
+    return conv == 'd' || conv == 'i';
+}
+
+static bool is_int_conv(char conv)
+{
+    return conv && strchr("diouxXc", conv);
+}
+
+static bool is_float_conv(char conv)
+{
+    return conv && strchr("eEfFgGaA", conv);
+}
+
+/* Copies the arguments the format consumes into r, false if it needs more
+ * room than a record has or uses a conversion the formatter does not know */
+static bool capture(struct vidc_log_record *r, const char *fmt, va_list ap)
+{
+    struct fmt_spec spec;
+    size_t str_used = 0;
+    const char *p = fmt;
+
+    r->nargs = 0;
+    while ((p = next_spec(p, &spec))) {
+        union vidc_log_arg *arg;
+
+        if (spec.conv == '%')
+            continue;
+        if (r->nargs + spec.stars + 1 > VIDC_LOG_MAX_ARGS)
+            return false;
+        for (int i = 0; i < spec.stars; i++)
+            r->args[r->nargs++].i = va_arg(ap, int);
+        arg = &r->args[r->nargs++];
+        if (is_int_conv(spec.conv)) {
+            bool sign = is_signed_conv(spec.conv);
+            switch (spec.length) {
+                case LEN_L:
+                    arg->i = sign ? (long long)va_arg(ap, long) :
+                        (long long)va_arg(ap, unsigned long);
+                    break;
+                case LEN_LL:
+                case LEN_J:
+                    arg->i = va_arg(ap, long long);
+                    break;
+                case LEN_Z:
+                case LEN_T:
+                    arg->i = sign ? (long long)va_arg(ap, ssize_t) :
+                        (long long)va_arg(ap, size_t);
+                    break;
+                default:
+                    arg->i = sign ? (long long)va_arg(ap, int) :
+                        (long long)va_arg(ap, unsigned int);
+                    break;
+            }
+        } else if (is_float_conv(spec.conv)) {
+            if (spec.length == LEN_BIG_L)
+                arg->d = (double)va_arg(ap, long double);
+            else
+                arg->d = va_arg(ap, double);
+        } else if (spec.conv == 's') {
+            const char *s = va_arg(ap, const char *);
+            size_t len;
+
+            if (!s) {
+                arg->i = -1;
+                continue;
+            }
+            /* Once the space is used up, strings print as empty */
+            if (str_used >= VIDC_LOG_STR_SIZE) {
+                arg->i = VIDC_LOG_STR_SIZE - 1;
+                continue;
+            }
+            len = strnlen(s, VIDC_LOG_STR_SIZE - 1 - str_used);
+            memcpy(r->str + str_used, s, len);
+            r->str[str_used + len] = '\0';
+            arg->i = str_used;
+            str_used += len + 1;
+        } else if (spec.conv == 'p' || spec.conv == 'n') {
+            arg->p = va_arg(ap, const void *);
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Formats one conversion of r into out, star arguments are spelled out */
+static int format_arg(char *out, size_t size, const struct vidc_log_record *r,
+        const struct fmt_spec *spec, unsigned int *next)
+{
+    char conv[32];
+    size_t pos = 0;
+    const union vidc_log_arg *arg;
+
+    if (spec->len + 2 * 11 >= sizeof(conv) || *next + spec->stars >= r->nargs)
+        return 0;
+    for (size_t i = 0; i < spec->len; i++) {
+        char c = spec->start[i];
+        if (c == '*') {
+            int value = (int)r->args[(*next)++].i;
+            /* A negative precision is the same as none */
+            if (value < 0 && pos && conv[pos - 1] == '.')
+                pos--;
+            else
+                pos += snprintf(conv + pos, sizeof(conv) - pos, "%d", value);
+        } else {
+            conv[pos++] = c;
+        }
+    }
+    conv[pos] = '\0';
+    arg = &r->args[(*next)++];
+
+    if (is_int_conv(spec->conv)) {
+        bool sign = is_signed_conv(spec->conv);
+        switch (spec->length) {
+            case LEN_L:
+                return sign ? snprintf(out, size, conv, (long)arg->i) :
+                    snprintf(out, size, conv, (unsigned long)arg->i);
+            case LEN_LL:
+            case LEN_J:
+                return sign ? snprintf(out, size, conv, (long long)arg->i) :
+                    snprintf(out, size, conv, (unsigned long long)arg->i);
+            case LEN_Z:
+            case LEN_T:
+                return sign ? snprintf(out, size, conv, (ssize_t)arg->i) :
+                    snprintf(out, size, conv, (size_t)arg->i);
+            default:
+                return sign ? snprintf(out, size, conv, (int)arg->i) :
+                    snprintf(out, size, conv, (unsigned int)arg->i);
+        }
+    } else if (is_float_conv(spec->conv)) {
+        if (spec->length == LEN_BIG_L)
+            return snprintf(out, size, conv, (long double)arg->d);
+        return snprintf(out, size, conv, arg->d);
+    } else if (spec->conv == 's') {
+        return snprintf(out, size, conv, arg->i < 0 ? "(null)" : r->str + arg->i);
+    } else if (spec->conv == 'p') {
+        return snprintf(out, size, conv, arg->p);
+    }
+    return 0;
+}
+
+static void format_record(char *line, size_t size, const struct vidc_log_record *r)
+{
+    struct fmt_spec spec;
+    const char *p = r->fmt;
+    const char *q;
+    unsigned int next = 0;
+    size_t pos;
+
+    pos = snprintf(line, size, "[%d] ", r->tid);
+    while (pos < size - 1) {
+        size_t literal;
+
+        q = next_spec(p, &spec);
+        literal = q ? (size_t)(spec.start - p) : strlen(p);
+        if (literal > size - 1 - pos)
+            literal = size - 1 - pos;
+        memcpy(line + pos, p, literal);
+        pos += literal;
+        if (!q)
+            break;
+        if (spec.conv == '%')
+            line[pos++] = '%';
+        else
+            pos += format_arg(line + pos, size - pos, r, &spec, &next);
+        if (pos > size - 1)
+            pos = size - 1;
+        p = q;
+    }
+    line[pos] = '\0';
+}
+
+/* Writes out every published record, callers hold drain_lock */
+static void drain()
+{
+    char line[VIDC_LOG_LINE_SIZE];
+    uint32_t dropped;
+
+    while (ring_tail != ring_head) {
+        struct vidc_log_record *r = &ring[ring_tail & (VIDC_LOG_RING_SIZE - 1)];
+
+        if (r->seq != ring_tail + 1)
+            break;
+        __sync_synchronize();
+        if (r->fmt) {
+            format_record(line, sizeof(line), r);
+            __android_log_write(r->prio, r->tag, line);
+        }
+        __sync_synchronize();
+        ring_tail = ring_tail + 1;
+    }
+    dropped = __sync_fetch_and_and(&ring_dropped, 0);
+    if (dropped)
+        ALOGW("%u debug messages dropped, the log ring was full", dropped);
+}
+
+static void *drain_thread(void *)
+{
+    prctl(PR_SET_NAME, (unsigned long)"VidcLogDrain", 0, 0, 0);
+    while (1) {
+        struct timespec deadline;
+
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += VIDC_LOG_DRAIN_MS * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        pthread_mutex_lock(&wake_lock);
+        pthread_cond_timedwait(&wake_cond, &wake_lock, &deadline);
+        pthread_mutex_unlock(&wake_lock);
+
+        pthread_mutex_lock(&drain_lock);
+        drain();
+        pthread_mutex_unlock(&drain_lock);
+    }
+    return NULL;
+}
+
+static bool start_ring()
+{
+    pthread_t thread;
+    pthread_attr_t attr;
+    bool ret;
+
+    if (ring)
+        return true;
+    ring = (struct vidc_log_record *)calloc(VIDC_LOG_RING_SIZE, sizeof(*ring));
+    if (!ring)
+        return false;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    ret = !pthread_create(&thread, &attr, drain_thread, NULL);
+    pthread_attr_destroy(&attr);
+    if (!ret) {
+        free(ring);
+        ring = NULL;
+    }
+    return ret;
+}
+
+static void init_async()
+{
+    char property_value[PROPERTY_VALUE_MAX] = {0};
+
+    property_get("vidc.debug.log.async", property_value, "0");
+    if (atoi(property_value) && start_ring())
+        async_enabled = true;
+}
+
+/* Queues the message, false if it has to be written synchronously */
+static bool queue(int prio, const char *tag, const char *fmt, va_list ap)
+{
+    struct vidc_log_record *r;
+    uint32_t head;
+    va_list copy;
+    bool ret;
+
+    do {
+        head = ring_head;
+        if (head - ring_tail >= VIDC_LOG_RING_SIZE) {
+            __sync_fetch_and_add(&ring_dropped, 1);
+            return true;
+        }
+    } while (!__sync_bool_compare_and_swap(&ring_head, head, head + 1));
+
+    r = &ring[head & (VIDC_LOG_RING_SIZE - 1)];
+    r->prio = prio;
+    r->tid = (pid_t)syscall(__NR_gettid);
+    r->tag = tag;
+    r->fmt = fmt;
+    va_copy(copy, ap);
+    ret = capture(r, fmt, copy);
+    va_end(copy);
+    /* The slot is claimed either way, an empty one is skipped by the reader */
+    if (!ret)
+        r->fmt = NULL;
+    __sync_synchronize();
+    r->seq = head + 1;
+
+    if (head + 1 - ring_tail == VIDC_LOG_RING_SIZE / 2)
+        pthread_cond_signal(&wake_cond);
+    return ret;
+}
+
+void vidc_log_print(int prio, const char *tag, const char *fmt, ...)
+{
+    va_list ap;
+
+    pthread_once(&init_once, init_async);
+    va_start(ap, fmt);
+    if (async_enabled && prio <= ANDROID_LOG_DEBUG) {
+        if (!queue(prio, tag, fmt, ap))
+            __android_log_vprint(prio, tag, fmt, ap);
+    } else {
+        /* Keep what was queued ahead of a warning or error in order */
+        if (async_enabled)
+            vidc_log_flush();
+        __android_log_vprint(prio, tag, fmt, ap);
+    }
+    va_end(ap);
+}
+
+void vidc_log_set_async(bool enable)
+{
+    pthread_once(&init_once, init_async);
+    pthread_mutex_lock(&drain_lock);
+    if (enable)
+        async_enabled = start_ring();
+    else if (async_enabled) {
+        async_enabled = false;
+        drain();
+    }
+    pthread_mutex_unlock(&drain_lock);
+}
+
+void vidc_log_flush()
+{
+    if (!ring)
+        return;
+    pthread_mutex_lock(&drain_lock);
+    drain();
+    pthread_mutex_unlock(&drain_lock);
+}
+
+/* Racy by design: concurrent callers may let a message or two through the
+ * burst or miscount what they dropped, which is fine for logging. */
+bool vidc_log_ratelimit_pass(struct vidc_log_ratelimit *rl, int prio, const char *tag)
+{
+    struct timespec now;
+    uint32_t now_ms;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    now_ms = (uint32_t)(now.tv_sec * 1000 + now.tv_nsec / 1000000);
+    if (!rl->window || now_ms - rl->window >= VIDC_LOG_RATELIMIT_INTERVAL_MS) {
+        if (rl->suppressed)
+            vidc_log_print(prio, tag, "%u similar messages suppressed", rl->suppressed);
+        rl->window = now_ms ? now_ms : 1;
+        rl->printed = 0;
+        rl->suppressed = 0;
+    }
+    if (rl->printed < VIDC_LOG_RATELIMIT_BURST) {
+        rl->printed++;
+        return true;
+    }
+    rl->suppressed++;
+    return false;
+}
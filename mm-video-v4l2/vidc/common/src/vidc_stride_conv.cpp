@@ -0,0 +1,260 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2015, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+    * Neither the name of The Linux Foundation nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+#define LOG_TAG "OMX_VIDC_STRIDE"
+
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <utils/Log.h>
+#include "vidc_stride_conv.h"
+#include "vidc_debug.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define VIDC_STRIDE_CONV_SSE2
+#endif
+
+/* Fewer rows than this per band are not worth a thread wakeup */
+#define VIDC_STRIDE_CONV_MIN_BAND_ROWS 64
+/* Smaller pictures are still in the caches when the hardware reads them */
+#define VIDC_STRIDE_CONV_STREAM_MIN (8 * 1024 * 1024)
+
+/* Only whole cache lines are streamed, a row that ends inside a line would
+ * have the tail store fight the write combining buffer. bionic's memcpy is
+ * already tuned for the ARM cores, so this is x86 only. */
+static inline void copy_row(OMX_U8 *dst, const OMX_U8 *src, size_t n, bool stream)
+{
+#if defined(VIDC_STRIDE_CONV_SSE2)
+    if (stream && !((uintptr_t)dst & 63) && !(n & 63)) {
+        for (; n; n -= 64, src += 64, dst += 64) {
+            __m128i a = _mm_loadu_si128((const __m128i *)src);
+            __m128i b = _mm_loadu_si128((const __m128i *)(src + 16));
+            __m128i c = _mm_loadu_si128((const __m128i *)(src + 32));
+            __m128i d = _mm_loadu_si128((const __m128i *)(src + 48));
+            _mm_stream_si128((__m128i *)dst, a);
+            _mm_stream_si128((__m128i *)(dst + 16), b);
+            _mm_stream_si128((__m128i *)(dst + 32), c);
+            _mm_stream_si128((__m128i *)(dst + 48), d);
+        }
+    }
+#else
+    (void)stream;
+#endif
+    memcpy(dst, src, n);
+}
+
+/* Moves rows inside one buffer, dst must not be below src */
+static void move_plane(OMX_U8 *dst, OMX_U32 dst_stride, const OMX_U8 *src,
+        OMX_U32 src_stride, OMX_U32 row_bytes, OMX_U32 rows)
+{
+    if (!rows || (dst == src && dst_stride == src_stride))
+        return;
+    if (dst_stride == src_stride) {
+        memmove(dst, src, (size_t)(rows - 1) * src_stride + row_bytes);
+        return;
+    }
+    for (OMX_U32 row = rows; row-- > 0;)
+        memmove(dst + (size_t)row * dst_stride, src + (size_t)row * src_stride, row_bytes);
+}
+
+static bool layout_fits(OMX_U32 width, OMX_U32 height,
+        const struct vidc_nv12_layout &layout)
+{
+    return width && height && width <= layout.y_stride && width <= layout.uv_stride &&
+        height <= layout.y_scanlines && height / 2 <= layout.uv_scanlines;
+}
+
+vidc_stride_conv::vidc_stride_conv(unsigned int threads)
+    : m_num_workers(0), m_generation(0), m_pending(0), m_exit(false),
+      m_src(NULL), m_dst(NULL), m_width(0), m_height(0),
+      m_num_bands(1), m_band_rows(0), m_stream(false)
+{
+    memset(&m_layout, 0, sizeof(m_layout));
+    pthread_mutex_init(&m_lock, NULL);
+    pthread_cond_init(&m_start_cond, NULL);
+    pthread_cond_init(&m_done_cond, NULL);
+
+    if (!threads) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cores < 1 ? 1 : (unsigned int)cores;
+    }
+    if (threads > VIDC_STRIDE_CONV_MAX_THREADS)
+        threads = VIDC_STRIDE_CONV_MAX_THREADS;
+
+    for (unsigned int i = 0; i + 1 < threads; i++) {
+        m_workers[i].conv = this;
+        m_workers[i].band = i + 1;
+        if (pthread_create(&m_workers[i].thread, NULL, worker_thread, &m_workers[i])) {
+            DEBUG_PRINT_ERROR("Failed to start stride worker %u, using %u threads", i, i + 1);
+            break;
+        }
+        m_num_workers++;
+    }
+}
+
+vidc_stride_conv::~vidc_stride_conv()
+{
+    pthread_mutex_lock(&m_lock);
+    m_exit = true;
+    pthread_cond_broadcast(&m_start_cond);
+    pthread_mutex_unlock(&m_lock);
+    for (unsigned int i = 0; i < m_num_workers; i++)
+        pthread_join(m_workers[i].thread, NULL);
+    pthread_cond_destroy(&m_done_cond);
+    pthread_cond_destroy(&m_start_cond);
+    pthread_mutex_destroy(&m_lock);
+}
+
+size_t vidc_stride_conv::buffer_size(const struct vidc_nv12_layout &layout)
+{
+    return (size_t)layout.y_stride * layout.y_scanlines +
+        (size_t)layout.uv_stride * layout.uv_scanlines;
+}
+
+void *vidc_stride_conv::worker_thread(void *arg)
+{
+    struct worker *w = (struct worker *)arg;
+    vidc_stride_conv *conv = w->conv;
+    unsigned int seen = 0;
+
+    pthread_mutex_lock(&conv->m_lock);
+    for (;;) {
+        while (conv->m_generation == seen && !conv->m_exit)
+            pthread_cond_wait(&conv->m_start_cond, &conv->m_lock);
+        if (conv->m_exit)
+            break;
+        seen = conv->m_generation;
+        pthread_mutex_unlock(&conv->m_lock);
+
+        conv->copy_band(w->band);
+
+        pthread_mutex_lock(&conv->m_lock);
+        if (--conv->m_pending == 0)
+            pthread_cond_signal(&conv->m_done_cond);
+    }
+    pthread_mutex_unlock(&conv->m_lock);
+    return NULL;
+}
+
+void vidc_stride_conv::copy_band(unsigned int band)
+{
+    OMX_U32 rows = m_height + m_height / 2;
+    OMX_U32 first, last;
+    const OMX_U8 *src_uv = m_src + (size_t)m_width * m_height;
+    OMX_U8 *dst_uv = m_dst + (size_t)m_layout.y_stride * m_layout.y_scanlines;
+
+    if (band >= m_num_bands)
+        return;
+    first = band * m_band_rows;
+    last = first + m_band_rows < rows ? first + m_band_rows : rows;
+
+    for (OMX_U32 row = first; row < last && row < m_height; row++)
+        copy_row(m_dst + (size_t)row * m_layout.y_stride,
+                m_src + (size_t)row * m_width, m_width, m_stream);
+    for (OMX_U32 row = first > m_height ? first : m_height; row < last; row++)
+        copy_row(dst_uv + (size_t)(row - m_height) * m_layout.uv_stride,
+                src_uv + (size_t)(row - m_height) * m_width, m_width, m_stream);
+#if defined(VIDC_STRIDE_CONV_SSE2)
+    if (m_stream)
+        _mm_sfence();
+#endif
+}
+
+bool vidc_stride_conv::align(const OMX_U8 *src, OMX_U8 *dst, size_t dst_len,
+        OMX_U32 width, OMX_U32 height, const struct vidc_nv12_layout &layout)
+{
+    size_t src_len = (size_t)width * height + (size_t)width * (height / 2);
+    OMX_U32 rows = height + height / 2;
+    unsigned int bands;
+
+    if (!src || !dst || !layout_fits(width, height, layout) ||
+            dst_len < buffer_size(layout)) {
+        DEBUG_PRINT_ERROR("Cannot align %ux%u into %zu bytes (%ux%u/%ux%u)",
+                (unsigned int)width, (unsigned int)height, dst_len,
+                (unsigned int)layout.y_stride, (unsigned int)layout.y_scanlines,
+                (unsigned int)layout.uv_stride, (unsigned int)layout.uv_scanlines);
+        return false;
+    }
+    if (src < dst + dst_len && dst < src + src_len) {
+        DEBUG_PRINT_ERROR("Overlapping buffers, use align_in_place");
+        return false;
+    }
+
+    bands = rows / VIDC_STRIDE_CONV_MIN_BAND_ROWS;
+    if (bands > m_num_workers + 1)
+        bands = m_num_workers + 1;
+    if (!bands)
+        bands = 1;
+
+    m_src = src;
+    m_dst = dst;
+    m_width = width;
+    m_height = height;
+    m_layout = layout;
+    m_num_bands = bands;
+    m_band_rows = (rows + bands - 1) / bands;
+    m_stream = src_len >= VIDC_STRIDE_CONV_STREAM_MIN;
+
+    if (bands == 1) {
+        copy_band(0);
+        return true;
+    }
+
+    pthread_mutex_lock(&m_lock);
+    m_pending = m_num_workers;
+    m_generation++;
+    pthread_cond_broadcast(&m_start_cond);
+    pthread_mutex_unlock(&m_lock);
+
+    copy_band(0);
+
+    pthread_mutex_lock(&m_lock);
+    while (m_pending)
+        pthread_cond_wait(&m_done_cond, &m_lock);
+    pthread_mutex_unlock(&m_lock);
+    return true;
+}
+
+bool vidc_stride_conv::align_in_place(OMX_U8 *buf, size_t len,
+        OMX_U32 width, OMX_U32 height, const struct vidc_nv12_layout &layout)
+{
+    if (!buf || !layout_fits(width, height, layout) || len < buffer_size(layout)) {
+        DEBUG_PRINT_ERROR("Cannot align %ux%u in place in %zu bytes (%ux%u/%ux%u)",
+                (unsigned int)width, (unsigned int)height, len,
+                (unsigned int)layout.y_stride, (unsigned int)layout.y_scanlines,
+                (unsigned int)layout.uv_stride, (unsigned int)layout.uv_scanlines);
+        return false;
+    }
+
+    /* Chroma first, the luma moves over its source */
+    move_plane(buf + (size_t)layout.y_stride * layout.y_scanlines, layout.uv_stride,
+            buf + (size_t)width * height, width, width, height / 2);
+    move_plane(buf, layout.y_stride, buf, width, width, height);
+    return true;
+}
@@ -0,0 +1,216 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2015, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+    * Neither the name of The Linux Foundation nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+#define LOG_TAG "OMX_VIDC_TRACE"
+
+#include <stdio.h>
+#include <utils/Log.h>
+#include "vidc_trace.h"
+#include "vidc_debug.h"
+
+/* How far back a stage looks for the start of its span */
+#define VIDC_TRACE_MATCH_WINDOW 1024
+
+static const char *const stage_names[VIDC_TRACE_STAGE_MAX] = {
+    "ETB", "ETB proxy", "QBUF in", "DQBUF in", "EBD",
+    "FTB", "QBUF out", "DQBUF out", "FBD",
+};
+
+/*
+ * Input side spans follow the buffer index, except across the message
+ * thread to QBUF hop where arbitrary bytes mode may repack the data into
+ * another buffer. Spans that cross from input to output follow the frame
+ * timestamp.
+ */
+static const struct {
+    const char *name;
+    vidc_trace_stage from, to;
+    bool by_timestamp;
+} spans[] = {
+    { "ETB->proxy",          VIDC_TRACE_ETB,       VIDC_TRACE_ETB_PROXY, false },
+    { "proxy->QBUF in",      VIDC_TRACE_ETB_PROXY, VIDC_TRACE_QBUF_IN,   true  },
+    { "QBUF->DQBUF in",      VIDC_TRACE_QBUF_IN,   VIDC_TRACE_DQBUF_IN,  false },
+    { "DQBUF in->EBD",       VIDC_TRACE_DQBUF_IN,  VIDC_TRACE_EBD,       false },
+    { "FTB->QBUF out",       VIDC_TRACE_FTB,       VIDC_TRACE_QBUF_OUT,  false },
+    { "QBUF in->DQBUF out",  VIDC_TRACE_QBUF_IN,   VIDC_TRACE_DQBUF_OUT, true  },
+    { "DQBUF out->FBD",      VIDC_TRACE_DQBUF_OUT, VIDC_TRACE_FBD,       false },
+    { "ETB->FBD",            VIDC_TRACE_ETB,       VIDC_TRACE_FBD,       true  },
+};
+
+bool vidc_trace::init(unsigned int size)
+{
+    unsigned int count = 1;
+
+    free(m_ring);
+    m_ring = NULL;
+    m_next = 0;
+    if (!size)
+        return true;
+    if (size == 1)
+        size = VIDC_TRACE_DEFAULT_SIZE;
+    while (count < size && count < (1U << 20))
+        count <<= 1;
+    m_ring = (vidc_trace_record *)calloc(count, sizeof(*m_ring));
+    if (!m_ring)
+        return false;
+    m_mask = count - 1;
+    return true;
+}
+
+size_t vidc_trace::snapshot(vidc_trace_record *out) const
+{
+    uint32_t next = m_next, size = m_mask + 1;
+    uint32_t start = next > size ? next - size : 0;
+    size_t count = 0;
+
+    for (uint32_t idx = start; idx != next; idx++) {
+        const vidc_trace_record *r = &m_ring[idx & m_mask];
+        if (r->seq != idx + 1)
+            continue;
+        out[count] = *r;
+        __sync_synchronize();
+        /* Overwritten while copying */
+        if (r->seq != idx + 1 || out[count].seq != idx + 1)
+            continue;
+        count++;
+    }
+    return count;
+}
+
+static int compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+size_t vidc_trace::summarize(vidc_trace_span_stats *stats, size_t max) const
+{
+    vidc_trace_record *records;
+    double *deltas;
+    size_t count, filled = 0;
+
+    if (!m_ring)
+        return 0;
+    records = (vidc_trace_record *)malloc((m_mask + 1) * sizeof(*records));
+    deltas = (double *)malloc((m_mask + 1) * sizeof(*deltas));
+    if (!records || !deltas) {
+        free(records);
+        free(deltas);
+        return 0;
+    }
+    count = snapshot(records);
+
+    for (size_t s = 0; s < sizeof(spans) / sizeof(spans[0]) && filled < max; s++) {
+        unsigned int n = 0;
+
+        for (size_t j = 0; j < count; j++) {
+            const vidc_trace_record *to = &records[j];
+            if (to->stage != (uint32_t)spans[s].to)
+                continue;
+            size_t stop = j > VIDC_TRACE_MATCH_WINDOW ? j - VIDC_TRACE_MATCH_WINDOW : 0;
+            for (size_t i = j; i-- > stop;) {
+                const vidc_trace_record *from = &records[i];
+                if (from->stage != (uint32_t)spans[s].from)
+                    continue;
+                if (spans[s].by_timestamp ? from->timestamp != to->timestamp :
+                        from->buffer != to->buffer)
+                    continue;
+                if (to->time_ns >= from->time_ns)
+                    deltas[n++] = (to->time_ns - from->time_ns) / 1000.0;
+                break;
+            }
+        }
+        if (!n)
+            continue;
+        qsort(deltas, n, sizeof(*deltas), compare_double);
+        stats[filled].name = spans[s].name;
+        stats[filled].count = n;
+        stats[filled].p50 = deltas[(n - 1) / 2];
+        stats[filled].p99 = deltas[(size_t)((n - 1) * 0.99)];
+        stats[filled].max = deltas[n - 1];
+        filled++;
+    }
+    free(records);
+    free(deltas);
+    return filled;
+}
+
+void vidc_trace::log_summary(const char *name) const
+{
+    vidc_trace_span_stats stats[sizeof(spans) / sizeof(spans[0])];
+    size_t count = summarize(stats, sizeof(stats) / sizeof(stats[0]));
+
+    for (size_t i = 0; i < count; i++)
+        DEBUG_PRINT_INFO("%s trace %-20s n=%-6u p50=%9.1fus p99=%9.1fus max=%9.1fus",
+                name, stats[i].name, stats[i].count, stats[i].p50, stats[i].p99,
+                stats[i].max);
+}
+
+bool vidc_trace::dump(const char *path, const char *name) const
+{
+    vidc_trace_record *records;
+    size_t count;
+    FILE *file;
+    int pid = getpid();
+
+    if (!m_ring)
+        return false;
+    records = (vidc_trace_record *)malloc((m_mask + 1) * sizeof(*records));
+    if (!records)
+        return false;
+    file = fopen(path, "w");
+    if (!file) {
+        DEBUG_PRINT_ERROR("Failed to open trace file %s", path);
+        free(records);
+        return false;
+    }
+    count = snapshot(records);
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"%s\"}}",
+            pid, name);
+    for (size_t i = 0; i < count; i++) {
+        const vidc_trace_record *r = &records[i];
+        double ts = r->time_ns / 1000.0;
+
+        fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"vidc\",\"ph\":\"i\",\"s\":\"t\","
+                "\"ts\":%.3f,\"pid\":%d,\"tid\":%u,\"args\":{\"buffer\":%u,\"timestamp\":%lld}}",
+                stage_names[r->stage], ts, pid, r->tid, r->buffer, (long long)r->timestamp);
+        /* One async slice per frame from ETB to FBD, keyed by its timestamp */
+        if (r->stage == VIDC_TRACE_ETB || r->stage == VIDC_TRACE_FBD)
+            fprintf(file, ",\n{\"name\":\"frame\",\"cat\":\"frame\",\"ph\":\"%s\",\"id\":\"%lld\","
+                    "\"ts\":%.3f,\"pid\":%d,\"tid\":%u}",
+                    r->stage == VIDC_TRACE_ETB ? "b" : "e", (long long)r->timestamp,
+                    ts, pid, r->tid);
+    }
+    fprintf(file, "\n]}\n");
+    fclose(file);
+    free(records);
+    DEBUG_PRINT_INFO("%s trace: %u records written to %s", name, (unsigned int)count, path);
+    return true;
+}
@@ -12,3 +12,368 @@ LOCAL_CFLAGS                  := -DLOG_TAG=\"MSM-VIDC-TEST\"
 LOCAL_MODULE_TAGS             := optional
 LOCAL_32_BIT_ONLY             := true
 include $(BUILD_EXECUTABLE)
+
+# ---------------------------------------------------------------------------------
+# 			Make the decoder input path benchmark (vdec-parse-bench)
+# ---------------------------------------------------------------------------------
+
+vdec-parse-bench-inc          := $(LOCAL_PATH)/../vdec/inc
+vdec-parse-bench-inc          += $(LOCAL_PATH)/../common/inc
+vdec-parse-bench-inc          += $(call project-path-for,qcom-media)/mm-core/inc
+vdec-parse-bench-def          := -DLOG_TAG=\"VDEC-PARSE-BENCH\"
+vdec-parse-bench-def          += -D_ANDROID_
+vdec-parse-bench-def          += -D_MSM8974_
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE                  := vdec-parse-bench
+LOCAL_C_INCLUDES              := $(vdec-parse-bench-inc)
+LOCAL_SRC_FILES               := vdec_parse_bench.cpp
+LOCAL_SRC_FILES               += ../common/src/vidc_log.cpp
+LOCAL_CFLAGS                  := $(vdec-parse-bench-def)
+LOCAL_STATIC_LIBRARIES        := libOmxVdecAuAssembler
+LOCAL_SHARED_LIBRARIES        := liblog libcutils
+LOCAL_MODULE_TAGS             := optional
+LOCAL_32_BIT_ONLY             := true
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE                  := vdec-parse-bench
+LOCAL_C_INCLUDES              := $(vdec-parse-bench-inc)
+LOCAL_SRC_FILES               := vdec_parse_bench.cpp
+LOCAL_SRC_FILES               += ../common/src/vidc_log.cpp
+LOCAL_CFLAGS                  := $(vdec-parse-bench-def)
+LOCAL_STATIC_LIBRARIES        := libOmxVdecAuAssembler
+LOCAL_SHARED_LIBRARIES        := liblog libcutils
+LOCAL_MODULE_TAGS             := optional
+include $(BUILD_HOST_EXECUTABLE)
+
+# ---------------------------------------------------------------------------------
+# 			Make the AU assembly replay test (vdec-au-replay-test)
+# ---------------------------------------------------------------------------------
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE                  := vdec-au-replay-test
+LOCAL_C_INCLUDES              := $(vdec-parse-bench-inc)
+LOCAL_SRC_FILES               := vdec_au_replay_test.cpp
+LOCAL_SRC_FILES               += ../common/src/vidc_log.cpp
+LOCAL_CFLAGS                  := $(vdec-parse-bench-def)
+LOCAL_STATIC_LIBRARIES        := libOmxVdecAuAssembler
+LOCAL_SHARED_LIBRARIES        := liblog libcutils
+LOCAL_MODULE_TAGS             := optional
+LOCAL_32_BIT_ONLY             := true
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE                  := vdec-au-replay-test
+LOCAL_C_INCLUDES              := $(vdec-parse-bench-inc)
+LOCAL_SRC_FILES               := vdec_au_replay_test.cpp
+LOCAL_SRC_FILES               += ../common/src/vidc_log.cpp
+LOCAL_CFLAGS                  := $(vdec-parse-bench-def)
+LOCAL_STATIC_LIBRARIES        := libOmxVdecAuAssembler
+LOCAL_SHARED_LIBRARIES        := liblog libcutils
+LOCAL_MODULE_TAGS             := optional
+include $(BUILD_HOST_EXECUTABLE)
+
+# ---------------------------------------------------------------------------------
+# 			Make the extradata writer test (vdec-extradata-writer-test)
+# ---------------------------------------------------------------------------------
+
+vdec-extradata-writer-test-inc := $(LOCAL_PATH)/../vdec/inc
+vdec-extradata-writer-test-inc += $(call project-path-for,qcom-media)/mm-core/inc
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE                  := vdec-extradata-writer-test
+LOCAL_C_INCLUDES              := $(vdec-extradata-writer-test-inc)
+LOCAL_SRC_FILES               := vdec_extradata_writer_test.cpp
+LOCAL_CFLAGS                  := -D_ANDROID_
+LOCAL_MODULE_TAGS             := optional
+LOCAL_32_BIT_ONLY             := true
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE                  := vdec-extradata-writer-test
+LOCAL_C_INCLUDES              := $(vdec-extradata-writer-test-inc)
+LOCAL_SRC_FILES               := vdec_extradata_writer_test.cpp
+LOCAL_CFLAGS                  := -D_ANDROID_
+LOCAL_MODULE_TAGS             := optional
+include $(BUILD_HOST_EXECUTABLE)
+
+# ---------------------------------------------------------------------------------
+# 			Make the timestamp reorder benchmark (vidc-ts-bench)
+# ---------------------------------------------------------------------------------
+
+vidc-ts-bench-inc             := $(LOCAL_PATH)/../common/inc
+vidc-ts-bench-inc             += $(call project-path-for,qcom-media)/mm-core/inc
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE                  := vidc-ts-bench
+LOCAL_C_INCLUDES              := $(vidc-ts-bench-inc)
+LOCAL_SRC_FILES               := vidc_ts_bench.cpp
+LOCAL_MODULE_TAGS             := optional
+LOCAL_32_BIT_ONLY             := true
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE                  := vidc-ts-bench
+LOCAL_C_INCLUDES              := $(vidc-ts-bench-inc)
+LOCAL_SRC_FILES               := vidc_ts_bench.cpp
+LOCAL_MODULE_TAGS             := optional
+include $(BUILD_HOST_EXECUTABLE)
+
+# ---------------------------------------------------------------------------------
+# 			Make the message dispatch benchmark (vidc-msg-bench)
+# ---------------------------------------------------------------------------------
+
+vidc-msg-bench-inc            := $(LOCAL_PATH)/../common/inc
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE                  := vidc-msg-bench
+LOCAL_C_INCLUDES              := $(vidc-msg-bench-inc)
+LOCAL_SRC_FILES               := vidc_msg_bench.cpp
+LOCAL_MODULE_TAGS             := optional
+LOCAL_32_BIT_ONLY             := true
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE                  := vidc-msg-bench
+LOCAL_C_INCLUDES              := $(vidc-msg-bench-inc)
+LOCAL_SRC_FILES               := vidc_msg_bench.cpp
+LOCAL_MODULE_TAGS             := optional
+LOCAL_LDLIBS                  := -lpthread
+include $(BUILD_HOST_EXECUTABLE)
+
+# ---------------------------------------------------------------------------------
+# 			Make the CPU color conversion benchmark (vidc-cc-bench)
+# ---------------------------------------------------------------------------------
+
+vidc-cc-bench-inc             := $(call project-path-for,qcom-media)/libc2dcolorconvert
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE                  := vidc-cc-bench
+LOCAL_C_INCLUDES              := $(vidc-cc-bench-inc)
+LOCAL_C_INCLUDES              += $(TARGET_OUT_HEADERS)/qcom/display
+LOCAL_SRC_FILES               := vidc_cc_bench.cpp
+LOCAL_SHARED_LIBRARIES        := libc2dcolorconvert
+LOCAL_MODULE_TAGS             := optional
+LOCAL_32_BIT_ONLY             := true
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE                  := vidc-cc-bench
+LOCAL_C_INCLUDES              := $(vidc-cc-bench-inc)
+LOCAL_SRC_FILES               := vidc_cc_bench.cpp
+LOCAL_CFLAGS                  := -DC2D_CPU_ONLY
+LOCAL_STATIC_LIBRARIES        := libc2dcolorconvert_cpu
+LOCAL_SHARED_LIBRARIES        := liblog
+LOCAL_MODULE_TAGS             := optional
+LOCAL_LDLIBS                  := -lpthread -lm
+include $(BUILD_HOST_EXECUTABLE)
+
+# ---------------------------------------------------------------------------------
+# 			Make the C2D mapping cache benchmark (vidc-c2d-map-bench)
+# ---------------------------------------------------------------------------------
+
+vidc-c2d-map-bench-inc        := $(call project-path-for,qcom-media)/libc2dcolorconvert
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE                  := vidc-c2d-map-bench
+LOCAL_C_INCLUDES              := $(vidc-c2d-map-bench-inc)
+LOCAL_SRC_FILES               := vidc_c2d_map_bench.cpp
+LOCAL_CFLAGS                  := -DC2D_CPU_ONLY
+LOCAL_MODULE_TAGS             := optional
+LOCAL_32_BIT_ONLY             := true
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE                  := vidc-c2d-map-bench
+LOCAL_C_INCLUDES              := $(vidc-c2d-map-bench-inc)
+LOCAL_SRC_FILES               := vidc_c2d_map_bench.cpp
+LOCAL_CFLAGS                  := -DC2D_CPU_ONLY
+LOCAL_MODULE_TAGS             := optional
+include $(BUILD_HOST_EXECUTABLE)
+
+# ---------------------------------------------------------------------------------
+# 			Make the NV12 stride conversion benchmark (vidc-stride-bench)
+# ---------------------------------------------------------------------------------
+
+vidc-stride-bench-inc         := $(LOCAL_PATH)/../common/inc
+vidc-stride-bench-inc         += $(call project-path-for,qcom-media)/mm-core/inc
+vidc-stride-bench-inc         += $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr/include
+vidc-stride-bench-def         := -D_ANDROID_
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE                  := vidc-stride-bench
+LOCAL_C_INCLUDES              := $(vidc-stride-bench-inc)
+LOCAL_ADDITIONAL_DEPENDENCIES := $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr
+LOCAL_SRC_FILES               := vidc_stride_bench.cpp
+LOCAL_SRC_FILES               += ../common/src/vidc_stride_conv.cpp
+LOCAL_SRC_FILES               += ../common/src/vidc_log.cpp
+LOCAL_CFLAGS                  := $(vidc-stride-bench-def)
+LOCAL_SHARED_LIBRARIES        := liblog libcutils
+LOCAL_MODULE_TAGS             := optional
+LOCAL_32_BIT_ONLY             := true
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE                  := vidc-stride-bench
+LOCAL_C_INCLUDES              := $(vidc-stride-bench-inc)
+LOCAL_ADDITIONAL_DEPENDENCIES := $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr
+LOCAL_SRC_FILES               := vidc_stride_bench.cpp
+LOCAL_SRC_FILES               += ../common/src/vidc_stride_conv.cpp
+LOCAL_SRC_FILES               += ../common/src/vidc_log.cpp
+LOCAL_CFLAGS                  := $(vidc-stride-bench-def)
+LOCAL_SHARED_LIBRARIES        := liblog libcutils
+LOCAL_MODULE_TAGS             := optional
+LOCAL_LDLIBS                  := -lpthread
+include $(BUILD_HOST_EXECUTABLE)
+
+# ---------------------------------------------------------------------------------
+# 			Make the buffer pool benchmark (vidc-ion-pool-bench)
+# ---------------------------------------------------------------------------------
+
+vidc-ion-pool-bench-inc       := $(LOCAL_PATH)/../common/inc
+vidc-ion-pool-bench-inc       += $(call project-path-for,qcom-media)/mm-core/inc
+vidc-ion-pool-bench-inc       += $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr/include
+vidc-ion-pool-bench-def       := -D_ANDROID_
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE                  := vidc-ion-pool-bench
+LOCAL_C_INCLUDES              := $(vidc-ion-pool-bench-inc)
+LOCAL_ADDITIONAL_DEPENDENCIES := $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr
+LOCAL_SRC_FILES               := vidc_ion_pool_bench.cpp
+LOCAL_SRC_FILES               += ../common/src/vidc_ion_pool.cpp
+LOCAL_SRC_FILES               += ../common/src/vidc_log.cpp
+LOCAL_CFLAGS                  := $(vidc-ion-pool-bench-def)
+LOCAL_SHARED_LIBRARIES        := liblog libcutils
+LOCAL_MODULE_TAGS             := optional
+LOCAL_32_BIT_ONLY             := true
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE                  := vidc-ion-pool-bench
+LOCAL_C_INCLUDES              := $(vidc-ion-pool-bench-inc)
+LOCAL_ADDITIONAL_DEPENDENCIES := $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr
+LOCAL_SRC_FILES               := vidc_ion_pool_bench.cpp
+LOCAL_SRC_FILES               += ../common/src/vidc_ion_pool.cpp
+LOCAL_SRC_FILES               += ../common/src/vidc_log.cpp
+LOCAL_CFLAGS                  := $(vidc-ion-pool-bench-def)
+LOCAL_SHARED_LIBRARIES        := liblog libcutils
+LOCAL_MODULE_TAGS             := optional
+LOCAL_LDLIBS                  := -lpthread
+include $(BUILD_HOST_EXECUTABLE)
+
+# ---------------------------------------------------------------------------------
+# 			Make the header bit reader benchmark (vidc-bit-reader-bench)
+# ---------------------------------------------------------------------------------
+
+vidc-bit-reader-bench-inc     := $(LOCAL_PATH)/../common/inc
+vidc-bit-reader-bench-def     := -D_ANDROID_
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE                  := vidc-bit-reader-bench
+LOCAL_C_INCLUDES              := $(vidc-bit-reader-bench-inc)
+LOCAL_SRC_FILES               := vidc_bit_reader_bench.cpp
+LOCAL_CFLAGS                  := $(vidc-bit-reader-bench-def)
+LOCAL_MODULE_TAGS             := optional
+LOCAL_32_BIT_ONLY             := true
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE                  := vidc-bit-reader-bench
+LOCAL_C_INCLUDES              := $(vidc-bit-reader-bench-inc)
+LOCAL_SRC_FILES               := vidc_bit_reader_bench.cpp
+LOCAL_CFLAGS                  := $(vidc-bit-reader-bench-def)
+LOCAL_MODULE_TAGS             := optional
+include $(BUILD_HOST_EXECUTABLE)
+
+# ---------------------------------------------------------------------------------
+# 			Make the parameter set map benchmark (vidc-map-bench)
+# ---------------------------------------------------------------------------------
+
+vidc-map-bench-inc            := $(LOCAL_PATH)/../vdec/inc
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE                  := vidc-map-bench
+LOCAL_C_INCLUDES              := $(vidc-map-bench-inc)
+LOCAL_SRC_FILES               := vidc_map_bench.cpp
+LOCAL_MODULE_TAGS             := optional
+LOCAL_32_BIT_ONLY             := true
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE                  := vidc-map-bench
+LOCAL_C_INCLUDES              := $(vidc-map-bench-inc)
+LOCAL_SRC_FILES               := vidc_map_bench.cpp
+LOCAL_MODULE_TAGS             := optional
+include $(BUILD_HOST_EXECUTABLE)
+
+# ---------------------------------------------------------------------------------
+# 			Make the encoder input mapping cache test (venc-map-cache-test)
+# ---------------------------------------------------------------------------------
+
+venc-map-cache-test-inc       := $(LOCAL_PATH)/../venc/inc
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE                  := venc-map-cache-test
+LOCAL_C_INCLUDES              := $(venc-map-cache-test-inc)
+LOCAL_SRC_FILES               := venc_map_cache_test.cpp
+LOCAL_MODULE_TAGS             := optional
+LOCAL_LDLIBS                  := -lpthread
+include $(BUILD_HOST_EXECUTABLE)
+
+# ---------------------------------------------------------------------------------
+# 			Make the loopback vidc driver for LD_PRELOAD (libvidcfake)
+# ---------------------------------------------------------------------------------
+
+libvidcfake-inc               := $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr/include
+libvidcfake-def               := -U_FORTIFY_SOURCE
+
+ifeq ($(TARGET_BOARD_PLATFORM),apq8084)
+libvidcfake-def               += -DVIDC_FAKE_VPU
+endif
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE                  := libvidcfake
+LOCAL_C_INCLUDES              := $(libvidcfake-inc)
+LOCAL_ADDITIONAL_DEPENDENCIES := $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr
+LOCAL_SRC_FILES               := vidc_fake_driver.cpp
+LOCAL_CFLAGS                  := $(libvidcfake-def)
+LOCAL_SHARED_LIBRARIES        := libdl
+LOCAL_MODULE_TAGS             := optional
+LOCAL_32_BIT_ONLY             := true
+include $(BUILD_SHARED_LIBRARY)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE                  := libvidcfake
+LOCAL_C_INCLUDES              := $(libvidcfake-inc)
+LOCAL_ADDITIONAL_DEPENDENCIES := $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr
+LOCAL_SRC_FILES               := vidc_fake_driver.cpp
+LOCAL_CFLAGS                  := $(libvidcfake-def)
+LOCAL_MODULE_TAGS             := optional
+LOCAL_LDLIBS                  := -ldl -lpthread
+include $(BUILD_HOST_SHARED_LIBRARY)
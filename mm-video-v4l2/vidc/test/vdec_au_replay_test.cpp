@@ -0,0 +1,530 @@
+/*
+ * Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * vdec-au-replay-test: replays an elementary stream through
+ * AccessUnitAssembler with the scratch copy, zero copy, and zero copy with
+ * the held sources released after every push as an input flush does, and
+ * compares the access units byte for byte. Source
+ * buffers are laid out back to back like a client recycling one ring, and
+ * each one is overwritten as soon as it is handed back, so a buffer that
+ * is returned while a pending NAL still points into it shows up as a
+ * mismatch.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <limits.h>
+#include <algorithm>
+#include <vector>
+#include "au_assembler.h"
+#include "vidc_debug.h"
+
+/* Owned by libOmxVidcCommon in the components, which is not linked here */
+int debug_level = PRIO_ERROR;
+
+#define DEFAULT_BUFFER_SIZE (1920*1080*3/2)
+#define DEFAULT_BUFFER_COUNT 8
+#define POISON_BYTE 0xA5
+
+struct replay_args {
+    const char *input_file;
+    codec_type codec;
+    unsigned int nal_length;
+    OMX_U32 buffer_size;
+    OMX_U32 buffer_count;
+    unsigned int seeds;
+};
+
+/* FIX chunk sizes replayed for every stream, then "seeds" ARBITRARY runs */
+static const OMX_U32 fix_chunks[] = { 1, 3, 7, 188, 1000, 4096, 65536 };
+
+/* Assembly paths compared against the scratch copy */
+enum replay_mode {
+    REPLAY_COPY,
+    REPLAY_ZERO_COPY,
+    REPLAY_ZERO_COPY_RELEASE,   /* release_sources() after every push, as a flush would */
+};
+
+struct replay_au {
+    std::vector<OMX_U8> data;
+    OMX_U32 flags;
+};
+
+static const struct {
+    const char *name;
+    codec_type codec;
+} codec_names[] = {
+    { "H.264", CODEC_TYPE_H264 },
+    { "H264",  CODEC_TYPE_H264 },
+    { "HEVC",  CODEC_TYPE_HEVC },
+    { "MPEG4", CODEC_TYPE_MPEG4 },
+    { "H.263", CODEC_TYPE_H263 },
+    { "H263",  CODEC_TYPE_H263 },
+    { "MPEG2", CODEC_TYPE_MPEG2 },
+    { "VC1",   CODEC_TYPE_VC1 },
+};
+
+/* Stands in for omx_vdec: source buffers are consecutive slices of a private
+ * copy of the stream, poisoned when the assembler returns them. */
+class replay_client : public au_assembler_client
+{
+    public:
+        replay_client(const replay_args &args, std::vector<replay_au> &aus);
+        ~replay_client();
+        bool run(const OMX_U8 *stream, OMX_U32 size, replay_mode mode,
+                OMX_U32 fix_bytes, unsigned int seed);
+
+        OMX_ERRORTYPE au_ready(OMX_BUFFERHEADERTYPE *dest);
+        OMX_BUFFERHEADERTYPE *get_free_dest();
+        void return_dest(OMX_BUFFERHEADERTYPE *dest);
+        OMX_BUFFERHEADERTYPE *get_next_source();
+        void source_done(OMX_BUFFERHEADERTYPE *source);
+
+    private:
+        OMX_U32 next_chunk_size();
+        void queue_sources();
+
+        const replay_args &args;
+        std::vector<replay_au> &aus;
+        std::vector<OMX_BUFFERHEADERTYPE> dest_hdrs;
+        std::vector<OMX_BUFFERHEADERTYPE> source_hdrs;
+        std::vector<OMX_BUFFERHEADERTYPE *> free_dests;
+        std::vector<OMX_BUFFERHEADERTYPE *> free_sources;
+        std::vector<OMX_BUFFERHEADERTYPE *> pending_sources;
+        size_t pending_head;
+        std::vector<OMX_U8> stream_copy;
+        OMX_U32 stream_offset;
+        OMX_U32 fix_bytes;
+        OMX_U32 sources_out;
+};
+
+replay_client::replay_client(const replay_args &a, std::vector<replay_au> &au_list):
+    args(a),
+    aus(au_list),
+    pending_head(0),
+    stream_offset(0),
+    fix_bytes(0),
+    sources_out(0)
+{
+    dest_hdrs.resize(args.buffer_count);
+    source_hdrs.resize(args.buffer_count);
+    for (OMX_U32 i = 0; i < args.buffer_count; i++) {
+        memset(&dest_hdrs[i], 0, sizeof(OMX_BUFFERHEADERTYPE));
+        memset(&source_hdrs[i], 0, sizeof(OMX_BUFFERHEADERTYPE));
+        dest_hdrs[i].nAllocLen = args.buffer_size;
+        dest_hdrs[i].pBuffer = (OMX_U8 *)malloc(args.buffer_size);
+    }
+}
+
+replay_client::~replay_client()
+{
+    for (size_t i = 0; i < dest_hdrs.size(); i++)
+        free(dest_hdrs[i].pBuffer);
+}
+
+/* Same sizes as the FIX and ARBITRARY read modes of vdec-parse-bench */
+OMX_U32 replay_client::next_chunk_size()
+{
+    OMX_U32 bytes, max_bytes = args.buffer_size / 2;
+    OMX_U32 min_bytes = max_bytes / (args.buffer_count - 1);
+
+    if (fix_bytes)
+        return fix_bytes;
+    do {
+        bytes = rand() % max_bytes;
+    } while (bytes < min_bytes);
+    return bytes;
+}
+
+void replay_client::queue_sources()
+{
+    while (!free_sources.empty() && stream_offset < stream_copy.size()) {
+        OMX_BUFFERHEADERTYPE *source = free_sources.back();
+        OMX_U32 bytes = std::min(next_chunk_size(),
+                (OMX_U32)stream_copy.size() - stream_offset);
+
+        free_sources.pop_back();
+        source->pBuffer = &stream_copy[stream_offset];
+        source->nAllocLen = bytes;
+        source->nFilledLen = bytes;
+        source->nOffset = 0;
+        source->nTimeStamp = 0;
+        source->nFlags = 0;
+        stream_offset += bytes;
+        if (stream_offset == stream_copy.size())
+            source->nFlags |= OMX_BUFFERFLAG_EOS;
+        pending_sources.push_back(source);
+        sources_out++;
+    }
+}
+
+bool replay_client::run(const OMX_U8 *stream, OMX_U32 size, replay_mode mode,
+        OMX_U32 fix, unsigned int seed)
+{
+    AccessUnitAssembler assembler;
+    OMX_BUFFERHEADERTYPE *source = NULL;
+    OMX_BUFFERHEADERTYPE *dest = NULL;
+    OMX_ERRORTYPE ret = OMX_ErrorNone;
+
+    aus.clear();
+    stream_copy.assign(stream, stream + size);
+    stream_offset = 0;
+    fix_bytes = fix;
+    sources_out = 0;
+    srand(seed);
+
+    assembler.set_zero_copy(mode != REPLAY_COPY);
+    if (assembler.init(args.codec, this) < 0 ||
+            assembler.set_nal_length(args.nal_length) < 0 ||
+            !assembler.allocate(args.buffer_size)) {
+        fprintf(stderr, "Failed to set up the AU assembler\n");
+        return false;
+    }
+    assembler.set_source_count(args.buffer_count);
+
+    free_dests.clear();
+    free_sources.clear();
+    pending_sources.clear();
+    pending_head = 0;
+    for (OMX_U32 i = 0; i < args.buffer_count; i++) {
+        free_dests.push_back(&dest_hdrs[i]);
+        free_sources.push_back(&source_hdrs[i]);
+    }
+
+    for (;;) {
+        queue_sources();
+        if (!dest)
+            dest = get_free_dest();
+        if (!source)
+            source = get_next_source();
+        if (!source || !dest)
+            break;
+        while (source && dest && ret == OMX_ErrorNone) {
+            ret = assembler.push(source, dest);
+            if (mode == REPLAY_ZERO_COPY_RELEASE) {
+                /* Only the buffer being parsed and the queued ones remain */
+                assembler.release_sources();
+                if (sources_out != pending_sources.size() - pending_head +
+                        (source ? 1 : 0)) {
+                    fprintf(stderr, "Source buffers still held after release\n");
+                    return false;
+                }
+            }
+        }
+        if (ret != OMX_ErrorNone) {
+            fprintf(stderr, "AU assembly failed: 0x%x\n", ret);
+            return false;
+        }
+    }
+    if (stream_offset < stream_copy.size()) {
+        fprintf(stderr, "Stalled at offset %u of %u\n",
+                (unsigned)stream_offset, (unsigned)stream_copy.size());
+        return false;
+    }
+
+    /* Like a flush: the assembler hands back whatever it still holds */
+    assembler.reset();
+    if (source) {
+        source_done(source);
+    }
+    while (pending_head < pending_sources.size()) {
+        source_done(pending_sources[pending_head++]);
+    }
+    if (sources_out) {
+        fprintf(stderr, "%u source buffer(s) never returned\n",
+                (unsigned)sources_out);
+        return false;
+    }
+    assembler.deallocate();
+    return true;
+}
+
+OMX_ERRORTYPE replay_client::au_ready(OMX_BUFFERHEADERTYPE *dest)
+{
+    if (dest->nFilledLen) {
+        aus.push_back(replay_au());
+        aus.back().data.assign(dest->pBuffer, dest->pBuffer + dest->nFilledLen);
+        aus.back().flags = dest->nFlags;
+    }
+    dest->nFilledLen = 0;
+    free_dests.push_back(dest);
+    return OMX_ErrorNone;
+}
+
+OMX_BUFFERHEADERTYPE *replay_client::get_free_dest()
+{
+    OMX_BUFFERHEADERTYPE *dest;
+
+    if (free_dests.empty())
+        return NULL;
+    dest = free_dests.back();
+    free_dests.pop_back();
+    dest->nFilledLen = 0;
+    dest->nFlags = 0;
+    dest->nTimeStamp = LLONG_MAX;
+    return dest;
+}
+
+void replay_client::return_dest(OMX_BUFFERHEADERTYPE *dest)
+{
+    free_dests.push_back(dest);
+}
+
+OMX_BUFFERHEADERTYPE *replay_client::get_next_source()
+{
+    if (pending_head == pending_sources.size())
+        queue_sources();
+    if (pending_head == pending_sources.size())
+        return NULL;
+    return pending_sources[pending_head++];
+}
+
+/* The client owns the buffer again and may refill it right away */
+void replay_client::source_done(OMX_BUFFERHEADERTYPE *source)
+{
+    memset(source->pBuffer, POISON_BYTE, source->nAllocLen);
+    free_sources.push_back(source);
+    sources_out--;
+}
+
+/* Compares two AU lists, reports the first difference */
+static bool compare_aus(const std::vector<replay_au> &ref,
+        const std::vector<replay_au> &test, const char *label)
+{
+    size_t count = std::min(ref.size(), test.size());
+
+    for (size_t i = 0; i < count; i++) {
+        const std::vector<OMX_U8> &a = ref[i].data, &b = test[i].data;
+
+        if (a.size() != b.size()) {
+            printf("FAIL %s: AU %zu is %zu bytes, expected %zu\n", label, i,
+                    b.size(), a.size());
+            return false;
+        }
+        std::pair<std::vector<OMX_U8>::const_iterator,
+            std::vector<OMX_U8>::const_iterator> diff =
+                std::mismatch(a.begin(), a.end(), b.begin());
+        if (diff.first != a.end()) {
+            printf("FAIL %s: AU %zu differs at byte %zu (0x%02x, expected 0x%02x)\n",
+                    label, i, (size_t)(diff.first - a.begin()), *diff.second,
+                    *diff.first);
+            return false;
+        }
+        if (ref[i].flags != test[i].flags) {
+            printf("FAIL %s: AU %zu flags 0x%x, expected 0x%x\n", label, i,
+                    (unsigned)test[i].flags, (unsigned)ref[i].flags);
+            return false;
+        }
+    }
+    if (ref.size() != test.size()) {
+        printf("FAIL %s: %zu AUs, expected %zu\n", label, test.size(), ref.size());
+        return false;
+    }
+    return true;
+}
+
+static bool replay(const replay_args &args, const OMX_U8 *data, OMX_U32 size,
+        OMX_U32 fix_bytes, unsigned int seed)
+{
+    static const struct {
+        replay_mode mode;
+        const char *name;
+    } modes[] = {
+        { REPLAY_ZERO_COPY,         "zero copy" },
+        { REPLAY_ZERO_COPY_RELEASE, "zero copy, released on every push" },
+    };
+    std::vector<replay_au> ref, test;
+    char label[96];
+
+    if (fix_bytes)
+        snprintf(label, sizeof(label), "FIX %u", (unsigned)fix_bytes);
+    else
+        snprintf(label, sizeof(label), "ARBITRARY seed %u", seed);
+
+    {
+        replay_client client(args, ref);
+        if (!client.run(data, size, REPLAY_COPY, fix_bytes, seed)) {
+            printf("FAIL %s: copy path\n", label);
+            return false;
+        }
+    }
+    for (size_t i = 0; i < sizeof(modes) / sizeof(modes[0]); i++) {
+        char run_label[160];
+        replay_client client(args, test);
+
+        snprintf(run_label, sizeof(run_label), "%s, %s", label, modes[i].name);
+        if (!client.run(data, size, modes[i].mode, fix_bytes, seed)) {
+            printf("FAIL %s\n", run_label);
+            return false;
+        }
+        if (!compare_aus(ref, test, run_label))
+            return false;
+    }
+    printf("ok   %s: %zu AUs\n", label, ref.size());
+    return true;
+}
+
+static void help()
+{
+    printf("\n\n");
+    printf("=============================\n");
+    printf("vdec-au-replay-test -i <file> -c <codec> [options]\n");
+    printf("=============================\n\n");
+    printf("  eg: vdec-au-replay-test -i clip.264 -c H.264\n\n");
+    printf("      -i, --input <file>     Elementary stream (required)\n");
+    printf("      -c, --codec <codec>    H.264 | HEVC | MPEG4 | H.263 | MPEG2 | VC1\n");
+    printf("      -l, --nal-length <#>   NAL length field size, 0 for Annex-B\n");
+    printf("      -B, --buffer-size <#>  Input buffer size (default %d)\n",
+            DEFAULT_BUFFER_SIZE);
+    printf("      -n, --buffers <#>      Input buffer count (default %d)\n",
+            DEFAULT_BUFFER_COUNT);
+    printf("      -s, --seeds <#>        ARBITRARY runs (default 8)\n");
+    printf("      -h, --help             Print this menu\n");
+    printf("=============================\n\n\n");
+}
+
+static int parse_args(int argc, char **argv, replay_args *args)
+{
+    int command;
+    struct option longopts[] = {
+        { "input",       required_argument, NULL, 'i'},
+        { "codec",       required_argument, NULL, 'c'},
+        { "nal-length",  required_argument, NULL, 'l'},
+        { "buffer-size", required_argument, NULL, 'B'},
+        { "buffers",     required_argument, NULL, 'n'},
+        { "seeds",       required_argument, NULL, 's'},
+        { "help",        no_argument,       NULL, 'h'},
+        { NULL,          0,                 NULL,  0},
+    };
+    bool codec_set = false;
+
+    while ((command = getopt_long(argc, argv, "i:c:l:B:n:s:h",
+                    longopts, NULL)) != -1) {
+        switch (command) {
+            case 'i':
+                args->input_file = optarg;
+                break;
+            case 'c':
+                for (size_t i = 0; i < sizeof(codec_names) / sizeof(codec_names[0]); i++) {
+                    if (!strcmp(optarg, codec_names[i].name)) {
+                        args->codec = codec_names[i].codec;
+                        codec_set = true;
+                    }
+                }
+                if (!codec_set) {
+                    fprintf(stderr, "Unknown codec: %s\n", optarg);
+                    return -1;
+                }
+                break;
+            case 'l':
+                args->nal_length = strtoul(optarg, NULL, 0);
+                break;
+            case 'B':
+                args->buffer_size = strtoul(optarg, NULL, 0);
+                break;
+            case 'n':
+                args->buffer_count = strtoul(optarg, NULL, 0);
+                break;
+            case 's':
+                args->seeds = strtoul(optarg, NULL, 0);
+                break;
+            case 'h':
+            default:
+                return -1;
+        }
+    }
+
+    if (!args->input_file || !codec_set) {
+        fprintf(stderr, "Input file and codec are required\n");
+        return -1;
+    }
+    if (args->buffer_count < 2 || args->buffer_size < 2) {
+        fprintf(stderr, "Need at least 2 buffers and a buffer size\n");
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    replay_args args;
+    FILE *input = NULL;
+    OMX_U8 *data = NULL;
+    long size;
+    unsigned int failed = 0;
+    int rc = -1;
+
+    memset(&args, 0, sizeof(args));
+    args.buffer_size = DEFAULT_BUFFER_SIZE;
+    args.buffer_count = DEFAULT_BUFFER_COUNT;
+    args.seeds = 8;
+
+    if (parse_args(argc, argv, &args)) {
+        help();
+        return -1;
+    }
+
+    input = fopen(args.input_file, "rb");
+    if (!input) {
+        fprintf(stderr, "Failed to open %s\n", args.input_file);
+        return -1;
+    }
+    fseek(input, 0, SEEK_END);
+    size = ftell(input);
+    fseek(input, 0, SEEK_SET);
+    if (size <= 0 || size > UINT_MAX) {
+        fprintf(stderr, "Unsupported input size %ld\n", size);
+        goto exit;
+    }
+    data = (OMX_U8 *)malloc(size);
+    if (!data || fread(data, 1, size, input) != (size_t)size) {
+        fprintf(stderr, "Failed to read %s\n", args.input_file);
+        goto exit;
+    }
+
+    for (size_t i = 0; i < sizeof(fix_chunks) / sizeof(fix_chunks[0]); i++) {
+        if (fix_chunks[i] <= args.buffer_size &&
+                !replay(args, data, (OMX_U32)size, fix_chunks[i], 0))
+            failed++;
+    }
+    for (unsigned int seed = 0; seed < args.seeds; seed++) {
+        if (!replay(args, data, (OMX_U32)size, 0, seed))
+            failed++;
+    }
+    printf("%s: %u run(s) failed\n", failed ? "FAIL" : "PASS", failed);
+    rc = failed ? 1 : 0;
+
+exit:
+    free(data);
+    fclose(input);
+    return rc;
+}
@@ -0,0 +1,554 @@
+/*
+ * Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * vdec-extradata-writer-test: replays the fixtures in test/extradata
+ * through extradata_writer. Each fixture pairs a driver extradata dump with
+ * the client extradata handle_extradata wrote for it before the writer.
+ * The records of the legacy output are appended to the writer in the same
+ * order, user data taking its size and payload from the driver dump, and
+ * the writer's output has to match the legacy output byte for byte, apart
+ * from the two layout changes the writer made on purpose. Every frame is
+ * then written into every shorter buffer, checking that nothing lands past
+ * the end and that what is written stays a valid record chain.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "OMX_Core.h"
+#include "OMX_QCOMExtns.h"
+#include "extradata_writer.h"
+
+#define POISON_BYTE 0xA5
+#define BENCH_ROUNDS 5
+#define MANIFEST "fixtures.txt"
+
+/* Driver user data record, MSM_VIDC_EXTRADATA_STREAM_USERDATA in
+ * media/msm_vidc.h; the kernel headers are not available to host builds */
+#define DRV_EXTRADATA_NONE              0x00000000
+#define DRV_EXTRADATA_STREAM_USERDATA   0x0000000E
+
+#define SPEC_VERSION 0x00000101
+#define OUTPUT_PORT 1
+
+/* The record sizes omx_vdec.h defines */
+#define RECORD_SIZE(payload) ((sizeof(OMX_OTHER_EXTRADATATYPE) + (payload) + 3) & ~3)
+
+/* The templates omx_vdec::update_extradata_templates() sets up, with the
+ * OMX_*_EXTRADATA bit of omx_vdec.h that enables each */
+static const struct record_type {
+    extradata_record rec;
+    OMX_U32 client;
+    OMX_U32 type;
+    OMX_U32 size;
+    OMX_U32 data_size;
+    bool versioned;
+} record_types[] = {
+    { EXTRADATA_REC_INTERLACE, 0x00020000, OMX_ExtraDataInterlaceFormat,
+        RECORD_SIZE(sizeof(OMX_STREAMINTERLACEFORMAT)),
+        sizeof(OMX_STREAMINTERLACEFORMAT), true },
+    { EXTRADATA_REC_FRAMEINFO, 0x00010000, OMX_ExtraDataFrameInfo,
+        RECORD_SIZE(sizeof(OMX_QCOM_EXTRADATA_FRAMEINFO)),
+        sizeof(OMX_QCOM_EXTRADATA_FRAMEINFO), false },
+    { EXTRADATA_REC_FRAMEDIMENSION, 0x00200000, OMX_ExtraDataFrameDimension,
+        RECORD_SIZE(sizeof(OMX_QCOM_EXTRADATA_FRAMEDIMENSION)),
+        sizeof(OMX_QCOM_EXTRADATA_FRAMEDIMENSION), false },
+    { EXTRADATA_REC_FRAMEPACK, 0x00400000, OMX_ExtraDataFramePackingArrangement,
+        RECORD_SIZE(sizeof(OMX_QCOM_FRAME_PACK_ARRANGEMENT)),
+        sizeof(OMX_QCOM_FRAME_PACK_ARRANGEMENT), false },
+    { EXTRADATA_REC_QP, 0x00800000, OMX_ExtraDataQP,
+        RECORD_SIZE(sizeof(OMX_QCOM_EXTRADATA_QP)),
+        sizeof(OMX_QCOM_EXTRADATA_QP), false },
+    { EXTRADATA_REC_BITSINFO, 0x01000000, OMX_ExtraDataInputBitsInfo,
+        RECORD_SIZE(sizeof(OMX_QCOM_EXTRADATA_BITS_INFO)),
+        sizeof(OMX_QCOM_EXTRADATA_BITS_INFO), false },
+    { EXTRADATA_REC_USERDATA, 0x00100000, OMX_ExtraDataMP2UserData,
+        RECORD_SIZE(0), 0, false },
+};
+
+#define NUM_RECORD_TYPES (sizeof(record_types) / sizeof(record_types[0]))
+
+/* Bytes of the payload a versioned template stamps */
+#define VERSIONED_STAMP_SIZE (3 * sizeof(OMX_U32))
+
+static const struct record_type *find_record_type(OMX_U32 type)
+{
+    for (size_t i = 0; i < NUM_RECORD_TYPES; i++) {
+        if (record_types[i].type == type)
+            return &record_types[i];
+    }
+    return NULL;
+}
+
+/* One record of the legacy output */
+struct legacy_record {
+    const struct record_type *type;
+    size_t offset;
+    OMX_U32 size;
+    OMX_U32 data_size;
+};
+
+struct test_frame {
+    std::vector<legacy_record> records;
+    /* Offsets of the driver user data records in the dump, in order */
+    std::vector<size_t> user;
+    /* The frame as the writer should leave it, outside the records poison */
+    std::vector<OMX_U8> expected;
+    bool repeated;
+};
+
+struct fixture {
+    std::string name;
+    OMX_U32 client_extradata;
+    std::vector<OMX_U8> dump;
+    std::vector<OMX_U8> legacy;
+    std::vector<test_frame> frames;
+};
+
+/* Set by -d */
+static bool debug_extradata;
+
+static void print_debug_extradata(OMX_OTHER_EXTRADATATYPE *extra)
+{
+    if (!debug_extradata || !extra)
+        return;
+    printf("  record type 0x%08x size %u data %u\n", (unsigned)extra->eType,
+            (unsigned)extra->nSize, (unsigned)extra->nDataSize);
+}
+
+static bool load_file(const std::string &name, std::vector<OMX_U8> &data)
+{
+    FILE *input = fopen(name.c_str(), "rb");
+    long size;
+
+    if (!input) {
+        fprintf(stderr, "Failed to open %s\n", name.c_str());
+        return false;
+    }
+    fseek(input, 0, SEEK_END);
+    size = ftell(input);
+    fseek(input, 0, SEEK_SET);
+    data.resize(size > 0 ? size : 0);
+    if (size <= 0 || fread(&data[0], 1, size, input) != (size_t)size) {
+        fprintf(stderr, "Failed to read %s\n", name.c_str());
+        fclose(input);
+        return false;
+    }
+    fclose(input);
+    return true;
+}
+
+/* Splits the legacy output into frames and checks it against the dump */
+static bool parse_fixture(fixture &f, size_t slot_size)
+{
+    size_t offset = 0, frame_count;
+
+    if (!slot_size || (slot_size & 3) || f.dump.size() % slot_size) {
+        fprintf(stderr, "%s: dump is not a whole number of %zu byte slots\n",
+                f.name.c_str(), slot_size);
+        return false;
+    }
+    frame_count = f.dump.size() / slot_size;
+    f.frames.resize(frame_count);
+    for (size_t i = 0; i < frame_count; i++) {
+        test_frame &frame = f.frames[i];
+        const OMX_U8 *slot = &f.dump[i * slot_size];
+        size_t consumed_len = 0, pos = 0;
+        std::vector<OMX_U32> types;
+
+        while (consumed_len + sizeof(OMX_OTHER_EXTRADATATYPE) <= slot_size) {
+            const OMX_OTHER_EXTRADATATYPE *data =
+                (const OMX_OTHER_EXTRADATATYPE *)(const void *)(slot + consumed_len);
+
+            if (data->eType == (OMX_EXTRADATATYPE)DRV_EXTRADATA_NONE)
+                break;
+            if (data->nSize < sizeof(OMX_OTHER_EXTRADATATYPE) - 4 ||
+                    consumed_len + data->nSize > slot_size ||
+                    data->nDataSize > data->nSize - (sizeof(OMX_OTHER_EXTRADATATYPE) - 4)) {
+                fprintf(stderr, "%s: frame %zu: bad driver record at %zu\n",
+                        f.name.c_str(), i, consumed_len);
+                return false;
+            }
+            if (data->eType == (OMX_EXTRADATATYPE)DRV_EXTRADATA_STREAM_USERDATA)
+                frame.user.push_back(i * slot_size + consumed_len);
+            consumed_len += data->nSize;
+        }
+
+        frame.expected.assign(f.legacy.size(), POISON_BYTE);
+        for (;;) {
+            OMX_OTHER_EXTRADATATYPE extra;
+            legacy_record record;
+            OMX_U32 size, copy;
+
+            if (offset + sizeof(extra) > f.legacy.size()) {
+                fprintf(stderr, "%s: frame %zu: legacy output ends without a terminator\n",
+                        f.name.c_str(), i);
+                return false;
+            }
+            memcpy(&extra, &f.legacy[offset], sizeof(extra));
+            if (extra.eType == OMX_ExtraDataNone) {
+                /* The writer sets nPortIndex on the terminator as well */
+                extra.nPortIndex = OUTPUT_PORT;
+                memcpy(&frame.expected[pos], &extra, sizeof(extra) - 3);
+                offset = (offset + extra.nSize + 3) & ~3;
+                break;
+            }
+            record.type = find_record_type(extra.eType);
+            if (!record.type || extra.nSize < sizeof(extra) - 4 ||
+                    extra.nDataSize > extra.nSize - (sizeof(extra) - 4) ||
+                    offset + extra.nSize > f.legacy.size()) {
+                fprintf(stderr, "%s: frame %zu: bad legacy record 0x%08x at %zu\n",
+                        f.name.c_str(), i, (unsigned)extra.eType, offset);
+                return false;
+            }
+            record.offset = offset;
+            record.size = extra.nSize;
+            record.data_size = extra.nDataSize;
+            frame.records.push_back(record);
+            types.push_back(extra.eType);
+
+            /* The writer rounds user data up to 4 bytes, so the records
+             * after it start where the legacy code left them unaligned */
+            size = (extra.nSize + 3) & ~3;
+            copy = sizeof(extra) - 4 + extra.nDataSize;
+            memcpy(&frame.expected[pos], &f.legacy[offset], copy);
+            memcpy(&frame.expected[pos], &size, sizeof(size));
+            pos += size;
+            offset += extra.nSize;
+        }
+
+        size_t user_records = 0;
+        for (size_t r = 0; r < frame.records.size(); r++)
+            user_records += frame.records[r].type->rec == EXTRADATA_REC_USERDATA;
+        if (user_records != frame.user.size() &&
+                (user_records || (f.client_extradata & 0x00100000))) {
+            fprintf(stderr, "%s: frame %zu: %zu user data records for %zu in the dump\n",
+                    f.name.c_str(), i, user_records, frame.user.size());
+            return false;
+        }
+        std::sort(types.begin(), types.end());
+        frame.repeated = std::adjacent_find(types.begin(), types.end()) != types.end();
+    }
+    if (offset != f.legacy.size()) {
+        fprintf(stderr, "%s: %zu bytes of legacy output past frame %zu\n",
+                f.name.c_str(), f.legacy.size() - offset, frame_count);
+        return false;
+    }
+    return true;
+}
+
+static bool load_fixtures(const char *dir, std::vector<fixture> &fixtures)
+{
+    std::string path = std::string(dir) + "/" MANIFEST;
+    FILE *manifest = fopen(path.c_str(), "r");
+    char line[512];
+
+    if (!manifest) {
+        fprintf(stderr, "Failed to open %s\n", path.c_str());
+        return false;
+    }
+    while (fgets(line, sizeof(line), manifest)) {
+        char dump[256], legacy[256];
+        unsigned long slot_size, client_extradata;
+        fixture f;
+
+        if (line[0] == '#' || sscanf(line, "%255s %lu %lx %255s",
+                    dump, &slot_size, &client_extradata, legacy) != 4)
+            continue;
+        f.name = legacy;
+        f.client_extradata = client_extradata;
+        if (!load_file(std::string(dir) + "/" + dump, f.dump) ||
+                !load_file(std::string(dir) + "/" + legacy, f.legacy) ||
+                !parse_fixture(f, slot_size)) {
+            fclose(manifest);
+            return false;
+        }
+        fixtures.push_back(f);
+    }
+    fclose(manifest);
+    if (fixtures.empty()) {
+        fprintf(stderr, "No fixtures in %s\n", path.c_str());
+        return false;
+    }
+    return true;
+}
+
+static void setup_writer(extradata_writer &writer, OMX_U32 client_extradata)
+{
+    writer.init(SPEC_VERSION, OUTPUT_PORT);
+    for (size_t i = 0; i < NUM_RECORD_TYPES; i++) {
+        const struct record_type *t = &record_types[i];
+
+        writer.set_template(t->rec, t->type, t->size, t->data_size, t->versioned,
+                client_extradata & t->client);
+    }
+}
+
+/* Appends the records of one frame the way handle_extradata does. The
+ * payloads the decoder builds from its own state are taken from the legacy
+ * output, past the header the template stamps. Returns what begin() said
+ * about the room for the enabled records. */
+static bool write_frame(extradata_writer &writer, const fixture &f,
+        const test_frame &frame, OMX_U8 *start, OMX_U8 *end)
+{
+    bool fits = writer.begin(start, end);
+    size_t user = 0;
+
+    for (size_t i = 0; i < frame.records.size(); i++) {
+        const legacy_record &record = frame.records[i];
+        OMX_OTHER_EXTRADATATYPE *extra;
+
+        if (record.type->rec == EXTRADATA_REC_USERDATA) {
+            const OMX_OTHER_EXTRADATATYPE *data =
+                (const OMX_OTHER_EXTRADATATYPE *)(const void *)&f.dump[frame.user[user++]];
+
+            extra = writer.append(EXTRADATA_REC_USERDATA, data->nDataSize);
+            if (extra && extra->nDataSize)
+                memcpy(extra->data, data->data, extra->nDataSize);
+        } else {
+            size_t skip = record.type->versioned ? VERSIONED_STAMP_SIZE : 0;
+
+            extra = writer.append(record.type->rec);
+            if (extra)
+                memcpy(extra->data + skip,
+                        &f.legacy[record.offset + sizeof(*extra) - 4 + skip],
+                        record.data_size - skip);
+        }
+        print_debug_extradata(extra);
+    }
+    print_debug_extradata(writer.finish());
+    return fits;
+}
+
+/* Bytes from start up to the end of the terminator, 0 if the chain leaves
+ * [start, start + len) or has no terminator. types gets the record types. */
+static size_t chain_length(const OMX_U8 *start, size_t len,
+        std::vector<OMX_U32> *types = NULL)
+{
+    size_t offset = 0;
+
+    if (types)
+        types->clear();
+    while (offset + sizeof(OMX_OTHER_EXTRADATATYPE) <= len) {
+        const OMX_OTHER_EXTRADATATYPE *extra =
+            (const OMX_OTHER_EXTRADATATYPE *)(const void *)(start + offset);
+
+        if (extra->nSize < sizeof(OMX_OTHER_EXTRADATATYPE) - 4 ||
+                (extra->nSize & 3) || offset + extra->nSize > len)
+            return 0;
+        offset += extra->nSize;
+        if (extra->eType == OMX_ExtraDataNone)
+            return offset;
+        if (types)
+            types->push_back(extra->eType);
+    }
+    return 0;
+}
+
+static bool check_frame(extradata_writer &writer, const fixture &f, size_t index,
+        std::vector<OMX_U8> &buf)
+{
+    const test_frame &frame = f.frames[index];
+    std::vector<OMX_U32> types, short_types;
+    size_t len, end;
+
+    memset(&buf[0], POISON_BYTE, buf.size());
+    write_frame(writer, f, frame, &buf[0], &buf[0] + buf.size());
+    for (size_t i = 0; i < buf.size(); i++) {
+        if (buf[i] != frame.expected[i]) {
+            printf("FAIL %s, frame %zu: differs at byte %zu (0x%02x, expected 0x%02x)\n",
+                    f.name.c_str(), index, i, buf[i], frame.expected[i]);
+            return false;
+        }
+    }
+    len = chain_length(&buf[0], buf.size(), &types);
+    if (!len) {
+        printf("FAIL %s, frame %zu: no terminator\n", f.name.c_str(), index);
+        return false;
+    }
+
+    /* Every shorter buffer: nothing written past the end, the records that
+     * made it form a chain that stays inside the buffer, and with the room
+     * begin() asks for, user data never pushes out a fixed size record */
+    for (end = 0; end < len; end++) {
+        bool fits;
+
+        memset(&buf[0], POISON_BYTE, buf.size());
+        fits = write_frame(writer, f, frame, &buf[0], &buf[0] + end);
+        for (size_t i = end; i < buf.size(); i++) {
+            if (buf[i] != POISON_BYTE) {
+                printf("FAIL %s, frame %zu: %zu byte buffer written at byte %zu\n",
+                        f.name.c_str(), index, end, i);
+                return false;
+            }
+        }
+        if (end >= sizeof(OMX_OTHER_EXTRADATATYPE) &&
+                !chain_length(&buf[0], end, &short_types)) {
+            printf("FAIL %s, frame %zu: %zu byte buffer has no valid record chain\n",
+                    f.name.c_str(), index, end);
+            return false;
+        }
+        if (!fits || frame.repeated)
+            continue;
+        for (size_t i = 0; i < types.size(); i++) {
+            if (types[i] != (OMX_U32)OMX_ExtraDataMP2UserData &&
+                    std::find(short_types.begin(), short_types.end(), types[i]) ==
+                    short_types.end()) {
+                printf("FAIL %s, frame %zu: %zu byte buffer dropped record 0x%08x\n",
+                        f.name.c_str(), index, end, (unsigned)types[i]);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static bool check_fixture(const fixture &f)
+{
+    extradata_writer writer;
+    std::vector<OMX_U8> buf(f.legacy.size());
+
+    setup_writer(writer, f.client_extradata);
+    for (size_t i = 0; i < f.frames.size(); i++) {
+        if (!check_frame(writer, f, i, buf))
+            return false;
+    }
+    printf("ok   %s, client 0x%08x: %zu frames, %zu bytes\n", f.name.c_str(),
+            (unsigned)f.client_extradata, f.frames.size(), f.legacy.size());
+    return true;
+}
+
+static double now_ns()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static double time_fixture(const fixture &f, unsigned int iterations)
+{
+    extradata_writer writer;
+    std::vector<OMX_U8> buf(f.legacy.size());
+    double best = 1e30;
+
+    setup_writer(writer, f.client_extradata);
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        double start = now_ns();
+
+        for (unsigned int i = 0; i < iterations; i++) {
+            for (size_t n = 0; n < f.frames.size(); n++) {
+                write_frame(writer, f, f.frames[n], &buf[0], &buf[0] + buf.size());
+                __asm__ __volatile__("" : : "r"(&buf[0]) : "memory");
+            }
+        }
+        best = std::min(best, (now_ns() - start) / ((double)iterations * f.frames.size()));
+    }
+    return best;
+}
+
+static void help()
+{
+    printf("\n\n");
+    printf("=============================\n");
+    printf("vdec-extradata-writer-test [options]\n");
+    printf("=============================\n\n");
+    printf("  eg: vdec-extradata-writer-test -f test/extradata -b 1000000\n\n");
+    printf("      -f, --fixtures <dir>   Directory holding " MANIFEST " (required)\n");
+    printf("      -b, --bench <#>        Also time the writer over # passes\n");
+    printf("      -d, --debug            Print every record written\n");
+    printf("      -h, --help             Print this menu\n");
+    printf("=============================\n\n\n");
+}
+
+int main(int argc, char **argv)
+{
+    struct option longopts[] = {
+        { "fixtures",  required_argument, NULL, 'f'},
+        { "bench",     required_argument, NULL, 'b'},
+        { "debug",     no_argument,       NULL, 'd'},
+        { "help",      no_argument,       NULL, 'h'},
+        { NULL,        0,                 NULL,  0},
+    };
+    const char *fixture_dir = NULL;
+    unsigned int iterations = 0, failed = 0;
+    std::vector<fixture> fixtures;
+    int command;
+
+    while ((command = getopt_long(argc, argv, "f:b:dh", longopts, NULL)) != -1) {
+        switch (command) {
+            case 'f':
+                fixture_dir = optarg;
+                break;
+            case 'b':
+                iterations = strtoul(optarg, NULL, 0);
+                break;
+            case 'd':
+                debug_extradata = true;
+                break;
+            case 'h':
+            default:
+                help();
+                return -1;
+        }
+    }
+    if (!fixture_dir) {
+        help();
+        return -1;
+    }
+    if (!load_fixtures(fixture_dir, fixtures))
+        return -1;
+
+    for (size_t i = 0; i < fixtures.size(); i++) {
+        if (!check_fixture(fixtures[i]))
+            failed++;
+    }
+
+    if (iterations) {
+        debug_extradata = false;
+        for (size_t i = 0; i < fixtures.size(); i++) {
+            printf("%-20s client 0x%08x: %.1f ns/frame\n", fixtures[i].name.c_str(),
+                    (unsigned)fixtures[i].client_extradata,
+                    time_fixture(fixtures[i], iterations));
+        }
+    }
+
+    if (failed) {
+        printf("%u of %zu fixtures FAILED\n", failed, fixtures.size());
+        return 1;
+    }
+    printf("All %zu fixtures passed\n", fixtures.size());
+    return 0;
+}
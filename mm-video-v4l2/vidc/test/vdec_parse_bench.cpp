@@ -0,0 +1,667 @@
+/*
+ * Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * vdec-parse-bench: replays an elementary stream through the decoder's
+ * arbitrary-bytes input path (frame_parse, H264_Utils, HEVC_Utils,
+ * h264_stream_parser and MP4_Utils, driven by AccessUnitAssembler) and
+ * reports throughput and per-AU latency. No V4L2 device or ION is needed,
+ * so it runs on the host as well as on targets.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include <algorithm>
+#include <vector>
+#include "au_assembler.h"
+#include "h264_utils.h"
+#include "mp4_utils.h"
+#include "vidc_debug.h"
+
+/* Owned by libOmxVidcCommon in the components, which is not linked here */
+int debug_level = PRIO_ERROR;
+
+#define DEFAULT_BUFFER_SIZE (1920*1080*3/2)
+#define DEFAULT_BUFFER_COUNT 8
+#define DEFAULT_FRAME_INTERVAL_US 33333
+
+enum read_mode_type {
+    READ_MODE_FIX,
+    READ_MODE_ARBITRARY,
+};
+
+struct bench_args {
+    const char *input_file;
+    const char *bufsize_file;
+    codec_type codec;
+    read_mode_type read_mode;
+    OMX_U32 read_bytes;
+    OMX_U32 buffer_size;
+    OMX_U32 buffer_count;
+    unsigned int nal_length;
+    unsigned int seed;
+    unsigned int repeat;
+    bool zero_copy;
+    bool sei;
+    bool async_log;
+};
+
+struct bench_stats {
+    OMX_U64 bytes;
+    OMX_U64 chunks;
+    OMX_U64 aus;
+    OMX_U64 au_bytes;
+    OMX_U64 not_coded;
+    OMX_U64 stream_changes;
+    stream_params stream;       // last stream announced by the assembler
+    OMX_U64 elapsed_ns;
+    OMX_S64 instructions;
+    std::vector<OMX_U64> latency_ns;
+};
+
+static const struct {
+    const char *name;
+    codec_type codec;
+} codec_names[] = {
+    { "H.264", CODEC_TYPE_H264 },
+    { "H264",  CODEC_TYPE_H264 },
+    { "HEVC",  CODEC_TYPE_HEVC },
+    { "MPEG4", CODEC_TYPE_MPEG4 },
+    { "H.263", CODEC_TYPE_H263 },
+    { "H263",  CODEC_TYPE_H263 },
+    { "MPEG2", CODEC_TYPE_MPEG2 },
+    { "VC1",   CODEC_TYPE_VC1 },
+};
+
+static OMX_U64 now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (OMX_U64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* User space instructions retired by this thread, -1 where the kernel or the
+ * CPU does not expose the counter (emulators, most VMs) */
+static int insn_fd = -1;
+
+static void open_instruction_counter()
+{
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    insn_fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static OMX_S64 read_instructions()
+{
+    OMX_S64 count;
+
+    if (insn_fd < 0 || read(insn_fd, &count, sizeof(count)) != sizeof(count))
+        return -1;
+    return count;
+}
+
+/* Stands in for omx_vdec: hands out buffers, collects AUs and feeds the
+ * same parser hooks the component does. */
+class bench_client : public au_assembler_client
+{
+    public:
+        bench_client(const bench_args &args, bench_stats &stats);
+        ~bench_client();
+        bool init(const OMX_U8 *stream, OMX_U32 size, FILE *sizes);
+        OMX_ERRORTYPE run();
+
+        OMX_ERRORTYPE au_ready(OMX_BUFFERHEADERTYPE *dest);
+        OMX_BUFFERHEADERTYPE *get_free_dest();
+        void return_dest(OMX_BUFFERHEADERTYPE *dest);
+        OMX_BUFFERHEADERTYPE *get_next_source();
+        void source_done(OMX_BUFFERHEADERTYPE *source);
+        void nal_parsed(const au_nal_unit &nal);
+        OMX_S64 au_timestamp(OMX_S64 timestamp);
+        void stream_changed(OMX_U32 changes, const stream_params &params);
+
+    private:
+        OMX_U32 next_chunk_size();
+        void queue_sources();
+
+        const bench_args &args;
+        bench_stats &stats;
+        AccessUnitAssembler assembler;
+        h264_stream_parser h264_parser;
+        MP4_Utils mp4_parser;
+        std::vector<OMX_BUFFERHEADERTYPE> dest_hdrs;
+        std::vector<OMX_BUFFERHEADERTYPE> source_hdrs;
+        std::vector<OMX_BUFFERHEADERTYPE *> free_dests;
+        std::vector<OMX_BUFFERHEADERTYPE *> free_sources;
+        std::vector<OMX_BUFFERHEADERTYPE *> pending_sources;
+        size_t pending_head;
+        std::vector<OMX_U32> chunk_sizes;
+        size_t chunk_index;
+        const OMX_U8 *stream;
+        OMX_U32 stream_size;
+        OMX_U32 stream_offset;
+        OMX_U64 last_mark;
+};
+
+bench_client::bench_client(const bench_args &a, bench_stats &s):
+    args(a),
+    stats(s),
+    pending_head(0),
+    chunk_index(0),
+    stream(NULL),
+    stream_size(0),
+    stream_offset(0),
+    last_mark(0)
+{
+}
+
+bench_client::~bench_client()
+{
+    for (size_t i = 0; i < dest_hdrs.size(); i++)
+        free(dest_hdrs[i].pBuffer);
+    assembler.deallocate();
+}
+
+bool bench_client::init(const OMX_U8 *data, OMX_U32 size, FILE *sizes)
+{
+    char line[64];
+
+    stream = data;
+    stream_size = size;
+
+    while (sizes && fgets(line, sizeof(line), sizes)) {
+        OMX_U32 bytes = strtoul(line, NULL, 0);
+        if (bytes)
+            chunk_sizes.push_back(bytes);
+    }
+
+    assembler.set_zero_copy(args.zero_copy);
+    if (assembler.init(args.codec, this) < 0 ||
+            assembler.set_nal_length(args.nal_length) < 0 ||
+            !assembler.allocate(args.buffer_size)) {
+        fprintf(stderr, "Failed to set up the AU assembler\n");
+        return false;
+    }
+    assembler.set_source_count(args.buffer_count);
+
+    dest_hdrs.resize(args.buffer_count);
+    source_hdrs.resize(args.buffer_count);
+    for (OMX_U32 i = 0; i < args.buffer_count; i++) {
+        memset(&dest_hdrs[i], 0, sizeof(OMX_BUFFERHEADERTYPE));
+        dest_hdrs[i].nAllocLen = args.buffer_size;
+        dest_hdrs[i].pBuffer = (OMX_U8 *)malloc(args.buffer_size);
+        if (!dest_hdrs[i].pBuffer) {
+            fprintf(stderr, "Failed to allocate %u byte input buffers\n",
+                    (unsigned)args.buffer_size);
+            return false;
+        }
+        memset(&source_hdrs[i], 0, sizeof(OMX_BUFFERHEADERTYPE));
+    }
+    return true;
+}
+
+/* FIX: sizes from the buffer size file, then read_bytes.
+ * ARBITRARY: reproducible rand() sizes, large enough that the input
+ * buffers in flight can hold at least one frame (as msm-vidc-test). */
+OMX_U32 bench_client::next_chunk_size()
+{
+    OMX_U32 bytes;
+
+    if (args.read_mode == READ_MODE_ARBITRARY) {
+        OMX_U32 min_bytes = args.read_bytes / (args.buffer_count - 1);
+        do {
+            bytes = rand() % args.read_bytes;
+        } while (bytes < min_bytes);
+    } else if (chunk_index < chunk_sizes.size()) {
+        bytes = chunk_sizes[chunk_index];
+    } else {
+        bytes = args.read_bytes;
+    }
+    chunk_index++;
+    return bytes;
+}
+
+void bench_client::queue_sources()
+{
+    while (!free_sources.empty() && stream_offset < stream_size) {
+        OMX_BUFFERHEADERTYPE *source = free_sources.back();
+        OMX_U32 bytes = std::min(next_chunk_size(), stream_size - stream_offset);
+
+        free_sources.pop_back();
+        source->pBuffer = (OMX_U8 *)stream + stream_offset;
+        source->nAllocLen = bytes;
+        source->nFilledLen = bytes;
+        source->nOffset = 0;
+        source->nTimeStamp = (OMX_S64)stats.chunks * DEFAULT_FRAME_INTERVAL_US;
+        source->nFlags = 0;
+        stream_offset += bytes;
+        if (stream_offset == stream_size)
+            source->nFlags |= OMX_BUFFERFLAG_EOS;
+        pending_sources.push_back(source);
+        stats.chunks++;
+        stats.bytes += bytes;
+    }
+}
+
+OMX_ERRORTYPE bench_client::run()
+{
+    OMX_BUFFERHEADERTYPE *source = NULL;
+    OMX_BUFFERHEADERTYPE *dest = NULL;
+    OMX_ERRORTYPE ret = OMX_ErrorNone;
+    OMX_U64 start;
+    OMX_S64 insn_start;
+
+    free_dests.clear();
+    free_sources.clear();
+    pending_sources.clear();
+    pending_head = 0;
+    for (OMX_U32 i = 0; i < args.buffer_count; i++) {
+        free_dests.push_back(&dest_hdrs[i]);
+        free_sources.push_back(&source_hdrs[i]);
+    }
+    chunk_index = 0;
+    stream_offset = 0;
+    assembler.reset();
+    h264_parser.reset();
+
+    insn_start = read_instructions();
+    start = last_mark = now_ns();
+    for (;;) {
+        queue_sources();
+        if (!dest)
+            dest = get_free_dest();
+        if (!source)
+            source = get_next_source();
+        if (!source || !dest)
+            break;
+        while (source && dest && ret == OMX_ErrorNone)
+            ret = assembler.push(source, dest);
+        if (ret != OMX_ErrorNone) {
+            fprintf(stderr, "AU assembly failed: 0x%x\n", ret);
+            break;
+        }
+    }
+    stats.elapsed_ns += now_ns() - start;
+    if (insn_start >= 0 && stats.instructions >= 0)
+        stats.instructions += read_instructions() - insn_start;
+    else
+        stats.instructions = -1;
+
+    if (ret == OMX_ErrorNone && stream_offset < stream_size) {
+        fprintf(stderr, "Stalled at offset %u of %u\n",
+                (unsigned)stream_offset, (unsigned)stream_size);
+        ret = OMX_ErrorUndefined;
+    }
+    return ret;
+}
+
+OMX_ERRORTYPE bench_client::au_ready(OMX_BUFFERHEADERTYPE *dest)
+{
+    OMX_U64 now = now_ns();
+
+    if (dest->nFilledLen) {
+        stats.aus++;
+        stats.au_bytes += dest->nFilledLen;
+        stats.latency_ns.push_back(now - last_mark);
+        if ((args.codec == CODEC_TYPE_MPEG4 || args.codec == CODEC_TYPE_H263) &&
+                mp4_parser.is_notcodec_vop(dest->pBuffer, dest->nFilledLen))
+            stats.not_coded++;
+    }
+    dest->nFilledLen = 0;
+    free_dests.push_back(dest);
+    last_mark = now_ns();
+    return OMX_ErrorNone;
+}
+
+OMX_BUFFERHEADERTYPE *bench_client::get_free_dest()
+{
+    OMX_BUFFERHEADERTYPE *dest;
+
+    if (free_dests.empty())
+        return NULL;
+    dest = free_dests.back();
+    free_dests.pop_back();
+    dest->nFilledLen = 0;
+    dest->nFlags = 0;
+    dest->nTimeStamp = LLONG_MAX;
+    return dest;
+}
+
+void bench_client::return_dest(OMX_BUFFERHEADERTYPE *dest)
+{
+    free_dests.push_back(dest);
+}
+
+OMX_BUFFERHEADERTYPE *bench_client::get_next_source()
+{
+    if (pending_head == pending_sources.size())
+        queue_sources();
+    if (pending_head == pending_sources.size())
+        return NULL;
+    return pending_sources[pending_head++];
+}
+
+void bench_client::source_done(OMX_BUFFERHEADERTYPE *source)
+{
+    free_sources.push_back(source);
+}
+
+void bench_client::nal_parsed(const au_nal_unit &nal)
+{
+    if (args.codec != CODEC_TYPE_H264)
+        return;
+    h264_parser.parse_nal_payload(nal.payload, nal.payload_len, nal.type,
+            args.sei);
+}
+
+OMX_S64 bench_client::au_timestamp(OMX_S64 timestamp)
+{
+    if (args.codec == CODEC_TYPE_H264 && args.sei)
+        return h264_parser.process_ts_with_sei_vui(timestamp);
+    return LLONG_MAX;
+}
+
+void bench_client::stream_changed(OMX_U32 changes, const stream_params &params)
+{
+    (void)changes;
+    stats.stream_changes++;
+    stats.stream = params;
+}
+
+static double percentile_us(const std::vector<OMX_U64> &sorted, unsigned pct)
+{
+    if (sorted.empty())
+        return 0;
+    return sorted[(sorted.size() - 1) * pct / 100] / 1000.0;
+}
+
+static void print_stats(const bench_args &args, bench_stats &stats)
+{
+    double secs = stats.elapsed_ns / 1e9;
+
+    std::sort(stats.latency_ns.begin(), stats.latency_ns.end());
+    printf("input          : %s\n", args.input_file);
+    printf("read mode      : %s, %u buffers of %u bytes%s\n",
+            args.read_mode == READ_MODE_FIX ? "FIX" : "ARBITRARY",
+            (unsigned)args.buffer_count, (unsigned)args.buffer_size,
+            args.zero_copy ? ", zero copy" : "");
+    printf("chunks         : %llu (%llu bytes)\n",
+            (unsigned long long)stats.chunks, (unsigned long long)stats.bytes);
+    printf("access units   : %llu (%llu bytes)\n",
+            (unsigned long long)stats.aus, (unsigned long long)stats.au_bytes);
+    if (stats.not_coded)
+        printf("not coded VOPs : %llu\n", (unsigned long long)stats.not_coded);
+    if (stats.stream_changes)
+        printf("stream         : %ux%u, %llu change(s)\n",
+                (unsigned)stats.stream.crop_width, (unsigned)stats.stream.crop_height,
+                (unsigned long long)stats.stream_changes);
+    printf("elapsed        : %.3f ms\n", secs * 1e3);
+    if (secs > 0) {
+        printf("throughput     : %.2f MB/s\n", stats.bytes / secs / (1024 * 1024));
+        printf("AU rate        : %.1f AU/s\n", stats.aus / secs);
+    }
+    if (stats.instructions >= 0)
+        printf("instructions   : %lld (%.2f/byte)\n", (long long)stats.instructions,
+                stats.bytes ? (double)stats.instructions / stats.bytes : 0.0);
+    else
+        printf("instructions   : not available\n");
+    printf("AU latency (us): p50 %.2f p90 %.2f p99 %.2f max %.2f\n",
+            percentile_us(stats.latency_ns, 50),
+            percentile_us(stats.latency_ns, 90),
+            percentile_us(stats.latency_ns, 99),
+            percentile_us(stats.latency_ns, 100));
+}
+
+static void help()
+{
+    printf("\n\n");
+    printf("=============================\n");
+    printf("vdec-parse-bench -i <file> -c <codec> [options]\n");
+    printf("=============================\n\n");
+    printf("  eg: vdec-parse-bench -i clip.264 -c H.264 -m ARBITRARY -s 7\n\n");
+    printf("      -i, --input <file>     Elementary stream (required)\n");
+    printf("      -c, --codec <codec>    H.264 | HEVC | MPEG4 | H.263 | MPEG2 | VC1\n");
+    printf("      -m, --mode <mode>      FIX (default) | ARBITRARY\n");
+    printf("      -b, --read-bytes <#>   FIX chunk size, ARBITRARY upper bound\n");
+    printf("      -f, --fix-file <file>  FIX chunk sizes, one per line\n");
+    printf("      -s, --seed <#>         ARBITRARY random seed (default 0)\n");
+    printf("      -l, --nal-length <#>   NAL length field size, 0 for Annex-B\n");
+    printf("      -B, --buffer-size <#>  Input buffer size (default %d)\n",
+            DEFAULT_BUFFER_SIZE);
+    printf("      -n, --buffers <#>      Input buffer count (default %d)\n",
+            DEFAULT_BUFFER_COUNT);
+    printf("      -z, --zero-copy        Assemble H.264 without the scratch copy\n");
+    printf("      -e, --sei              Parse SEI/VUI timing like TIMEINFO extradata\n");
+    printf("      -r, --repeat <#>       Replay the stream #times\n");
+    printf("      -v, --verbose <#>      debug_level for the parsers\n");
+    printf("      -a, --async-log        Queue parser debug messages to the log ring\n");
+    printf("      -h, --help             Print this menu\n");
+    printf("=============================\n\n\n");
+}
+
+static int parse_args(int argc, char **argv, bench_args *args)
+{
+    int command;
+    struct option longopts[] = {
+        { "input",       required_argument, NULL, 'i'},
+        { "codec",       required_argument, NULL, 'c'},
+        { "mode",        required_argument, NULL, 'm'},
+        { "read-bytes",  required_argument, NULL, 'b'},
+        { "fix-file",    required_argument, NULL, 'f'},
+        { "seed",        required_argument, NULL, 's'},
+        { "nal-length",  required_argument, NULL, 'l'},
+        { "buffer-size", required_argument, NULL, 'B'},
+        { "buffers",     required_argument, NULL, 'n'},
+        { "zero-copy",   no_argument,       NULL, 'z'},
+        { "sei",         no_argument,       NULL, 'e'},
+        { "repeat",      required_argument, NULL, 'r'},
+        { "verbose",     required_argument, NULL, 'v'},
+        { "async-log",   no_argument,       NULL, 'a'},
+        { "help",        no_argument,       NULL, 'h'},
+        { NULL,          0,                 NULL,  0},
+    };
+    bool codec_set = false;
+
+    while ((command = getopt_long(argc, argv, "i:c:m:b:f:s:l:B:n:zer:v:ah",
+                    longopts, NULL)) != -1) {
+        switch (command) {
+            case 'i':
+                args->input_file = optarg;
+                break;
+            case 'c':
+                for (size_t i = 0; i < sizeof(codec_names) / sizeof(codec_names[0]); i++) {
+                    if (!strcmp(optarg, codec_names[i].name)) {
+                        args->codec = codec_names[i].codec;
+                        codec_set = true;
+                    }
+                }
+                if (!codec_set) {
+                    fprintf(stderr, "Unknown codec: %s\n", optarg);
+                    return -1;
+                }
+                break;
+            case 'm':
+                if (!strcmp(optarg, "FIX")) {
+                    args->read_mode = READ_MODE_FIX;
+                } else if (!strcmp(optarg, "ARBITRARY")) {
+                    args->read_mode = READ_MODE_ARBITRARY;
+                } else {
+                    fprintf(stderr, "Unknown read mode: %s\n", optarg);
+                    return -1;
+                }
+                break;
+            case 'b':
+                args->read_bytes = strtoul(optarg, NULL, 0);
+                break;
+            case 'f':
+                args->bufsize_file = optarg;
+                break;
+            case 's':
+                args->seed = strtoul(optarg, NULL, 0);
+                break;
+            case 'l':
+                args->nal_length = strtoul(optarg, NULL, 0);
+                break;
+            case 'B':
+                args->buffer_size = strtoul(optarg, NULL, 0);
+                break;
+            case 'n':
+                args->buffer_count = strtoul(optarg, NULL, 0);
+                break;
+            case 'z':
+                args->zero_copy = true;
+                break;
+            case 'e':
+                args->sei = true;
+                break;
+            case 'r':
+                args->repeat = strtoul(optarg, NULL, 0);
+                break;
+            case 'v':
+                debug_level = atoi(optarg);
+                break;
+            case 'a':
+                args->async_log = true;
+                break;
+            case 'h':
+            default:
+                return -1;
+        }
+    }
+
+    if (!args->input_file || !codec_set) {
+        fprintf(stderr, "Input file and codec are required\n");
+        return -1;
+    }
+    if (args->buffer_count < 2 || !args->buffer_size || !args->repeat) {
+        fprintf(stderr, "Need at least 2 buffers, a buffer size and a repeat count\n");
+        return -1;
+    }
+    if (!args->read_bytes)
+        args->read_bytes = args->buffer_size / 2;
+    if (args->read_bytes > args->buffer_size) {
+        fprintf(stderr, "read_bytes %u exceeds the buffer size, limiting\n",
+                (unsigned)args->read_bytes);
+        args->read_bytes = args->buffer_size;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    bench_args args;
+    bench_stats stats;
+    FILE *input = NULL;
+    FILE *sizes = NULL;
+    OMX_U8 *data = NULL;
+    long size;
+    int rc = -1;
+
+    memset(&args, 0, sizeof(args));
+    args.codec = CODEC_TYPE_H264;
+    args.read_mode = READ_MODE_FIX;
+    args.buffer_size = DEFAULT_BUFFER_SIZE;
+    args.buffer_count = DEFAULT_BUFFER_COUNT;
+    args.repeat = 1;
+    stats.bytes = stats.chunks = stats.aus = stats.au_bytes = 0;
+    stats.not_coded = stats.stream_changes = stats.elapsed_ns = 0;
+    memset(&stats.stream, 0, sizeof(stats.stream));
+    stats.instructions = 0;
+
+    if (parse_args(argc, argv, &args)) {
+        help();
+        return -1;
+    }
+
+    input = fopen(args.input_file, "rb");
+    if (!input) {
+        fprintf(stderr, "Failed to open %s\n", args.input_file);
+        return -1;
+    }
+    fseek(input, 0, SEEK_END);
+    size = ftell(input);
+    fseek(input, 0, SEEK_SET);
+    if (size <= 0 || size > UINT_MAX) {
+        fprintf(stderr, "Unsupported input size %ld\n", size);
+        goto exit;
+    }
+    data = (OMX_U8 *)malloc(size);
+    if (!data || fread(data, 1, size, input) != (size_t)size) {
+        fprintf(stderr, "Failed to read %s\n", args.input_file);
+        goto exit;
+    }
+    if (args.bufsize_file) {
+        sizes = fopen(args.bufsize_file, "r");
+        if (!sizes) {
+            fprintf(stderr, "Failed to open %s\n", args.bufsize_file);
+            goto exit;
+        }
+    }
+
+    srand(args.seed);
+    open_instruction_counter();
+    if (args.async_log)
+        vidc_log_set_async(true);
+    {
+        bench_client client(args, stats);
+
+        if (!client.init(data, (OMX_U32)size, sizes))
+            goto exit;
+        for (unsigned int i = 0; i < args.repeat; i++) {
+            if (client.run() != OMX_ErrorNone)
+                goto exit;
+        }
+    }
+    print_stats(args, stats);
+    rc = 0;
+
+exit:
+    if (args.async_log)
+        vidc_log_flush();
+    if (insn_fd >= 0)
+        close(insn_fd);
+    if (sizes)
+        fclose(sizes);
+    free(data);
+    fclose(input);
+    return rc;
+}
@@ -0,0 +1,351 @@
+/*
+ * Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * venc-map-cache-test: checks venc_map_cache, which the software encoder
+ * uses to keep meta mode input buffers mapped across ETBs. Temporary files
+ * stand in for the camera and gralloc buffers, each filled with its own
+ * byte pattern so a mapping of the wrong buffer or at the wrong offset shows
+ * up in the data.
+ *
+ * Covers repeat hits, offsets that are not page aligned, busy entries
+ * surviving eviction and clear(), a recycled fd number pointing at a new
+ * file, and the byte limit. The exit status is non zero on any failure.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "venc_map_cache.h"
+
+/* Byte at offset of the buffer filled with seed */
+static unsigned char pattern(unsigned int seed, size_t offset)
+{
+    return (unsigned char)(offset * 7 + (offset >> 8) + seed * 31);
+}
+
+/* Returns an fd of an unlinked file of len bytes filled with seed */
+static int open_buffer(size_t len, unsigned int seed)
+{
+    FILE *file = tmpfile();
+    unsigned char *data;
+    int fd;
+
+    if (!file)
+        return -1;
+    fd = dup(fileno(file));
+    fclose(file);
+    if (fd < 0)
+        return -1;
+    data = (unsigned char *)malloc(len);
+    if (!data) {
+        close(fd);
+        return -1;
+    }
+    for (size_t i = 0; i < len; i++)
+        data[i] = pattern(seed, i);
+    if (write(fd, data, len) != (ssize_t)len) {
+        close(fd);
+        fd = -1;
+    }
+    free(data);
+    return fd;
+}
+
+/* True if data holds size bytes of the buffer filled with seed at offset */
+static bool holds(const void *data, unsigned int seed, size_t offset, size_t size)
+{
+    const unsigned char *bytes = (const unsigned char *)data;
+
+    if (!data)
+        return false;
+    for (size_t i = 0; i < size; i++)
+        if (bytes[i] != pattern(seed, offset + i))
+            return false;
+    return true;
+}
+
+static int check(bool ok, const char *what)
+{
+    printf("%-52s: %s\n", what, ok ? "ok" : "FAILED");
+    return ok ? 0 : -1;
+}
+
+static int test_repeat_hits(size_t page)
+{
+    venc_map_cache cache;
+    struct venc_map_stats stats;
+    int fd = open_buffer(4 * page, 1);
+    void *first, *again;
+    int ret = 0;
+
+    first = cache.acquire(fd, 0, 4 * page);
+    cache.release(first);
+    again = cache.acquire(fd, 0, 4 * page);
+    cache.get_stats(&stats);
+    ret |= check(first && again == first && holds(again, 1, 0, 4 * page),
+            "repeat acquire served from the cache");
+    ret |= check(stats.hits == 1 && stats.misses == 1 && stats.live_maps == 1,
+            "one miss, then hits");
+
+    /* Holding the buffer does not stop another user of it hitting */
+    void *shared = cache.acquire(fd, 0, 4 * page);
+    cache.get_stats(&stats);
+    ret |= check(shared == first && stats.hits == 2, "busy entry shared by a second acquire");
+    ret |= check(cache.release(again) && cache.release(shared) && !cache.release(shared),
+            "release() once per acquire");
+
+    /* Another size or offset of the same fd is a different mapping */
+    void *smaller = cache.acquire(fd, 0, 2 * page);
+    cache.get_stats(&stats);
+    ret |= check(smaller && stats.misses == 2 && stats.live_maps == 2,
+            "other size of the same fd mapped separately");
+    cache.release(smaller);
+    close(fd);
+    return ret;
+}
+
+static int test_unaligned_offsets(size_t page)
+{
+    venc_map_cache cache;
+    struct venc_map_stats stats;
+    int fd = open_buffer(8 * page, 2);
+    const off_t offsets[] = { 100, (off_t)page + 37, 3 * (off_t)page - 1 };
+    size_t bytes = 0;
+    int ret = 0;
+
+    for (size_t i = 0; i < sizeof(offsets) / sizeof(offsets[0]); i++) {
+        void *data = cache.acquire(fd, offsets[i], 2 * page);
+        char what[64];
+
+        snprintf(what, sizeof(what), "data at unaligned offset %ld", (long)offsets[i]);
+        ret |= check(holds(data, 2, offsets[i], 2 * page), what);
+        bytes += 2 * page + offsets[i] % page;
+        cache.release(data);
+    }
+    cache.get_stats(&stats);
+    ret |= check(stats.live_bytes == bytes, "mapped bytes include the page offset");
+    ret |= check(!cache.acquire(fd, -1, page) && !cache.acquire(fd, 0, 0) &&
+            !cache.acquire(-1, 0, page), "bad fd, offset or size refused");
+    close(fd);
+    return ret;
+}
+
+static int test_busy_eviction(size_t page)
+{
+    venc_map_cache cache(2);
+    struct venc_map_stats stats;
+    int fds[3];
+    void *held, *idle, *third, *none;
+    int ret = 0;
+
+    for (int i = 0; i < 3; i++)
+        fds[i] = open_buffer(page, 10 + i);
+
+    held = cache.acquire(fds[0], 0, page);
+    idle = cache.acquire(fds[1], 0, page);
+    cache.release(idle);
+    third = cache.acquire(fds[2], 0, page);
+    cache.get_stats(&stats);
+    ret |= check(third && stats.evictions == 1 && holds(held, 10, 0, page),
+            "full cache evicts the idle entry, not the busy one");
+
+    none = cache.acquire(fds[1], 0, page);
+    cache.get_stats(&stats);
+    ret |= check(!none && stats.failures == 1 && holds(held, 10, 0, page) &&
+            holds(third, 12, 0, page), "every entry busy: acquire fails, nothing unmapped");
+
+    cache.release(third);
+    none = cache.acquire(fds[1], 0, page);
+    ret |= check(holds(none, 11, 0, page), "entry reused once released");
+    cache.release(none);
+    cache.release(held);
+    for (int i = 0; i < 3; i++)
+        close(fds[i]);
+    return ret;
+}
+
+static int test_busy_clear(size_t page)
+{
+    venc_map_cache cache;
+    struct venc_map_stats stats;
+    int busy_fd = open_buffer(page, 20), idle_fd = open_buffer(page, 21);
+    void *busy, *idle, *again;
+    int ret = 0;
+
+    busy = cache.acquire(busy_fd, 0, page);
+    idle = cache.acquire(idle_fd, 0, page);
+    cache.release(idle);
+    cache.clear();
+    cache.get_stats(&stats);
+    ret |= check(stats.live_maps == 1 && holds(busy, 20, 0, page),
+            "clear() keeps a busy mapping until its release");
+
+    /* The doomed entry is not handed out again */
+    again = cache.acquire(busy_fd, 0, page);
+    cache.get_stats(&stats);
+    ret |= check(again && again != busy && stats.hits == 0 && holds(again, 20, 0, page),
+            "cleared busy entry not served again");
+    cache.release(busy);
+    cache.release(again);
+    cache.clear();
+    cache.get_stats(&stats);
+    ret |= check(!stats.live_maps && !stats.live_bytes, "last release() unmaps it");
+    close(busy_fd);
+    close(idle_fd);
+    return ret;
+}
+
+static int test_fd_reuse(size_t page)
+{
+    venc_map_cache cache;
+    struct venc_map_stats stats;
+    int fd = open_buffer(page, 30), other;
+    void *old_data, *new_data, *held;
+    int ret = 0;
+
+    old_data = cache.acquire(fd, 0, page);
+    cache.release(old_data);
+
+    /* Free the buffer and let a new file take over its fd number */
+    other = open_buffer(page, 31);
+    close(fd);
+    if (other < 0 || dup2(other, fd) != fd) {
+        close(other);
+        return check(false, "recycled fd gets a new mapping");
+    }
+    close(other);
+    new_data = cache.acquire(fd, 0, page);
+    cache.get_stats(&stats);
+    ret |= check(holds(new_data, 31, 0, page) && stats.invalidations == 1,
+            "recycled fd gets a new mapping");
+
+    /* Same again while the old buffer is still being read */
+    other = open_buffer(page, 32);
+    held = new_data;
+    if (other < 0 || dup2(other, fd) != fd) {
+        close(other);
+        return ret | check(false, "busy mapping of a recycled fd kept");
+    }
+    close(other);
+    new_data = cache.acquire(fd, 0, page);
+    cache.get_stats(&stats);
+    ret |= check(holds(new_data, 32, 0, page) && holds(held, 31, 0, page) &&
+            stats.invalidations == 2, "busy mapping of a recycled fd kept");
+    cache.release(held);
+    cache.release(new_data);
+    cache.get_stats(&stats);
+    ret |= check(stats.live_maps == 1, "stale mapping dropped on its release");
+    close(fd);
+    return ret;
+}
+
+static int test_byte_cap(size_t page)
+{
+    venc_map_cache cache(VENC_MAP_CACHE_SIZE, 3 * page);
+    struct venc_map_stats stats;
+    int fds[5];
+    void *data[5];
+    int ret = 0;
+
+    for (int i = 0; i < 5; i++)
+        fds[i] = open_buffer(page, 40 + i);
+
+    for (int i = 0; i < 5; i++) {
+        data[i] = cache.acquire(fds[i], 0, page);
+        cache.release(data[i]);
+    }
+    cache.get_stats(&stats);
+    ret |= check(stats.live_bytes <= 3 * page && stats.peak_bytes <= 3 * page &&
+            stats.evictions == 2, "idle entries evicted to stay under the byte limit");
+    void *hit = cache.acquire(fds[4], 0, page);
+    data[0] = cache.acquire(fds[0], 0, page);
+    cache.get_stats(&stats);
+    ret |= check(hit == data[4] && data[0] && stats.evictions == 3,
+            "least recently used entries evicted first");
+
+    /* Busy mappings are never dropped for the limit, the cache goes over */
+    for (int i = 1; i < 4; i++)
+        data[i] = cache.acquire(fds[i], 0, page);
+    cache.get_stats(&stats);
+    ret |= check(stats.live_maps == 5 && stats.live_bytes == 5 * page,
+            "busy entries kept over the byte limit");
+    bool intact = true;
+    for (int i = 0; i < 5; i++)
+        intact = intact && holds(data[i], 40 + i, 0, page);
+    ret |= check(intact, "busy data intact");
+    for (int i = 0; i < 5; i++) {
+        cache.release(data[i]);
+        close(fds[i]);
+    }
+    return ret;
+}
+
+static void help()
+{
+    printf("\n\n");
+    printf("=============================\n");
+    printf("venc-map-cache-test [options]\n");
+    printf("=============================\n\n");
+    printf("      -h, --help             Print this menu\n");
+    printf("=============================\n\n\n");
+}
+
+int main(int argc, char **argv)
+{
+    struct option longopts[] = {
+        { "help",    no_argument,       NULL, 'h'},
+        { NULL,      0,                 NULL,  0},
+    };
+    long page = sysconf(_SC_PAGESIZE);
+    int command, ret = 0;
+
+    while ((command = getopt_long(argc, argv, "h", longopts, NULL)) != -1) {
+        switch (command) {
+            case 'h':
+            default:
+                help();
+                return -1;
+        }
+    }
+    if (page <= 0)
+        page = 4096;
+
+    ret |= test_repeat_hits(page);
+    ret |= test_unaligned_offsets(page);
+    ret |= test_busy_eviction(page);
+    ret |= test_busy_clear(page);
+    ret |= test_fd_reuse(page);
+    ret |= test_byte_cap(page);
+    printf("%s\n", ret ? "FAILED" : "All checks passed");
+    return ret ? 1 : 0;
+}
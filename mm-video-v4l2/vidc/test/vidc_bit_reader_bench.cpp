@@ -0,0 +1,751 @@
+/*
+ * Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * vidc-bit-reader-bench: checks vidc_bit_reader against the readers it
+ * replaced and times both. The old readers are kept below as they were:
+ * the word reader of h264_stream_parser (RBSP with emulation prevention
+ * enabled, raw without), the byte cursor of RbspParser (NAL) and
+ * MP4_Utils::read_bit_field (raw, fixed length fields only).
+ *
+ * The fuzz pass writes random u(n)/ue(v)/se(v) traces with emulation
+ * prevention, reads them back with every reader and compares against the
+ * written values, then reads random bytes heavy in 00 00 03 with random
+ * traces and compares the readers with each other. The timed pass reads
+ * SEI/VUI shaped traces: mostly flags and short Exp-Golomb codes with the
+ * odd 32 bit timing field.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#include <vector>
+#include "vidc_bit_reader.h"
+
+typedef std::vector<uint8_t> bytes;
+
+enum element_kind {
+    ELEM_U,
+    ELEM_UE,
+    ELEM_SE,
+};
+
+struct element {
+    element_kind kind;
+    uint32_t bits;      // ELEM_U only
+    uint32_t value;     // se(v) values stored as int32_t
+};
+
+/* h264_stream_parser::extract_bits/read_word/uev/sev before vidc_bit_reader */
+class legacy_word_reader
+{
+    public:
+        legacy_word_reader(const uint8_t *data, uint32_t size, bool emulation) :
+            bitstream(data), bitstream_bytes(size), curr_32_bit(0), bits_read(0),
+            zero_cntr(0), emulation_sc_enabled(emulation) {}
+
+        uint32_t extract_bits(uint32_t n) {
+            uint32_t value = shr(curr_32_bit, 32 - n);
+            if (bits_read < n) {
+                n -= bits_read;
+                read_word();
+                value |= shr(curr_32_bit, 32 - n);
+                if (bits_read < n) {
+                    value = shr(value, n - bits_read);
+                    n = bits_read;
+                }
+            }
+            bits_read -= n;
+            curr_32_bit = shl(curr_32_bit, n);
+            return value;
+        }
+        uint32_t uev() {
+            uint32_t lead_zero_bits = 0;
+            while (!extract_bits(1) && more_bits())
+                lead_zero_bits++;
+            return lead_zero_bits == 0 ? 0 :
+                shl(1, lead_zero_bits) - 1 + extract_bits(lead_zero_bits);
+        }
+        int32_t sev() {
+            uint32_t code_num = uev();
+            int32_t ret = (code_num + 1) >> 1;
+            return (code_num & 1) ? ret : -ret;
+        }
+        bool more_bits() const {
+            return bitstream_bytes > 0 || bits_read > 0;
+        }
+        uint32_t bytes_left() const {
+            return bitstream_bytes;
+        }
+
+    private:
+        // The original shifted by whatever count it had: 32 for a zero bit
+        // read or a word with no bits left, more than 32 (or 32 - n gone
+        // negative) for codes over 32 bits, and it built 1 << 32 as an int.
+        // Those are undefined; ARM takes the count from its bottom byte and
+        // gives 0, x86 masks it to 5 bits. Spell out the ARM result for any
+        // count of 32 and up.
+        static uint32_t shr(uint32_t x, uint32_t n) {
+            return n < 32 ? x >> n : 0;
+        }
+        static uint32_t shl(uint32_t x, uint32_t n) {
+            return n < 32 ? x << n : 0;
+        }
+
+        void read_word() {
+            curr_32_bit = 0;
+            bits_read = 0;
+            while (bitstream_bytes && bits_read < 32) {
+                if (*bitstream == 0x03 && zero_cntr >= 2 && emulation_sc_enabled) {
+                    // skipped
+                } else {
+                    curr_32_bit <<= 8;
+                    curr_32_bit |= *bitstream;
+                    bits_read += 8;
+                }
+                if (*bitstream == 0)
+                    zero_cntr++;
+                else
+                    zero_cntr = 0;
+                bitstream++;
+                bitstream_bytes--;
+            }
+            curr_32_bit = shl(curr_32_bit, 32 - bits_read);
+        }
+
+        const uint8_t *bitstream;
+        uint32_t bitstream_bytes;
+        uint32_t curr_32_bit;
+        uint32_t bits_read;
+        uint32_t zero_cntr;
+        bool emulation_sc_enabled;
+};
+
+/* RbspParser before vidc_bit_reader */
+class legacy_rbsp_parser
+{
+    public:
+        legacy_rbsp_parser(const uint8_t *_begin, const uint8_t *_end) :
+            begin(_begin), end(_end), pos(-1), bit(0), cursor(0xFFFFFF),
+            advanceNeeded(true), pastEnd(false) {}
+
+        uint32_t u(uint32_t n) {
+            uint32_t i, s, x = 0;
+            for (i = 0; i < n; i += s) {
+                s = 8 - bit < n - i ? 8 - bit : n - i;
+                x <<= s;
+                x |= ((next() >> ((8 - bit) - s)) & ((1 << s) - 1));
+                bit = (bit + s) % 8;
+                if (!bit)
+                    advanceNeeded = true;
+            }
+            return x;
+        }
+        uint32_t ue() {
+            int leadingZeroBits = -1;
+            for (uint32_t b = 0; !b; ++leadingZeroBits) {
+                if (leadingZeroBits >= 31) {
+                    pastEnd = true;
+                    return 0;
+                }
+                b = u(1);
+            }
+            return ((1u << leadingZeroBits) - 1) + u(leadingZeroBits);
+        }
+        int32_t se() {
+            const uint32_t x = ue();
+            if (!x) return 0;
+            else if (x & 1) return (int32_t)((x >> 1) + 1);
+            else return -(int32_t)(x >> 1);
+        }
+        bool overrun() const {
+            return pastEnd;
+        }
+
+    private:
+        uint32_t next() {
+            if (advanceNeeded) advance();
+            return cursor & 0xFF;
+        }
+        void advance() {
+            ++pos;
+            cursor <<= 8;
+            advanceNeeded = false;
+            if (pastEnd || begin + pos >= end) {
+                pastEnd = true;
+                return;
+            }
+            cursor |= begin[pos];
+            if ((cursor & 0xFFFFFF) == 0x000003) {
+                advance();
+            } else if ((cursor & 0xFFFFFE) == 0x000000) {
+                cursor &= ~0xFF;
+                pastEnd = true;
+            }
+        }
+
+        const uint8_t *begin, *end;
+        int32_t pos;
+        uint32_t bit;
+        uint32_t cursor;
+        bool advanceNeeded;
+        bool pastEnd;
+};
+
+/* MP4_Utils::read_bit_field before vidc_bit_reader. Reads four bytes at
+   the current position whatever the field size, so the data needs three
+   bytes of padding. */
+struct legacy_mp4_pos {
+    const uint8_t *bytePtr;
+    uint32_t bitPos;
+};
+
+static uint32_t legacy_read_bit_field(legacy_mp4_pos *posPtr, uint32_t size)
+{
+    const uint8_t *bits = &posPtr->bytePtr[0];
+    uint32_t bitBuf = (bits[0] << 24) | (bits[1] << 16) | (bits[2] << 8) | bits[3];
+    uint32_t value = (bitBuf >> (32 - posPtr->bitPos - size)) &
+        (size == 32 ? 0xFFFFFFFF : (1u << size) - 1);
+
+    posPtr->bitPos += size;
+    while (posPtr->bitPos >= 8) {
+        posPtr->bitPos -= 8;
+        posPtr->bytePtr++;
+    }
+    return value;
+}
+
+static uint32_t rng_state = 1;
+
+static uint32_t rnd()
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static uint32_t rnd(uint32_t n)
+{
+    return rnd() % n;
+}
+
+class bit_writer
+{
+    public:
+        bit_writer() : acc(0), accbits(0) {}
+
+        void put(uint32_t value, uint32_t n) {
+            for (uint32_t i = n; i > 0; i--) {
+                acc = (acc << 1) | ((value >> (i - 1)) & 1);
+                if (++accbits == 8) {
+                    out.push_back((uint8_t)acc);
+                    acc = 0;
+                    accbits = 0;
+                }
+            }
+        }
+        void put_ue(uint32_t value) {
+            uint64_t code = (uint64_t)value + 1;
+            uint32_t len = 64 - __builtin_clzll(code);
+            put(0, len - 1);
+            if (len > 32) {
+                put((uint32_t)(code >> 32), len - 32);
+                put((uint32_t)code, 32);
+            } else {
+                put((uint32_t)code, len);
+            }
+        }
+        void put_se(int32_t value) {
+            put_ue(value > 0 ? 2 * (uint32_t)value - 1 : -2 * (int64_t)value);
+        }
+        /* rbsp_trailing_bits */
+        bytes finish() {
+            put(1, 1);
+            while (accbits)
+                put(0, 1);
+            return out;
+        }
+
+    private:
+        bytes out;
+        uint32_t acc, accbits;
+};
+
+static bytes add_emulation_prevention(const bytes &rbsp)
+{
+    bytes nal;
+    uint32_t zeros = 0;
+
+    for (size_t i = 0; i < rbsp.size(); i++) {
+        if (zeros >= 2 && rbsp[i] <= 3) {
+            nal.push_back(3);
+            zeros = 0;
+        }
+        nal.push_back(rbsp[i]);
+        zeros = rbsp[i] ? 0 : zeros + 1;
+    }
+    return nal;
+}
+
+static bytes write_trace(const std::vector<element> &trace)
+{
+    bit_writer w;
+
+    for (size_t i = 0; i < trace.size(); i++) {
+        if (trace[i].kind == ELEM_U)
+            w.put(trace[i].value, trace[i].bits);
+        else if (trace[i].kind == ELEM_UE)
+            w.put_ue(trace[i].value);
+        else
+            w.put_se((int32_t)trace[i].value);
+    }
+    return w.finish();
+}
+
+/* Random values, with runs of zero bits so emulation prevention is hit */
+static std::vector<element> random_trace(uint32_t count, uint32_t max_u_bits)
+{
+    std::vector<element> trace(count);
+
+    for (uint32_t i = 0; i < count; i++) {
+        element &e = trace[i];
+        uint32_t value_bits = rnd(4) ? rnd(12) : rnd(33);
+
+        e.kind = (element_kind)rnd(3);
+        e.bits = 1 + rnd(max_u_bits);
+        e.value = rnd(4) ? rnd() : 0;
+        if (e.kind == ELEM_U) {
+            if (e.bits < 32)
+                e.value &= (1u << e.bits) - 1;
+        } else {
+            // ue(v) stays below 2^32 - 1, the longest code the readers share
+            if (value_bits > 31)
+                value_bits = 31;
+            e.value &= (1u << value_bits) - 1;
+            if (e.kind == ELEM_SE) {
+                e.value >>= 1;
+                if (rnd(2))
+                    e.value = (uint32_t)-(int32_t)e.value;
+            }
+        }
+    }
+    return trace;
+}
+
+/* The fields of vui_parameters with nal_hrd_parameters, then a buffering
+   period and a pic timing SEI message, in bitstream order */
+static const struct {
+    element_kind kind;
+    uint32_t bits;
+} header_layout[] = {
+    { ELEM_U, 1 }, { ELEM_U, 8 }, { ELEM_U, 1 }, { ELEM_U, 1 }, { ELEM_U, 3 },
+    { ELEM_U, 1 }, { ELEM_U, 1 }, { ELEM_U, 8 }, { ELEM_U, 8 }, { ELEM_U, 8 },
+    { ELEM_U, 1 }, { ELEM_UE, 0 }, { ELEM_UE, 0 }, { ELEM_U, 1 }, { ELEM_U, 32 },
+    { ELEM_U, 32 }, { ELEM_U, 1 }, { ELEM_U, 1 }, { ELEM_UE, 0 }, { ELEM_U, 4 },
+    { ELEM_U, 4 }, { ELEM_UE, 0 }, { ELEM_UE, 0 }, { ELEM_U, 1 }, { ELEM_U, 5 },
+    { ELEM_U, 5 }, { ELEM_U, 5 }, { ELEM_U, 5 }, { ELEM_U, 1 }, { ELEM_U, 1 },
+    { ELEM_U, 1 }, { ELEM_U, 1 }, { ELEM_U, 1 }, { ELEM_UE, 0 }, { ELEM_UE, 0 },
+    { ELEM_UE, 0 }, { ELEM_UE, 0 }, { ELEM_UE, 0 }, { ELEM_UE, 0 },
+    { ELEM_U, 8 }, { ELEM_U, 8 }, { ELEM_UE, 0 }, { ELEM_U, 24 }, { ELEM_U, 24 },
+    { ELEM_U, 8 }, { ELEM_U, 8 }, { ELEM_U, 24 }, { ELEM_U, 24 }, { ELEM_U, 4 },
+    { ELEM_U, 1 }, { ELEM_U, 2 }, { ELEM_U, 1 }, { ELEM_U, 5 }, { ELEM_U, 1 },
+    { ELEM_U, 1 }, { ELEM_U, 1 }, { ELEM_U, 8 }, { ELEM_SE, 0 }, { ELEM_U, 1 },
+};
+
+/* SEI/VUI shaped: the layout above over and over with random values, flags
+   mostly clear and small Exp-Golomb codes. With fixed_only the Exp-Golomb
+   fields become u(5) and the 32 bit ones u(24), the most
+   MP4_Utils::read_bit_field reads at any bit position. */
+static std::vector<element> header_trace(uint32_t count, bool fixed_only)
+{
+    const uint32_t layout_size = sizeof(header_layout) / sizeof(header_layout[0]);
+    std::vector<element> trace(count);
+
+    for (uint32_t i = 0; i < count; i++) {
+        element &e = trace[i];
+
+        e.kind = header_layout[i % layout_size].kind;
+        e.bits = header_layout[i % layout_size].bits;
+        if (fixed_only && e.kind != ELEM_U) {
+            e.kind = ELEM_U;
+            e.bits = 5;
+        } else if (fixed_only && e.bits > 25) {
+            e.bits = 24;
+        }
+        if (e.kind == ELEM_UE) {
+            e.value = rnd(4) ? rnd(8) : rnd(256);
+        } else if (e.kind == ELEM_SE) {
+            e.value = (uint32_t)((int32_t)rnd(64) - 32);
+        } else if (e.bits == 1) {
+            e.value = rnd(10) < 3;
+        } else {
+            e.value = rnd() & (e.bits == 32 ? 0xFFFFFFFF : (1u << e.bits) - 1);
+            if (rnd(4) == 0)
+                e.value = 0;
+        }
+    }
+    return trace;
+}
+
+template <class reader>
+static uint32_t read_new(reader &r, const element &e)
+{
+    if (e.kind == ELEM_U)
+        return r.read_bits(e.bits);
+    if (e.kind == ELEM_UE)
+        return r.read_ue();
+    return (uint32_t)r.read_se();
+}
+
+static uint32_t read_legacy(legacy_word_reader &r, const element &e)
+{
+    if (e.kind == ELEM_U)
+        return r.extract_bits(e.bits);
+    if (e.kind == ELEM_UE)
+        return r.uev();
+    return (uint32_t)r.sev();
+}
+
+static uint32_t read_legacy(legacy_rbsp_parser &r, const element &e)
+{
+    if (e.kind == ELEM_U)
+        return r.u(e.bits);
+    if (e.kind == ELEM_UE)
+        return r.ue();
+    return (uint32_t)r.se();
+}
+
+static const char *kind_name(const element &e)
+{
+    return e.kind == ELEM_U ? "u" : e.kind == ELEM_UE ? "ue" : "se";
+}
+
+static bool report_mismatch(const char *what, uint32_t iteration, size_t index,
+        const element &e, uint32_t expected, uint32_t got)
+{
+    fprintf(stderr, "MISMATCH %s: iteration %u element %zu %s(%u) expected 0x%x got 0x%x\n",
+            what, iteration, index, kind_name(e), e.kind == ELEM_U ? e.bits : 0,
+            expected, got);
+    return false;
+}
+
+/* Written traces: every reader has to return the written values */
+static bool fuzz_written(uint32_t iteration)
+{
+    std::vector<element> trace = random_trace(1 + rnd(300), 32);
+    std::vector<element> fixed = random_trace(1 + rnd(300), 25);
+    bytes rbsp = write_trace(trace);
+    bytes nal = add_emulation_prevention(rbsp);
+    vidc_bit_reader<VIDC_BITS_RAW> raw(&rbsp[0], rbsp.size());
+    vidc_bit_reader<VIDC_BITS_RBSP> rbsp_reader(&nal[0], nal.size());
+    vidc_bit_reader<VIDC_BITS_NAL> nal_reader(&nal[0], nal.size());
+    legacy_word_reader old_raw(&rbsp[0], rbsp.size(), false);
+    legacy_word_reader old_rbsp(&nal[0], nal.size(), true);
+    legacy_rbsp_parser old_nal(&nal[0], &nal[0] + nal.size());
+    uint32_t got;
+
+    for (size_t i = 0; i < trace.size(); i++) {
+        const element &e = trace[i];
+        if ((got = read_new(raw, e)) != e.value)
+            return report_mismatch("raw", iteration, i, e, e.value, got);
+        if ((got = read_new(rbsp_reader, e)) != e.value)
+            return report_mismatch("rbsp", iteration, i, e, e.value, got);
+        if ((got = read_new(nal_reader, e)) != e.value)
+            return report_mismatch("nal", iteration, i, e, e.value, got);
+        if ((got = read_legacy(old_raw, e)) != e.value)
+            return report_mismatch("legacy raw", iteration, i, e, e.value, got);
+        if ((got = read_legacy(old_rbsp, e)) != e.value)
+            return report_mismatch("legacy rbsp", iteration, i, e, e.value, got);
+        if ((got = read_legacy(old_nal, e)) != e.value)
+            return report_mismatch("legacy nal", iteration, i, e, e.value, got);
+    }
+    if (raw.overrun() || rbsp_reader.overrun() || nal_reader.overrun() ||
+            rbsp_reader.epb_count() != nal.size() - rbsp.size()) {
+        fprintf(stderr, "MISMATCH: iteration %u overrun or emulation prevention count\n",
+                iteration);
+        return false;
+    }
+
+    for (size_t i = 0; i < fixed.size(); i++) {
+        fixed[i].kind = ELEM_U;
+        fixed[i].value &= (1u << fixed[i].bits) - 1;
+    }
+    rbsp = write_trace(fixed);
+    rbsp.resize(rbsp.size() + 3);
+    raw.init(&rbsp[0], rbsp.size());
+    legacy_mp4_pos pos = { &rbsp[0], 0 };
+    for (size_t i = 0; i < fixed.size(); i++) {
+        const element &e = fixed[i];
+        if ((got = legacy_read_bit_field(&pos, e.bits)) != e.value)
+            return report_mismatch("legacy mp4", iteration, i, e, e.value, got);
+        if ((got = raw.read_bits(e.bits)) != e.value)
+            return report_mismatch("mp4", iteration, i, e, e.value, got);
+        if (raw.byte_position() != pos.bytePtr)
+            return report_mismatch("mp4 position", iteration, i, e,
+                    pos.bytePtr - &rbsp[0], raw.byte_position() - &rbsp[0]);
+    }
+    return true;
+}
+
+/* Random bytes: the new readers have to agree with the old ones until the
+   old ones run out of data or hit a code longer than 31 bits */
+static bool fuzz_random(uint32_t iteration)
+{
+    static const uint8_t picks[] = { 0x00, 0x00, 0x00, 0x03, 0x01, 0x80, 0xFF };
+    uint32_t size = 1 + rnd(256);
+    std::vector<element> trace = random_trace(4 * size, 32);
+    bytes data(size);
+    uint32_t got, want;
+
+    for (uint32_t i = 0; i < size; i++)
+        data[i] = rnd(2) ? picks[rnd(sizeof(picks))] : (uint8_t)rnd();
+
+    for (int emulation = 0; emulation < 2; emulation++) {
+        legacy_word_reader old_reader(&data[0], size, emulation);
+        vidc_bit_reader<VIDC_BITS_RAW> raw(&data[0], size);
+        vidc_bit_reader<VIDC_BITS_RBSP> rbsp(&data[0], size);
+
+        for (size_t i = 0; i < trace.size() && old_reader.bytes_left() >= 12; i++) {
+            const element &e = trace[i];
+            want = read_legacy(old_reader, e);
+            got = emulation ? read_new(rbsp, e) : read_new(raw, e);
+            if (emulation ? rbsp.overrun() : raw.overrun())
+                break;
+            if (got != want)
+                return report_mismatch(emulation ? "random rbsp" : "random raw",
+                        iteration, i, e, want, got);
+        }
+    }
+
+    legacy_rbsp_parser old_nal(&data[0], &data[0] + size);
+    vidc_bit_reader<VIDC_BITS_NAL> nal(&data[0], size);
+    for (size_t i = 0; i < trace.size(); i++) {
+        const element &e = trace[i];
+        want = read_legacy(old_nal, e);
+        got = read_new(nal, e);
+        if (old_nal.overrun() != nal.overrun()) {
+            fprintf(stderr, "MISMATCH random nal: iteration %u element %zu overrun %d/%d\n",
+                    iteration, i, old_nal.overrun(), nal.overrun());
+            return false;
+        }
+        if (nal.overrun())
+            break;
+        if (got != want)
+            return report_mismatch("random nal", iteration, i, e, want, got);
+    }
+    return true;
+}
+
+static unsigned long long now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void report(const char *name, unsigned long long ns, uint32_t elements,
+        size_t size, uint32_t repeat, uint32_t sum, uint32_t expected_sum)
+{
+    double per = (double)ns / repeat;
+
+    printf("  %-22s %7.2f ns/element %8.1f MB/s %s\n", name, per / elements,
+            size / per * 1e3, sum == expected_sum ? "" : "MISMATCH");
+}
+
+template <vidc_bit_reader_mode mode>
+static uint32_t time_new(const bytes &data, const std::vector<element> &trace,
+        uint32_t repeat, unsigned long long &ns)
+{
+    uint32_t sum = 0;
+    unsigned long long start = now_ns();
+
+    for (uint32_t r = 0; r < repeat; r++) {
+        vidc_bit_reader<mode> reader(&data[0], data.size());
+        for (size_t i = 0; i < trace.size(); i++)
+            sum += read_new(reader, trace[i]);
+    }
+    ns = now_ns() - start;
+    return sum;
+}
+
+static uint32_t time_legacy(const bytes &data, const std::vector<element> &trace,
+        uint32_t repeat, bool emulation, unsigned long long &ns)
+{
+    uint32_t sum = 0;
+    unsigned long long start = now_ns();
+
+    for (uint32_t r = 0; r < repeat; r++) {
+        legacy_word_reader reader(&data[0], data.size(), emulation);
+        for (size_t i = 0; i < trace.size(); i++)
+            sum += read_legacy(reader, trace[i]);
+    }
+    ns = now_ns() - start;
+    return sum;
+}
+
+static uint32_t time_legacy_nal(const bytes &data, const std::vector<element> &trace,
+        uint32_t repeat, unsigned long long &ns)
+{
+    uint32_t sum = 0;
+    unsigned long long start = now_ns();
+
+    for (uint32_t r = 0; r < repeat; r++) {
+        legacy_rbsp_parser reader(&data[0], &data[0] + data.size());
+        for (size_t i = 0; i < trace.size(); i++)
+            sum += read_legacy(reader, trace[i]);
+    }
+    ns = now_ns() - start;
+    return sum;
+}
+
+static uint32_t time_legacy_mp4(const bytes &data, const std::vector<element> &trace,
+        uint32_t repeat, unsigned long long &ns)
+{
+    uint32_t sum = 0;
+    unsigned long long start = now_ns();
+
+    for (uint32_t r = 0; r < repeat; r++) {
+        legacy_mp4_pos pos = { &data[0], 0 };
+        for (size_t i = 0; i < trace.size(); i++)
+            sum += legacy_read_bit_field(&pos, trace[i].bits);
+    }
+    ns = now_ns() - start;
+    return sum;
+}
+
+static uint32_t expected_sum(const std::vector<element> &trace, uint32_t repeat)
+{
+    uint32_t sum = 0;
+
+    for (size_t i = 0; i < trace.size(); i++)
+        sum += trace[i].value;
+    return sum * repeat;
+}
+
+static void run_timing(uint32_t elements, uint32_t repeat)
+{
+    std::vector<element> trace = header_trace(elements, false);
+    std::vector<element> fixed = header_trace(elements, true);
+    bytes rbsp = write_trace(trace);
+    bytes nal = add_emulation_prevention(rbsp);
+    bytes mp4 = write_trace(fixed);
+    uint32_t expected = expected_sum(trace, repeat), sum;
+    unsigned long long ns;
+
+    mp4.resize(mp4.size() + 3);
+    printf("SEI/VUI shaped trace, %u elements, %zu bytes, %zu emulation prevention bytes, "
+            "%u runs\n", elements, nal.size(), nal.size() - rbsp.size(), repeat);
+
+    sum = time_legacy(nal, trace, repeat, true, ns);
+    report("rbsp legacy", ns, elements, nal.size(), repeat, sum, expected);
+    sum = time_new<VIDC_BITS_RBSP>(nal, trace, repeat, ns);
+    report("rbsp vidc_bit_reader", ns, elements, nal.size(), repeat, sum, expected);
+
+    sum = time_legacy_nal(nal, trace, repeat, ns);
+    report("nal legacy", ns, elements, nal.size(), repeat, sum, expected);
+    sum = time_new<VIDC_BITS_NAL>(nal, trace, repeat, ns);
+    report("nal vidc_bit_reader", ns, elements, nal.size(), repeat, sum, expected);
+
+    sum = time_legacy(rbsp, trace, repeat, false, ns);
+    report("raw legacy", ns, elements, rbsp.size(), repeat, sum, expected);
+    sum = time_new<VIDC_BITS_RAW>(rbsp, trace, repeat, ns);
+    report("raw vidc_bit_reader", ns, elements, rbsp.size(), repeat, sum, expected);
+
+    expected = expected_sum(fixed, repeat);
+    sum = time_legacy_mp4(mp4, fixed, repeat, ns);
+    report("mp4 read_bit_field", ns, elements, mp4.size(), repeat, sum, expected);
+    sum = time_new<VIDC_BITS_RAW>(mp4, fixed, repeat, ns);
+    report("mp4 vidc_bit_reader", ns, elements, mp4.size(), repeat, sum, expected);
+}
+
+static void help()
+{
+    printf("\n\n");
+    printf("=============================\n");
+    printf("vidc-bit-reader-bench [options]\n");
+    printf("=============================\n\n");
+    printf("      -f, --fuzz <#>         Fuzz iterations, 0 to skip (default 20000)\n");
+    printf("      -s, --seed <#>         Fuzz and trace seed (default 1)\n");
+    printf("      -n, --elements <#>     Elements in the timed trace, 0 to skip (default 100000)\n");
+    printf("      -r, --repeat <#>       Timed runs over the trace (default 50)\n");
+    printf("      -h, --help             Print this menu\n");
+    printf("=============================\n\n\n");
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t iterations = 20000, seed = 1, elements = 100000, repeat = 50;
+    struct option longopts[] = {
+        { "fuzz",     required_argument, NULL, 'f'},
+        { "seed",     required_argument, NULL, 's'},
+        { "elements", required_argument, NULL, 'n'},
+        { "repeat",   required_argument, NULL, 'r'},
+        { "help",     no_argument,       NULL, 'h'},
+        { NULL,       0,                 NULL,  0},
+    };
+    int command;
+
+    while ((command = getopt_long(argc, argv, "f:s:n:r:h", longopts, NULL)) != -1) {
+        switch (command) {
+            case 'f':
+                iterations = strtoul(optarg, NULL, 0);
+                break;
+            case 's':
+                seed = strtoul(optarg, NULL, 0);
+                break;
+            case 'n':
+                elements = strtoul(optarg, NULL, 0);
+                break;
+            case 'r':
+                repeat = strtoul(optarg, NULL, 0);
+                break;
+            default:
+                help();
+                return -1;
+        }
+    }
+    if (!seed || !repeat) {
+        help();
+        return -1;
+    }
+
+    rng_state = seed;
+    for (uint32_t i = 0; i < iterations; i++)
+        if (!fuzz_written(i) || !fuzz_random(i))
+            return -1;
+    if (iterations)
+        printf("fuzz: %u iterations, seed %u, no mismatch\n", iterations, seed);
+
+    if (elements)
+        run_timing(elements, repeat);
+    return 0;
+}
@@ -0,0 +1,292 @@
+/*
+ * Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * vidc-c2d-map-bench: drives C2DMapCache the way C2DColorConverter::convertC2D
+ * does, against a stubbed c2dMapAddr/c2dUnMapAddr link table that charges a
+ * fixed cost per call and tracks live mappings. Source and destination
+ * buffers are cycled through fixed pools like encoder input buffers are, and
+ * the old map/draw/unmap per frame is compared with the cached mappings.
+ *
+ * The run ends with the checks the converter relies on: a released fd is
+ * unmapped, a recycled fd number pointing at a new file is not served the
+ * old mapping, a per-call source released after its conversion is mapped
+ * again when its fd and address come back for another buffer, and nothing
+ * is left mapped once the cache is gone.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "C2DMapCache.h"
+
+using namespace android;
+
+/* Stand-in for the kgsl map/unmap ioctls behind libC2D2 */
+struct stub_c2d {
+    unsigned int cost_ns;
+    uintptr_t next_addr;
+    unsigned long long maps, unmaps;
+    long live;
+};
+
+static unsigned long long now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void spin(unsigned int ns)
+{
+    unsigned long long end = now_ns() + ns;
+    while (now_ns() < end);
+}
+
+static void *stub_map(void *ctx, int fd, void *ptr, size_t len)
+{
+    stub_c2d *c2d = (stub_c2d *)ctx;
+
+    (void)fd;
+    (void)ptr;
+    spin(c2d->cost_ns);
+    c2d->maps++;
+    c2d->live++;
+    c2d->next_addr += (len + 4095) & ~(size_t)4095;
+    return (void *)c2d->next_addr;
+}
+
+static bool stub_unmap(void *ctx, void *gpu_addr)
+{
+    stub_c2d *c2d = (stub_c2d *)ctx;
+
+    if (!gpu_addr || c2d->live <= 0)
+        return false;
+    spin(c2d->cost_ns);
+    c2d->unmaps++;
+    c2d->live--;
+    return true;
+}
+
+struct buffer {
+    int fd;
+    void *ptr;
+    size_t len;
+};
+
+static bool open_pool(buffer *pool, unsigned int count, size_t len, uintptr_t base)
+{
+    for (unsigned int i = 0; i < count; i++) {
+        FILE *file = tmpfile();
+        if (!file)
+            return false;
+        /* Keep the fd, tmpfile() unlinks the file and fclose() is never called */
+        pool[i].fd = dup(fileno(file));
+        fclose(file);
+        pool[i].ptr = (void *)(base + i * len);
+        pool[i].len = len;
+        if (pool[i].fd < 0)
+            return false;
+    }
+    return true;
+}
+
+static void close_pool(buffer *pool, unsigned int count)
+{
+    for (unsigned int i = 0; i < count; i++)
+        close(pool[i].fd);
+}
+
+static int check(bool ok, const char *what)
+{
+    printf("%-44s: %s\n", what, ok ? "ok" : "FAILED");
+    return ok ? 0 : -1;
+}
+
+static void help()
+{
+    printf("\n\n");
+    printf("=============================\n");
+    printf("vidc-c2d-map-bench [options]\n");
+    printf("=============================\n\n");
+    printf("      -s, --sources <#>      Source buffers cycled (default 9)\n");
+    printf("      -d, --dests <#>        Destination buffers cycled (default 9)\n");
+    printf("      -f, --frames <#>       Frames converted (default 20000)\n");
+    printf("      -c, --cost <ns>        Stub cost per map or unmap (default 20000)\n");
+    printf("      -h, --help             Print this menu\n");
+    printf("=============================\n\n\n");
+}
+
+int main(int argc, char **argv)
+{
+    unsigned int sources = 9, dests = 9, frames = 20000, cost_ns = 20000;
+    struct option longopts[] = {
+        { "sources", required_argument, NULL, 's'},
+        { "dests",   required_argument, NULL, 'd'},
+        { "frames",  required_argument, NULL, 'f'},
+        { "cost",    required_argument, NULL, 'c'},
+        { "help",    no_argument,       NULL, 'h'},
+        { NULL,      0,                 NULL,  0},
+    };
+    const size_t src_len = 1920 * 1088 * 4, dst_len = 1920 * 1088 * 3 / 2;
+    buffer *src, *dst;
+    stub_c2d uncached, cached;
+    unsigned long long start, uncached_ns, cached_ns;
+    int command, ret = 0;
+
+    while ((command = getopt_long(argc, argv, "s:d:f:c:h", longopts, NULL)) != -1) {
+        switch (command) {
+            case 's':
+                sources = strtoul(optarg, NULL, 0);
+                break;
+            case 'd':
+                dests = strtoul(optarg, NULL, 0);
+                break;
+            case 'f':
+                frames = strtoul(optarg, NULL, 0);
+                break;
+            case 'c':
+                cost_ns = strtoul(optarg, NULL, 0);
+                break;
+            default:
+                help();
+                return -1;
+        }
+    }
+    if (!sources || !dests || !frames) {
+        help();
+        return -1;
+    }
+
+    src = new buffer[sources];
+    dst = new buffer[dests];
+    if (!open_pool(src, sources, src_len, 0x10000000) ||
+            !open_pool(dst, dests, dst_len, 0x80000000)) {
+        fprintf(stderr, "Failed to create the buffer pools\n");
+        return -1;
+    }
+
+    /* Old convertC2D: map both, draw, finish, unmap both */
+    memset(&uncached, 0, sizeof(uncached));
+    uncached.cost_ns = cost_ns;
+    start = now_ns();
+    for (unsigned int i = 0; i < frames; i++) {
+        buffer &s = src[i % sources], &d = dst[i % dests];
+        void *src_addr = stub_map(&uncached, s.fd, s.ptr, s.len);
+        void *dst_addr = stub_map(&uncached, d.fd, d.ptr, d.len);
+        stub_unmap(&uncached, src_addr);
+        stub_unmap(&uncached, dst_addr);
+    }
+    uncached_ns = now_ns() - start;
+
+    memset(&cached, 0, sizeof(cached));
+    cached.cost_ns = cost_ns;
+    {
+        C2DMapCache cache(stub_map, stub_unmap, &cached);
+        bool served_stale = false;
+
+        start = now_ns();
+        for (unsigned int i = 0; i < frames; i++) {
+            buffer &s = src[i % sources], &d = dst[i % dests];
+            cache.get(s.fd, s.ptr, s.len);
+            cache.get(d.fd, d.ptr, d.len);
+        }
+        cached_ns = now_ns() - start;
+
+        const C2DMapStats &stats = cache.stats();
+        printf("%u sources, %u destinations, %u frames, %u ns per map/unmap\n",
+                sources, dests, frames, cost_ns);
+        printf("map/unmap per frame : %8.2f us/frame, %llu maps\n",
+                uncached_ns / 1e3 / frames, uncached.maps);
+        printf("cached mappings     : %8.2f us/frame, %llu maps, %llu hits, %llu misses, %llu evictions\n",
+                cached_ns / 1e3 / frames, cached.maps,
+                (unsigned long long)stats.hits, (unsigned long long)stats.misses,
+                (unsigned long long)stats.evictions);
+
+        if (sources + dests <= C2D_MAP_CACHE_SIZE)
+            ret |= check(stats.misses == sources + dests, "every buffer mapped once");
+        ret |= check(cached.live <= C2D_MAP_CACHE_SIZE, "live mappings bounded by the cache");
+
+        long live = cached.live;
+        size_t released = cache.release(dst[0].fd, NULL);
+        ret |= check(cached.live == live - (long)released, "release() unmaps the buffer");
+
+        /* Free a source and let a new file take over its fd number */
+        void *old_addr = cache.get(src[0].fd, src[0].ptr, src[0].len);
+        int old_fd = src[0].fd;
+        close(src[0].fd);
+        FILE *file = tmpfile();
+        src[0].fd = file ? dup2(fileno(file), old_fd) : -1;
+        if (file)
+            fclose(file);
+        if (src[0].fd == old_fd) {
+            unsigned long long invalidations = stats.invalidations;
+            served_stale = cache.get(src[0].fd, src[0].ptr, src[0].len) == old_addr;
+            ret |= check(!served_stale && stats.invalidations == invalidations + 1,
+                    "recycled fd gets a new mapping");
+        } else {
+            ret |= check(false, "recycled fd gets a new mapping");
+        }
+
+        /* An encoder source mmapped per frame: the next frame's buffer gets
+         * the same fd number and address, and like dma-bufs sharing one
+         * anonymous inode (/dev/null here) nothing tells the two apart */
+        void *uva = (void *)0x40000000;
+        int anon = open("/dev/null", O_RDWR | O_CLOEXEC);
+        void *first = cache.get(anon, uva, src_len);
+        cache.release(anon, NULL);
+        close(anon);
+        int reused = open("/dev/null", O_RDWR | O_CLOEXEC);
+        void *second = cache.get(reused, uva, src_len);
+        ret |= check(anon >= 0 && reused == anon && second != first,
+                "released per-call source remapped on reuse");
+
+        /* Without the release the old mapping is served */
+        close(reused);
+        anon = open("/dev/null", O_RDWR | O_CLOEXEC);
+        served_stale = cache.get(anon, uva, src_len) == second;
+        printf("%-44s: %s\n", "unreleased per-call source on reuse",
+                served_stale ? "old mapping served, release is required" : "remapped");
+        cache.release(anon, NULL);
+        close(anon);
+        ret |= check(!stats.unmapErrors, "no unmap errors");
+    }
+    ret |= check(!cached.live, "nothing mapped after destruction");
+
+    close_pool(src, sources);
+    close_pool(dst, dests);
+    delete[] src;
+    delete[] dst;
+    return ret;
+}
@@ -0,0 +1,207 @@
+/*
+ * Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * vidc-cc-bench: measures the CPU color converter of libc2dcolorconvert,
+ * which the encoder falls back to when C2D is not available. A synthetic
+ * NV12 frame is converted to RGBA and back for each thread count and the
+ * round trip is checked against the source, so a broken SIMD row kernel or
+ * band split shows up as a PSNR drop instead of just a faster number.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <math.h>
+#include <time.h>
+#include "C2DColorConverter.h"
+
+using namespace android;
+
+static unsigned long long now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Smooth gradients with some texture, close enough to camera content that
+ * the 4:2:0 round trip stays well above 30 dB */
+static void fill_nv12(unsigned char *buf, const C2DBuffReq &req, size_t width,
+        size_t height)
+{
+    unsigned char *uv = buf + req.stride * req.sliceHeight;
+
+    for (size_t y = 0; y < height; y++)
+        for (size_t x = 0; x < width; x++)
+            buf[y * req.stride + x] = 32 + (x * 160 / width + y * 32 / height + (x ^ y) % 7);
+    for (size_t y = 0; y < height / 2; y++) {
+        for (size_t x = 0; x < width / 2; x++) {
+            uv[y * req.stride + 2 * x] = 96 + x * 64 / width;
+            uv[y * req.stride + 2 * x + 1] = 160 - y * 64 / height;
+        }
+    }
+}
+
+static double psnr(const unsigned char *a, const unsigned char *b, const C2DBuffReq &req,
+        size_t width, size_t height)
+{
+    const unsigned char *uv_a = a + req.stride * req.sliceHeight;
+    const unsigned char *uv_b = b + req.stride * req.sliceHeight;
+    double sse = 0;
+    size_t count = 0;
+
+    for (size_t y = 0; y < height; y++, count += width)
+        for (size_t x = 0; x < width; x++) {
+            int d = a[y * req.stride + x] - b[y * req.stride + x];
+            sse += d * d;
+        }
+    for (size_t y = 0; y < height / 2; y++, count += width)
+        for (size_t x = 0; x < width; x++) {
+            int d = uv_a[y * req.stride + x] - uv_b[y * req.stride + x];
+            sse += d * d;
+        }
+    if (!sse)
+        return 99.0;
+    return 10 * log10(255.0 * 255.0 * count / sse);
+}
+
+static C2DColorConverterBase *create(size_t width, size_t height, ColorConvertFormat src,
+        ColorConvertFormat dst, unsigned int threads)
+{
+    return createCPUColorConverter(width, height, width, height, src, dst,
+            C2D_FLAG_CPU | C2D_FLAG_CPU_THREADS(threads), 0);
+}
+
+static int run(size_t width, size_t height, unsigned int threads, unsigned int frames)
+{
+    C2DColorConverterBase *to_rgb = create(width, height, NV12_2K, RGBA8888, threads);
+    C2DColorConverterBase *to_yuv = create(width, height, RGBA8888, NV12_2K, threads);
+    C2DBuffReq yuv_req, rgb_req;
+    unsigned char *yuv = NULL, *rgb = NULL, *back = NULL;
+    unsigned long long start, rgb_ns = 0, yuv_ns = 0;
+    double mpix = (double)width * height * frames / 1e6;
+    int ret = -1;
+
+    if (!to_rgb || !to_yuv ||
+            to_rgb->getBuffReq(C2D_INPUT, &yuv_req) ||
+            to_rgb->getBuffReq(C2D_OUTPUT, &rgb_req)) {
+        fprintf(stderr, "Failed to create the converters\n");
+        goto done;
+    }
+    yuv = (unsigned char *)calloc(1, yuv_req.size);
+    rgb = (unsigned char *)calloc(1, rgb_req.size);
+    back = (unsigned char *)calloc(1, yuv_req.size);
+    if (!yuv || !rgb || !back) {
+        fprintf(stderr, "Failed to allocate %d byte frames\n", yuv_req.size);
+        goto done;
+    }
+    fill_nv12(yuv, yuv_req, width, height);
+
+    for (unsigned int i = 0; i < frames; i++) {
+        start = now_ns();
+        if (to_rgb->convertC2D(-1, yuv, yuv, -1, rgb, rgb))
+            goto done;
+        rgb_ns += now_ns() - start;
+        start = now_ns();
+        if (to_yuv->convertC2D(-1, rgb, rgb, -1, back, back))
+            goto done;
+        yuv_ns += now_ns() - start;
+    }
+    printf("%2u threads: NV12->RGBA %8.1f Mpix/s, RGBA->NV12 %8.1f Mpix/s, round trip %5.2f dB\n",
+            threads, mpix * 1e9 / rgb_ns, mpix * 1e9 / yuv_ns,
+            psnr(yuv, back, yuv_req, width, height));
+    ret = 0;
+done:
+    free(yuv);
+    free(rgb);
+    free(back);
+    delete to_rgb;
+    delete to_yuv;
+    return ret;
+}
+
+static void help()
+{
+    printf("\n\n");
+    printf("=============================\n");
+    printf("vidc-cc-bench [options]\n");
+    printf("=============================\n\n");
+    printf("      -w, --width <#>        Frame width (default 1920)\n");
+    printf("      -e, --height <#>       Frame height (default 1080)\n");
+    printf("      -t, --threads <#>      Largest thread count to try (default 4)\n");
+    printf("      -f, --frames <#>       Frames per thread count (default 50)\n");
+    printf("      -h, --help             Print this menu\n");
+    printf("=============================\n\n\n");
+}
+
+int main(int argc, char **argv)
+{
+    unsigned int width = 1920, height = 1080, threads = 4, frames = 50;
+    struct option longopts[] = {
+        { "width",   required_argument, NULL, 'w'},
+        { "height",  required_argument, NULL, 'e'},
+        { "threads", required_argument, NULL, 't'},
+        { "frames",  required_argument, NULL, 'f'},
+        { "help",    no_argument,       NULL, 'h'},
+        { NULL,      0,                 NULL,  0},
+    };
+    int command;
+
+    while ((command = getopt_long(argc, argv, "w:e:t:f:h", longopts, NULL)) != -1) {
+        switch (command) {
+            case 'w':
+                width = strtoul(optarg, NULL, 0);
+                break;
+            case 'e':
+                height = strtoul(optarg, NULL, 0);
+                break;
+            case 't':
+                threads = strtoul(optarg, NULL, 0);
+                break;
+            case 'f':
+                frames = strtoul(optarg, NULL, 0);
+                break;
+            default:
+                help();
+                return -1;
+        }
+    }
+    if (width < 2 || height < 2 || !threads || threads > 255 || !frames) {
+        help();
+        return -1;
+    }
+
+    printf("%ux%u, %u frames\n", width, height, frames);
+    for (unsigned int i = 1; i <= threads; i++)
+        if (run(width, height, i, frames))
+            return -1;
+    return 0;
+}
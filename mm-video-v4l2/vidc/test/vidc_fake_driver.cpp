@@ -0,0 +1,1386 @@
+/*
+ * Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * libvidcfake: loopback stand-in for the msm_vidc and msm_vpu V4L2 drivers
+ * and ION, loaded with LD_PRELOAD in front of the OMX components. open() of
+ * the decoder, encoder and VPU nodes and of /dev/ion returns an eventfd
+ * owned by the fake, and ioctl(), poll() and close() on those fds are served
+ * here; every other fd goes straight to libc. omx_vdpp finds its node by
+ * name under /sys/class/video4linux, so that directory is redirected to a
+ * temporary copy listing the fake nodes.
+ *
+ * Each session runs a worker thread that takes queued OUTPUT_MPLANE buffers
+ * in order, charges the configured latency, copies the payload into the
+ * next queued CAPTURE_MPLANE buffer and returns both the way the driver
+ * does: DQBUF readiness through POLLIN/POLLOUT and events (flush done,
+ * close done, port reconfig) through POLLPRI/DQEVENT. msm_vidc buffers are
+ * reached through the fd and offset in plane.reserved[0..1] like the
+ * driver's SMMU mapping, so meta mode inputs whose userptr is only an index
+ * are echoed too; msm_vpu takes the fd in m.userptr and the offset in
+ * reserved[0] and every plane is echoed. ION buffers are memfds, so the
+ * components mmap them as usual. The VPU node is only served when built
+ * with VIDC_FAKE_VPU, on the targets whose kernel has msm_vpu.
+ *
+ * Configured through the environment:
+ *   FAKE_VIDC_LATENCY_US  processing time per frame, frames are serialized
+ *   FAKE_VIDC_REORDER     decoded frames held and released in reverse order
+ *   FAKE_VIDC_RECONFIG    <frames>:<w>x<h>, every <frames> inputs switch the
+ *                         decoded size and raise an insufficient port
+ *                         settings event, output resumes after the capture
+ *                         port is streamed off and on again
+ *   FAKE_VIDC_COPY        0 to skip the payload copy
+ *   FAKE_VIDC_VERBOSE     1 to print a summary per session to stderr
+ */
+
+#undef _FORTIFY_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <dlfcn.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+#include <linux/videodev2.h>
+#include <linux/msm_ion.h>
+#include <media/msm_vidc.h>
+#ifdef VIDC_FAKE_VPU
+#include <media/msm_vpu.h>
+#endif
+#include <media/msm_media_info.h>
+
+#define FAKE_VIDC_DEC_DEVICE "/dev/video32"
+#define FAKE_VIDC_ENC_DEVICE "/dev/video33"
+#define FAKE_VPU_DEVICE "/dev/video34"
+#define FAKE_ION_DEVICE "/dev/ion"
+#define FAKE_SYSFS_V4L2_DIR "/sys/class/video4linux"
+#define FAKE_VPU_SESSIONS 2
+#define FAKE_VIDC_MAX_FDS 1024
+#define FAKE_VIDC_MAX_EVENTS 32
+#define FAKE_ION_MAX_HANDLES 64
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
+
+#ifdef __BIONIC__
+typedef int ioctl_request_t;
+#define FAKE_TMP_DIR "/data/local/tmp"
+#else
+typedef unsigned long ioctl_request_t;
+#define FAKE_TMP_DIR "/tmp"
+#endif
+
+enum { PORT_OUTPUT, PORT_CAPTURE, PORT_MAX };
+
+enum fake_kind { FAKE_DECODER, FAKE_ENCODER, FAKE_VPU };
+
+/* Device nodes served by the fake and their name in sysfs */
+static const struct {
+    const char *path;
+    const char *name;
+    fake_kind kind;
+} g_nodes[] = {
+    { FAKE_VIDC_DEC_DEVICE, "msm_vidc_dec", FAKE_DECODER },
+    { FAKE_VIDC_ENC_DEVICE, "msm_vidc_enc", FAKE_ENCODER },
+#ifdef VIDC_FAKE_VPU
+    { FAKE_VPU_DEVICE, "msm_vpu", FAKE_VPU },
+#endif
+};
+
+/* Host mapping of a plane, kept until its fd or offset changes */
+struct fake_map {
+    int fd;
+    unsigned int offset;
+    void *base;
+    size_t len;
+    unsigned char *data;
+};
+
+struct fake_buf {
+    struct v4l2_buffer buf;
+    struct v4l2_plane planes[VIDEO_MAX_PLANES];
+    fake_map map[VIDEO_MAX_PLANES];
+    bool owned;
+};
+
+/* Buffer indices in queue order; each index is in at most one ring */
+struct fake_ring {
+    unsigned int idx[VIDEO_MAX_FRAME];
+    unsigned int head, count;
+};
+
+struct fake_port {
+    struct v4l2_pix_format_mplane fmt;
+    unsigned int count;
+    bool streaming;
+    fake_buf bufs[VIDEO_MAX_FRAME];
+    fake_ring queued;
+    fake_ring done;
+};
+
+struct fake_stats {
+    unsigned long long in, out, flushes, reconfigs, unmapped;
+};
+
+struct fake_dev {
+    int fd;
+    fake_kind kind;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_t worker;
+    bool exit;
+    bool signalled;
+    /* Stream size set on the OUTPUT port and size of the decoded picture */
+    unsigned int base_width, base_height;
+    unsigned int width, height;
+    fake_port port[PORT_MAX];
+    struct v4l2_event events[FAKE_VIDC_MAX_EVENTS];
+    unsigned int event_head, event_count, event_seq;
+    fake_ring held;
+    unsigned long long busy_until_us, due_us;
+    unsigned int since_reconfig;
+    bool reconfig_alt, reconfig_hold, keyframe;
+    fake_stats stats;
+};
+
+struct fake_ion {
+    int fd;
+    int memfd[FAKE_ION_MAX_HANDLES];
+};
+
+struct fake_file {
+    fake_dev *dev;
+    fake_ion *ion;
+};
+
+static struct {
+    unsigned int latency_us;
+    unsigned int reorder;
+    unsigned int reconfig_frames, reconfig_width, reconfig_height;
+    bool copy;
+    bool verbose;
+} g_config;
+
+static int (*real_open)(const char *, int, ...);
+static int (*real_close)(int);
+static int (*real_ioctl)(int, ioctl_request_t, ...);
+static int (*real_poll)(struct pollfd *, nfds_t, int);
+static DIR *(*real_opendir)(const char *);
+static pthread_once_t g_once = PTHREAD_ONCE_INIT;
+static pthread_once_t g_sysfs_once = PTHREAD_ONCE_INIT;
+static char g_sysfs_dir[256];
+static pthread_mutex_t g_files_lock = PTHREAD_MUTEX_INITIALIZER;
+static fake_file *g_files[FAKE_VIDC_MAX_FDS];
+
+static unsigned long long now_us()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static unsigned int env_uint(const char *name, unsigned int def)
+{
+    const char *value = getenv(name);
+    return value && *value ? strtoul(value, NULL, 0) : def;
+}
+
+static void init_once()
+{
+    const char *reconfig = getenv("FAKE_VIDC_RECONFIG");
+
+    real_open = (int (*)(const char *, int, ...))dlsym(RTLD_NEXT, "open");
+    real_close = (int (*)(int))dlsym(RTLD_NEXT, "close");
+    real_ioctl = (int (*)(int, ioctl_request_t, ...))dlsym(RTLD_NEXT, "ioctl");
+    real_poll = (int (*)(struct pollfd *, nfds_t, int))dlsym(RTLD_NEXT, "poll");
+    real_opendir = (DIR *(*)(const char *))dlsym(RTLD_NEXT, "opendir");
+
+    g_config.latency_us = env_uint("FAKE_VIDC_LATENCY_US", 0);
+    g_config.reorder = env_uint("FAKE_VIDC_REORDER", 0);
+    if (g_config.reorder >= VIDEO_MAX_FRAME / 2)
+        g_config.reorder = VIDEO_MAX_FRAME / 2 - 1;
+    g_config.copy = env_uint("FAKE_VIDC_COPY", 1);
+    g_config.verbose = env_uint("FAKE_VIDC_VERBOSE", 0);
+    if (reconfig && sscanf(reconfig, "%u:%ux%u", &g_config.reconfig_frames,
+                &g_config.reconfig_width, &g_config.reconfig_height) != 3) {
+        fprintf(stderr, "libvidcfake: ignoring FAKE_VIDC_RECONFIG=%s\n", reconfig);
+        g_config.reconfig_frames = 0;
+    }
+}
+
+static fake_file *lookup(int fd)
+{
+    if (fd < 0 || fd >= FAKE_VIDC_MAX_FDS)
+        return NULL;
+    return __atomic_load_n(&g_files[fd], __ATOMIC_ACQUIRE);
+}
+
+static void remove_sysfs()
+{
+    char path[PATH_MAX];
+
+    for (unsigned int i = 0; i < sizeof(g_nodes) / sizeof(g_nodes[0]); i++) {
+        snprintf(path, sizeof(path), "%s/%s/name", g_sysfs_dir, g_nodes[i].path + 5);
+        unlink(path);
+        snprintf(path, sizeof(path), "%s/%s", g_sysfs_dir, g_nodes[i].path + 5);
+        rmdir(path);
+    }
+    rmdir(g_sysfs_dir);
+}
+
+/* Built on first use, so processes that never look a node up by name do not
+ * leave anything behind in the temporary directory */
+static void init_sysfs()
+{
+    const char *tmp = getenv("TMPDIR");
+    char path[PATH_MAX];
+
+    snprintf(g_sysfs_dir, sizeof(g_sysfs_dir), "%s/libvidcfake-XXXXXX",
+            tmp && *tmp ? tmp : FAKE_TMP_DIR);
+    if (!mkdtemp(g_sysfs_dir)) {
+        fprintf(stderr, "libvidcfake: cannot create %s: %s\n", g_sysfs_dir, strerror(errno));
+        g_sysfs_dir[0] = '\0';
+        return;
+    }
+    for (unsigned int i = 0; i < sizeof(g_nodes) / sizeof(g_nodes[0]); i++) {
+        int fd;
+
+        snprintf(path, sizeof(path), "%s/%s", g_sysfs_dir, g_nodes[i].path + 5);
+        mkdir(path, 0755);
+        snprintf(path, sizeof(path), "%s/%s/name", g_sysfs_dir, g_nodes[i].path + 5);
+        fd = real_open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd >= 0) {
+            dprintf(fd, "%s\n", g_nodes[i].name);
+            real_close(fd);
+        }
+    }
+    atexit(remove_sysfs);
+}
+
+/* Maps a path under /sys/class/video4linux to the fake copy */
+static bool sysfs_path(const char *path, char *fake, size_t size)
+{
+    size_t len = sizeof(FAKE_SYSFS_V4L2_DIR) - 1;
+
+    if (!path || strncmp(path, FAKE_SYSFS_V4L2_DIR, len) ||
+            (path[len] && path[len] != '/'))
+        return false;
+    pthread_once(&g_sysfs_once, init_sysfs);
+    if (!g_sysfs_dir[0])
+        return false;
+    snprintf(fake, size, "%s%s", g_sysfs_dir, path + len);
+    return true;
+}
+
+/* ------------------------------------------------------------------------ */
+/* Session state, called with dev->lock held                                 */
+/* ------------------------------------------------------------------------ */
+
+static void ring_push(fake_ring *ring, unsigned int idx)
+{
+    ring->idx[(ring->head + ring->count++) % VIDEO_MAX_FRAME] = idx;
+}
+
+static unsigned int ring_pop(fake_ring *ring)
+{
+    unsigned int idx = ring->idx[ring->head];
+    ring->head = (ring->head + 1) % VIDEO_MAX_FRAME;
+    ring->count--;
+    return idx;
+}
+
+static unsigned int ring_pop_back(fake_ring *ring)
+{
+    ring->count--;
+    return ring->idx[(ring->head + ring->count) % VIDEO_MAX_FRAME];
+}
+
+static int port_of(unsigned int type)
+{
+    if (type == V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE)
+        return PORT_OUTPUT;
+    if (type == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE)
+        return PORT_CAPTURE;
+    return -1;
+}
+
+static bool is_yuv_port(fake_dev *dev, int port)
+{
+    if (dev->kind == FAKE_VPU)
+        return true;
+    return dev->kind == FAKE_ENCODER ? port == PORT_OUTPUT : port == PORT_CAPTURE;
+}
+
+static unsigned int min_buffers(fake_dev *dev, int port)
+{
+    if (dev->kind != FAKE_DECODER)
+        return 4;
+    return port == PORT_OUTPUT ? 6 : 8 + g_config.reorder;
+}
+
+/* Plane layout the driver reports for the current session size. The VPU
+ * takes the layout the client sets on each port as it is. */
+static void update_formats(fake_dev *dev)
+{
+    if (dev->kind == FAKE_VPU)
+        return;
+    for (int p = 0; p < PORT_MAX; p++) {
+        struct v4l2_pix_format_mplane *fmt = &dev->port[p].fmt;
+
+        memset(fmt->plane_fmt, 0, sizeof(fmt->plane_fmt));
+        if (is_yuv_port(dev, p)) {
+            fmt->width = dev->width;
+            fmt->height = dev->height;
+            fmt->plane_fmt[0].bytesperline = VENUS_Y_STRIDE(COLOR_FMT_NV12, dev->width);
+            fmt->plane_fmt[0].reserved[0] = VENUS_Y_SCANLINES(COLOR_FMT_NV12, dev->height);
+            fmt->plane_fmt[0].sizeimage = VENUS_BUFFER_SIZE(COLOR_FMT_NV12,
+                    dev->width, dev->height);
+            fmt->num_planes = dev->kind == FAKE_ENCODER ? 1 : 2;
+            if (fmt->num_planes > 1)
+                fmt->plane_fmt[1].sizeimage = VENUS_EXTRADATA_SIZE(dev->width, dev->height);
+        } else {
+            unsigned int size = dev->base_width * dev->base_height * 3 / 4;
+            fmt->width = dev->base_width;
+            fmt->height = dev->base_height;
+            fmt->plane_fmt[0].sizeimage = size < 65536 ? 65536 : (size + 4095) & ~4095;
+            fmt->num_planes = 1;
+        }
+    }
+}
+
+static void update_signal(fake_dev *dev)
+{
+    bool ready = dev->event_count ||
+        dev->port[PORT_OUTPUT].done.count || dev->port[PORT_CAPTURE].done.count;
+    uint64_t value = 1;
+
+    if (ready && !dev->signalled) {
+        if (write(dev->fd, &value, sizeof(value)) == sizeof(value))
+            dev->signalled = true;
+    } else if (!ready && dev->signalled) {
+        if (read(dev->fd, &value, sizeof(value)) == sizeof(value))
+            dev->signalled = false;
+    }
+}
+
+static struct v4l2_event *post_event(fake_dev *dev, unsigned int type)
+{
+    struct v4l2_event *ev;
+
+    if (dev->event_count == FAKE_VIDC_MAX_EVENTS) {
+        /* Like the V4L2 core, drop the oldest one */
+        dev->event_head = (dev->event_head + 1) % FAKE_VIDC_MAX_EVENTS;
+        dev->event_count--;
+    }
+    ev = &dev->events[(dev->event_head + dev->event_count++) % FAKE_VIDC_MAX_EVENTS];
+    memset(ev, 0, sizeof(*ev));
+    ev->type = type;
+    ev->sequence = dev->event_seq++;
+    clock_gettime(CLOCK_MONOTONIC, &ev->timestamp);
+    update_signal(dev);
+    return ev;
+}
+
+static void unmap_buf(fake_buf *b)
+{
+    for (unsigned int j = 0; j < VIDEO_MAX_PLANES; j++) {
+        fake_map *map = &b->map[j];
+        if (map->base)
+            munmap(map->base, map->len);
+        map->base = NULL;
+        map->data = NULL;
+    }
+}
+
+static unsigned char *map_buf(fake_dev *dev, fake_buf *b, unsigned int j)
+{
+    struct v4l2_plane *plane = &b->planes[j];
+    fake_map *map = &b->map[j];
+    /* msm_vidc takes the buffer fd and offset in reserved[0..1], msm_vpu
+     * takes the fd in m.userptr and the offset in reserved[0] */
+    int fd = dev->kind == FAKE_VPU ? (int)plane->m.userptr : (int)plane->reserved[0];
+    unsigned int offset = dev->kind == FAKE_VPU ? plane->reserved[0] : plane->reserved[1];
+    unsigned int page_offset = offset & ~(unsigned int)(getpagesize() - 1);
+
+    if (map->base && map->fd == fd && map->offset == offset &&
+            map->len >= offset - page_offset + plane->length)
+        return map->data;
+    if (map->base)
+        munmap(map->base, map->len);
+    map->base = NULL;
+    map->data = NULL;
+    if (fd <= 0 || !plane->length)
+        return NULL;
+    map->len = offset - page_offset + plane->length;
+    map->base = mmap(NULL, map->len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, page_offset);
+    if (map->base == MAP_FAILED) {
+        map->base = NULL;
+        dev->stats.unmapped++;
+        return NULL;
+    }
+    map->fd = fd;
+    map->offset = offset;
+    map->data = (unsigned char *)map->base + (offset - page_offset);
+    return map->data;
+}
+
+static void release_port(fake_port *port)
+{
+    for (unsigned int i = 0; i < VIDEO_MAX_FRAME; i++) {
+        unmap_buf(&port->bufs[i]);
+        port->bufs[i].owned = false;
+    }
+    memset(&port->queued, 0, sizeof(port->queued));
+    memset(&port->done, 0, sizeof(port->done));
+}
+
+/* Hands back every buffer the fake holds on a port, without payload */
+static void return_all(fake_dev *dev, int p)
+{
+    fake_port *port = &dev->port[p];
+
+    if (p == PORT_CAPTURE) {
+        while (dev->held.count)
+            ring_push(&port->queued, ring_pop(&dev->held));
+        for (unsigned int i = 0; i < port->queued.count; i++) {
+            fake_buf *b = &port->bufs[port->queued.idx[(port->queued.head + i) % VIDEO_MAX_FRAME]];
+            for (unsigned int j = 0; j < b->buf.length; j++)
+                b->planes[j].bytesused = 0;
+            b->buf.flags = 0;
+        }
+    } else {
+        dev->due_us = 0;
+    }
+    while (port->queued.count)
+        ring_push(&port->done, ring_pop(&port->queued));
+}
+
+static void drop_all(fake_dev *dev, int p)
+{
+    fake_port *port = &dev->port[p];
+
+    if (p == PORT_CAPTURE)
+        memset(&dev->held, 0, sizeof(dev->held));
+    else
+        dev->due_us = 0;
+    for (unsigned int i = 0; i < VIDEO_MAX_FRAME; i++)
+        port->bufs[i].owned = false;
+    memset(&port->queued, 0, sizeof(port->queued));
+    memset(&port->done, 0, sizeof(port->done));
+}
+
+/* Decoded frames leave in reverse order once a group of reorder + 1 is held */
+static void release_held(fake_dev *dev, bool all)
+{
+    if (!all && dev->held.count <= g_config.reorder)
+        return;
+    while (dev->held.count)
+        ring_push(&dev->port[PORT_CAPTURE].done, ring_pop_back(&dev->held));
+}
+
+static bool needs_output(fake_dev *dev, fake_buf *in)
+{
+    return dev->kind != FAKE_DECODER || !(in->buf.flags & V4L2_QCOM_BUF_FLAG_CODECCONFIG);
+}
+
+static bool can_process(fake_dev *dev)
+{
+    fake_port *in = &dev->port[PORT_OUTPUT], *out = &dev->port[PORT_CAPTURE];
+
+    if (!in->streaming || !in->queued.count || dev->reconfig_hold)
+        return false;
+    if (!needs_output(dev, &in->bufs[in->queued.idx[in->queued.head]]))
+        return true;
+    return out->streaming && out->queued.count;
+}
+
+/* Echoes a VPU frame plane by plane, each plane at its own fd and offset */
+static void echo_planes(fake_dev *dev, fake_buf *in, fake_buf *out)
+{
+    for (unsigned int j = 0; j < out->buf.length; j++) {
+        struct v4l2_plane *plane = &out->planes[j];
+        unsigned int bytes = j < in->buf.length ? in->planes[j].bytesused : 0;
+
+        if (bytes > plane->length)
+            bytes = plane->length;
+        if (g_config.copy && bytes) {
+            unsigned char *src = map_buf(dev, in, j), *dst = map_buf(dev, out, j);
+            if (src && dst && in->planes[j].data_offset + bytes <= in->planes[j].length)
+                memcpy(dst, src + in->planes[j].data_offset, bytes);
+        }
+        plane->bytesused = bytes;
+        plane->data_offset = 0;
+    }
+}
+
+static void process_one(fake_dev *dev)
+{
+    fake_port *in_port = &dev->port[PORT_OUTPUT], *out_port = &dev->port[PORT_CAPTURE];
+    fake_buf *in = &in_port->bufs[ring_pop(&in_port->queued)];
+    unsigned int in_bytes = in->planes[0].bytesused;
+    bool eos = in->buf.flags & V4L2_QCOM_BUF_FLAG_EOS;
+
+    if (needs_output(dev, in)) {
+        fake_buf *out = &out_port->bufs[ring_pop(&out_port->queued)];
+        struct v4l2_plane *plane = &out->planes[0];
+        unsigned int out_bytes;
+
+        if (dev->kind == FAKE_DECODER)
+            out_bytes = in_bytes ? out_port->fmt.plane_fmt[0].sizeimage : 0;
+        else
+            out_bytes = in_bytes < plane->length ? in_bytes : plane->length;
+        if (out_bytes > plane->length)
+            out_bytes = plane->length;
+        if (dev->kind == FAKE_VPU) {
+            echo_planes(dev, in, out);
+        } else {
+            if (g_config.copy && in_bytes) {
+                unsigned char *src = map_buf(dev, in, 0), *dst = map_buf(dev, out, 0);
+                unsigned int len = in_bytes < out_bytes ? in_bytes : out_bytes;
+                if (src && dst && in->planes[0].data_offset + len <= in->planes[0].length)
+                    memcpy(dst, src + in->planes[0].data_offset, len);
+            }
+            plane->bytesused = out_bytes;
+            plane->data_offset = 0;
+            for (unsigned int j = 1; j < out->buf.length; j++)
+                out->planes[j].bytesused = 0;
+        }
+        if (dev->kind == FAKE_DECODER && out_bytes) {
+            plane->reserved[2] = 0;
+            plane->reserved[3] = 0;
+            plane->reserved[4] = dev->width;
+            plane->reserved[5] = dev->height;
+            plane->reserved[6] = dev->width;
+            plane->reserved[7] = dev->height;
+        }
+        out->buf.timestamp = in->buf.timestamp;
+        out->buf.flags = eos ? V4L2_QCOM_BUF_FLAG_EOS : 0;
+        if (dev->keyframe && out_bytes) {
+            out->buf.flags |= V4L2_BUF_FLAG_KEYFRAME | V4L2_QCOM_BUF_FLAG_IDRFRAME;
+            dev->keyframe = false;
+        }
+        ring_push(&dev->held, out - out_port->bufs);
+        release_held(dev, eos || dev->kind != FAKE_DECODER);
+        dev->stats.out++;
+    }
+    ring_push(&in_port->done, in - in_port->bufs);
+    dev->stats.in++;
+
+    if (dev->kind == FAKE_DECODER && g_config.reconfig_frames && in_bytes &&
+            ++dev->since_reconfig >= g_config.reconfig_frames) {
+        dev->since_reconfig = 0;
+        dev->reconfig_alt = !dev->reconfig_alt;
+        dev->width = dev->reconfig_alt ? g_config.reconfig_width : dev->base_width;
+        dev->height = dev->reconfig_alt ? g_config.reconfig_height : dev->base_height;
+        update_formats(dev);
+        release_held(dev, true);
+        dev->reconfig_hold = true;
+        dev->stats.reconfigs++;
+        post_event(dev, V4L2_EVENT_MSM_VIDC_PORT_SETTINGS_CHANGED_INSUFFICIENT);
+    }
+    update_signal(dev);
+}
+
+static void *worker_thread(void *arg)
+{
+    fake_dev *dev = (fake_dev *)arg;
+
+    pthread_mutex_lock(&dev->lock);
+    while (!dev->exit) {
+        if (!can_process(dev)) {
+            pthread_cond_wait(&dev->cond, &dev->lock);
+            continue;
+        }
+        unsigned long long now = now_us();
+        if (!dev->due_us)
+            dev->due_us = (now > dev->busy_until_us ? now : dev->busy_until_us) +
+                g_config.latency_us;
+        if (now < dev->due_us) {
+            struct timespec ts;
+            unsigned long long wait_us = dev->due_us - now;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            ts.tv_sec += wait_us / 1000000;
+            ts.tv_nsec += (wait_us % 1000000) * 1000;
+            if (ts.tv_nsec >= 1000000000) {
+                ts.tv_sec++;
+                ts.tv_nsec -= 1000000000;
+            }
+            pthread_cond_timedwait(&dev->cond, &dev->lock, &ts);
+            continue;
+        }
+        dev->busy_until_us = dev->due_us;
+        dev->due_us = 0;
+        process_one(dev);
+    }
+    pthread_mutex_unlock(&dev->lock);
+    return NULL;
+}
+
+/* ------------------------------------------------------------------------ */
+/* ioctls                                                                    */
+/* ------------------------------------------------------------------------ */
+
+static int dev_querycap(fake_dev *dev, struct v4l2_capability *cap)
+{
+    static const char *const cards[] = { "msm_vidc_vdec", "msm_vidc_venc", "msm_vpu" };
+
+    memset(cap, 0, sizeof(*cap));
+    snprintf((char *)cap->driver, sizeof(cap->driver), "%s",
+            dev->kind == FAKE_VPU ? "msm_vpu" : "msm_vidc_driver");
+    snprintf((char *)cap->card, sizeof(cap->card), "%s", cards[dev->kind]);
+    snprintf((char *)cap->bus_info, sizeof(cap->bus_info), "libvidcfake");
+    cap->capabilities = V4L2_CAP_VIDEO_CAPTURE_MPLANE | V4L2_CAP_VIDEO_OUTPUT_MPLANE |
+        V4L2_CAP_STREAMING;
+    return 0;
+}
+
+static int dev_enum_fmt(fake_dev *dev, struct v4l2_fmtdesc *desc)
+{
+    static const unsigned int coded[] = {
+        V4L2_PIX_FMT_H264, V4L2_PIX_FMT_MPEG4, V4L2_PIX_FMT_H263,
+        V4L2_PIX_FMT_MPEG2, V4L2_PIX_FMT_VP8,
+    };
+    int p = port_of(desc->type);
+
+    if (p < 0)
+        return -EINVAL;
+    if (is_yuv_port(dev, p)) {
+        if (desc->index)
+            return -EINVAL;
+        desc->pixelformat = V4L2_PIX_FMT_NV12;
+        snprintf((char *)desc->description, sizeof(desc->description), "Y/CbCr 4:2:0");
+    } else {
+        if (desc->index >= sizeof(coded) / sizeof(coded[0]))
+            return -EINVAL;
+        desc->pixelformat = coded[desc->index];
+        snprintf((char *)desc->description, sizeof(desc->description), "compressed");
+    }
+    desc->flags = is_yuv_port(dev, p) ? 0 : V4L2_FMT_FLAG_COMPRESSED;
+    return 0;
+}
+
+static int dev_fmt(fake_dev *dev, struct v4l2_format *f, bool set)
+{
+    int p = port_of(f->type);
+
+    if (p < 0)
+        return -EINVAL;
+    if (set && dev->kind == FAKE_VPU) {
+        struct v4l2_pix_format_mplane *fmt = &dev->port[p].fmt;
+        if (dev->port[p].streaming)
+            return -EBUSY;
+        if (!f->fmt.pix_mp.num_planes || f->fmt.pix_mp.num_planes > VIDEO_MAX_PLANES)
+            return -EINVAL;
+        *fmt = f->fmt.pix_mp;
+        if (p == PORT_OUTPUT) {
+            dev->base_width = fmt->width;
+            dev->base_height = fmt->height;
+        } else {
+            dev->width = fmt->width;
+            dev->height = fmt->height;
+        }
+    } else if (set) {
+        fake_port *port = &dev->port[p];
+        if (port->streaming)
+            return -EBUSY;
+        port->fmt.pixelformat = f->fmt.pix_mp.pixelformat;
+        if (f->fmt.pix_mp.width && f->fmt.pix_mp.height) {
+            dev->width = f->fmt.pix_mp.width;
+            dev->height = f->fmt.pix_mp.height;
+            if (p == PORT_OUTPUT || dev->kind == FAKE_ENCODER) {
+                dev->base_width = dev->width;
+                dev->base_height = dev->height;
+            }
+            update_formats(dev);
+        }
+    }
+    f->fmt.pix_mp = dev->port[p].fmt;
+    return 0;
+}
+
+static int dev_reqbufs(fake_dev *dev, struct v4l2_requestbuffers *req)
+{
+    int p = port_of(req->type);
+    fake_port *port;
+
+    if (p < 0)
+        return -EINVAL;
+    port = &dev->port[p];
+    if (port->streaming && req->count)
+        return -EBUSY;
+    release_port(port);
+    if (p == PORT_CAPTURE)
+        memset(&dev->held, 0, sizeof(dev->held));
+    if (req->count) {
+        if (req->count < min_buffers(dev, p))
+            req->count = min_buffers(dev, p);
+        if (req->count > VIDEO_MAX_FRAME)
+            req->count = VIDEO_MAX_FRAME;
+    }
+    port->count = req->count;
+    return 0;
+}
+
+static int dev_qbuf(fake_dev *dev, struct v4l2_buffer *buf)
+{
+    int p = port_of(buf->type);
+    fake_port *port;
+    fake_buf *b;
+
+    if (p < 0 || !buf->m.planes || !buf->length || buf->length > VIDEO_MAX_PLANES)
+        return -EINVAL;
+    port = &dev->port[p];
+    if (buf->index >= port->count)
+        return -EINVAL;
+    b = &port->bufs[buf->index];
+    if (b->owned)
+        return -EBUSY;
+    b->buf = *buf;
+    memcpy(b->planes, buf->m.planes, buf->length * sizeof(struct v4l2_plane));
+    b->buf.m.planes = b->planes;
+    b->owned = true;
+    ring_push(&port->queued, buf->index);
+    pthread_cond_signal(&dev->cond);
+    return 0;
+}
+
+static int dev_dqbuf(fake_dev *dev, struct v4l2_buffer *buf)
+{
+    int p = port_of(buf->type);
+    struct v4l2_plane *planes = buf->m.planes;
+    unsigned int length = buf->length;
+    fake_port *port;
+    fake_buf *b;
+
+    if (p < 0 || !planes)
+        return -EINVAL;
+    port = &dev->port[p];
+    if (!port->done.count)
+        return -EAGAIN;
+    b = &port->bufs[ring_pop(&port->done)];
+    b->owned = false;
+    *buf = b->buf;
+    buf->m.planes = planes;
+    buf->length = length < b->buf.length ? length : b->buf.length;
+    memcpy(planes, b->planes, buf->length * sizeof(struct v4l2_plane));
+    update_signal(dev);
+    return 0;
+}
+
+static int dev_stream(fake_dev *dev, int *type, bool on)
+{
+    int p = port_of(*type);
+
+    if (p < 0)
+        return -EINVAL;
+    if (!on && dev->port[p].streaming) {
+        drop_all(dev, p);
+        if (p == PORT_CAPTURE)
+            dev->reconfig_hold = false;
+        update_signal(dev);
+    }
+    if (on && p == PORT_CAPTURE && !dev->port[p].streaming)
+        dev->keyframe = dev->kind != FAKE_VPU;
+    dev->port[p].streaming = on;
+    pthread_cond_signal(&dev->cond);
+    return 0;
+}
+
+static int dev_flush(fake_dev *dev, bool output, bool capture)
+{
+    if (!output && !capture)
+        output = capture = true;
+    if (output)
+        return_all(dev, PORT_OUTPUT);
+    if (capture)
+        return_all(dev, PORT_CAPTURE);
+    dev->stats.flushes++;
+    post_event(dev, V4L2_EVENT_MSM_VIDC_FLUSH_DONE);
+    return 0;
+}
+
+#ifdef VIDC_FAKE_VPU
+/* msm_vpu private ioctls, returns false for anything else */
+static bool vpu_ioctl(fake_dev *dev, ioctl_request_t request, void *arg, int *ret)
+{
+    switch (request) {
+        case VPU_QUERY_SESSIONS:
+            *(int *)arg = FAKE_VPU_SESSIONS;
+            break;
+        case VPU_ATTACH_TO_SESSION: {
+            int session = *(int *)arg;
+            if (session < 0 || session >= FAKE_VPU_SESSIONS)
+                *ret = -EINVAL;
+            break;
+        }
+        case VPU_FLUSH_BUFS: {
+            /* One port per call, reported by a flush done carrying its type */
+            enum v4l2_buf_type type = *(enum v4l2_buf_type *)arg;
+            int p = port_of(type);
+            struct v4l2_event *ev;
+            if (p < 0) {
+                *ret = -EINVAL;
+                break;
+            }
+            return_all(dev, p);
+            dev->stats.flushes++;
+            ev = post_event(dev, VPU_EVENT_FLUSH_DONE);
+            memcpy(ev->u.data, &type, sizeof(type));
+            break;
+        }
+        case VPU_S_CONTROL:
+        case VPU_G_CONTROL:
+            /* Accepted and ignored, the loopback does no processing */
+            break;
+        default:
+            return false;
+    }
+    return true;
+}
+#endif
+
+static int dev_dqevent(fake_dev *dev, struct v4l2_event *ev)
+{
+    if (!dev->event_count)
+        return -ENOENT;
+    *ev = dev->events[dev->event_head];
+    dev->event_head = (dev->event_head + 1) % FAKE_VIDC_MAX_EVENTS;
+    dev->event_count--;
+    ev->pending = dev->event_count;
+    update_signal(dev);
+    return 0;
+}
+
+static int dev_ioctl(fake_dev *dev, ioctl_request_t request, void *arg)
+{
+    int ret = 0;
+
+    pthread_mutex_lock(&dev->lock);
+#ifdef VIDC_FAKE_VPU
+    if (dev->kind == FAKE_VPU && vpu_ioctl(dev, request, arg, &ret)) {
+        pthread_mutex_unlock(&dev->lock);
+        if (ret) {
+            errno = -ret;
+            return -1;
+        }
+        return 0;
+    }
+#endif
+    switch (request) {
+        case VIDIOC_QUERYCAP:
+            ret = dev_querycap(dev, (struct v4l2_capability *)arg);
+            break;
+        case VIDIOC_ENUM_FMT:
+            ret = dev_enum_fmt(dev, (struct v4l2_fmtdesc *)arg);
+            break;
+        case VIDIOC_ENUM_FRAMESIZES: {
+            struct v4l2_frmsizeenum *frmsize = (struct v4l2_frmsizeenum *)arg;
+            if (frmsize->index) {
+                ret = -EINVAL;
+                break;
+            }
+            frmsize->type = V4L2_FRMSIZE_TYPE_STEPWISE;
+            frmsize->stepwise.min_width = 32;
+            frmsize->stepwise.max_width = 4096;
+            frmsize->stepwise.step_width = 1;
+            frmsize->stepwise.min_height = 32;
+            frmsize->stepwise.max_height = 2304;
+            frmsize->stepwise.step_height = 1;
+            break;
+        }
+        case VIDIOC_S_FMT:
+        case VIDIOC_G_FMT:
+        case VIDIOC_TRY_FMT:
+            /* TRY_FMT reports the current layout, the clients only read
+               back the plane count and size from it */
+            ret = dev_fmt(dev, (struct v4l2_format *)arg, request == VIDIOC_S_FMT);
+            break;
+        case VIDIOC_REQBUFS:
+            ret = dev_reqbufs(dev, (struct v4l2_requestbuffers *)arg);
+            break;
+        case VIDIOC_PREPARE_BUF: {
+            struct v4l2_buffer *buf = (struct v4l2_buffer *)arg;
+            int p = port_of(buf->type);
+            if (p < 0 || buf->index >= dev->port[p].count)
+                ret = -EINVAL;
+            break;
+        }
+        case VIDIOC_QBUF:
+            ret = dev_qbuf(dev, (struct v4l2_buffer *)arg);
+            break;
+        case VIDIOC_DQBUF:
+            ret = dev_dqbuf(dev, (struct v4l2_buffer *)arg);
+            break;
+        case VIDIOC_STREAMON:
+        case VIDIOC_STREAMOFF:
+            ret = dev_stream(dev, (int *)arg, request == VIDIOC_STREAMON);
+            break;
+        case VIDIOC_DECODER_CMD: {
+            struct v4l2_decoder_cmd *cmd = (struct v4l2_decoder_cmd *)arg;
+            if (cmd->cmd == V4L2_DEC_QCOM_CMD_FLUSH)
+                ret = dev_flush(dev, cmd->flags & V4L2_DEC_QCOM_CMD_FLUSH_OUTPUT,
+                        cmd->flags & V4L2_DEC_QCOM_CMD_FLUSH_CAPTURE);
+            else if (cmd->cmd == V4L2_DEC_CMD_STOP)
+                post_event(dev, V4L2_EVENT_MSM_VIDC_CLOSE_DONE);
+            break;
+        }
+        case VIDIOC_ENCODER_CMD: {
+            struct v4l2_encoder_cmd *cmd = (struct v4l2_encoder_cmd *)arg;
+            if (cmd->cmd == V4L2_ENC_QCOM_CMD_FLUSH)
+                ret = dev_flush(dev, cmd->flags & V4L2_QCOM_CMD_FLUSH_OUTPUT,
+                        cmd->flags & V4L2_QCOM_CMD_FLUSH_CAPTURE);
+            else if (cmd->cmd == V4L2_ENC_CMD_STOP)
+                post_event(dev, V4L2_EVENT_MSM_VIDC_CLOSE_DONE);
+            break;
+        }
+        case VIDIOC_DQEVENT:
+            ret = dev_dqevent(dev, (struct v4l2_event *)arg);
+            break;
+        case VIDIOC_G_CTRL:
+            ((struct v4l2_control *)arg)->value = 0;
+            break;
+        case VIDIOC_S_CTRL:
+        case VIDIOC_S_EXT_CTRLS:
+        case VIDIOC_S_PARM:
+        case VIDIOC_G_PARM:
+        case VIDIOC_SUBSCRIBE_EVENT:
+        case VIDIOC_UNSUBSCRIBE_EVENT:
+            /* Accepted and ignored, the loopback has no codec settings */
+            break;
+        default:
+            ret = -ENOTTY;
+            break;
+    }
+    pthread_mutex_unlock(&dev->lock);
+    if (ret) {
+        errno = -ret;
+        return -1;
+    }
+    return 0;
+}
+
+static int ion_ioctl(fake_ion *ion, ioctl_request_t request, void *arg)
+{
+    int ret = 0;
+
+    /* Each client is used by one thread at a time, like the driver's handles */
+    switch (request) {
+        case ION_IOC_ALLOC: {
+            struct ion_allocation_data *data = (struct ion_allocation_data *)arg;
+            int slot = 0;
+            while (slot < FAKE_ION_MAX_HANDLES && ion->memfd[slot] >= 0)
+                slot++;
+            if (slot == FAKE_ION_MAX_HANDLES || !data->len) {
+                ret = -ENOMEM;
+                break;
+            }
+#ifdef __NR_memfd_create
+            ion->memfd[slot] = syscall(__NR_memfd_create, "libvidcfake-ion", MFD_CLOEXEC);
+#else
+            errno = ENOSYS;
+#endif
+            if (ion->memfd[slot] < 0) {
+                ret = -errno;
+                ion->memfd[slot] = -1;
+                break;
+            }
+            if (ftruncate(ion->memfd[slot], data->len)) {
+                ret = -errno;
+                real_close(ion->memfd[slot]);
+                ion->memfd[slot] = -1;
+                break;
+            }
+            data->handle = slot + 1;
+            break;
+        }
+        case ION_IOC_FREE: {
+            struct ion_handle_data *data = (struct ion_handle_data *)arg;
+            unsigned int slot = data->handle - 1;
+            if (slot >= FAKE_ION_MAX_HANDLES || ion->memfd[slot] < 0) {
+                ret = -EINVAL;
+                break;
+            }
+            real_close(ion->memfd[slot]);
+            ion->memfd[slot] = -1;
+            break;
+        }
+        case ION_IOC_MAP:
+        case ION_IOC_SHARE: {
+            struct ion_fd_data *data = (struct ion_fd_data *)arg;
+            unsigned int slot = data->handle - 1;
+            if (slot >= FAKE_ION_MAX_HANDLES || ion->memfd[slot] < 0) {
+                ret = -EINVAL;
+                break;
+            }
+            data->fd = fcntl(ion->memfd[slot], F_DUPFD_CLOEXEC, 0);
+            if (data->fd < 0)
+                ret = -errno;
+            break;
+        }
+        case ION_IOC_IMPORT: {
+            struct ion_fd_data *data = (struct ion_fd_data *)arg;
+            int slot = 0;
+            while (slot < FAKE_ION_MAX_HANDLES && ion->memfd[slot] >= 0)
+                slot++;
+            if (slot == FAKE_ION_MAX_HANDLES) {
+                ret = -ENOMEM;
+                break;
+            }
+            ion->memfd[slot] = fcntl(data->fd, F_DUPFD_CLOEXEC, 0);
+            if (ion->memfd[slot] < 0) {
+                ret = -errno;
+                ion->memfd[slot] = -1;
+                break;
+            }
+            data->handle = slot + 1;
+            break;
+        }
+        case ION_IOC_CUSTOM:
+        case ION_IOC_SYNC:
+            /* memfd pages are coherent, cache maintenance is a no-op */
+            break;
+        default:
+            ret = -ENOTTY;
+            break;
+    }
+    if (ret) {
+        errno = -ret;
+        return -1;
+    }
+    return 0;
+}
+
+/* ------------------------------------------------------------------------ */
+/* Interposed libc entry points                                              */
+/* ------------------------------------------------------------------------ */
+
+static int node_of(const char *path)
+{
+    for (unsigned int i = 0; path && i < sizeof(g_nodes) / sizeof(g_nodes[0]); i++)
+        if (!strcmp(path, g_nodes[i].path))
+            return i;
+    return -1;
+}
+
+static int open_fake(const char *path)
+{
+    int node = node_of(path);
+    fake_file *file;
+    int fd;
+
+    fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (fd < 0)
+        return -1;
+    if (fd >= FAKE_VIDC_MAX_FDS) {
+        real_close(fd);
+        errno = EMFILE;
+        return -1;
+    }
+    file = (fake_file *)calloc(1, sizeof(*file));
+    if (!file) {
+        real_close(fd);
+        errno = ENOMEM;
+        return -1;
+    }
+    if (node >= 0) {
+        fake_kind kind = g_nodes[node].kind;
+        fake_dev *dev = (fake_dev *)calloc(1, sizeof(*dev));
+        if (!dev) {
+            free(file);
+            real_close(fd);
+            errno = ENOMEM;
+            return -1;
+        }
+        dev->fd = fd;
+        dev->kind = kind;
+        dev->base_width = dev->width = 1920;
+        dev->base_height = dev->height = 1080;
+        dev->port[PORT_OUTPUT].fmt.pixelformat = kind == FAKE_DECODER ? V4L2_PIX_FMT_H264 : V4L2_PIX_FMT_NV12;
+        dev->port[PORT_CAPTURE].fmt.pixelformat = kind == FAKE_ENCODER ? V4L2_PIX_FMT_H264 : V4L2_PIX_FMT_NV12;
+        if (kind == FAKE_VPU) {
+            for (int p = 0; p < PORT_MAX; p++) {
+                struct v4l2_pix_format_mplane *fmt = &dev->port[p].fmt;
+                fmt->width = dev->width;
+                fmt->height = dev->height;
+                fmt->num_planes = 2;
+                fmt->plane_fmt[0].bytesperline = fmt->plane_fmt[1].bytesperline = dev->width;
+                fmt->plane_fmt[0].sizeimage = dev->width * dev->height;
+                fmt->plane_fmt[1].sizeimage = dev->width * dev->height / 2;
+            }
+        }
+        update_formats(dev);
+        pthread_mutex_init(&dev->lock, NULL);
+        pthread_cond_init(&dev->cond, NULL);
+        if (pthread_create(&dev->worker, NULL, worker_thread, dev)) {
+            free(dev);
+            free(file);
+            real_close(fd);
+            errno = EAGAIN;
+            return -1;
+        }
+        file->dev = dev;
+    } else {
+        fake_ion *ion = (fake_ion *)calloc(1, sizeof(*ion));
+        if (!ion) {
+            free(file);
+            real_close(fd);
+            errno = ENOMEM;
+            return -1;
+        }
+        ion->fd = fd;
+        for (int i = 0; i < FAKE_ION_MAX_HANDLES; i++)
+            ion->memfd[i] = -1;
+        file->ion = ion;
+    }
+    pthread_mutex_lock(&g_files_lock);
+    __atomic_store_n(&g_files[fd], file, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&g_files_lock);
+    return fd;
+}
+
+static bool is_fake_path(const char *path)
+{
+    return node_of(path) >= 0 || (path && !strcmp(path, FAKE_ION_DEVICE));
+}
+
+static void destroy_file(fake_file *file)
+{
+    if (file->dev) {
+        static const char *const kinds[] = { "decoder", "encoder", "vpu" };
+        fake_dev *dev = file->dev;
+
+        pthread_mutex_lock(&dev->lock);
+        dev->exit = true;
+        pthread_cond_signal(&dev->cond);
+        pthread_mutex_unlock(&dev->lock);
+        pthread_join(dev->worker, NULL);
+        if (g_config.verbose)
+            fprintf(stderr, "libvidcfake: %s session %ux%u: %llu in, %llu out, "
+                    "%llu flushes, %llu reconfigs, %llu unmapped buffers\n",
+                    kinds[dev->kind], dev->width, dev->height,
+                    dev->stats.in, dev->stats.out, dev->stats.flushes,
+                    dev->stats.reconfigs, dev->stats.unmapped);
+        for (int p = 0; p < PORT_MAX; p++)
+            release_port(&dev->port[p]);
+        pthread_cond_destroy(&dev->cond);
+        pthread_mutex_destroy(&dev->lock);
+        free(dev);
+    }
+    if (file->ion) {
+        for (int i = 0; i < FAKE_ION_MAX_HANDLES; i++)
+            if (file->ion->memfd[i] >= 0)
+                real_close(file->ion->memfd[i]);
+        free(file->ion);
+    }
+    free(file);
+}
+
+extern "C" {
+
+int open(const char *path, int flags, ...)
+{
+    char sysfs[PATH_MAX];
+    mode_t mode = 0;
+
+    pthread_once(&g_once, init_once);
+    if (flags & O_CREAT) {
+        va_list args;
+        va_start(args, flags);
+        mode = va_arg(args, int);
+        va_end(args);
+    }
+    if (is_fake_path(path))
+        return open_fake(path);
+    if (sysfs_path(path, sysfs, sizeof(sysfs)))
+        return real_open(sysfs, flags, mode);
+    return real_open(path, flags, mode);
+}
+
+#ifndef __BIONIC__
+int open64(const char *path, int flags, ...)
+{
+    mode_t mode = 0;
+
+    if (flags & O_CREAT) {
+        va_list args;
+        va_start(args, flags);
+        mode = va_arg(args, int);
+        va_end(args);
+    }
+    return open(path, flags | O_LARGEFILE, mode);
+}
+#endif
+
+int __open_2(const char *path, int flags)
+{
+    return open(path, flags);
+}
+
+#ifndef __BIONIC__
+int __open64_2(const char *path, int flags)
+{
+    return open(path, flags | O_LARGEFILE);
+}
+#endif
+
+DIR *opendir(const char *path)
+{
+    char sysfs[PATH_MAX];
+
+    pthread_once(&g_once, init_once);
+    if (sysfs_path(path, sysfs, sizeof(sysfs)))
+        return real_opendir(sysfs);
+    return real_opendir(path);
+}
+
+int close(int fd)
+{
+    fake_file *file;
+
+    pthread_once(&g_once, init_once);
+    file = lookup(fd);
+    if (file) {
+        pthread_mutex_lock(&g_files_lock);
+        __atomic_store_n(&g_files[fd], (fake_file *)NULL, __ATOMIC_RELEASE);
+        pthread_mutex_unlock(&g_files_lock);
+        destroy_file(file);
+    }
+    return real_close(fd);
+}
+
+int ioctl(int fd, ioctl_request_t request, ...)
+{
+    fake_file *file;
+    va_list args;
+    void *arg;
+
+    pthread_once(&g_once, init_once);
+    va_start(args, request);
+    arg = va_arg(args, void *);
+    va_end(args);
+    file = lookup(fd);
+    if (!file)
+        return real_ioctl(fd, request, arg);
+    if (!arg) {
+        errno = EFAULT;
+        return -1;
+    }
+    if (file->dev)
+        return dev_ioctl(file->dev, request, arg);
+    return ion_ioctl(file->ion, request, arg);
+}
+
+/*
+ * The eventfd behind a session is readable while the fake has something to
+ * dequeue, so it is polled for POLLIN together with any real fds and the
+ * V4L2 revents are filled in from the session state afterwards.
+ */
+int poll(struct pollfd *fds, nfds_t nfds, int timeout)
+{
+    struct pollfd local[8];
+    struct pollfd *polled = local;
+    unsigned long long deadline = timeout > 0 ? now_us() + timeout * 1000ULL : 0;
+    bool fake = false;
+    int rc;
+
+    pthread_once(&g_once, init_once);
+    for (nfds_t i = 0; i < nfds && !fake; i++) {
+        fake_file *file = lookup(fds[i].fd);
+        fake = file && file->dev;
+    }
+    if (!fake)
+        return real_poll(fds, nfds, timeout);
+
+    if (nfds > sizeof(local) / sizeof(local[0])) {
+        polled = (struct pollfd *)malloc(nfds * sizeof(*polled));
+        if (!polled) {
+            errno = ENOMEM;
+            return -1;
+        }
+    }
+    for (;;) {
+        int wait = timeout;
+        if (timeout > 0) {
+            unsigned long long now = now_us();
+            wait = now < deadline ? (deadline - now + 999) / 1000 : 0;
+        }
+        for (nfds_t i = 0; i < nfds; i++) {
+            fake_file *file = lookup(fds[i].fd);
+            polled[i] = fds[i];
+            if (file && file->dev)
+                polled[i].events = POLLIN;
+        }
+        rc = real_poll(polled, nfds, wait);
+        if (rc <= 0)
+            break;
+        rc = 0;
+        for (nfds_t i = 0; i < nfds; i++) {
+            fake_file *file = lookup(fds[i].fd);
+            fds[i].revents = polled[i].revents;
+            if (file && file->dev && !(polled[i].revents & (POLLERR | POLLNVAL))) {
+                fake_dev *dev = file->dev;
+                short revents = 0;
+                pthread_mutex_lock(&dev->lock);
+                if (dev->port[PORT_CAPTURE].done.count)
+                    revents |= POLLIN | POLLRDNORM;
+                if (dev->port[PORT_OUTPUT].done.count)
+                    revents |= POLLOUT | POLLWRNORM;
+                if (dev->event_count)
+                    revents |= POLLPRI;
+                pthread_mutex_unlock(&dev->lock);
+                fds[i].revents = revents & (fds[i].events | POLLPRI);
+            }
+            if (fds[i].revents)
+                rc++;
+        }
+        if (rc || !timeout)
+            break;
+        if (timeout > 0 && now_us() >= deadline)
+            break;
+    }
+    if (polled != local)
+        free(polled);
+    return rc;
+}
+
+}
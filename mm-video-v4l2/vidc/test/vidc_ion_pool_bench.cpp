@@ -0,0 +1,264 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2015, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+    * Neither the name of The Linux Foundation nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+
+/*
+ * vidc-ion-pool-bench: measures port reconfigurations with and without
+ * vidc_buffer_pool. A set of output buffers is allocated, mapped and
+ * written like the decoder does, then freed and reallocated for the other
+ * resolution, alternating as adaptive playback does. The direct run
+ * allocates and frees every buffer through the backend, the pooled run
+ * goes through the pool. Both use the memfd backend, so this runs on a
+ * host as well as on target.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <media/msm_media_info.h>
+#include "vidc_ion_pool.h"
+#include "vidc_debug.h"
+
+/* Owned by libOmxVidcCommon in the components, which is not linked here */
+int debug_level = PRIO_ERROR;
+
+#define MAX_BUFFERS 64
+
+struct bench_buf {
+    struct vidc_pool_block blk;
+    int fd;
+    void *addr;
+    size_t len;
+};
+
+static unsigned long long now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int open_fds()
+{
+    DIR *dir = opendir("/proc/self/fd");
+    int count = 0;
+
+    if (!dir)
+        return -1;
+    while (readdir(dir))
+        count++;
+    closedir(dir);
+    return count;
+}
+
+/* What the hardware does to a fresh buffer: every page gets written */
+static bool map_buf(struct bench_buf *b, bool touch)
+{
+    b->addr = mmap(NULL, b->len, PROT_READ | PROT_WRITE, MAP_SHARED, b->fd, 0);
+    if (b->addr == MAP_FAILED) {
+        b->addr = NULL;
+        return false;
+    }
+    if (touch) {
+        for (size_t off = 0; off < b->len; off += 4096)
+            ((volatile unsigned char *)b->addr)[off] = (unsigned char)off;
+    }
+    return true;
+}
+
+static bool alloc_set(vidc_pool_backend *backend, vidc_buffer_pool *pool,
+        struct bench_buf *bufs, unsigned int count, size_t len, bool touch)
+{
+    for (unsigned int i = 0; i < count; i++) {
+        struct bench_buf *b = &bufs[i];
+
+        memset(b, 0, sizeof(*b));
+        b->len = len;
+        if (pool) {
+            if (pool->acquire(len, 4096, 0, 0, &b->blk, &b->fd) < 0)
+                return false;
+        } else {
+            b->blk.len = len;
+            b->blk.align = 4096;
+            if (!backend->alloc(&b->blk))
+                return false;
+            b->fd = b->blk.fd;
+        }
+        if (!map_buf(b, touch))
+            return false;
+    }
+    return true;
+}
+
+static void free_set(vidc_pool_backend *backend, vidc_buffer_pool *pool,
+        struct bench_buf *bufs, unsigned int count)
+{
+    for (unsigned int i = 0; i < count; i++) {
+        struct bench_buf *b = &bufs[i];
+
+        if (b->addr)
+            munmap(b->addr, b->len);
+        close(b->fd);
+        if (pool) {
+            pool->release(b->blk.dev_fd, b->blk.handle);
+        } else {
+            b->blk.fd = -1;
+            backend->free(&b->blk);
+        }
+    }
+}
+
+static int run(vidc_pool_backend *backend, vidc_buffer_pool *pool,
+        const size_t *lens, unsigned int count, unsigned int cycles, bool touch)
+{
+    static struct bench_buf bufs[MAX_BUFFERS];
+    unsigned long long start, ns = 0;
+    int fds = open_fds();
+
+    if (!alloc_set(backend, pool, bufs, count, lens[0], touch)) {
+        fprintf(stderr, "Failed to allocate the first set\n");
+        return -1;
+    }
+    for (unsigned int c = 1; c <= cycles; c++) {
+        start = now_ns();
+        free_set(backend, pool, bufs, count);
+        if (!alloc_set(backend, pool, bufs, count, lens[c & 1], touch)) {
+            fprintf(stderr, "Failed to reallocate in cycle %u\n", c);
+            return -1;
+        }
+        ns += now_ns() - start;
+    }
+    free_set(backend, pool, bufs, count);
+    if (pool)
+        pool->trim(0);
+
+    printf("  %-8s %10.1f us/reconfig", pool ? "pooled" : "direct", ns / 1e3 / cycles);
+    if (pool) {
+        struct vidc_pool_stats stats;
+
+        pool->get_stats(&stats);
+        printf("  %llu hits %llu misses %llu allocs, peak %zu KB",
+                (unsigned long long)stats.hits, (unsigned long long)stats.misses,
+                (unsigned long long)stats.allocs, stats.peak_bytes / 1024);
+        if (stats.idle_blocks || stats.busy_bytes)
+            printf(" LEAK");
+    }
+    if (open_fds() != fds)
+        printf(" FD LEAK (%d -> %d)", fds, open_fds());
+    printf("\n");
+    return 0;
+}
+
+static void help()
+{
+    printf("\n\n");
+    printf("=============================\n");
+    printf("vidc-ion-pool-bench [options]\n");
+    printf("=============================\n\n");
+    printf("      -w, --width <#>        First frame width (default 1920)\n");
+    printf("      -e, --height <#>       First frame height (default 1080)\n");
+    printf("      -W, --width2 <#>       Second frame width (default 1280)\n");
+    printf("      -E, --height2 <#>      Second frame height (default 720)\n");
+    printf("      -n, --buffers <#>      Buffers per set (default 16, max %d)\n", MAX_BUFFERS);
+    printf("      -c, --cycles <#>       Reconfigurations (default 50)\n");
+    printf("      -t, --no-touch         Do not write the buffers after mapping\n");
+    printf("      -h, --help             Print this menu\n");
+    printf("=============================\n\n\n");
+}
+
+int main(int argc, char **argv)
+{
+    unsigned int width = 1920, height = 1080, width2 = 1280, height2 = 720;
+    unsigned int count = 16, cycles = 50;
+    bool touch = true;
+    struct option longopts[] = {
+        { "width",    required_argument, NULL, 'w'},
+        { "height",   required_argument, NULL, 'e'},
+        { "width2",   required_argument, NULL, 'W'},
+        { "height2",  required_argument, NULL, 'E'},
+        { "buffers",  required_argument, NULL, 'n'},
+        { "cycles",   required_argument, NULL, 'c'},
+        { "no-touch", no_argument,       NULL, 't'},
+        { "help",     no_argument,       NULL, 'h'},
+        { NULL,       0,                 NULL,  0},
+    };
+    int command;
+
+    while ((command = getopt_long(argc, argv, "w:e:W:E:n:c:th", longopts, NULL)) != -1) {
+        switch (command) {
+            case 'w':
+                width = strtoul(optarg, NULL, 0);
+                break;
+            case 'e':
+                height = strtoul(optarg, NULL, 0);
+                break;
+            case 'W':
+                width2 = strtoul(optarg, NULL, 0);
+                break;
+            case 'E':
+                height2 = strtoul(optarg, NULL, 0);
+                break;
+            case 'n':
+                count = strtoul(optarg, NULL, 0);
+                break;
+            case 'c':
+                cycles = strtoul(optarg, NULL, 0);
+                break;
+            case 't':
+                touch = false;
+                break;
+            default:
+                help();
+                return -1;
+        }
+    }
+    if (!width || !height || !width2 || !height2 || !count ||
+            count > MAX_BUFFERS || !cycles) {
+        help();
+        return -1;
+    }
+
+    size_t lens[2] = {
+        VENUS_BUFFER_SIZE(COLOR_FMT_NV12, width, height),
+        VENUS_BUFFER_SIZE(COLOR_FMT_NV12, width2, height2),
+    };
+    vidc_memfd_backend backend;
+    vidc_buffer_pool pool(&backend);
+
+    printf("%u x %zu <-> %u x %zu byte buffers, %u reconfigs\n",
+            count, lens[0], count, lens[1], cycles);
+    if (run(&backend, NULL, lens, count, cycles, touch) ||
+            run(&backend, &pool, lens, count, cycles, touch))
+        return -1;
+    return 0;
+}
@@ -0,0 +1,323 @@
+/*
+ * Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * vidc-map-bench: checks the flat Map of vdec/inc/Map.h against std::map
+ * and times it against the linked list Map it replaced, which is kept below
+ * as it was. Sizes cover the parameter set maps: a handful of SPS, up to
+ * 32 SPS and up to 256 PPS ids.
+ *
+ * The fuzz pass runs random insert/erase/find/eraseall sequences on both
+ * maps and compares every result, the key order of the flat map and a copy
+ * of it. The timed pass fills maps of each size with keys in random and in
+ * ascending order, the order parameter set ids usually arrive in, and
+ * reports ns per insert and per lookup, half of the lookups missing.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#include <stdint.h>
+#include <algorithm>
+#include <map>
+#include <vector>
+#include "Map.h"
+
+/* Map<T,T2> before the flat array, trimmed to the calls timed here */
+template <typename T,typename T2>
+class legacy_map
+{
+    struct node {
+        T    data;
+        T2   data2;
+        node* prev;
+        node* next;
+        node(T t, T2 t2,node* p, node* n) :
+            data(t), data2(t2), prev(p), next(n) {}
+    };
+    node* head;
+    node* tail;
+    node* tmp;
+    unsigned size_of_list;
+    public:
+    legacy_map() : head( NULL ), tail ( NULL ),tmp(head),size_of_list(0) {}
+    bool empty() const {
+        return ( !head || !tail );
+    }
+    T2 find(T d1) {
+        tmp = head;
+
+        while (tmp) {
+            if (tmp->data == d1) {
+                return tmp->data2;
+            }
+
+            tmp = tmp->next;
+        }
+
+        return 0;
+    }
+    void insert(T data, T2 data2) {
+        tail = new node(data, data2,tail, NULL);
+
+        if ( tail->prev )
+            tail->prev->next = tail;
+
+        if ( empty() ) {
+            head = tail;
+            tmp=head;
+        }
+
+        tmp = head;
+        size_of_list++;
+    }
+    ~legacy_map() {
+        while (head) {
+            node* temp(head);
+            head=head->next;
+            size_of_list--;
+            delete temp;
+        }
+    }
+};
+
+typedef Map<uint32_t, uint32_t> flat_map;
+
+static uint32_t rng_state = 1;
+
+static uint32_t rnd()
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static uint32_t rnd(uint32_t n)
+{
+    return rnd() % n;
+}
+
+static bool fail(uint32_t iteration, uint32_t op, const char *what, uint32_t key)
+{
+    printf("MISMATCH: iteration %u op %u: %s, key %u\n", iteration, op, what, key);
+    return false;
+}
+
+static bool same_contents(const flat_map &map, const std::map<uint32_t, uint32_t> &ref)
+{
+    std::map<uint32_t, uint32_t>::const_iterator it = ref.begin();
+    unsigned i;
+
+    if ((unsigned)map.size() != ref.size())
+        return false;
+    for (i = 0; it != ref.end(); i++, it++)
+        if (map.key_at(i) != it->first || map.value_at(i) != it->second)
+            return false;
+    return true;
+}
+
+/* Keys from a small range so that inserts hit present keys and erases
+   find something; 0 is a key as well as the "not found" value */
+static bool fuzz(uint32_t iteration)
+{
+    flat_map map;
+    std::map<uint32_t, uint32_t> ref;
+    uint32_t ops = 1 + rnd(600), range = 1 + rnd(300), op;
+
+    for (op = 0; op < ops; op++) {
+        uint32_t key = rnd(range), value = 1 + rnd(1000), pick = rnd(100);
+        bool present = ref.count(key) != 0;
+
+        if (pick < 45) {
+            if (map.insert(key, value) == present)
+                return fail(iteration, op, "insert", key);
+            ref.insert(std::make_pair(key, value));
+        } else if (pick < 70) {
+            if (map.erase(key) != present)
+                return fail(iteration, op, "erase", key);
+            ref.erase(key);
+        } else if (pick < 99) {
+            if (map.find(key) != (present ? ref[key] : 0) ||
+                    (present && map.find_ele(key) != key))
+                return fail(iteration, op, "find", key);
+        } else {
+            map.eraseall();
+            ref.clear();
+        }
+        if (map.empty() != ref.empty() ||
+                map.begin() != (ref.empty() ? 0 : ref.begin()->second))
+            return fail(iteration, op, "empty/begin", key);
+    }
+    if (!same_contents(map, ref))
+        return fail(iteration, op, "contents", 0);
+
+    flat_map copy(map), assigned;
+    assigned.insert(1, 1);
+    assigned = copy;
+    if (!same_contents(copy, ref) || !same_contents(assigned, ref))
+        return fail(iteration, op, "copy", 0);
+    return true;
+}
+
+static unsigned long long now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Fills with keys, then looks up probes and sums the values found */
+template <typename M>
+static uint32_t run(const std::vector<uint32_t> &keys, const std::vector<uint32_t> &probes,
+        uint32_t repeat, unsigned long long &insert_ns, unsigned long long &find_ns)
+{
+    uint32_t sum = 0, r;
+    size_t i;
+    unsigned long long start;
+
+    insert_ns = find_ns = 0;
+    for (r = 0; r < repeat; r++) {
+        M map;
+
+        start = now_ns();
+        for (i = 0; i < keys.size(); i++)
+            map.insert(keys[i], keys[i] + 1);
+        insert_ns += now_ns() - start;
+
+        start = now_ns();
+        for (i = 0; i < probes.size(); i++)
+            sum += map.find(probes[i]);
+        find_ns += now_ns() - start;
+    }
+    return sum;
+}
+
+static void run_timing(uint32_t lookups, uint32_t repeat)
+{
+    static const uint32_t sizes[] = { 4, 32, 256 };
+    unsigned s;
+
+    printf("%u lookups per run, half missing, %u runs\n", lookups, repeat);
+    for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        std::vector<uint32_t> keys, sorted, probes;
+        std::map<uint32_t, bool> used;
+        unsigned long long ins[2], fnd[2], asc[2], unused;
+        uint32_t sum[2], i;
+
+        while (keys.size() < sizes[s]) {
+            uint32_t key = rnd(sizes[s] * 2);
+            if (!used[key]) {
+                used[key] = true;
+                keys.push_back(key);
+            }
+        }
+        for (i = 0; i < lookups; i++)
+            probes.push_back(i & 1 ? keys[rnd(sizes[s])] : sizes[s] * 2 + rnd(1000));
+
+        sorted = keys;
+        std::sort(sorted.begin(), sorted.end());
+
+        sum[0] = run<legacy_map<uint32_t, uint32_t> >(keys, probes, repeat, ins[0], fnd[0]);
+        sum[1] = run<flat_map>(keys, probes, repeat, ins[1], fnd[1]);
+        run<legacy_map<uint32_t, uint32_t> >(sorted, probes, repeat, asc[0], unused);
+        run<flat_map>(sorted, probes, repeat, asc[1], unused);
+        printf("  %3u keys: insert random %6.2f -> %6.2f ns, ascending %6.2f -> %6.2f ns, "
+                "lookup %6.2f -> %6.2f ns%s\n", sizes[s],
+                (double)ins[0] / repeat / sizes[s], (double)ins[1] / repeat / sizes[s],
+                (double)asc[0] / repeat / sizes[s], (double)asc[1] / repeat / sizes[s],
+                (double)fnd[0] / repeat / lookups, (double)fnd[1] / repeat / lookups,
+                sum[0] == sum[1] ? "" : " MISMATCH");
+    }
+}
+
+static void help()
+{
+    printf("\n\n");
+    printf("=============================\n");
+    printf("vidc-map-bench [options]\n");
+    printf("=============================\n\n");
+    printf("      -f, --fuzz <#>         Fuzz iterations, 0 to skip (default 2000)\n");
+    printf("      -s, --seed <#>         Fuzz and key seed (default 1)\n");
+    printf("      -n, --lookups <#>      Lookups per timed run, 0 to skip (default 10000)\n");
+    printf("      -r, --repeat <#>       Timed runs per map size (default 200)\n");
+    printf("      -h, --help             Print this menu\n");
+    printf("=============================\n\n\n");
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t iterations = 2000, seed = 1, lookups = 10000, repeat = 200;
+    struct option longopts[] = {
+        { "fuzz",     required_argument, NULL, 'f'},
+        { "seed",     required_argument, NULL, 's'},
+        { "lookups",  required_argument, NULL, 'n'},
+        { "repeat",   required_argument, NULL, 'r'},
+        { "help",     no_argument,       NULL, 'h'},
+        { NULL,       0,                 NULL,  0},
+    };
+    int command;
+
+    while ((command = getopt_long(argc, argv, "f:s:n:r:h", longopts, NULL)) != -1) {
+        switch (command) {
+            case 'f':
+                iterations = strtoul(optarg, NULL, 0);
+                break;
+            case 's':
+                seed = strtoul(optarg, NULL, 0);
+                break;
+            case 'n':
+                lookups = strtoul(optarg, NULL, 0);
+                break;
+            case 'r':
+                repeat = strtoul(optarg, NULL, 0);
+                break;
+            default:
+                help();
+                return -1;
+        }
+    }
+    if (!seed || !repeat) {
+        help();
+        return -1;
+    }
+
+    rng_state = seed;
+    for (uint32_t i = 0; i < iterations; i++)
+        if (!fuzz(i))
+            return -1;
+    if (iterations)
+        printf("fuzz: %u iterations, seed %u, no mismatch\n", iterations, seed);
+
+    if (lookups)
+        run_timing(lookups, repeat);
+    return 0;
+}
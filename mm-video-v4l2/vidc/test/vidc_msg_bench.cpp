@@ -0,0 +1,277 @@
+/*
+ * Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * vidc-msg-bench: models the OMX component message path under contention.
+ * Producer threads stand in for the client (ETB/FTB/commands) and driver
+ * event threads: each one inserts into a ring guarded by a shared lock and
+ * then posts a wakeup. One consumer thread stands in for the message thread
+ * and drains the ring on every wakeup like process_event_cb does.
+ *
+ * The "pipe" mode is the old scheme with a one byte write and read per
+ * event, "eventfd" uses vidc_msg_notifier which only signals when the
+ * message thread is not already pending.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include "vidc_msg_notifier.h"
+
+#define RING_SIZE 1024
+
+struct bench_ctx {
+    pthread_mutex_t lock;
+    unsigned long ring[RING_SIZE];
+    unsigned int read, write, size;
+
+    bool use_pipe;
+    int pipe_fds[2];
+    vidc_msg_notifier notifier;
+
+    unsigned int events_per_producer;
+    unsigned int work_ns;
+    unsigned long long total;
+    unsigned long long processed;
+    unsigned long long checksum;
+
+    unsigned long long signals;
+    unsigned long long wakeups;
+};
+
+static unsigned long long now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Stand-in for handling one event, e.g. queueing a buffer to the driver */
+static void spin(unsigned int ns)
+{
+    unsigned long long end;
+
+    if (!ns)
+        return;
+    end = now_ns() + ns;
+    while (now_ns() < end);
+}
+
+static void *producer(void *arg)
+{
+    bench_ctx *ctx = (bench_ctx *)arg;
+    unsigned char id = 1;
+
+    for (unsigned int i = 0; i < ctx->events_per_producer; i++) {
+        pthread_mutex_lock(&ctx->lock);
+        while (ctx->size == RING_SIZE) {
+            pthread_mutex_unlock(&ctx->lock);
+            sched_yield();
+            pthread_mutex_lock(&ctx->lock);
+        }
+        ctx->ring[ctx->write] = i;
+        ctx->write = (ctx->write + 1) % RING_SIZE;
+        ctx->size++;
+        pthread_mutex_unlock(&ctx->lock);
+
+        if (ctx->use_pipe) {
+            while (write(ctx->pipe_fds[1], &id, 1) < 0 && errno == EINTR);
+            __sync_fetch_and_add(&ctx->signals, 1);
+        } else if (ctx->notifier.notify()) {
+            __sync_fetch_and_add(&ctx->signals, 1);
+        }
+    }
+    return NULL;
+}
+
+/* Same shape as process_event_cb: pop under the lock until empty */
+static void drain(bench_ctx *ctx)
+{
+    unsigned int size;
+
+    do {
+        unsigned long entry = 0;
+
+        pthread_mutex_lock(&ctx->lock);
+        size = ctx->size;
+        if (size) {
+            entry = ctx->ring[ctx->read];
+            ctx->read = (ctx->read + 1) % RING_SIZE;
+            ctx->size--;
+        }
+        pthread_mutex_unlock(&ctx->lock);
+        if (size) {
+            spin(ctx->work_ns);
+            ctx->checksum += entry;
+            ctx->processed++;
+        }
+    } while (size > 1);
+}
+
+static void *consumer(void *arg)
+{
+    bench_ctx *ctx = (bench_ctx *)arg;
+    unsigned char id;
+
+    while (ctx->processed < ctx->total) {
+        if (ctx->use_pipe) {
+            ssize_t n = read(ctx->pipe_fds[0], &id, 1);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n != 1)
+                break;
+        } else if (!ctx->notifier.wait()) {
+            break;
+        }
+        ctx->wakeups++;
+        drain(ctx);
+    }
+    return NULL;
+}
+
+static int run(bool use_pipe, unsigned int producers, unsigned int events,
+        unsigned int work_ns)
+{
+    bench_ctx *ctx = new bench_ctx;
+    pthread_t *threads = new pthread_t[producers];
+    pthread_t consumer_id;
+    unsigned long long start, elapsed, expected;
+    int ret = 0;
+
+    memset(ctx->ring, 0, sizeof(ctx->ring));
+    pthread_mutex_init(&ctx->lock, NULL);
+    ctx->read = ctx->write = ctx->size = 0;
+    ctx->use_pipe = use_pipe;
+    ctx->events_per_producer = events;
+    ctx->work_ns = work_ns;
+    ctx->total = (unsigned long long)producers * events;
+    ctx->processed = ctx->checksum = 0;
+    ctx->signals = ctx->wakeups = 0;
+
+    if (use_pipe ? pipe(ctx->pipe_fds) != 0 : !ctx->notifier.init()) {
+        fprintf(stderr, "Failed to create the %s\n", use_pipe ? "pipe" : "eventfd");
+        ret = -1;
+        goto done;
+    }
+
+    start = now_ns();
+    pthread_create(&consumer_id, NULL, consumer, ctx);
+    for (unsigned int i = 0; i < producers; i++)
+        pthread_create(&threads[i], NULL, producer, ctx);
+    for (unsigned int i = 0; i < producers; i++)
+        pthread_join(threads[i], NULL);
+    pthread_join(consumer_id, NULL);
+    elapsed = now_ns() - start;
+
+    expected = (unsigned long long)producers * events * (events - 1) / 2;
+    if (ctx->processed != ctx->total || ctx->checksum != expected) {
+        fprintf(stderr, "%s: lost events, %llu of %llu\n", use_pipe ? "pipe" : "eventfd",
+                ctx->processed, ctx->total);
+        ret = -1;
+    }
+    printf("%-8s: %10.0f events/s, %9llu signals, %9llu wakeups, %6.2f events/wakeup\n",
+            use_pipe ? "pipe" : "eventfd", ctx->total * 1e9 / elapsed,
+            ctx->signals, ctx->wakeups,
+            ctx->wakeups ? (double)ctx->processed / ctx->wakeups : 0);
+
+    if (use_pipe) {
+        close(ctx->pipe_fds[0]);
+        close(ctx->pipe_fds[1]);
+    }
+done:
+    pthread_mutex_destroy(&ctx->lock);
+    delete[] threads;
+    delete ctx;
+    return ret;
+}
+
+static void help()
+{
+    printf("\n\n");
+    printf("=============================\n");
+    printf("vidc-msg-bench [options]\n");
+    printf("=============================\n\n");
+    printf("      -p, --producers <#>    Posting threads (default 2)\n");
+    printf("      -e, --events <#>       Events per producer (default 200000)\n");
+    printf("      -w, --work <ns>        Consumer time per event (default 0)\n");
+    printf("      -m, --mode <mode>      pipe | eventfd | both (default both)\n");
+    printf("      -h, --help             Print this menu\n");
+    printf("=============================\n\n\n");
+}
+
+int main(int argc, char **argv)
+{
+    unsigned int producers = 2, events = 200000, work_ns = 0;
+    bool do_pipe = true, do_eventfd = true;
+    struct option longopts[] = {
+        { "producers", required_argument, NULL, 'p'},
+        { "events",    required_argument, NULL, 'e'},
+        { "work",      required_argument, NULL, 'w'},
+        { "mode",      required_argument, NULL, 'm'},
+        { "help",      no_argument,       NULL, 'h'},
+        { NULL,        0,                 NULL,  0},
+    };
+    int command, ret = 0;
+
+    while ((command = getopt_long(argc, argv, "p:e:w:m:h", longopts, NULL)) != -1) {
+        switch (command) {
+            case 'p':
+                producers = strtoul(optarg, NULL, 0);
+                break;
+            case 'e':
+                events = strtoul(optarg, NULL, 0);
+                break;
+            case 'w':
+                work_ns = strtoul(optarg, NULL, 0);
+                break;
+            case 'm':
+                do_pipe = !strcmp(optarg, "pipe") || !strcmp(optarg, "both");
+                do_eventfd = !strcmp(optarg, "eventfd") || !strcmp(optarg, "both");
+                break;
+            default:
+                help();
+                return -1;
+        }
+    }
+    if (!producers || !events || (!do_pipe && !do_eventfd)) {
+        help();
+        return -1;
+    }
+
+    printf("%u producers, %u events each, %u ns per event\n", producers, events, work_ns);
+    if (do_pipe && run(true, producers, events, work_ns))
+        ret = -1;
+    if (do_eventfd && run(false, producers, events, work_ns))
+        ret = -1;
+    return ret;
+}
@@ -0,0 +1,236 @@
+/*
+ * Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * vidc-stride-bench: measures the NV12 stride conversion the encoder runs
+ * on YUV420SemiPlanar input (venc_color_align and the software encoder's
+ * dev_color_align). For each resolution it times the row by row memmove
+ * loop the encoder used before, the in-place conversion and the
+ * out-of-place conversion at each thread count, and checks every result
+ * against the row by row output.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#include <media/msm_media_info.h>
+#include "vidc_stride_conv.h"
+#include "vidc_debug.h"
+
+/* Owned by libOmxVidcCommon in the components, which is not linked here */
+int debug_level = PRIO_ERROR;
+
+static const struct {
+    unsigned int width, height;
+} resolutions[] = {
+    { 176, 144 }, { 720, 480 }, { 1280, 720 }, { 1366, 768 },
+    { 1920, 1080 }, { 2560, 1440 }, { 3840, 2160 }, { 4096, 2160 },
+};
+
+static unsigned long long now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void get_layout(unsigned int width, unsigned int height, struct vidc_nv12_layout *l)
+{
+    l->y_stride = VENUS_Y_STRIDE(COLOR_FMT_NV12, width);
+    l->y_scanlines = VENUS_Y_SCANLINES(COLOR_FMT_NV12, height);
+    l->uv_stride = VENUS_UV_STRIDE(COLOR_FMT_NV12, width);
+    l->uv_scanlines = VENUS_UV_SCANLINES(COLOR_FMT_NV12, height);
+}
+
+/* The conversion venc_color_align did before vidc_stride_conv */
+static void align_rows(OMX_U8 *buf, unsigned int width, unsigned int height,
+        const struct vidc_nv12_layout &l)
+{
+    OMX_U8 *src_buf = buf + width * height, *dst_buf = buf + l.y_stride * l.y_scanlines;
+
+    for (int line = height / 2 - 1; line >= 0; --line)
+        memmove(dst_buf + line * l.uv_stride, src_buf + line * width, width);
+    for (int line = height - 1; line > 0; --line)
+        memmove(buf + line * l.y_stride, buf + line * width, width);
+}
+
+static bool same_picture(const OMX_U8 *a, const OMX_U8 *b, unsigned int width,
+        unsigned int height, const struct vidc_nv12_layout &l)
+{
+    const OMX_U8 *uv_a = a + l.y_stride * l.y_scanlines;
+    const OMX_U8 *uv_b = b + l.y_stride * l.y_scanlines;
+
+    for (unsigned int y = 0; y < height; y++)
+        if (memcmp(a + y * l.y_stride, b + y * l.y_stride, width))
+            return false;
+    for (unsigned int y = 0; y < height / 2; y++)
+        if (memcmp(uv_a + y * l.uv_stride, uv_b + y * l.uv_stride, width))
+            return false;
+    return true;
+}
+
+static void report(const char *name, unsigned long long ns, unsigned int frames,
+        size_t bytes, bool ok)
+{
+    double us = ns / 1e3 / frames;
+
+    printf("  %-18s %9.1f us/frame %8.2f GB/s %s\n", name, us,
+            bytes / (us * 1e3), ok ? "" : "MISMATCH");
+}
+
+static int run(unsigned int width, unsigned int height, unsigned int threads,
+        unsigned int frames)
+{
+    struct vidc_nv12_layout l;
+    size_t src_len = (size_t)width * height * 3 / 2, len;
+    OMX_U8 *src, *ref, *buf, *dst;
+    unsigned long long start, ns;
+    bool ok = true;
+    char name[32];
+    int ret = -1;
+
+    get_layout(width, height, &l);
+    len = VENUS_BUFFER_SIZE(COLOR_FMT_NV12, width, height);
+    src = (OMX_U8 *)malloc(src_len);
+    ref = (OMX_U8 *)calloc(1, len);
+    buf = (OMX_U8 *)calloc(1, len);
+    dst = (OMX_U8 *)calloc(1, len);
+    if (!src || !ref || !buf || !dst) {
+        fprintf(stderr, "Failed to allocate %zu byte frames\n", len);
+        goto done;
+    }
+    for (size_t i = 0; i < src_len; i++)
+        src[i] = (OMX_U8)(i * 7 + i / width);
+
+    printf("%ux%u -> %ux%u, %u frames\n", width, height, l.y_stride, l.y_scanlines, frames);
+
+    ns = 0;
+    for (unsigned int i = 0; i < frames; i++) {
+        memcpy(ref, src, src_len);
+        start = now_ns();
+        align_rows(ref, width, height, l);
+        ns += now_ns() - start;
+    }
+    report("row memmove", ns, frames, src_len, true);
+
+    ns = 0;
+    for (unsigned int i = 0; i < frames; i++) {
+        memcpy(buf, src, src_len);
+        start = now_ns();
+        ok = vidc_stride_conv::align_in_place(buf, len, width, height, l);
+        ns += now_ns() - start;
+    }
+    report("in place", ns, frames, src_len, ok && same_picture(ref, buf, width, height, l));
+
+    for (unsigned int t = 1; t <= threads; t++) {
+        vidc_stride_conv conv(t);
+
+        if (conv.threads() != t)
+            break;
+        ns = 0;
+        for (unsigned int i = 0; i < frames; i++) {
+            start = now_ns();
+            ok = conv.align(src, dst, len, width, height, l);
+            ns += now_ns() - start;
+        }
+        snprintf(name, sizeof(name), "out of place x%u", t);
+        report(name, ns, frames, src_len, ok && same_picture(ref, dst, width, height, l));
+    }
+    ret = 0;
+done:
+    free(src);
+    free(ref);
+    free(buf);
+    free(dst);
+    return ret;
+}
+
+static void help()
+{
+    printf("\n\n");
+    printf("=============================\n");
+    printf("vidc-stride-bench [options]\n");
+    printf("=============================\n\n");
+    printf("      -w, --width <#>        Only this frame width (default: a set of sizes)\n");
+    printf("      -e, --height <#>       Frame height with -w\n");
+    printf("      -t, --threads <#>      Largest thread count to try (default %d)\n",
+            VIDC_STRIDE_CONV_MAX_THREADS);
+    printf("      -f, --frames <#>       Frames per measurement (default 100)\n");
+    printf("      -h, --help             Print this menu\n");
+    printf("=============================\n\n\n");
+}
+
+int main(int argc, char **argv)
+{
+    unsigned int width = 0, height = 0, frames = 100;
+    unsigned int threads = VIDC_STRIDE_CONV_MAX_THREADS;
+    struct option longopts[] = {
+        { "width",   required_argument, NULL, 'w'},
+        { "height",  required_argument, NULL, 'e'},
+        { "threads", required_argument, NULL, 't'},
+        { "frames",  required_argument, NULL, 'f'},
+        { "help",    no_argument,       NULL, 'h'},
+        { NULL,      0,                 NULL,  0},
+    };
+    int command;
+
+    while ((command = getopt_long(argc, argv, "w:e:t:f:h", longopts, NULL)) != -1) {
+        switch (command) {
+            case 'w':
+                width = strtoul(optarg, NULL, 0);
+                break;
+            case 'e':
+                height = strtoul(optarg, NULL, 0);
+                break;
+            case 't':
+                threads = strtoul(optarg, NULL, 0);
+                break;
+            case 'f':
+                frames = strtoul(optarg, NULL, 0);
+                break;
+            default:
+                help();
+                return -1;
+        }
+    }
+    if ((width && height < 2) || (!width && height) ||
+            !threads || threads > VIDC_STRIDE_CONV_MAX_THREADS || !frames) {
+        help();
+        return -1;
+    }
+
+    if (width)
+        return run(width, height, threads, frames);
+    for (size_t i = 0; i < sizeof(resolutions) / sizeof(resolutions[0]); i++)
+        if (run(resolutions[i].width, resolutions[i].height, threads, frames))
+            return -1;
+    return 0;
+}
@@ -0,0 +1,215 @@
+/*
+ * Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * vidc-ts-bench: compares vidc_ts_heap against the fixed array with linear
+ * insert/pop-min scans it replaced in the decoder and vpp components. The
+ * workload queues timestamps in decode order (reordered by a GOP with B
+ * frames) and pops them in presentation order, keeping "depth" entries in
+ * flight like ETB/FBD do. Both structures must return the same sequence.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#include <vector>
+#include "vidc_ts_heap.h"
+
+/* Layout and algorithm of the old ts_arr_list, which had 32 entries */
+class ts_linear_list
+{
+    public:
+        ts_linear_list(int entry_count) : size(entry_count) {
+            reset();
+        }
+        void reset() {
+            memset(entries, 0, sizeof(entries));
+        }
+        bool insert(OMX_TICKS ts) {
+            for (int idx = 0; idx < size; idx++) {
+                if (!entries[idx].valid) {
+                    entries[idx].valid = true;
+                    entries[idx].timestamp = ts;
+                    return true;
+                }
+            }
+            return false;
+        }
+        bool pop_min(OMX_TICKS &ts) {
+            int min_idx = -1;
+
+            for (int idx = 0; idx < size; idx++) {
+                if (entries[idx].valid &&
+                        (min_idx < 0 || entries[idx].timestamp < entries[min_idx].timestamp))
+                    min_idx = idx;
+            }
+            if (min_idx < 0)
+                return false;
+            ts = entries[min_idx].timestamp;
+            entries[min_idx].valid = false;
+            return true;
+        }
+    private:
+        int size;
+        struct {
+            OMX_TICKS timestamp;
+            bool valid;
+        } entries[VIDC_TS_HEAP_SIZE];
+};
+
+static unsigned long long now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* I P B B P B B ... display order, coded as I P B B with the P first */
+static void make_decode_order(std::vector<OMX_TICKS> &ts, unsigned int frames,
+        unsigned int b_frames)
+{
+    unsigned int i = 0;
+
+    ts.clear();
+    while (i < frames) {
+        unsigned int anchor = i + b_frames;
+        if (anchor >= frames)
+            anchor = frames - 1;
+        ts.push_back((OMX_TICKS)anchor * 33333);
+        for (unsigned int b = i; b < anchor; b++)
+            ts.push_back((OMX_TICKS)b * 33333);
+        i = anchor + 1;
+    }
+}
+
+template <class T>
+static double run(T &list, const std::vector<OMX_TICKS> &in, unsigned int depth,
+        std::vector<OMX_TICKS> &out)
+{
+    unsigned long long start;
+    OMX_TICKS ts;
+    size_t next = 0;
+
+    out.clear();
+    list.reset();
+    start = now_ns();
+    while (next < in.size() && next < depth)
+        list.insert(in[next++]);
+    while (list.pop_min(ts)) {
+        out.push_back(ts);
+        if (next < in.size())
+            list.insert(in[next++]);
+    }
+    return (double)(now_ns() - start) / (2 * in.size());
+}
+
+static void help()
+{
+    printf("\n\n");
+    printf("=============================\n");
+    printf("vidc-ts-bench [options]\n");
+    printf("=============================\n\n");
+    printf("      -d, --depth <#>        Timestamps in flight, up to %d (default 32)\n",
+            VIDC_TS_HEAP_SIZE);
+    printf("      -b, --b-frames <#>     B frames between anchors (default 3)\n");
+    printf("      -f, --frames <#>       Frames per pass (default 100000)\n");
+    printf("      -r, --repeat <#>       Passes, best one is reported (default 5)\n");
+    printf("      -h, --help             Print this menu\n");
+    printf("=============================\n\n\n");
+}
+
+int main(int argc, char **argv)
+{
+    unsigned int depth = 32, b_frames = 3, frames = 100000, repeat = 5;
+    struct option longopts[] = {
+        { "depth",    required_argument, NULL, 'd'},
+        { "b-frames", required_argument, NULL, 'b'},
+        { "frames",   required_argument, NULL, 'f'},
+        { "repeat",   required_argument, NULL, 'r'},
+        { "help",     no_argument,       NULL, 'h'},
+        { NULL,       0,                 NULL,  0},
+    };
+    std::vector<OMX_TICKS> in, linear_out, heap_out;
+    double linear_ns = 0, heap_ns = 0;
+    int command;
+
+    while ((command = getopt_long(argc, argv, "d:b:f:r:h", longopts, NULL)) != -1) {
+        switch (command) {
+            case 'd':
+                depth = strtoul(optarg, NULL, 0);
+                break;
+            case 'b':
+                b_frames = strtoul(optarg, NULL, 0);
+                break;
+            case 'f':
+                frames = strtoul(optarg, NULL, 0);
+                break;
+            case 'r':
+                repeat = strtoul(optarg, NULL, 0);
+                break;
+            default:
+                help();
+                return -1;
+        }
+    }
+    if (!depth || depth > VIDC_TS_HEAP_SIZE || !frames || !repeat ||
+            b_frames >= depth) {
+        help();
+        return -1;
+    }
+
+    {
+        ts_linear_list *linear = new ts_linear_list(depth > 32 ? depth : 32);
+        vidc_ts_heap *heap = new vidc_ts_heap;
+
+        make_decode_order(in, frames, b_frames);
+        for (unsigned int i = 0; i < repeat; i++) {
+            double ns = run(*linear, in, depth, linear_out);
+            if (!i || ns < linear_ns)
+                linear_ns = ns;
+            ns = run(*heap, in, depth, heap_out);
+            if (!i || ns < heap_ns)
+                heap_ns = ns;
+        }
+        delete linear;
+        delete heap;
+    }
+
+    if (linear_out != heap_out || heap_out.size() != in.size()) {
+        fprintf(stderr, "Output order mismatch\n");
+        return -1;
+    }
+    printf("depth %u, %u B frames, %u frames\n", depth, b_frames, frames);
+    printf("linear scan : %8.2f ns/op\n", linear_ns);
+    printf("min-heap    : %8.2f ns/op\n", heap_ns);
+    printf("speedup     : %8.2fx\n", heap_ns > 0 ? linear_ns / heap_ns : 0);
+    return 0;
+}
@@ -48,6 +48,11 @@ ifeq ($(TARGET_USES_ION),true)
 libmm-vdec-def += -DUSE_ION
 endif
 
+# Debug levels compiled into the components, e.g. 0x3 drops DEBUG_PRINT_LOW
+ifneq ($(TARGET_VIDC_DEBUG_COMPILED_MASK),)
+libmm-vdec-def += -DVIDC_DEBUG_COMPILED_MASK=$(TARGET_VIDC_DEBUG_COMPILED_MASK)
+endif
+
 ifneq (1,$(filter 1,$(shell echo "$$(( $(PLATFORM_SDK_VERSION) >= 18 ))" )))
 libmm-vdec-def += -DANDROID_JELLYBEAN_MR1=1
 endif
@@ -87,6 +92,45 @@ ifeq ($(call is-platform-sdk-version-at-least, 22),true)
 libmm-vdec-def += -DFLEXYUV_SUPPORTED
 endif
 
+# ---------------------------------------------------------------------------------
+# 			Make the Static library (libOmxVdecAuAssembler)
+# ---------------------------------------------------------------------------------
+
+# Arbitrary-bytes framing (start code / NAL parsing and AU assembly). It does
+# not depend on V4L2 or ION so it is also built for the host.
+libmm-vdec-au-src       := src/au_assembler.cpp
+libmm-vdec-au-src       += src/frameparser.cpp
+libmm-vdec-au-src       += src/h264_utils.cpp
+libmm-vdec-au-src       += src/hevc_utils.cpp
+libmm-vdec-au-src       += src/mp4_utils.cpp
+libmm-vdec-au-src       += src/param_set_cache.cpp
+
+libmm-vdec-au-inc       := $(LOCAL_PATH)/inc
+libmm-vdec-au-inc       += $(OMX_VIDEO_PATH)/vidc/common/inc
+libmm-vdec-au-inc       += $(call project-path-for,qcom-media)/mm-core/inc
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE                    := libOmxVdecAuAssembler
+LOCAL_MODULE_TAGS               := optional
+LOCAL_CFLAGS                    := $(libmm-vdec-def) -Werror
+LOCAL_C_INCLUDES                := $(libmm-vdec-au-inc)
+LOCAL_SHARED_LIBRARIES          := liblog libcutils
+LOCAL_SRC_FILES                 := $(libmm-vdec-au-src)
+
+include $(BUILD_STATIC_LIBRARY)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE                    := libOmxVdecAuAssembler
+LOCAL_MODULE_TAGS               := optional
+LOCAL_CFLAGS                    := $(libmm-vdec-def)
+LOCAL_C_INCLUDES                := $(libmm-vdec-au-inc)
+LOCAL_SHARED_LIBRARIES          := liblog libcutils
+LOCAL_SRC_FILES                 := $(libmm-vdec-au-src)
+
+include $(BUILD_HOST_STATIC_LIBRARY)
+
 # ---------------------------------------------------------------------------------
 # 			Make the Shared library (libOmxVdec)
 # ---------------------------------------------------------------------------------
@@ -105,12 +149,8 @@ LOCAL_SHARED_LIBRARIES  := liblog libutils libbinder libcutils libdl
 LOCAL_SHARED_LIBRARIES  += libdivxdrmdecrypt
 LOCAL_SHARED_LIBRARIES  += libqdMetaData
 
-LOCAL_SRC_FILES         := src/frameparser.cpp
-LOCAL_SRC_FILES         += src/h264_utils.cpp
-LOCAL_SRC_FILES         += src/ts_parser.cpp
-LOCAL_SRC_FILES         += src/mp4_utils.cpp
-LOCAL_SRC_FILES         += src/hevc_utils.cpp
-LOCAL_STATIC_LIBRARIES  := libOmxVidcCommon
+LOCAL_SRC_FILES         := src/ts_parser.cpp
+LOCAL_STATIC_LIBRARIES  := libOmxVdecAuAssembler libOmxVidcCommon
 LOCAL_SRC_FILES         += src/omx_vdec_msm8974.cpp
 
 include $(BUILD_SHARED_LIBRARY)
@@ -139,10 +179,7 @@ LOCAL_SHARED_LIBRARIES  := liblog libutils libbinder libcutils libdl
 LOCAL_SHARED_LIBRARIES  += libdivxdrmdecrypt
 LOCAL_SHARED_LIBRARIES  += libqdMetaData
 
-LOCAL_SRC_FILES         := src/frameparser.cpp
-LOCAL_SRC_FILES         += src/h264_utils.cpp
-LOCAL_SRC_FILES         += src/ts_parser.cpp
-LOCAL_SRC_FILES         += src/mp4_utils.cpp
+LOCAL_SRC_FILES         := src/ts_parser.cpp
 
 ifeq ($(call is-board-platform-in-list, $(TARGETS_THAT_NEED_SW_HEVC)),true)
 LOCAL_SHARED_LIBRARIES  += libHevcSwDecoder
@@ -151,9 +188,7 @@ else
 LOCAL_SRC_FILES         += src/omx_vdec_hevc.cpp
 endif
 
-LOCAL_SRC_FILES         += src/hevc_utils.cpp
-
-LOCAL_STATIC_LIBRARIES  := libOmxVidcCommon
+LOCAL_STATIC_LIBRARIES  := libOmxVdecAuAssembler libOmxVidcCommon
 
 include $(BUILD_SHARED_LIBRARY)
 
@@ -31,215 +31,207 @@ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <stdio.h>
 using namespace std;
 
+/* Entries held inside the Map itself, parameter set maps stay below this */
+#define MAP_INLINE_ENTRIES 8
+
+/*
+ * Key to value map kept as an array sorted by key. Lookups are a binary
+ * search over contiguous entries and do not modify the map, so concurrent
+ * readers are safe. The first MAP_INLINE_ENTRIES entries need no
+ * allocation, past that the array grows by doubling.
+ *
+ * T needs operator< and operator==. Like std::map::insert, inserting a key
+ * already present keeps its value. find() and find_ele() return 0 for a
+ * missing key. Entries are iterated in key order through key_at() and
+ * value_at() for indexes below size().
+ */
 template <typename T,typename T2>
 class Map
 {
-    struct node {
+    struct entry {
         T    data;
         T2   data2;
-        node* prev;
-        node* next;
-        node(T t, T2 t2,node* p, node* n) :
-            data(t), data2(t2), prev(p), next(n) {}
     };
-    node* head;
-    node* tail;
-    node* tmp;
+    entry  inline_entries[MAP_INLINE_ENTRIES];
+    entry *entries;
     unsigned size_of_list;
-    static Map<T,T2> *m_self;
+    unsigned capacity;
+
+    /* Index of the first entry whose key is not below d. The binary search
+       keeps no branch on the comparison, whose outcome cannot be predicted;
+       it beats scanning even four entries. */
+    unsigned lower_bound(const T &d) const {
+        const entry *base = entries;
+        unsigned n = size_of_list;
+
+        if (!n)
+            return 0;
+        while (n > 1) {
+            unsigned half = n / 2;
+            base = base[half].data < d ? base + half : base;
+            n -= half;
+        }
+        return (base - entries) + (base->data < d);
+    }
+    void copy_from(const Map &other);
+    void release() {
+        if (entries != inline_entries)
+            delete[] entries;
+        entries = inline_entries;
+        capacity = MAP_INLINE_ENTRIES;
+        size_of_list = 0;
+    }
     public:
-    Map() : head( NULL ), tail ( NULL ),tmp(head),size_of_list(0) {}
+    Map() : entries(inline_entries), size_of_list(0),
+        capacity(MAP_INLINE_ENTRIES) {}
+    Map(const Map &other) : entries(inline_entries), size_of_list(0),
+        capacity(MAP_INLINE_ENTRIES) {
+        copy_from(other);
+    }
+    Map &operator=(const Map &other) {
+        if (this != &other) {
+            release();
+            copy_from(other);
+        }
+        return *this;
+    }
     bool empty() const {
-        return ( !head || !tail );
+        return !size_of_list;
     }
     operator bool() const {
         return !empty();
     }
-    void insert(T,T2);
-    void show();
-    int  size();
-    T2 find(T); // Return VALUE
-    T find_ele(T);// Check if the KEY is present or not
-    T2 begin(); //give the first ele
+    bool insert(T,T2);
+    void show() const;
+    int  size() const {
+        return size_of_list;
+    }
+    T2 find(T) const; // Return VALUE
+    T find_ele(T) const;// Check if the KEY is present or not
+    T2 begin() const; //give the value of the smallest key
     bool erase(T);
     bool eraseall();
-    bool isempty();
+    bool isempty() const {
+        return empty();
+    }
+    const T &key_at(unsigned i) const {
+        return entries[i].data;
+    }
+    const T2 &value_at(unsigned i) const {
+        return entries[i].data2;
+    }
     ~Map() {
-        while (head) {
-            node* temp(head);
-            head=head->next;
-            size_of_list--;
-            delete temp;
-        }
+        release();
     }
 };
 
     template <typename T,typename T2>
-T2 Map<T,T2>::find(T d1)
+void Map<T,T2>::copy_from(const Map &other)
 {
-    tmp = head;
-
-    while (tmp) {
-        if (tmp->data == d1) {
-            return tmp->data2;
-        }
-
-        tmp = tmp->next;
+    if (other.size_of_list > capacity) {
+        entries = new entry[other.capacity];
+        capacity = other.capacity;
     }
 
-    return 0;
+    for (unsigned i = 0; i < other.size_of_list; i++)
+        entries[i] = other.entries[i];
+
+    size_of_list = other.size_of_list;
 }
 
     template <typename T,typename T2>
-T Map<T,T2>::find_ele(T d1)
+T2 Map<T,T2>::find(T d1) const
 {
-    tmp = head;
+    unsigned i = lower_bound(d1);
 
-    while (tmp) {
-        if (tmp->data == d1) {
-            return tmp->data;
-        }
-
-        tmp = tmp->next;
-    }
+    if (i < size_of_list && entries[i].data == d1)
+        return entries[i].data2;
 
     return 0;
 }
 
     template <typename T,typename T2>
-T2 Map<T,T2>::begin()
+T Map<T,T2>::find_ele(T d1) const
 {
-    tmp = head;
+    unsigned i = lower_bound(d1);
 
-    if (tmp) {
-        return (tmp->data2);
-    }
+    if (i < size_of_list && entries[i].data == d1)
+        return entries[i].data;
 
     return 0;
 }
 
     template <typename T,typename T2>
-void Map<T,T2>::show()
+T2 Map<T,T2>::begin() const
 {
-    tmp = head;
+    if (size_of_list)
+        return entries[0].data2;
 
-    while (tmp) {
-        printf("%d-->%d\n",tmp->data,tmp->data2);
-        tmp = tmp->next;
-    }
+    return 0;
 }
 
     template <typename T,typename T2>
-int Map<T,T2>::size()
+void Map<T,T2>::show() const
 {
-    int count =0;
-    tmp = head;
-
-    while (tmp) {
-        tmp = tmp->next;
-        count++;
-    }
-
-    return count;
+    for (unsigned i = 0; i < size_of_list; i++)
+        printf("%d-->%d\n",entries[i].data,entries[i].data2);
 }
 
     template <typename T,typename T2>
-void Map<T,T2>::insert(T data, T2 data2)
+bool Map<T,T2>::insert(T data, T2 data2)
 {
-    tail = new node(data, data2,tail, NULL);
+    unsigned i, j;
+
+    /* Ids mostly arrive in ascending order and are appended */
+    if (!size_of_list || entries[size_of_list - 1].data < data) {
+        i = size_of_list;
+    } else {
+        i = lower_bound(data);
+        if (entries[i].data == data)
+            return false;
+    }
 
-    if ( tail->prev )
-        tail->prev->next = tail;
+    if (size_of_list == capacity) {
+        entry *grown = new entry[capacity * 2];
 
-    if ( empty() ) {
-        head = tail;
-        tmp=head;
+        for (j = 0; j < size_of_list; j++)
+            grown[j] = entries[j];
+
+        if (entries != inline_entries)
+            delete[] entries;
+
+        entries = grown;
+        capacity *= 2;
     }
 
-    tmp = head;
+    for (j = size_of_list; j > i; j--)
+        entries[j] = entries[j - 1];
+
+    entries[i].data = data;
+    entries[i].data2 = data2;
     size_of_list++;
+    return true;
 }
 
     template <typename T,typename T2>
 bool Map<T,T2>::erase(T d)
 {
-    bool found = false;
-    tmp = head;
-    node* prevnode = tmp;
-    node *tempnode;
-
-    while (tmp) {
-        if ((head == tail) && (head->data == d)) {
-            found = true;
-            tempnode = head;
-            head = tail = NULL;
-            delete tempnode;
-            break;
-        }
-
-        if ((tmp ==head) && (tmp->data ==d)) {
-            found = true;
-            tempnode = tmp;
-            tmp = tmp->next;
-            tmp->prev = NULL;
-            head = tmp;
-            tempnode->next = NULL;
-            delete tempnode;
-            break;
-        }
+    unsigned i = lower_bound(d);
 
-        if ((tmp == tail) && (tmp->data ==d)) {
-            found = true;
-            tempnode = tmp;
-            prevnode->next = NULL;
-            tmp->prev = NULL;
-            tail = prevnode;
-            delete tempnode;
-            break;
-        }
+    if (i == size_of_list || !(entries[i].data == d))
+        return false;
 
-        if (tmp->data == d) {
-            found = true;
-            prevnode->next = tmp->next;
-            tmp->next->prev = prevnode->next;
-            tempnode = tmp;
-            //tmp = tmp->next;
-            delete tempnode;
-            break;
-        }
+    for (size_of_list--; i < size_of_list; i++)
+        entries[i] = entries[i + 1];
 
-        prevnode = tmp;
-        tmp = tmp->next;
-    }
-
-    if (found)size_of_list--;
-
-    return found;
+    return true;
 }
 
     template <typename T,typename T2>
 bool Map<T,T2>::eraseall()
 {
-    node *tempnode;
-    tmp = head;
-
-    while (head) {
-        tempnode = head;
-        tempnode->next = NULL;
-        head = head->next;
-        delete tempnode;
-    }
-
-    tail = head = NULL;
+    release();
     return true;
 }
 
-
-    template <typename T,typename T2>
-bool Map<T,T2>::isempty()
-{
-    if (!size_of_list) return true;
-    else return false;
-}
-
 #endif // _MAP_H_
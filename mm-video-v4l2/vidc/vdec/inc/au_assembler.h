@@ -0,0 +1,208 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2015, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of The Linux Foundation nor
+      the names of its contributors may be used to endorse or promote
+      products derived from this software without specific prior written
+      permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+#ifndef AU_ASSEMBLER_H
+#define AU_ASSEMBLER_H
+
+#include "OMX_Core.h"
+#include "OMX_QCOMExtns.h"
+#include "frameparser.h"
+#include "h264_utils.h"
+#include "hevc_utils.h"
+#include "mp4_utils.h"
+
+/* A complete NAL located by the assembler. The start code is searched and
+ * the NAL header read once per NAL, then the unit is routed by type to the
+ * client and to the boundary detector, neither of which re-parses it. */
+struct au_nal_unit {
+    OMX_BUFFERHEADERTYPE *buffer;   /* NAL including its start code */
+    OMX_U8  *header;                /* first byte of the NAL header */
+    OMX_U8  *payload;               /* first byte after the NAL header */
+    OMX_U32 payload_len;            /* bytes available, a prefix for slices */
+    OMX_U32 type;                   /* nal_unit_type in the codec numbering */
+};
+
+/* Component side of the access unit assembler: owns the source and
+ * destination buffer queues and the decoder the AUs are handed to. */
+class au_assembler_client
+{
+    public:
+        virtual ~au_assembler_client() {}
+        /* Queue a complete access unit to the decoder */
+        virtual OMX_ERRORTYPE au_ready(OMX_BUFFERHEADERTYPE *dest) = 0;
+        /* Next free destination buffer, NULL if none is available */
+        virtual OMX_BUFFERHEADERTYPE *get_free_dest() = 0;
+        /* Give back a destination buffer that ended up empty */
+        virtual void return_dest(OMX_BUFFERHEADERTYPE *dest) = 0;
+        /* Next pending source buffer, NULL if none is available */
+        virtual OMX_BUFFERHEADERTYPE *get_next_source() = 0;
+        /* Hand a fully consumed source buffer back to the client */
+        virtual void source_done(OMX_BUFFERHEADERTYPE *source) = 0;
+        /* Called with every located NAL before AU boundary detection */
+        virtual void nal_parsed(const au_nal_unit &nal) {
+            (void)nal;
+        }
+        /* Called when a pending AU timestamp is carried onto its destination */
+        virtual void au_started(OMX_S64 timestamp) {
+            (void)timestamp;
+        }
+        /* Timestamp derived from SEI/VUI for an AU, LLONG_MAX if unknown */
+        virtual OMX_S64 au_timestamp(OMX_S64 timestamp) {
+            return timestamp;
+        }
+        /* Called when an SPS that changes the stream gets activated, before
+           the AU that activates it is handed to au_ready. changes holds the
+           STREAM_CHANGE_* flags. */
+        virtual void stream_changed(OMX_U32 changes, const stream_params &params) {
+            (void)changes;
+            (void)params;
+        }
+};
+
+/* Decides whether a complete NAL starts a new access unit */
+class au_boundary_detector
+{
+    public:
+        virtual ~au_boundary_detector() {}
+        virtual bool allocate(OMX_U32 max_nal_size) {
+            (void)max_nal_size;
+            return true;
+        }
+        virtual void reset() = 0;
+        /* Size of the NAL header and the nal_unit_type it carries */
+        virtual OMX_U32 header_size() = 0;
+        virtual OMX_U32 unit_type(const OMX_U8 *header) = 0;
+        virtual bool is_new_frame(const au_nal_unit &nal, OMX_BOOL &new_frame) = 0;
+        /* STREAM_CHANGE_* flags raised by the NALs seen since the last call */
+        virtual OMX_U32 stream_change(stream_params &params) {
+            (void)params;
+            return 0;
+        }
+};
+
+class h264_au_detector : public au_boundary_detector
+{
+    public:
+        bool allocate(OMX_U32 max_nal_size);
+        void reset();
+        OMX_U32 header_size() {
+            return 1;
+        }
+        OMX_U32 unit_type(const OMX_U8 *header) {
+            return header[0] & 0x1F;
+        }
+        bool is_new_frame(const au_nal_unit &nal, OMX_BOOL &new_frame);
+        OMX_U32 stream_change(stream_params &params) {
+            return utils.stream_change(params);
+        }
+    private:
+        H264_Utils utils;
+};
+
+class hevc_au_detector : public au_boundary_detector
+{
+    public:
+        void reset();
+        OMX_U32 header_size() {
+            return 2;
+        }
+        OMX_U32 unit_type(const OMX_U8 *header) {
+            return (header[0] & 0x7E) >> 1;
+        }
+        bool is_new_frame(const au_nal_unit &nal, OMX_BOOL &new_frame);
+        OMX_U32 stream_change(stream_params &params) {
+            return utils.stream_change(params);
+        }
+    private:
+        HEVC_Utils utils;
+};
+
+/* Stitches arbitrary-bytes input into complete access units. Start code
+ * codecs (MPEG4/H263/MPEG2/VC1 AP) are framed by frame_parse alone, NAL
+ * codecs (H.264/HEVC) use a boundary detector on every complete NAL. */
+class AccessUnitAssembler
+{
+    public:
+        AccessUnitAssembler();
+        ~AccessUnitAssembler();
+
+        int init(codec_type codec, au_assembler_client *client);
+        bool allocate(OMX_U32 max_au_size);
+        void deallocate();
+        int set_nal_length(unsigned int length);
+        /* Must be called before init() */
+        void set_zero_copy(bool enable) {
+            zero_copy = enable;
+        }
+        void set_source_count(OMX_U32 count) {
+            source_count = count;
+        }
+        void reset();
+        /* Copies the pending NAL out of the client buffers and hands back
+         * every source buffer held for it, keeping the parser state */
+        void release_sources();
+
+        /* Parses source into dest until one of them is exhausted or an AU
+         * is completed. Both pointers are replaced as buffers are handed
+         * back and refilled through the client, and may become NULL. */
+        OMX_ERRORTYPE push(OMX_BUFFERHEADERTYPE *&source, OMX_BUFFERHEADERTYPE *&dest);
+
+    private:
+        OMX_ERRORTYPE push_sc(OMX_BUFFERHEADERTYPE *&psource_frame,
+                OMX_BUFFERHEADERTYPE *&pdest_frame);
+        OMX_ERRORTYPE push_h264(OMX_BUFFERHEADERTYPE *&psource_frame,
+                OMX_BUFFERHEADERTYPE *&pdest_frame);
+        OMX_ERRORTYPE push_hevc(OMX_BUFFERHEADERTYPE *&psource_frame,
+                OMX_BUFFERHEADERTYPE *&pdest_frame);
+        int parse_nal(OMX_BUFFERHEADERTYPE *source, OMX_U32 *partial_frame);
+        void copy_scratch(OMX_BUFFERHEADERTYPE *dest);
+        bool locate_nal_unit(OMX_BUFFERHEADERTYPE *nal, au_nal_unit &unit);
+        void detect_boundary(const au_nal_unit &nal, OMX_BOOL &new_frame);
+        bool prepare_nal_head(OMX_BUFFERHEADERTYPE &nal_head, au_nal_unit &unit);
+        void flatten_nal();
+        void reset_spans();
+        OMX_BUFFERHEADERTYPE *next_source();
+        OMX_BUFFERHEADERTYPE *next_dest();
+
+        codec_type codec;
+        au_assembler_client *client;
+        au_boundary_detector *detector;
+        frame_parse parser;
+        MP4_Utils mp4_headerparser;
+        OMX_BUFFERHEADERTYPE scratch;
+        nal_span_list spans;
+        bool zero_copy;
+        OMX_U32 source_count;
+        unsigned int nal_length;
+        bool look_ahead_nal;
+        unsigned nal_count;
+        unsigned frame_count;
+        OMX_S64 last_au_ts;
+        OMX_U32 last_au_flags;
+};
+
+#endif /* AU_ASSEMBLER_H */
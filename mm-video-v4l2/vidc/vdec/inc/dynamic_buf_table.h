@@ -0,0 +1,228 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2015, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+    * Neither the name of The Linux Foundation nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+#ifndef __DYNAMIC_BUF_TABLE_H__
+#define __DYNAMIC_BUF_TABLE_H__
+
+#include <stdlib.h>
+#include <unistd.h>
+#include "OMX_Types.h"
+
+struct dynamic_buf_list {
+    OMX_U32 fd;
+    OMX_U32 dup_fd;
+    OMX_U32 offset;
+    OMX_U32 ref_count;
+};
+
+/*
+ * References the firmware holds on dynamic output buffers, keyed by
+ * (fd, offset). Entries live in a fixed array of one slot per output buffer;
+ * an open-addressed index with linear probing maps the key to its slot, so
+ * add and remove no longer walk every output buffer. The index is kept at
+ * most half full and deletions shift later probes back instead of leaving
+ * tombstones, so lookups stay short for the lifetime of the port.
+ *
+ * The first reference on a buffer dups its fd so the memory stays alive
+ * while the firmware uses it; the dup is closed when the last reference is
+ * dropped or the table is torn down.
+ *
+ * Not thread safe, callers serialize access.
+ */
+class dynamic_buf_table
+{
+    public:
+        dynamic_buf_table()
+            : m_entries(NULL), m_count(0), m_index(NULL), m_mask(0),
+              m_free(NULL), m_free_count(0), m_held_refs(0) {
+        }
+
+        ~dynamic_buf_table() {
+            deinit();
+        }
+
+        bool init(unsigned int count) {
+            unsigned int index_size = 8;
+
+            deinit();
+            while (index_size < 2 * count)
+                index_size <<= 1;
+            m_entries = (struct dynamic_buf_list *)calloc(count, sizeof(*m_entries));
+            m_index = (unsigned int *)calloc(index_size, sizeof(*m_index));
+            m_free = (unsigned int *)calloc(count, sizeof(*m_free));
+            if (!m_entries || !m_index || !m_free) {
+                deinit();
+                return false;
+            }
+            m_count = count;
+            m_mask = index_size - 1;
+            for (unsigned int i = 0; i < count; i++)
+                m_free[i] = count - 1 - i;
+            m_free_count = count;
+            return true;
+        }
+
+        /* Closes the fds of buffers the firmware never released */
+        void deinit() {
+            if (m_index) {
+                for (unsigned int i = 0; i <= m_mask; i++) {
+                    if (m_index[i])
+                        close(m_entries[m_index[i] - 1].dup_fd);
+                }
+            }
+            free(m_entries);
+            free(m_index);
+            free(m_free);
+            m_entries = NULL;
+            m_index = NULL;
+            m_free = NULL;
+            m_count = m_mask = m_free_count = m_held_refs = 0;
+        }
+
+        bool is_init() const {
+            return m_entries != NULL;
+        }
+
+        /* Returns the new reference count, or -1 if the buffer could not be
+         * tracked (table full or dup failed) */
+        int add(OMX_U32 fd, OMX_U32 offset) {
+            unsigned int pos;
+            struct dynamic_buf_list *entry;
+            int dup_fd;
+
+            if (find(fd, offset, &pos)) {
+                entry = &m_entries[m_index[pos] - 1];
+            } else {
+                if (!m_free_count)
+                    return -1;
+                dup_fd = dup(fd);
+                if (dup_fd < 0)
+                    return -1;
+                m_index[pos] = m_free[--m_free_count] + 1;
+                entry = &m_entries[m_index[pos] - 1];
+                entry->fd = fd;
+                entry->offset = offset;
+                entry->dup_fd = dup_fd;
+                entry->ref_count = 0;
+            }
+            entry->ref_count++;
+            m_held_refs++;
+            return entry->ref_count;
+        }
+
+        /* Returns the remaining reference count, or -1 if the buffer is not
+         * in the table */
+        int remove(OMX_U32 fd, OMX_U32 offset) {
+            unsigned int pos, slot;
+            struct dynamic_buf_list *entry;
+
+            if (!find(fd, offset, &pos))
+                return -1;
+            slot = m_index[pos] - 1;
+            entry = &m_entries[slot];
+            entry->ref_count--;
+            m_held_refs--;
+            if (entry->ref_count)
+                return entry->ref_count;
+            close(entry->dup_fd);
+            entry->fd = entry->dup_fd = entry->offset = 0;
+            m_free[m_free_count++] = slot;
+            erase(pos);
+            return 0;
+        }
+
+        int ref_count(OMX_U32 fd, OMX_U32 offset) const {
+            unsigned int pos;
+
+            if (!find(fd, offset, &pos))
+                return 0;
+            return m_entries[m_index[pos] - 1].ref_count;
+        }
+
+        /* Buffers the firmware currently holds at least one reference on */
+        unsigned int held_buffers() const {
+            return m_count - m_free_count;
+        }
+
+        /* Sum of all reference counts */
+        unsigned int held_refs() const {
+            return m_held_refs;
+        }
+
+    private:
+        static unsigned int hash(OMX_U32 fd, OMX_U32 offset) {
+            unsigned int h = fd * 0x9e3779b1u ^ offset * 0x85ebca77u;
+            return h ^ (h >> 15);
+        }
+
+        /* On a miss pos is the empty index position the key would go to */
+        bool find(OMX_U32 fd, OMX_U32 offset, unsigned int *pos) const {
+            unsigned int i;
+
+            *pos = 0;
+            if (!m_index)
+                return false;
+            for (i = hash(fd, offset) & m_mask; m_index[i]; i = (i + 1) & m_mask) {
+                const struct dynamic_buf_list &entry = m_entries[m_index[i] - 1];
+                if (entry.fd == fd && entry.offset == offset)
+                    break;
+            }
+            *pos = i;
+            return m_index[i] != 0;
+        }
+
+        /* Backward shift deletion: move later members of the probe run into
+         * the hole when their home position does not lie past it */
+        void erase(unsigned int hole) {
+            unsigned int i = hole;
+
+            for (;;) {
+                i = (i + 1) & m_mask;
+                if (!m_index[i])
+                    break;
+                const struct dynamic_buf_list &entry = m_entries[m_index[i] - 1];
+                unsigned int home = hash(entry.fd, entry.offset) & m_mask;
+                if (((i - home) & m_mask) >= ((i - hole) & m_mask)) {
+                    m_index[hole] = m_index[i];
+                    hole = i;
+                }
+            }
+            m_index[hole] = 0;
+        }
+
+        struct dynamic_buf_list *m_entries;
+        unsigned int m_count;
+        /* Slot + 1 per position, 0 when empty */
+        unsigned int *m_index;
+        unsigned int m_mask;
+        unsigned int *m_free;
+        unsigned int m_free_count;
+        unsigned int m_held_refs;
+};
+
+#endif /* __DYNAMIC_BUF_TABLE_H__ */
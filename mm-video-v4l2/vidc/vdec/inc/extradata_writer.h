@@ -0,0 +1,215 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2015, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+    * Neither the name of The Linux Foundation nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+#ifndef __EXTRADATA_WRITER_H__
+#define __EXTRADATA_WRITER_H__
+
+#include <stddef.h>
+#include <string.h>
+#include "OMX_Core.h"
+
+enum extradata_record {
+    EXTRADATA_REC_INTERLACE,
+    EXTRADATA_REC_FRAMEINFO,
+    EXTRADATA_REC_FRAMEDIMENSION,
+    EXTRADATA_REC_FRAMEPACK,
+    EXTRADATA_REC_QP,
+    EXTRADATA_REC_BITSINFO,
+    EXTRADATA_REC_USERDATA,
+    EXTRADATA_REC_PORTDEF,
+    EXTRADATA_REC_MAX
+};
+
+/*
+ * Appends OMX extradata records behind the frame in an output buffer.
+ *
+ * The headers of every record the decoder emits are built once into
+ * templates, so appending a record copies its template and hands back the
+ * record for the caller to fill in the payload. Payloads that open with
+ * their own nSize/nVersion/nPortIndex get those stamped by the template too.
+ *
+ * Every append checks the record plus a terminator against the space left,
+ * one compare, and drops the record rather than writing past the end, so
+ * the frame can always be closed. Variable sized user data also has to
+ * leave room for one record of each enabled fixed size type, so it cannot
+ * crowd out the records the client asked for; begin() reports whether that
+ * room exists at all.
+ *
+ * Not thread safe, callers serialize access.
+ */
+class extradata_writer
+{
+    public:
+        extradata_writer()
+            : m_version(0), m_port(0), m_reserved(0), m_cur(NULL), m_end(NULL) {
+            memset(m_tmpl, 0, sizeof(m_tmpl));
+        }
+
+        void init(OMX_U32 version, OMX_U32 port) {
+            m_version = version;
+            m_port = port;
+            m_reserved = 0;
+            memset(m_tmpl, 0, sizeof(m_tmpl));
+        }
+
+        /* size is the whole record rounded to 4 bytes, for variable sized
+         * records the size without payload. versioned_payload stamps the
+         * OMX struct header that opens the payload. */
+        void set_template(extradata_record rec, OMX_U32 type, OMX_U32 size,
+                OMX_U32 data_size, bool versioned_payload, bool enabled) {
+            struct record_template *t = &m_tmpl[rec];
+            OMX_OTHER_EXTRADATATYPE *hdr = (OMX_OTHER_EXTRADATATYPE *)(void *)t->bytes;
+            OMX_U32 *payload = (OMX_U32 *)(void *)hdr->data;
+
+            if (t->reserved)
+                m_reserved -= t->size;
+            memset(t, 0, sizeof(*t));
+            hdr->nSize = size;
+            hdr->nVersion.nVersion = m_version;
+            hdr->nPortIndex = m_port;
+            hdr->eType = (OMX_EXTRADATATYPE)type;
+            hdr->nDataSize = data_size;
+            if (versioned_payload) {
+                payload[0] = data_size;
+                payload[1] = m_version;
+                payload[2] = m_port;
+            }
+            t->versioned = versioned_payload;
+            t->size = size;
+            t->fixed = data_size != 0;
+            t->reserved = enabled && t->fixed;
+            if (t->reserved)
+                m_reserved += size;
+        }
+
+        /* Starts a frame; returns false if the enabled records may not fit */
+        bool begin(OMX_U8 *start, OMX_U8 *end) {
+            m_cur = (OMX_U8 *)(((unsigned long)start + 3) & ~3UL);
+            m_end = end;
+            if (!start || !end || m_cur > end) {
+                m_cur = m_end = NULL;
+                return false;
+            }
+            return left() >= m_reserved + sizeof(OMX_OTHER_EXTRADATATYPE);
+        }
+
+        /* Returns the record with its header stamped, NULL if it does not fit */
+        OMX_OTHER_EXTRADATATYPE *append(extradata_record rec) {
+            const struct record_template *t = &m_tmpl[rec];
+            OMX_U8 *cur = m_cur;
+
+            if (left() < (size_t)t->size + sizeof(OMX_OTHER_EXTRADATATYPE))
+                return NULL;
+            /* Whatever the caller writes into the record may alias the
+             * writer, so the cursor moves before the record is stamped */
+            m_cur = cur + t->size;
+            copy((OMX_OTHER_EXTRADATATYPE *)(void *)cur, t);
+            return (OMX_OTHER_EXTRADATATYPE *)(void *)cur;
+        }
+
+        /* Variable sized record with a payload of data_size bytes, which
+         * leaves room for one record of each enabled fixed size type */
+        OMX_OTHER_EXTRADATATYPE *append(extradata_record rec, OMX_U32 data_size) {
+            OMX_U32 size = record_size(rec, data_size);
+            OMX_OTHER_EXTRADATATYPE *extra = (OMX_OTHER_EXTRADATATYPE *)(void *)m_cur;
+
+            if (size < data_size ||
+                    left() < size + m_reserved + sizeof(OMX_OTHER_EXTRADATATYPE))
+                return NULL;
+            m_cur += size;
+            copy(extra, &m_tmpl[rec]);
+            extra->nSize = size;
+            extra->nDataSize = data_size;
+            return extra;
+        }
+
+        /* data_size only counts for variable sized records */
+        OMX_U32 record_size(extradata_record rec, OMX_U32 data_size = 0) const {
+            const struct record_template *t = &m_tmpl[rec];
+
+            return t->fixed ? t->size : (t->size + data_size + 3) & ~3U;
+        }
+
+        /* Stamps the template into a record outside the frame being written */
+        void stamp(OMX_OTHER_EXTRADATATYPE *extra, extradata_record rec) const {
+            copy(extra, &m_tmpl[rec]);
+        }
+
+        /* Writes the terminator and closes the frame */
+        OMX_OTHER_EXTRADATATYPE *finish() {
+            OMX_OTHER_EXTRADATATYPE *extra = (OMX_OTHER_EXTRADATATYPE *)(void *)m_cur;
+            bool fits = left() >= sizeof(OMX_OTHER_EXTRADATATYPE);
+
+            m_cur = m_end = NULL;
+            if (!fits)
+                return NULL;
+            extra->nSize = sizeof(OMX_OTHER_EXTRADATATYPE);
+            extra->nVersion.nVersion = m_version;
+            extra->nPortIndex = m_port;
+            extra->eType = OMX_ExtraDataNone;
+            extra->nDataSize = 0;
+            extra->data[0] = 0;
+            return extra;
+        }
+
+    private:
+        enum {
+            EXTRADATA_HDR_SIZE = offsetof(OMX_OTHER_EXTRADATATYPE, data),
+            EXTRADATA_TEMPLATE_SIZE = EXTRADATA_HDR_SIZE + 3 * sizeof(OMX_U32),
+        };
+
+        struct record_template {
+            OMX_U32 bytes[EXTRADATA_TEMPLATE_SIZE / sizeof(OMX_U32)];
+            OMX_U32 size;
+            bool versioned;
+            bool fixed;
+            bool reserved;
+        };
+
+        /* Fixed size copies so the compiler inlines them */
+        static void copy(OMX_OTHER_EXTRADATATYPE *extra, const struct record_template *t) {
+            memcpy(extra, t->bytes, EXTRADATA_HDR_SIZE);
+            if (t->versioned)
+                memcpy(extra->data, (const OMX_U8 *)t->bytes + EXTRADATA_HDR_SIZE,
+                        EXTRADATA_TEMPLATE_SIZE - EXTRADATA_HDR_SIZE);
+        }
+
+        /* Bytes left in the frame, 0 once it is closed */
+        size_t left() const {
+            return m_end - m_cur;
+        }
+
+        OMX_U32 m_version;
+        OMX_U32 m_port;
+        size_t m_reserved;
+        struct record_template m_tmpl[EXTRADATA_REC_MAX];
+        OMX_U8 *m_cur;
+        OMX_U8 *m_end;
+};
+
+#endif
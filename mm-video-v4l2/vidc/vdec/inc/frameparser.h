@@ -61,11 +61,48 @@ enum state_nal_parse {
     NAL_PARSING
 };
 
+#define MAX_NAL_SPANS 64
+#define MAX_NAL_HELD_BUFFERS 8
+
+struct nal_span {
+    const OMX_U8 *data;
+    OMX_U32 len;
+};
+
+/* Scatter list describing the bytes of the NAL being assembled. Spans point
+ * either at the static start code tables or into client source buffers, so
+ * a source buffer must be held (not returned) while a span refers to it. */
+class nal_span_list
+{
+    public:
+        nal_span_list ();
+        void reset ();
+        bool append (const OMX_U8 *data, OMX_U32 len);
+        OMX_U32 copy_to (OMX_U8 *dest, OMX_U32 max_len) const;
+        bool references (const OMX_BUFFERHEADERTYPE *buffer) const;
+        bool hold (OMX_BUFFERHEADERTYPE *buffer);
+        OMX_BUFFERHEADERTYPE *release_held ();
+        bool is_full () const;
+        OMX_U32 size () const {
+            return total_len;
+        }
+        OMX_U32 held_count () const {
+            return held;
+        }
+
+    private:
+        nal_span spans[MAX_NAL_SPANS];
+        OMX_U32 count;
+        OMX_U32 total_len;
+        OMX_BUFFERHEADERTYPE *held_buffers[MAX_NAL_HELD_BUFFERS];
+        OMX_U32 held;
+        OMX_U32 held_first;
+};
+
 class frame_parse
 {
 
     public:
-        H264_Utils *mutils;
         int init_start_codes (codec_type codec_type_parse);
         int parse_sc_frame (OMX_BUFFERHEADERTYPE *source,
                 OMX_BUFFERHEADERTYPE *dest ,
@@ -74,6 +111,7 @@ class frame_parse
         int parse_h264_nallength (OMX_BUFFERHEADERTYPE *source,
                 OMX_BUFFERHEADERTYPE *dest ,
                 OMX_U32 *partialframe);
+        bool set_span_sink (nal_span_list *spans);
         void flush ();
         frame_parse ();
         ~frame_parse ();
@@ -87,6 +125,8 @@ class frame_parse
         unsigned char last_byte;
         bool header_found;
         bool skip_frame_boundary;
+        bool fast_scan;
+        nal_span_list *span_sink;
 
         /*Variables for NAL Length Parsing*/
         enum state_nal_parse state_nal;
@@ -97,6 +137,7 @@ class frame_parse
         void parse_additional_start_code(OMX_U8 *psource, OMX_U32 *parsed_length);
         void check_skip_frame_boundary(OMX_U32 *partial_frame);
         void update_skip_frame();
+        void copy_out(OMX_U8 *pdest, const OMX_U8 *psource, OMX_U32 len);
 };
 
 #endif /* FRAMEPARSER_H */
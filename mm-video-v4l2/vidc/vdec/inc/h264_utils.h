@@ -48,6 +48,8 @@ This module contains H264 video decoder utilities and helper routines.
 #include "qtypes.h"
 #include "OMX_Core.h"
 #include "OMX_QCOMExtns.h"
+#include "vidc_bit_reader.h"
+#include "param_set_cache.h"
 
 #define STD_MIN(x,y) (((x) < (y)) ? (x) : (y))
 
@@ -117,6 +119,12 @@ struct H264ParamNalu {
     uint32 log2MaxFrameNumMinus4;
     uint32 log2MaxPicOrderCntLsbMinus4;
     bool deltaPicOrderAlwaysZeroFlag;
+    bool separateColourPlaneFlag;
+    uint32 profileIdc;
+    uint32 levelIdc;
+    uint32 chromaFormatIdc;
+    uint32 bitDepthLumaMinus8;
+    uint32 bitDepthChromaMinus8;
     //std::vector<uint8> nalu;
     uint32 nalu;
     uint32 crop_left;
@@ -160,29 +168,57 @@ typedef struct {
 
 class extra_data_parser;
 
+#define H264_MAX_SPS_COUNT 32
+#define H264_MAX_PPS_COUNT 256
+
+// Slice header fields compared across VCL NAL units to find the first slice
+// of a primary coded picture (H.264 7.4.1.2.4)
+struct H264SliceInfo {
+    bool   idr_pic_flag;
+    uint32 first_mb_in_slice;
+    uint32 pic_parameter_set_id;
+    uint32 frame_num;
+    bool   field_pic_flag;
+    bool   bottom_field_flag;
+    uint32 idr_pic_id;
+    uint32 pic_order_cnt_type;
+    uint32 pic_order_cnt_lsb;
+    int32  delta_pic_order_cnt_bottom;
+    int32  delta_pic_order_cnt[2];
+    // false if only first_mb_in_slice could be read (unknown PPS/SPS or
+    // a truncated header)
+    bool   complete;
+};
+
 class RbspParser
 /******************************************************************************
  ** This class is used to convert an H.264 NALU (network abstraction layer
  ** unit) into RBSP (raw byte sequence payload) and extract bits from it.
+ ** Emulation prevention bytes are dropped as the bytes are consumed, so only
+ ** the part of the NAL that is actually read gets de-emulated. Reads past
+ ** the end of the NAL, or into the next start code, return zero bits and
+ ** set the overrun flag.
  *****************************************************************************/
 {
     public:
-        RbspParser (const uint8 *begin, const uint8 *end);
-
-        virtual ~RbspParser ();
-
-        uint32 next ();
-        void advance ();
-        uint32 u (uint32 n);
-        uint32 ue ();
-        int32 se ();
+        RbspParser (const uint8 *begin, const uint8 *end)
+            : bits(begin, end - begin) {}
+
+        uint32 u (uint32 n) {
+            return bits.read_bits(n);
+        }
+        uint32 ue () {
+            return bits.read_ue();
+        }
+        int32 se () {
+            return bits.read_se();
+        }
+        bool overrun () const {
+            return bits.overrun();
+        }
 
     private:
-        const     uint8 *begin, *end;
-        int32     pos;
-        uint32    bit;
-        uint32    cursor;
-        bool      advanceNeeded;
+        vidc_bit_reader<VIDC_BITS_NAL> bits;
 };
 
 class H264_Utils
@@ -191,25 +227,46 @@ class H264_Utils
         H264_Utils();
         ~H264_Utils();
         void initialize_frame_checking_environment();
-        void allocate_rbsp_buffer(uint32 inputBufferSize);
         bool isNewFrame(OMX_BUFFERHEADERTYPE *p_buf_hdr,
                 OMX_IN OMX_U32 size_of_nal_length_field,
                 OMX_OUT OMX_BOOL &isNewFrame);
+        bool isNewFrame(OMX_IN const NALU &nal_unit,
+                OMX_IN const OMX_U8 *payload,
+                OMX_IN OMX_U32 payload_len,
+                OMX_OUT OMX_BOOL &isNewFrame);
+        /* STREAM_CHANGE_* flags raised by the SPS activated since the last
+           call, with params set to the stream it describes */
+        OMX_U32 stream_change(stream_params &params);
         uint32 nalu_type;
 
     private:
-        boolean extract_rbsp(OMX_IN   OMX_U8  *buffer,
+        boolean locate_nal(OMX_IN   OMX_U8  *buffer,
                 OMX_IN   OMX_U32 buffer_length,
                 OMX_IN   OMX_U32 size_of_nal_length_field,
-                OMX_OUT  OMX_U8  *rbsp_bistream,
-                OMX_OUT  OMX_U32 *rbsp_length,
+                OMX_OUT  OMX_U32 *payload_offset,
+                OMX_OUT  OMX_U32 *payload_end,
                 OMX_OUT  NALU    *nal_unit);
+        void parse_sps(RbspParser &parser, const param_set_key &key);
+        void parse_pps(RbspParser &parser);
+        void activate_sps(uint32 id);
+        void parse_slice_header(RbspParser &parser, const NALU &nal_unit,
+                H264SliceInfo &slice);
+        bool is_first_slice_of_picture(const NALU &nal_unit,
+                const H264SliceInfo &slice);
 
         unsigned          m_height;
         unsigned          m_width;
-        H264ParamNaluSet  pic;
-        H264ParamNaluSet  seq;
-        uint8             *m_rbspBytes;
+        // Only the fields slice headers and stream_params depend on are kept
+        H264ParamNalu     m_sps[H264_MAX_SPS_COUNT];
+        H264ParamNalu     m_pps[H264_MAX_PPS_COUNT];
+        uint32            m_sps_valid;
+        bool              m_pps_valid[H264_MAX_PPS_COUNT];
+        param_set_cache   m_param_sets;
+        // SPS parsed with new content since they were last activated
+        uint32            m_sps_updated;
+        uint32            m_active_sps;
+        OMX_U32           m_stream_changes;
+        H264SliceInfo     m_prv_slice;
         NALU              m_prv_nalu;
         bool              m_forceToStichNextNAL;
         bool              m_au_data;
@@ -420,6 +477,8 @@ class h264_stream_parser
         void parse_nal(OMX_U8* data_ptr, OMX_U32 data_len,
                 OMX_U32 nal_type = NALU_TYPE_UNSPECIFIED,
                 bool enable_emu_sc = true);
+        void parse_nal_payload(OMX_U8* payload, OMX_U32 payload_len,
+                OMX_U32 nal_unit_type, bool sei_enabled);
         OMX_S64 process_ts_with_sei_vui(OMX_S64 timestamp);
         void get_frame_pack_data(OMX_QCOM_FRAME_PACK_ARRANGEMENT *frame_pack);
         bool is_mbaff();
@@ -433,7 +492,6 @@ class h264_stream_parser
         void init_bitstream(OMX_U8* data, OMX_U32 size);
         OMX_U32 extract_bits(OMX_U32 n);
         inline bool more_bits();
-        void read_word();
         OMX_U32 uev();
         OMX_S32 sev();
         OMX_S32 iv(OMX_U32 n_bits);
@@ -455,15 +513,13 @@ class h264_stream_parser
         OMX_S64 calculate_fixed_fps_ts(OMX_S64 timestamp, OMX_U32 DeltaTfiDivisor);
         void parse_frame_pack();
 
-        OMX_U32 curr_32_bit;
-        OMX_U32 bits_read;
         OMX_U32 profile;
-        OMX_U32 zero_cntr;
-        OMX_U32 emulation_code_skip_cntr;
         OMX_U8* bitstream;
         OMX_U32 bitstream_bytes;
         OMX_U32 frame_rate;
         bool    emulation_sc_enabled;
+        vidc_bit_reader<VIDC_BITS_RBSP> rbsp_bits;
+        vidc_bit_reader<VIDC_BITS_RAW> raw_bits;
 
         h264_vui_param vui_param;
         h264_sei_buf_period sei_buf_period;
@@ -475,6 +531,9 @@ class h264_stream_parser
 #endif
         OMX_QCOM_FRAME_PACK_ARRANGEMENT frame_packing_arrangement;
         bool     mbaff_flag;
+        // SPS the profile, mbaff_flag and vui_param come from
+        param_set_key last_sps;
+        bool     last_sps_valid;
 };
 
 #endif /* H264_UTILS_H */
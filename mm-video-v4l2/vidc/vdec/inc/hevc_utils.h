@@ -51,7 +51,11 @@ This module contains H264 video decoder utilities and helper routines.
 #include "qtypes.h"
 #include "OMX_Core.h"
 #include "OMX_QCOMExtns.h"
+#include "vidc_bit_reader.h"
+#include "param_set_cache.h"
 
+#define HEVC_MAX_SPS_COUNT 16
+#define HEVC_MAX_PPS_COUNT 64
 
 class HEVC_Utils
 {
@@ -135,12 +139,35 @@ class HEVC_Utils
         bool isNewFrame(OMX_BUFFERHEADERTYPE *p_buf_hdr,
                 OMX_IN OMX_U32 size_of_nal_length_field,
                 OMX_OUT OMX_BOOL &isNewFrame);
+        bool isNewFrame(OMX_IN OMX_U32 nal_unit_type,
+                OMX_IN const OMX_U8 *payload,
+                OMX_IN OMX_U32 payload_len,
+                OMX_OUT OMX_BOOL &isNewFrame);
+        /* STREAM_CHANGE_* flags raised by the SPS activated since the last
+           call, with params set to the stream it describes */
+        OMX_U32 stream_change(stream_params &params);
+        uint32 nalu_type;
 
     private:
+        typedef vidc_bit_reader<VIDC_BITS_NAL> bit_reader;
+
+        void parse_sps(const OMX_U8 *payload, OMX_U32 payload_len,
+                const param_set_key &key);
+        void parse_pps(const OMX_U8 *payload, OMX_U32 payload_len);
+        void parse_slice(const OMX_U8 *payload, OMX_U32 payload_len);
+        void activate_sps(uint32 id);
 
         bool              m_forceToStichNextNAL;
         bool              m_au_data;
-        uint32 nalu_type;
+        // Parameter sets only as far as stream_params need them
+        stream_params     m_sps[HEVC_MAX_SPS_COUNT];
+        uint32            m_sps_valid;
+        uint8             m_pps_sps_id[HEVC_MAX_PPS_COUNT];
+        param_set_cache   m_param_sets;
+        // SPS parsed with new content since they were last activated
+        uint32            m_sps_updated;
+        uint32            m_active_sps;
+        OMX_U32           m_stream_changes;
 };
 
 #endif /* HEVC_UTILS_H */
@@ -29,6 +29,7 @@ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define MP4_UTILS_H
 #include "OMX_Core.h"
 #include "OMX_QCOMExtns.h"
+#include "vidc_bit_reader.h"
 typedef signed long long int64;
 typedef unsigned int uint32;   /* Unsigned 32 bit value */
 typedef unsigned short uint16;   /* Unsigned 16 bit value */
@@ -148,12 +149,7 @@ typedef struct {
 class MP4_Utils
 {
     private:
-        struct posInfoType {
-            uint8 *bytePtr;
-            uint8 bitPos;
-        };
-
-        posInfoType m_posInfo;
+        vidc_bit_reader<VIDC_BITS_RAW> m_bits;
         byte *m_dataBeginPtr;
         unsigned int vop_time_resolution;
         bool vop_time_found;
@@ -163,7 +159,6 @@ class MP4_Utils
         ~MP4_Utils();
         int16 populateHeightNWidthFromShortHeader(mp4StreamType * psBits);
         bool parseHeader(mp4StreamType * psBits);
-        static uint32 read_bit_field(posInfoType * posPtr, uint32 size);
         bool is_notcodec_vop(unsigned char *pbuffer, unsigned int len);
 };
 #endif
@@ -95,9 +95,16 @@ extern "C" {
 #include "OMX_VideoExt.h"
 #include "OMX_IndexExt.h"
 #include "qc_omx_component.h"
+#include "vidc_ts_heap.h"
+#include "vidc_msg_notifier.h"
+#include "vidc_trace.h"
+#include "vidc_ion_pool.h"
 #include <linux/msm_vidc_dec.h>
 #include <media/msm_vidc.h>
 #include "frameparser.h"
+#include "au_assembler.h"
+#include "dynamic_buf_table.h"
+#include "extradata_writer.h"
 #ifdef MAX_RES_1080P
 #include "mp4_utils.h"
 #endif
@@ -241,6 +248,27 @@ struct extradata_buffer_info {
     struct vdec_ion ion;
 #endif
 };
+
+#define VDEC_EXTRADATA_INDEX_MAX 16
+
+/* Lazy extradata: where each driver entry of an output buffer sits in its
+ * extradata slot, plus the frame info inputs the entries do not carry */
+struct vdec_extradata_index {
+    bool ready;
+    OMX_U32 count;
+    struct {
+        OMX_U32 type;
+        OMX_U32 offset;
+    } entry[VDEC_EXTRADATA_INDEX_MAX];
+    OMX_U32 num_conceal_mb;
+    OMX_U32 frame_rate;
+    OMX_TICKS time_stamp;
+    enum vdec_interlaced_format interlace;
+    OMX_U32 disp_hor_size;
+    OMX_U32 disp_vert_size;
+    /* The crop when the buffer was done, a later reconfig may change it */
+    OMX_QCOM_EXTRADATA_FRAMEDIMENSION frame_dimension;
+};
 #endif
 
 struct video_driver_context {
@@ -296,15 +324,8 @@ struct debug_cap {
     FILE *outfile;
 };
 
-struct dynamic_buf_list {
-    OMX_U32 fd;
-    OMX_U32 dup_fd;
-    OMX_U32 offset;
-    OMX_U32 ref_count;
-};
-
 // OMX video decoder class
-class omx_vdec: public qc_omx_component
+class omx_vdec: public qc_omx_component, public au_assembler_client
 {
 
     public:
@@ -435,13 +456,15 @@ class omx_vdec: public qc_omx_component
         int update_resolution(int width, int height, int stride, int scan_lines);
         OMX_ERRORTYPE is_video_session_supported();
 #endif
-        int  m_pipe_in;
-        int  m_pipe_out;
+        vidc_msg_notifier m_msg_notifier;
+        vidc_trace m_trace;
         pthread_t msg_thread_id;
         pthread_t async_thread_id;
         bool is_component_secure();
         void buf_ref_add(OMX_U32 fd, OMX_U32 offset);
         void buf_ref_remove(OMX_U32 fd, OMX_U32 offset);
+        /* Output buffers and total references the firmware still holds */
+        void buf_ref_query(OMX_U32 *buffers, OMX_U32 *refs);
 
     private:
         // Bit Positions
@@ -543,24 +566,6 @@ class omx_vdec: public qc_omx_component
 
         };
 
-#ifdef _ANDROID_
-        struct ts_entry {
-            OMX_TICKS timestamp;
-            bool valid;
-        };
-
-        struct ts_arr_list {
-            ts_entry m_ts_arr_list[MAX_NUM_INPUT_OUTPUT_BUFFERS];
-
-            ts_arr_list();
-            ~ts_arr_list();
-
-            bool insert_ts(OMX_TICKS ts);
-            bool pop_min_ts(OMX_TICKS &ts);
-            bool reset_ts_list();
-        };
-#endif
-
         struct desc_buffer_hdr {
             OMX_U8 *buf_addr;
             OMX_U32 desc_data_size;
@@ -624,11 +629,19 @@ class omx_vdec: public qc_omx_component
                 );
 
         OMX_ERRORTYPE push_input_buffer (OMX_HANDLETYPE hComp);
-        OMX_ERRORTYPE push_input_sc_codec (OMX_HANDLETYPE hComp);
-        OMX_ERRORTYPE push_input_h264 (OMX_HANDLETYPE hComp);
-        OMX_ERRORTYPE push_input_hevc (OMX_HANDLETYPE hComp);
         OMX_ERRORTYPE push_input_vc1 (OMX_HANDLETYPE hComp);
 
+        /* au_assembler_client */
+        OMX_ERRORTYPE au_ready(OMX_BUFFERHEADERTYPE *dest);
+        OMX_BUFFERHEADERTYPE *get_free_dest();
+        void return_dest(OMX_BUFFERHEADERTYPE *dest);
+        OMX_BUFFERHEADERTYPE *get_next_source();
+        void source_done(OMX_BUFFERHEADERTYPE *source);
+        void nal_parsed(const au_nal_unit &nal);
+        void au_started(OMX_S64 timestamp);
+        OMX_S64 au_timestamp(OMX_S64 timestamp);
+        void stream_changed(OMX_U32 changes, const stream_params &params);
+
         OMX_ERRORTYPE fill_this_buffer_proxy(OMX_HANDLETYPE       hComp,
                 OMX_BUFFERHEADERTYPE *buffer);
         bool release_done();
@@ -646,17 +659,30 @@ class omx_vdec: public qc_omx_component
         void handle_extradata(OMX_BUFFERHEADERTYPE *p_buf_hdr);
         void print_debug_extradata(OMX_OTHER_EXTRADATATYPE *extra);
 #ifdef _MSM8974_
-        void append_interlace_extradata(OMX_OTHER_EXTRADATATYPE *extra,
+        void update_extradata_templates();
+        void append_interlace_extradata(OMX_U32 interlaced_format_type, bool is_mbaff);
+        static enum vdec_interlaced_format fill_interlace_format(
+                OMX_STREAMINTERLACEFORMAT *interlace_format,
                 OMX_U32 interlaced_format_type, bool is_mbaff);
         OMX_ERRORTYPE enable_extradata(OMX_U32 requested_extradata, bool is_internal,
                 bool enable = true);
-        void append_frame_info_extradata(OMX_OTHER_EXTRADATATYPE *extra,
+        void append_frame_info_extradata(
                 OMX_U32 num_conceal_mb,
                 OMX_U32 picture_type,
                 OMX_U32 frame_rate,
                 OMX_TICKS time_stamp,
                 struct msm_vidc_panscan_window_payload *panscan_payload,
                 struct vdec_aspectratioinfo *aspect_ratio_info);
+        void fill_frame_info_extradata(OMX_QCOM_EXTRADATA_FRAMEINFO *frame_info,
+                OMX_U32 num_conceal_mb,
+                OMX_U32 picture_type,
+                OMX_U32 frame_rate,
+                OMX_TICKS time_stamp,
+                struct msm_vidc_panscan_window_payload *panscan_payload,
+                struct vdec_aspectratioinfo *aspect_ratio_info,
+                enum vdec_interlaced_format interlace,
+                OMX_U32 disp_hor_size, OMX_U32 disp_vert_size);
+        OMX_ERRORTYPE get_lazy_extradata(QOMX_VIDEO_EXTRADATA_QUERY *query);
 #else
         void append_interlace_extradata(OMX_OTHER_EXTRADATATYPE *extra,
                 OMX_U32 interlaced_format_type, OMX_U32 buf_index);
@@ -668,22 +694,22 @@ class omx_vdec: public qc_omx_component
                 OMX_S64 timestamp,
                 OMX_U32 frame_rate,
                 struct vdec_aspectratioinfo *aspect_ratio_info);
-        void fill_aspect_ratio_info(struct vdec_aspectratioinfo *aspect_ratio_info,
+        static void fill_aspect_ratio_info(struct vdec_aspectratioinfo *aspect_ratio_info,
                 OMX_QCOM_EXTRADATA_FRAMEINFO *frame_info);
-        void append_terminator_extradata(OMX_OTHER_EXTRADATATYPE *extra);
+        void append_terminator_extradata();
         OMX_ERRORTYPE update_portdef(OMX_PARAM_PORTDEFINITIONTYPE *portDefn);
         void append_portdef_extradata(OMX_OTHER_EXTRADATATYPE *extra);
-        void append_frame_dimension_extradata(OMX_OTHER_EXTRADATATYPE *extra);
+        void append_frame_dimension_extradata();
         void append_extn_extradata(OMX_OTHER_EXTRADATATYPE *extra, OMX_OTHER_EXTRADATATYPE *p_extn);
-        void append_user_extradata(OMX_OTHER_EXTRADATATYPE *extra, OMX_OTHER_EXTRADATATYPE *p_user);
+        void append_user_extradata(OMX_OTHER_EXTRADATATYPE *p_user);
         void append_concealmb_extradata(OMX_OTHER_EXTRADATATYPE *extra,
                 OMX_OTHER_EXTRADATATYPE *p_concealmb, OMX_U8 *conceal_mb_data);
-        void append_framepack_extradata(OMX_OTHER_EXTRADATATYPE *extra,
+        void append_framepack_extradata(
+                struct msm_vidc_s3d_frame_packing_payload *s3d_frame_packing_payload);
+        static void fill_framepack_extradata(OMX_QCOM_FRAME_PACK_ARRANGEMENT *framepack,
                 struct msm_vidc_s3d_frame_packing_payload *s3d_frame_packing_payload);
-        void append_qp_extradata(OMX_OTHER_EXTRADATATYPE *extra,
-                struct msm_vidc_frame_qp_payload *qp_payload);
-        void append_bitsinfo_extradata(OMX_OTHER_EXTRADATATYPE *extra,
-                struct msm_vidc_frame_bits_info_payload *bits_payload);
+        void append_qp_extradata(struct msm_vidc_frame_qp_payload *qp_payload);
+        void append_bitsinfo_extradata(struct msm_vidc_frame_bits_info_payload *bits_payload);
         void insert_demux_addr_offset(OMX_U32 address_offset);
         void extract_demux_addr_offsets(OMX_BUFFERHEADERTYPE *buf_hdr);
         OMX_ERRORTYPE handle_demux_data(OMX_BUFFERHEADERTYPE *buf_hdr);
@@ -800,7 +826,7 @@ class omx_vdec: public qc_omx_component
         unsigned int m_inp_err_count;
 #ifdef _ANDROID_
         // Timestamp list
-        ts_arr_list           m_timestamp_list;
+        vidc_ts_heap          m_timestamp_list;
 #endif
 
         bool input_flush_progress;
@@ -847,15 +873,12 @@ class omx_vdec: public qc_omx_component
         OMX_VENDOR_EXTRADATATYPE            m_vendor_config;
 
         /*Variables for arbitrary Byte parsing support*/
-        frame_parse m_frame_parser;
+        AccessUnitAssembler m_au_assembler;
         h264_stream_parser *h264_parser;
-        MP4_Utils mp4_headerparser;
-        HEVC_Utils m_hevc_utils;
 
         omx_cmd_queue m_input_pending_q;
         omx_cmd_queue m_input_free_q;
         bool arbitrary_bytes;
-        OMX_BUFFERHEADERTYPE  h264_scratch;
         OMX_BUFFERHEADERTYPE  *psource_frame;
         OMX_BUFFERHEADERTYPE  *pdest_frame;
         OMX_BUFFERHEADERTYPE  *m_inp_heap_ptr;
@@ -863,18 +886,16 @@ class omx_vdec: public qc_omx_component
         unsigned int m_heap_inp_bm_count;
         codec_type codec_type_parse;
         bool first_frame_meta;
-        unsigned frame_count;
-        unsigned nal_count;
         unsigned nal_length;
-        bool look_ahead_nal;
+        /* Zero-copy AU assembly: NAL bytes stay in the client buffers until
+           the AU they belong to is known */
+        bool m_h264_zero_copy;
         int first_frame;
         unsigned char *first_buffer;
         int first_frame_size;
         unsigned char m_hwdevice_name[80];
         FILE *m_device_file_ptr;
         enum vc1_profile_type m_vc1_profile;
-        OMX_S64 h264_last_au_ts;
-        OMX_U32 h264_last_au_flags;
         OMX_U32 m_demux_offsets[8192];
         OMX_U32 m_demux_entries;
         OMX_U32 m_disp_hor_size;
@@ -888,6 +909,7 @@ class omx_vdec: public qc_omx_component
         bool in_reconfig;
         OMX_NATIVE_WINDOWTYPE m_display_id;
         OMX_U32 client_extradata;
+        extradata_writer m_extradata_writer;
 #ifdef _ANDROID_
         bool m_debug_timestamp;
         bool perf_flag;
@@ -933,8 +955,10 @@ class omx_vdec: public qc_omx_component
         bool secure_mode;
         bool external_meta_buffer;
         bool external_meta_buffer_iommu;
-        OMX_QCOM_EXTRADATA_FRAMEINFO *m_extradata;
         OMX_OTHER_EXTRADATATYPE *m_other_extradata;
+        bool m_lazy_extradata;
+        struct vdec_extradata_index *m_extradata_index;
+        int m_extradata_index_count;
         bool codec_config_flag;
 #ifdef _MSM8974_
         int capture_capability;
@@ -960,7 +984,7 @@ class omx_vdec: public qc_omx_component
 
         //variables to handle dynamic buffer mode
         bool dynamic_buf_mode;
-        struct dynamic_buf_list *out_dynamic_list;
+        dynamic_buf_table out_dynamic_table;
         bool m_smoothstreaming_mode;
         OMX_U32 m_smoothstreaming_width;
         OMX_U32 m_smoothstreaming_height;
@@ -985,6 +1009,7 @@ class omx_vdec: public qc_omx_component
                 OMX_BUFFERHEADERTYPE* get_dr_buf_hdr(OMX_BUFFERHEADERTYPE *input_hdr);
                 OMX_BUFFERHEADERTYPE* convert(OMX_BUFFERHEADERTYPE *header);
                 OMX_BUFFERHEADERTYPE* queue_buffer(OMX_BUFFERHEADERTYPE *header);
+                void submit_conversion(OMX_BUFFERHEADERTYPE *bufadd);
                 OMX_ERRORTYPE allocate_buffers_color_convert(OMX_HANDLETYPE hComp,
                         OMX_BUFFERHEADERTYPE **bufferHdr,OMX_U32 port,OMX_PTR appData,
                         OMX_U32 bytes);
@@ -1011,6 +1036,9 @@ class omx_vdec: public qc_omx_component
 #endif
                 unsigned char *pmem_baseaddress[MAX_COUNT];
                 unsigned long pmem_fd[MAX_COUNT];
+                // Conversion queued by submit_conversion, 0 if none
+                C2DFence m_convert_fence[MAX_COUNT];
+                bool submit_locked(unsigned int index, OMX_BUFFERHEADERTYPE *bufadd);
                 struct vidc_heap {
                     sp<MemoryHeapBase>    video_heap_ptr;
                 };
@@ -100,9 +100,12 @@ extern "C"{
 #include "OMX_QCOMExtns.h"
 #include "OMX_Video.h"
 #include "qc_omx_component.h"
+#include "vidc_ts_heap.h"
+#include "vidc_msg_notifier.h"
 #include <linux/msm_vidc_dec.h>
 #include <media/msm_vidc.h>
 #include "frameparser.h"
+#include "au_assembler.h"
 #ifdef MAX_RES_1080P
 #include "mp4_utils.h"
 #endif
@@ -315,7 +318,7 @@ struct dynamic_buf_list {
 };
 
 // OMX video decoder class
-class omx_vdec: public qc_omx_component
+class omx_vdec: public qc_omx_component, public au_assembler_client
 {
 
 public:
@@ -446,8 +449,7 @@ public:
     int update_resolution(int width, int height, int stride, int scan_lines);
     OMX_ERRORTYPE is_video_session_supported();
 #endif
-    int  m_pipe_in;
-    int  m_pipe_out;
+    vidc_msg_notifier m_msg_notifier;
     pthread_t msg_thread_id;
     pthread_t async_thread_id;
     bool is_component_secure();
@@ -574,26 +576,6 @@ private:
 
     };
 
-#ifdef _ANDROID_
-    struct ts_entry
-    {
-        OMX_TICKS timestamp;
-        bool valid;
-    };
-
-    struct ts_arr_list
-    {
-        ts_entry m_ts_arr_list[MAX_NUM_INPUT_OUTPUT_BUFFERS];
-
-        ts_arr_list();
-        ~ts_arr_list();
-
-        bool insert_ts(OMX_TICKS ts);
-        bool pop_min_ts(OMX_TICKS &ts);
-        bool reset_ts_list();
-    };
-#endif
-
     struct desc_buffer_hdr
     {
         OMX_U8 *buf_addr;
@@ -661,7 +643,13 @@ private:
                                                    );
 
     OMX_ERRORTYPE push_input_buffer (OMX_HANDLETYPE hComp);
-    OMX_ERRORTYPE push_input_hevc (OMX_HANDLETYPE hComp);
+
+    /* au_assembler_client */
+    OMX_ERRORTYPE au_ready(OMX_BUFFERHEADERTYPE *dest);
+    OMX_BUFFERHEADERTYPE *get_free_dest();
+    void return_dest(OMX_BUFFERHEADERTYPE *dest);
+    OMX_BUFFERHEADERTYPE *get_next_source();
+    void source_done(OMX_BUFFERHEADERTYPE *source);
 
     OMX_ERRORTYPE fill_this_buffer_proxy(OMX_HANDLETYPE       hComp,
                                        OMX_BUFFERHEADERTYPE *buffer);
@@ -852,7 +840,7 @@ private:
     unsigned int m_inp_err_count;
 #ifdef _ANDROID_
     // Timestamp list
-    ts_arr_list           m_timestamp_list;
+    vidc_ts_heap          m_timestamp_list;
 #endif
 
     bool input_flush_progress;
@@ -919,11 +907,10 @@ private:
     OMX_VENDOR_EXTRADATATYPE            m_vendor_config;
 
     /*Variables for arbitrary Byte parsing support*/
-    frame_parse m_frame_parser;
+    AccessUnitAssembler m_au_assembler;
     omx_cmd_queue m_input_pending_q;
     omx_cmd_queue m_input_free_q;
     bool arbitrary_bytes;
-    OMX_BUFFERHEADERTYPE  h264_scratch;
     OMX_BUFFERHEADERTYPE  *psource_frame;
     OMX_BUFFERHEADERTYPE  *pdest_frame;
     OMX_BUFFERHEADERTYPE  *m_inp_heap_ptr;
@@ -931,18 +918,13 @@ private:
     unsigned int m_heap_inp_bm_count;
     codec_type codec_type_parse;
     bool first_frame_meta;
-    unsigned frame_count;
-    unsigned nal_count;
     unsigned nal_length;
-    bool look_ahead_nal;
     int first_frame;
     unsigned char *first_buffer;
     int first_frame_size;
     unsigned char m_hwdevice_name[80];
     FILE *m_device_file_ptr;
     enum vc1_profile_type m_vc1_profile;
-    OMX_S64 h264_last_au_ts;
-    OMX_U32 h264_last_au_flags;
     OMX_U32 m_demux_offsets[8192];
     OMX_U32 m_demux_entries;
     OMX_U32 m_disp_hor_size;
@@ -1074,7 +1056,6 @@ private:
 #if  defined (_MSM8960_) || defined (_MSM8974_)
     allocate_color_convert_buf client_buffers;
 #endif
-    HEVC_Utils mHEVCutils;
     struct video_decoder_capability m_decoder_capability;
     struct debug_cap m_debug;
     int log_input_buffers(const char *, int);
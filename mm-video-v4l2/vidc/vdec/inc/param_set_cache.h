@@ -0,0 +1,113 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2015, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of The Linux Foundation nor
+      the names of its contributors may be used to endorse or promote
+      products derived from this software without specific prior written
+      permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+#ifndef PARAM_SET_CACHE_H
+#define PARAM_SET_CACHE_H
+
+#include "OMX_Types.h"
+
+/* What the decoder has to be configured for, from the active SPS */
+struct stream_params {
+    OMX_U32 profile;            // profile_idc, general_profile_idc for HEVC
+    OMX_U32 level;              // level_idc, general_level_idc for HEVC
+    OMX_U32 width;              // coded luma size
+    OMX_U32 height;
+    OMX_U32 crop_left;          // display window inside the coded size
+    OMX_U32 crop_top;
+    OMX_U32 crop_width;
+    OMX_U32 crop_height;
+    OMX_U32 chroma_format;      // chroma_format_idc
+    OMX_U32 bit_depth_luma;
+    OMX_U32 bit_depth_chroma;
+    bool    interlaced;         // field or MBAFF coding possible
+};
+
+/* What differs between two stream_params, see param_set_cache::update_stream */
+enum {
+    STREAM_CHANGE_RESOLUTION = 0x1,
+    STREAM_CHANGE_CROP       = 0x2,
+    STREAM_CHANGE_PROFILE    = 0x4,     // profile or level
+    STREAM_CHANGE_FORMAT     = 0x8,     // chroma format, bit depth, interlacing
+};
+
+/* sps_id range of H.264, HEVC only uses the first 16 */
+#define PARAM_SET_MAX_SPS 32
+
+/* Identifies the raw bytes of a parameter set NAL payload */
+struct param_set_key {
+    OMX_U64 hash;
+    OMX_U32 len;
+};
+
+/*
+ * Remembers a hash of the raw payload of every stored SPS, by id, so that
+ * the repeats sent with every IDR in broadcast and HLS streams are
+ * recognized without parsing them again. The parsed fields themselves stay
+ * with the codec parser that owns the cache. PPS and VPS are not kept:
+ * only their leading ids are read, which costs less than hashing them.
+ *
+ * It also holds the stream parameters last announced to the decoder, so
+ * that a newly activated SPS only raises a change when it really differs.
+ */
+class param_set_cache
+{
+    public:
+        param_set_cache();
+        /* Forgets every SPS and the announced stream */
+        void reset();
+        /* Fills key from the SPS payload and returns true if an SPS with
+           identical bytes is already stored */
+        bool is_repeat(const OMX_U8 *payload, OMX_U32 len, param_set_key &key);
+        /* Records the SPS just parsed under its id */
+        void store(OMX_U32 id, const param_set_key &key);
+        /* Drops an SPS that failed to parse */
+        void remove(OMX_U32 id);
+        /* Returns the STREAM_CHANGE_* flags of params against the stream
+           announced last, and makes params the announced one. The first
+           stream after a reset is reported as a change of everything. */
+        OMX_U32 update_stream(const stream_params &params);
+        const stream_params &stream() const {
+            return announced;
+        }
+
+        /* Key of a parameter set NAL payload, without trailing zero bytes */
+        static void make_key(const OMX_U8 *payload, OMX_U32 len, param_set_key &key);
+        static OMX_U64 hash(const OMX_U8 *data, OMX_U32 len);
+
+    private:
+        struct entry {
+            OMX_U32 id;
+            param_set_key key;
+        };
+        /* Packed, streams carry one or a few SPS */
+        entry sps[PARAM_SET_MAX_SPS];
+        OMX_U32 count;
+        stream_params announced;
+        bool announced_valid;
+};
+
+#endif /* PARAM_SET_CACHE_H */
@@ -31,6 +31,7 @@ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "OMX_Core.h"
 #include "OMX_QCOMExtns.h"
 #include "qc_omx_component.h"
+#include "vidc_ts_heap.h"
 
 #include<stdlib.h>
 
@@ -73,23 +74,8 @@ class omx_time_stamp_reorder
         void flush_timestamp();
 
     private:
-#define TIME_SZ 64
-        typedef struct timestamp {
-            OMX_TICKS timestamps;
-            bool in_use;
-        } timestamp;
-        typedef struct time_stamp_list {
-            timestamp input_timestamps[TIME_SZ];
-            time_stamp_list *next;
-            time_stamp_list *prev;
-            unsigned int entries_filled;
-        } time_stamp_list;
+        vidc_ts_heap ts_heap;
         bool error;
-        time_stamp_list *phead,*pcurrent;
-        bool get_current_list();
-        bool add_new_list();
-        bool update_head();
-        void delete_list();
         void handle_error() {
             ALOGE("Error handler called for TS Parser");
 
@@ -97,7 +83,7 @@ class omx_time_stamp_reorder
                 return;
 
             error = true;
-            delete_list();
+            ts_heap.reset();
         }
         bool reorder_ts;
         bool print_debug;
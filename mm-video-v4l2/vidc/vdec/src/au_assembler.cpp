@@ -0,0 +1,808 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2015, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of The Linux Foundation nor
+      the names of its contributors may be used to endorse or promote
+      products derived from this software without specific prior written
+      permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include "au_assembler.h"
+#include "vidc_debug.h"
+
+#ifdef _ANDROID_
+extern "C" {
+#include<utils/Log.h>
+}
+#endif//_ANDROID_
+
+/* Bytes of a slice NAL needed to classify it as an AU boundary */
+#define H264_NAL_HEAD_BYTES 64
+
+bool h264_au_detector::allocate(OMX_U32 max_nal_size)
+{
+    (void)max_nal_size;
+    utils.initialize_frame_checking_environment();
+    return true;
+}
+
+void h264_au_detector::reset()
+{
+    utils.initialize_frame_checking_environment();
+}
+
+bool h264_au_detector::is_new_frame(const au_nal_unit &nal, OMX_BOOL &new_frame)
+{
+    NALU nal_unit;
+
+    nal_unit.forbidden_zero_bit = nal.header[0] & 0x80;
+    nal_unit.nal_ref_idc = (nal.header[0] & 0x60) >> 5;
+    nal_unit.nalu_type = nal.type;
+    return utils.isNewFrame(nal_unit, nal.payload, nal.payload_len, new_frame);
+}
+
+void hevc_au_detector::reset()
+{
+    utils.initialize_frame_checking_environment();
+}
+
+bool hevc_au_detector::is_new_frame(const au_nal_unit &nal, OMX_BOOL &new_frame)
+{
+    return utils.isNewFrame(nal.type, nal.payload, nal.payload_len, new_frame);
+}
+
+static OMX_ERRORTYPE copy_buffer(OMX_BUFFERHEADERTYPE* pDst, OMX_BUFFERHEADERTYPE* pSrc)
+{
+    OMX_ERRORTYPE rc = OMX_ErrorNone;
+    if ((pDst->nAllocLen - pDst->nFilledLen) >= pSrc->nFilledLen) {
+        memcpy((pDst->pBuffer + pDst->nFilledLen), pSrc->pBuffer, pSrc->nFilledLen);
+        if (pDst->nTimeStamp == LLONG_MAX) {
+            pDst->nTimeStamp = pSrc->nTimeStamp;
+            DEBUG_PRINT_LOW("Assign Dst nTimeStamp = %lld", pDst->nTimeStamp);
+        }
+        pDst->nFilledLen += pSrc->nFilledLen;
+        pSrc->nFilledLen = 0;
+    } else {
+        DEBUG_PRINT_ERROR_RATELIMITED("Error: Destination buffer overflow");
+        rc = OMX_ErrorBadParameter;
+    }
+    return rc;
+}
+
+AccessUnitAssembler::AccessUnitAssembler():
+    codec(CODEC_TYPE_MAX),
+    client(NULL),
+    detector(NULL),
+    zero_copy(false),
+    source_count(0),
+    nal_length(0),
+    look_ahead_nal(false),
+    nal_count(0),
+    frame_count(0),
+    last_au_ts(LLONG_MAX),
+    last_au_flags(0)
+{
+    memset(&scratch, 0, sizeof(scratch));
+}
+
+AccessUnitAssembler::~AccessUnitAssembler()
+{
+    deallocate();
+}
+
+int AccessUnitAssembler::init(codec_type codec_type_parse, au_assembler_client *cb)
+{
+    if (!cb || parser.init_start_codes(codec_type_parse) == -1) {
+        return -1;
+    }
+
+    codec = codec_type_parse;
+    client = cb;
+
+    delete detector;
+    detector = NULL;
+    if (codec == CODEC_TYPE_H264) {
+        detector = new h264_au_detector();
+        if (zero_copy) {
+            parser.set_span_sink(&spans);
+        }
+    } else if (codec == CODEC_TYPE_HEVC) {
+        detector = new hevc_au_detector();
+    }
+
+    if (nal_length) {
+        parser.init_nal_length(nal_length);
+    }
+    return 1;
+}
+
+/* The scratch NAL and the detector RBSP buffer are only needed for NAL
+ * based codecs, start code codecs parse straight into the destination. */
+bool AccessUnitAssembler::allocate(OMX_U32 max_au_size)
+{
+    if (!detector || scratch.pBuffer) {
+        return true;
+    }
+
+    scratch.pBuffer = (OMX_U8 *)malloc(max_au_size);
+    if (scratch.pBuffer == NULL) {
+        DEBUG_PRINT_ERROR("AU assembler scratch buffer allocation failed");
+        return false;
+    }
+    scratch.nAllocLen = max_au_size;
+    scratch.nFilledLen = 0;
+    scratch.nOffset = 0;
+
+    return detector->allocate(max_au_size);
+}
+
+/* Buffers still held for a pending NAL are returned by reset(), which the
+ * client is expected to call (flush) before tearing the assembler down. */
+void AccessUnitAssembler::deallocate()
+{
+    spans.reset();
+    if (scratch.pBuffer) {
+        free(scratch.pBuffer);
+        scratch.pBuffer = NULL;
+    }
+    scratch.nAllocLen = 0;
+    scratch.nFilledLen = 0;
+
+    delete detector;
+    detector = NULL;
+}
+
+int AccessUnitAssembler::set_nal_length(unsigned int length)
+{
+    if (length && parser.init_nal_length(length) == -1) {
+        return -1;
+    }
+    nal_length = length;
+    return 1;
+}
+
+void AccessUnitAssembler::release_sources()
+{
+    flatten_nal();
+}
+
+void AccessUnitAssembler::reset()
+{
+    reset_spans();
+    scratch.nFilledLen = 0;
+    nal_count = 0;
+    look_ahead_nal = false;
+    frame_count = 0;
+    last_au_ts = LLONG_MAX;
+    last_au_flags = 0;
+    if (detector) {
+        detector->reset();
+    }
+    parser.flush();
+}
+
+OMX_ERRORTYPE AccessUnitAssembler::push(OMX_BUFFERHEADERTYPE *&source,
+        OMX_BUFFERHEADERTYPE *&dest)
+{
+    if (!client || !source || !dest) {
+        return OMX_ErrorBadParameter;
+    }
+
+    switch (codec) {
+        case CODEC_TYPE_MPEG4:
+        case CODEC_TYPE_H263:
+        case CODEC_TYPE_MPEG2:
+        case CODEC_TYPE_VC1:
+            return push_sc(source, dest);
+        case CODEC_TYPE_H264:
+            return push_h264(source, dest);
+        case CODEC_TYPE_HEVC:
+            return push_hevc(source, dest);
+        default:
+            DEBUG_PRINT_ERROR("AU assembler: unsupported codec %d", codec);
+            return OMX_ErrorUnsupportedSetting;
+    }
+}
+
+OMX_BUFFERHEADERTYPE *AccessUnitAssembler::next_source()
+{
+    OMX_BUFFERHEADERTYPE *source = client->get_next_source();
+
+    if (source) {
+        DEBUG_PRINT_LOW("Next source Buffer %p flag %u length %u time stamp %lld",
+                source, (unsigned int)source->nFlags,
+                (unsigned int)source->nFilledLen, source->nTimeStamp);
+    }
+    return source;
+}
+
+OMX_BUFFERHEADERTYPE *AccessUnitAssembler::next_dest()
+{
+    OMX_BUFFERHEADERTYPE *dest = client->get_free_dest();
+
+    if (dest) {
+        DEBUG_PRINT_LOW("Pop the next pdest_buffer %p", dest);
+        dest->nFilledLen = 0;
+        dest->nFlags = 0;
+        dest->nTimeStamp = LLONG_MAX;
+    }
+    return dest;
+}
+
+int AccessUnitAssembler::parse_nal(OMX_BUFFERHEADERTYPE *source, OMX_U32 *partial_frame)
+{
+    if (nal_length == 0) {
+        DEBUG_PRINT_LOW("Zero NAL, hence parse using start code");
+        if (parser.parse_sc_frame(source, &scratch, partial_frame) == -1) {
+            DEBUG_PRINT_ERROR("Error In Parsing Return Error");
+            return -1;
+        }
+    } else {
+        DEBUG_PRINT_LOW("Non-zero NAL length clip, hence parse with NAL size %d", nal_length);
+        if (parser.parse_h264_nallength(source, &scratch, partial_frame) == -1) {
+            DEBUG_PRINT_ERROR("Error In Parsing NAL size, Return Error");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+OMX_ERRORTYPE AccessUnitAssembler::push_sc(OMX_BUFFERHEADERTYPE *&psource_frame,
+        OMX_BUFFERHEADERTYPE *&pdest_frame)
+{
+    OMX_U32 partial_frame = 1;
+    OMX_BOOL generate_ebd = OMX_TRUE;
+
+    DEBUG_PRINT_LOW("Start Parsing the bit stream address %p TimeStamp %lld",
+            psource_frame,psource_frame->nTimeStamp);
+    if (parser.parse_sc_frame(psource_frame,
+                pdest_frame,&partial_frame) == -1) {
+        DEBUG_PRINT_ERROR("Error In Parsing Return Error");
+        return OMX_ErrorBadParameter;
+    }
+
+    if (partial_frame == 0) {
+        DEBUG_PRINT_LOW("Frame size %u source %p frame count %d",
+                (unsigned int)pdest_frame->nFilledLen,psource_frame,frame_count);
+
+        DEBUG_PRINT_LOW("TimeStamp updated %lld", pdest_frame->nTimeStamp);
+        /*First Parsed buffer will have only header Hence skip*/
+        if (frame_count == 0) {
+            DEBUG_PRINT_LOW("H263/MPEG4 Codec First Frame ");
+
+            if (codec == CODEC_TYPE_MPEG4) {
+                mp4StreamType psBits;
+                psBits.data = pdest_frame->pBuffer + pdest_frame->nOffset;
+                psBits.numBytes = pdest_frame->nFilledLen;
+                mp4_headerparser.parseHeader(&psBits);
+            }
+
+            frame_count++;
+        } else {
+            pdest_frame->nFlags &= ~OMX_BUFFERFLAG_EOS;
+            if (pdest_frame->nFilledLen) {
+                /*Push the frame to the Decoder*/
+                if (client->au_ready(pdest_frame) != OMX_ErrorNone) {
+                    return OMX_ErrorBadParameter;
+                }
+                frame_count++;
+                pdest_frame = client->get_free_dest();
+                if (pdest_frame) {
+                    pdest_frame->nFilledLen = 0;
+                }
+            } else if (!(psource_frame->nFlags & OMX_BUFFERFLAG_EOS)) {
+                DEBUG_PRINT_ERROR("Zero len buffer return back to POOL");
+                client->return_dest(pdest_frame);
+                pdest_frame = NULL;
+            }
+        }
+    } else {
+        DEBUG_PRINT_LOW("Not a Complete Frame %u", (unsigned int)pdest_frame->nFilledLen);
+        /*Check if Destination Buffer is full*/
+        if (pdest_frame->nAllocLen ==
+                pdest_frame->nFilledLen + pdest_frame->nOffset) {
+            DEBUG_PRINT_ERROR("ERROR:Frame Not found though Destination Filled");
+            return OMX_ErrorStreamCorrupt;
+        }
+    }
+
+    if (psource_frame->nFilledLen == 0) {
+        if (psource_frame->nFlags & OMX_BUFFERFLAG_EOS) {
+            if (pdest_frame) {
+                pdest_frame->nFlags |= psource_frame->nFlags;
+                DEBUG_PRINT_LOW("Frame Found start Decoding Size =%u TimeStamp = %lld",
+                        (unsigned int)pdest_frame->nFilledLen,pdest_frame->nTimeStamp);
+                DEBUG_PRINT_LOW("Found a frame size = %u number = %d",
+                        (unsigned int)pdest_frame->nFilledLen,frame_count++);
+                /*Push the frame to the Decoder*/
+                if (client->au_ready(pdest_frame) != OMX_ErrorNone) {
+                    return OMX_ErrorBadParameter;
+                }
+                frame_count++;
+                pdest_frame = NULL;
+            } else {
+                DEBUG_PRINT_LOW("Last frame in else dest addr") ;
+                generate_ebd = OMX_FALSE;
+            }
+        }
+        if (generate_ebd) {
+            DEBUG_PRINT_LOW("Buffer Consumed return back to client %p",psource_frame);
+            client->source_done(psource_frame);
+            psource_frame = next_source();
+        }
+    }
+    return OMX_ErrorNone;
+}
+
+OMX_ERRORTYPE AccessUnitAssembler::push_h264(OMX_BUFFERHEADERTYPE *&psource_frame,
+        OMX_BUFFERHEADERTYPE *&pdest_frame)
+{
+    OMX_U32 partial_frame = 1;
+    OMX_BOOL isNewFrame = OMX_FALSE;
+    OMX_BOOL generate_ebd = OMX_TRUE;
+    OMX_BUFFERHEADERTYPE nal_head;
+    au_nal_unit nal;
+
+    if (scratch.pBuffer == NULL) {
+        DEBUG_PRINT_ERROR("ERROR:H.264 Scratch Buffer not allocated");
+        return OMX_ErrorBadParameter;
+    }
+    DEBUG_PRINT_LOW("Pending scratch.nFilledLen %u "
+            "look_ahead_nal %d", (unsigned int)scratch.nFilledLen, look_ahead_nal);
+    DEBUG_PRINT_LOW("Pending pdest_frame->nFilledLen %u",(unsigned int)pdest_frame->nFilledLen);
+    if (scratch.nFilledLen && look_ahead_nal) {
+        look_ahead_nal = false;
+        if ((pdest_frame->nAllocLen - pdest_frame->nFilledLen) >=
+                scratch.nFilledLen) {
+            copy_scratch(pdest_frame);
+            DEBUG_PRINT_LOW("Copy the previous NAL (h264 scratch) into Dest frame");
+        } else {
+            DEBUG_PRINT_ERROR_RATELIMITED("Error:1: Destination buffer overflow for H264");
+            return OMX_ErrorBadParameter;
+        }
+    }
+
+    /* If an empty input is queued with EOS, do not coalesce with the destination-frame yet, as this may result
+       in EOS flag getting associated with the destination
+    */
+    if (!psource_frame->nFilledLen && (psource_frame->nFlags & OMX_BUFFERFLAG_EOS) &&
+            pdest_frame->nFilledLen) {
+        DEBUG_PRINT_HIGH("delay ETB for 'empty buffer with EOS'");
+        generate_ebd = OMX_FALSE;
+    }
+
+    /* Out of spans or held source buffers: materialize the pending NAL */
+    if (spans.is_full()) {
+        flatten_nal();
+    }
+
+    if (parse_nal(psource_frame, &partial_frame) == -1) {
+        return OMX_ErrorBadParameter;
+    }
+
+    if (partial_frame == 0) {
+        if (nal_count == 0 && scratch.nFilledLen == 0) {
+            DEBUG_PRINT_LOW("First NAL with Zero Length, hence Skip");
+            nal_count++;
+            scratch.nTimeStamp = psource_frame->nTimeStamp;
+            scratch.nFlags = psource_frame->nFlags;
+        } else {
+            DEBUG_PRINT_LOW("Parsed New NAL Length = %u",(unsigned int)scratch.nFilledLen);
+            if (scratch.nFilledLen) {
+                if (prepare_nal_head(nal_head, nal)) {
+                    client->nal_parsed(nal);
+                    detect_boundary(nal, isNewFrame);
+                } else {
+                    DEBUG_PRINT_ERROR("No NAL header found in %u bytes",
+                            (unsigned int)nal_head.nFilledLen);
+                    isNewFrame = OMX_FALSE;
+                }
+                nal_count++;
+                if (VALID_TS(last_au_ts) && !VALID_TS(pdest_frame->nTimeStamp)) {
+                    pdest_frame->nTimeStamp = last_au_ts;
+                    pdest_frame->nFlags = last_au_flags;
+                    client->au_started(last_au_ts);
+                }
+                if (nal.type == NALU_TYPE_NON_IDR ||
+                        nal.type == NALU_TYPE_IDR) {
+                    last_au_ts = scratch.nTimeStamp;
+                    last_au_flags = scratch.nFlags;
+                    OMX_S64 ts_in_sei = client->au_timestamp(last_au_ts);
+                    if (!VALID_TS(last_au_ts))
+                        last_au_ts = ts_in_sei;
+                } else
+                    last_au_ts = LLONG_MAX;
+            }
+
+            if (!isNewFrame) {
+                if ( (pdest_frame->nAllocLen - pdest_frame->nFilledLen) >=
+                        scratch.nFilledLen) {
+                    DEBUG_PRINT_LOW("Not a NewFrame Copy into Dest len %u",
+                            (unsigned int)scratch.nFilledLen);
+                    copy_scratch(pdest_frame);
+                    if (nal.type == NALU_TYPE_EOSEQ)
+                        pdest_frame->nFlags |= QOMX_VIDEO_BUFFERFLAG_EOSEQ;
+                } else {
+                    DEBUG_PRINT_LOW("Error:2: Destination buffer overflow for H264");
+                    return OMX_ErrorBadParameter;
+                }
+            } else if(scratch.nFilledLen) {
+                look_ahead_nal = true;
+                DEBUG_PRINT_LOW("Frame Found start Decoding Size =%u TimeStamp = %llu",
+                        (unsigned int)pdest_frame->nFilledLen,pdest_frame->nTimeStamp);
+                DEBUG_PRINT_LOW("Found a frame size = %u number = %d",
+                        (unsigned int)pdest_frame->nFilledLen,frame_count++);
+
+                if (pdest_frame->nFilledLen == 0) {
+                    DEBUG_PRINT_LOW("Copy the Current Frame since and push it");
+                    look_ahead_nal = false;
+                    if ( (pdest_frame->nAllocLen - pdest_frame->nFilledLen) >=
+                            scratch.nFilledLen) {
+                        copy_scratch(pdest_frame);
+                    } else {
+                        DEBUG_PRINT_ERROR_RATELIMITED("Error:3: Destination buffer overflow for H264");
+                        return OMX_ErrorBadParameter;
+                    }
+                } else {
+                    if (psource_frame->nFilledLen || scratch.nFilledLen) {
+                        DEBUG_PRINT_LOW("Reset the EOS Flag");
+                        pdest_frame->nFlags &= ~OMX_BUFFERFLAG_EOS;
+                    }
+                    /*Push the frame to the Decoder*/
+                    if (client->au_ready(pdest_frame) != OMX_ErrorNone) {
+                        return OMX_ErrorBadParameter;
+                    }
+                    pdest_frame = next_dest();
+                    if (pdest_frame == NULL) {
+                        /* The look-ahead NAL has to wait for a free input
+                           buffer; stop referencing the client buffers */
+                        flatten_nal();
+                    }
+                }
+            }
+        }
+    } else {
+        DEBUG_PRINT_LOW("Not a Complete Frame, pdest_frame->nFilledLen %u", (unsigned int)pdest_frame->nFilledLen);
+        /*Check if Destination Buffer is full*/
+        if (scratch.nAllocLen ==
+                scratch.nFilledLen + scratch.nOffset) {
+            DEBUG_PRINT_ERROR("ERROR: Frame Not found though Destination Filled");
+            return OMX_ErrorStreamCorrupt;
+        }
+    }
+
+    if (!psource_frame->nFilledLen) {
+        DEBUG_PRINT_LOW("Buffer Consumed return source %p back to client",psource_frame);
+
+        if (psource_frame->nFlags & OMX_BUFFERFLAG_EOS) {
+            flatten_nal();
+            if (pdest_frame) {
+                DEBUG_PRINT_LOW("EOS Reached Pass Last Buffer");
+                if ( (pdest_frame->nAllocLen - pdest_frame->nFilledLen) >=
+                        scratch.nFilledLen) {
+                    if(pdest_frame->nFilledLen == 0) {
+                        /* No residual frame from before, send whatever
+                         * we have left */
+                        copy_scratch(pdest_frame);
+                        pdest_frame->nTimeStamp = scratch.nTimeStamp;
+                    } else {
+                        isNewFrame = OMX_FALSE;
+                        if (locate_nal_unit(&scratch, nal))
+                            detect_boundary(nal, isNewFrame);
+                        if(!isNewFrame) {
+                            /* Have a residual frame, but we know that the
+                             * AU in this frame is belonging to whatever
+                             * frame we had left over.  So append it */
+                             copy_scratch(pdest_frame);
+                             if (last_au_ts != LLONG_MAX)
+                                 pdest_frame->nTimeStamp = last_au_ts;
+                        } else {
+                            /* Completely new frame, let's just push what
+                             * we have now.  The resulting EBD would trigger
+                             * another push */
+                            generate_ebd = OMX_FALSE;
+                            pdest_frame->nTimeStamp = last_au_ts;
+                            last_au_ts = scratch.nTimeStamp;
+                        }
+                    }
+                } else {
+                    DEBUG_PRINT_ERROR_RATELIMITED("ERROR:4: Destination buffer overflow for H264");
+                    return OMX_ErrorBadParameter;
+                }
+
+                /* Iff we coalesced two buffers, inherit the flags of both bufs */
+                if(generate_ebd == OMX_TRUE) {
+                     pdest_frame->nFlags = scratch.nFlags | psource_frame->nFlags;
+                }
+
+                DEBUG_PRINT_LOW("pdest_frame->nFilledLen =%u TimeStamp = %llu",
+                        (unsigned int)pdest_frame->nFilledLen,pdest_frame->nTimeStamp);
+                DEBUG_PRINT_LOW("Push AU frame number %d to driver", frame_count++);
+                OMX_S64 ts_in_sei = client->au_timestamp(pdest_frame->nTimeStamp);
+                if (!VALID_TS(pdest_frame->nTimeStamp))
+                    pdest_frame->nTimeStamp = ts_in_sei;
+                /*Push the frame to the Decoder*/
+                if (client->au_ready(pdest_frame) != OMX_ErrorNone) {
+                    return OMX_ErrorBadParameter;
+                }
+                frame_count++;
+                pdest_frame = NULL;
+            } else {
+                DEBUG_PRINT_LOW("Last frame in else dest addr %p size %u",
+                        pdest_frame, (unsigned int)scratch.nFilledLen);
+                generate_ebd = OMX_FALSE;
+            }
+        }
+    }
+    if (generate_ebd && !psource_frame->nFilledLen) {
+        /* Hold the source while the pending NAL points into it, but always
+           leave the client one input buffer so that it is never starved */
+        if (spans.references(psource_frame) &&
+                (spans.held_count() + 2 > source_count ||
+                 !spans.hold(psource_frame))) {
+            flatten_nal();
+        }
+        if (!spans.references(psource_frame)) {
+            client->source_done(psource_frame);
+        }
+        psource_frame = next_source();
+    }
+    return OMX_ErrorNone;
+}
+
+/* Finds the start code of a complete NAL and reads its header */
+bool AccessUnitAssembler::locate_nal_unit(OMX_BUFFERHEADERTYPE *nal, au_nal_unit &unit)
+{
+    OMX_U8 *data = nal->pBuffer;
+    OMX_U32 len = nal->nFilledLen, pos, header_size = detector->header_size();
+
+    unit.buffer = nal;
+    unit.type = NALU_TYPE_UNSPECIFIED;
+    for (pos = 2; pos < len; pos++) {
+        if (data[pos] == 0x01 && !data[pos - 1] && !data[pos - 2])
+            break;
+    }
+    pos++;
+    if (pos + header_size > len) {
+        return false;
+    }
+    unit.header = data + pos;
+    unit.payload = unit.header + header_size;
+    unit.payload_len = len - pos - header_size;
+    unit.type = detector->unit_type(unit.header);
+    return true;
+}
+
+/* Classifies a complete NAL and reports the stream change raised when it
+   is the first slice of a picture activating a different SPS */
+void AccessUnitAssembler::detect_boundary(const au_nal_unit &nal, OMX_BOOL &new_frame)
+{
+    stream_params params;
+    OMX_U32 changes;
+
+    detector->is_new_frame(nal, new_frame);
+    changes = detector->stream_change(params);
+    if (changes) {
+        client->stream_changed(changes, params);
+    }
+}
+
+/* Makes the head of the pending NAL contiguous in the scratch buffer and
+   locates its header. Slices only need their header to be classified,
+   every other NAL type is materialized in full. */
+bool AccessUnitAssembler::prepare_nal_head(OMX_BUFFERHEADERTYPE &nal_head,
+        au_nal_unit &unit)
+{
+    bool found;
+
+    nal_head = scratch;
+    if (!spans.size()) {
+        return locate_nal_unit(&nal_head, unit);
+    }
+
+    nal_head.nFilledLen = spans.copy_to(scratch.pBuffer, H264_NAL_HEAD_BYTES);
+    found = locate_nal_unit(&nal_head, unit);
+    if (found && nal_head.nFilledLen < spans.size() &&
+            (unit.type == NALU_TYPE_NON_IDR || unit.type == NALU_TYPE_IDR)) {
+        return true;
+    }
+
+    flatten_nal();
+    if (found) {
+        /* Same bytes at the same place, only the length grew */
+        unit.payload_len += scratch.nFilledLen - nal_head.nFilledLen;
+        nal_head.nFilledLen = scratch.nFilledLen;
+        return true;
+    }
+    nal_head.nFilledLen = scratch.nFilledLen;
+    return locate_nal_unit(&nal_head, unit);
+}
+
+/* Copies the pending NAL into the scratch buffer so that it no longer
+   refers to client buffers, and returns the buffers held for it. */
+void AccessUnitAssembler::flatten_nal()
+{
+    OMX_BUFFERHEADERTYPE *buffer;
+
+    if (spans.size()) {
+        spans.copy_to(scratch.pBuffer, scratch.nAllocLen);
+        spans.reset();
+        spans.append(scratch.pBuffer, scratch.nFilledLen);
+    }
+
+    while ((buffer = spans.release_held()) != NULL) {
+        client->source_done(buffer);
+    }
+}
+
+/* Appends the pending NAL to dest; callers check the available space */
+void AccessUnitAssembler::copy_scratch(OMX_BUFFERHEADERTYPE *dest)
+{
+    if (spans.size()) {
+        spans.copy_to(dest->pBuffer + dest->nFilledLen, scratch.nFilledLen);
+    } else {
+        memcpy ((dest->pBuffer + dest->nFilledLen),
+                scratch.pBuffer, scratch.nFilledLen);
+    }
+    dest->nFilledLen += scratch.nFilledLen;
+    scratch.nFilledLen = 0;
+    reset_spans();
+}
+
+void AccessUnitAssembler::reset_spans()
+{
+    OMX_BUFFERHEADERTYPE *buffer;
+
+    spans.reset();
+    while ((buffer = spans.release_held()) != NULL) {
+        client->source_done(buffer);
+    }
+}
+
+OMX_ERRORTYPE AccessUnitAssembler::push_hevc(OMX_BUFFERHEADERTYPE *&psource_frame,
+        OMX_BUFFERHEADERTYPE *&pdest_frame)
+{
+    OMX_U32 partial_frame = 1;
+    OMX_BOOL isNewFrame = OMX_FALSE;
+    OMX_BOOL generate_ebd = OMX_TRUE;
+    OMX_ERRORTYPE rc = OMX_ErrorNone;
+    au_nal_unit nal;
+    if (scratch.pBuffer == NULL) {
+        DEBUG_PRINT_ERROR("ERROR:Hevc Scratch Buffer not allocated");
+        return OMX_ErrorBadParameter;
+    }
+
+    DEBUG_PRINT_LOW("scratch.nFilledLen %u has look_ahead_nal %d \
+            pdest_frame nFilledLen %u nTimeStamp %lld",
+            (unsigned int)scratch.nFilledLen, look_ahead_nal, (unsigned int)pdest_frame->nFilledLen, pdest_frame->nTimeStamp);
+
+    if (scratch.nFilledLen && look_ahead_nal) {
+        look_ahead_nal = false;
+        rc = copy_buffer(pdest_frame, &scratch);
+        if (rc != OMX_ErrorNone) {
+            return rc;
+        }
+    }
+
+    if (parse_nal(psource_frame, &partial_frame) == -1) {
+        return OMX_ErrorBadParameter;
+    }
+
+    if (partial_frame == 0) {
+        if (nal_count == 0 && scratch.nFilledLen == 0) {
+            DEBUG_PRINT_LOW("First NAL with Zero Length, hence Skip");
+            nal_count++;
+            scratch.nTimeStamp = psource_frame->nTimeStamp;
+            scratch.nFlags = psource_frame->nFlags;
+        } else {
+            DEBUG_PRINT_LOW("Parsed New NAL Length = %u", (unsigned int)scratch.nFilledLen);
+            if (scratch.nFilledLen) {
+                if (locate_nal_unit(&scratch, nal))
+                    detect_boundary(nal, isNewFrame);
+                nal_count++;
+            }
+
+            if (!isNewFrame) {
+                DEBUG_PRINT_LOW("Not a new frame, copy scratch nFilledLen %u \
+                        nTimestamp %lld, pdest_frame nFilledLen %u nTimestamp %lld",
+                        (unsigned int)scratch.nFilledLen, scratch.nTimeStamp,
+                        (unsigned int)pdest_frame->nFilledLen, pdest_frame->nTimeStamp);
+                rc = copy_buffer(pdest_frame, &scratch);
+                if (rc != OMX_ErrorNone) {
+                    return rc;
+                }
+            } else {
+                look_ahead_nal = true;
+                if (pdest_frame->nFilledLen == 0) {
+                    look_ahead_nal = false;
+                    DEBUG_PRINT_LOW("dest nation buffer empty, copy scratch buffer");
+                    rc = copy_buffer(pdest_frame, &scratch);
+                    if (rc != OMX_ErrorNone) {
+                        return OMX_ErrorBadParameter;
+                    }
+                } else {
+                    if (psource_frame->nFilledLen || scratch.nFilledLen) {
+                        pdest_frame->nFlags &= ~OMX_BUFFERFLAG_EOS;
+                    }
+                    DEBUG_PRINT_LOW("FrameDetected # %d pdest_frame nFilledLen %u \
+                            nTimeStamp %lld, look_ahead_nal in scratch \
+                            nFilledLen %u nTimeStamp %lld",
+                            frame_count++, (unsigned int)pdest_frame->nFilledLen,
+                            pdest_frame->nTimeStamp, (unsigned int)scratch.nFilledLen,
+                            scratch.nTimeStamp);
+                    if (client->au_ready(pdest_frame) != OMX_ErrorNone) {
+                        return OMX_ErrorBadParameter;
+                    }
+                    pdest_frame = next_dest();
+                }
+            }
+        }
+    } else {
+        DEBUG_PRINT_LOW("psource_frame is partial nFilledLen %u nTimeStamp %lld, \
+                pdest_frame nFilledLen %u nTimeStamp %lld, scratch \
+                nFilledLen %u nTimeStamp %lld",
+                (unsigned int)psource_frame->nFilledLen, psource_frame->nTimeStamp,
+                (unsigned int)pdest_frame->nFilledLen, pdest_frame->nTimeStamp,
+                (unsigned int)scratch.nFilledLen, scratch.nTimeStamp);
+
+        if (scratch.nAllocLen ==
+                scratch.nFilledLen + scratch.nOffset) {
+            DEBUG_PRINT_ERROR("ERROR: Frame Not found though Destination Filled");
+            return OMX_ErrorStreamCorrupt;
+        }
+    }
+
+    if (!psource_frame->nFilledLen) {
+        DEBUG_PRINT_LOW("Buffer Consumed return source %p back to client", psource_frame);
+        if (psource_frame->nFlags & OMX_BUFFERFLAG_EOS) {
+            if (pdest_frame) {
+                DEBUG_PRINT_LOW("EOS Reached Pass Last Buffer");
+                rc = copy_buffer(pdest_frame, &scratch);
+                if ( rc != OMX_ErrorNone ) {
+                    return rc;
+                }
+                pdest_frame->nTimeStamp = scratch.nTimeStamp;
+                pdest_frame->nFlags = scratch.nFlags | psource_frame->nFlags;
+                DEBUG_PRINT_LOW("Push EOS frame number:%d nFilledLen =%u TimeStamp = %lld",
+                        frame_count, (unsigned int)pdest_frame->nFilledLen, pdest_frame->nTimeStamp);
+                if (client->au_ready(pdest_frame) != OMX_ErrorNone) {
+                    return OMX_ErrorBadParameter;
+                }
+                frame_count++;
+                pdest_frame = NULL;
+            } else {
+                DEBUG_PRINT_LOW("Last frame in else dest addr %p size %u",
+                        pdest_frame, (unsigned int)scratch.nFilledLen);
+                generate_ebd = OMX_FALSE;
+            }
+        }
+    }
+
+    if (generate_ebd && !psource_frame->nFilledLen) {
+        client->source_done(psource_frame);
+        psource_frame = next_source();
+    }
+    return OMX_ErrorNone;
+}
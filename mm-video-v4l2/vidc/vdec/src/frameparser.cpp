@@ -41,6 +41,11 @@ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <sys/time.h>
 #include <sys/poll.h>
 #include <stdint.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 #include "frameparser.h"
 #include "vidc_debug.h"
@@ -66,14 +71,81 @@ static unsigned char VC1_AP_mask_code[4] = {0xFF,0xFF,0xFF,0xFC};
 static unsigned char MPEG2_start_code[4] = {0x00, 0x00, 0x01, 0x00};
 static unsigned char MPEG2_mask_code[4] = {0xFF, 0xFF, 0xFF, 0xFF};
 
-frame_parse::frame_parse():mutils(NULL),
-    parse_state(A0),
+#define SC_SCAN_BLOCK 16
+
+/* Returns the index of the first zero byte in [pos, len) that is either
+ * followed by another zero byte or is the last byte of the range, or len
+ * if there is none. From state A0 every byte before that index leaves the
+ * start code state machine in A0, so the scan can jump straight to it. */
+static OMX_U32 find_zero_pair_scalar(const OMX_U8 *buf, OMX_U32 pos, OMX_U32 len)
+{
+    while (pos < len) {
+        const OMX_U8 *zero = (const OMX_U8 *)memchr(buf + pos, 0x00, len - pos);
+
+        if (zero == NULL)
+            return len;
+
+        pos = zero - buf;
+
+        if (pos + 1 == len || buf[pos + 1] == 0x00)
+            return pos;
+
+        pos += 2;
+    }
+
+    return len;
+}
+
+static OMX_U32 find_zero_pair(const OMX_U8 *buf, OMX_U32 pos, OMX_U32 len)
+{
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+
+    /* Each block also reads the byte following it, hence the extra byte. */
+    while (pos + SC_SCAN_BLOCK + 1 <= len) {
+        __m128i cur = _mm_loadu_si128((const __m128i *)(buf + pos));
+        __m128i next = _mm_loadu_si128((const __m128i *)(buf + pos + 1));
+        int mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(cur, zero),
+                    _mm_cmpeq_epi8(next, zero)));
+
+        if (mask)
+            return pos + __builtin_ctz(mask);
+
+        pos += SC_SCAN_BLOCK;
+    }
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+    while (pos + SC_SCAN_BLOCK + 1 <= len) {
+        uint8x16_t cur = vld1q_u8(buf + pos);
+        uint8x16_t next = vld1q_u8(buf + pos + 1);
+        uint8x16_t hit = vandq_u8(vceqq_u8(cur, vdupq_n_u8(0)),
+                vceqq_u8(next, vdupq_n_u8(0)));
+        uint64x2_t hit64 = vreinterpretq_u64_u8(hit);
+
+        if (vgetq_lane_u64(hit64, 0) | vgetq_lane_u64(hit64, 1)) {
+            OMX_U32 i = 0;
+
+            while (buf[pos + i] || buf[pos + i + 1])
+                i++;
+
+            return pos + i;
+        }
+
+        pos += SC_SCAN_BLOCK;
+    }
+#endif
+
+    return find_zero_pair_scalar(buf, pos, len);
+}
+
+frame_parse::frame_parse():parse_state(A0),
     start_code(NULL),
     mask_code(NULL),
     last_byte_h263(0),
     last_byte(0),
     header_found(false),
     skip_frame_boundary(false),
+    fast_scan(false),
+    span_sink(NULL),
     state_nal(NAL_LENGTH_ACC),
     nal_length(0),
     accum_length(0),
@@ -83,10 +155,6 @@ frame_parse::frame_parse():mutils(NULL),
 
 frame_parse::~frame_parse ()
 {
-    if (mutils)
-        delete mutils;
-
-    mutils = NULL;
 }
 
 int frame_parse::init_start_codes (codec_type codec_type_parse)
@@ -126,10 +194,28 @@ int frame_parse::init_start_codes (codec_type codec_type_parse)
             return -1;
     }
 
+    /* The vector scan only looks for a zero byte pair, which is a prefix
+     * of every start code we parse today, but stay generic. */
+    fast_scan = start_code && mask_code &&
+        (mask_code[0] == 0xFF && start_code[0] == 0x00) &&
+        (mask_code[1] == 0xFF && start_code[1] == 0x00);
+
     return 1;
 }
 
 
+bool frame_parse::set_span_sink (nal_span_list *spans)
+{
+    /* Codecs that patch the byte following the start code cannot be
+     * described by spans of constant tables and source bytes. */
+    if (spans && start_code != H264_start_code) {
+        return false;
+    }
+
+    span_sink = spans;
+    return true;
+}
+
 int frame_parse::init_nal_length (unsigned int nal_len)
 {
     if (nal_len == 0 || nal_len > 4 || state_nal != NAL_LENGTH_ACC) {
@@ -182,12 +268,12 @@ int frame_parse::parse_sc_frame ( OMX_BUFFERHEADERTYPE *source,
         dest->nTimeStamp = source->nTimeStamp;
 
         if (start_code == H263_start_code) {
-            memcpy (pdest,start_code,2);
+            copy_out (pdest,start_code,2);
             pdest[2] = last_byte_h263;
             dest->nFilledLen += 3;
             pdest += 3;
         } else {
-            memcpy (pdest,start_code,4);
+            copy_out (pdest,start_code,4);
 
             if (start_code == VC1_AP_start_code
                     || start_code == MPEG4_start_code
@@ -228,19 +314,19 @@ int frame_parse::parse_sc_frame ( OMX_BUFFERHEADERTYPE *source,
                     psource++;
                 } else if ((start_code [1] == start_code [0]) && (start_code [2]  == start_code [1])) {
                     parse_state = A2;
-                    memcpy (pdest,start_code,1);
+                    copy_out (pdest,start_code,1);
                     pdest++;
                     dest->nFilledLen++;
                     dest_len--;
                 } else if (start_code [2] == start_code [0]) {
                     parse_state = A1;
-                    memcpy (pdest,start_code,2);
+                    copy_out (pdest,start_code,2);
                     pdest += 2;
                     dest->nFilledLen += 2;
                     dest_len -= 2;
                 } else {
                     parse_state = A0;
-                    memcpy (pdest,start_code,3);
+                    copy_out (pdest,start_code,3);
                     pdest += 3;
                     dest->nFilledLen +=3;
                     dest_len -= 3;
@@ -275,13 +361,13 @@ int frame_parse::parse_sc_frame ( OMX_BUFFERHEADERTYPE *source,
                     psource++;
                 } else if (start_code [1] == start_code [0]) {
                     parse_state = A1;
-                    memcpy (pdest,start_code,1);
+                    copy_out (pdest,start_code,1);
                     dest->nFilledLen +=1;
                     dest_len--;
                     pdest++;
                 } else {
                     parse_state = A0;
-                    memcpy (pdest,start_code,2);
+                    copy_out (pdest,start_code,2);
                     dest->nFilledLen +=2;
                     dest_len -= 2;
                     pdest += 2;
@@ -297,7 +383,7 @@ int frame_parse::parse_sc_frame ( OMX_BUFFERHEADERTYPE *source,
                     source->nOffset++;
                     psource++;
                 } else {
-                    memcpy (pdest,start_code,1);
+                    copy_out (pdest,start_code,1);
                     dest->nFilledLen +=1;
                     pdest++;
                     dest_len--;
@@ -342,6 +428,14 @@ int frame_parse::parse_sc_frame ( OMX_BUFFERHEADERTYPE *source,
         switch (parse_state) {
             case A0:
 
+                if (fast_scan) {
+                    parsed_length = find_zero_pair(psource, parsed_length, temp_len);
+
+                    if (parsed_length >= temp_len) {
+                        break;
+                    }
+                }
+
                 if ((psource [parsed_length] & mask_code [0])  == start_code[0]) {
                     parse_state = A1;
                 }
@@ -463,7 +557,7 @@ int frame_parse::parse_sc_frame ( OMX_BUFFERHEADERTYPE *source,
     }
 
     if (parsed_length > bytes_to_skip) {
-        memcpy (pdest, psource, (parsed_length-bytes_to_skip));
+        copy_out (pdest,psource, (parsed_length-bytes_to_skip));
         dest->nFilledLen += (parsed_length-bytes_to_skip);
     }
 
@@ -502,7 +596,7 @@ int frame_parse::parse_h264_nallength (OMX_BUFFERHEADERTYPE *source,
             *partialframe = 0;
             return 1;
         } else {
-            DEBUG_PRINT_ERROR("FrameParser: NAL Parsing Error!"
+            DEBUG_PRINT_ERROR_RATELIMITED("FrameParser: NAL Parsing Error!"
                 "Buffer recieved with source_len = %u and with"
                 "flags %u", (unsigned int)source_len, (unsigned int)source->nFlags);
             return -1;
@@ -532,7 +626,7 @@ int frame_parse::parse_h264_nallength (OMX_BUFFERHEADERTYPE *source,
             if (accum_length == nal_length) {
                 accum_length = 0;
                 state_nal = NAL_PARSING;
-                memcpy (pdest,H264_start_code,4);
+                copy_out (pdest,H264_start_code,4);
                 dest->nFilledLen += 4;
                 break;
             }
@@ -552,13 +646,13 @@ int frame_parse::parse_h264_nallength (OMX_BUFFERHEADERTYPE *source,
     /*Already in Parsing state go ahead and copy*/
     if (state_nal == NAL_PARSING && temp_len > 0) {
         if (temp_len < bytes_tobeparsed) {
-            memcpy (pdest,psource,temp_len);
+            copy_out (pdest,psource,temp_len);
             dest->nFilledLen += temp_len;
             source->nOffset += temp_len;
             source->nFilledLen -= temp_len;
             bytes_tobeparsed -= temp_len;
         } else {
-            memcpy (pdest,psource,bytes_tobeparsed);
+            copy_out (pdest,psource,bytes_tobeparsed);
             temp_len -= bytes_tobeparsed;
             dest->nFilledLen += bytes_tobeparsed;
             source->nOffset += bytes_tobeparsed;
@@ -585,6 +679,15 @@ void frame_parse::flush ()
     skip_frame_boundary = false;
 }
 
+void frame_parse::copy_out(OMX_U8 *pdest, const OMX_U8 *psource, OMX_U32 len)
+{
+    if (span_sink) {
+        span_sink->append(psource, len);
+    } else {
+        memcpy (pdest, psource, len);
+    }
+}
+
 void frame_parse::parse_additional_start_code(OMX_U8 *psource,
         OMX_U32 *parsed_length)
 {
@@ -636,3 +739,109 @@ void frame_parse::update_skip_frame()
         skip_frame_boundary = true;
     }
 }
+
+nal_span_list::nal_span_list():
+    count(0),
+    total_len(0),
+    held(0),
+    held_first(0)
+{
+    memset(spans, 0, sizeof(spans));
+    memset(held_buffers, 0, sizeof(held_buffers));
+}
+
+void nal_span_list::reset()
+{
+    count = 0;
+    total_len = 0;
+}
+
+bool nal_span_list::append(const OMX_U8 *data, OMX_U32 len)
+{
+    if (!len) {
+        return true;
+    }
+
+    /* Bytes that continue the previous span (same source buffer) merge */
+    if (count && spans[count - 1].data + spans[count - 1].len == data) {
+        spans[count - 1].len += len;
+        total_len += len;
+        return true;
+    }
+
+    if (count == MAX_NAL_SPANS) {
+        DEBUG_PRINT_ERROR_RATELIMITED("nal_span_list: out of spans");
+        return false;
+    }
+
+    spans[count].data = data;
+    spans[count].len = len;
+    count++;
+    total_len += len;
+    return true;
+}
+
+OMX_U32 nal_span_list::copy_to(OMX_U8 *dest, OMX_U32 max_len) const
+{
+    OMX_U32 copied = 0;
+
+    for (OMX_U32 i = 0; i < count && copied < max_len; i++) {
+        OMX_U32 len = spans[i].len;
+
+        if (len > max_len - copied)
+            len = max_len - copied;
+
+        /* A span may already sit at its destination (flattened list) */
+        if (spans[i].data != dest + copied)
+            memmove(dest + copied, spans[i].data, len);
+
+        copied += len;
+    }
+
+    return copied;
+}
+
+bool nal_span_list::references(const OMX_BUFFERHEADERTYPE *buffer) const
+{
+    const OMX_U8 *start = buffer->pBuffer;
+    const OMX_U8 *end = buffer->pBuffer + buffer->nAllocLen;
+
+    /* Spans that continue into the next source buffer are merged by
+       append(), so any overlap counts, not only a span starting here */
+    for (OMX_U32 i = 0; i < count; i++) {
+        if (spans[i].data < end && spans[i].data + spans[i].len > start)
+            return true;
+    }
+
+    return false;
+}
+
+bool nal_span_list::hold(OMX_BUFFERHEADERTYPE *buffer)
+{
+    if (held == MAX_NAL_HELD_BUFFERS) {
+        return false;
+    }
+
+    held_buffers[(held_first + held) % MAX_NAL_HELD_BUFFERS] = buffer;
+    held++;
+    return true;
+}
+
+OMX_BUFFERHEADERTYPE *nal_span_list::release_held()
+{
+    OMX_BUFFERHEADERTYPE *buffer = NULL;
+
+    if (held) {
+        buffer = held_buffers[held_first];
+        held_first = (held_first + 1) % MAX_NAL_HELD_BUFFERS;
+        held--;
+    }
+
+    return buffer;
+}
+
+bool nal_span_list::is_full() const
+{
+    /* One parse call adds at most four spans */
+    return (count + 4 > MAX_NAL_SPANS) || (held == MAX_NAL_HELD_BUFFERS);
+}
@@ -46,7 +46,8 @@ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 ========================================================================== */
 #include "h264_utils.h"
-#include "extra_data_handler.h"
+#include "vidc_debug.h"
+#include <stddef.h>
 #include <string.h>
 #include <stdlib.h>
 #include <limits.h>
@@ -71,99 +72,15 @@ extern "C" {
 
 #define MAX_SUPPORTED_LEVEL 32
 
-    RbspParser::RbspParser (const uint8 *_begin, const uint8 *_end)
-: begin (_begin), end(_end), pos (- 1), bit (0),
-    cursor (0xFFFFFF), advanceNeeded (true)
-{
-}
-
-// Destructor
-/*lint -e{1540}  Pointer member neither freed nor zeroed by destructor
- * No problem
- */
-RbspParser::~RbspParser () {}
-
-// Return next RBSP byte as a word
-uint32 RbspParser::next ()
-{
-    if (advanceNeeded) advance ();
-    //return static_cast<uint32> (*pos);
-    return static_cast<uint32> (begin[pos]);
-}
-
-// Advance RBSP decoder to next byte
-void RbspParser::advance ()
-{
-    ++pos;
-    //if (pos >= stop)
-    if (begin + pos == end) {
-        /*lint -e{730}  Boolean argument to function
-         * I don't see a problem here
-         */
-        //throw false;
-        ALOGV("H264Parser-->NEED TO THROW THE EXCEPTION...");
-    }
-    cursor <<= 8;
-    //cursor |= static_cast<uint32> (*pos);
-    cursor |= static_cast<uint32> (begin[pos]);
-    if ((cursor & 0xFFFFFF) == 0x000003) {
-        advance ();
-    }
-    advanceNeeded = false;
-}
-
-// Decode unsigned integer
-uint32 RbspParser::u (uint32 n)
-{
-    uint32 i, s, x = 0;
-    for (i = 0; i < n; i += s) {
-        s = static_cast<uint32>STD_MIN(static_cast<int>(8 - bit),
-                static_cast<int>(n - i));
-        x <<= s;
-
-        x |= ((next () >> ((8 - static_cast<uint32>(bit)) - s)) &
-                ((1 << s) - 1));
-
-        bit = (bit + s) % 8;
-        if (!bit) {
-            advanceNeeded = true;
-        }
-    }
-    return x;
-}
-
-// Decode unsigned integer Exp-Golomb-coded syntax element
-uint32 RbspParser::ue ()
-{
-    int leadingZeroBits = -1;
-    for (uint32 b = 0; !b; ++leadingZeroBits) {
-        b = u (1);
-    }
-    return ((1 << leadingZeroBits) - 1) +
-        u (static_cast<uint32>(leadingZeroBits));
-}
-
-// Decode signed integer Exp-Golomb-coded syntax element
-int32 RbspParser::se ()
-{
-    const uint32 x = ue ();
-    if (!x) return 0;
-    else if (x & 1) return static_cast<int32> ((x >> 1) + 1);
-    else return - static_cast<int32> (x >> 1);
-}
-
-void H264_Utils::allocate_rbsp_buffer(uint32 inputBufferSize)
-{
-    m_rbspBytes = (byte *) calloc(1,inputBufferSize);
-    m_prv_nalu.nal_ref_idc = 0;
-    m_prv_nalu.nalu_type = NALU_TYPE_UNSPECIFIED;
-}
-
 H264_Utils::H264_Utils(): m_height(0),
     m_width(0),
-    m_rbspBytes(NULL),
+    m_sps_valid(0),
+    m_sps_updated(0),
+    m_active_sps(H264_MAX_SPS_COUNT),
+    m_stream_changes(0),
     m_au_data (false)
 {
+    memset(m_pps_valid, 0, sizeof(m_pps_valid));
     initialize_frame_checking_environment();
 }
 
@@ -175,10 +92,6 @@ H264_Utils::~H264_Utils()
         m_pbits = NULL;
         }
      */
-    if (m_rbspBytes) {
-        free(m_rbspBytes);
-        m_rbspBytes = NULL;
-    }
 }
 
 /***********************************************************************/
@@ -205,27 +118,28 @@ void H264_Utils::initialize_frame_checking_environment()
     m_au_data = false;
     m_prv_nalu.nal_ref_idc = 0;
     m_prv_nalu.nalu_type = NALU_TYPE_UNSPECIFIED;
+    memset(&m_prv_slice, 0, sizeof(m_prv_slice));
 }
 
 /***********************************************************************/
 /*
 FUNCTION:
-H264_Utils::extract_rbsp
+H264_Utils::locate_nal
 
 DESCRIPTION:
-Extract RBSP data from a NAL
+Locate the NAL header and the payload bounds of the first NAL in a buffer.
+The payload is left as is, RbspParser removes the emulation prevention
+bytes of the part that is read.
 
 INPUT/OUTPUT PARAMETERS:
 <In>
 buffer : buffer containing start code or nal length + NAL units
 buffer_length : the length of the NAL buffer
-start_code : If true, start code is detected,
-otherwise size nal length is detected
-size_of_nal_length_field: size of nal length field
+size_of_nal_length_field: size of nal length field, 0 for start codes
 
 <Out>
-rbsp_bistream : extracted RBSP bistream
-rbsp_length : the length of the RBSP bitstream
+payload_offset : offset of the first byte after the NAL header
+payload_end : offset past the last byte the NAL may span
 nal_unit : decoded NAL header information
 
 RETURN VALUE:
@@ -236,21 +150,24 @@ None.
  */
 /***********************************************************************/
 
-boolean H264_Utils::extract_rbsp(OMX_IN   OMX_U8  *buffer,
+boolean H264_Utils::locate_nal(OMX_IN   OMX_U8  *buffer,
         OMX_IN   OMX_U32 buffer_length,
         OMX_IN   OMX_U32 size_of_nal_length_field,
-        OMX_OUT  OMX_U8  *rbsp_bistream,
-        OMX_OUT  OMX_U32 *rbsp_length,
+        OMX_OUT  OMX_U32 *payload_offset,
+        OMX_OUT  OMX_U32 *payload_end,
         OMX_OUT  NALU    *nal_unit)
 {
     byte coef1, coef2, coef3;
     uint32 pos = 0;
     uint32 nal_len = buffer_length;
     uint32 sizeofNalLengthField = 0;
-    uint32 zero_count;
-    boolean eRet = true;
     boolean start_code = (size_of_nal_length_field==0)?true:false;
 
+    if (buffer_length < 3) {
+        ALOGE("ERROR: In %s() - line %d", __func__, __LINE__);
+        return false;
+    }
+
     if (start_code) {
         // Search start_code_prefix_one_3bytes (0x000001)
         coef2 = buffer[pos++];
@@ -294,38 +211,280 @@ boolean H264_Utils::extract_rbsp(OMX_IN   OMX_U8  *buffer,
     nal_unit->nalu_type = buffer[pos++] & 0x1f;
     ALOGV("@#@# Pos = %x NalType = %x buflen = %d",
             pos-1, nal_unit->nalu_type, buffer_length);
-    *rbsp_length = 0;
 
+    *payload_offset = pos;
+    *payload_end = nal_len + sizeofNalLengthField;
+    return true;
+}
+
+static void skip_scaling_list(RbspParser &parser, uint32 size)
+{
+    int32 last_scale = 8, next_scale = 8;
 
-    if ( nal_unit->nalu_type == NALU_TYPE_EOSEQ ||
-            nal_unit->nalu_type == NALU_TYPE_EOSTREAM)
-        return (nal_len + sizeofNalLengthField);
+    for (uint32 j = 0; j < size && !parser.overrun(); j++) {
+        if (next_scale) {
+            next_scale = (last_scale + parser.se() + 256) % 256;
+        }
+        last_scale = next_scale ? next_scale : last_scale;
+    }
+}
 
-    zero_count = 0;
-    while (pos < (nal_len+sizeofNalLengthField)) {  //similar to for in p-42
-        if ( zero_count == 2 ) {
-            if ( buffer[pos] == 0x03 ) {
-                pos ++;
-                zero_count = 0;
-                continue;
+/* Keeps the SPS fields slice headers and stream_params depend on, up to
+   the cropping window. key identifies the payload in m_param_sets. */
+void H264_Utils::parse_sps(RbspParser &parser, const param_set_key &key)
+{
+    H264ParamNalu sps;
+    uint32 profile_idc, chroma_format_idc = 1, id, i, n;
+
+    memset(&sps, 0, sizeof(sps));
+    profile_idc = parser.u(8);
+    parser.u(8); // constraint_set flags, reserved_zero_2bits
+    sps.levelIdc = parser.u(8);
+    id = parser.ue();
+    if (id >= H264_MAX_SPS_COUNT) {
+        ALOGE("ERROR: In %s() - invalid sps id %u", __func__, id);
+        return;
+    }
+    sps.seqSetID = id;
+    sps.profileIdc = profile_idc;
+
+    switch (profile_idc) {
+        case 100: case 110: case 122: case 244: case 44:
+        case 83: case 86: case 118: case 128: case 138:
+        case 139: case 134: case 135:
+            chroma_format_idc = parser.ue();
+            if (chroma_format_idc == 3) {
+                sps.separateColourPlaneFlag = parser.u(1);
             }
-            if ( buffer[pos] <= 0x01 ) {
-                if ( start_code ) {
-                    *rbsp_length -= 2;
-                    pos -= 2;
-                    return pos;
+            sps.bitDepthLumaMinus8 = parser.ue();
+            sps.bitDepthChromaMinus8 = parser.ue();
+            parser.u(1); // qpprime_y_zero_transform_bypass_flag
+            if (parser.u(1)) { // seq_scaling_matrix_present_flag
+                n = (chroma_format_idc != 3) ? 8 : 12;
+                for (i = 0; i < n; i++) {
+                    if (parser.u(1)) {
+                        skip_scaling_list(parser, (i < 6) ? 16 : 64);
+                    }
                 }
             }
-            zero_count = 0;
+            break;
+        default:
+            break;
+    }
+
+    sps.log2MaxFrameNumMinus4 = parser.ue();
+    sps.picOrderCntType = parser.ue();
+    if (sps.picOrderCntType == 0) {
+        sps.log2MaxPicOrderCntLsbMinus4 = parser.ue();
+    } else if (sps.picOrderCntType == 1) {
+        sps.deltaPicOrderAlwaysZeroFlag = parser.u(1);
+        parser.se(); // offset_for_non_ref_pic
+        parser.se(); // offset_for_top_to_bottom_field
+        n = parser.ue();
+        for (i = 0; i < n && i < 256 && !parser.overrun(); i++) {
+            parser.se(); // offset_for_ref_frame
         }
-        zero_count ++;
-        if ( buffer[pos] != 0 )
-            zero_count = 0;
+    }
+    parser.ue(); // max_num_ref_frames
+    parser.u(1); // gaps_in_frame_num_value_allowed_flag
+    sps.picWidthInMbsMinus1 = parser.ue();
+    sps.picHeightInMapUnitsMinus1 = parser.ue();
+    sps.frameMbsOnlyFlag = parser.u(1);
+    if (!sps.frameMbsOnlyFlag) {
+        parser.u(1); // mb_adaptive_frame_field_flag
+    }
+    parser.u(1); // direct_8x8_inference_flag
+    if (parser.u(1)) { // frame_cropping_flag
+        sps.crop_left = parser.ue();
+        sps.crop_right = parser.ue();
+        sps.crop_top = parser.ue();
+        sps.crop_bot = parser.ue();
+    }
+    sps.chromaFormatIdc = chroma_format_idc;
+
+    if (parser.overrun() || sps.log2MaxFrameNumMinus4 > 12 ||
+            sps.picOrderCntType > 2 || sps.log2MaxPicOrderCntLsbMinus4 > 12 ||
+            chroma_format_idc > 3 || sps.bitDepthLumaMinus8 > 6 ||
+            sps.bitDepthChromaMinus8 > 6) {
+        ALOGE("ERROR: In %s() - corrupt sps %u", __func__, id);
+        m_sps_valid &= ~(1u << id);
+        m_param_sets.remove(id);
+        return;
+    }
+    m_sps[id] = sps;
+    m_sps_valid |= 1u << id;
+    m_sps_updated |= 1u << id;
+    m_param_sets.store(id, key);
+}
+
+/* Keeps the PPS fields slice headers depend on. The SPS is looked up when a
+   slice refers to the PPS, since it may be resent after the PPS. */
+void H264_Utils::parse_pps(RbspParser &parser)
+{
+    H264ParamNalu pps;
+
+    memset(&pps, 0, sizeof(pps));
+    pps.picSetID = parser.ue();
+    pps.seqSetID = parser.ue();
+    if (pps.picSetID >= H264_MAX_PPS_COUNT) {
+        ALOGE("ERROR: In %s() - invalid pps id %u", __func__, pps.picSetID);
+        return;
+    }
+    parser.u(1); // entropy_coding_mode_flag
+    pps.picOrderPresentFlag = parser.u(1);
+
+    if (parser.overrun() || pps.seqSetID >= H264_MAX_SPS_COUNT) {
+        ALOGE("ERROR: In %s() - corrupt pps %u", __func__, pps.picSetID);
+        m_pps_valid[pps.picSetID] = false;
+        return;
+    }
+    m_pps[pps.picSetID] = pps;
+    m_pps_valid[pps.picSetID] = true;
+}
 
-        rbsp_bistream[(*rbsp_length)++] = buffer[pos++];
+/* Called for the slices of IDR pictures, where an SPS becomes active (H.264
+   7.4.1.2.1), and for the first slices decoded at all. Raises the changes
+   against the stream announced last, if the SPS is new or was updated. */
+void H264_Utils::activate_sps(uint32 id)
+{
+    const H264ParamNalu &sps = m_sps[id];
+    stream_params params;
+    uint32 crop_unit_x = 1, crop_unit_y = 1, crop_x, crop_y;
+
+    if (id == m_active_sps && !(m_sps_updated & (1u << id))) {
+        return;
+    }
+    m_active_sps = id;
+    m_sps_updated &= ~(1u << id);
+
+    // CropUnitX/Y for ChromaArrayType != 0, 7.4.2.1.1
+    if (!sps.separateColourPlaneFlag && sps.chromaFormatIdc) {
+        crop_unit_x = sps.chromaFormatIdc == 3 ? 1 : 2;
+        crop_unit_y = sps.chromaFormatIdc == 1 ? 2 : 1;
+    }
+    crop_unit_y *= sps.frameMbsOnlyFlag ? 1 : 2;
+
+    memset(&params, 0, sizeof(params));
+    params.profile = sps.profileIdc;
+    params.level = sps.levelIdc;
+    params.width = (sps.picWidthInMbsMinus1 + 1) * 16;
+    params.height = (sps.picHeightInMapUnitsMinus1 + 1) * 16 *
+        (sps.frameMbsOnlyFlag ? 1 : 2);
+    crop_x = crop_unit_x * (sps.crop_left + sps.crop_right);
+    crop_y = crop_unit_y * (sps.crop_top + sps.crop_bot);
+    if (crop_x < params.width && crop_y < params.height) {
+        params.crop_left = crop_unit_x * sps.crop_left;
+        params.crop_top = crop_unit_y * sps.crop_top;
+        params.crop_width = params.width - crop_x;
+        params.crop_height = params.height - crop_y;
+    } else {
+        params.crop_width = params.width;
+        params.crop_height = params.height;
     }
+    params.chroma_format = sps.chromaFormatIdc;
+    params.bit_depth_luma = sps.bitDepthLumaMinus8 + 8;
+    params.bit_depth_chroma = sps.bitDepthChromaMinus8 + 8;
+    params.interlaced = !sps.frameMbsOnlyFlag;
+    m_stream_changes |= m_param_sets.update_stream(params);
+}
+
+OMX_U32 H264_Utils::stream_change(stream_params &params)
+{
+    OMX_U32 changes = m_stream_changes;
 
-    return eRet;
+    m_stream_changes = 0;
+    params = m_param_sets.stream();
+    return changes;
+}
+
+/* Reads the slice header up to delta_pic_order_cnt, which covers every
+   field 7.4.1.2.4 compares. Only those bytes of the NAL are de-emulated. */
+void H264_Utils::parse_slice_header(RbspParser &parser, const NALU &nal_unit,
+        H264SliceInfo &slice)
+{
+    const H264ParamNalu *sps, *pps;
+
+    memset(&slice, 0, sizeof(slice));
+    slice.idr_pic_flag = (nal_unit.nalu_type == NALU_TYPE_IDR);
+    slice.first_mb_in_slice = parser.ue();
+    parser.ue(); // slice_type
+    slice.pic_parameter_set_id = parser.ue();
+    if (slice.pic_parameter_set_id >= H264_MAX_PPS_COUNT ||
+            !m_pps_valid[slice.pic_parameter_set_id]) {
+        return;
+    }
+    pps = &m_pps[slice.pic_parameter_set_id];
+    if (!(m_sps_valid & (1u << pps->seqSetID))) {
+        return;
+    }
+    sps = &m_sps[pps->seqSetID];
+
+    if (sps->separateColourPlaneFlag) {
+        parser.u(2); // colour_plane_id
+    }
+    slice.frame_num = parser.u(sps->log2MaxFrameNumMinus4 + 4);
+    if (!sps->frameMbsOnlyFlag) {
+        slice.field_pic_flag = parser.u(1);
+        if (slice.field_pic_flag) {
+            slice.bottom_field_flag = parser.u(1);
+        }
+    }
+    if (slice.idr_pic_flag) {
+        slice.idr_pic_id = parser.ue();
+    }
+    slice.pic_order_cnt_type = sps->picOrderCntType;
+    if (sps->picOrderCntType == 0) {
+        slice.pic_order_cnt_lsb = parser.u(sps->log2MaxPicOrderCntLsbMinus4 + 4);
+        if (pps->picOrderPresentFlag && !slice.field_pic_flag) {
+            slice.delta_pic_order_cnt_bottom = parser.se();
+        }
+    } else if (sps->picOrderCntType == 1 && !sps->deltaPicOrderAlwaysZeroFlag) {
+        slice.delta_pic_order_cnt[0] = parser.se();
+        if (pps->picOrderPresentFlag && !slice.field_pic_flag) {
+            slice.delta_pic_order_cnt[1] = parser.se();
+        }
+    }
+    slice.complete = !parser.overrun();
+}
+
+/* Detection of the first VCL NAL unit of a primary coded picture,
+   H.264 7.4.1.2.4. The rules that need the slice header beyond
+   first_mb_in_slice are applied only when both slices could be parsed. */
+bool H264_Utils::is_first_slice_of_picture(const NALU &nal_unit,
+        const H264SliceInfo &slice)
+{
+    const H264SliceInfo &prv = m_prv_slice;
+
+    if ((!slice.first_mb_in_slice) ||
+            ( (m_prv_nalu.nal_ref_idc != nal_unit.nal_ref_idc) && ( nal_unit.nal_ref_idc * m_prv_nalu.nal_ref_idc == 0 ) ) ||
+            ( (m_prv_nalu.nalu_type != nal_unit.nalu_type ) && ((m_prv_nalu.nalu_type == NALU_TYPE_IDR) || (nal_unit.nalu_type == NALU_TYPE_IDR)) ) ) {
+        return true;
+    }
+    if (!slice.complete || !prv.complete) {
+        return false;
+    }
+    if ((slice.frame_num != prv.frame_num) ||
+            (slice.pic_parameter_set_id != prv.pic_parameter_set_id) ||
+            (slice.field_pic_flag != prv.field_pic_flag) ||
+            (slice.bottom_field_flag != prv.bottom_field_flag) ||
+            (slice.idr_pic_flag != prv.idr_pic_flag)) {
+        return true;
+    }
+    if (slice.idr_pic_flag && slice.idr_pic_id != prv.idr_pic_id) {
+        return true;
+    }
+    if (slice.pic_order_cnt_type != prv.pic_order_cnt_type) {
+        return false;
+    }
+    if (slice.pic_order_cnt_type == 0) {
+        return (slice.pic_order_cnt_lsb != prv.pic_order_cnt_lsb) ||
+            (slice.delta_pic_order_cnt_bottom != prv.delta_pic_order_cnt_bottom);
+    }
+    if (slice.pic_order_cnt_type == 1) {
+        return (slice.delta_pic_order_cnt[0] != prv.delta_pic_order_cnt[0]) ||
+            (slice.delta_pic_order_cnt[1] != prv.delta_pic_order_cnt[1]);
+    }
+    return false;
 }
 
 /*===========================================================================
@@ -358,75 +517,114 @@ bool H264_Utils::isNewFrame(OMX_BUFFERHEADERTYPE *p_buf_hdr,
         OMX_OUT OMX_BOOL &isNewFrame)
 {
     NALU nal_unit;
-    uint16 first_mb_in_slice = 0;
-    OMX_IN OMX_U32 numBytesInRBSP = 0;
+    OMX_U32 payload_offset = 0, payload_end = 0;
     OMX_IN OMX_U8 *buffer = p_buf_hdr->pBuffer;
     OMX_IN OMX_U32 buffer_length = p_buf_hdr->nFilledLen;
-    bool eRet = true;
 
     ALOGV("isNewFrame: buffer %p buffer_length %d "
             "size_of_nal_length_field %d", buffer, buffer_length,
             size_of_nal_length_field);
 
-    if ( false == extract_rbsp(buffer, buffer_length, size_of_nal_length_field,
-                m_rbspBytes, &numBytesInRBSP, &nal_unit) ) {
-        ALOGE("ERROR: In %s() - extract_rbsp() failed", __func__);
+    if ( false == locate_nal(buffer, buffer_length, size_of_nal_length_field,
+                &payload_offset, &payload_end, &nal_unit) ) {
+        ALOGE("ERROR: In %s() - locate_nal() failed", __func__);
         isNewFrame = OMX_FALSE;
-        eRet = false;
-    } else {
-        nalu_type = nal_unit.nalu_type;
-        switch (nal_unit.nalu_type) {
-            case NALU_TYPE_IDR:
-            case NALU_TYPE_NON_IDR: {
-                            ALOGV("AU Boundary with NAL type %d ",nal_unit.nalu_type);
-                            if (m_forceToStichNextNAL) {
-                                isNewFrame = OMX_FALSE;
-                            } else {
-                                RbspParser rbsp_parser(m_rbspBytes, (m_rbspBytes+numBytesInRBSP));
-                                first_mb_in_slice = rbsp_parser.ue();
-
-                                if ((!first_mb_in_slice) || /*(slice.prv_frame_num != slice.frame_num ) ||*/
-                                        ( (m_prv_nalu.nal_ref_idc != nal_unit.nal_ref_idc) && ( nal_unit.nal_ref_idc * m_prv_nalu.nal_ref_idc == 0 ) ) ||
-                                        /*( ((m_prv_nalu.nalu_type == NALU_TYPE_IDR) && (nal_unit.nalu_type == NALU_TYPE_IDR)) && (slice.idr_pic_id != slice.prv_idr_pic_id) ) || */
-                                        ( (m_prv_nalu.nalu_type != nal_unit.nalu_type ) && ((m_prv_nalu.nalu_type == NALU_TYPE_IDR) || (nal_unit.nalu_type == NALU_TYPE_IDR)) ) ) {
-                                    //ALOGV("Found a New Frame due to NALU_TYPE_IDR/NALU_TYPE_NON_IDR");
-                                    isNewFrame = OMX_TRUE;
-                                } else {
-                                    isNewFrame = OMX_FALSE;
-                                }
-                            }
-                            m_au_data = true;
-                            m_forceToStichNextNAL = false;
-                            break;
+        return false;
+    }
+    return this->isNewFrame(nal_unit, buffer + payload_offset,
+            payload_end - payload_offset, isNewFrame);
+}
+
+/*===========================================================================
+FUNCTION:
+H264_Utils::isNewFrame
+
+DESCRIPTION:
+Same as above for a NAL whose header was already read by the caller.
+
+INPUT/OUTPUT PARAMETERS:
+<In>
+nal_unit : decoded NAL header information
+payload : first byte after the NAL header
+payload_len : bytes available from payload, may stop short of the NAL end
+<out>
+isNewFrame: true if the NAL belongs to a differenet frame
+false if the NAL belongs to a current frame
+
+RETURN VALUE:
+boolean  true
+
+SIDE EFFECTS:
+None.
+===========================================================================*/
+bool H264_Utils::isNewFrame(OMX_IN const NALU &nal_unit,
+        OMX_IN const OMX_U8 *payload,
+        OMX_IN OMX_U32 payload_len,
+        OMX_OUT OMX_BOOL &isNewFrame)
+{
+    H264SliceInfo slice;
+    RbspParser rbsp_parser(payload, payload + payload_len);
+    param_set_key key;
+
+    nalu_type = nal_unit.nalu_type;
+    switch (nal_unit.nalu_type) {
+        case NALU_TYPE_IDR:
+        case NALU_TYPE_NON_IDR: {
+                        ALOGV("AU Boundary with NAL type %d ",nal_unit.nalu_type);
+                        parse_slice_header(rbsp_parser, nal_unit, slice);
+                        if (slice.complete &&
+                                (nal_unit.nalu_type == NALU_TYPE_IDR ||
+                                 m_active_sps == H264_MAX_SPS_COUNT)) {
+                            activate_sps(m_pps[slice.pic_parameter_set_id].seqSetID);
+                        }
+                        if (m_forceToStichNextNAL) {
+                            isNewFrame = OMX_FALSE;
+                        } else if (is_first_slice_of_picture(nal_unit, slice)) {
+                            //ALOGV("Found a New Frame due to NALU_TYPE_IDR/NALU_TYPE_NON_IDR");
+                            isNewFrame = OMX_TRUE;
+                        } else {
+                            isNewFrame = OMX_FALSE;
                         }
-            case NALU_TYPE_SPS:
-            case NALU_TYPE_PPS:
-            case NALU_TYPE_SEI: {
-                            ALOGV("Non-AU boundary with NAL type %d", nal_unit.nalu_type);
-                            if (m_au_data) {
-                                isNewFrame = OMX_TRUE;
-                                m_au_data = false;
-                            } else {
-                                isNewFrame =  OMX_FALSE;
+                        m_prv_slice = slice;
+                        m_au_data = true;
+                        m_forceToStichNextNAL = false;
+                        break;
+                    }
+        case NALU_TYPE_SPS:
+        case NALU_TYPE_PPS:
+        case NALU_TYPE_SEI: {
+                        ALOGV("Non-AU boundary with NAL type %d", nal_unit.nalu_type);
+                        if (nal_unit.nalu_type == NALU_TYPE_SPS) {
+                            // Repeats are identical to a stored SPS
+                            if (!m_param_sets.is_repeat(payload, payload_len, key)) {
+                                parse_sps(rbsp_parser, key);
                             }
-
-                            m_forceToStichNextNAL = true;
-                            break;
+                        } else if (nal_unit.nalu_type == NALU_TYPE_PPS) {
+                            parse_pps(rbsp_parser);
+                        }
+                        if (m_au_data) {
+                            isNewFrame = OMX_TRUE;
+                            m_au_data = false;
+                        } else {
+                            isNewFrame =  OMX_FALSE;
                         }
-            case NALU_TYPE_ACCESS_DELIM:
-            case NALU_TYPE_UNSPECIFIED:
-            case NALU_TYPE_EOSEQ:
-            case NALU_TYPE_EOSTREAM:
-            default: {
-                     isNewFrame =  OMX_FALSE;
-                     // Do not update m_forceToStichNextNAL
-                     break;
-                 }
-        } // end of switch
-    } // end of if
+
+                        m_forceToStichNextNAL = true;
+                        break;
+                    }
+        case NALU_TYPE_ACCESS_DELIM:
+        case NALU_TYPE_UNSPECIFIED:
+        case NALU_TYPE_EOSEQ:
+        case NALU_TYPE_EOSTREAM:
+        default: {
+                 isNewFrame =  OMX_FALSE;
+                 // Do not update m_forceToStichNextNAL
+                 break;
+             }
+    } // end of switch
     m_prv_nalu = nal_unit;
     ALOGV("get_h264_nal_type - newFrame value %d",isNewFrame);
-    return eRet;
+    return true;
 }
 
 void perf_metrics::start()
@@ -504,13 +702,8 @@ h264_stream_parser::~h264_stream_parser()
 
 void h264_stream_parser::reset()
 {
-    curr_32_bit = 0;
-    bits_read = 0;
-    zero_cntr = 0;
-    emulation_code_skip_cntr = 0;
     emulation_sc_enabled = true;
-    bitstream = NULL;
-    bitstream_bytes = 0;
+    init_bitstream(NULL, 0);
     memset(&vui_param, 0, sizeof(vui_param));
     vui_param.fixed_fps_prev_ts = LLONG_MAX;
     memset(&sei_buf_period, 0, sizeof(sei_buf_period));
@@ -518,16 +711,15 @@ void h264_stream_parser::reset()
     memset(&frame_packing_arrangement,0,sizeof(frame_packing_arrangement));
     frame_packing_arrangement.cancel_flag = 1;
     mbaff_flag = 0;
+    last_sps_valid = false;
 }
 
 void h264_stream_parser::init_bitstream(OMX_U8* data, OMX_U32 size)
 {
     bitstream = data;
     bitstream_bytes = size;
-    curr_32_bit = 0;
-    bits_read = 0;
-    zero_cntr = 0;
-    emulation_code_skip_cntr = 0;
+    rbsp_bits.init(data, size);
+    raw_bits.init(data, size);
 }
 
 void h264_stream_parser::parse_vui(bool vui_in_extradata)
@@ -719,9 +911,38 @@ void h264_stream_parser::hrd_parameters(h264_hrd_param *hrd_param)
     ALOGV("hrd_parameters: OUT");
 }
 
+/* Bytes of data that hold the first rbsp_bytes bytes of RBSP, and the
+   emulation prevention byte right after them if there is one. Only a zero
+   pair can come before one, so the bytes up to each zero are counted
+   without looking at them one by one. */
+static OMX_U32 rbsp_span(const OMX_U8 *data, OMX_U32 size, OMX_U32 rbsp_bytes)
+{
+    OMX_U32 pos = 0, n;
+    const OMX_U8 *zero;
+
+    while (rbsp_bytes && pos < size) {
+        n = STD_MIN(rbsp_bytes, size - pos);
+        zero = (const OMX_U8 *)memchr(data + pos, 0, n);
+        if (!zero)
+            return pos + n;
+        n = zero - (data + pos) + 1;
+        pos += n;
+        rbsp_bytes -= n;
+        if (pos == size || data[pos])
+            continue;
+        while (pos < size && !data[pos] && rbsp_bytes) {
+            pos++;
+            rbsp_bytes--;
+        }
+        if (pos < size && data[pos] == EMULATION_PREVENTION_THREE_BYTE)
+            pos++;
+    }
+    return pos;
+}
+
 void h264_stream_parser::parse_sei()
 {
-    OMX_U32 value = 0, processed_bytes = 0;
+    OMX_U32 value = 0, processed_bytes = 0, msg_bytes;
     OMX_U8 *sei_msg_start = bitstream;
     OMX_U32 sei_unit_size = bitstream_bytes;
     ALOGV("@@parse_sei: IN sei_unit_size(%u)", sei_unit_size);
@@ -729,16 +950,17 @@ void h264_stream_parser::parse_sei()
         init_bitstream(sei_msg_start + processed_bytes, sei_unit_size - processed_bytes);
         ALOGV("-->NALU_TYPE_SEI");
         OMX_U32 payload_type = 0, payload_size = 0, aux = 0;
+        msg_bytes = 0;
         do {
             value = extract_bits(8);
             payload_type += value;
-            processed_bytes++;
+            msg_bytes++;
         } while (value == 0xFF);
         ALOGV("-->payload_type   : %u", payload_type);
         do {
             value = extract_bits(8);
             payload_size += value;
-            processed_bytes++;
+            msg_bytes++;
         } while (value == 0xFF);
         ALOGV("-->payload_size   : %u", payload_size);
         if (payload_size > 0) {
@@ -759,7 +981,12 @@ void h264_stream_parser::parse_sei()
                     ALOGV("-->SEI payload type [%u] not implemented! size[%u]", payload_type, payload_size);
             }
         }
-        processed_bytes += (payload_size + emulation_code_skip_cntr);
+        // The reader caches ahead, so the emulation prevention bytes of
+        // this message are counted on the bytes themselves
+        msg_bytes += payload_size;
+        processed_bytes += emulation_sc_enabled ?
+            rbsp_span(sei_msg_start + processed_bytes,
+                    sei_unit_size - processed_bytes, msg_bytes) : msg_bytes;
         ALOGV("-->SEI processed_bytes[%u]", processed_bytes);
     }
     ALOGV("@@parse_sei: OUT");
@@ -1054,72 +1281,26 @@ void h264_stream_parser::scaling_list(OMX_U32 size_of_scaling_list)
 
 OMX_U32 h264_stream_parser::extract_bits(OMX_U32 n)
 {
-    OMX_U32 value = 0;
     if (n > 32) {
         ALOGE("ERROR: extract_bits limit to 32 bits!");
-        return value;
-    }
-    value = curr_32_bit >> (32 - n);
-    if (bits_read < n) {
-        n -= bits_read;
-        read_word();
-        value |= (curr_32_bit >> (32 - n));
-        if (bits_read < n) {
-            ALOGV("ERROR: extract_bits underflow!");
-            value >>= (n - bits_read);
-            n = bits_read;
-        }
+        return 0;
     }
-    bits_read -= n;
-    curr_32_bit <<= n;
-    return value;
-}
-
-void h264_stream_parser::read_word()
-{
-    curr_32_bit = 0;
-    bits_read = 0;
-    while (bitstream_bytes && bits_read < 32) {
-        if (*bitstream == EMULATION_PREVENTION_THREE_BYTE &&
-                zero_cntr >= 2 && emulation_sc_enabled) {
-            ALOGV("EMULATION_PREVENTION_THREE_BYTE: Skip 0x03 byte aligned!");
-            emulation_code_skip_cntr++;
-        } else {
-            curr_32_bit <<= 8;
-            curr_32_bit |= *bitstream;
-            bits_read += 8;
-        }
-        if (*bitstream == 0)
-            zero_cntr++;
-        else
-            zero_cntr = 0;
-        bitstream++;
-        bitstream_bytes--;
-    }
-    curr_32_bit <<= (32 - bits_read);
+    return emulation_sc_enabled ? rbsp_bits.read_bits(n) : raw_bits.read_bits(n);
 }
 
 OMX_U32 h264_stream_parser::uev()
 {
-    OMX_U32 lead_zero_bits = 0, code_num = 0;
-    while (!extract_bits(1) && more_bits())
-        lead_zero_bits++;
-    code_num = lead_zero_bits == 0 ? 0 :
-        (1 << lead_zero_bits) - 1 + extract_bits(lead_zero_bits);
-    return code_num;
+    return emulation_sc_enabled ? rbsp_bits.read_ue() : raw_bits.read_ue();
 }
 
 bool h264_stream_parser::more_bits()
 {
-    return (bitstream_bytes > 0 || bits_read > 0);
+    return emulation_sc_enabled ? rbsp_bits.more_data() : raw_bits.more_data();
 }
 
 OMX_S32 h264_stream_parser::sev()
 {
-    OMX_U32 code_num = uev();
-    OMX_S32 ret;
-    ret = (code_num + 1) >> 1;
-    return ((code_num & 1) ? ret : -ret);
+    return emulation_sc_enabled ? rbsp_bits.read_se() : raw_bits.read_se();
 }
 
 OMX_S32 h264_stream_parser::iv(OMX_U32 n_bits)
@@ -1272,7 +1453,7 @@ void h264_stream_parser::get_frame_pack_data(
 {
     ALOGV("%s:%d get frame data", __func__, __LINE__);
     memcpy(&frame_pack->id,&frame_packing_arrangement.id,
-            FRAME_PACK_SIZE*sizeof(OMX_U32));
+            sizeof(*frame_pack) - offsetof(OMX_QCOM_FRAME_PACK_ARRANGEMENT, id));
     return;
 }
 
@@ -1306,6 +1487,7 @@ void h264_stream_parser::parse_nal(OMX_U8* data_ptr, OMX_U32 data_len, OMX_U32 n
     }
     switch (nal_type) {
         case NALU_TYPE_SPS:
+            last_sps_valid = false;
             if (more_bits())
                 parse_sps();
 #ifdef PANSCAN_HDLR
@@ -1317,6 +1499,7 @@ void h264_stream_parser::parse_nal(OMX_U8* data_ptr, OMX_U32 data_len, OMX_U32 n
             parse_sei();
             break;
         case NALU_TYPE_VUI:
+            last_sps_valid = false;
             parse_vui(true);
             break;
         default:
@@ -1325,6 +1508,47 @@ void h264_stream_parser::parse_nal(OMX_U8* data_ptr, OMX_U32 data_len, OMX_U32 n
     ALOGV("parse_nal(): OUT");
 }
 
+/* For callers that already read the NAL header: payload starts right after
+   it. Only SPS, and SEI if sei_enabled, are parsed, other units are not
+   touched at all. */
+void h264_stream_parser::parse_nal_payload(OMX_U8* payload, OMX_U32 payload_len,
+        OMX_U32 nal_unit_type, bool sei_enabled)
+{
+    param_set_key key;
+
+    if (!payload_len)
+        return;
+    switch (nal_unit_type) {
+        case NALU_TYPE_SPS:
+            /* Parsing the SPS parsed last again would not change anything,
+               it is resent with every IDR in broadcast and HLS streams */
+            param_set_cache::make_key(payload, payload_len, key);
+            if (last_sps_valid && key.hash == last_sps.hash &&
+                    key.len == last_sps.len) {
+                ALOGV("SPS unchanged, not parsed again");
+            } else {
+                init_bitstream(payload, payload_len);
+                emulation_sc_enabled = true;
+                parse_sps();
+                last_sps = key;
+                last_sps_valid = true;
+            }
+#ifdef PANSCAN_HDLR
+            panscan_hdl->get_free();
+#endif
+            break;
+        case NALU_TYPE_SEI:
+            if (!sei_enabled)
+                break;
+            init_bitstream(payload, payload_len);
+            emulation_sc_enabled = true;
+            parse_sei();
+            break;
+        default:
+            break;
+    }
+}
+
 #ifdef PANSCAN_HDLR
 void h264_stream_parser::update_panscan_data(OMX_S64 timestamp)
 {
@@ -66,8 +66,16 @@ and other items needed by this module.
 
 ========================================================================== */
 
-HEVC_Utils::HEVC_Utils()
+/* No PPS is known, or a PPS refers to an invalid SPS */
+#define HEVC_NO_SPS 0xFF
+
+HEVC_Utils::HEVC_Utils():
+    m_sps_valid(0),
+    m_sps_updated(0),
+    m_active_sps(HEVC_MAX_SPS_COUNT),
+    m_stream_changes(0)
 {
+    memset(m_pps_sps_id, HEVC_NO_SPS, sizeof(m_pps_sps_id));
     initialize_frame_checking_environment();
 }
 
@@ -100,6 +108,151 @@ void HEVC_Utils::initialize_frame_checking_environment()
     nalu_type = NAL_UNIT_INVALID;
 }
 
+/* Reads the SPS up to the bit depths, HEVC 7.3.2.2. Everything in
+   profile_tier_level but the general profile and level is skipped. */
+void HEVC_Utils::parse_sps(const OMX_U8 *payload, OMX_U32 payload_len,
+        const param_set_key &key)
+{
+    bit_reader bits(payload, payload_len);
+    stream_params params;
+    uint32 max_sub_layers_minus1, sub_layer_flags = 0, id, i;
+    uint32 sub_width = 1, sub_height = 1, separate_colour_plane = 0;
+    uint32 left, right, top, bottom;
+
+    memset(&params, 0, sizeof(params));
+    bits.read_bits(4); // sps_video_parameter_set_id
+    max_sub_layers_minus1 = bits.read_bits(3);
+    bits.read_bits(1); // sps_temporal_id_nesting_flag
+
+    bits.read_bits(3); // general_profile_space, general_tier_flag
+    params.profile = bits.read_bits(5);
+    bits.skip_bits(32); // general_profile_compatibility_flag[32]
+    bits.read_bits(1); // general_progressive_source_flag
+    params.interlaced = bits.read_bits(1);
+    bits.skip_bits(46); // constraint flags and reserved bits
+    params.level = bits.read_bits(8);
+    for (i = 0; i < max_sub_layers_minus1; i++) {
+        sub_layer_flags = (sub_layer_flags << 2) | bits.read_bits(2);
+    }
+    if (max_sub_layers_minus1) {
+        bits.read_bits(2 * (8 - max_sub_layers_minus1)); // reserved_zero_2bits
+    }
+    for (i = max_sub_layers_minus1; i > 0; i--) {
+        if (sub_layer_flags & (2u << 2 * (i - 1))) {
+            bits.skip_bits(88); // sub_layer profile
+        }
+        if (sub_layer_flags & (1u << 2 * (i - 1))) {
+            bits.read_bits(8); // sub_layer_level_idc
+        }
+    }
+
+    id = bits.read_ue();
+    if (id >= HEVC_MAX_SPS_COUNT) {
+        DEBUG_PRINT_ERROR("ERROR: In %s() - invalid sps id %u", __func__, id);
+        return;
+    }
+    params.chroma_format = bits.read_ue();
+    if (params.chroma_format == 3) {
+        separate_colour_plane = bits.read_bits(1);
+    }
+    params.width = bits.read_ue();
+    params.height = bits.read_ue();
+    left = right = top = bottom = 0;
+    if (bits.read_bits(1)) { // conformance_window_flag
+        left = bits.read_ue();
+        right = bits.read_ue();
+        top = bits.read_ue();
+        bottom = bits.read_ue();
+    }
+    params.bit_depth_luma = bits.read_ue() + 8;
+    params.bit_depth_chroma = bits.read_ue() + 8;
+
+    // SubWidthC and SubHeightC, Table 6-1
+    if (!separate_colour_plane && params.chroma_format &&
+            params.chroma_format < 3) {
+        sub_width = 2;
+        sub_height = params.chroma_format == 1 ? 2 : 1;
+    }
+    if (!bits.overrun() && params.chroma_format <= 3 &&
+            params.bit_depth_luma <= 16 && params.bit_depth_chroma <= 16 &&
+            sub_width * (left + right) < params.width &&
+            sub_height * (top + bottom) < params.height) {
+        params.crop_left = sub_width * left;
+        params.crop_top = sub_height * top;
+        params.crop_width = params.width - sub_width * (left + right);
+        params.crop_height = params.height - sub_height * (top + bottom);
+        m_sps[id] = params;
+        m_sps_valid |= 1u << id;
+        m_sps_updated |= 1u << id;
+        m_param_sets.store(id, key);
+    } else {
+        DEBUG_PRINT_ERROR("ERROR: In %s() - corrupt sps %u", __func__, id);
+        m_sps_valid &= ~(1u << id);
+        m_param_sets.remove(id);
+    }
+}
+
+/* Only the SPS a PPS refers to is kept */
+void HEVC_Utils::parse_pps(const OMX_U8 *payload, OMX_U32 payload_len)
+{
+    bit_reader bits(payload, payload_len);
+    uint32 id, sps_id;
+
+    id = bits.read_ue();
+    sps_id = bits.read_ue();
+    if (id >= HEVC_MAX_PPS_COUNT) {
+        DEBUG_PRINT_ERROR("ERROR: In %s() - invalid pps id %u", __func__, id);
+        return;
+    }
+    m_pps_sps_id[id] = (!bits.overrun() && sps_id < HEVC_MAX_SPS_COUNT) ?
+        sps_id : HEVC_NO_SPS;
+}
+
+/* Activates the SPS of the first slice of an IRAP picture (HEVC 7.4.2.4.2),
+   or of the first slice decoded at all */
+void HEVC_Utils::parse_slice(const OMX_U8 *payload, OMX_U32 payload_len)
+{
+    bit_reader bits(payload, payload_len);
+    bool irap = nalu_type >= NAL_UNIT_CODED_SLICE_BLA &&
+        nalu_type <= NAL_UNIT_CODED_SLICE_CRA;
+    uint32 pps_id, sps_id;
+
+    if (!bits.read_bits(1) || // first_slice_segment_in_pic_flag
+            (!irap && m_active_sps != HEVC_MAX_SPS_COUNT)) {
+        return;
+    }
+    if (irap) {
+        bits.read_bits(1); // no_output_of_prior_pics_flag
+    }
+    pps_id = bits.read_ue();
+    if (bits.overrun() || pps_id >= HEVC_MAX_PPS_COUNT) {
+        return;
+    }
+    sps_id = m_pps_sps_id[pps_id];
+    if (sps_id != HEVC_NO_SPS && (m_sps_valid & (1u << sps_id))) {
+        activate_sps(sps_id);
+    }
+}
+
+void HEVC_Utils::activate_sps(uint32 id)
+{
+    if (id == m_active_sps && !(m_sps_updated & (1u << id))) {
+        return;
+    }
+    m_active_sps = id;
+    m_sps_updated &= ~(1u << id);
+    m_stream_changes |= m_param_sets.update_stream(m_sps[id]);
+}
+
+OMX_U32 HEVC_Utils::stream_change(stream_params &params)
+{
+    OMX_U32 changes = m_stream_changes;
+
+    m_stream_changes = 0;
+    params = m_param_sets.stream();
+    return changes;
+}
+
 /*===========================================================================
 FUNCTION:
 HEVC_Utils::iSNewFrame
@@ -131,7 +284,6 @@ bool HEVC_Utils::isNewFrame(OMX_BUFFERHEADERTYPE *p_buf_hdr,
 {
     OMX_IN OMX_U8 *buffer = p_buf_hdr->pBuffer;
     OMX_IN OMX_U32 buffer_length = p_buf_hdr->nFilledLen;
-    byte bFirstSliceInPic = 0;
 
     byte coef1=1, coef2=0, coef3=0;
     uint32 pos = 0;
@@ -181,12 +333,59 @@ bool HEVC_Utils::isNewFrame(OMX_BUFFERHEADERTYPE *p_buf_hdr,
         return false;
     }
 
-    nalu_type = (buffer[pos] & 0x7E)>>1 ;      //=== nal_unit_type
+    DEBUG_PRINT_LOW("@#@# Pos = %x NalType = %x buflen = %u", pos-1,
+            (buffer[pos] & 0x7E)>>1, (unsigned int) buffer_length);
 
-    DEBUG_PRINT_LOW("@#@# Pos = %x NalType = %x buflen = %u", pos-1, nalu_type, (unsigned int) buffer_length);
+    return this->isNewFrame((buffer[pos] & 0x7E)>>1, buffer + pos + 2,
+            nal_len + sizeofNalLengthField - (pos + 2), isNewFrame);
+}
 
+/*===========================================================================
+FUNCTION:
+HEVC_Utils::isNewFrame
+
+DESCRIPTION:
+Same as above for a NAL whose header was already read by the caller.
+
+INPUT/OUTPUT PARAMETERS:
+<In>
+nal_unit_type : nal_unit_type from the NAL header
+payload : first byte after the two byte NAL header
+payload_len : bytes available from payload
+<out>
+isNewFrame: true if the NAL belongs to a differenet frame
+false if the NAL belongs to a current frame
+
+RETURN VALUE:
+boolean  true
+
+SIDE EFFECTS:
+None.
+===========================================================================*/
+bool HEVC_Utils::isNewFrame(OMX_IN OMX_U32 nal_unit_type,
+        OMX_IN const OMX_U8 *payload,
+        OMX_IN OMX_U32 payload_len,
+        OMX_OUT OMX_BOOL &isNewFrame)
+{
+    byte bFirstSliceInPic = 0;
+    param_set_key key;
+
+    nalu_type = nal_unit_type;
     isNewFrame =  OMX_FALSE;
 
+    if (nalu_type == NAL_UNIT_SPS) {
+        // Repeats are identical to a stored SPS
+        if (!m_param_sets.is_repeat(payload, payload_len, key)) {
+            parse_sps(payload, payload_len, key);
+        }
+    } else if (nalu_type == NAL_UNIT_PPS) {
+        parse_pps(payload, payload_len);
+    } else if ((nalu_type <= NAL_UNIT_CODED_SLICE_TFD ||
+                (nalu_type >= NAL_UNIT_CODED_SLICE_BLA &&
+                 nalu_type <= NAL_UNIT_CODED_SLICE_CRA)) && payload_len) {
+        parse_slice(payload, payload_len);
+    }
+
     if (nalu_type == NAL_UNIT_VPS ||
             nalu_type == NAL_UNIT_SPS ||
             nalu_type == NAL_UNIT_PPS ||
@@ -202,8 +401,8 @@ bool HEVC_Utils::isNewFrame(OMX_BUFFERHEADERTYPE *p_buf_hdr,
     } else if (nalu_type <= NAL_UNIT_RESERVED_23) {
         DEBUG_PRINT_LOW("AU Boundary with NAL type %d ", nalu_type);
 
-        if (!m_forceToStichNextNAL) {
-            bFirstSliceInPic = ((buffer[pos+2] & 0x80)>>7);
+        if (!m_forceToStichNextNAL && payload_len) {
+            bFirstSliceInPic = ((payload[0] & 0x80)>>7);
 
             if (bFirstSliceInPic) {    //=== first_ctb_in_slice is only 1'b1  coded tree block
                 DEBUG_PRINT_LOW("Found a New Frame due to 1st coded tree block");
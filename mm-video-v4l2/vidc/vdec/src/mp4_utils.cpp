@@ -47,24 +47,6 @@ MP4_Utils::~MP4_Utils()
 {
 }
 
-uint32 MP4_Utils::read_bit_field(posInfoType * posPtr, uint32 size)
-{
-    uint8 *bits = &posPtr->bytePtr[0];
-    uint32 bitBuf =
-        (bits[0] << 24) | (bits[1] << 16) | (bits[2] << 8) | bits[3];
-
-    uint32 value = (bitBuf >> (32 - posPtr->bitPos - size)) & MASK(size);
-
-    /* Update the offset in preparation for next field    */
-    posPtr->bitPos += size;
-
-    while (posPtr->bitPos >= 8) {
-        posPtr->bitPos -= 8;
-        posPtr->bytePtr++;
-    }
-
-    return value;
-}
     static uint8 *find_code
 (uint8 * bytePtr, uint32 size, uint32 codeMask, uint32 referenceCode)
 {
@@ -87,64 +69,59 @@ bool MP4_Utils::parseHeader(mp4StreamType * psBits)
     uint32 profile_and_level_indication = 0;
     uint8 VerID = 1; /* default value */
     long hxw = 0;
+    uint8 *pos;
+    uint8 *end = psBits->data + psBits->numBytes;
 
-    m_posInfo.bitPos = 0;
-    m_posInfo.bytePtr = psBits->data;
     m_dataBeginPtr = psBits->data;
 
-    m_posInfo.bytePtr = find_code(m_posInfo.bytePtr,4,
+    pos = find_code(psBits->data,4,
             MASK(32),VOP_START_CODE);
 
-    if (m_posInfo.bytePtr) {
+    if (pos) {
         return false;
     }
 
-    m_posInfo.bitPos = 0;
-    m_posInfo.bytePtr = psBits->data;
-    m_dataBeginPtr = psBits->data;
-    m_posInfo.bytePtr = find_code(m_posInfo.bytePtr,4,
+    pos = find_code(psBits->data,4,
             MASK(32),GOV_START_CODE);
 
-    if (m_posInfo.bytePtr) {
+    if (pos) {
         return false;
     }
 
-    m_posInfo.bitPos = 0;
-    m_posInfo.bytePtr = psBits->data;
-    m_dataBeginPtr = psBits->data;
     /* parsing Visual Object Seqence(VOS) header */
-    m_posInfo.bytePtr = find_code(m_posInfo.bytePtr,
+    pos = find_code(psBits->data,
             psBits->numBytes,
             MASK(32),
             VISUAL_OBJECT_SEQUENCE_START_CODE);
 
-    if ( m_posInfo.bytePtr == NULL ) {
-        m_posInfo.bitPos  = 0;
-        m_posInfo.bytePtr = psBits->data;
+    if ( pos == NULL ) {
+        pos = psBits->data;
     } else {
-        uint32 profile_and_level_indication = read_bit_field (&m_posInfo, 8);
+        m_bits.init(pos, end - pos);
+        uint32 profile_and_level_indication = m_bits.read_bits(8);
+        pos = (uint8 *)m_bits.byte_position();
     }
 
     /* parsing Visual Object(VO) header*/
     /* note: for now, we skip over the user_data */
-    m_posInfo.bytePtr = find_code(m_posInfo.bytePtr,psBits->numBytes,
+    pos = find_code(pos,end - pos,
             MASK(32),VISUAL_OBJECT_START_CODE);
 
-    if (m_posInfo.bytePtr == NULL) {
-        m_posInfo.bitPos = 0;
-        m_posInfo.bytePtr = psBits->data;
+    if (pos == NULL) {
+        pos = psBits->data;
     } else {
-        uint32 is_visual_object_identifier = read_bit_field (&m_posInfo, 1);
+        m_bits.init(pos, end - pos);
+        uint32 is_visual_object_identifier = m_bits.read_bits(1);
 
         if ( is_visual_object_identifier ) {
             /* visual_object_verid*/
-            read_bit_field (&m_posInfo, 4);
+            m_bits.read_bits(4);
             /* visual_object_priority*/
-            read_bit_field (&m_posInfo, 3);
+            m_bits.read_bits(3);
         }
 
         /* visual_object_type*/
-        uint32 visual_object_type = read_bit_field (&m_posInfo, 4);
+        uint32 visual_object_type = m_bits.read_bits(4);
 
         if ( visual_object_type != VISUAL_OBJECT_TYPE_VIDEO_ID ) {
             return false;
@@ -152,30 +129,30 @@ bool MP4_Utils::parseHeader(mp4StreamType * psBits)
 
         /* skipping video_signal_type params*/
         /*parsing Video Object header*/
-        m_posInfo.bytePtr = find_code(m_posInfo.bytePtr,psBits->numBytes,
+        pos = (uint8 *)m_bits.byte_position();
+        pos = find_code(pos,end - pos,
                 VIDEO_OBJECT_START_CODE_MASK,VIDEO_OBJECT_START_CODE);
 
-        if ( m_posInfo.bytePtr == NULL ) {
+        if ( pos == NULL ) {
             return false;
         }
     }
 
     /* parsing Video Object Layer(VOL) header */
-    m_posInfo.bitPos = 0;
-    m_posInfo.bytePtr = find_code(m_posInfo.bytePtr,
-            psBits->numBytes,
+    pos = find_code(pos,
+            end - pos,
             VIDEO_OBJECT_LAYER_START_CODE_MASK,
             VIDEO_OBJECT_LAYER_START_CODE);
 
-    if ( m_posInfo.bytePtr == NULL ) {
-        m_posInfo.bitPos = 0;
-        m_posInfo.bytePtr = psBits->data;
+    if ( pos == NULL ) {
+        pos = psBits->data;
     }
+    m_bits.init(pos, end - pos);
 
     // 1 -> random accessible VOL
-    read_bit_field(&m_posInfo, 1);
+    m_bits.read_bits(1);
 
-    uint32 video_object_type_indication = read_bit_field (&m_posInfo, 8);
+    uint32 video_object_type_indication = m_bits.read_bits(8);
 
     if ( (video_object_type_indication != SIMPLE_OBJECT_TYPE) &&
             (video_object_type_indication != SIMPLE_SCALABLE_OBJECT_TYPE) &&
@@ -187,52 +164,52 @@ bool MP4_Utils::parseHeader(mp4StreamType * psBits)
     }
 
     /* is_object_layer_identifier*/
-    uint32 is_object_layer_identifier = read_bit_field (&m_posInfo, 1);
+    uint32 is_object_layer_identifier = m_bits.read_bits(1);
 
     if (is_object_layer_identifier) {
-        uint32 video_object_layer_verid = read_bit_field (&m_posInfo, 4);
-        uint32 video_object_layer_priority = read_bit_field (&m_posInfo, 3);
+        uint32 video_object_layer_verid = m_bits.read_bits(4);
+        uint32 video_object_layer_priority = m_bits.read_bits(3);
         VerID = (unsigned char)video_object_layer_verid;
     }
 
     /* aspect_ratio_info*/
-    uint32 aspect_ratio_info = read_bit_field (&m_posInfo, 4);
+    uint32 aspect_ratio_info = m_bits.read_bits(4);
 
     if ( aspect_ratio_info == EXTENDED_PAR ) {
         /* par_width*/
-        read_bit_field (&m_posInfo, 8);
+        m_bits.read_bits(8);
         /* par_height*/
-        read_bit_field (&m_posInfo, 8);
+        m_bits.read_bits(8);
     }
 
     /* vol_control_parameters */
-    uint32 vol_control_parameters = read_bit_field (&m_posInfo, 1);
+    uint32 vol_control_parameters = m_bits.read_bits(1);
 
     if ( vol_control_parameters ) {
         /* chroma_format*/
-        uint32 chroma_format = read_bit_field (&m_posInfo, 2);
+        uint32 chroma_format = m_bits.read_bits(2);
 
         if ( chroma_format != 1 ) {
             return false;
         }
 
         /* low_delay*/
-        uint32 low_delay = read_bit_field (&m_posInfo, 1);
+        uint32 low_delay = m_bits.read_bits(1);
         /* vbv_parameters (annex D)*/
-        uint32 vbv_parameters = read_bit_field (&m_posInfo, 1);
+        uint32 vbv_parameters = m_bits.read_bits(1);
 
         if ( vbv_parameters ) {
             /* first_half_bitrate*/
-            uint32 first_half_bitrate = read_bit_field (&m_posInfo, 15);
-            uint32 marker_bit = read_bit_field (&m_posInfo, 1);
+            uint32 first_half_bitrate = m_bits.read_bits(15);
+            uint32 marker_bit = m_bits.read_bits(1);
 
             if ( marker_bit != 1) {
                 return false;
             }
 
             /* latter_half_bitrate*/
-            uint32 latter_half_bitrate = read_bit_field (&m_posInfo, 15);
-            marker_bit = read_bit_field (&m_posInfo, 1);
+            uint32 latter_half_bitrate = m_bits.read_bits(15);
+            marker_bit = m_bits.read_bits(1);
 
             if ( marker_bit != 1) {
                 return false;
@@ -240,27 +217,27 @@ bool MP4_Utils::parseHeader(mp4StreamType * psBits)
 
             uint32 VBVPeakBitRate = (first_half_bitrate << 15) + latter_half_bitrate;
             /* first_half_vbv_buffer_size*/
-            uint32 first_half_vbv_buffer_size = read_bit_field (&m_posInfo, 15);
-            marker_bit = read_bit_field (&m_posInfo, 1);
+            uint32 first_half_vbv_buffer_size = m_bits.read_bits(15);
+            marker_bit = m_bits.read_bits(1);
 
             if ( marker_bit != 1) {
                 return false;
             }
 
             /* latter_half_vbv_buffer_size*/
-            uint32 latter_half_vbv_buffer_size = read_bit_field (&m_posInfo, 3);
+            uint32 latter_half_vbv_buffer_size = m_bits.read_bits(3);
             uint32 VBVBufferSize = (first_half_vbv_buffer_size << 3) + latter_half_vbv_buffer_size;
             /* first_half_vbv_occupancy*/
-            uint32 first_half_vbv_occupancy = read_bit_field (&m_posInfo, 11);
-            marker_bit = read_bit_field (&m_posInfo, 1);
+            uint32 first_half_vbv_occupancy = m_bits.read_bits(11);
+            marker_bit = m_bits.read_bits(1);
 
             if ( marker_bit != 1) {
                 return false;
             }
 
             /* latter_half_vbv_occupancy*/
-            uint32 latter_half_vbv_occupancy = read_bit_field (&m_posInfo, 15);
-            marker_bit = read_bit_field (&m_posInfo, 1);
+            uint32 latter_half_vbv_occupancy = m_bits.read_bits(15);
+            marker_bit = m_bits.read_bits(1);
 
             if ( marker_bit != 1) {
                 return false;
@@ -269,7 +246,7 @@ bool MP4_Utils::parseHeader(mp4StreamType * psBits)
     }/*vol_control_parameters*/
 
     /* video_object_layer_shape*/
-    uint32 video_object_layer_shape = read_bit_field (&m_posInfo, 2);
+    uint32 video_object_layer_shape = m_bits.read_bits(2);
     uint8 VOLShape = (unsigned char)video_object_layer_shape;
 
     if ( VOLShape != MPEG4_SHAPE_RECTANGULAR ) {
@@ -277,14 +254,14 @@ bool MP4_Utils::parseHeader(mp4StreamType * psBits)
     }
 
     /* marker_bit*/
-    uint32 marker_bit = read_bit_field (&m_posInfo, 1);
+    uint32 marker_bit = m_bits.read_bits(1);
 
     if ( marker_bit != 1 ) {
         return false;
     }
 
     /* vop_time_increment_resolution*/
-    uint32 vop_time_increment_resolution = read_bit_field (&m_posInfo, 16);
+    uint32 vop_time_increment_resolution = m_bits.read_bits(16);
     vop_time_resolution = vop_time_increment_resolution;
     vop_time_found = true;
     return true;
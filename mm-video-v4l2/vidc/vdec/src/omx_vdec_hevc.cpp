@@ -262,8 +262,6 @@ void* async_message_thread (void *input)
 void* message_thread(void *input)
 {
     omx_vdec* omx = reinterpret_cast<omx_vdec*>(input);
-    unsigned char id;
-    int n;
     if (omx == NULL) {
         DEBUG_PRINT_ERROR("message thread null pointer rxd");
         return NULL;
@@ -271,21 +269,8 @@ void* message_thread(void *input)
 
     DEBUG_PRINT_HIGH("omx_vdec: message thread start");
     prctl(PR_SET_NAME, (unsigned long)"VideoDecMsgThread", 0, 0, 0);
-    while (1) {
-
-        n = read(omx->m_pipe_in, &id, 1);
-
-        if (0 == n) {
-            break;
-        }
-
-        if (1 == n) {
-            omx->process_event_cb(omx, id);
-        }
-        if ((n < 0) && (errno != EINTR)) {
-            DEBUG_PRINT_LOW("ERROR: read from pipe failed, ret %d errno %d", n, errno);
-            break;
-        }
+    while (omx->m_msg_notifier.wait()) {
+        omx->process_event_cb(omx, 0);
     }
     DEBUG_PRINT_HIGH("omx_vdec: message thread stop");
     return NULL;
@@ -293,15 +278,14 @@ void* message_thread(void *input)
 
 void post_message(omx_vdec *omx, unsigned char id)
 {
-    int ret_value;
+    bool woken;
 
     if (omx == NULL) {
         DEBUG_PRINT_ERROR("message thread null pointer rxd");
         return;
     }
-    DEBUG_PRINT_LOW("omx_vdec: post_message %d pipe out%d", id,omx->m_pipe_out);
-    ret_value = write(omx->m_pipe_out, &id, 1);
-    DEBUG_PRINT_LOW("post_message to pipe done %d",ret_value);
+    woken = omx->m_msg_notifier.notify();
+    DEBUG_PRINT_LOW("omx_vdec: post_message %d wake %d", id, woken);
 }
 
 // omx_cmd_queue destructor
@@ -362,95 +346,6 @@ unsigned omx_vdec::omx_cmd_queue::get_q_msg_type()
     return m_q[m_read].id;
 }
 
-#ifdef _ANDROID_
-omx_vdec::ts_arr_list::ts_arr_list()
-{
-    //initialize timestamps array
-    memset(m_ts_arr_list, 0, sizeof(m_ts_arr_list) );
-}
-omx_vdec::ts_arr_list::~ts_arr_list()
-{
-    //free m_ts_arr_list?
-}
-
-bool omx_vdec::ts_arr_list::insert_ts(OMX_TICKS ts)
-{
-    bool ret = true;
-    bool duplicate_ts = false;
-    int idx = 0;
-
-    //insert at the first available empty location
-    for ( ; idx < MAX_NUM_INPUT_OUTPUT_BUFFERS; idx++) {
-        if (!m_ts_arr_list[idx].valid) {
-            //found invalid or empty entry, save timestamp
-            m_ts_arr_list[idx].valid = true;
-            m_ts_arr_list[idx].timestamp = ts;
-            DEBUG_PRINT_LOW("Insert_ts(): Inserting TIMESTAMP (%lld) at idx (%d)",
-                    ts, idx);
-            break;
-        }
-    }
-
-    if (idx == MAX_NUM_INPUT_OUTPUT_BUFFERS) {
-        DEBUG_PRINT_LOW("Timestamp array list is FULL. Unsuccessful insert");
-        ret = false;
-    }
-    return ret;
-}
-
-bool omx_vdec::ts_arr_list::pop_min_ts(OMX_TICKS &ts)
-{
-    bool ret = true;
-    int min_idx = -1;
-    OMX_TICKS min_ts = 0;
-    int idx = 0;
-
-    for ( ; idx < MAX_NUM_INPUT_OUTPUT_BUFFERS; idx++) {
-
-        if (m_ts_arr_list[idx].valid) {
-            //found valid entry, save index
-            if (min_idx < 0) {
-                //first valid entry
-                min_ts = m_ts_arr_list[idx].timestamp;
-                min_idx = idx;
-            } else if (m_ts_arr_list[idx].timestamp < min_ts) {
-                min_ts = m_ts_arr_list[idx].timestamp;
-                min_idx = idx;
-            }
-        }
-
-    }
-
-    if (min_idx < 0) {
-        //no valid entries found
-        DEBUG_PRINT_LOW("Timestamp array list is empty. Unsuccessful pop");
-        ts = 0;
-        ret = false;
-    } else {
-        ts = m_ts_arr_list[min_idx].timestamp;
-        m_ts_arr_list[min_idx].valid = false;
-        DEBUG_PRINT_LOW("Pop_min_ts:Timestamp (%lld), index(%d)",
-                ts, min_idx);
-    }
-
-    return ret;
-
-}
-
-
-bool omx_vdec::ts_arr_list::reset_ts_list()
-{
-    bool ret = true;
-    int idx = 0;
-
-    DEBUG_PRINT_LOW("reset_ts_list(): Resetting timestamp array list");
-    for ( ; idx < MAX_NUM_INPUT_OUTPUT_BUFFERS; idx++) {
-        m_ts_arr_list[idx].valid = false;
-    }
-    return ret;
-}
-#endif
-
 // factory function executed by the core to create instances
 void *get_omx_component_factory_fn(void)
 {
@@ -523,17 +418,12 @@ omx_vdec::omx_vdec(): m_error_propogated(false),
     m_heap_inp_bm_count (0),
     codec_type_parse ((codec_type)0),
     first_frame_meta (true),
-    frame_count (0),
-    nal_count (0),
     nal_length(0),
-    look_ahead_nal (false),
     first_frame(0),
     first_buffer(NULL),
     first_frame_size (0),
     m_device_file_ptr(NULL),
     m_vc1_profile((vc1_profile_type)0),
-    h264_last_au_ts(LLONG_MAX),
-    h264_last_au_flags(0),
     prev_ts(LLONG_MAX),
     rst_prev_ts(true),
     frm_int(0),
@@ -582,7 +472,6 @@ omx_vdec::omx_vdec(): m_error_propogated(false),
     memset(&m_cmp,0,sizeof(m_cmp));
     memset(&m_cb,0,sizeof(m_cb));
     memset (&drv_ctx,0,sizeof(drv_ctx));
-    memset (&h264_scratch,0,sizeof (OMX_BUFFERHEADERTYPE));
     memset (m_hwdevice_name,0,sizeof(m_hwdevice_name));
     memset(m_demux_offsets, 0, sizeof(m_demux_offsets) );
     m_demux_entries = 0;
@@ -691,10 +580,7 @@ omx_vdec::~omx_vdec()
     m_pmem_info = NULL;
     struct v4l2_decoder_cmd dec;
     DEBUG_PRINT_HIGH("In OMX vdec Destructor");
-    if (m_pipe_in) close(m_pipe_in);
-    if (m_pipe_out) close(m_pipe_out);
-    m_pipe_in = -1;
-    m_pipe_out = -1;
+    m_msg_notifier.stop();
     DEBUG_PRINT_HIGH("Waiting on OMX Msg Thread exit");
     pthread_join(msg_thread_id,NULL);
     DEBUG_PRINT_HIGH("Waiting on OMX Async Thread exit");
@@ -1238,7 +1124,6 @@ OMX_ERRORTYPE omx_vdec::component_init(OMX_STRING role)
     struct v4l2_requestbuffers bufreq;
     struct v4l2_control control;
     unsigned int   alignment = 0,buffer_size = 0;
-    int fds[2];
     int r,ret=0;
     bool codec_ambiguous = false;
     OMX_STRING device_name = (OMX_STRING)DEVICE_NAME;
@@ -1289,7 +1174,7 @@ OMX_ERRORTYPE omx_vdec::component_init(OMX_STRING role)
         output_capability=V4L2_PIX_FMT_MPEG4;
         /*Initialize Start Code for MPEG4*/
         codec_type_parse = CODEC_TYPE_MPEG4;
-        m_frame_parser.init_start_codes (codec_type_parse);
+        m_au_assembler.init(codec_type_parse, this);
 #ifdef INPUT_BUFFER_LOG
         strcat(inputfilename, "m4v");
 #endif
@@ -1302,7 +1187,7 @@ OMX_ERRORTYPE omx_vdec::component_init(OMX_STRING role)
         eCompressionFormat = OMX_VIDEO_CodingMPEG2;
         /*Initialize Start Code for MPEG2*/
         codec_type_parse = CODEC_TYPE_MPEG2;
-        m_frame_parser.init_start_codes (codec_type_parse);
+        m_au_assembler.init(codec_type_parse, this);
 #ifdef INPUT_BUFFER_LOG
         strcat(inputfilename, "mpg");
 #endif
@@ -1314,7 +1199,7 @@ OMX_ERRORTYPE omx_vdec::component_init(OMX_STRING role)
         eCompressionFormat = OMX_VIDEO_CodingH263;
         output_capability = V4L2_PIX_FMT_H263;
         codec_type_parse = CODEC_TYPE_H263;
-        m_frame_parser.init_start_codes (codec_type_parse);
+        m_au_assembler.init(codec_type_parse, this);
 #ifdef INPUT_BUFFER_LOG
         strcat(inputfilename, "263");
 #endif
@@ -1326,7 +1211,7 @@ OMX_ERRORTYPE omx_vdec::component_init(OMX_STRING role)
         output_capability = V4L2_PIX_FMT_DIVX_311;
         eCompressionFormat = (OMX_VIDEO_CODINGTYPE)QOMX_VIDEO_CodingDivx;
         codec_type_parse = CODEC_TYPE_DIVX;
-        m_frame_parser.init_start_codes (codec_type_parse);
+        m_au_assembler.init(codec_type_parse, this);
 
         eRet = createDivxDrmContext();
         if (eRet != OMX_ErrorNone) {
@@ -1342,7 +1227,7 @@ OMX_ERRORTYPE omx_vdec::component_init(OMX_STRING role)
         eCompressionFormat = (OMX_VIDEO_CODINGTYPE)QOMX_VIDEO_CodingDivx;
         codec_type_parse = CODEC_TYPE_DIVX;
         codec_ambiguous = true;
-        m_frame_parser.init_start_codes (codec_type_parse);
+        m_au_assembler.init(codec_type_parse, this);
 
         eRet = createDivxDrmContext();
         if (eRet != OMX_ErrorNone) {
@@ -1358,7 +1243,7 @@ OMX_ERRORTYPE omx_vdec::component_init(OMX_STRING role)
         eCompressionFormat = (OMX_VIDEO_CODINGTYPE)QOMX_VIDEO_CodingDivx;
         codec_type_parse = CODEC_TYPE_DIVX;
         codec_ambiguous = true;
-        m_frame_parser.init_start_codes (codec_type_parse);
+        m_au_assembler.init(codec_type_parse, this);
 
         eRet = createDivxDrmContext();
         if (eRet != OMX_ErrorNone) {
@@ -1373,8 +1258,7 @@ OMX_ERRORTYPE omx_vdec::component_init(OMX_STRING role)
         output_capability=V4L2_PIX_FMT_H264;
         eCompressionFormat = OMX_VIDEO_CodingAVC;
         codec_type_parse = CODEC_TYPE_H264;
-        m_frame_parser.init_start_codes (codec_type_parse);
-        m_frame_parser.init_nal_length(nal_length);
+        m_au_assembler.init(codec_type_parse, this);
 #ifdef INPUT_BUFFER_LOG
         strcat(inputfilename, "264");
 #endif
@@ -1385,8 +1269,7 @@ OMX_ERRORTYPE omx_vdec::component_init(OMX_STRING role)
         output_capability=V4L2_PIX_FMT_HEVC;
         eCompressionFormat = (OMX_VIDEO_CODINGTYPE)QOMX_VIDEO_CodingHevc;
         codec_type_parse = CODEC_TYPE_HEVC;
-        m_frame_parser.init_start_codes (codec_type_parse);
-        m_frame_parser.init_nal_length(nal_length);
+        m_au_assembler.init(codec_type_parse, this);
 #ifdef INPUT_BUFFER_LOG
         strcat(inputfilename, "265");
 #endif
@@ -1397,7 +1280,7 @@ OMX_ERRORTYPE omx_vdec::component_init(OMX_STRING role)
         eCompressionFormat = OMX_VIDEO_CodingWMV;
         codec_type_parse = CODEC_TYPE_VC1;
         output_capability = V4L2_PIX_FMT_VC1_ANNEX_G;
-        m_frame_parser.init_start_codes (codec_type_parse);
+        m_au_assembler.init(codec_type_parse, this);
 #ifdef INPUT_BUFFER_LOG
         strcat(inputfilename, "vc1");
 #endif
@@ -1408,7 +1291,7 @@ OMX_ERRORTYPE omx_vdec::component_init(OMX_STRING role)
         eCompressionFormat = OMX_VIDEO_CodingWMV;
         codec_type_parse = CODEC_TYPE_VC1;
         output_capability = V4L2_PIX_FMT_VC1_ANNEX_L;
-        m_frame_parser.init_start_codes (codec_type_parse);
+        m_au_assembler.init(codec_type_parse, this);
 #ifdef INPUT_BUFFER_LOG
         strcat(inputfilename, "vc1");
 #endif
@@ -1552,30 +1435,13 @@ OMX_ERRORTYPE omx_vdec::component_init(OMX_STRING role)
         get_buffer_req(&drv_ctx.op_buf);
         if (drv_ctx.decoder_format == VDEC_CODECTYPE_H264 ||
                 drv_ctx.decoder_format == VDEC_CODECTYPE_HEVC) {
-            h264_scratch.nAllocLen = drv_ctx.ip_buf.buffer_size;
-            h264_scratch.pBuffer = (OMX_U8 *)malloc (drv_ctx.ip_buf.buffer_size);
-            h264_scratch.nFilledLen = 0;
-            h264_scratch.nOffset = 0;
-
-            if (h264_scratch.pBuffer == NULL) {
-                DEBUG_PRINT_ERROR("h264_scratch.pBuffer Allocation failed ");
+            if (!m_au_assembler.allocate(drv_ctx.ip_buf.buffer_size)) {
+                DEBUG_PRINT_ERROR("AU assembler allocation failed ");
                 return OMX_ErrorInsufficientResources;
             }
         }
 
         if (drv_ctx.decoder_format == VDEC_CODECTYPE_H264) {
-            if (m_frame_parser.mutils == NULL) {
-                m_frame_parser.mutils = new H264_Utils();
-
-                if (m_frame_parser.mutils == NULL) {
-                    DEBUG_PRINT_ERROR("parser utils Allocation failed ");
-                    eRet = OMX_ErrorInsufficientResources;
-                } else {
-                    m_frame_parser.mutils->initialize_frame_checking_environment();
-                    m_frame_parser.mutils->allocate_rbsp_buffer (drv_ctx.ip_buf.buffer_size);
-                }
-            }
-
             h264_parser = new h264_stream_parser();
             if (!h264_parser) {
                 DEBUG_PRINT_ERROR("ERROR: H264 parser allocation failed!");
@@ -1583,23 +1449,10 @@ OMX_ERRORTYPE omx_vdec::component_init(OMX_STRING role)
             }
         }
 
-        if (pipe(fds)) {
-            DEBUG_PRINT_ERROR("pipe creation failed");
+        if (!m_msg_notifier.init()) {
+            DEBUG_PRINT_ERROR("eventfd creation failed");
             eRet = OMX_ErrorInsufficientResources;
         } else {
-            int temp1[2];
-            if (fds[0] == 0 || fds[1] == 0) {
-                if (pipe (temp1)) {
-                    DEBUG_PRINT_ERROR("pipe creation failed");
-                    return OMX_ErrorInsufficientResources;
-                }
-                //close (fds[0]);
-                //close (fds[1]);
-                fds[0] = temp1 [0];
-                fds[1] = temp1 [1];
-            }
-            m_pipe_in = fds[0];
-            m_pipe_out = fds[1];
             r = pthread_create(&msg_thread_id,0,message_thread,this);
 
             if (r < 0) {
@@ -2259,18 +2112,9 @@ bool omx_vdec::execute_input_flush()
     /*Check if Heap Buffers are to be flushed*/
     if (arbitrary_bytes && !(codec_config_flag)) {
         DEBUG_PRINT_LOW("Reset all the variables before flusing");
-        h264_scratch.nFilledLen = 0;
-        nal_count = 0;
-        look_ahead_nal = false;
-        frame_count = 0;
-        h264_last_au_ts = LLONG_MAX;
-        h264_last_au_flags = 0;
+        m_au_assembler.reset();
         memset(m_demux_offsets, 0, ( sizeof(OMX_U32) * 8192) );
         m_demux_entries = 0;
-        DEBUG_PRINT_LOW("Initialize parser");
-        if (m_frame_parser.mutils) {
-            m_frame_parser.mutils->initialize_frame_checking_environment();
-        }
 
         while (m_input_pending_q.m_size) {
             m_input_pending_q.pop_entry(&p1,&p2,&ident);
@@ -2288,7 +2132,6 @@ bool omx_vdec::execute_input_flush()
                     (unsigned int)NULL);
             pdest_frame = NULL;
         }
-        m_frame_parser.flush();
     } else if (codec_config_flag) {
         DEBUG_PRINT_HIGH("frame_parser flushing skipped due to codec config buffer "
             "is not sent to the driver yet");
@@ -2301,7 +2144,7 @@ bool omx_vdec::execute_input_flush()
     }
 #ifdef _ANDROID_
     if (m_debug_timestamp) {
-        m_timestamp_list.reset_ts_list();
+        m_timestamp_list.reset();
     }
 #endif
     DEBUG_PRINT_HIGH("OMX flush i/p Port complete PenBuf(%d)", pending_input_buffers);
@@ -3471,7 +3314,7 @@ OMX_ERRORTYPE  omx_vdec::set_config(OMX_IN OMX_HANDLETYPE      hComp,
 
         pNal = reinterpret_cast < OMX_VIDEO_CONFIG_NALSIZE * >(configData);
         nal_length = pNal->nNaluBytes;
-        m_frame_parser.init_nal_length(nal_length);
+        m_au_assembler.set_nal_length(nal_length);
         DEBUG_PRINT_LOW("OMX_IndexConfigVideoNalSize called with Size %d",nal_length);
         return ret;
     }
@@ -5057,8 +4900,8 @@ OMX_ERRORTYPE  omx_vdec::empty_this_buffer_proxy(OMX_IN OMX_HANDLETYPE         h
         not_coded_vop = mp4_headerparser.is_notcodec_vop(
                 (buffer->pBuffer + buffer->nOffset),buffer->nFilledLen);
         if (not_coded_vop) {
-            DEBUG_PRINT_HIGH("Found Not coded vop len %lu frame number %u",
-                    buffer->nFilledLen,frame_count);
+            DEBUG_PRINT_HIGH("Found Not coded vop len %lu",
+                    buffer->nFilledLen);
             if (buffer->nFlags & OMX_BUFFERFLAG_EOS) {
                 DEBUG_PRINT_HIGH("Eos and Not coded Vop set len to zero");
                 not_coded_vop = false;
@@ -5132,10 +4975,10 @@ OMX_ERRORTYPE  omx_vdec::empty_this_buffer_proxy(OMX_IN OMX_HANDLETYPE         h
     if (m_debug_timestamp) {
         if (arbitrary_bytes) {
             DEBUG_PRINT_LOW("Inserting TIMESTAMP (%lld) into queue", buffer->nTimeStamp);
-            m_timestamp_list.insert_ts(buffer->nTimeStamp);
+            m_timestamp_list.insert(buffer->nTimeStamp);
         } else if (!arbitrary_bytes && !(buffer->nFlags & OMX_BUFFERFLAG_CODECCONFIG)) {
             DEBUG_PRINT_LOW("Inserting TIMESTAMP (%lld) into queue", buffer->nTimeStamp);
-            m_timestamp_list.insert_ts(buffer->nTimeStamp);
+            m_timestamp_list.insert(buffer->nTimeStamp);
         }
     }
 #endif
@@ -5155,15 +4998,7 @@ OMX_ERRORTYPE  omx_vdec::empty_this_buffer_proxy(OMX_IN OMX_HANDLETYPE         h
     if (temp_buffer->buffer_len == 0 || (buffer->nFlags & OMX_BUFFERFLAG_EOS)) {
         DEBUG_PRINT_HIGH("Rxd i/p EOS, Notify Driver that EOS has been reached");
         frameinfo.flags |= VDEC_BUFFERFLAG_EOS;
-        h264_scratch.nFilledLen = 0;
-        nal_count = 0;
-        look_ahead_nal = false;
-        frame_count = 0;
-        if (m_frame_parser.mutils)
-            m_frame_parser.mutils->initialize_frame_checking_environment();
-        m_frame_parser.flush();
-        h264_last_au_ts = LLONG_MAX;
-        h264_last_au_flags = 0;
+        m_au_assembler.reset();
         memset(m_demux_offsets, 0, ( sizeof(OMX_U32) * 8192) );
         m_demux_entries = 0;
     }
@@ -5459,10 +5294,7 @@ OMX_ERRORTYPE  omx_vdec::component_deinit(OMX_IN OMX_HANDLETYPE hComp)
     }
     free_input_buffer_header();
     free_output_buffer_header();
-    if (h264_scratch.pBuffer) {
-        free(h264_scratch.pBuffer);
-        h264_scratch.pBuffer = NULL;
-    }
+    m_au_assembler.deallocate();
 
     if (h264_parser) {
         delete h264_parser;
@@ -5487,7 +5319,7 @@ OMX_ERRORTYPE  omx_vdec::component_deinit(OMX_IN OMX_HANDLETYPE hComp)
     m_etb_q.m_read = m_etb_q.m_write =0;
 #ifdef _ANDROID_
     if (m_debug_timestamp) {
-        m_timestamp_list.reset_ts_list();
+        m_timestamp_list.reset();
     }
 #endif
 
@@ -5959,7 +5791,7 @@ OMX_ERRORTYPE omx_vdec::fill_buffer_done(OMX_HANDLETYPE hComp,
         if (m_debug_timestamp) {
             {
                 OMX_TICKS expected_ts = 0;
-                m_timestamp_list.pop_min_ts(expected_ts);
+                m_timestamp_list.pop_min(expected_ts);
                 DEBUG_PRINT_LOW("Current timestamp (%lld),Popped TIMESTAMP (%lld) from list",
                         buffer->nTimeStamp, expected_ts);
 
@@ -6338,13 +6170,9 @@ OMX_ERRORTYPE omx_vdec::push_input_buffer (OMX_HANDLETYPE hComp)
             case CODEC_TYPE_MPEG4:
             case CODEC_TYPE_H263:
             case CODEC_TYPE_MPEG2:
-                ret =  push_input_sc_codec(hComp);
-                break;
             case CODEC_TYPE_H264:
-                ret = push_input_h264(hComp);
-                break;
             case CODEC_TYPE_HEVC:
-                ret = push_input_hevc(hComp);
+                ret = m_au_assembler.push(psource_frame, pdest_frame);
                 break;
             case CODEC_TYPE_VC1:
                 ret = push_input_vc1(hComp);
@@ -6362,483 +6190,89 @@ OMX_ERRORTYPE omx_vdec::push_input_buffer (OMX_HANDLETYPE hComp)
     return ret;
 }
 
-OMX_ERRORTYPE omx_vdec::push_input_sc_codec(OMX_HANDLETYPE hComp)
+OMX_ERRORTYPE omx_vdec::au_ready(OMX_BUFFERHEADERTYPE *dest)
+{
+    return empty_this_buffer_proxy(&m_cmp, dest);
+}
+
+OMX_BUFFERHEADERTYPE *omx_vdec::get_free_dest()
 {
-    OMX_U32 partial_frame = 1;
-    OMX_BOOL generate_ebd = OMX_TRUE;
     unsigned address,p2,id;
 
-    DEBUG_PRINT_LOW("Start Parsing the bit stream address %p TimeStamp %d",
-            psource_frame,psource_frame->nTimeStamp);
-    if (m_frame_parser.parse_sc_frame(psource_frame,
-                pdest_frame,&partial_frame) == -1) {
-        DEBUG_PRINT_ERROR("Error In Parsing Return Error");
-        return OMX_ErrorBadParameter;
+    if (!m_input_free_q.m_size) {
+        return NULL;
     }
+    m_input_free_q.pop_entry(&address,&p2,&id);
+    return (OMX_BUFFERHEADERTYPE *)address;
+}
 
-    if (partial_frame == 0) {
-        DEBUG_PRINT_LOW("Frame size %d source %p frame count %d",
-                pdest_frame->nFilledLen,psource_frame,frame_count);
-
-
-        DEBUG_PRINT_LOW("TimeStamp updated %d",pdest_frame->nTimeStamp);
-        /*First Parsed buffer will have only header Hence skip*/
-        if (frame_count == 0) {
-            DEBUG_PRINT_LOW("H263/MPEG4 Codec First Frame ");
-
-            if (codec_type_parse == CODEC_TYPE_MPEG4 ||
-                    codec_type_parse == CODEC_TYPE_DIVX) {
-                mp4StreamType psBits;
-                psBits.data = pdest_frame->pBuffer + pdest_frame->nOffset;
-                psBits.numBytes = pdest_frame->nFilledLen;
-                mp4_headerparser.parseHeader(&psBits);
-            }
-
-            frame_count++;
-        } else {
-            pdest_frame->nFlags &= ~OMX_BUFFERFLAG_EOS;
-            if (pdest_frame->nFilledLen) {
-                /*Push the frame to the Decoder*/
-                if (empty_this_buffer_proxy(hComp,pdest_frame) != OMX_ErrorNone) {
-                    return OMX_ErrorBadParameter;
-                }
-                frame_count++;
-                pdest_frame = NULL;
-
-                if (m_input_free_q.m_size) {
-                    m_input_free_q.pop_entry(&address,&p2,&id);
-                    pdest_frame = (OMX_BUFFERHEADERTYPE *) address;
-                    pdest_frame->nFilledLen = 0;
-                }
-            } else if (!(psource_frame->nFlags & OMX_BUFFERFLAG_EOS)) {
-                DEBUG_PRINT_ERROR("Zero len buffer return back to POOL");
-                m_input_free_q.insert_entry((unsigned) pdest_frame, (unsigned)NULL,
-                        (unsigned)NULL);
-                pdest_frame = NULL;
-            }
-        }
-    } else {
-        DEBUG_PRINT_LOW("Not a Complete Frame %d",pdest_frame->nFilledLen);
-        /*Check if Destination Buffer is full*/
-        if (pdest_frame->nAllocLen ==
-                pdest_frame->nFilledLen + pdest_frame->nOffset) {
-            DEBUG_PRINT_ERROR("ERROR:Frame Not found though Destination Filled");
-            return OMX_ErrorStreamCorrupt;
-        }
-    }
-
-    if (psource_frame->nFilledLen == 0) {
-        if (psource_frame->nFlags & OMX_BUFFERFLAG_EOS) {
-            if (pdest_frame) {
-                pdest_frame->nFlags |= psource_frame->nFlags;
-                DEBUG_PRINT_LOW("Frame Found start Decoding Size =%d TimeStamp = %x",
-                        pdest_frame->nFilledLen,pdest_frame->nTimeStamp);
-                DEBUG_PRINT_LOW("Found a frame size = %d number = %d",
-                        pdest_frame->nFilledLen,frame_count++);
-                /*Push the frame to the Decoder*/
-                if (empty_this_buffer_proxy(hComp,pdest_frame) != OMX_ErrorNone) {
-                    return OMX_ErrorBadParameter;
-                }
-                frame_count++;
-                pdest_frame = NULL;
-            } else {
-                DEBUG_PRINT_LOW("Last frame in else dest addr") ;
-                generate_ebd = OMX_FALSE;
-            }
-        }
-        if (generate_ebd) {
-            DEBUG_PRINT_LOW("Buffer Consumed return back to client %p",psource_frame);
-            m_cb.EmptyBufferDone (hComp,m_app_data,psource_frame);
-            psource_frame = NULL;
-
-            if (m_input_pending_q.m_size) {
-                DEBUG_PRINT_LOW("Pull Next source Buffer %p",psource_frame);
-                m_input_pending_q.pop_entry(&address,&p2,&id);
-                psource_frame = (OMX_BUFFERHEADERTYPE *) address;
-                DEBUG_PRINT_LOW("Next source Buffer %p time stamp %d",psource_frame,
-                        psource_frame->nTimeStamp);
-                DEBUG_PRINT_LOW("Next source Buffer flag %d length %d",
-                        psource_frame->nFlags,psource_frame->nFilledLen);
-            }
-        }
-    }
-    return OMX_ErrorNone;
+void omx_vdec::return_dest(OMX_BUFFERHEADERTYPE *dest)
+{
+    m_input_free_q.insert_entry((unsigned) dest, (unsigned)NULL,
+            (unsigned)NULL);
 }
 
-OMX_ERRORTYPE omx_vdec::push_input_h264 (OMX_HANDLETYPE hComp)
+OMX_BUFFERHEADERTYPE *omx_vdec::get_next_source()
 {
-    OMX_U32 partial_frame = 1;
     unsigned address,p2,id;
-    OMX_BOOL isNewFrame = OMX_FALSE;
-    OMX_BOOL generate_ebd = OMX_TRUE;
 
-    if (h264_scratch.pBuffer == NULL) {
-        DEBUG_PRINT_ERROR("ERROR:H.264 Scratch Buffer not allocated");
-        return OMX_ErrorBadParameter;
-    }
-    DEBUG_PRINT_LOW("Pending h264_scratch.nFilledLen %d "
-            "look_ahead_nal %d", h264_scratch.nFilledLen, look_ahead_nal);
-    DEBUG_PRINT_LOW("Pending pdest_frame->nFilledLen %d",pdest_frame->nFilledLen);
-    if (h264_scratch.nFilledLen && look_ahead_nal) {
-        look_ahead_nal = false;
-        if ((pdest_frame->nAllocLen - pdest_frame->nFilledLen) >=
-                h264_scratch.nFilledLen) {
-            memcpy ((pdest_frame->pBuffer + pdest_frame->nFilledLen),
-                    h264_scratch.pBuffer,h264_scratch.nFilledLen);
-            pdest_frame->nFilledLen += h264_scratch.nFilledLen;
-            DEBUG_PRINT_LOW("Copy the previous NAL (h264 scratch) into Dest frame");
-            h264_scratch.nFilledLen = 0;
-        } else {
-            DEBUG_PRINT_ERROR("Error:1: Destination buffer overflow for H264");
-            return OMX_ErrorBadParameter;
-        }
-    }
-    if (nal_length == 0) {
-        DEBUG_PRINT_LOW("Zero NAL, hence parse using start code");
-        if (m_frame_parser.parse_sc_frame(psource_frame,
-                    &h264_scratch,&partial_frame) == -1) {
-            DEBUG_PRINT_ERROR("Error In Parsing Return Error");
-            return OMX_ErrorBadParameter;
-        }
-    } else {
-        DEBUG_PRINT_LOW("Non-zero NAL length clip, hence parse with NAL size %d ",nal_length);
-        if (m_frame_parser.parse_h264_nallength(psource_frame,
-                    &h264_scratch,&partial_frame) == -1) {
-            DEBUG_PRINT_ERROR("Error In Parsing NAL size, Return Error");
-            return OMX_ErrorBadParameter;
-        }
+    if (!m_input_pending_q.m_size) {
+        return NULL;
     }
+    m_input_pending_q.pop_entry(&address,&p2,&id);
+    return (OMX_BUFFERHEADERTYPE *)address;
+}
 
-    if (partial_frame == 0) {
-        if (nal_count == 0 && h264_scratch.nFilledLen == 0) {
-            DEBUG_PRINT_LOW("First NAL with Zero Length, hence Skip");
-            nal_count++;
-            h264_scratch.nTimeStamp = psource_frame->nTimeStamp;
-            h264_scratch.nFlags = psource_frame->nFlags;
-        } else {
-            DEBUG_PRINT_LOW("Parsed New NAL Length = %d",h264_scratch.nFilledLen);
-            if (h264_scratch.nFilledLen) {
-                h264_parser->parse_nal((OMX_U8*)h264_scratch.pBuffer, h264_scratch.nFilledLen,
-                        NALU_TYPE_SPS);
-#ifndef PROCESS_EXTRADATA_IN_OUTPUT_PORT
-                if (client_extradata & OMX_TIMEINFO_EXTRADATA)
-                    h264_parser->parse_nal((OMX_U8*)h264_scratch.pBuffer,
-                            h264_scratch.nFilledLen, NALU_TYPE_SEI);
-                else if (client_extradata & OMX_FRAMEINFO_EXTRADATA)
-                    // If timeinfo is present frame info from SEI is already processed
-                    h264_parser->parse_nal((OMX_U8*)h264_scratch.pBuffer,
-                            h264_scratch.nFilledLen, NALU_TYPE_SEI);
-#endif
-                m_frame_parser.mutils->isNewFrame(&h264_scratch, 0, isNewFrame);
-                nal_count++;
-                if (VALID_TS(h264_last_au_ts) && !VALID_TS(pdest_frame->nTimeStamp)) {
-                    pdest_frame->nTimeStamp = h264_last_au_ts;
-                    pdest_frame->nFlags = h264_last_au_flags;
-#ifdef PANSCAN_HDLR
-                    if (client_extradata & OMX_FRAMEINFO_EXTRADATA)
-                        h264_parser->update_panscan_data(h264_last_au_ts);
-#endif
-                }
-                if (m_frame_parser.mutils->nalu_type == NALU_TYPE_NON_IDR ||
-                        m_frame_parser.mutils->nalu_type == NALU_TYPE_IDR) {
-                    h264_last_au_ts = h264_scratch.nTimeStamp;
-                    h264_last_au_flags = h264_scratch.nFlags;
-#ifndef PROCESS_EXTRADATA_IN_OUTPUT_PORT
-                    if (client_extradata & OMX_TIMEINFO_EXTRADATA) {
-                        OMX_S64 ts_in_sei = h264_parser->process_ts_with_sei_vui(h264_last_au_ts);
-                        if (!VALID_TS(h264_last_au_ts))
-                            h264_last_au_ts = ts_in_sei;
-                    }
-#endif
-                } else
-                    h264_last_au_ts = LLONG_MAX;
-            }
-
-            if (!isNewFrame) {
-                if ( (pdest_frame->nAllocLen - pdest_frame->nFilledLen) >=
-                        h264_scratch.nFilledLen) {
-                    DEBUG_PRINT_LOW("Not a NewFrame Copy into Dest len %d",
-                            h264_scratch.nFilledLen);
-                    memcpy ((pdest_frame->pBuffer + pdest_frame->nFilledLen),
-                            h264_scratch.pBuffer,h264_scratch.nFilledLen);
-                    pdest_frame->nFilledLen += h264_scratch.nFilledLen;
-                    if (m_frame_parser.mutils->nalu_type == NALU_TYPE_EOSEQ)
-                        pdest_frame->nFlags |= QOMX_VIDEO_BUFFERFLAG_EOSEQ;
-                    h264_scratch.nFilledLen = 0;
-                } else {
-                    DEBUG_PRINT_LOW("Error:2: Destination buffer overflow for H264");
-                    return OMX_ErrorBadParameter;
-                }
-            } else {
-                look_ahead_nal = true;
-                DEBUG_PRINT_LOW("Frame Found start Decoding Size =%d TimeStamp = %x",
-                        pdest_frame->nFilledLen,pdest_frame->nTimeStamp);
-                DEBUG_PRINT_LOW("Found a frame size = %d number = %d",
-                        pdest_frame->nFilledLen,frame_count++);
-
-                if (pdest_frame->nFilledLen == 0) {
-                    DEBUG_PRINT_LOW("Copy the Current Frame since and push it");
-                    look_ahead_nal = false;
-                    if ( (pdest_frame->nAllocLen - pdest_frame->nFilledLen) >=
-                            h264_scratch.nFilledLen) {
-                        memcpy ((pdest_frame->pBuffer + pdest_frame->nFilledLen),
-                                h264_scratch.pBuffer,h264_scratch.nFilledLen);
-                        pdest_frame->nFilledLen += h264_scratch.nFilledLen;
-                        h264_scratch.nFilledLen = 0;
-                    } else {
-                        DEBUG_PRINT_ERROR("Error:3: Destination buffer overflow for H264");
-                        return OMX_ErrorBadParameter;
-                    }
-                } else {
-                    if (psource_frame->nFilledLen || h264_scratch.nFilledLen) {
-                        DEBUG_PRINT_LOW("Reset the EOS Flag");
-                        pdest_frame->nFlags &= ~OMX_BUFFERFLAG_EOS;
-                    }
-                    /*Push the frame to the Decoder*/
-                    if (empty_this_buffer_proxy(hComp,pdest_frame) != OMX_ErrorNone) {
-                        return OMX_ErrorBadParameter;
-                    }
-                    //frame_count++;
-                    pdest_frame = NULL;
-                    if (m_input_free_q.m_size) {
-                        m_input_free_q.pop_entry(&address,&p2,&id);
-                        pdest_frame = (OMX_BUFFERHEADERTYPE *) address;
-                        DEBUG_PRINT_LOW("Pop the next pdest_buffer %p",pdest_frame);
-                        pdest_frame->nFilledLen = 0;
-                        pdest_frame->nFlags = 0;
-                        pdest_frame->nTimeStamp = LLONG_MAX;
-                    }
-                }
-            }
-        }
-    } else {
-        DEBUG_PRINT_LOW("Not a Complete Frame, pdest_frame->nFilledLen %d",pdest_frame->nFilledLen);
-        /*Check if Destination Buffer is full*/
-        if (h264_scratch.nAllocLen ==
-                h264_scratch.nFilledLen + h264_scratch.nOffset) {
-            DEBUG_PRINT_ERROR("ERROR: Frame Not found though Destination Filled");
-            return OMX_ErrorStreamCorrupt;
-        }
-    }
-
-    if (!psource_frame->nFilledLen) {
-        DEBUG_PRINT_LOW("Buffer Consumed return source %p back to client",psource_frame);
-
-        if (psource_frame->nFlags & OMX_BUFFERFLAG_EOS) {
-            if (pdest_frame) {
-                DEBUG_PRINT_LOW("EOS Reached Pass Last Buffer");
-                if ( (pdest_frame->nAllocLen - pdest_frame->nFilledLen) >=
-                        h264_scratch.nFilledLen) {
-                    memcpy ((pdest_frame->pBuffer + pdest_frame->nFilledLen),
-                            h264_scratch.pBuffer,h264_scratch.nFilledLen);
-                    pdest_frame->nFilledLen += h264_scratch.nFilledLen;
-                    h264_scratch.nFilledLen = 0;
-                } else {
-                    DEBUG_PRINT_ERROR("ERROR:4: Destination buffer overflow for H264");
-                    return OMX_ErrorBadParameter;
-                }
-                pdest_frame->nTimeStamp = h264_scratch.nTimeStamp;
-                pdest_frame->nFlags = h264_scratch.nFlags | psource_frame->nFlags;
+void omx_vdec::source_done(OMX_BUFFERHEADERTYPE *source)
+{
+    m_cb.EmptyBufferDone(&m_cmp, m_app_data, source);
+}
 
-                DEBUG_PRINT_LOW("pdest_frame->nFilledLen =%d TimeStamp = %x",
-                        pdest_frame->nFilledLen,pdest_frame->nTimeStamp);
-                DEBUG_PRINT_LOW("Push AU frame number %d to driver", frame_count++);
+void omx_vdec::nal_parsed(const au_nal_unit &nal)
+{
+    bool sei_enabled = false;
 #ifndef PROCESS_EXTRADATA_IN_OUTPUT_PORT
-                if (client_extradata & OMX_TIMEINFO_EXTRADATA) {
-                    OMX_S64 ts_in_sei = h264_parser->process_ts_with_sei_vui(pdest_frame->nTimeStamp);
-                    if (!VALID_TS(pdest_frame->nTimeStamp))
-                        pdest_frame->nTimeStamp = ts_in_sei;
-                }
+    // Frame info shares the SEI parsed for time info
+    sei_enabled = (client_extradata &
+            (OMX_TIMEINFO_EXTRADATA | OMX_FRAMEINFO_EXTRADATA)) != 0;
 #endif
-                /*Push the frame to the Decoder*/
-                if (empty_this_buffer_proxy(hComp,pdest_frame) != OMX_ErrorNone) {
-                    return OMX_ErrorBadParameter;
-                }
-                frame_count++;
-                pdest_frame = NULL;
-            } else {
-                DEBUG_PRINT_LOW("Last frame in else dest addr %p size %d",
-                        pdest_frame,h264_scratch.nFilledLen);
-                generate_ebd = OMX_FALSE;
-            }
-        }
-    }
-    if (generate_ebd && !psource_frame->nFilledLen) {
-        m_cb.EmptyBufferDone (hComp,m_app_data,psource_frame);
-        psource_frame = NULL;
-        if (m_input_pending_q.m_size) {
-            DEBUG_PRINT_LOW("Pull Next source Buffer %p",psource_frame);
-            m_input_pending_q.pop_entry(&address,&p2,&id);
-            psource_frame = (OMX_BUFFERHEADERTYPE *) address;
-            DEBUG_PRINT_LOW("Next source Buffer flag %d src length %d",
-                    psource_frame->nFlags,psource_frame->nFilledLen);
-        }
-    }
-    return OMX_ErrorNone;
+    h264_parser->parse_nal_payload(nal.payload, nal.payload_len,
+            nal.type, sei_enabled);
 }
 
-OMX_ERRORTYPE copy_buffer(OMX_BUFFERHEADERTYPE* pDst, OMX_BUFFERHEADERTYPE* pSrc)
+void omx_vdec::au_started(OMX_S64 timestamp)
 {
-    OMX_ERRORTYPE rc = OMX_ErrorNone;
-    if ((pDst->nAllocLen - pDst->nFilledLen) >= pSrc->nFilledLen) {
-        memcpy ((pDst->pBuffer + pDst->nFilledLen), pSrc->pBuffer, pSrc->nFilledLen);
-        if (pDst->nTimeStamp == LLONG_MAX) {
-            pDst->nTimeStamp = pSrc->nTimeStamp;
-            DEBUG_PRINT_LOW("Assign Dst nTimeStamp=%lld", pDst->nTimeStamp);
-        }
-        pDst->nFilledLen += pSrc->nFilledLen;
-        pSrc->nFilledLen = 0;
-    } else {
-        DEBUG_PRINT_ERROR("Error: Destination buffer overflow");
-        rc = OMX_ErrorBadParameter;
-    }
-    return rc;
+#ifdef PANSCAN_HDLR
+    if (client_extradata & OMX_FRAMEINFO_EXTRADATA)
+        h264_parser->update_panscan_data(timestamp);
+#else
+    (void)timestamp;
+#endif
 }
 
-OMX_ERRORTYPE omx_vdec::push_input_hevc (OMX_HANDLETYPE hComp)
+OMX_S64 omx_vdec::au_timestamp(OMX_S64 timestamp)
 {
-    OMX_U32 partial_frame = 1;
-    unsigned address,p2,id;
-    OMX_BOOL isNewFrame = OMX_FALSE;
-    OMX_BOOL generate_ebd = OMX_TRUE;
-    OMX_ERRORTYPE rc = OMX_ErrorNone;
-
-    if (h264_scratch.pBuffer == NULL) {
-        DEBUG_PRINT_ERROR("ERROR:Hevc Scratch Buffer not allocated");
-        return OMX_ErrorBadParameter;
-    }
-
-
-    DEBUG_PRINT_LOW("h264_scratch.nFilledLen %d has look_ahead_nal %d pdest_frame nFilledLen %d nTimeStamp %lld",
-            h264_scratch.nFilledLen, look_ahead_nal, pdest_frame->nFilledLen, pdest_frame->nTimeStamp);
-
-    if (h264_scratch.nFilledLen && look_ahead_nal) {
-        look_ahead_nal = false;
-
-        // copy the lookahead buffer in the scratch
-        rc = copy_buffer(pdest_frame, &h264_scratch);
-        if (rc != OMX_ErrorNone) {
-            return rc;
-        }
-    }
-    if (nal_length == 0) {
-        if (m_frame_parser.parse_sc_frame(psource_frame,
-                    &h264_scratch,&partial_frame) == -1) {
-            DEBUG_PRINT_ERROR("Error In Parsing Return Error");
-            return OMX_ErrorBadParameter;
-        }
-    } else {
-        DEBUG_PRINT_LOW("Non-zero NAL length clip, hence parse with NAL size %d",nal_length);
-        if (m_frame_parser.parse_h264_nallength(psource_frame,
-                    &h264_scratch,&partial_frame) == -1) {
-            DEBUG_PRINT_ERROR("Error In Parsing NAL size, Return Error");
-            return OMX_ErrorBadParameter;
-        }
-    }
-
-    if (partial_frame == 0) {
-        if (nal_count == 0 && h264_scratch.nFilledLen == 0) {
-            DEBUG_PRINT_LOW("First NAL with Zero Length, hence Skip");
-            nal_count++;
-            h264_scratch.nTimeStamp = psource_frame->nTimeStamp;
-            h264_scratch.nFlags = psource_frame->nFlags;
-        } else {
-            DEBUG_PRINT_LOW("Parsed New NAL Length = %d",h264_scratch.nFilledLen);
-            if (h264_scratch.nFilledLen) {
-                mHEVCutils.isNewFrame(&h264_scratch, 0, isNewFrame);
-                nal_count++;
-            }
-
-            if (!isNewFrame) {
-                DEBUG_PRINT_LOW("Not a new frame, copy h264_scratch nFilledLen %d nTimestamp %lld, pdest_frame nFilledLen %d nTimestamp %lld",
-                        h264_scratch.nFilledLen, h264_scratch.nTimeStamp, pdest_frame->nFilledLen, pdest_frame->nTimeStamp);
-                rc = copy_buffer(pdest_frame, &h264_scratch);
-                if ( rc != OMX_ErrorNone) {
-                    return rc;
-                }
-            } else {
-                look_ahead_nal = true;
-                if (pdest_frame->nFilledLen == 0) {
-                    look_ahead_nal = false;
-                    DEBUG_PRINT_LOW("dest nation buffer empty, copy scratch buffer");
-                    rc = copy_buffer(pdest_frame, &h264_scratch);
-                    if ( rc != OMX_ErrorNone ) {
-                        return OMX_ErrorBadParameter;
-                    }
-                } else {
-                    if (psource_frame->nFilledLen || h264_scratch.nFilledLen) {
-                        pdest_frame->nFlags &= ~OMX_BUFFERFLAG_EOS;
-                    }
-
-                    DEBUG_PRINT_LOW("FrameDetecetd # %d pdest_frame nFilledLen %d nTimeStamp %lld, look_ahead_nal in h264_scratch nFilledLen %d nTimeStamp %lld",
-                            frame_count++, pdest_frame->nFilledLen, pdest_frame->nTimeStamp, h264_scratch.nFilledLen, h264_scratch.nTimeStamp);
-                    if (empty_this_buffer_proxy(hComp,pdest_frame) != OMX_ErrorNone) {
-                        return OMX_ErrorBadParameter;
-                    }
-                    pdest_frame = NULL;
-                    if (m_input_free_q.m_size) {
-                        m_input_free_q.pop_entry(&address,&p2,&id);
-                        pdest_frame = (OMX_BUFFERHEADERTYPE *) address;
-                        DEBUG_PRINT_LOW("pop the next pdest_buffer %p",pdest_frame);
-                        pdest_frame->nFilledLen = 0;
-                        pdest_frame->nFlags = 0;
-                        pdest_frame->nTimeStamp = LLONG_MAX;
-                    }
-                }
-            }
-        }
-    } else {
-        DEBUG_PRINT_LOW("psource_frame is partial nFilledLen %d nTimeStamp %lld, pdest_frame nFilledLen %d nTimeStamp %lld, h264_scratch nFilledLen %d nTimeStamp %lld",
-                psource_frame->nFilledLen, psource_frame->nTimeStamp, pdest_frame->nFilledLen, pdest_frame->nTimeStamp, h264_scratch.nFilledLen, h264_scratch.nTimeStamp);
-
-        /*Check if Destination Buffer is full*/
-        if (h264_scratch.nAllocLen ==
-                h264_scratch.nFilledLen + h264_scratch.nOffset) {
-            DEBUG_PRINT_ERROR("ERROR: Frame Not found though Destination Filled");
-            return OMX_ErrorStreamCorrupt;
-        }
-    }
-
-    if (!psource_frame->nFilledLen) {
-        DEBUG_PRINT_LOW("Buffer Consumed return source %p back to client",psource_frame);
-
-        if (psource_frame->nFlags & OMX_BUFFERFLAG_EOS) {
-            if (pdest_frame) {
-                DEBUG_PRINT_LOW("EOS Reached Pass Last Buffer");
-                rc = copy_buffer(pdest_frame, &h264_scratch);
-                if ( rc != OMX_ErrorNone ) {
-                    return rc;
-                }
-                pdest_frame->nTimeStamp = h264_scratch.nTimeStamp;
-                pdest_frame->nFlags = h264_scratch.nFlags | psource_frame->nFlags;
-
-                DEBUG_PRINT_LOW("Push EOS frame number:%d nFilledLen =%d TimeStamp = %lld",
-                        frame_count, pdest_frame->nFilledLen,pdest_frame->nTimeStamp);
+#ifndef PROCESS_EXTRADATA_IN_OUTPUT_PORT
+    if (client_extradata & OMX_TIMEINFO_EXTRADATA)
+        return h264_parser->process_ts_with_sei_vui(timestamp);
+#else
+    (void)timestamp;
+#endif
+    return LLONG_MAX;
+}
 
-                /*Push the frame to the Decoder*/
-                if (empty_this_buffer_proxy(hComp,pdest_frame) != OMX_ErrorNone) {
-                    return OMX_ErrorBadParameter;
-                }
-                frame_count++;
-                pdest_frame = NULL;
-            } else {
-                DEBUG_PRINT_LOW("Last frame in else dest addr %p size %d",
-                        pdest_frame,h264_scratch.nFilledLen);
-                generate_ebd = OMX_FALSE;
-            }
-        }
-    }
-    if (generate_ebd && !psource_frame->nFilledLen) {
-        m_cb.EmptyBufferDone (hComp,m_app_data,psource_frame);
-        psource_frame = NULL;
-        if (m_input_pending_q.m_size) {
-            m_input_pending_q.pop_entry(&address,&p2,&id);
-            psource_frame = (OMX_BUFFERHEADERTYPE *) address;
-            DEBUG_PRINT_LOW("Next source Buffer flag %d nFilledLen %d, nTimeStamp %lld",
-                    psource_frame->nFlags,psource_frame->nFilledLen, psource_frame->nTimeStamp);
-        }
-    }
-    return OMX_ErrorNone;
+/* The buffer requirements of a new stream are only known once the driver
+   parsed the same SPS, so the port reconfiguration still waits for its
+   settings changed event, the change is only logged ahead of it. */
+void omx_vdec::stream_changed(OMX_U32 changes, const stream_params &params)
+{
+    if (changes & (STREAM_CHANGE_RESOLUTION | STREAM_CHANGE_FORMAT))
+        DEBUG_PRINT_HIGH("Stream changes 0x%x: %ux%u -> %ux%u, %u bit, "
+                "port settings change expected",
+                (unsigned int)changes, drv_ctx.video_resolution.frame_width,
+                drv_ctx.video_resolution.frame_height,
+                (unsigned int)params.width, (unsigned int)params.height,
+                (unsigned int)params.bit_depth_luma);
 }
 
 OMX_ERRORTYPE omx_vdec::push_input_vc1 (OMX_HANDLETYPE hComp)
@@ -6883,7 +6317,7 @@ OMX_ERRORTYPE omx_vdec::push_input_vc1 (OMX_HANDLETYPE hComp)
     switch (m_vc1_profile) {
         case VC1_AP:
             DEBUG_PRINT_LOW("VC1 AP, hence parse using frame start code");
-            if (push_input_sc_codec(hComp) != OMX_ErrorNone) {
+            if (m_au_assembler.push(psource_frame, pdest_frame) != OMX_ErrorNone) {
                 DEBUG_PRINT_ERROR("Error In Parsing VC1 AP start code");
                 return OMX_ErrorBadParameter;
             }
@@ -7029,12 +6463,6 @@ void omx_vdec::free_input_buffer_header()
 {
     input_use_buffer = false;
     if (arbitrary_bytes) {
-        if (m_frame_parser.mutils) {
-            DEBUG_PRINT_LOW("Free utils parser");
-            delete (m_frame_parser.mutils);
-            m_frame_parser.mutils = NULL;
-        }
-
         if (m_inp_heap_ptr) {
             DEBUG_PRINT_LOW("Free input Heap Pointer");
             free (m_inp_heap_ptr);
@@ -8361,6 +7789,13 @@ OMX_ERRORTYPE omx_vdec::allocate_color_convert_buf::free_output_buffer(
         DEBUG_PRINT_ERROR("Incorrect index color convert free_output_buffer");
         return OMX_ErrorBadParameter;
     }
+    /* Drop the converter's GPU mappings before the memory goes away */
+    pthread_mutex_lock(&omx->c_lock);
+    c2d.release_buffer(omx->drv_ctx.ptr_outputbuffer[index].pmem_fd,
+            omx->m_out_mem_ptr->pBuffer);
+    if (pmem_fd[index] > 0)
+        c2d.release_buffer(pmem_fd[index], pmem_baseaddress[index]);
+    pthread_mutex_unlock(&omx->c_lock);
     if (pmem_fd[index] > 0) {
         munmap(pmem_baseaddress[index], buffer_size_req);
         close(pmem_fd[index]);
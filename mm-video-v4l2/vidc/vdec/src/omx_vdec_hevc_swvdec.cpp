@@ -275,8 +275,6 @@ void* async_message_thread (void *input)
 void* message_thread(void *input)
 {
     omx_vdec* omx = reinterpret_cast<omx_vdec*>(input);
-    unsigned char id;
-    int n;
     if (omx == NULL)
     {
         DEBUG_PRINT_ERROR("message thread null pointer rxd");
@@ -285,25 +283,9 @@ void* message_thread(void *input)
 
     DEBUG_PRINT_HIGH("omx_vdec: message thread start");
     prctl(PR_SET_NAME, (unsigned long)"VideoDecMsgThread", 0, 0, 0);
-    while (1)
+    while (omx->m_msg_notifier.wait())
     {
-
-        n = read(omx->m_pipe_in, &id, 1);
-
-        if(0 == n)
-        {
-            break;
-        }
-
-        if (1 == n)
-        {
-            omx->process_event_cb(omx, id);
-        }
-        if ((n < 0) && (errno != EINTR))
-        {
-            DEBUG_PRINT_ERROR("ERROR: read from pipe failed, ret %d errno %d", n, errno);
-            break;
-        }
+        omx->process_event_cb(omx, 0);
     }
     DEBUG_PRINT_HIGH("omx_vdec: message thread stop");
     return NULL;
@@ -311,16 +293,15 @@ void* message_thread(void *input)
 
 void post_message(omx_vdec *omx, unsigned char id)
 {
-    int ret_value;
+    bool woken;
 
     if (omx == NULL)
     {
         DEBUG_PRINT_ERROR("message thread null pointer rxd");
         return;
     }
-    DEBUG_PRINT_LOW("omx_vdec: post_message %d pipe out%d", id,omx->m_pipe_out);
-    ret_value = write(omx->m_pipe_out, &id, 1);
-    DEBUG_PRINT_LOW("post_message to pipe done %d",ret_value);
+    woken = omx->m_msg_notifier.notify();
+    DEBUG_PRINT_LOW("omx_vdec: post_message %d wake %d", id, woken);
 }
 
 // omx_cmd_queue destructor
@@ -389,107 +370,6 @@ unsigned omx_vdec::omx_cmd_queue::get_q_msg_type()
     return m_q[m_read].id;
 }
 
-#ifdef _ANDROID_
-omx_vdec::ts_arr_list::ts_arr_list()
-{
-    //initialize timestamps array
-    memset(m_ts_arr_list, 0, sizeof(m_ts_arr_list) );
-}
-omx_vdec::ts_arr_list::~ts_arr_list()
-{
-    //free m_ts_arr_list?
-}
-
-bool omx_vdec::ts_arr_list::insert_ts(OMX_TICKS ts)
-{
-    bool ret = true;
-    bool duplicate_ts = false;
-    int idx = 0;
-
-    //insert at the first available empty location
-    for ( ; idx < MAX_NUM_INPUT_OUTPUT_BUFFERS; idx++)
-    {
-        if (!m_ts_arr_list[idx].valid)
-        {
-            //found invalid or empty entry, save timestamp
-            m_ts_arr_list[idx].valid = true;
-            m_ts_arr_list[idx].timestamp = ts;
-            DEBUG_PRINT_LOW("Insert_ts(): Inserting TIMESTAMP (%lld) at idx (%d)",
-                ts, idx);
-            break;
-        }
-    }
-
-    if (idx == MAX_NUM_INPUT_OUTPUT_BUFFERS)
-    {
-        DEBUG_PRINT_LOW("Timestamp array list is FULL. Unsuccessful insert");
-        ret = false;
-    }
-    return ret;
-}
-
-bool omx_vdec::ts_arr_list::pop_min_ts(OMX_TICKS &ts)
-{
-    bool ret = true;
-    int min_idx = -1;
-    OMX_TICKS min_ts = 0;
-    int idx = 0;
-
-    for ( ; idx < MAX_NUM_INPUT_OUTPUT_BUFFERS; idx++)
-    {
-
-        if (m_ts_arr_list[idx].valid)
-        {
-            //found valid entry, save index
-            if (min_idx < 0)
-            {
-                //first valid entry
-                min_ts = m_ts_arr_list[idx].timestamp;
-                min_idx = idx;
-            }
-            else if (m_ts_arr_list[idx].timestamp < min_ts)
-            {
-                min_ts = m_ts_arr_list[idx].timestamp;
-                min_idx = idx;
-            }
-        }
-
-    }
-
-    if (min_idx < 0)
-    {
-        //no valid entries found
-        DEBUG_PRINT_LOW("Timestamp array list is empty. Unsuccessful pop");
-        ts = 0;
-        ret = false;
-    }
-    else
-    {
-        ts = m_ts_arr_list[min_idx].timestamp;
-        m_ts_arr_list[min_idx].valid = false;
-        DEBUG_PRINT_LOW("Pop_min_ts:Timestamp (%lld), index(%d)",
-            ts, min_idx);
-    }
-
-    return ret;
-
-}
-
-
-bool omx_vdec::ts_arr_list::reset_ts_list()
-{
-    bool ret = true;
-    int idx = 0;
-
-    DEBUG_PRINT_LOW("reset_ts_list(): Resetting timestamp array list");
-    for ( ; idx < MAX_NUM_INPUT_OUTPUT_BUFFERS; idx++)
-    {
-        m_ts_arr_list[idx].valid = false;
-    }
-    return ret;
-}
-#endif
-
 // factory function executed by the core to create instances
 void *get_omx_component_factory_fn(void)
 {
@@ -580,17 +460,12 @@ omx_vdec::omx_vdec():
     m_heap_inp_bm_count (0),
     codec_type_parse ((codec_type)0),
     first_frame_meta (true),
-    frame_count (0),
-    nal_count (0),
     nal_length(0),
-    look_ahead_nal (false),
     first_frame(0),
     first_buffer(NULL),
     first_frame_size (0),
     m_device_file_ptr(NULL),
     m_vc1_profile((vc1_profile_type)0),
-    h264_last_au_ts(LLONG_MAX),
-    h264_last_au_flags(0),
     prev_ts(LLONG_MAX),
     rst_prev_ts(true),
     frm_int(0),
@@ -666,7 +541,6 @@ omx_vdec::omx_vdec():
     memset(&m_cmp,0,sizeof(m_cmp));
     memset(&m_cb,0,sizeof(m_cb));
     memset (&drv_ctx,0,sizeof(drv_ctx));
-    memset (&h264_scratch,0,sizeof (OMX_BUFFERHEADERTYPE));
     memset (m_hwdevice_name,0,sizeof(m_hwdevice_name));
     memset(m_demux_offsets, 0, sizeof(m_demux_offsets) );
     m_demux_entries = 0;
@@ -789,10 +663,7 @@ omx_vdec::~omx_vdec()
     m_pmem_info = NULL;
     struct v4l2_decoder_cmd dec;
     DEBUG_PRINT_HIGH("In OMX vdec Destructor");
-    if(m_pipe_in) close(m_pipe_in);
-    if(m_pipe_out) close(m_pipe_out);
-    m_pipe_in = -1;
-    m_pipe_out = -1;
+    m_msg_notifier.stop();
     DEBUG_PRINT_HIGH("Waiting on OMX Msg Thread exit");
 
     if (msg_thread_created)
@@ -1750,7 +1621,6 @@ OMX_ERRORTYPE omx_vdec::component_init(OMX_STRING role)
     struct v4l2_control control;
     struct v4l2_frmsizeenum frmsize;
     unsigned int   alignment = 0,buffer_size = 0;
-    int fds[2];
     int r,ret=0;
     bool codec_ambiguous = false;
 
@@ -1835,8 +1705,7 @@ OMX_ERRORTYPE omx_vdec::component_init(OMX_STRING role)
     drv_ctx.decoder_format = VDEC_CODECTYPE_HEVC;
     eCompressionFormat = OMX_VIDEO_CodingHEVC;
     codec_type_parse = CODEC_TYPE_HEVC;
-    m_frame_parser.init_start_codes (codec_type_parse);
-    m_frame_parser.init_nal_length(nal_length);
+    m_au_assembler.init(codec_type_parse, this);
 
     update_resolution(1280, 720, 1280, 720);
     drv_ctx.output_format = VDEC_YUV_FORMAT_NV12;
@@ -2041,34 +1910,19 @@ OMX_ERRORTYPE omx_vdec::component_init(OMX_STRING role)
         drv_ctx.ip_buf.buffer_size, drv_ctx.interm_op_buf.buffer_size,
         drv_ctx.op_buf.buffer_size);
 
-    h264_scratch.nAllocLen = drv_ctx.ip_buf.buffer_size;
-    h264_scratch.pBuffer = (OMX_U8 *)malloc (drv_ctx.ip_buf.buffer_size);
-    h264_scratch.nFilledLen = 0;
-    h264_scratch.nOffset = 0;
-
-    if (h264_scratch.pBuffer == NULL)
+    if (!m_au_assembler.allocate(drv_ctx.ip_buf.buffer_size))
     {
-        DEBUG_PRINT_ERROR("h264_scratch.pBuffer Allocation failed ");
+        DEBUG_PRINT_ERROR("AU assembler allocation failed ");
         return OMX_ErrorInsufficientResources;
     }
 
-    if(pipe(fds))
+    if (!m_msg_notifier.init())
     {
-        DEBUG_PRINT_ERROR("pipe creation failed");
+        DEBUG_PRINT_ERROR("eventfd creation failed");
         eRet = OMX_ErrorInsufficientResources;
     }
     else
     {
-        if(fds[0] == 0 || fds[1] == 0)
-        {
-            if (pipe (fds))
-            {
-                DEBUG_PRINT_ERROR("pipe creation failed");
-                return OMX_ErrorInsufficientResources;
-            }
-        }
-        m_pipe_in = fds[0];
-        m_pipe_out = fds[1];
         r = pthread_create(&msg_thread_id,0,message_thread,this);
 
         if(r < 0)
@@ -2889,19 +2743,9 @@ bool omx_vdec::execute_input_flush()
     if (arbitrary_bytes && !(codec_config_flag))
     {
         DEBUG_PRINT_LOW("Reset all the variables before flusing");
-        h264_scratch.nFilledLen = 0;
-        nal_count = 0;
-        look_ahead_nal = false;
-        frame_count = 0;
-        h264_last_au_ts = LLONG_MAX;
-        h264_last_au_flags = 0;
+        m_au_assembler.reset();
         memset(m_demux_offsets, 0, ( sizeof(OMX_U32) * 8192) );
         m_demux_entries = 0;
-        DEBUG_PRINT_LOW("Initialize parser");
-        if (m_frame_parser.mutils)
-        {
-            m_frame_parser.mutils->initialize_frame_checking_environment();
-        }
 
         while (m_input_pending_q.m_size)
         {
@@ -2922,7 +2766,6 @@ bool omx_vdec::execute_input_flush()
                 (unsigned long)NULL);
             pdest_frame = NULL;
         }
-        m_frame_parser.flush();
     }
     else if (codec_config_flag)
     {
@@ -2939,7 +2782,7 @@ bool omx_vdec::execute_input_flush()
 #ifdef _ANDROID_
     if (m_debug_timestamp)
     {
-        m_timestamp_list.reset_ts_list();
+        m_timestamp_list.reset();
     }
 #endif
     DEBUG_PRINT_HIGH("OMX flush i/p Port complete PenBuf(%d)", pending_input_buffers);
@@ -4379,7 +4222,7 @@ OMX_ERRORTYPE  omx_vdec::set_config(OMX_IN OMX_HANDLETYPE      hComp,
 
         pNal = reinterpret_cast < OMX_VIDEO_CONFIG_NALSIZE * >(configData);
         nal_length = pNal->nNaluBytes;
-        m_frame_parser.init_nal_length(nal_length);
+        m_au_assembler.set_nal_length(nal_length);
         DEBUG_PRINT_LOW("OMX_IndexConfigVideoNalSize called with Size %d",nal_length);
         return ret;
     }
@@ -6351,12 +6194,12 @@ OMX_ERRORTYPE  omx_vdec::empty_this_buffer_proxy(OMX_IN OMX_HANDLETYPE         h
         if(arbitrary_bytes)
         {
             DEBUG_PRINT_LOW("Inserting TIMESTAMP (%lld) into queue", buffer->nTimeStamp);
-            m_timestamp_list.insert_ts(buffer->nTimeStamp);
+            m_timestamp_list.insert(buffer->nTimeStamp);
         }
         else if(!arbitrary_bytes && !(buffer->nFlags & OMX_BUFFERFLAG_CODECCONFIG))
         {
             DEBUG_PRINT_LOW("Inserting TIMESTAMP (%lld) into queue", buffer->nTimeStamp);
-            m_timestamp_list.insert_ts(buffer->nTimeStamp);
+            m_timestamp_list.insert(buffer->nTimeStamp);
         }
     }
 #endif
@@ -6376,15 +6219,7 @@ OMX_ERRORTYPE  omx_vdec::empty_this_buffer_proxy(OMX_IN OMX_HANDLETYPE         h
     {
         DEBUG_PRINT_HIGH("Rxd i/p EOS, Notify Driver that EOS has been reached");
         frameinfo.flags |= VDEC_BUFFERFLAG_EOS;
-        h264_scratch.nFilledLen = 0;
-        nal_count = 0;
-        look_ahead_nal = false;
-        frame_count = 0;
-        if (m_frame_parser.mutils)
-            m_frame_parser.mutils->initialize_frame_checking_environment();
-        m_frame_parser.flush();
-        h264_last_au_ts = LLONG_MAX;
-        h264_last_au_flags = 0;
+        m_au_assembler.reset();
         memset(m_demux_offsets, 0, ( sizeof(OMX_U32) * 8192) );
         m_demux_entries = 0;
     }
@@ -6765,11 +6600,7 @@ OMX_ERRORTYPE  omx_vdec::component_deinit(OMX_IN OMX_HANDLETYPE hComp)
     }
     free_input_buffer_header();
     free_output_buffer_header();
-    if(h264_scratch.pBuffer)
-    {
-        free(h264_scratch.pBuffer);
-        h264_scratch.pBuffer = NULL;
-    }
+    m_au_assembler.deallocate();
 
     if (h264_parser)
     {
@@ -6802,7 +6633,7 @@ OMX_ERRORTYPE  omx_vdec::component_deinit(OMX_IN OMX_HANDLETYPE hComp)
 #ifdef _ANDROID_
     if (m_debug_timestamp)
     {
-        m_timestamp_list.reset_ts_list();
+        m_timestamp_list.reset();
     }
 #endif
 
@@ -7288,7 +7119,7 @@ OMX_ERRORTYPE omx_vdec::fill_buffer_done(OMX_HANDLETYPE hComp,
         {
             {
                 OMX_TICKS expected_ts = 0;
-                m_timestamp_list.pop_min_ts(expected_ts);
+                m_timestamp_list.pop_min(expected_ts);
                 DEBUG_PRINT_LOW("Current timestamp (%lld),Popped TIMESTAMP (%lld) from list",
                     buffer->nTimeStamp, expected_ts);
 
@@ -7873,7 +7704,7 @@ OMX_ERRORTYPE omx_vdec::push_input_buffer (OMX_HANDLETYPE hComp)
         switch (codec_type_parse)
         {
         case CODEC_TYPE_HEVC:
-            ret = push_input_hevc(hComp);
+            ret = m_au_assembler.push(psource_frame, pdest_frame);
             break;
         default:
             break;
@@ -7889,208 +7720,44 @@ OMX_ERRORTYPE omx_vdec::push_input_buffer (OMX_HANDLETYPE hComp)
     return ret;
 }
 
-OMX_ERRORTYPE copy_buffer(OMX_BUFFERHEADERTYPE* pDst, OMX_BUFFERHEADERTYPE* pSrc)
+OMX_ERRORTYPE omx_vdec::au_ready(OMX_BUFFERHEADERTYPE *dest)
 {
-    OMX_ERRORTYPE rc = OMX_ErrorNone;
-    if ((pDst->nAllocLen - pDst->nFilledLen) >= pSrc->nFilledLen)
-    {
-        memcpy ((pDst->pBuffer + pDst->nFilledLen), pSrc->pBuffer, pSrc->nFilledLen);
-        if (pDst->nTimeStamp == LLONG_MAX)
-        {
-            pDst->nTimeStamp = pSrc->nTimeStamp;
-            DEBUG_PRINT_LOW("Assign Dst nTimeStamp=%lld", pDst->nTimeStamp);
-        }
-        pDst->nFilledLen += pSrc->nFilledLen;
-        pSrc->nFilledLen = 0;
-    }
-    else
-    {
-        DEBUG_PRINT_ERROR("Error: Destination buffer overflow");
-        rc = OMX_ErrorBadParameter;
-    }
-    return rc;
+    return empty_this_buffer_proxy(&m_cmp, dest);
 }
 
-OMX_ERRORTYPE omx_vdec::push_input_hevc (OMX_HANDLETYPE hComp)
+OMX_BUFFERHEADERTYPE *omx_vdec::get_free_dest()
 {
-    OMX_U32 partial_frame = 1;
     unsigned long address,p2,id;
-    OMX_BOOL isNewFrame = OMX_FALSE;
-    OMX_BOOL generate_ebd = OMX_TRUE;
-    OMX_ERRORTYPE rc = OMX_ErrorNone;
 
-    if (h264_scratch.pBuffer == NULL)
+    if (!m_input_free_q.m_size)
     {
-        DEBUG_PRINT_ERROR("ERROR:Hevc Scratch Buffer not allocated");
-        return OMX_ErrorBadParameter;
-    }
-
-
-    DEBUG_PRINT_LOW("h264_scratch.nFilledLen %lu has look_ahead_nal %d pdest_frame nFilledLen %lu nTimeStamp %lld",
-        h264_scratch.nFilledLen, look_ahead_nal, pdest_frame->nFilledLen, pdest_frame->nTimeStamp);
-
-    if (h264_scratch.nFilledLen && look_ahead_nal)
-    {
-        look_ahead_nal = false;
-
-        // copy the lookahead buffer in the scratch
-        rc = copy_buffer(pdest_frame, &h264_scratch);
-        if (rc != OMX_ErrorNone)
-        {
-            return rc;
-        }
-    }
-    if (nal_length == 0)
-    {
-        if (m_frame_parser.parse_sc_frame(psource_frame,
-            &h264_scratch,&partial_frame) == -1)
-        {
-            DEBUG_PRINT_ERROR("Error In Parsing Return Error");
-            return OMX_ErrorBadParameter;
-        }
-    }
-    else
-    {
-        DEBUG_PRINT_LOW("Non-zero NAL length clip, hence parse with NAL size %d",nal_length);
-        if (m_frame_parser.parse_h264_nallength(psource_frame,
-            &h264_scratch,&partial_frame) == -1)
-        {
-            DEBUG_PRINT_ERROR("Error In Parsing NAL size, Return Error");
-            return OMX_ErrorBadParameter;
-        }
+        return NULL;
     }
+    m_input_free_q.pop_entry(&address,&p2,&id);
+    return (OMX_BUFFERHEADERTYPE *)address;
+}
 
-    if (partial_frame == 0)
-    {
-        if (nal_count == 0 && h264_scratch.nFilledLen == 0)
-        {
-            DEBUG_PRINT_LOW("First NAL with Zero Length, hence Skip");
-            nal_count++;
-            h264_scratch.nTimeStamp = psource_frame->nTimeStamp;
-            h264_scratch.nFlags = psource_frame->nFlags;
-        }
-        else
-        {
-            DEBUG_PRINT_LOW("Parsed New NAL Length = %lu",h264_scratch.nFilledLen);
-            if(h264_scratch.nFilledLen)
-            {
-                mHEVCutils.isNewFrame(&h264_scratch, 0, isNewFrame);
-                nal_count++;
-            }
+void omx_vdec::return_dest(OMX_BUFFERHEADERTYPE *dest)
+{
+    m_input_free_q.insert_entry((unsigned long) dest, (unsigned long)NULL,
+        (unsigned long)NULL);
+}
 
-            if (!isNewFrame)
-            {
-                DEBUG_PRINT_LOW("Not a new frame, copy h264_scratch nFilledLen %lu nTimestamp %lld, pdest_frame nFilledLen %lu nTimestamp %lld",
-                    h264_scratch.nFilledLen, h264_scratch.nTimeStamp, pdest_frame->nFilledLen, pdest_frame->nTimeStamp);
-                rc = copy_buffer(pdest_frame, &h264_scratch);
-                if ( rc != OMX_ErrorNone)
-                {
-                    return rc;
-                }
-            }
-            else
-            {
-                look_ahead_nal = true;
-                if (pdest_frame->nFilledLen == 0)
-                {
-                    look_ahead_nal = false;
-                    DEBUG_PRINT_LOW("dest nation buffer empty, copy scratch buffer");
-                    rc = copy_buffer(pdest_frame, &h264_scratch);
-                    if ( rc != OMX_ErrorNone )
-                    {
-                        return OMX_ErrorBadParameter;
-                    }
-                }
-                else
-                {
-                    if(psource_frame->nFilledLen || h264_scratch.nFilledLen)
-                    {
-                        pdest_frame->nFlags &= ~OMX_BUFFERFLAG_EOS;
-                    }
+OMX_BUFFERHEADERTYPE *omx_vdec::get_next_source()
+{
+    unsigned long address,p2,id;
 
-                    DEBUG_PRINT_LOW("FrameDetecetd # %d pdest_frame nFilledLen %lu nTimeStamp %lld, look_ahead_nal in h264_scratch nFilledLen %lu nTimeStamp %lld",
-                        frame_count++, pdest_frame->nFilledLen, pdest_frame->nTimeStamp, h264_scratch.nFilledLen, h264_scratch.nTimeStamp);
-                    if (empty_this_buffer_proxy(hComp,pdest_frame) != OMX_ErrorNone)
-                    {
-                        return OMX_ErrorBadParameter;
-                    }
-                    pdest_frame = NULL;
-                    if (m_input_free_q.m_size)
-                    {
-                        m_input_free_q.pop_entry(&address,&p2,&id);
-                        pdest_frame = (OMX_BUFFERHEADERTYPE *) address;
-                        DEBUG_PRINT_LOW("pop the next pdest_buffer %p",pdest_frame);
-                        pdest_frame->nFilledLen = 0;
-                        pdest_frame->nFlags = 0;
-                        pdest_frame->nTimeStamp = LLONG_MAX;
-                    }
-                }
-            }
-        }
-    }
-    else
+    if (!m_input_pending_q.m_size)
     {
-        DEBUG_PRINT_LOW("psource_frame is partial nFilledLen %lu nTimeStamp %lld, pdest_frame nFilledLen %lu nTimeStamp %lld, h264_scratch nFilledLen %lu nTimeStamp %lld",
-            psource_frame->nFilledLen, psource_frame->nTimeStamp, pdest_frame->nFilledLen, pdest_frame->nTimeStamp, h264_scratch.nFilledLen, h264_scratch.nTimeStamp);
-
-        /*Check if Destination Buffer is full*/
-        if (h264_scratch.nAllocLen ==
-            h264_scratch.nFilledLen + h264_scratch.nOffset)
-        {
-            DEBUG_PRINT_ERROR("ERROR: Frame Not found though Destination Filled");
-            return OMX_ErrorStreamCorrupt;
-        }
+        return NULL;
     }
+    m_input_pending_q.pop_entry(&address,&p2,&id);
+    return (OMX_BUFFERHEADERTYPE *)address;
+}
 
-    if (!psource_frame->nFilledLen)
-    {
-        DEBUG_PRINT_LOW("Buffer Consumed return source %p back to client",psource_frame);
-
-        if (psource_frame->nFlags & OMX_BUFFERFLAG_EOS)
-        {
-            if (pdest_frame)
-            {
-                DEBUG_PRINT_LOW("EOS Reached Pass Last Buffer");
-                rc = copy_buffer(pdest_frame, &h264_scratch);
-                if ( rc != OMX_ErrorNone )
-                {
-                    return rc;
-                }
-                pdest_frame->nTimeStamp = h264_scratch.nTimeStamp;
-                pdest_frame->nFlags = h264_scratch.nFlags | psource_frame->nFlags;
-
-
-                DEBUG_PRINT_ERROR("Push EOS frame number:%d nFilledLen =%lu TimeStamp = %lld nFlags %lu",
-                    frame_count++, pdest_frame->nFilledLen,pdest_frame->nTimeStamp, pdest_frame->nFlags);
-
-                /*Push the frame to the Decoder*/
-                if (empty_this_buffer_proxy(hComp,pdest_frame) != OMX_ErrorNone)
-                {
-                    return OMX_ErrorBadParameter;
-                }
-                pdest_frame = NULL;
-            }
-            else
-            {
-                DEBUG_PRINT_LOW("Last frame in else dest addr %p size %lu frame_count %d",
-                    pdest_frame,h264_scratch.nFilledLen, frame_count);
-                generate_ebd = OMX_FALSE;
-            }
-        }
-    }
-    if(generate_ebd && !psource_frame->nFilledLen)
-    {
-        m_cb.EmptyBufferDone (hComp,m_app_data,psource_frame);
-        psource_frame = NULL;
-        if (m_input_pending_q.m_size)
-        {
-            m_input_pending_q.pop_entry(&address,&p2,&id);
-            psource_frame = (OMX_BUFFERHEADERTYPE *) address;
-            DEBUG_PRINT_LOW("Next source Buffer flag %lu nFilledLen %lu, nTimeStamp %lld",
-                psource_frame->nFlags,psource_frame->nFilledLen, psource_frame->nTimeStamp);
-        }
-    }
-    return OMX_ErrorNone;
+void omx_vdec::source_done(OMX_BUFFERHEADERTYPE *source)
+{
+    m_cb.EmptyBufferDone(&m_cmp, m_app_data, source);
 }
 
 bool omx_vdec::align_pmem_buffers(int pmem_fd, OMX_U32 buffer_size,
@@ -8237,13 +7904,6 @@ void omx_vdec::free_input_buffer_header()
     input_use_buffer = false;
     if (arbitrary_bytes)
     {
-        if (m_frame_parser.mutils)
-        {
-            DEBUG_PRINT_LOW("Free utils parser");
-            delete (m_frame_parser.mutils);
-            m_frame_parser.mutils = NULL;
-        }
-
         if (m_inp_heap_ptr)
         {
             DEBUG_PRINT_LOW("Free input Heap Pointer");
@@ -9689,6 +9349,13 @@ OMX_ERRORTYPE omx_vdec::allocate_color_convert_buf::free_output_buffer(
         DEBUG_PRINT_ERROR("Incorrect index color convert free_output_buffer");
         return OMX_ErrorBadParameter;
     }
+    /* Drop the converter's GPU mappings before the memory goes away */
+    pthread_mutex_lock(&omx->c_lock);
+    c2d.release_buffer(omx->drv_ctx.ptr_outputbuffer[index].pmem_fd,
+            omx->m_out_mem_ptr->pBuffer);
+    if (pmem_fd[index] > 0)
+        c2d.release_buffer(pmem_fd[index], pmem_baseaddress[index]);
+    pthread_mutex_unlock(&omx->c_lock);
     if (pmem_fd[index] > 0) {
         munmap(pmem_baseaddress[index], buffer_size_req);
         close(pmem_fd[index]);
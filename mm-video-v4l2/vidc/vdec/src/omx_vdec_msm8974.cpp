@@ -166,6 +166,9 @@ void* async_message_thread (void *input)
             v4l2_buf.length = omx->drv_ctx.num_planes;
             v4l2_buf.m.planes = plane;
             while (!ioctl(pfd.fd, VIDIOC_DQBUF, &v4l2_buf)) {
+                if (plane[0].bytesused)
+                    omx->m_trace.record(VIDC_TRACE_DQBUF_OUT, v4l2_buf.index,
+                            ((int64_t)v4l2_buf.timestamp.tv_sec * 1000000) + v4l2_buf.timestamp.tv_usec);
                 vdec_msg.msgcode=VDEC_MSG_RESP_OUTPUT_BUFFER_DONE;
                 vdec_msg.status_code=VDEC_S_SUCCESS;
                 vdec_msg.msgdata.output_frame.client_data=(void*)&v4l2_buf;
@@ -194,6 +197,8 @@ void* async_message_thread (void *input)
             v4l2_buf.length = 1;
             v4l2_buf.m.planes = plane;
             while (!ioctl(pfd.fd, VIDIOC_DQBUF, &v4l2_buf)) {
+                omx->m_trace.record(VIDC_TRACE_DQBUF_IN, v4l2_buf.index,
+                        ((int64_t)v4l2_buf.timestamp.tv_sec * 1000000) + v4l2_buf.timestamp.tv_usec);
                 vdec_msg.msgcode=VDEC_MSG_RESP_INPUT_BUFFER_DONE;
                 vdec_msg.status_code=VDEC_S_SUCCESS;
                 vdec_msg.msgdata.input_frame_clientdata=(void*)&v4l2_buf;
@@ -303,26 +308,11 @@ void* async_message_thread (void *input)
 void* dec_message_thread(void *input)
 {
     omx_vdec* omx = reinterpret_cast<omx_vdec*>(input);
-    unsigned char id;
-    int n;
 
     DEBUG_PRINT_HIGH("omx_vdec: message thread start");
     prctl(PR_SET_NAME, (unsigned long)"VideoDecMsgThread", 0, 0, 0);
-    while (1) {
-
-        n = read(omx->m_pipe_in, &id, 1);
-
-        if (0 == n) {
-            break;
-        }
-
-        if (1 == n) {
-            omx->process_event_cb(omx, id);
-        }
-        if ((n < 0) && (errno != EINTR)) {
-            DEBUG_PRINT_LOW("ERROR: read from pipe failed, ret %d errno %d", n, errno);
-            break;
-        }
+    while (omx->m_msg_notifier.wait()) {
+        omx->process_event_cb(omx, 0);
     }
     DEBUG_PRINT_HIGH("omx_vdec: message thread stop");
     return 0;
@@ -330,10 +320,8 @@ void* dec_message_thread(void *input)
 
 void post_message(omx_vdec *omx, unsigned char id)
 {
-    int ret_value;
-    DEBUG_PRINT_LOW("omx_vdec: post_message %d pipe out%d", id,omx->m_pipe_out);
-    ret_value = write(omx->m_pipe_out, &id, 1);
-    DEBUG_PRINT_LOW("post_message to pipe done %d",ret_value);
+    bool woken = omx->m_msg_notifier.notify();
+    DEBUG_PRINT_LOW("omx_vdec: post_message %d wake %d", id, woken);
 }
 
 // omx_cmd_queue destructor
@@ -394,95 +382,6 @@ unsigned omx_vdec::omx_cmd_queue::get_q_msg_type()
     return m_q[m_read].id;
 }
 
-#ifdef _ANDROID_
-omx_vdec::ts_arr_list::ts_arr_list()
-{
-    //initialize timestamps array
-    memset(m_ts_arr_list, 0, ( sizeof(ts_entry) * MAX_NUM_INPUT_OUTPUT_BUFFERS) );
-}
-omx_vdec::ts_arr_list::~ts_arr_list()
-{
-    //free m_ts_arr_list?
-}
-
-bool omx_vdec::ts_arr_list::insert_ts(OMX_TICKS ts)
-{
-    bool ret = true;
-    bool duplicate_ts = false;
-    int idx = 0;
-
-    //insert at the first available empty location
-    for ( ; idx < MAX_NUM_INPUT_OUTPUT_BUFFERS; idx++) {
-        if (!m_ts_arr_list[idx].valid) {
-            //found invalid or empty entry, save timestamp
-            m_ts_arr_list[idx].valid = true;
-            m_ts_arr_list[idx].timestamp = ts;
-            DEBUG_PRINT_LOW("Insert_ts(): Inserting TIMESTAMP (%lld) at idx (%d)",
-                    ts, idx);
-            break;
-        }
-    }
-
-    if (idx == MAX_NUM_INPUT_OUTPUT_BUFFERS) {
-        DEBUG_PRINT_LOW("Timestamp array list is FULL. Unsuccessful insert");
-        ret = false;
-    }
-    return ret;
-}
-
-bool omx_vdec::ts_arr_list::pop_min_ts(OMX_TICKS &ts)
-{
-    bool ret = true;
-    int min_idx = -1;
-    OMX_TICKS min_ts = 0;
-    int idx = 0;
-
-    for ( ; idx < MAX_NUM_INPUT_OUTPUT_BUFFERS; idx++) {
-
-        if (m_ts_arr_list[idx].valid) {
-            //found valid entry, save index
-            if (min_idx < 0) {
-                //first valid entry
-                min_ts = m_ts_arr_list[idx].timestamp;
-                min_idx = idx;
-            } else if (m_ts_arr_list[idx].timestamp < min_ts) {
-                min_ts = m_ts_arr_list[idx].timestamp;
-                min_idx = idx;
-            }
-        }
-
-    }
-
-    if (min_idx < 0) {
-        //no valid entries found
-        DEBUG_PRINT_LOW("Timestamp array list is empty. Unsuccessful pop");
-        ts = 0;
-        ret = false;
-    } else {
-        ts = m_ts_arr_list[min_idx].timestamp;
-        m_ts_arr_list[min_idx].valid = false;
-        DEBUG_PRINT_LOW("Pop_min_ts:Timestamp (%lld), index(%d)",
-                ts, min_idx);
-    }
-
-    return ret;
-
-}
-
-
-bool omx_vdec::ts_arr_list::reset_ts_list()
-{
-    bool ret = true;
-    int idx = 0;
-
-    DEBUG_PRINT_LOW("reset_ts_list(): Resetting timestamp array list");
-    for ( ; idx < MAX_NUM_INPUT_OUTPUT_BUFFERS; idx++) {
-        m_ts_arr_list[idx].valid = false;
-    }
-    return ret;
-}
-#endif
-
 // factory function executed by the core to create instances
 void *get_omx_component_factory_fn(void)
 {
@@ -560,17 +459,13 @@ omx_vdec::omx_vdec(): m_error_propogated(false),
     m_heap_inp_bm_count (0),
     codec_type_parse ((codec_type)0),
     first_frame_meta (true),
-    frame_count (0),
-    nal_count (0),
     nal_length(0),
-    look_ahead_nal (false),
+    m_h264_zero_copy(false),
     first_frame(0),
     first_buffer(NULL),
     first_frame_size (0),
     m_device_file_ptr(NULL),
     m_vc1_profile((vc1_profile_type)0),
-    h264_last_au_ts(LLONG_MAX),
-    h264_last_au_flags(0),
     m_disp_hor_size(0),
     m_disp_vert_size(0),
     prev_ts(LLONG_MAX),
@@ -589,6 +484,9 @@ omx_vdec::omx_vdec(): m_error_propogated(false),
     m_desc_buffer_ptr(NULL),
     secure_mode(false),
     m_other_extradata(NULL),
+    m_lazy_extradata(false),
+    m_extradata_index(NULL),
+    m_extradata_index_count(0),
     m_profile(0),
     client_set_fps(false),
     m_last_rendered_TS(-1),
@@ -628,6 +526,12 @@ omx_vdec::omx_vdec(): m_error_propogated(false),
     m_debug_concealedmb = atoi(property_value);
     DEBUG_PRINT_HIGH("vidc.dec.debug.concealedmb value is %d",m_debug_concealedmb);
 
+    property_value[0] = '\0';
+    property_get("vidc.dec.debug.trace", property_value, "0");
+    if (!m_trace.init(atoi(property_value)))
+        DEBUG_PRINT_ERROR("Failed to allocate the latency trace");
+    DEBUG_PRINT_HIGH("vidc.dec.debug.trace value is %d", m_trace.enabled());
+
     property_value[0] = '\0';
     property_get("vidc.dec.profile.check", property_value, "0");
     m_reject_avc_1080p_mp = atoi(property_value);
@@ -661,11 +565,16 @@ omx_vdec::omx_vdec(): m_error_propogated(false),
     m_disable_dynamic_buf_mode = atoi(property_value);
     DEBUG_PRINT_HIGH("vidc.dec.debug.dyn.disabled value is %d",m_disable_dynamic_buf_mode);
 
+    property_value[0] = '\0';
+    property_get("vidc.dec.arbitrarybytes.zerocopy", property_value, "1");
+    m_h264_zero_copy = atoi(property_value);
+    DEBUG_PRINT_HIGH("vidc.dec.arbitrarybytes.zerocopy value is %d",m_h264_zero_copy);
+
 #endif
     memset(&m_cmp,0,sizeof(m_cmp));
     memset(&m_cb,0,sizeof(m_cb));
     memset (&drv_ctx,0,sizeof(drv_ctx));
-    memset (&h264_scratch,0,sizeof (OMX_BUFFERHEADERTYPE));
+    m_au_assembler.set_zero_copy(m_h264_zero_copy);
     memset (m_hwdevice_name,0,sizeof(m_hwdevice_name));
     memset(m_demux_offsets, 0, ( sizeof(OMX_U32) * 8192) );
     memset(&m_custom_buffersize, 0, sizeof(m_custom_buffersize));
@@ -678,6 +587,8 @@ omx_vdec::omx_vdec(): m_error_propogated(false),
     memset(&native_buffer, 0 ,(sizeof(struct nativebuffer) * MAX_NUM_INPUT_OUTPUT_BUFFERS));
 #endif
     memset(&drv_ctx.extradata_info, 0, sizeof(drv_ctx.extradata_info));
+    m_extradata_writer.init(OMX_SPEC_VERSION, OMX_CORE_OUTPUT_PORT_INDEX);
+    update_extradata_templates();
 
     /* invalidate m_frame_pack_arrangement */
     memset(&m_frame_pack_arrangement, 0, sizeof(OMX_QCOM_FRAME_PACK_ARRANGEMENT));
@@ -701,12 +612,14 @@ omx_vdec::omx_vdec(): m_error_propogated(false),
     m_fill_output_msg = OMX_COMPONENT_GENERATE_FTB;
     client_buffers.set_vdec_client(this);
     dynamic_buf_mode = false;
-    out_dynamic_list = NULL;
     is_down_scalar_enabled = false;
     m_smoothstreaming_mode = false;
     m_smoothstreaming_width = 0;
     m_smoothstreaming_height = 0;
     is_q6_platform = false;
+#ifdef USE_ION
+    vidc_buffer_pool::instance()->attach();
+#endif
     m_perf_control.send_hint_to_mpctl(true);
 }
 
@@ -797,10 +710,7 @@ omx_vdec::~omx_vdec()
     m_pmem_info = NULL;
     struct v4l2_decoder_cmd dec;
     DEBUG_PRINT_HIGH("In OMX vdec Destructor");
-    if (m_pipe_in) close(m_pipe_in);
-    if (m_pipe_out) close(m_pipe_out);
-    m_pipe_in = -1;
-    m_pipe_out = -1;
+    m_msg_notifier.stop();
     DEBUG_PRINT_HIGH("Waiting on OMX Msg Thread exit");
     if (msg_thread_created)
         pthread_join(msg_thread_id,NULL);
@@ -821,6 +731,9 @@ omx_vdec::~omx_vdec()
         DEBUG_PRINT_HIGH("--> TOTAL PROCESSING TIME");
         dec_time.end();
     }
+#ifdef USE_ION
+    vidc_buffer_pool::instance()->detach();
+#endif
     DEBUG_PRINT_INFO("Exit OMX vdec Destructor: fd=%d",drv_ctx.video_driver_fd);
     m_perf_control.send_hint_to_mpctl(false);
 }
@@ -1574,7 +1487,6 @@ OMX_ERRORTYPE omx_vdec::component_init(OMX_STRING role)
     struct v4l2_control control;
     struct v4l2_frmsizeenum frmsize;
     unsigned int   alignment = 0,buffer_size = 0;
-    int fds[2];
     int r,ret=0;
     bool codec_ambiguous = false;
     OMX_STRING device_name = (OMX_STRING)"/dev/video32";
@@ -1681,7 +1593,7 @@ OMX_ERRORTYPE omx_vdec::component_init(OMX_STRING role)
         output_capability=V4L2_PIX_FMT_MPEG4;
         /*Initialize Start Code for MPEG4*/
         codec_type_parse = CODEC_TYPE_MPEG4;
-        m_frame_parser.init_start_codes(codec_type_parse);
+        m_au_assembler.init(codec_type_parse, this);
     } else if (!strncmp(drv_ctx.kind,"OMX.qcom.video.decoder.mpeg2",\
                 OMX_MAX_STRINGNAME_SIZE)) {
         strlcpy((char *)m_cRole, "video_decoder.mpeg2",\
@@ -1691,7 +1603,7 @@ OMX_ERRORTYPE omx_vdec::component_init(OMX_STRING role)
         eCompressionFormat = OMX_VIDEO_CodingMPEG2;
         /*Initialize Start Code for MPEG2*/
         codec_type_parse = CODEC_TYPE_MPEG2;
-        m_frame_parser.init_start_codes(codec_type_parse);
+        m_au_assembler.init(codec_type_parse, this);
     } else if (!strncmp(drv_ctx.kind, "OMX.qcom.video.decoder.h263",\
                 OMX_MAX_STRINGNAME_SIZE)) {
         strlcpy((char *)m_cRole, "video_decoder.h263",OMX_MAX_STRINGNAME_SIZE);
@@ -1700,7 +1612,7 @@ OMX_ERRORTYPE omx_vdec::component_init(OMX_STRING role)
         eCompressionFormat = OMX_VIDEO_CodingH263;
         output_capability = V4L2_PIX_FMT_H263;
         codec_type_parse = CODEC_TYPE_H263;
-        m_frame_parser.init_start_codes(codec_type_parse);
+        m_au_assembler.init(codec_type_parse, this);
     } else if (!strncmp(drv_ctx.kind, "OMX.qcom.video.decoder.divx311",\
                 OMX_MAX_STRINGNAME_SIZE)) {
         strlcpy((char *)m_cRole, "video_decoder.divx",OMX_MAX_STRINGNAME_SIZE);
@@ -1709,7 +1621,7 @@ OMX_ERRORTYPE omx_vdec::component_init(OMX_STRING role)
         output_capability = V4L2_PIX_FMT_DIVX_311;
         eCompressionFormat = (OMX_VIDEO_CODINGTYPE)QOMX_VIDEO_CodingDivx;
         codec_type_parse = CODEC_TYPE_DIVX;
-        m_frame_parser.init_start_codes(codec_type_parse);
+        m_au_assembler.init(codec_type_parse, this);
 
         eRet = createDivxDrmContext();
         if (eRet != OMX_ErrorNone) {
@@ -1725,7 +1637,7 @@ OMX_ERRORTYPE omx_vdec::component_init(OMX_STRING role)
         eCompressionFormat = (OMX_VIDEO_CODINGTYPE)QOMX_VIDEO_CodingDivx;
         codec_type_parse = CODEC_TYPE_DIVX;
         codec_ambiguous = true;
-        m_frame_parser.init_start_codes(codec_type_parse);
+        m_au_assembler.init(codec_type_parse, this);
 
         eRet = createDivxDrmContext();
         if (eRet != OMX_ErrorNone) {
@@ -1741,7 +1653,7 @@ OMX_ERRORTYPE omx_vdec::component_init(OMX_STRING role)
         eCompressionFormat = (OMX_VIDEO_CODINGTYPE)QOMX_VIDEO_CodingDivx;
         codec_type_parse = CODEC_TYPE_DIVX;
         codec_ambiguous = true;
-        m_frame_parser.init_start_codes(codec_type_parse);
+        m_au_assembler.init(codec_type_parse, this);
 
         eRet = createDivxDrmContext();
         if (eRet != OMX_ErrorNone) {
@@ -1755,8 +1667,7 @@ OMX_ERRORTYPE omx_vdec::component_init(OMX_STRING role)
         output_capability=V4L2_PIX_FMT_H264;
         eCompressionFormat = OMX_VIDEO_CodingAVC;
         codec_type_parse = CODEC_TYPE_H264;
-        m_frame_parser.init_start_codes(codec_type_parse);
-        m_frame_parser.init_nal_length(nal_length);
+        m_au_assembler.init(codec_type_parse, this);
     } else if (!strncmp(drv_ctx.kind, "OMX.qcom.video.decoder.mvc",\
                 OMX_MAX_STRINGNAME_SIZE)) {
         strlcpy((char *)m_cRole, "video_decoder.mvc", OMX_MAX_STRINGNAME_SIZE);
@@ -1764,8 +1675,7 @@ OMX_ERRORTYPE omx_vdec::component_init(OMX_STRING role)
         output_capability = V4L2_PIX_FMT_H264_MVC;
         eCompressionFormat = (OMX_VIDEO_CODINGTYPE)QOMX_VIDEO_CodingMVC;
         codec_type_parse = CODEC_TYPE_H264;
-        m_frame_parser.init_start_codes(codec_type_parse);
-        m_frame_parser.init_nal_length(nal_length);
+        m_au_assembler.init(codec_type_parse, this);
     } else if (!strncmp(drv_ctx.kind, "OMX.qcom.video.decoder.hevc",\
                 OMX_MAX_STRINGNAME_SIZE)) {
         strlcpy((char *)m_cRole, "video_decoder.hevc",OMX_MAX_STRINGNAME_SIZE);
@@ -1773,8 +1683,7 @@ OMX_ERRORTYPE omx_vdec::component_init(OMX_STRING role)
         output_capability = V4L2_PIX_FMT_HEVC;
         eCompressionFormat = (OMX_VIDEO_CODINGTYPE)QOMX_VIDEO_CodingHevc;
         codec_type_parse = CODEC_TYPE_HEVC;
-        m_frame_parser.init_start_codes(codec_type_parse);
-        m_frame_parser.init_nal_length(nal_length);
+        m_au_assembler.init(codec_type_parse, this);
     } else if (!strncmp(drv_ctx.kind, "OMX.qcom.video.decoder.vc1",\
                 OMX_MAX_STRINGNAME_SIZE)) {
         strlcpy((char *)m_cRole, "video_decoder.vc1",OMX_MAX_STRINGNAME_SIZE);
@@ -1782,7 +1691,7 @@ OMX_ERRORTYPE omx_vdec::component_init(OMX_STRING role)
         eCompressionFormat = OMX_VIDEO_CodingWMV;
         codec_type_parse = CODEC_TYPE_VC1;
         output_capability = V4L2_PIX_FMT_VC1_ANNEX_G;
-        m_frame_parser.init_start_codes(codec_type_parse);
+        m_au_assembler.init(codec_type_parse, this);
     } else if (!strncmp(drv_ctx.kind, "OMX.qcom.video.decoder.wmv",\
                 OMX_MAX_STRINGNAME_SIZE)) {
         strlcpy((char *)m_cRole, "video_decoder.vc1",OMX_MAX_STRINGNAME_SIZE);
@@ -1790,7 +1699,7 @@ OMX_ERRORTYPE omx_vdec::component_init(OMX_STRING role)
         eCompressionFormat = OMX_VIDEO_CodingWMV;
         codec_type_parse = CODEC_TYPE_VC1;
         output_capability = V4L2_PIX_FMT_VC1_ANNEX_L;
-        m_frame_parser.init_start_codes(codec_type_parse);
+        m_au_assembler.init(codec_type_parse, this);
     } else if (!strncmp(drv_ctx.kind, "OMX.qcom.video.decoder.vp8",    \
                 OMX_MAX_STRINGNAME_SIZE)) {
         strlcpy((char *)m_cRole, "video_decoder.vp8",OMX_MAX_STRINGNAME_SIZE);
@@ -1987,29 +1896,13 @@ OMX_ERRORTYPE omx_vdec::component_init(OMX_STRING role)
         if (drv_ctx.decoder_format == VDEC_CODECTYPE_H264 ||
                 drv_ctx.decoder_format == VDEC_CODECTYPE_HEVC ||
                 drv_ctx.decoder_format == VDEC_CODECTYPE_MVC) {
-                    h264_scratch.nAllocLen = drv_ctx.ip_buf.buffer_size;
-                    h264_scratch.pBuffer = (OMX_U8 *)malloc (drv_ctx.ip_buf.buffer_size);
-                    h264_scratch.nFilledLen = 0;
-                    h264_scratch.nOffset = 0;
-
-                    if (h264_scratch.pBuffer == NULL) {
-                        DEBUG_PRINT_ERROR("h264_scratch.pBuffer Allocation failed ");
+                    if (!m_au_assembler.allocate(drv_ctx.ip_buf.buffer_size)) {
+                        DEBUG_PRINT_ERROR("AU assembler allocation failed ");
                         return OMX_ErrorInsufficientResources;
                     }
         }
         if (drv_ctx.decoder_format == VDEC_CODECTYPE_H264 ||
             drv_ctx.decoder_format == VDEC_CODECTYPE_MVC) {
-            if (m_frame_parser.mutils == NULL) {
-                m_frame_parser.mutils = new H264_Utils();
-                if (m_frame_parser.mutils == NULL) {
-                    DEBUG_PRINT_ERROR("parser utils Allocation failed ");
-                    eRet = OMX_ErrorInsufficientResources;
-                } else {
-                    m_frame_parser.mutils->initialize_frame_checking_environment();
-                    m_frame_parser.mutils->allocate_rbsp_buffer (drv_ctx.ip_buf.buffer_size);
-                }
-            }
-
             h264_parser = new h264_stream_parser();
             if (!h264_parser) {
                 DEBUG_PRINT_ERROR("ERROR: H264 parser allocation failed!");
@@ -2017,23 +1910,10 @@ OMX_ERRORTYPE omx_vdec::component_init(OMX_STRING role)
             }
         }
 
-        if (pipe(fds)) {
-            DEBUG_PRINT_ERROR("pipe creation failed");
+        if (!m_msg_notifier.init()) {
+            DEBUG_PRINT_ERROR("eventfd creation failed");
             eRet = OMX_ErrorInsufficientResources;
         } else {
-            int temp1[2];
-            if (fds[0] == 0 || fds[1] == 0) {
-                if (pipe (temp1)) {
-                    DEBUG_PRINT_ERROR("pipe creation failed");
-                    return OMX_ErrorInsufficientResources;
-                }
-                //close (fds[0]);
-                //close (fds[1]);
-                fds[0] = temp1 [0];
-                fds[1] = temp1 [1];
-            }
-            m_pipe_in = fds[0];
-            m_pipe_out = fds[1];
             msg_thread_created = true;
             r = pthread_create(&msg_thread_id,0, dec_message_thread,this);
 
@@ -2731,21 +2611,17 @@ bool omx_vdec::execute_input_flush()
         }
     }
     time_stamp_dts.flush_timestamp();
+    /* Source buffers held by the zero copy assembler go back on every flush,
+       a pending codec config NAL is kept in the scratch buffer */
+    if (arbitrary_bytes) {
+        m_au_assembler.release_sources();
+    }
     /*Check if Heap Buffers are to be flushed*/
     if (arbitrary_bytes && !(codec_config_flag)) {
         DEBUG_PRINT_LOW("Reset all the variables before flusing");
-        h264_scratch.nFilledLen = 0;
-        nal_count = 0;
-        look_ahead_nal = false;
-        frame_count = 0;
-        h264_last_au_ts = LLONG_MAX;
-        h264_last_au_flags = 0;
+        m_au_assembler.reset();
         memset(m_demux_offsets, 0, ( sizeof(OMX_U32) * 8192) );
         m_demux_entries = 0;
-        DEBUG_PRINT_LOW("Initialize parser");
-        if (m_frame_parser.mutils) {
-            m_frame_parser.mutils->initialize_frame_checking_environment();
-        }
 
         while (m_input_pending_q.m_size) {
             m_input_pending_q.pop_entry(&p1,&p2,&ident);
@@ -2763,7 +2639,6 @@ bool omx_vdec::execute_input_flush()
                     (unsigned int)NULL);
             pdest_frame = NULL;
         }
-        m_frame_parser.flush();
     } else if (codec_config_flag) {
         DEBUG_PRINT_HIGH("frame_parser flushing skipped due to codec config buffer "
                 "is not sent to the driver yet");
@@ -2776,7 +2651,7 @@ bool omx_vdec::execute_input_flush()
     }
 #ifdef _ANDROID_
     if (m_debug_timestamp) {
-        m_timestamp_list.reset_ts_list();
+        m_timestamp_list.reset();
     }
 #endif
     DEBUG_PRINT_HIGH("OMX flush i/p Port complete PenBuf(%d)", pending_input_buffers);
@@ -3810,6 +3685,20 @@ OMX_ERRORTYPE  omx_vdec::set_parameter(OMX_IN OMX_HANDLETYPE     hComp,
                                 eRet = enable_extradata(OMX_EXTNUSER_EXTRADATA, false,
                                     ((QOMX_ENABLETYPE *)paramData)->bEnable);
                                 break;
+        case OMX_QTIIndexParamVideoLazyExtradata: {
+                                bool enable = ((QOMX_ENABLETYPE *)paramData)->bEnable;
+                                if (m_state != OMX_StateLoaded) {
+                                    DEBUG_PRINT_ERROR("set_parameter: lazy extradata allowed in Loaded state only");
+                                    eRet = OMX_ErrorIncorrectStateOperation;
+                                } else if (enable && secure_mode) {
+                                    DEBUG_PRINT_ERROR("set_parameter: lazy extradata not supported in secure mode");
+                                    eRet = OMX_ErrorUnsupportedSetting;
+                                } else {
+                                    DEBUG_PRINT_HIGH("set_parameter: lazy extradata %d", enable);
+                                    m_lazy_extradata = enable;
+                                }
+                                break;
+                            }
         case OMX_QcomIndexParamVideoDivx: {
                               QOMX_VIDEO_PARAM_DIVXTYPE* divXType = (QOMX_VIDEO_PARAM_DIVXTYPE *) paramData;
                           }
@@ -4148,6 +4037,28 @@ OMX_ERRORTYPE  omx_vdec::get_config(OMX_IN OMX_HANDLETYPE      hComp,
                                           }
                                           break;
                                       }
+        case OMX_QTIIndexConfigVideoExtradataQuery: {
+                                  eRet = get_lazy_extradata((QOMX_VIDEO_EXTRADATA_QUERY *)configData);
+                                  break;
+                              }
+        case OMX_QTIIndexConfigVideoDynamicBufferRefs: {
+                                  QOMX_VIDEO_DYNAMIC_BUFFER_REFS *refs =
+                                      (QOMX_VIDEO_DYNAMIC_BUFFER_REFS *)configData;
+                                  if (refs->nPortIndex != OMX_CORE_OUTPUT_PORT_INDEX) {
+                                      DEBUG_PRINT_ERROR("get_config: DynamicBufferRefs bad port index %u",
+                                              (unsigned int)refs->nPortIndex);
+                                      eRet = OMX_ErrorBadPortIndex;
+                                  } else if (!dynamic_buf_mode) {
+                                      DEBUG_PRINT_ERROR("get_config: DynamicBufferRefs needs dynamic buffer mode");
+                                      eRet = OMX_ErrorUnsupportedSetting;
+                                  } else {
+                                      buf_ref_query(&refs->nBuffersHeld, &refs->nRefsHeld);
+                                      DEBUG_PRINT_LOW("get_config: firmware holds %u refs on %u buffers",
+                                              (unsigned int)refs->nRefsHeld,
+                                              (unsigned int)refs->nBuffersHeld);
+                                  }
+                                  break;
+                              }
         case OMX_IndexConfigCommonOutputCrop: {
                                   OMX_CONFIG_RECTTYPE *rect = (OMX_CONFIG_RECTTYPE *) configData;
                                   memcpy(rect, &rectangle, sizeof(OMX_CONFIG_RECTTYPE));
@@ -4353,7 +4264,7 @@ OMX_ERRORTYPE  omx_vdec::set_config(OMX_IN OMX_HANDLETYPE      hComp,
         }
 
         nal_length = pNal->nNaluBytes;
-        m_frame_parser.init_nal_length(nal_length);
+        m_au_assembler.set_nal_length(nal_length);
 
         DEBUG_PRINT_LOW("OMX_IndexConfigVideoNalSize called with Size %d", nal_length);
         return ret;
@@ -4516,6 +4427,12 @@ OMX_ERRORTYPE  omx_vdec::get_extension_index(OMX_IN OMX_HANDLETYPE      hComp,
         *indexType = (OMX_INDEXTYPE)OMX_QcomIndexParamVideoInputBitsInfoExtraData;
     } else if (extn_equals(paramName, OMX_QCOM_INDEX_PARAM_VIDEO_EXTNUSER_EXTRADATA)) {
         *indexType = (OMX_INDEXTYPE)OMX_QcomIndexEnableExtnUserData;
+    } else if (extn_equals(paramName, OMX_QTI_INDEX_PARAM_VIDEO_LAZY_EXTRADATA)) {
+        *indexType = (OMX_INDEXTYPE)OMX_QTIIndexParamVideoLazyExtradata;
+    } else if (extn_equals(paramName, OMX_QTI_INDEX_CONFIG_VIDEO_EXTRADATA_QUERY)) {
+        *indexType = (OMX_INDEXTYPE)OMX_QTIIndexConfigVideoExtradataQuery;
+    } else if (extn_equals(paramName, OMX_QTI_INDEX_CONFIG_VIDEO_DYNAMIC_BUFFER_REFS)) {
+        *indexType = (OMX_INDEXTYPE)OMX_QTIIndexConfigVideoDynamicBufferRefs;
     }
 #if defined (_ANDROID_HONEYCOMB_) || defined (_ANDROID_ICS_)
     else if (extn_equals(paramName, "OMX.google.android.index.enableAndroidNativeBuffers")) {
@@ -4653,6 +4570,15 @@ OMX_ERRORTYPE omx_vdec::allocate_extradata()
             return OMX_ErrorInsufficientResources;
         }
     }
+    if (m_lazy_extradata && !m_extradata_index) {
+        m_extradata_index = (struct vdec_extradata_index *)calloc(
+                drv_ctx.op_buf.actualcount, sizeof(*m_extradata_index));
+        if (!m_extradata_index) {
+            DEBUG_PRINT_ERROR("Failed to alloc the lazy extradata index");
+            return OMX_ErrorInsufficientResources;
+        }
+        m_extradata_index_count = drv_ctx.op_buf.actualcount;
+    }
     return OMX_ErrorNone;
 }
 
@@ -4670,6 +4596,9 @@ void omx_vdec::free_extradata()
         free(m_other_extradata);
         m_other_extradata = NULL;
     }
+    free(m_extradata_index);
+    m_extradata_index = NULL;
+    m_extradata_index_count = 0;
 }
 
 OMX_ERRORTYPE  omx_vdec::use_output_buffer(
@@ -6105,6 +6034,7 @@ OMX_ERRORTYPE  omx_vdec::empty_this_buffer(OMX_IN OMX_HANDLETYPE         hComp,
 
     DEBUG_PRINT_LOW("[ETB] BHdr(%p) pBuf(%p) nTS(%lld) nFL(%u)",
             buffer, buffer->pBuffer, buffer->nTimeStamp, (unsigned int)buffer->nFilledLen);
+    m_trace.record(VIDC_TRACE_ETB, nBufferIndex, buffer->nTimeStamp);
     if (arbitrary_bytes) {
         post_event ((unsigned long)hComp,(unsigned long)buffer,
                 OMX_COMPONENT_GENERATE_ETB_ARBITRARY);
@@ -6155,6 +6085,9 @@ OMX_ERRORTYPE  omx_vdec::empty_this_buffer_proxy(OMX_IN OMX_HANDLETYPE  hComp,
                 nPortIndex);
         return OMX_ErrorBadParameter;
     }
+    /* Arbitrary bytes traces the client buffer in empty_this_buffer_proxy_arbitrary */
+    if (!arbitrary_bytes)
+        m_trace.record(VIDC_TRACE_ETB_PROXY, nPortIndex, buffer->nTimeStamp);
 
     pending_input_buffers++;
 
@@ -6246,10 +6179,10 @@ OMX_ERRORTYPE  omx_vdec::empty_this_buffer_proxy(OMX_IN OMX_HANDLETYPE  hComp,
     if (m_debug_timestamp) {
         if (arbitrary_bytes) {
             DEBUG_PRINT_LOW("Inserting TIMESTAMP (%lld) into queue", buffer->nTimeStamp);
-            m_timestamp_list.insert_ts(buffer->nTimeStamp);
+            m_timestamp_list.insert(buffer->nTimeStamp);
         } else if (!arbitrary_bytes && !(buffer->nFlags & OMX_BUFFERFLAG_CODECCONFIG)) {
             DEBUG_PRINT_LOW("Inserting TIMESTAMP (%lld) into queue", buffer->nTimeStamp);
-            m_timestamp_list.insert_ts(buffer->nTimeStamp);
+            m_timestamp_list.insert(buffer->nTimeStamp);
         }
     }
 #endif
@@ -6264,15 +6197,7 @@ if (buffer->nFlags & QOMX_VIDEO_BUFFERFLAG_EOSEQ) {
     if (temp_buffer->buffer_len == 0 || (buffer->nFlags & OMX_BUFFERFLAG_EOS)) {
         DEBUG_PRINT_HIGH("Rxd i/p EOS, Notify Driver that EOS has been reached");
         frameinfo.flags |= VDEC_BUFFERFLAG_EOS;
-        h264_scratch.nFilledLen = 0;
-        nal_count = 0;
-        look_ahead_nal = false;
-        frame_count = 0;
-        if (m_frame_parser.mutils)
-            m_frame_parser.mutils->initialize_frame_checking_environment();
-        m_frame_parser.flush();
-        h264_last_au_ts = LLONG_MAX;
-        h264_last_au_flags = 0;
+        m_au_assembler.reset();
         memset(m_demux_offsets, 0, ( sizeof(OMX_U32) * 8192) );
         m_demux_entries = 0;
     }
@@ -6313,6 +6238,7 @@ if (buffer->nFlags & QOMX_VIDEO_BUFFERFLAG_EOSEQ) {
         android_atomic_inc(&m_queued_codec_config_count);
     }
 
+    m_trace.record(VIDC_TRACE_QBUF_IN, nPortIndex, frameinfo.timestamp);
     rc = ioctl(drv_ctx.video_driver_fd, VIDIOC_QBUF, &buf);
     if (rc) {
         DEBUG_PRINT_ERROR("Failed to qbuf Input buffer to driver");
@@ -6431,6 +6357,10 @@ OMX_ERRORTYPE  omx_vdec::fill_this_buffer(OMX_IN OMX_HANDLETYPE  hComp,
     }
 
     DEBUG_PRINT_LOW("[FTB] bufhdr = %p, bufhdr->pBuffer = %p", buffer, buffer->pBuffer);
+    /* The driver reuses the extradata slot once the buffer is queued */
+    if (m_extradata_index && (int)nPortIndex < m_extradata_index_count)
+        m_extradata_index[nPortIndex].ready = false;
+    m_trace.record(VIDC_TRACE_FTB, nPortIndex, 0);
     post_event((unsigned long) hComp, (unsigned long)buffer, m_fill_output_msg);
     return OMX_ErrorNone;
 }
@@ -6549,6 +6479,7 @@ OMX_ERRORTYPE  omx_vdec::fill_this_buffer_proxy(
     DEBUG_PRINT_LOW("SENDING FTB TO F/W - fd[0] = %d fd[1] = %d offset[1] = %d",
              plane[0].reserved[0],plane[extra_idx].reserved[0], plane[extra_idx].reserved[1]);
 
+    m_trace.record(VIDC_TRACE_QBUF_OUT, nPortIndex, 0);
     rc = ioctl(drv_ctx.video_driver_fd, VIDIOC_QBUF, &buf);
     if (rc) {
         /*TODO: How to handle this case */
@@ -6639,22 +6570,13 @@ OMX_ERRORTYPE  omx_vdec::component_deinit(OMX_IN OMX_HANDLETYPE hComp)
     }
     free_input_buffer_header();
     free_output_buffer_header();
-    if (h264_scratch.pBuffer) {
-        free(h264_scratch.pBuffer);
-        h264_scratch.pBuffer = NULL;
-    }
+    m_au_assembler.deallocate();
 
     if (h264_parser) {
         delete h264_parser;
         h264_parser = NULL;
     }
 
-    if (m_frame_parser.mutils) {
-        DEBUG_PRINT_LOW("Free utils parser");
-        delete (m_frame_parser.mutils);
-        m_frame_parser.mutils = NULL;
-    }
-
     if (m_platform_list) {
         free(m_platform_list);
         m_platform_list = NULL;
@@ -6673,7 +6595,7 @@ OMX_ERRORTYPE  omx_vdec::component_deinit(OMX_IN OMX_HANDLETYPE hComp)
     m_etb_q.m_read = m_etb_q.m_write =0;
 #ifdef _ANDROID_
     if (m_debug_timestamp) {
-        m_timestamp_list.reset_ts_list();
+        m_timestamp_list.reset();
     }
 #endif
 
@@ -6694,6 +6616,13 @@ OMX_ERRORTYPE  omx_vdec::component_deinit(OMX_IN OMX_HANDLETYPE hComp)
     if (outputExtradataFile)
         fclose (outputExtradataFile);
 #endif
+    if (m_trace.enabled()) {
+        char trace_name[PROPERTY_VALUE_MAX + 64];
+        snprintf(trace_name, sizeof(trace_name), "%s/trace_dec_%d_%p.json",
+                m_debug.log_loc, getpid(), this);
+        m_trace.log_summary((const char *)m_cRole);
+        m_trace.dump(trace_name, (const char *)m_cRole);
+    }
     DEBUG_PRINT_INFO("omx_vdec::component_deinit() complete");
     return OMX_ErrorNone;
 }
@@ -7123,6 +7052,8 @@ OMX_ERRORTYPE omx_vdec::fill_buffer_done(OMX_HANDLETYPE hComp,
     DEBUG_PRINT_LOW("fill_buffer_done: bufhdr = %p, bufhdr->pBuffer = %p",
             buffer, buffer->pBuffer);
     pending_output_buffers --;
+    if (buffer->nFilledLen)
+        m_trace.record(VIDC_TRACE_FBD, buffer - m_out_mem_ptr, buffer->nTimeStamp);
 
     if (buffer->nFlags & OMX_BUFFERFLAG_EOS) {
         DEBUG_PRINT_HIGH("Output EOS has been reached");
@@ -7195,9 +7126,9 @@ OMX_ERRORTYPE omx_vdec::fill_buffer_done(OMX_HANDLETYPE hComp,
             if (m_debug_timestamp) {
                 {
                     OMX_TICKS expected_ts = 0;
-                    m_timestamp_list.pop_min_ts(expected_ts);
+                    m_timestamp_list.pop_min(expected_ts);
                     if (is_interlaced && is_duplicate_ts_valid) {
-                        m_timestamp_list.pop_min_ts(expected_ts);
+                        m_timestamp_list.pop_min(expected_ts);
                     }
                     DEBUG_PRINT_LOW("Current timestamp (%lld),Popped TIMESTAMP (%lld) from list",
                             buffer->nTimeStamp, expected_ts);
@@ -7354,6 +7285,7 @@ OMX_ERRORTYPE omx_vdec::empty_buffer_done(OMX_HANDLETYPE         hComp,
     DEBUG_PRINT_LOW("empty_buffer_done: bufhdr = %p, bufhdr->pBuffer = %p, bufhdr->nFlags = %x",
             buffer, buffer->pBuffer, buffer->nFlags);
     pending_input_buffers--;
+    m_trace.record(VIDC_TRACE_EBD, buffer - m_inp_mem_ptr, buffer->nTimeStamp);
 
     if (arbitrary_bytes) {
         if (pdest_frame == NULL && input_flush_progress == false) {
@@ -7606,6 +7538,9 @@ int omx_vdec::async_message_process (void *context, void* message)
                         omx->post_event(OMX_CORE_OUTPUT_PORT_INDEX,
                                 OMX_IndexConfigCommonOutputCrop,
                                 OMX_COMPONENT_GENERATE_PORT_RECONFIG);
+                    } else if (omxhdr->nFilledLen) {
+                        /* Geometry unchanged, start the color conversion now */
+                        omx->client_buffers.submit_conversion(omxhdr);
                     }
 
                     if (omxhdr->nFilledLen)
@@ -7671,6 +7606,7 @@ OMX_ERRORTYPE omx_vdec::empty_this_buffer_proxy_arbitrary (
     if (buffer == NULL) {
         return OMX_ErrorBadParameter;
     }
+    m_trace.record(VIDC_TRACE_ETB_PROXY, buffer - m_inp_heap_ptr, buffer->nTimeStamp);
     DEBUG_PRINT_LOW("ETBProxyArb: bufhdr = %p, bufhdr->pBuffer = %p", buffer, buffer->pBuffer);
     DEBUG_PRINT_LOW("ETBProxyArb: nFilledLen %u, flags %u, timestamp %lld",
             (unsigned int)buffer->nFilledLen, (unsigned int)buffer->nFlags, buffer->nTimeStamp);
@@ -7737,18 +7673,15 @@ OMX_ERRORTYPE omx_vdec::push_input_buffer (OMX_HANDLETYPE hComp)
 
     }
 
+    m_au_assembler.set_source_count(drv_ctx.ip_buf.actualcount);
     while ((pdest_frame != NULL) && (psource_frame != NULL)) {
         switch (codec_type_parse) {
             case CODEC_TYPE_MPEG4:
             case CODEC_TYPE_H263:
             case CODEC_TYPE_MPEG2:
-                ret =  push_input_sc_codec(hComp);
-                break;
             case CODEC_TYPE_H264:
-                ret = push_input_h264(hComp);
-                break;
             case CODEC_TYPE_HEVC:
-                ret = push_input_hevc(hComp);
+                ret = m_au_assembler.push(psource_frame, pdest_frame);
                 break;
             case CODEC_TYPE_VC1:
                 ret = push_input_vc1(hComp);
@@ -7766,524 +7699,91 @@ OMX_ERRORTYPE omx_vdec::push_input_buffer (OMX_HANDLETYPE hComp)
     return ret;
 }
 
-OMX_ERRORTYPE omx_vdec::push_input_sc_codec(OMX_HANDLETYPE hComp)
+OMX_ERRORTYPE omx_vdec::au_ready(OMX_BUFFERHEADERTYPE *dest)
+{
+    return empty_this_buffer_proxy(&m_cmp, dest);
+}
+
+OMX_BUFFERHEADERTYPE *omx_vdec::get_free_dest()
 {
-    OMX_U32 partial_frame = 1;
-    OMX_BOOL generate_ebd = OMX_TRUE;
     unsigned long address = 0, p2 = 0, id = 0;
 
-    DEBUG_PRINT_LOW("Start Parsing the bit stream address %p TimeStamp %lld",
-            psource_frame,psource_frame->nTimeStamp);
-    if (m_frame_parser.parse_sc_frame(psource_frame,
-                pdest_frame,&partial_frame) == -1) {
-        DEBUG_PRINT_ERROR("Error In Parsing Return Error");
-        return OMX_ErrorBadParameter;
+    if (!m_input_free_q.m_size) {
+        return NULL;
     }
+    m_input_free_q.pop_entry(&address,&p2,&id);
+    return (OMX_BUFFERHEADERTYPE *)address;
+}
 
-    if (partial_frame == 0) {
-        DEBUG_PRINT_LOW("Frame size %u source %p frame count %d",
-                (unsigned int)pdest_frame->nFilledLen,psource_frame,frame_count);
-
-
-        DEBUG_PRINT_LOW("TimeStamp updated %lld", pdest_frame->nTimeStamp);
-        /*First Parsed buffer will have only header Hence skip*/
-        if (frame_count == 0) {
-            DEBUG_PRINT_LOW("H263/MPEG4 Codec First Frame ");
-
-            if (codec_type_parse == CODEC_TYPE_MPEG4 ||
-                    codec_type_parse == CODEC_TYPE_DIVX) {
-                mp4StreamType psBits;
-                psBits.data = pdest_frame->pBuffer + pdest_frame->nOffset;
-                psBits.numBytes = pdest_frame->nFilledLen;
-                mp4_headerparser.parseHeader(&psBits);
-            }
-
-            frame_count++;
-        } else {
-            pdest_frame->nFlags &= ~OMX_BUFFERFLAG_EOS;
-            if (pdest_frame->nFilledLen) {
-                /*Push the frame to the Decoder*/
-                if (empty_this_buffer_proxy(hComp,pdest_frame) != OMX_ErrorNone) {
-                    return OMX_ErrorBadParameter;
-                }
-                frame_count++;
-                pdest_frame = NULL;
-
-                if (m_input_free_q.m_size) {
-                    m_input_free_q.pop_entry(&address,&p2,&id);
-                    pdest_frame = (OMX_BUFFERHEADERTYPE *) address;
-                    pdest_frame->nFilledLen = 0;
-                }
-            } else if (!(psource_frame->nFlags & OMX_BUFFERFLAG_EOS)) {
-                DEBUG_PRINT_ERROR("Zero len buffer return back to POOL");
-                m_input_free_q.insert_entry((unsigned long) pdest_frame, (unsigned)NULL,
-                        (unsigned)NULL);
-                pdest_frame = NULL;
-            }
-        }
-    } else {
-        DEBUG_PRINT_LOW("Not a Complete Frame %u", (unsigned int)pdest_frame->nFilledLen);
-        /*Check if Destination Buffer is full*/
-        if (pdest_frame->nAllocLen ==
-                pdest_frame->nFilledLen + pdest_frame->nOffset) {
-            DEBUG_PRINT_ERROR("ERROR:Frame Not found though Destination Filled");
-            return OMX_ErrorStreamCorrupt;
-        }
-    }
-
-    if (psource_frame->nFilledLen == 0) {
-        if (psource_frame->nFlags & OMX_BUFFERFLAG_EOS) {
-            if (pdest_frame) {
-                pdest_frame->nFlags |= psource_frame->nFlags;
-                DEBUG_PRINT_LOW("Frame Found start Decoding Size =%u TimeStamp = %lld",
-                        (unsigned int)pdest_frame->nFilledLen,pdest_frame->nTimeStamp);
-                DEBUG_PRINT_LOW("Found a frame size = %u number = %d",
-                        (unsigned int)pdest_frame->nFilledLen,frame_count++);
-                /*Push the frame to the Decoder*/
-                if (empty_this_buffer_proxy(hComp,pdest_frame) != OMX_ErrorNone) {
-                    return OMX_ErrorBadParameter;
-                }
-                frame_count++;
-                pdest_frame = NULL;
-            } else {
-                DEBUG_PRINT_LOW("Last frame in else dest addr") ;
-                generate_ebd = OMX_FALSE;
-            }
-        }
-        if (generate_ebd) {
-            DEBUG_PRINT_LOW("Buffer Consumed return back to client %p",psource_frame);
-            m_cb.EmptyBufferDone (hComp,m_app_data,psource_frame);
-            psource_frame = NULL;
-
-            if (m_input_pending_q.m_size) {
-                DEBUG_PRINT_LOW("Pull Next source Buffer %p",psource_frame);
-                m_input_pending_q.pop_entry(&address,&p2,&id);
-                psource_frame = (OMX_BUFFERHEADERTYPE *) address;
-                DEBUG_PRINT_LOW("Next source Buffer %p time stamp %lld",psource_frame,
-                        psource_frame->nTimeStamp);
-                DEBUG_PRINT_LOW("Next source Buffer flag %u length %u",
-                        (unsigned int)psource_frame->nFlags, (unsigned int)psource_frame->nFilledLen);
-            }
-        }
-    }
-    return OMX_ErrorNone;
+void omx_vdec::return_dest(OMX_BUFFERHEADERTYPE *dest)
+{
+    m_input_free_q.insert_entry((unsigned long) dest, (unsigned)NULL,
+            (unsigned)NULL);
 }
 
-OMX_ERRORTYPE omx_vdec::push_input_h264 (OMX_HANDLETYPE hComp)
+OMX_BUFFERHEADERTYPE *omx_vdec::get_next_source()
 {
-    OMX_U32 partial_frame = 1;
     unsigned long address = 0, p2 = 0, id = 0;
-    OMX_BOOL isNewFrame = OMX_FALSE;
-    OMX_BOOL generate_ebd = OMX_TRUE;
-
-    if (h264_scratch.pBuffer == NULL) {
-        DEBUG_PRINT_ERROR("ERROR:H.264 Scratch Buffer not allocated");
-        return OMX_ErrorBadParameter;
-    }
-    DEBUG_PRINT_LOW("Pending h264_scratch.nFilledLen %u "
-            "look_ahead_nal %d", (unsigned int)h264_scratch.nFilledLen, look_ahead_nal);
-    DEBUG_PRINT_LOW("Pending pdest_frame->nFilledLen %u",(unsigned int)pdest_frame->nFilledLen);
-    if (h264_scratch.nFilledLen && look_ahead_nal) {
-        look_ahead_nal = false;
-        if ((pdest_frame->nAllocLen - pdest_frame->nFilledLen) >=
-                h264_scratch.nFilledLen) {
-            memcpy ((pdest_frame->pBuffer + pdest_frame->nFilledLen),
-                    h264_scratch.pBuffer,h264_scratch.nFilledLen);
-            pdest_frame->nFilledLen += h264_scratch.nFilledLen;
-            DEBUG_PRINT_LOW("Copy the previous NAL (h264 scratch) into Dest frame");
-            h264_scratch.nFilledLen = 0;
-        } else {
-            DEBUG_PRINT_ERROR("Error:1: Destination buffer overflow for H264");
-            return OMX_ErrorBadParameter;
-        }
-    }
 
-    /* If an empty input is queued with EOS, do not coalesce with the destination-frame yet, as this may result
-       in EOS flag getting associated with the destination
-    */
-    if (!psource_frame->nFilledLen && (psource_frame->nFlags & OMX_BUFFERFLAG_EOS) &&
-            pdest_frame->nFilledLen) {
-        DEBUG_PRINT_HIGH("delay ETB for 'empty buffer with EOS'");
-        generate_ebd = OMX_FALSE;
+    if (!m_input_pending_q.m_size) {
+        return NULL;
     }
+    m_input_pending_q.pop_entry(&address,&p2,&id);
+    return (OMX_BUFFERHEADERTYPE *)address;
+}
 
-    if (nal_length == 0) {
-        DEBUG_PRINT_LOW("Zero NAL, hence parse using start code");
-        if (m_frame_parser.parse_sc_frame(psource_frame,
-                    &h264_scratch,&partial_frame) == -1) {
-            DEBUG_PRINT_ERROR("Error In Parsing Return Error");
-            return OMX_ErrorBadParameter;
-        }
-    } else {
-        DEBUG_PRINT_LOW("Non-zero NAL length clip, hence parse with NAL size %d ",nal_length);
-        if (m_frame_parser.parse_h264_nallength(psource_frame,
-                    &h264_scratch,&partial_frame) == -1) {
-            DEBUG_PRINT_ERROR("Error In Parsing NAL size, Return Error");
-            return OMX_ErrorBadParameter;
-        }
-    }
+void omx_vdec::source_done(OMX_BUFFERHEADERTYPE *source)
+{
+    m_cb.EmptyBufferDone(&m_cmp, m_app_data, source);
+}
 
-    if (partial_frame == 0) {
-        if (nal_count == 0 && h264_scratch.nFilledLen == 0) {
-            DEBUG_PRINT_LOW("First NAL with Zero Length, hence Skip");
-            nal_count++;
-            h264_scratch.nTimeStamp = psource_frame->nTimeStamp;
-            h264_scratch.nFlags = psource_frame->nFlags;
-        } else {
-            DEBUG_PRINT_LOW("Parsed New NAL Length = %u",(unsigned int)h264_scratch.nFilledLen);
-            if (h264_scratch.nFilledLen) {
-                h264_parser->parse_nal((OMX_U8*)h264_scratch.pBuffer, h264_scratch.nFilledLen,
-                        NALU_TYPE_SPS);
-#ifndef PROCESS_EXTRADATA_IN_OUTPUT_PORT
-                if (client_extradata & OMX_TIMEINFO_EXTRADATA)
-                    h264_parser->parse_nal((OMX_U8*)h264_scratch.pBuffer,
-                            h264_scratch.nFilledLen, NALU_TYPE_SEI);
-                else if (client_extradata & OMX_FRAMEINFO_EXTRADATA)
-                    // If timeinfo is present frame info from SEI is already processed
-                    h264_parser->parse_nal((OMX_U8*)h264_scratch.pBuffer,
-                            h264_scratch.nFilledLen, NALU_TYPE_SEI);
-#endif
-                m_frame_parser.mutils->isNewFrame(&h264_scratch, 0, isNewFrame);
-                nal_count++;
-                if (VALID_TS(h264_last_au_ts) && !VALID_TS(pdest_frame->nTimeStamp)) {
-                    pdest_frame->nTimeStamp = h264_last_au_ts;
-                    pdest_frame->nFlags = h264_last_au_flags;
-#ifdef PANSCAN_HDLR
-                    if (client_extradata & OMX_FRAMEINFO_EXTRADATA)
-                        h264_parser->update_panscan_data(h264_last_au_ts);
-#endif
-                }
-                if (m_frame_parser.mutils->nalu_type == NALU_TYPE_NON_IDR ||
-                        m_frame_parser.mutils->nalu_type == NALU_TYPE_IDR) {
-                    h264_last_au_ts = h264_scratch.nTimeStamp;
-                    h264_last_au_flags = h264_scratch.nFlags;
+void omx_vdec::nal_parsed(const au_nal_unit &nal)
+{
+    bool sei_enabled = false;
 #ifndef PROCESS_EXTRADATA_IN_OUTPUT_PORT
-                    if (client_extradata & OMX_TIMEINFO_EXTRADATA) {
-                        OMX_S64 ts_in_sei = h264_parser->process_ts_with_sei_vui(h264_last_au_ts);
-                        if (!VALID_TS(h264_last_au_ts))
-                            h264_last_au_ts = ts_in_sei;
-                    }
+    // Frame info shares the SEI parsed for time info
+    sei_enabled = (client_extradata &
+            (OMX_TIMEINFO_EXTRADATA | OMX_FRAMEINFO_EXTRADATA)) != 0;
 #endif
-                } else
-                    h264_last_au_ts = LLONG_MAX;
-            }
-
-            if (!isNewFrame) {
-                if ( (pdest_frame->nAllocLen - pdest_frame->nFilledLen) >=
-                        h264_scratch.nFilledLen) {
-                    DEBUG_PRINT_LOW("Not a NewFrame Copy into Dest len %u",
-                            (unsigned int)h264_scratch.nFilledLen);
-                    memcpy ((pdest_frame->pBuffer + pdest_frame->nFilledLen),
-                            h264_scratch.pBuffer,h264_scratch.nFilledLen);
-                    pdest_frame->nFilledLen += h264_scratch.nFilledLen;
-                    if (m_frame_parser.mutils->nalu_type == NALU_TYPE_EOSEQ)
-                        pdest_frame->nFlags |= QOMX_VIDEO_BUFFERFLAG_EOSEQ;
-                    h264_scratch.nFilledLen = 0;
-                } else {
-                    DEBUG_PRINT_LOW("Error:2: Destination buffer overflow for H264");
-                    return OMX_ErrorBadParameter;
-                }
-            } else if(h264_scratch.nFilledLen) {
-                look_ahead_nal = true;
-                DEBUG_PRINT_LOW("Frame Found start Decoding Size =%u TimeStamp = %llu",
-                        (unsigned int)pdest_frame->nFilledLen,pdest_frame->nTimeStamp);
-                DEBUG_PRINT_LOW("Found a frame size = %u number = %d",
-                        (unsigned int)pdest_frame->nFilledLen,frame_count++);
-
-                if (pdest_frame->nFilledLen == 0) {
-                    DEBUG_PRINT_LOW("Copy the Current Frame since and push it");
-                    look_ahead_nal = false;
-                    if ( (pdest_frame->nAllocLen - pdest_frame->nFilledLen) >=
-                            h264_scratch.nFilledLen) {
-                        memcpy ((pdest_frame->pBuffer + pdest_frame->nFilledLen),
-                                h264_scratch.pBuffer,h264_scratch.nFilledLen);
-                        pdest_frame->nFilledLen += h264_scratch.nFilledLen;
-                        h264_scratch.nFilledLen = 0;
-                    } else {
-                        DEBUG_PRINT_ERROR("Error:3: Destination buffer overflow for H264");
-                        return OMX_ErrorBadParameter;
-                    }
-                } else {
-                    if (psource_frame->nFilledLen || h264_scratch.nFilledLen) {
-                        DEBUG_PRINT_LOW("Reset the EOS Flag");
-                        pdest_frame->nFlags &= ~OMX_BUFFERFLAG_EOS;
-                    }
-                    /*Push the frame to the Decoder*/
-                    if (empty_this_buffer_proxy(hComp,pdest_frame) != OMX_ErrorNone) {
-                        return OMX_ErrorBadParameter;
-                    }
-                    //frame_count++;
-                    pdest_frame = NULL;
-                    if (m_input_free_q.m_size) {
-                        m_input_free_q.pop_entry(&address,&p2,&id);
-                        pdest_frame = (OMX_BUFFERHEADERTYPE *) address;
-                        DEBUG_PRINT_LOW("Pop the next pdest_buffer %p",pdest_frame);
-                        pdest_frame->nFilledLen = 0;
-                        pdest_frame->nFlags = 0;
-                        pdest_frame->nTimeStamp = LLONG_MAX;
-                    }
-                }
-            }
-        }
-    } else {
-        DEBUG_PRINT_LOW("Not a Complete Frame, pdest_frame->nFilledLen %u", (unsigned int)pdest_frame->nFilledLen);
-        /*Check if Destination Buffer is full*/
-        if (h264_scratch.nAllocLen ==
-                h264_scratch.nFilledLen + h264_scratch.nOffset) {
-            DEBUG_PRINT_ERROR("ERROR: Frame Not found though Destination Filled");
-            return OMX_ErrorStreamCorrupt;
-        }
-    }
-
-    if (!psource_frame->nFilledLen) {
-        DEBUG_PRINT_LOW("Buffer Consumed return source %p back to client",psource_frame);
-
-        if (psource_frame->nFlags & OMX_BUFFERFLAG_EOS) {
-            if (pdest_frame) {
-                DEBUG_PRINT_LOW("EOS Reached Pass Last Buffer");
-                if ( (pdest_frame->nAllocLen - pdest_frame->nFilledLen) >=
-                        h264_scratch.nFilledLen) {
-                    if(pdest_frame->nFilledLen == 0) {
-                        /* No residual frame from before, send whatever
-                         * we have left */
-                        memcpy((pdest_frame->pBuffer + pdest_frame->nFilledLen),
-                                h264_scratch.pBuffer, h264_scratch.nFilledLen);
-                        pdest_frame->nFilledLen += h264_scratch.nFilledLen;
-                        h264_scratch.nFilledLen = 0;
-                        pdest_frame->nTimeStamp = h264_scratch.nTimeStamp;
-                    } else {
-                        m_frame_parser.mutils->isNewFrame(&h264_scratch, 0, isNewFrame);
-                        if(!isNewFrame) {
-                            /* Have a residual frame, but we know that the
-                             * AU in this frame is belonging to whatever
-                             * frame we had left over.  So append it */
-                             memcpy ((pdest_frame->pBuffer + pdest_frame->nFilledLen),
-                                     h264_scratch.pBuffer,h264_scratch.nFilledLen);
-                             pdest_frame->nFilledLen += h264_scratch.nFilledLen;
-                             h264_scratch.nFilledLen = 0;
-                             if (h264_last_au_ts != LLONG_MAX)
-                                 pdest_frame->nTimeStamp = h264_last_au_ts;
-                        } else {
-                            /* Completely new frame, let's just push what
-                             * we have now.  The resulting EBD would trigger
-                             * another push */
-                            generate_ebd = OMX_FALSE;
-                            pdest_frame->nTimeStamp = h264_last_au_ts;
-                            h264_last_au_ts = h264_scratch.nTimeStamp;
-                        }
-                    }
-                } else {
-                    DEBUG_PRINT_ERROR("ERROR:4: Destination buffer overflow for H264");
-                    return OMX_ErrorBadParameter;
-                }
-
-                /* Iff we coalesced two buffers, inherit the flags of both bufs */
-                if(generate_ebd == OMX_TRUE) {
-                     pdest_frame->nFlags = h264_scratch.nFlags | psource_frame->nFlags;
-                }
+    h264_parser->parse_nal_payload(nal.payload, nal.payload_len,
+            nal.type, sei_enabled);
+}
 
-                DEBUG_PRINT_LOW("pdest_frame->nFilledLen =%u TimeStamp = %llu",
-                        (unsigned int)pdest_frame->nFilledLen,pdest_frame->nTimeStamp);
-                DEBUG_PRINT_LOW("Push AU frame number %d to driver", frame_count++);
-#ifndef PROCESS_EXTRADATA_IN_OUTPUT_PORT
-                if (client_extradata & OMX_TIMEINFO_EXTRADATA) {
-                    OMX_S64 ts_in_sei = h264_parser->process_ts_with_sei_vui(pdest_frame->nTimeStamp);
-                    if (!VALID_TS(pdest_frame->nTimeStamp))
-                        pdest_frame->nTimeStamp = ts_in_sei;
-                }
+void omx_vdec::au_started(OMX_S64 timestamp)
+{
+#ifdef PANSCAN_HDLR
+    if (client_extradata & OMX_FRAMEINFO_EXTRADATA)
+        h264_parser->update_panscan_data(timestamp);
+#else
+    (void)timestamp;
 #endif
-                /*Push the frame to the Decoder*/
-                if (empty_this_buffer_proxy(hComp,pdest_frame) != OMX_ErrorNone) {
-                    return OMX_ErrorBadParameter;
-                }
-                frame_count++;
-                pdest_frame = NULL;
-            } else {
-                DEBUG_PRINT_LOW("Last frame in else dest addr %p size %u",
-                        pdest_frame, (unsigned int)h264_scratch.nFilledLen);
-                generate_ebd = OMX_FALSE;
-            }
-        }
-    }
-    if (generate_ebd && !psource_frame->nFilledLen) {
-        m_cb.EmptyBufferDone (hComp,m_app_data,psource_frame);
-        psource_frame = NULL;
-        if (m_input_pending_q.m_size) {
-            DEBUG_PRINT_LOW("Pull Next source Buffer %p",psource_frame);
-            m_input_pending_q.pop_entry(&address,&p2,&id);
-            psource_frame = (OMX_BUFFERHEADERTYPE *) address;
-            DEBUG_PRINT_LOW("Next source Buffer flag %u src length %u",
-                    (unsigned int)psource_frame->nFlags, (unsigned int)psource_frame->nFilledLen);
-        }
-    }
-    return OMX_ErrorNone;
 }
 
-OMX_ERRORTYPE copy_buffer(OMX_BUFFERHEADERTYPE* pDst, OMX_BUFFERHEADERTYPE* pSrc)
+OMX_S64 omx_vdec::au_timestamp(OMX_S64 timestamp)
 {
-    OMX_ERRORTYPE rc = OMX_ErrorNone;
-    if ((pDst->nAllocLen - pDst->nFilledLen) >= pSrc->nFilledLen) {
-        memcpy((pDst->pBuffer + pDst->nFilledLen), pSrc->pBuffer, pSrc->nFilledLen);
-        if (pDst->nTimeStamp == LLONG_MAX) {
-            pDst->nTimeStamp = pSrc->nTimeStamp;
-            DEBUG_PRINT_LOW("Assign Dst nTimeStamp = %lld", pDst->nTimeStamp);
-        }
-        pDst->nFilledLen += pSrc->nFilledLen;
-        pSrc->nFilledLen = 0;
-    } else {
-        DEBUG_PRINT_ERROR("Error: Destination buffer overflow");
-        rc = OMX_ErrorBadParameter;
-    }
-    return rc;
+#ifndef PROCESS_EXTRADATA_IN_OUTPUT_PORT
+    if (client_extradata & OMX_TIMEINFO_EXTRADATA)
+        return h264_parser->process_ts_with_sei_vui(timestamp);
+#else
+    (void)timestamp;
+#endif
+    return LLONG_MAX;
 }
 
-OMX_ERRORTYPE omx_vdec::push_input_hevc(OMX_HANDLETYPE hComp)
+/* The buffer requirements of a new stream are only known once the driver
+   parsed the same SPS, so the port reconfiguration still waits for its
+   settings changed event. Only the profile is taken over ahead of it. */
+void omx_vdec::stream_changed(OMX_U32 changes, const stream_params &params)
 {
-    OMX_U32 partial_frame = 1;
-    unsigned long address,p2,id;
-    OMX_BOOL isNewFrame = OMX_FALSE;
-    OMX_BOOL generate_ebd = OMX_TRUE;
-    OMX_ERRORTYPE rc = OMX_ErrorNone;
-    if (h264_scratch.pBuffer == NULL) {
-        DEBUG_PRINT_ERROR("ERROR:Hevc Scratch Buffer not allocated");
-        return OMX_ErrorBadParameter;
-    }
-
-    DEBUG_PRINT_LOW("h264_scratch.nFilledLen %u has look_ahead_nal %d \
-            pdest_frame nFilledLen %u nTimeStamp %lld",
-            (unsigned int)h264_scratch.nFilledLen, look_ahead_nal, (unsigned int)pdest_frame->nFilledLen, pdest_frame->nTimeStamp);
-
-    if (h264_scratch.nFilledLen && look_ahead_nal) {
-        look_ahead_nal = false;
-        rc = copy_buffer(pdest_frame, &h264_scratch);
-        if (rc != OMX_ErrorNone) {
-            return rc;
-        }
-    }
-
-    if (nal_length == 0) {
-        if (m_frame_parser.parse_sc_frame(psource_frame,
-                    &h264_scratch,&partial_frame) == -1) {
-            DEBUG_PRINT_ERROR("Error In Parsing Return Error");
-            return OMX_ErrorBadParameter;
-        }
-    } else {
-        DEBUG_PRINT_LOW("Non-zero NAL length clip, hence parse with NAL size %d",nal_length);
-        if (m_frame_parser.parse_h264_nallength(psource_frame,
-                    &h264_scratch,&partial_frame) == -1) {
-            DEBUG_PRINT_ERROR("Error In Parsing NAL size, Return Error");
-            return OMX_ErrorBadParameter;
-        }
-    }
-
-    if (partial_frame == 0) {
-        if (nal_count == 0 && h264_scratch.nFilledLen == 0) {
-            DEBUG_PRINT_LOW("First NAL with Zero Length, hence Skip");
-            nal_count++;
-            h264_scratch.nTimeStamp = psource_frame->nTimeStamp;
-            h264_scratch.nFlags = psource_frame->nFlags;
-        } else {
-            DEBUG_PRINT_LOW("Parsed New NAL Length = %u", (unsigned int)h264_scratch.nFilledLen);
-            if (h264_scratch.nFilledLen) {
-                m_hevc_utils.isNewFrame(&h264_scratch, 0, isNewFrame);
-                nal_count++;
-            }
-
-            if (!isNewFrame) {
-                DEBUG_PRINT_LOW("Not a new frame, copy h264_scratch nFilledLen %u \
-                        nTimestamp %lld, pdest_frame nFilledLen %u nTimestamp %lld",
-                        (unsigned int)h264_scratch.nFilledLen, h264_scratch.nTimeStamp,
-                        (unsigned int)pdest_frame->nFilledLen, pdest_frame->nTimeStamp);
-                rc = copy_buffer(pdest_frame, &h264_scratch);
-                if (rc != OMX_ErrorNone) {
-                    return rc;
-                }
-            } else {
-                look_ahead_nal = true;
-                if (pdest_frame->nFilledLen == 0) {
-                    look_ahead_nal = false;
-                    DEBUG_PRINT_LOW("dest nation buffer empty, copy scratch buffer");
-                    rc = copy_buffer(pdest_frame, &h264_scratch);
-                    if (rc != OMX_ErrorNone) {
-                        return OMX_ErrorBadParameter;
-                    }
-                } else {
-                    if (psource_frame->nFilledLen || h264_scratch.nFilledLen) {
-                        pdest_frame->nFlags &= ~OMX_BUFFERFLAG_EOS;
-                    }
-                    DEBUG_PRINT_LOW("FrameDetected # %d pdest_frame nFilledLen %u \
-                            nTimeStamp %lld, look_ahead_nal in h264_scratch \
-                            nFilledLen %u nTimeStamp %lld",
-                            frame_count++, (unsigned int)pdest_frame->nFilledLen,
-                            pdest_frame->nTimeStamp, (unsigned int)h264_scratch.nFilledLen,
-                            h264_scratch.nTimeStamp);
-                    if (empty_this_buffer_proxy(hComp, pdest_frame) != OMX_ErrorNone) {
-                        return OMX_ErrorBadParameter;
-                    }
-                    pdest_frame = NULL;
-                    if (m_input_free_q.m_size) {
-                        m_input_free_q.pop_entry(&address, &p2, &id);
-                        pdest_frame = (OMX_BUFFERHEADERTYPE *) address;
-                        DEBUG_PRINT_LOW("pop the next pdest_buffer %p", pdest_frame);
-                        pdest_frame->nFilledLen = 0;
-                        pdest_frame->nFlags = 0;
-                        pdest_frame->nTimeStamp = LLONG_MAX;
-                    }
-                }
-            }
-        }
-    } else {
-        DEBUG_PRINT_LOW("psource_frame is partial nFilledLen %u nTimeStamp %lld, \
-                pdest_frame nFilledLen %u nTimeStamp %lld, h264_scratch \
-                nFilledLen %u nTimeStamp %lld",
-                (unsigned int)psource_frame->nFilledLen, psource_frame->nTimeStamp,
-                (unsigned int)pdest_frame->nFilledLen, pdest_frame->nTimeStamp,
-                (unsigned int)h264_scratch.nFilledLen, h264_scratch.nTimeStamp);
-
-        if (h264_scratch.nAllocLen ==
-                h264_scratch.nFilledLen + h264_scratch.nOffset) {
-            DEBUG_PRINT_ERROR("ERROR: Frame Not found though Destination Filled");
-            return OMX_ErrorStreamCorrupt;
-        }
-    }
-
-    if (!psource_frame->nFilledLen) {
-        DEBUG_PRINT_LOW("Buffer Consumed return source %p back to client", psource_frame);
-        if (psource_frame->nFlags & OMX_BUFFERFLAG_EOS) {
-            if (pdest_frame) {
-                DEBUG_PRINT_LOW("EOS Reached Pass Last Buffer");
-                rc = copy_buffer(pdest_frame, &h264_scratch);
-                if ( rc != OMX_ErrorNone ) {
-                    return rc;
-                }
-                pdest_frame->nTimeStamp = h264_scratch.nTimeStamp;
-                pdest_frame->nFlags = h264_scratch.nFlags | psource_frame->nFlags;
-                DEBUG_PRINT_LOW("Push EOS frame number:%d nFilledLen =%u TimeStamp = %lld",
-                        frame_count, (unsigned int)pdest_frame->nFilledLen, pdest_frame->nTimeStamp);
-                if (empty_this_buffer_proxy(hComp, pdest_frame) != OMX_ErrorNone) {
-                    return OMX_ErrorBadParameter;
-                }
-                frame_count++;
-                pdest_frame = NULL;
-            } else {
-                DEBUG_PRINT_LOW("Last frame in else dest addr %p size %u",
-                        pdest_frame, (unsigned int)h264_scratch.nFilledLen);
-                generate_ebd = OMX_FALSE;
-            }
-        }
-    }
-
-    if (generate_ebd && !psource_frame->nFilledLen) {
-        m_cb.EmptyBufferDone (hComp, m_app_data, psource_frame);
-        psource_frame = NULL;
-        if (m_input_pending_q.m_size) {
-            m_input_pending_q.pop_entry(&address, &p2, &id);
-            psource_frame = (OMX_BUFFERHEADERTYPE *)address;
-            DEBUG_PRINT_LOW("Next source Buffer flag %u nFilledLen %u, nTimeStamp %lld",
-                    (unsigned int)psource_frame->nFlags, (unsigned int)psource_frame->nFilledLen, psource_frame->nTimeStamp);
-        }
-    }
-    return OMX_ErrorNone;
+    if (changes & STREAM_CHANGE_PROFILE)
+        m_profile = params.profile;
+    if (changes & (STREAM_CHANGE_RESOLUTION | STREAM_CHANGE_FORMAT))
+        DEBUG_PRINT_HIGH("Stream changes 0x%x: %ux%u -> %ux%u, %u bit, "
+                "port settings change expected",
+                (unsigned int)changes, drv_ctx.video_resolution.frame_width,
+                drv_ctx.video_resolution.frame_height,
+                (unsigned int)params.width, (unsigned int)params.height,
+                (unsigned int)params.bit_depth_luma);
 }
 
 OMX_ERRORTYPE omx_vdec::push_input_vc1(OMX_HANDLETYPE hComp)
@@ -8328,7 +7828,7 @@ OMX_ERRORTYPE omx_vdec::push_input_vc1(OMX_HANDLETYPE hComp)
     switch (m_vc1_profile) {
         case VC1_AP:
             DEBUG_PRINT_LOW("VC1 AP, hence parse using frame start code");
-            if (push_input_sc_codec(hComp) != OMX_ErrorNone) {
+            if (m_au_assembler.push(psource_frame, pdest_frame) != OMX_ErrorNone) {
                 DEBUG_PRINT_ERROR("Error In Parsing VC1 AP start code");
                 return OMX_ErrorBadParameter;
             }
@@ -8366,19 +7866,12 @@ int omx_vdec::alloc_map_ion_memory(OMX_U32 buffer_size,
         struct ion_fd_data *fd_data, int flag)
 {
     int fd = -EINVAL;
-    int rc = -EINVAL;
-    int ion_dev_flag;
-    struct vdec_ion ion_buf_info;
+    int share_fd = -1;
+    struct vidc_pool_block blk;
     if (!alloc_data || buffer_size <= 0 || !fd_data) {
         DEBUG_PRINT_ERROR("Invalid arguments to alloc_map_ion_memory");
         return -EINVAL;
     }
-    ion_dev_flag = O_RDONLY;
-    fd = open (MEM_DEVICE, ion_dev_flag);
-    if (fd < 0) {
-        DEBUG_PRINT_ERROR("opening ion device failed with fd = %d", fd);
-        return fd;
-    }
     alloc_data->flags = 0;
     if (!secure_mode && (flag & ION_FLAG_CACHED)) {
         alloc_data->flags |= ION_FLAG_CACHED;
@@ -8394,25 +7887,17 @@ int omx_vdec::alloc_map_ion_memory(OMX_U32 buffer_size,
     alloc_data->heap_id_mask = ION_HEAP(ION_IOMMU_HEAP_ID);
     if (secure_mode && (alloc_data->flags & ION_SECURE))
         alloc_data->heap_id_mask = ION_HEAP(MEM_HEAP_ID);
-    rc = ioctl(fd,ION_IOC_ALLOC,alloc_data);
-    if (rc || !alloc_data->handle) {
+
+    // Reconfig and adaptive playback reallocate what they just freed
+    fd = vidc_buffer_pool::instance()->acquire(alloc_data->len, alloc_data->align,
+            alloc_data->flags, alloc_data->heap_id_mask, &blk, &share_fd);
+    if (fd < 0) {
         DEBUG_PRINT_ERROR("ION ALLOC memory failed");
         alloc_data->handle = 0;
-        close(fd);
-        fd = -ENOMEM;
-        return fd;
-    }
-    fd_data->handle = alloc_data->handle;
-    rc = ioctl(fd,ION_IOC_MAP,fd_data);
-    if (rc) {
-        DEBUG_PRINT_ERROR("ION MAP failed ");
-        ion_buf_info.ion_alloc_data = *alloc_data;
-        ion_buf_info.ion_device_fd = fd;
-        ion_buf_info.fd_ion_data = *fd_data;
-        free_ion_memory(&ion_buf_info);
-        fd_data->fd =-1;
-        fd = -ENOMEM;
+        fd_data->fd = -1;
+        return -ENOMEM;
     }
+    vidc_ion_pool_export(blk, share_fd, alloc_data, fd_data);
 
     return fd;
 }
@@ -8424,11 +7909,8 @@ void omx_vdec::free_ion_memory(struct vdec_ion *buf_ion_info)
         DEBUG_PRINT_ERROR("ION: free called with invalid fd/allocdata");
         return;
     }
-    if (ioctl(buf_ion_info->ion_device_fd,ION_IOC_FREE,
-                &buf_ion_info->ion_alloc_data.handle)) {
-        DEBUG_PRINT_ERROR("ION: free failed" );
-    }
-    close(buf_ion_info->ion_device_fd);
+    vidc_buffer_pool::instance()->release(buf_ion_info->ion_device_fd,
+            (unsigned long)buf_ion_info->ion_alloc_data.handle);
     buf_ion_info->ion_device_fd = -1;
     buf_ion_info->ion_alloc_data.handle = 0;
     buf_ion_info->fd_ion_data.fd = -1;
@@ -8465,10 +7947,11 @@ void omx_vdec::free_output_buffer_header()
         drv_ctx.op_buf_ion_info = NULL;
     }
 #endif
-    if (out_dynamic_list) {
-        free(out_dynamic_list);
-        out_dynamic_list = NULL;
+    if (out_dynamic_table.held_buffers()) {
+        DEBUG_PRINT_HIGH("Releasing %u dynamic buffers (%u refs) still held by firmware",
+                out_dynamic_table.held_buffers(), out_dynamic_table.held_refs());
     }
+    out_dynamic_table.deinit();
 }
 
 void omx_vdec::free_input_buffer_header()
@@ -8898,9 +8381,10 @@ OMX_ERRORTYPE omx_vdec::allocate_output_headers()
             return OMX_ErrorInsufficientResources;
         }
 #endif
-        if (dynamic_buf_mode) {
-            out_dynamic_list = (struct dynamic_buf_list *) \
-                calloc (sizeof(struct dynamic_buf_list), drv_ctx.op_buf.actualcount);
+        if (dynamic_buf_mode &&
+                !out_dynamic_table.init(drv_ctx.op_buf.actualcount)) {
+            DEBUG_PRINT_ERROR("Failed to alloc out_dynamic_table");
+            return OMX_ErrorInsufficientResources;
         }
 
         if (m_out_mem_ptr && pPtr && drv_ctx.ptr_outputbuffer
@@ -9120,10 +8604,13 @@ void omx_vdec::handle_extradata(OMX_BUFFERHEADERTYPE *p_buf_hdr)
     OMX_U32 num_MB_in_frame;
     OMX_U32 recovery_sei_flags = 1;
     int enable = 0;
+    struct vdec_extradata_index *index = NULL;
+    /* Records the writer appends now, none when the index defers them */
+    OMX_U32 append_extradata = client_extradata;
 
     int buf_index = p_buf_hdr - m_out_mem_ptr;
     if (buf_index >= drv_ctx.extradata_info.count) {
-        DEBUG_PRINT_ERROR("handle_extradata: invalid index(%d) max(%d)",
+        DEBUG_PRINT_ERROR_RATELIMITED("handle_extradata: invalid index(%d) max(%d)",
                 buf_index, drv_ctx.extradata_info.count);
         return;
     }
@@ -9135,8 +8622,10 @@ void omx_vdec::handle_extradata(OMX_BUFFERHEADERTYPE *p_buf_hdr)
         DEBUG_PRINT_HIGH("NULL drv_ctx.extradata_info.uaddr");
         return;
     }
-    if (!secure_mode && (drv_ctx.extradata_info.buffer_size > (p_buf_hdr->nAllocLen - p_buf_hdr->nFilledLen)) ) {
-        DEBUG_PRINT_ERROR("Error: Insufficient size allocated for extra-data");
+    /* Lazy extradata never writes behind the frame */
+    if (!secure_mode && !m_lazy_extradata &&
+            (drv_ctx.extradata_info.buffer_size > (p_buf_hdr->nAllocLen - p_buf_hdr->nFilledLen)) ) {
+        DEBUG_PRINT_ERROR_RATELIMITED("Error: Insufficient size allocated for extra-data");
         p_extra = NULL;
         return;
     }
@@ -9147,11 +8636,24 @@ void omx_vdec::handle_extradata(OMX_BUFFERHEADERTYPE *p_buf_hdr)
         p_extra = m_other_extradata;
     char *p_extradata = drv_ctx.extradata_info.uaddr + buf_index * drv_ctx.extradata_info.buffer_size;
 
-    if (!secure_mode && ((OMX_U8*)p_extra > (pBuffer + p_buf_hdr->nAllocLen))) {
+    if (!secure_mode && !m_lazy_extradata && ((OMX_U8*)p_extra > (pBuffer + p_buf_hdr->nAllocLen))) {
         p_extra = NULL;
-        DEBUG_PRINT_ERROR("Error: out of bound memory access by p_extra");
+        DEBUG_PRINT_ERROR_RATELIMITED("Error: out of bound memory access by p_extra");
         return;
     }
+    if (m_lazy_extradata && buf_index < m_extradata_index_count) {
+        index = &m_extradata_index[buf_index];
+        index->ready = false;
+        index->count = 0;
+        append_extradata = 0;
+    } else if (client_extradata && p_extra) {
+        OMX_U8 *extra_end = secure_mode ?
+            (OMX_U8 *)m_other_extradata + drv_ctx.extradata_info.buffer_size :
+            (OMX_U8 *)drv_ctx.ptr_outputbuffer[buf_index].bufferaddr + p_buf_hdr->nAllocLen;
+        if (!m_extradata_writer.begin((OMX_U8 *)p_extra, extra_end))
+            DEBUG_PRINT_ERROR_RATELIMITED("handle_extradata: %u bytes left for extradata, "
+                    "dropping what does not fit", (unsigned int)(extra_end - (OMX_U8 *)p_extra));
+    }
     OMX_OTHER_EXTRADATATYPE *data = (struct OMX_OTHER_EXTRADATATYPE *)p_extradata;
     if (data && p_extra) {
         while ((consumed_len < drv_ctx.extradata_info.buffer_size)
@@ -9161,6 +8663,11 @@ void omx_vdec::handle_extradata(OMX_BUFFERHEADERTYPE *p_buf_hdr)
                 break;
             }
             DEBUG_PRINT_LOW("handle_extradata: eType = %d", data->eType);
+            if (index && index->count < VDEC_EXTRADATA_INDEX_MAX) {
+                index->entry[index->count].type = data->eType;
+                index->entry[index->count].offset = consumed_len;
+                index->count++;
+            }
             switch ((unsigned long)data->eType) {
                 case MSM_VIDC_EXTRADATA_INTERLACE_VIDEO:
                     struct msm_vidc_interlace_payload *payload;
@@ -9192,9 +8699,8 @@ void omx_vdec::handle_extradata(OMX_BUFFERHEADERTYPE *p_buf_hdr)
                                PP_PARAM_INTERLACED, (void*)&enable);
                     }
                     if (client_extradata & OMX_INTERLACE_EXTRADATA) {
-                        append_interlace_extradata(p_extra, payload->format,
+                        append_interlace_extradata(payload->format,
                                       p_buf_hdr->nFlags & QOMX_VIDEO_BUFFERFLAG_MBAFF);
-                        p_extra = (OMX_OTHER_EXTRADATATYPE *) (((OMX_U8 *) p_extra) + p_extra->nSize);
                     }
                     break;
                 case MSM_VIDC_EXTRADATA_FRAME_RATE:
@@ -9244,9 +8750,9 @@ void omx_vdec::handle_extradata(OMX_BUFFERHEADERTYPE *p_buf_hdr)
                case MSM_VIDC_EXTRADATA_PANSCAN_WINDOW:
                     panscan_payload = (struct msm_vidc_panscan_window_payload *)(void *)data->data;
                     if (panscan_payload->num_panscan_windows > MAX_PAN_SCAN_WINDOWS) {
-                        DEBUG_PRINT_ERROR("Panscan windows are more than supported\n");
-                        DEBUG_PRINT_ERROR("Max supported = %d FW returned = %d\n",
-                            MAX_PAN_SCAN_WINDOWS, panscan_payload->num_panscan_windows);
+                        DEBUG_PRINT_ERROR_RATELIMITED("Panscan windows are more than supported, "
+                                "max supported = %d FW returned = %d",
+                                MAX_PAN_SCAN_WINDOWS, panscan_payload->num_panscan_windows);
                         return;
                     }
                     break;
@@ -9262,30 +8768,26 @@ void omx_vdec::handle_extradata(OMX_BUFFERHEADERTYPE *p_buf_hdr)
                     struct msm_vidc_s3d_frame_packing_payload *s3d_frame_packing_payload;
                     s3d_frame_packing_payload = (struct msm_vidc_s3d_frame_packing_payload *)(void *)data->data;
                     if (client_extradata & OMX_FRAMEPACK_EXTRADATA) {
-                        append_framepack_extradata(p_extra, s3d_frame_packing_payload);
-                        p_extra = (OMX_OTHER_EXTRADATATYPE *) (((OMX_U8 *) p_extra) + p_extra->nSize);
+                        append_framepack_extradata(s3d_frame_packing_payload);
                     }
                     break;
                 case MSM_VIDC_EXTRADATA_FRAME_QP:
                     struct msm_vidc_frame_qp_payload *qp_payload;
                     qp_payload = (struct msm_vidc_frame_qp_payload*)(void *)data->data;
-                    if (client_extradata & OMX_QP_EXTRADATA) {
-                        append_qp_extradata(p_extra, qp_payload);
-                        p_extra = (OMX_OTHER_EXTRADATATYPE *) (((OMX_U8 *) p_extra) + p_extra->nSize);
+                    if (append_extradata & OMX_QP_EXTRADATA) {
+                        append_qp_extradata(qp_payload);
                     }
                     break;
                 case MSM_VIDC_EXTRADATA_FRAME_BITS_INFO:
                     struct msm_vidc_frame_bits_info_payload *bits_info_payload;
                     bits_info_payload = (struct msm_vidc_frame_bits_info_payload*)(void *)data->data;
-                    if (client_extradata & OMX_BITSINFO_EXTRADATA) {
-                        append_bitsinfo_extradata(p_extra, bits_info_payload);
-                        p_extra = (OMX_OTHER_EXTRADATATYPE *) (((OMX_U8 *) p_extra) + p_extra->nSize);
+                    if (append_extradata & OMX_BITSINFO_EXTRADATA) {
+                        append_bitsinfo_extradata(bits_info_payload);
                     }
                     break;
                 case MSM_VIDC_EXTRADATA_STREAM_USERDATA:
-                    if (client_extradata & OMX_EXTNUSER_EXTRADATA) {
-                        append_user_extradata(p_extra, data);
-                        p_extra = (OMX_OTHER_EXTRADATATYPE *) (((OMX_U8 *) p_extra) + p_extra->nSize);
+                    if (append_extradata & OMX_EXTNUSER_EXTRADATA) {
+                        append_user_extradata(data);
                     }
                     break;
                 default:
@@ -9295,23 +8797,36 @@ void omx_vdec::handle_extradata(OMX_BUFFERHEADERTYPE *p_buf_hdr)
             consumed_len += data->nSize;
             data = (OMX_OTHER_EXTRADATATYPE *)((char *)data + data->nSize);
         }
-        if (client_extradata & OMX_FRAMEINFO_EXTRADATA) {
+        if (append_extradata & OMX_FRAMEINFO_EXTRADATA) {
             p_buf_hdr->nFlags |= OMX_BUFFERFLAG_EXTRADATA;
-            append_frame_info_extradata(p_extra,
+            append_frame_info_extradata(
                     num_conceal_MB, ((struct vdec_output_frameinfo *)p_buf_hdr->pOutputPortPrivate)->pic_type, frame_rate,
                     time_stamp, panscan_payload,&((struct vdec_output_frameinfo *)
                         p_buf_hdr->pOutputPortPrivate)->aspect_ratio_info);
-            p_extra = (OMX_OTHER_EXTRADATATYPE *) (((OMX_U8 *) p_extra) + p_extra->nSize);
         }
-        if (client_extradata & OMX_FRAMEDIMENSION_EXTRADATA) {
-            append_frame_dimension_extradata(p_extra);
-            p_extra = (OMX_OTHER_EXTRADATATYPE *) (((OMX_U8 *) p_extra) + p_extra->nSize);
+        if (append_extradata & OMX_FRAMEDIMENSION_EXTRADATA) {
+            append_frame_dimension_extradata();
         }
     }
 unrecognized_extradata:
+    if (index) {
+        /* get_lazy_extradata() builds the records from here on request */
+        index->num_conceal_mb = num_conceal_MB;
+        index->frame_rate = frame_rate;
+        index->time_stamp = time_stamp;
+        index->interlace = drv_ctx.interlace;
+        index->disp_hor_size = m_disp_hor_size;
+        index->disp_vert_size = m_disp_vert_size;
+        index->frame_dimension.nDecWidth = rectangle.nLeft;
+        index->frame_dimension.nDecHeight = rectangle.nTop;
+        index->frame_dimension.nActualWidth = rectangle.nWidth;
+        index->frame_dimension.nActualHeight = rectangle.nHeight;
+        index->ready = true;
+        return;
+    }
     if (client_extradata && p_extra) {
         p_buf_hdr->nFlags |= OMX_BUFFERFLAG_EXTRADATA;
-        append_terminator_extradata(p_extra);
+        append_terminator_extradata();
     }
     if (secure_mode && p_extradata && m_other_extradata) {
         struct vdec_output_frameinfo  *ptr_extradatabuff = NULL;
@@ -9340,6 +8855,7 @@ OMX_ERRORTYPE omx_vdec::enable_extradata(OMX_U32 requested_extradata,
             client_extradata |= requested_extradata;
         else
             client_extradata = client_extradata & ~requested_extradata;
+        update_extradata_templates();
     }
 
     if (enable) {
@@ -9592,55 +9108,94 @@ void omx_vdec::print_debug_extradata(OMX_OTHER_EXTRADATATYPE *extra)
     }
 }
 
-void omx_vdec::append_interlace_extradata(OMX_OTHER_EXTRADATATYPE *extra,
+/* Headers of the records handle_extradata() appends, rebuilt whenever the
+ * client changes the set of extradata it wants */
+void omx_vdec::update_extradata_templates()
+{
+    m_extradata_writer.set_template(EXTRADATA_REC_INTERLACE,
+            OMX_ExtraDataInterlaceFormat, OMX_INTERLACE_EXTRADATA_SIZE,
+            sizeof(OMX_STREAMINTERLACEFORMAT), true,
+            client_extradata & OMX_INTERLACE_EXTRADATA);
+    m_extradata_writer.set_template(EXTRADATA_REC_FRAMEINFO,
+            OMX_ExtraDataFrameInfo, OMX_FRAMEINFO_EXTRADATA_SIZE,
+            sizeof(OMX_QCOM_EXTRADATA_FRAMEINFO), false,
+            client_extradata & OMX_FRAMEINFO_EXTRADATA);
+    m_extradata_writer.set_template(EXTRADATA_REC_FRAMEDIMENSION,
+            OMX_ExtraDataFrameDimension, OMX_FRAMEDIMENSION_EXTRADATA_SIZE,
+            sizeof(OMX_QCOM_EXTRADATA_FRAMEDIMENSION), false,
+            client_extradata & OMX_FRAMEDIMENSION_EXTRADATA);
+    m_extradata_writer.set_template(EXTRADATA_REC_FRAMEPACK,
+            OMX_ExtraDataFramePackingArrangement, OMX_FRAMEPACK_EXTRADATA_SIZE,
+            sizeof(OMX_QCOM_FRAME_PACK_ARRANGEMENT), false,
+            client_extradata & OMX_FRAMEPACK_EXTRADATA);
+    m_extradata_writer.set_template(EXTRADATA_REC_QP,
+            OMX_ExtraDataQP, OMX_QP_EXTRADATA_SIZE,
+            sizeof(OMX_QCOM_EXTRADATA_QP), false,
+            client_extradata & OMX_QP_EXTRADATA);
+    m_extradata_writer.set_template(EXTRADATA_REC_BITSINFO,
+            OMX_ExtraDataInputBitsInfo, OMX_BITSINFO_EXTRADATA_SIZE,
+            sizeof(OMX_QCOM_EXTRADATA_BITS_INFO), false,
+            client_extradata & OMX_BITSINFO_EXTRADATA);
+    m_extradata_writer.set_template(EXTRADATA_REC_USERDATA,
+            OMX_ExtraDataMP2UserData, OMX_USERDATA_EXTRADATA_SIZE, 0, false,
+            client_extradata & OMX_EXTNUSER_EXTRADATA);
+    m_extradata_writer.set_template(EXTRADATA_REC_PORTDEF,
+            OMX_ExtraDataPortDef, OMX_PORTDEF_EXTRADATA_SIZE,
+            sizeof(OMX_PARAM_PORTDEFINITIONTYPE), false, false);
+}
+
+/* Returns the interlace state the frame leaves the decoder in */
+enum vdec_interlaced_format omx_vdec::fill_interlace_format(
+        OMX_STREAMINTERLACEFORMAT *interlace_format,
         OMX_U32 interlaced_format_type, bool is_mbaff)
 {
-    OMX_STREAMINTERLACEFORMAT *interlace_format;
-
-    if (!(client_extradata & OMX_INTERLACE_EXTRADATA)) {
-        return;
-    }
-    extra->nSize = OMX_INTERLACE_EXTRADATA_SIZE;
-    extra->nVersion.nVersion = OMX_SPEC_VERSION;
-    extra->nPortIndex = OMX_CORE_OUTPUT_PORT_INDEX;
-    extra->eType = (OMX_EXTRADATATYPE)OMX_ExtraDataInterlaceFormat;
-    extra->nDataSize = sizeof(OMX_STREAMINTERLACEFORMAT);
-    interlace_format = (OMX_STREAMINTERLACEFORMAT *)(void *)extra->data;
-    interlace_format->nSize = sizeof(OMX_STREAMINTERLACEFORMAT);
-    interlace_format->nVersion.nVersion = OMX_SPEC_VERSION;
-    interlace_format->nPortIndex = OMX_CORE_OUTPUT_PORT_INDEX;
-
     if ((interlaced_format_type == MSM_VIDC_INTERLACE_FRAME_PROGRESSIVE) && !is_mbaff) {
         interlace_format->bInterlaceFormat = OMX_FALSE;
         interlace_format->nInterlaceFormats = OMX_InterlaceFrameProgressive;
-        drv_ctx.interlace = VDEC_InterlaceFrameProgressive;
+        return VDEC_InterlaceFrameProgressive;
     } else if ((interlaced_format_type == MSM_VIDC_INTERLACE_INTERLEAVE_FRAME_TOPFIELDFIRST) && !is_mbaff) {
         interlace_format->bInterlaceFormat = OMX_TRUE;
         interlace_format->nInterlaceFormats =  OMX_InterlaceInterleaveFrameTopFieldFirst;
-        drv_ctx.interlace = VDEC_InterlaceFrameProgressive;
+        return VDEC_InterlaceFrameProgressive;
     } else if ((interlaced_format_type == MSM_VIDC_INTERLACE_INTERLEAVE_FRAME_BOTTOMFIELDFIRST) && !is_mbaff) {
         interlace_format->bInterlaceFormat = OMX_TRUE;
         interlace_format->nInterlaceFormats = OMX_InterlaceInterleaveFrameBottomFieldFirst;
-        drv_ctx.interlace = VDEC_InterlaceFrameProgressive;
-    } else {
-        interlace_format->bInterlaceFormat = OMX_TRUE;
-        interlace_format->nInterlaceFormats = OMX_InterlaceInterleaveFrameTopFieldFirst;
-        drv_ctx.interlace = VDEC_InterlaceInterleaveFrameTopFieldFirst;
+        return VDEC_InterlaceFrameProgressive;
     }
-    print_debug_extradata(extra);
+    interlace_format->bInterlaceFormat = OMX_TRUE;
+    interlace_format->nInterlaceFormats = OMX_InterlaceInterleaveFrameTopFieldFirst;
+    return VDEC_InterlaceInterleaveFrameTopFieldFirst;
 }
 
-void omx_vdec::append_frame_dimension_extradata(OMX_OTHER_EXTRADATATYPE *extra)
+void omx_vdec::append_interlace_extradata(OMX_U32 interlaced_format_type, bool is_mbaff)
 {
+    OMX_OTHER_EXTRADATATYPE *extra = NULL;
+    OMX_STREAMINTERLACEFORMAT scratch;
+    OMX_STREAMINTERLACEFORMAT *interlace_format = &scratch;
+
+    if (!(client_extradata & OMX_INTERLACE_EXTRADATA)) {
+        return;
+    }
+    /* The decoder state is updated even when no record is written */
+    if (!m_lazy_extradata)
+        extra = m_extradata_writer.append(EXTRADATA_REC_INTERLACE);
+    if (extra)
+        interlace_format = (OMX_STREAMINTERLACEFORMAT *)(void *)extra->data;
+    drv_ctx.interlace = fill_interlace_format(interlace_format, interlaced_format_type, is_mbaff);
+    if (extra)
+        print_debug_extradata(extra);
+}
+
+void omx_vdec::append_frame_dimension_extradata()
+{
+    OMX_OTHER_EXTRADATATYPE *extra;
     OMX_QCOM_EXTRADATA_FRAMEDIMENSION *frame_dimension;
     if (!(client_extradata & OMX_FRAMEDIMENSION_EXTRADATA)) {
         return;
     }
-    extra->nSize = OMX_FRAMEDIMENSION_EXTRADATA_SIZE;
-    extra->nVersion.nVersion = OMX_SPEC_VERSION;
-    extra->nPortIndex = OMX_CORE_OUTPUT_PORT_INDEX;
-    extra->eType = (OMX_EXTRADATATYPE)OMX_ExtraDataFrameDimension;
-    extra->nDataSize = sizeof(OMX_QCOM_EXTRADATA_FRAMEDIMENSION);
+    extra = m_extradata_writer.append(EXTRADATA_REC_FRAMEDIMENSION);
+    if (!extra)
+        return;
     frame_dimension = (OMX_QCOM_EXTRADATA_FRAMEDIMENSION *)(void *)extra->data;
     frame_dimension->nDecWidth = rectangle.nLeft;
     frame_dimension->nDecHeight = rectangle.nTop;
@@ -9652,29 +9207,38 @@ void omx_vdec::fill_aspect_ratio_info(
         struct vdec_aspectratioinfo *aspect_ratio_info,
         OMX_QCOM_EXTRADATA_FRAMEINFO *frame_info)
 {
-    m_extradata = frame_info;
-    m_extradata->aspectRatio.aspectRatioX = aspect_ratio_info->par_width;
-    m_extradata->aspectRatio.aspectRatioY = aspect_ratio_info->par_height;
-    DEBUG_PRINT_LOW("aspectRatioX %u aspectRatioY %u", (unsigned int)m_extradata->aspectRatio.aspectRatioX,
-            (unsigned int)m_extradata->aspectRatio.aspectRatioY);
+    frame_info->aspectRatio.aspectRatioX = aspect_ratio_info->par_width;
+    frame_info->aspectRatio.aspectRatioY = aspect_ratio_info->par_height;
+    DEBUG_PRINT_LOW("aspectRatioX %u aspectRatioY %u", (unsigned int)frame_info->aspectRatio.aspectRatioX,
+            (unsigned int)frame_info->aspectRatio.aspectRatioY);
 }
 
-void omx_vdec::append_frame_info_extradata(OMX_OTHER_EXTRADATATYPE *extra,
+void omx_vdec::append_frame_info_extradata(
         OMX_U32 num_conceal_mb, OMX_U32 picture_type, OMX_U32 frame_rate,
         OMX_TICKS time_stamp, struct msm_vidc_panscan_window_payload *panscan_payload,
         struct vdec_aspectratioinfo *aspect_ratio_info)
 {
-    OMX_QCOM_EXTRADATA_FRAMEINFO *frame_info = NULL;
-    struct msm_vidc_panscan_window *panscan_window;
+    OMX_OTHER_EXTRADATATYPE *extra;
     if (!(client_extradata & OMX_FRAMEINFO_EXTRADATA)) {
         return;
     }
-    extra->nSize = OMX_FRAMEINFO_EXTRADATA_SIZE;
-    extra->nVersion.nVersion = OMX_SPEC_VERSION;
-    extra->nPortIndex = OMX_CORE_OUTPUT_PORT_INDEX;
-    extra->eType = (OMX_EXTRADATATYPE)OMX_ExtraDataFrameInfo;
-    extra->nDataSize = sizeof(OMX_QCOM_EXTRADATA_FRAMEINFO);
-    frame_info = (OMX_QCOM_EXTRADATA_FRAMEINFO *)(void *)extra->data;
+    extra = m_extradata_writer.append(EXTRADATA_REC_FRAMEINFO);
+    if (!extra)
+        return;
+    fill_frame_info_extradata((OMX_QCOM_EXTRADATA_FRAMEINFO *)(void *)extra->data,
+            num_conceal_mb, picture_type, frame_rate, time_stamp, panscan_payload,
+            aspect_ratio_info, drv_ctx.interlace, m_disp_hor_size, m_disp_vert_size);
+    print_debug_extradata(extra);
+}
+
+inline void omx_vdec::fill_frame_info_extradata(OMX_QCOM_EXTRADATA_FRAMEINFO *frame_info,
+        OMX_U32 num_conceal_mb, OMX_U32 picture_type, OMX_U32 frame_rate,
+        OMX_TICKS time_stamp, struct msm_vidc_panscan_window_payload *panscan_payload,
+        struct vdec_aspectratioinfo *aspect_ratio_info,
+        enum vdec_interlaced_format interlace,
+        OMX_U32 disp_hor_size, OMX_U32 disp_vert_size)
+{
+    struct msm_vidc_panscan_window *panscan_window;
     switch (picture_type) {
         case PICTURE_TYPE_I:
             frame_info->ePicType = OMX_VIDEO_PictureTypeI;
@@ -9688,9 +9252,9 @@ void omx_vdec::append_frame_info_extradata(OMX_OTHER_EXTRADATATYPE *extra,
         default:
             frame_info->ePicType = (OMX_VIDEO_PICTURETYPE)0;
     }
-    if (drv_ctx.interlace == VDEC_InterlaceInterleaveFrameTopFieldFirst)
+    if (interlace == VDEC_InterlaceInterleaveFrameTopFieldFirst)
         frame_info->interlaceType = OMX_QCOM_InterlaceInterleaveFrameTopFieldFirst;
-    else if (drv_ctx.interlace == VDEC_InterlaceInterleaveFrameBottomFieldFirst)
+    else if (interlace == VDEC_InterlaceInterleaveFrameBottomFieldFirst)
         frame_info->interlaceType = OMX_QCOM_InterlaceInterleaveFrameBottomFieldFirst;
     else
         frame_info->interlaceType = OMX_QCOM_InterlaceFrameProgressive;
@@ -9700,9 +9264,9 @@ void omx_vdec::append_frame_info_extradata(OMX_OTHER_EXTRADATATYPE *extra,
     frame_info->nTimeStamp = time_stamp;
     frame_info->panScan.numWindows = 0;
     if (output_capability == V4L2_PIX_FMT_MPEG2) {
-        if (m_disp_hor_size && m_disp_vert_size) {
-            frame_info->displayAspectRatio.displayHorizontalSize = m_disp_hor_size;
-            frame_info->displayAspectRatio.displayVerticalSize = m_disp_vert_size;
+        if (disp_hor_size && disp_vert_size) {
+            frame_info->displayAspectRatio.displayHorizontalSize = disp_hor_size;
+            frame_info->displayAspectRatio.displayVerticalSize = disp_vert_size;
         } else {
             frame_info->displayAspectRatio.displayHorizontalSize = 0;
             frame_info->displayAspectRatio.displayVerticalSize = 0;
@@ -9721,17 +9285,12 @@ void omx_vdec::append_frame_info_extradata(OMX_OTHER_EXTRADATATYPE *extra,
         }
     }
     fill_aspect_ratio_info(aspect_ratio_info, frame_info);
-    print_debug_extradata(extra);
 }
 
 void omx_vdec::append_portdef_extradata(OMX_OTHER_EXTRADATATYPE *extra)
 {
     OMX_PARAM_PORTDEFINITIONTYPE *portDefn = NULL;
-    extra->nSize = OMX_PORTDEF_EXTRADATA_SIZE;
-    extra->nVersion.nVersion = OMX_SPEC_VERSION;
-    extra->nPortIndex = OMX_CORE_OUTPUT_PORT_INDEX;
-    extra->eType = (OMX_EXTRADATATYPE)OMX_ExtraDataPortDef;
-    extra->nDataSize = sizeof(OMX_PARAM_PORTDEFINITIONTYPE);
+    m_extradata_writer.stamp(extra, EXTRADATA_REC_PORTDEF);
     portDefn = (OMX_PARAM_PORTDEFINITIONTYPE *)(void *)extra->data;
     *portDefn = m_port_def;
     DEBUG_PRINT_LOW("append_portdef_extradata height = %u width = %u "
@@ -9741,97 +9300,244 @@ void omx_vdec::append_portdef_extradata(OMX_OTHER_EXTRADATATYPE *extra)
             (unsigned int)portDefn->format.video.nSliceHeight);
 }
 
-void omx_vdec::append_framepack_extradata(OMX_OTHER_EXTRADATATYPE *extra,
+void omx_vdec::append_framepack_extradata(
         struct msm_vidc_s3d_frame_packing_payload *s3d_frame_packing_payload)
 {
-    OMX_QCOM_FRAME_PACK_ARRANGEMENT *framepack;
+    OMX_OTHER_EXTRADATATYPE *extra = NULL;
     if (FRAME_PACK_SIZE*sizeof(OMX_U32) != sizeof(struct msm_vidc_s3d_frame_packing_payload)) {
         DEBUG_PRINT_ERROR("frame packing size mismatch");
         return;
     }
-    extra->nSize = OMX_FRAMEPACK_EXTRADATA_SIZE;
-    extra->nVersion.nVersion = OMX_SPEC_VERSION;
-    extra->nPortIndex = OMX_CORE_OUTPUT_PORT_INDEX;
-    extra->eType = (OMX_EXTRADATATYPE)OMX_ExtraDataFramePackingArrangement;
-    extra->nDataSize = sizeof(OMX_QCOM_FRAME_PACK_ARRANGEMENT);
-    framepack = (OMX_QCOM_FRAME_PACK_ARRANGEMENT *)(void *)extra->data;
+    /* Kept for OMX_QcomIndexConfigVideoFramePackingArrangement */
+    fill_framepack_extradata(&m_frame_pack_arrangement, s3d_frame_packing_payload);
+    if (!m_lazy_extradata)
+        extra = m_extradata_writer.append(EXTRADATA_REC_FRAMEPACK);
+    if (!extra)
+        return;
+    memcpy(extra->data, &m_frame_pack_arrangement,
+        sizeof(OMX_QCOM_FRAME_PACK_ARRANGEMENT));
+    print_debug_extradata(extra);
+}
+
+void omx_vdec::fill_framepack_extradata(OMX_QCOM_FRAME_PACK_ARRANGEMENT *framepack,
+        struct msm_vidc_s3d_frame_packing_payload *s3d_frame_packing_payload)
+{
     framepack->nSize = sizeof(OMX_QCOM_FRAME_PACK_ARRANGEMENT);
     framepack->nVersion.nVersion = OMX_SPEC_VERSION;
     framepack->nPortIndex = OMX_CORE_OUTPUT_PORT_INDEX;
     memcpy(&framepack->id, s3d_frame_packing_payload,
         sizeof(struct msm_vidc_s3d_frame_packing_payload));
-    memcpy(&m_frame_pack_arrangement, framepack,
-        sizeof(OMX_QCOM_FRAME_PACK_ARRANGEMENT));
-    print_debug_extradata(extra);
 }
 
-void omx_vdec::append_qp_extradata(OMX_OTHER_EXTRADATATYPE *extra,
-            struct msm_vidc_frame_qp_payload *qp_payload)
+void omx_vdec::append_qp_extradata(struct msm_vidc_frame_qp_payload *qp_payload)
 {
+    OMX_OTHER_EXTRADATATYPE *extra;
     OMX_QCOM_EXTRADATA_QP * qp = NULL;
     if (!qp_payload) {
         DEBUG_PRINT_ERROR("QP payload is NULL");
         return;
     }
-    extra->nSize = OMX_QP_EXTRADATA_SIZE;
-    extra->nVersion.nVersion = OMX_SPEC_VERSION;
-    extra->nPortIndex = OMX_CORE_OUTPUT_PORT_INDEX;
-    extra->eType = (OMX_EXTRADATATYPE)OMX_ExtraDataQP;
-    extra->nDataSize = sizeof(OMX_QCOM_EXTRADATA_QP);
+    extra = m_extradata_writer.append(EXTRADATA_REC_QP);
+    if (!extra)
+        return;
     qp = (OMX_QCOM_EXTRADATA_QP *)(void *)extra->data;
     qp->nQP = qp_payload->frame_qp;
     print_debug_extradata(extra);
 }
 
-void omx_vdec::append_bitsinfo_extradata(OMX_OTHER_EXTRADATATYPE *extra,
-            struct msm_vidc_frame_bits_info_payload *bits_payload)
+void omx_vdec::append_bitsinfo_extradata(struct msm_vidc_frame_bits_info_payload *bits_payload)
 {
+    OMX_OTHER_EXTRADATATYPE *extra;
     OMX_QCOM_EXTRADATA_BITS_INFO * bits = NULL;
     if (!bits_payload) {
         DEBUG_PRINT_ERROR("bits info payload is NULL");
         return;
     }
-    extra->nSize = OMX_BITSINFO_EXTRADATA_SIZE;
-    extra->nVersion.nVersion = OMX_SPEC_VERSION;
-    extra->nPortIndex = OMX_CORE_OUTPUT_PORT_INDEX;
-    extra->eType = (OMX_EXTRADATATYPE)OMX_ExtraDataInputBitsInfo;
-    extra->nDataSize = sizeof(OMX_QCOM_EXTRADATA_BITS_INFO);
+    extra = m_extradata_writer.append(EXTRADATA_REC_BITSINFO);
+    if (!extra)
+        return;
     bits = (OMX_QCOM_EXTRADATA_BITS_INFO*)(void *)extra->data;
     bits->frame_bits = bits_payload->frame_bits;
     bits->header_bits = bits_payload->header_bits;
     print_debug_extradata(extra);
 }
 
-void omx_vdec::append_user_extradata(OMX_OTHER_EXTRADATATYPE *extra,
-            OMX_OTHER_EXTRADATATYPE *p_user)
-{
-    int userdata_size = 0;
-    struct msm_vidc_stream_userdata_payload *userdata_payload = NULL;
-    userdata_payload =
-        (struct msm_vidc_stream_userdata_payload *)(void *)p_user->data;
-    userdata_size = p_user->nDataSize;
-    extra->nSize = OMX_USERDATA_EXTRADATA_SIZE + userdata_size;
-    extra->nVersion.nVersion = OMX_SPEC_VERSION;
-    extra->nPortIndex = OMX_CORE_OUTPUT_PORT_INDEX;
-    extra->eType = (OMX_EXTRADATATYPE)OMX_ExtraDataMP2UserData;
-    extra->nDataSize = userdata_size;
-    if (extra->data && p_user->data && extra->nDataSize)
+void omx_vdec::append_user_extradata(OMX_OTHER_EXTRADATATYPE *p_user)
+{
+    OMX_OTHER_EXTRADATATYPE *extra;
+
+    extra = m_extradata_writer.append(EXTRADATA_REC_USERDATA, p_user->nDataSize);
+    if (!extra) {
+        DEBUG_PRINT_ERROR_RATELIMITED("No room for %u bytes of user extradata",
+                (unsigned int)p_user->nDataSize);
+        return;
+    }
+    if (extra->nDataSize)
         memcpy(extra->data, p_user->data, extra->nDataSize);
     print_debug_extradata(extra);
 }
 
-void omx_vdec::append_terminator_extradata(OMX_OTHER_EXTRADATATYPE *extra)
+void omx_vdec::append_terminator_extradata()
 {
     if (!client_extradata) {
         return;
     }
-    extra->nSize = sizeof(OMX_OTHER_EXTRADATATYPE);
-    extra->nVersion.nVersion = OMX_SPEC_VERSION;
-    extra->eType = OMX_ExtraDataNone;
-    extra->nDataSize = 0;
-    extra->data[0] = 0;
+    print_debug_extradata(m_extradata_writer.finish());
+}
+
+static OMX_OTHER_EXTRADATATYPE *find_lazy_extradata(struct vdec_extradata_index *index,
+        char *slot, OMX_U32 type)
+{
+    for (OMX_U32 i = 0; i < index->count; i++) {
+        if (index->entry[i].type == type)
+            return (OMX_OTHER_EXTRADATATYPE *)(void *)(slot + index->entry[i].offset);
+    }
+    return NULL;
+}
+
+/* Builds one record of a buffer the client holds, from the index
+ * handle_extradata() left behind in lazy mode. Runs on the client's thread;
+ * the buffer's index and extradata slot are not touched again until the
+ * buffer comes back through FTB. */
+OMX_ERRORTYPE omx_vdec::get_lazy_extradata(QOMX_VIDEO_EXTRADATA_QUERY *query)
+{
+    struct vdec_extradata_index *index;
+    struct vdec_output_frameinfo *frameinfo;
+    OMX_OTHER_EXTRADATATYPE *extra, *data = NULL;
+    extradata_record rec;
+    OMX_U32 mask, size, data_size = 0;
+    bool needs_data = true;
+    long buf_index;
+    char *slot;
+
+    if (!m_lazy_extradata || !m_extradata_index) {
+        DEBUG_PRINT_ERROR("get_lazy_extradata: lazy extradata is not enabled");
+        return OMX_ErrorIncorrectStateOperation;
+    }
+    if (query->nPortIndex != OMX_CORE_OUTPUT_PORT_INDEX) {
+        DEBUG_PRINT_ERROR("get_lazy_extradata: bad port index %u", (unsigned int)query->nPortIndex);
+        return OMX_ErrorBadPortIndex;
+    }
+    buf_index = query->pBufferHdr - client_buffers.get_il_buf_hdr();
+    if (!query->pBufferHdr || buf_index < 0 || buf_index >= m_extradata_index_count ||
+            buf_index >= drv_ctx.extradata_info.count) {
+        DEBUG_PRINT_ERROR("get_lazy_extradata: invalid buffer %p", query->pBufferHdr);
+        return OMX_ErrorBadParameter;
+    }
+    index = &m_extradata_index[buf_index];
+    if (!index->ready)
+        return OMX_ErrorNotReady;
+    slot = drv_ctx.extradata_info.uaddr + buf_index * drv_ctx.extradata_info.buffer_size;
+
+    switch (query->nExtradataType) {
+        case OMX_ExtraDataInterlaceFormat:
+            rec = EXTRADATA_REC_INTERLACE;
+            mask = OMX_INTERLACE_EXTRADATA;
+            data = find_lazy_extradata(index, slot, MSM_VIDC_EXTRADATA_INTERLACE_VIDEO);
+            break;
+        case OMX_ExtraDataFrameInfo:
+            rec = EXTRADATA_REC_FRAMEINFO;
+            mask = OMX_FRAMEINFO_EXTRADATA;
+            needs_data = false;
+            break;
+        case OMX_ExtraDataFrameDimension:
+            rec = EXTRADATA_REC_FRAMEDIMENSION;
+            mask = OMX_FRAMEDIMENSION_EXTRADATA;
+            needs_data = false;
+            break;
+        case OMX_ExtraDataFramePackingArrangement:
+            rec = EXTRADATA_REC_FRAMEPACK;
+            mask = OMX_FRAMEPACK_EXTRADATA;
+            data = find_lazy_extradata(index, slot, MSM_VIDC_EXTRADATA_S3D_FRAME_PACKING);
+            break;
+        case OMX_ExtraDataQP:
+            rec = EXTRADATA_REC_QP;
+            mask = OMX_QP_EXTRADATA;
+            data = find_lazy_extradata(index, slot, MSM_VIDC_EXTRADATA_FRAME_QP);
+            break;
+        case OMX_ExtraDataInputBitsInfo:
+            rec = EXTRADATA_REC_BITSINFO;
+            mask = OMX_BITSINFO_EXTRADATA;
+            data = find_lazy_extradata(index, slot, MSM_VIDC_EXTRADATA_FRAME_BITS_INFO);
+            break;
+        case OMX_ExtraDataMP2UserData:
+            rec = EXTRADATA_REC_USERDATA;
+            mask = OMX_EXTNUSER_EXTRADATA;
+            data = find_lazy_extradata(index, slot, MSM_VIDC_EXTRADATA_STREAM_USERDATA);
+            if (data)
+                data_size = data->nDataSize;
+            break;
+        default:
+            DEBUG_PRINT_ERROR("get_lazy_extradata: unsupported type %x",
+                    (unsigned int)query->nExtradataType);
+            return OMX_ErrorUnsupportedIndex;
+    }
+    if (!(client_extradata & mask)) {
+        DEBUG_PRINT_ERROR("get_lazy_extradata: type %x is not enabled",
+                (unsigned int)query->nExtradataType);
+        return OMX_ErrorUnsupportedSetting;
+    }
+    if (needs_data && !data)
+        return OMX_ErrorNoMore;
 
+    size = m_extradata_writer.record_size(rec, data_size);
+    if (!query->pData || query->nDataSize < size) {
+        query->nDataSize = size;
+        return OMX_ErrorOverflow;
+    }
+    extra = (OMX_OTHER_EXTRADATATYPE *)(void *)query->pData;
+    m_extradata_writer.stamp(extra, rec);
+    extra->nSize = size;
+
+    frameinfo = (struct vdec_output_frameinfo *)m_out_mem_ptr[buf_index].pOutputPortPrivate;
+    switch (rec) {
+        case EXTRADATA_REC_INTERLACE:
+            fill_interlace_format((OMX_STREAMINTERLACEFORMAT *)(void *)extra->data,
+                    ((struct msm_vidc_interlace_payload *)(void *)data->data)->format,
+                    m_out_mem_ptr[buf_index].nFlags & QOMX_VIDEO_BUFFERFLAG_MBAFF);
+            break;
+        case EXTRADATA_REC_FRAMEINFO: {
+            struct msm_vidc_panscan_window_payload *panscan_payload = NULL;
+            data = find_lazy_extradata(index, slot, MSM_VIDC_EXTRADATA_PANSCAN_WINDOW);
+            if (data)
+                panscan_payload = (struct msm_vidc_panscan_window_payload *)(void *)data->data;
+            fill_frame_info_extradata((OMX_QCOM_EXTRADATA_FRAMEINFO *)(void *)extra->data,
+                    index->num_conceal_mb, frameinfo->pic_type, index->frame_rate,
+                    index->time_stamp, panscan_payload, &frameinfo->aspect_ratio_info,
+                    index->interlace, index->disp_hor_size, index->disp_vert_size);
+            break;
+        }
+        case EXTRADATA_REC_FRAMEDIMENSION:
+            memcpy(extra->data, &index->frame_dimension,
+                    sizeof(OMX_QCOM_EXTRADATA_FRAMEDIMENSION));
+            break;
+        case EXTRADATA_REC_FRAMEPACK:
+            fill_framepack_extradata((OMX_QCOM_FRAME_PACK_ARRANGEMENT *)(void *)extra->data,
+                    (struct msm_vidc_s3d_frame_packing_payload *)(void *)data->data);
+            break;
+        case EXTRADATA_REC_QP:
+            ((OMX_QCOM_EXTRADATA_QP *)(void *)extra->data)->nQP =
+                ((struct msm_vidc_frame_qp_payload *)(void *)data->data)->frame_qp;
+            break;
+        case EXTRADATA_REC_BITSINFO: {
+            OMX_QCOM_EXTRADATA_BITS_INFO *bits = (OMX_QCOM_EXTRADATA_BITS_INFO *)(void *)extra->data;
+            struct msm_vidc_frame_bits_info_payload *bits_payload =
+                (struct msm_vidc_frame_bits_info_payload *)(void *)data->data;
+            bits->frame_bits = bits_payload->frame_bits;
+            bits->header_bits = bits_payload->header_bits;
+            break;
+        }
+        case EXTRADATA_REC_USERDATA:
+            extra->nDataSize = data_size;
+            if (data_size)
+                memcpy(extra->data, data->data, data_size);
+            break;
+        default:
+            break;
+    }
+    query->nDataSize = size;
     print_debug_extradata(extra);
+    return OMX_ErrorNone;
 }
 
 OMX_ERRORTYPE  omx_vdec::allocate_desc_buffer(OMX_U32 index)
@@ -10020,6 +9726,7 @@ void omx_vdec::allocate_color_convert_buf::init_members()
 #ifdef USE_ION
     memset(op_buf_ion_info,0,sizeof(m_platform_entry_client));
 #endif
+    memset(m_convert_fence, 0, sizeof(m_convert_fence));
     for (int i = 0; i < MAX_COUNT; i++)
         pmem_fd[i] = -1;
 }
@@ -10050,6 +9757,8 @@ bool omx_vdec::allocate_color_convert_buf::update_buffer_req()
         goto fail_update_buf_req;
     }
     c2d.close();
+    // Closing waited for everything queued, the fences die with it
+    memset(m_convert_fence, 0, sizeof(m_convert_fence));
     status = c2d.open(omx->drv_ctx.video_resolution.frame_height,
             omx->drv_ctx.video_resolution.frame_width,
             NV12_128m,dest_format);
@@ -10118,6 +9827,7 @@ bool omx_vdec::allocate_color_convert_buf::set_color_format(
             if (enabled)
                 c2d.destroy();
             enabled = false;
+            memset(m_convert_fence, 0, sizeof(m_convert_fence));
             if (!c2d.init()) {
                 DEBUG_PRINT_ERROR("open failed for c2d");
                 status = false;
@@ -10128,6 +9838,7 @@ bool omx_vdec::allocate_color_convert_buf::set_color_format(
         if (enabled)
             c2d.destroy();
         enabled = false;
+        memset(m_convert_fence, 0, sizeof(m_convert_fence));
     }
     pthread_mutex_unlock(&omx->c_lock);
     return status;
@@ -10160,12 +9871,14 @@ OMX_BUFFERHEADERTYPE* omx_vdec::allocate_color_convert_buf::get_il_buf_hdr()
         m_out_mem_ptr_client[index].nFlags = (bufadd->nFlags & OMX_BUFFERFLAG_EOS);
         m_out_mem_ptr_client[index].nTimeStamp = bufadd->nTimeStamp;
         bool status;
+        pthread_mutex_lock(&omx->c_lock);
         if (!omx->in_reconfig && !omx->output_flush_progress && bufadd->nFilledLen) {
-            pthread_mutex_lock(&omx->c_lock);
-            cache_clean_buffer(index);
-            status = c2d.convert(omx->drv_ctx.ptr_outputbuffer[index].pmem_fd,
-                    omx->m_out_mem_ptr->pBuffer, bufadd->pBuffer, pmem_fd[index],
-                    pmem_baseaddress[index], pmem_baseaddress[index]);
+            /* Normally queued by the async thread when the driver returned
+             * the buffer, only converted here if that did not happen */
+            status = m_convert_fence[index] || submit_locked(index, bufadd);
+            if (status)
+                status = c2d.wait(m_convert_fence[index]);
+            m_convert_fence[index] = 0;
             if (!status) {
                 DEBUG_PRINT_ERROR("Failed color conversion %d", status);
                 m_out_mem_ptr_client[index].nFilledLen = 0;
@@ -10177,15 +9890,59 @@ OMX_BUFFERHEADERTYPE* omx_vdec::allocate_color_convert_buf::get_il_buf_hdr()
                 m_out_mem_ptr_client[index].nFilledLen = filledLen;
                 cache_clean_invalidate_buffer(index);
             }
-            pthread_mutex_unlock(&omx->c_lock);
-        } else
+        } else {
+            /* Flushed or reconfiguring: the client buffer goes back empty,
+             * but not while a queued conversion may still write it */
+            if (m_convert_fence[index])
+                c2d.wait(m_convert_fence[index]);
+            m_convert_fence[index] = 0;
             m_out_mem_ptr_client[index].nFilledLen = 0;
+        }
+        pthread_mutex_unlock(&omx->c_lock);
         return &m_out_mem_ptr_client[index];
     }
     DEBUG_PRINT_ERROR("Index messed up in the get_il_buf_hdr");
     return NULL;
 }
 
+/* Called with c_lock held */
+bool omx_vdec::allocate_color_convert_buf::submit_locked(unsigned int index,
+        OMX_BUFFERHEADERTYPE *bufadd)
+{
+    cache_clean_buffer(index);
+    return c2d.submit(omx->drv_ctx.ptr_outputbuffer[index].pmem_fd,
+            omx->m_out_mem_ptr->pBuffer, bufadd->pBuffer, pmem_fd[index],
+            pmem_baseaddress[index], pmem_baseaddress[index],
+            m_convert_fence[index]);
+}
+
+/*
+ * Queues the conversion of a decoded buffer from the async thread, before
+ * its FBD event is posted. The GPU then converts frame N+1 while the message
+ * thread is still returning frame N, and get_il_buf_hdr only waits for the
+ * fence. Anything not submitted here is converted synchronously at FBD.
+ */
+void omx_vdec::allocate_color_convert_buf::submit_conversion(OMX_BUFFERHEADERTYPE *bufadd)
+{
+    unsigned int index;
+
+    if (!omx || !bufadd || !bufadd->nFilledLen)
+        return;
+    index = bufadd - omx->m_out_mem_ptr;
+    if (index >= omx->drv_ctx.op_buf.actualcount)
+        return;
+
+    /* enabled changes under c_lock when the client switches the output
+     * format, so it is only read with the lock held */
+    pthread_mutex_lock(&omx->c_lock);
+    if (enabled && !omx->in_reconfig && !omx->output_flush_progress &&
+            !m_convert_fence[index]) {
+        if (!submit_locked(index, bufadd))
+            DEBUG_PRINT_LOW("Color conversion of buffer %u deferred to FBD", index);
+    }
+    pthread_mutex_unlock(&omx->c_lock);
+}
+
     OMX_BUFFERHEADERTYPE* omx_vdec::allocate_color_convert_buf::get_dr_buf_hdr
 (OMX_BUFFERHEADERTYPE *bufadd)
 {
@@ -10243,6 +10000,15 @@ OMX_ERRORTYPE omx_vdec::allocate_color_convert_buf::free_output_buffer(
         DEBUG_PRINT_ERROR("Incorrect index color convert free_output_buffer");
         return OMX_ErrorBadParameter;
     }
+    pthread_mutex_lock(&omx->c_lock);
+    if (m_convert_fence[index])
+        c2d.wait(m_convert_fence[index]);
+    m_convert_fence[index] = 0;
+    c2d.release_buffer(omx->drv_ctx.ptr_outputbuffer[index].pmem_fd,
+            omx->m_out_mem_ptr->pBuffer);
+    if (pmem_fd[index] > 0)
+        c2d.release_buffer(pmem_fd[index], pmem_baseaddress[index]);
+    pthread_mutex_unlock(&omx->c_lock);
     if (pmem_fd[index] > 0) {
         munmap(pmem_baseaddress[index], buffer_size_req);
         close(pmem_fd[index]);
@@ -10419,85 +10185,62 @@ OMX_ERRORTYPE omx_vdec::allocate_color_convert_buf::cache_ops(
 
 void omx_vdec::buf_ref_add(OMX_U32 fd, OMX_U32 offset)
 {
-    unsigned long i = 0;
-    bool buf_present = false;
+    int ref_count;
 
     if (!dynamic_buf_mode) {
         return;
     }
 
-    if (!out_dynamic_list) {
-        DEBUG_PRINT_ERROR("buf_ref_add: out_dynamic_list is NULL");
+    if (!out_dynamic_table.is_init()) {
+        DEBUG_PRINT_ERROR("buf_ref_add: out_dynamic_table is not allocated");
         return;
     }
 
     pthread_mutex_lock(&m_lock);
-    for (i = 0; i < drv_ctx.op_buf.actualcount; i++) {
-        //check the buffer fd, offset, uv addr with list contents
-        //If present increment reference.
-        if ((out_dynamic_list[i].fd == fd) &&
-            (out_dynamic_list[i].offset == offset)) {
-               out_dynamic_list[i].ref_count++;
-               DEBUG_PRINT_LOW("buf_ref_add: [ALREADY PRESENT] fd = %u ref_count = %u",
-                     (unsigned int)out_dynamic_list[i].fd, (unsigned int)out_dynamic_list[i].ref_count);
-               buf_present = true;
-               break;
-        }
-    }
-    if (!buf_present) {
-        for (i = 0; i < drv_ctx.op_buf.actualcount; i++) {
-            //search for a entry to insert details of the new buffer
-            if (out_dynamic_list[i].dup_fd == 0) {
-                out_dynamic_list[i].fd = fd;
-                out_dynamic_list[i].offset = offset;
-                out_dynamic_list[i].dup_fd = dup(fd);
-                out_dynamic_list[i].ref_count++;
-                DEBUG_PRINT_LOW("buf_ref_add: [ADDED] fd = %u ref_count = %u",
-                     (unsigned int)out_dynamic_list[i].fd, (unsigned int)out_dynamic_list[i].ref_count);
-                break;
-            }
-        }
+    ref_count = out_dynamic_table.add(fd, offset);
+    if (ref_count < 0) {
+        DEBUG_PRINT_ERROR("buf_ref_add: cannot track fd = %u offset = %u, %u buffers held",
+                (unsigned int)fd, (unsigned int)offset, out_dynamic_table.held_buffers());
+    } else {
+        DEBUG_PRINT_LOW("buf_ref_add: %s fd = %u ref_count = %d",
+                ref_count == 1 ? "[ADDED]" : "[ALREADY PRESENT]",
+                (unsigned int)fd, ref_count);
     }
-   pthread_mutex_unlock(&m_lock);
+    pthread_mutex_unlock(&m_lock);
 }
 
 void omx_vdec::buf_ref_remove(OMX_U32 fd, OMX_U32 offset)
 {
-    unsigned long i = 0;
+    int ref_count;
 
     if (!dynamic_buf_mode) {
         return;
     }
 
-    if (!out_dynamic_list) {
-        DEBUG_PRINT_ERROR("buf_ref_add: out_dynamic_list is NULL");
+    if (!out_dynamic_table.is_init()) {
+        DEBUG_PRINT_ERROR("buf_ref_remove: out_dynamic_table is not allocated");
         return;
     }
 
     pthread_mutex_lock(&m_lock);
-    for (i = 0; i < drv_ctx.op_buf.actualcount; i++) {
-        //check the buffer fd, offset, uv addr with list contents
-        //If present decrement reference.
-        if ((out_dynamic_list[i].fd == fd) &&
-            (out_dynamic_list[i].offset == offset)) {
-            out_dynamic_list[i].ref_count--;
-            if (out_dynamic_list[i].ref_count == 0) {
-                close(out_dynamic_list[i].dup_fd);
-                DEBUG_PRINT_LOW("buf_ref_remove: [REMOVED] fd = %u ref_count = %u",
-                     (unsigned int)out_dynamic_list[i].fd, (unsigned int)out_dynamic_list[i].ref_count);
-                out_dynamic_list[i].dup_fd = 0;
-                out_dynamic_list[i].fd = 0;
-                out_dynamic_list[i].offset = 0;
-            }
-            break;
-        }
-    }
-    if (i  >= drv_ctx.op_buf.actualcount) {
+    ref_count = out_dynamic_table.remove(fd, offset);
+    if (ref_count < 0) {
         DEBUG_PRINT_ERROR("Error - could not remove ref, no match with any entry in list");
+    } else if (ref_count == 0) {
+        DEBUG_PRINT_LOW("buf_ref_remove: [REMOVED] fd = %u, firmware holds %u buffers",
+                (unsigned int)fd, out_dynamic_table.held_buffers());
     }
     pthread_mutex_unlock(&m_lock);
 }
 
+void omx_vdec::buf_ref_query(OMX_U32 *buffers, OMX_U32 *refs)
+{
+    pthread_mutex_lock(&m_lock);
+    *buffers = out_dynamic_table.held_buffers();
+    *refs = out_dynamic_table.held_refs();
+    pthread_mutex_unlock(&m_lock);
+}
+
 #ifdef _MSM8974_
 void omx_vdec::send_codec_config() {
     if (codec_config_flag) {
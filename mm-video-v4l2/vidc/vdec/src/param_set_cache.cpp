@@ -0,0 +1,166 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2015, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of The Linux Foundation nor
+      the names of its contributors may be used to endorse or promote
+      products derived from this software without specific prior written
+      permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+#define LOG_TAG "OMX_VDEC_PARAMSET"
+
+#include <string.h>
+
+#include "param_set_cache.h"
+#include "vidc_debug.h"
+
+param_set_cache::param_set_cache()
+{
+    reset();
+}
+
+void param_set_cache::reset()
+{
+    count = 0;
+    memset(&announced, 0, sizeof(announced));
+    announced_valid = false;
+}
+
+/* 64 bit FNV-1a taken a word at a time, with a final avalanche so that the
+   low bits depend on every input byte. Parameter sets are tens of bytes, a
+   byte-wise hash would cost about as much as parsing them. */
+OMX_U64 param_set_cache::hash(const OMX_U8 *data, OMX_U32 len)
+{
+    const OMX_U64 prime = 0x100000001b3ULL;
+    OMX_U64 h = 0xcbf29ce484222325ULL ^ len;
+    OMX_U64 w;
+
+    for (; len >= 8; data += 8, len -= 8) {
+        memcpy(&w, data, 8);
+        h = (h ^ w) * prime;
+    }
+    for (; len; data++, len--) {
+        h = (h ^ *data) * prime;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h;
+}
+
+void param_set_cache::make_key(const OMX_U8 *payload, OMX_U32 len,
+        param_set_key &key)
+{
+    /* Zero bytes after rbsp_trailing_bits belong to the next start code or
+       are trailing_zero_8bits, neither changes the parameter set */
+    while (len && !payload[len - 1]) {
+        len--;
+    }
+    key.hash = hash(payload, len);
+    key.len = len;
+}
+
+bool param_set_cache::is_repeat(const OMX_U8 *payload, OMX_U32 len,
+        param_set_key &key)
+{
+    OMX_U32 i;
+
+    make_key(payload, len, key);
+    for (i = 0; i < count; i++) {
+        if (sps[i].key.hash == key.hash && sps[i].key.len == key.len) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void param_set_cache::store(OMX_U32 id, const param_set_key &key)
+{
+    OMX_U32 i;
+
+    for (i = 0; i < count && sps[i].id != id; i++);
+    if (i == count) {
+        if (i == PARAM_SET_MAX_SPS) {
+            return;
+        }
+        count++;
+    }
+    sps[i].id = id;
+    sps[i].key = key;
+}
+
+void param_set_cache::remove(OMX_U32 id)
+{
+    OMX_U32 i;
+
+    for (i = 0; i < count; i++) {
+        if (sps[i].id == id) {
+            sps[i] = sps[--count];
+            return;
+        }
+    }
+}
+
+OMX_U32 param_set_cache::update_stream(const stream_params &params)
+{
+    OMX_U32 changes = 0;
+
+    if (!announced_valid) {
+        changes = STREAM_CHANGE_RESOLUTION | STREAM_CHANGE_CROP |
+            STREAM_CHANGE_PROFILE | STREAM_CHANGE_FORMAT;
+    } else {
+        if (params.width != announced.width ||
+                params.height != announced.height) {
+            changes |= STREAM_CHANGE_RESOLUTION;
+        }
+        if (params.crop_left != announced.crop_left ||
+                params.crop_top != announced.crop_top ||
+                params.crop_width != announced.crop_width ||
+                params.crop_height != announced.crop_height) {
+            changes |= STREAM_CHANGE_CROP;
+        }
+        if (params.profile != announced.profile ||
+                params.level != announced.level) {
+            changes |= STREAM_CHANGE_PROFILE;
+        }
+        if (params.chroma_format != announced.chroma_format ||
+                params.bit_depth_luma != announced.bit_depth_luma ||
+                params.bit_depth_chroma != announced.bit_depth_chroma ||
+                params.interlaced != announced.interlaced) {
+            changes |= STREAM_CHANGE_FORMAT;
+        }
+    }
+    if (changes) {
+        DEBUG_PRINT_HIGH("Stream %ux%u crop %u,%u %ux%u profile %u level %u "
+                "chroma %u depth %u/%u%s, changes 0x%x",
+                (unsigned int)params.width, (unsigned int)params.height,
+                (unsigned int)params.crop_left, (unsigned int)params.crop_top,
+                (unsigned int)params.crop_width, (unsigned int)params.crop_height,
+                (unsigned int)params.profile, (unsigned int)params.level,
+                (unsigned int)params.chroma_format,
+                (unsigned int)params.bit_depth_luma,
+                (unsigned int)params.bit_depth_chroma,
+                params.interlaced ? " interlaced" : "", (unsigned int)changes);
+    }
+    announced = params;
+    announced_valid = true;
+    return changes;
+}
@@ -44,111 +44,20 @@ void omx_time_stamp_reorder::enable_debug_print(bool flag)
 
 omx_time_stamp_reorder::~omx_time_stamp_reorder()
 {
-    delete_list();
     pthread_mutex_destroy(&m_lock);
 }
 
 omx_time_stamp_reorder::omx_time_stamp_reorder()
 {
     reorder_ts = false;
-    phead = pcurrent = NULL;
     error = false;
     print_debug = false;
     pthread_mutex_init(&m_lock, NULL);
 }
 
-void omx_time_stamp_reorder::delete_list()
-{
-    time_stamp_list *ptemp;
-
-    if (!phead) return;
-
-    while (phead->next != phead) {
-        ptemp = phead;
-        phead = phead->next;
-        phead->prev = ptemp->prev;
-        ptemp->prev->next = phead;
-        delete ptemp;
-    }
-
-    delete phead;
-    phead = NULL;
-}
-
-bool omx_time_stamp_reorder::get_current_list()
-{
-    if (!phead) {
-        if (!add_new_list()) {
-            handle_error();
-            return false;
-        }
-    }
-
-    pcurrent = phead->prev;
-    return true;
-}
-
-bool omx_time_stamp_reorder::update_head()
-{
-    time_stamp_list *ptemp;
-
-    if (!phead) return false;
-
-    if (phead->next != phead) {
-        ptemp = phead;
-        phead = ptemp->next;
-        phead->prev = ptemp->prev;
-        ptemp->prev->next = phead;
-        delete ptemp;
-    }
-
-    return true;
-}
-
-bool omx_time_stamp_reorder::add_new_list()
-{
-    bool status = true;
-    time_stamp_list *ptemp = NULL;
-
-    if (!phead) {
-        ptemp = phead = new time_stamp_list;
-
-        if (!phead) {
-            handle_error();
-            status = false;
-            return status;
-        }
-
-        phead->prev = phead->next = phead;
-    } else {
-        ptemp = new time_stamp_list;
-
-        if (!ptemp) {
-            handle_error();
-            status = false;
-            return status;
-        }
-
-        ptemp->prev = phead->prev;
-        ptemp->next = phead;
-        phead->prev->next = ptemp;
-        phead->prev = ptemp;
-    }
-
-    ptemp->entries_filled = 0;
-
-    for (int i=0; i < TIME_SZ; i++) {
-        ptemp->input_timestamps[i].in_use = false;
-        ptemp->input_timestamps[i].timestamps = -1;
-    }
-
-    return status;
-}
-
 bool omx_time_stamp_reorder::insert_timestamp(OMX_BUFFERHEADERTYPE *header)
 {
     auto_lock l(&m_lock);
-    OMX_TICKS *table_entry = NULL;
 
     if (!reorder_ts || error || !header) {
         if (error || !header)
@@ -157,57 +66,27 @@ bool omx_time_stamp_reorder::insert_timestamp(OMX_BUFFERHEADERTYPE *header)
         return false;
     }
 
-    if (!get_current_list()) {
-        handle_error();
-        return false;
-    }
-
-    if (pcurrent->entries_filled > (TIME_SZ - 1)) {
-        DEBUG("Table full return error");
-        handle_error();
-        return false;
-    }
-
     if (header->nFlags & OMX_BUFFERFLAG_CODECCONFIG) {
         return true;
     }
 
     if ((header->nFlags & OMX_BUFFERFLAG_EOS) && !header->nFilledLen) {
         DEBUG("EOS with zero length recieved");
-
-        if (!add_new_list()) {
-            handle_error();
-            return false;
-        }
-
+        ts_heap.new_generation();
         return true;
     }
 
-    for (int i = 0; i < TIME_SZ && !table_entry; i++) {
-        if (!pcurrent->input_timestamps[i].in_use) {
-            table_entry = &pcurrent->input_timestamps[i].timestamps;
-            pcurrent->input_timestamps[i].in_use = true;
-            pcurrent->entries_filled++;
-        }
-    }
-
-    if (!table_entry) {
-        DEBUG("All entries in use");
+    if (!ts_heap.insert(header->nTimeStamp)) {
+        DEBUG("Table full return error");
         handle_error();
         return false;
     }
 
-    *table_entry = header->nTimeStamp;
-
     if (print_debug)
         DEBUG("Time stamp inserted %lld", header->nTimeStamp);
 
-    if (header->nFlags & OMX_BUFFERFLAG_EOS) {
-        if (!add_new_list()) {
-            handle_error();
-            return false;
-        }
-    }
+    if (header->nFlags & OMX_BUFFERFLAG_EOS)
+        ts_heap.new_generation();
 
     return true;
 }
@@ -222,24 +101,11 @@ bool omx_time_stamp_reorder::remove_time_stamp(OMX_TICKS ts, bool is_interlaced
         return false;
     }
 
-    if (!phead || !phead->entries_filled) return false;
+    if (!ts_heap.size()) return false;
 
-    for (int i=0; i < TIME_SZ && num_ent_remove; i++) {
-        if (phead->input_timestamps[i].in_use && phead->input_timestamps[i].timestamps == ts) {
-            phead->input_timestamps[i].in_use = false;
-            phead->entries_filled--;
-            num_ent_remove--;
-
-            if (print_debug)
-                DEBUG("Removed TS %lld", ts);
-        }
-    }
-
-    if (!phead->entries_filled) {
-        if (!update_head()) {
-            handle_error();
-            return false;
-        }
+    while (num_ent_remove-- && ts_heap.remove(ts)) {
+        if (print_debug)
+            DEBUG("Removed TS %lld", ts);
     }
 
     return true;
@@ -248,14 +114,14 @@ bool omx_time_stamp_reorder::remove_time_stamp(OMX_TICKS ts, bool is_interlaced
 void omx_time_stamp_reorder::flush_timestamp()
 {
     auto_lock l(&m_lock);
-    delete_list();
+    ts_heap.reset();
 }
 
 bool omx_time_stamp_reorder::get_next_timestamp(OMX_BUFFERHEADERTYPE *header, bool is_interlaced)
 {
     auto_lock l(&m_lock);
-    timestamp *element = NULL,*duplicate = NULL;
-    bool status = false;
+    OMX_TICKS ts, next_ts;
+    OMX_U32 generation, next_generation;
 
     if (!reorder_ts || error || !header) {
         if (error || !header)
@@ -264,62 +130,20 @@ bool omx_time_stamp_reorder::get_next_timestamp(OMX_BUFFERHEADERTYPE *header, bo
         return false;
     }
 
-    if (!phead || !phead->entries_filled) return false;
-
-    for (int i=0; i < TIME_SZ; i++) {
-        if (phead->input_timestamps[i].in_use) {
-            status = true;
-
-            if (!element)
-                element = &phead->input_timestamps[i];
-            else {
-                if (element->timestamps > phead->input_timestamps[i].timestamps) {
-                    element = &phead->input_timestamps[i];
-                    duplicate = NULL;
-                } else if (element->timestamps == phead->input_timestamps[i].timestamps)
-                    duplicate = &phead->input_timestamps[i];
-            }
-        }
-    }
-
-    if (element) {
-        phead->entries_filled--;
-        header->nTimeStamp = element->timestamps;
+    if (!ts_heap.pop_min(ts, &generation)) return false;
 
-        if (print_debug)
-            DEBUG("Getnext Time stamp %lld", header->nTimeStamp);
-
-        element->in_use = false;
-    }
-
-    if (is_interlaced && duplicate) {
-        phead->entries_filled--;
-        duplicate->in_use = false;
-    } else if (is_interlaced && !duplicate) {
-        element = NULL;
+    header->nTimeStamp = ts;
 
-        for (int i=0; i < TIME_SZ; i++) {
-            if (phead->input_timestamps[i].in_use) {
-                if (!element)
-                    element = &phead->input_timestamps[i];
-                else if (element->timestamps > phead->input_timestamps[i].timestamps)
-                    element = &phead->input_timestamps[i];
-            }
-        }
-
-        if (element) {
-            phead->entries_filled--;
-            header->nTimeStamp = element->timestamps;
-            element->in_use = false;
-        }
-    }
+    if (print_debug)
+        DEBUG("Getnext Time stamp %lld", header->nTimeStamp);
 
-    if (!phead->entries_filled) {
-        if (!update_head()) {
-            handle_error();
-            return false;
-        }
+    /* Both fields of an interlaced frame carry a timestamp. Drop the
+     * duplicate, or use the second field's if they differ. */
+    if (is_interlaced && ts_heap.peek_min(next_ts, &next_generation) &&
+            next_generation == generation) {
+        ts_heap.pop_min(next_ts);
+        header->nTimeStamp = next_ts;
     }
 
-    return status;
+    return true;
 }
@@ -45,6 +45,11 @@ ifeq ($(TARGET_USES_ION),true)
 libmm-venc-def += -DUSE_ION
 endif
 
+# Debug levels compiled into the components, e.g. 0x3 drops DEBUG_PRINT_LOW
+ifneq ($(TARGET_VIDC_DEBUG_COMPILED_MASK),)
+libmm-venc-def += -DVIDC_DEBUG_COMPILED_MASK=$(TARGET_VIDC_DEBUG_COMPILED_MASK)
+endif
+
 # Common Includes
 libmm-venc-inc      := $(LOCAL_PATH)/inc
 libmm-venc-inc      += $(OMX_VIDEO_PATH)/vidc/common/inc
@@ -39,6 +39,7 @@ IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "swvenc_api.h"
 #include "swvenc_types.h"
+#include "venc_map_cache.h"
 
 extern "C" {
     OMX_API void * get_omx_component_factory_fn(void);
@@ -100,6 +101,9 @@ class omx_venc: public omx_video
     private:
         venc_debug_cap m_debug;
         bool m_bSeqHdrRequested;
+        venc_map_cache m_map_cache;
+
+        void release_input_mappings();
 
         OMX_U32 dev_stop(void);
         OMX_U32 dev_pause(void);
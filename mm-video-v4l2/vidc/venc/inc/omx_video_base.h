@@ -66,6 +66,9 @@ IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <dlfcn.h>
 #include "C2DColorConverter.h"
 #include "vidc_debug.h"
+#include "vidc_msg_notifier.h"
+#include "vidc_trace.h"
+#include "vidc_ion_pool.h"
 
 #ifdef _ANDROID_
 using namespace android;
@@ -169,6 +172,7 @@ class omx_video: public qc_omx_component
                 bool convert(int src_fd, void *src_base, void *src_viraddr,
                         int dest_fd, void *dest_base, void *dest_viraddr);
                 bool get_buffer_size(int port,unsigned int &buf_size);
+                void release_buffer(int fd, void *base);
                 int get_src_format();
                 void close();
             private:
@@ -337,8 +341,8 @@ class omx_video: public qc_omx_component
 
 
 
-        int  m_pipe_in;
-        int  m_pipe_out;
+        vidc_msg_notifier m_msg_notifier;
+        vidc_trace m_trace;
 
         pthread_t msg_thread_id;
         pthread_t async_thread_id;
@@ -602,6 +606,7 @@ class omx_video: public qc_omx_component
         OMX_VIDEO_PARAM_INTRAREFRESHTYPE m_sIntraRefresh;
         QOMX_VIDEO_PARAM_LTRMODE_TYPE m_sParamLTRMode;
         QOMX_VIDEO_PARAM_LTRCOUNT_TYPE m_sParamLTRCount;
+        OMX_PARAM_U32TYPE m_sParamInputBatch;
         QOMX_VIDEO_CONFIG_LTRPERIOD_TYPE m_sConfigLTRPeriod;
         QOMX_VIDEO_CONFIG_LTRUSE_TYPE m_sConfigLTRUse;
         OMX_VIDEO_CONFIG_AVCINTRAPERIOD m_sConfigAVCIDRPeriod;
@@ -0,0 +1,268 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2015, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+    * Neither the name of The Linux Foundation nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+#ifndef __VENC_MAP_CACHE_H__
+#define __VENC_MAP_CACHE_H__
+
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+/* Camera and gralloc sources cycle through fewer buffers than this */
+#define VENC_MAP_CACHE_SIZE 16
+/* Every cached mapping pins its buffer, also bound what stays pinned */
+#define VENC_MAP_CACHE_MAX_BYTES (96 * 1024 * 1024)
+
+struct venc_map_stats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    uint64_t invalidations;
+    uint64_t failures;
+    size_t live_maps;
+    size_t live_bytes;
+    size_t peak_bytes;
+};
+
+/*
+ * Keeps CPU mappings of meta mode input buffers (camera or gralloc fd,
+ * offset and size) alive across ETBs instead of mapping every frame.
+ * acquire() returns the address of the data and holds the mapping until
+ * the matching release(), so a frame the encoder still reads is never
+ * unmapped; idle entries are evicted least recently used once either the
+ * entry or the byte limit is reached.
+ *
+ * Like C2DMapCache, an entry also records the file behind the fd (pinned
+ * by a dup so the inode cannot be recycled) and a lookup whose file changed
+ * drops the stale mapping. clear() unmaps everything once it is idle; the
+ * owner calls it when the input buffers are freed.
+ *
+ * Thread safe: ETB and EBD run on different threads.
+ */
+class venc_map_cache
+{
+    public:
+        venc_map_cache(size_t max_entries = VENC_MAP_CACHE_SIZE,
+                size_t max_bytes = VENC_MAP_CACHE_MAX_BYTES)
+            : m_max_bytes(max_bytes), m_clock(0) {
+            m_max_entries = max_entries > VENC_MAP_CACHE_SIZE ?
+                VENC_MAP_CACHE_SIZE : (max_entries ? max_entries : 1);
+            m_page_size = sysconf(_SC_PAGESIZE);
+            if (m_page_size <= 0)
+                m_page_size = 4096;
+            memset(m_entries, 0, sizeof(m_entries));
+            memset(&m_stats, 0, sizeof(m_stats));
+            pthread_mutex_init(&m_lock, NULL);
+        }
+
+        ~venc_map_cache() {
+            clear();
+            pthread_mutex_destroy(&m_lock);
+        }
+
+        /* Returns the data at offset, NULL if it cannot be mapped */
+        void *acquire(int fd, off_t offset, size_t size) {
+            struct stat st;
+            struct entry *e;
+            void *data = NULL;
+
+            if (fd < 0 || offset < 0 || !size)
+                return NULL;
+            if (fstat(fd, &st))
+                memset(&st, 0, sizeof(st));
+
+            pthread_mutex_lock(&m_lock);
+            for (size_t i = 0; i < m_max_entries; i++) {
+                e = &m_entries[i];
+                if (!e->base || e->doomed || e->fd != fd ||
+                        e->offset != offset || e->size != size)
+                    continue;
+                if (e->dev == st.st_dev && e->ino == st.st_ino) {
+                    e->refs++;
+                    e->last_use = ++m_clock;
+                    m_stats.hits++;
+                    data = e->data;
+                    goto done;
+                }
+                /* Same fd number, different buffer */
+                m_stats.invalidations++;
+                retire(e);
+            }
+
+            m_stats.misses++;
+            e = map(fd, offset, size, &st);
+            if (e) {
+                e->refs = 1;
+                data = e->data;
+            } else {
+                m_stats.failures++;
+            }
+done:
+            pthread_mutex_unlock(&m_lock);
+            return data;
+        }
+
+        /* Drops the use taken by acquire(); false if data is not in use */
+        bool release(void *data) {
+            bool found = false;
+
+            pthread_mutex_lock(&m_lock);
+            for (size_t i = 0; i < m_max_entries; i++) {
+                struct entry *e = &m_entries[i];
+                if (e->base && e->refs && e->data == data) {
+                    if (--e->refs == 0 && e->doomed)
+                        drop(e);
+                    found = true;
+                    break;
+                }
+            }
+            pthread_mutex_unlock(&m_lock);
+            return found;
+        }
+
+        /* Unmaps idle entries now and busy ones on their last release() */
+        void clear() {
+            pthread_mutex_lock(&m_lock);
+            for (size_t i = 0; i < m_max_entries; i++)
+                if (m_entries[i].base)
+                    retire(&m_entries[i]);
+            pthread_mutex_unlock(&m_lock);
+        }
+
+        void get_stats(struct venc_map_stats *stats) {
+            pthread_mutex_lock(&m_lock);
+            *stats = m_stats;
+            pthread_mutex_unlock(&m_lock);
+        }
+
+    private:
+        struct entry {
+            int fd;
+            int pin_fd;
+            dev_t dev;
+            ino_t ino;
+            off_t offset;
+            size_t size;
+            void *base;
+            size_t length;
+            void *data;
+            unsigned int refs;
+            bool doomed;
+            uint64_t last_use;
+        };
+
+        venc_map_cache(const venc_map_cache &);
+        venc_map_cache &operator=(const venc_map_cache &);
+
+        void drop(struct entry *e) {
+            munmap(e->base, e->length);
+            if (e->pin_fd >= 0)
+                close(e->pin_fd);
+            m_stats.live_maps--;
+            m_stats.live_bytes -= e->length;
+            e->base = NULL;
+        }
+
+        void retire(struct entry *e) {
+            if (e->refs)
+                e->doomed = true;
+            else
+                drop(e);
+        }
+
+        /* Least recently used entry nobody holds */
+        struct entry *idle_victim() {
+            struct entry *victim = NULL;
+
+            for (size_t i = 0; i < m_max_entries; i++) {
+                struct entry *e = &m_entries[i];
+                if (e->base && !e->refs && (!victim || e->last_use < victim->last_use))
+                    victim = e;
+            }
+            return victim;
+        }
+
+        struct entry *map(int fd, off_t offset, size_t size, const struct stat *st) {
+            /* mmap offsets must be page aligned, camera offsets need not be */
+            off_t page_offset = offset & ~((off_t)m_page_size - 1);
+            size_t length = size + (offset - page_offset);
+            struct entry *slot = NULL, *victim;
+            void *base;
+
+            while (m_stats.live_bytes + length > m_max_bytes && (victim = idle_victim())) {
+                drop(victim);
+                m_stats.evictions++;
+            }
+            for (size_t i = 0; i < m_max_entries && !slot; i++)
+                if (!m_entries[i].base)
+                    slot = &m_entries[i];
+            if (!slot && (slot = idle_victim())) {
+                drop(slot);
+                m_stats.evictions++;
+            }
+            if (!slot)
+                return NULL;
+
+            base = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, page_offset);
+            if (base == MAP_FAILED)
+                return NULL;
+
+            slot->fd = fd;
+            slot->pin_fd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+            slot->dev = st->st_dev;
+            slot->ino = st->st_ino;
+            slot->offset = offset;
+            slot->size = size;
+            slot->base = base;
+            slot->length = length;
+            slot->data = (char *)base + (offset - page_offset);
+            slot->refs = 0;
+            slot->doomed = false;
+            slot->last_use = ++m_clock;
+            m_stats.live_maps++;
+            m_stats.live_bytes += length;
+            if (m_stats.live_bytes > m_stats.peak_bytes)
+                m_stats.peak_bytes = m_stats.live_bytes;
+            return slot;
+        }
+
+        pthread_mutex_t m_lock;
+        size_t m_max_entries;
+        size_t m_max_bytes;
+        long m_page_size;
+        uint64_t m_clock;
+        struct entry m_entries[VENC_MAP_CACHE_SIZE];
+        struct venc_map_stats m_stats;
+};
+
+#endif
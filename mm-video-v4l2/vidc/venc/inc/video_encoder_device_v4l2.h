@@ -322,6 +322,7 @@ class venc_dev
         OMX_ERRORTYPE allocate_extradata();
         void free_extradata();
         int append_mbi_extradata(void *, struct msm_vidc_extradata_header*);
+        int append_mbi_ref_extradata(void *, struct msm_vidc_extradata_header*);
         bool handle_extradata(void *, int);
         int venc_set_format(int);
         bool deinterlace_enabled;
@@ -420,6 +421,7 @@ class venc_dev
         bool streaming[MAX_PORT];
         bool extradata;
         struct extradata_buffer_info extradata_info;
+        bool extradata_passthrough;
 
         pthread_mutex_t pause_resume_mlock;
         pthread_cond_t pause_resume_cond;
@@ -430,9 +432,15 @@ class venc_dev
         int supported_rc_modes;
         bool camera_mode_enabled;
 
-        bool venc_empty_batch (OMX_BUFFERHEADERTYPE *buf, unsigned index);
+        bool venc_empty_batch (OMX_BUFFERHEADERTYPE *buf, void *pmem_data_buf,
+                unsigned index, unsigned fd);
+        bool venc_is_batch_buffer(OMX_BUFFERHEADERTYPE *buf);
         static const int kMaxBuffersInBatch = 16;
         bool mInputBatchMode;
+        // Frames per input buffer requested by the client through
+        // OMX_QcomIndexParamBatchSize. Byte-buffer and gralloc inputs carry
+        // that many frames back to back, one input frame size apart.
+        OMX_U32 mBatchSize;
         struct BatchInfo {
             BatchInfo();
             /* register a buffer and obtain its unique id (v4l2-buf-id)
@@ -447,7 +455,10 @@ class venc_dev
             static const int kMaxBufs = 64;
             static const int kBufIDFree = -1;
             pthread_mutex_t mLock;
-            int mBufMap[64];  // Map with slots for each buffer
+            int mBufMap[kMaxBufs];      // v4l2-buf-id -> buffer id
+            int mFreeIds[kMaxBufs];     // stack of unused v4l2-buf-ids
+            int mNumFree;
+            int mPendingCount[kMaxBufs]; // buffer id -> v4l2-buf-ids in flight
             size_t mNumPending;
 
           public:
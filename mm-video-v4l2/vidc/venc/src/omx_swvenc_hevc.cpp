@@ -98,7 +98,6 @@ OMX_ERRORTYPE omx_swvenc::component_init(OMX_STRING role)
 
     OMX_ERRORTYPE eRet = OMX_ErrorNone;
 
-    int fds[2];
     int r;
 
     OMX_VIDEO_CODINGTYPE codec_type;
@@ -324,20 +323,9 @@ OMX_ERRORTYPE omx_swvenc::component_init(OMX_STRING role)
     m_sExtraData = 0;
 
     if (eRet == OMX_ErrorNone) {
-        if (pipe(fds)) {
-            DEBUG_PRINT_ERROR("ERROR: pipe creation failed");
+        if (!m_msg_notifier.init()) {
+            DEBUG_PRINT_ERROR("ERROR: eventfd creation failed");
             eRet = OMX_ErrorInsufficientResources;
-        } else {
-            if (fds[0] == 0 || fds[1] == 0) {
-                if (pipe(fds)) {
-                    DEBUG_PRINT_ERROR("ERROR: pipe creation failed");
-                    eRet = OMX_ErrorInsufficientResources;
-                }
-            }
-            if (eRet == OMX_ErrorNone) {
-                m_pipe_in = fds[0];
-                m_pipe_out = fds[1];
-            }
         }
         msg_thread_created = true;
         r = pthread_create(&msg_thread_id,0, enc_message_thread, this);
@@ -32,6 +32,7 @@ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 /* def: VENUS_BUFFER_SIZE, VENUS_Y_STRIDE etc */
 #include <media/msm_media_info.h>
+#include "vidc_stride_conv.h"
 
 /* def: private_handle_t*/
 #include <gralloc_priv.h>
@@ -115,7 +116,6 @@ OMX_ERRORTYPE omx_venc::component_init(OMX_STRING role)
     SWVENC_CALLBACK callBackInfo;
     OMX_VIDEO_CODINGTYPE codec_type;
     SWVENC_PROPERTY Prop;
-    int fds[2];
 
     strlcpy((char *)m_nkind,role,OMX_MAX_STRINGNAME_SIZE);
     secure_session = false;
@@ -417,27 +417,11 @@ OMX_ERRORTYPE omx_venc::component_init(OMX_STRING role)
 
     if (eRet == OMX_ErrorNone)
     {
-        if (pipe(fds))
+        if (!m_msg_notifier.init())
         {
-            DEBUG_PRINT_ERROR("ERROR: pipe creation failed");
+            DEBUG_PRINT_ERROR("ERROR: eventfd creation failed");
             eRet = OMX_ErrorInsufficientResources;
         }
-        else
-        {
-            if ((fds[0] == 0) || (fds[1] == 0))
-            {
-                if (pipe(fds))
-                {
-                    DEBUG_PRINT_ERROR("ERROR: pipe creation failed");
-                    eRet = OMX_ErrorInsufficientResources;
-                }
-            }
-            if (eRet == OMX_ErrorNone)
-            {
-                m_pipe_in = fds[0];
-                m_pipe_out = fds[1];
-            }
-        }
 
         if (pthread_create(&msg_thread_id,0, message_thread, this) < 0)
         {
@@ -1646,6 +1630,8 @@ OMX_ERRORTYPE  omx_venc::component_deinit(OMX_IN OMX_HANDLETYPE hComp)
     DEBUG_PRINT_HIGH("Calling swvenc_deinit()");
     swvenc_deinit(m_hSwVenc);
 
+    release_input_mappings();
+
     DEBUG_PRINT_HIGH("OMX_Venc:Component Deinit");
 
     RETURN(OMX_ErrorNone);
@@ -1802,7 +1788,13 @@ bool omx_venc::dev_empty_buf
               size = handle->size;
           }
        }
-       ipbuffer.p_buffer = (unsigned char *)mmap(NULL, size, PROT_READ|PROT_WRITE,MAP_SHARED, fd, offset);
+       ipbuffer.p_buffer = (unsigned char *)m_map_cache.acquire(fd, offset, size);
+       if (!ipbuffer.p_buffer)
+       {
+          DEBUG_PRINT_ERROR("%s, failed to map input fd %u offset %u size %u",
+            __FUNCTION__, fd, offset, size);
+          RETURN(false);
+       }
        ipbuffer.size = size;
        ipbuffer.filled_length = size;
     }
@@ -1833,6 +1825,10 @@ bool omx_venc::dev_empty_buf
     {
        DEBUG_PRINT_ERROR("%s, swvenc_emptythisbuffer failed (%d)",
          __FUNCTION__, Ret);
+       if (meta_mode_enable)
+       {
+          m_map_cache.release(ipbuffer.p_buffer);
+       }
        RETURN(false);
     }
 
@@ -2001,9 +1997,30 @@ bool omx_venc::dev_loaded_start()
 bool omx_venc::dev_loaded_stop()
 {
    ENTER_FUNC();
+
+   /* Idle to loaded, the client frees its input buffers next */
+   release_input_mappings();
+
    RETURN(true);
 }
 
+void omx_venc::release_input_mappings()
+{
+   struct venc_map_stats stats;
+
+   m_map_cache.get_stats(&stats);
+   if (stats.hits || stats.misses)
+   {
+      DEBUG_PRINT_HIGH("input mappings: %llu hits, %llu misses, %llu evictions, "
+        "%llu stale, %llu failed, %zu maps / %zu bytes live, %zu bytes peak",
+        (unsigned long long)stats.hits, (unsigned long long)stats.misses,
+        (unsigned long long)stats.evictions, (unsigned long long)stats.invalidations,
+        (unsigned long long)stats.failures, stats.live_maps, stats.live_bytes,
+        stats.peak_bytes);
+   }
+   m_map_cache.clear();
+}
+
 bool omx_venc::dev_loaded_start_done()
 {
    ENTER_FUNC();
@@ -2142,16 +2159,30 @@ bool omx_venc::dev_color_align(OMX_BUFFERHEADERTYPE *buffer,
 {
     ENTER_FUNC();
 
-    (void)buffer;
-    (void)width;
-    (void)height;
+    struct vidc_nv12_layout layout;
+
     if(secure_session) {
         DEBUG_PRINT_ERROR("Cannot align colors in secure session.");
         RETURN(OMX_FALSE);
     }
 
+    /* Same layout as the frame attributes given to swvenc */
+    layout.y_stride = VENUS_Y_STRIDE(COLOR_FMT_NV12, width);
+    layout.y_scanlines = VENUS_Y_SCANLINES(COLOR_FMT_NV12, height);
+    layout.uv_stride = VENUS_UV_STRIDE(COLOR_FMT_NV12, width);
+    layout.uv_scanlines = VENUS_UV_SCANLINES(COLOR_FMT_NV12, height);
+
+    if (buffer->nAllocLen < VENUS_BUFFER_SIZE(COLOR_FMT_NV12, width, height) ||
+            !vidc_stride_conv::align_in_place(buffer->pBuffer, buffer->nAllocLen,
+                width, height, layout))
+    {
+        DEBUG_PRINT_ERROR("Failed to align %ux%u: Insufficient bufferLen=%u v/s Required=%u",
+                (unsigned int)width, (unsigned int)height, (unsigned int)buffer->nAllocLen,
+                VENUS_BUFFER_SIZE(COLOR_FMT_NV12, width, height));
+        RETURN(false);
+    }
+
     RETURN(true);
-    //return handle->venc_color_align(buffer, width,height);
 }
 
 bool omx_venc::is_secure_session()
@@ -2347,6 +2378,13 @@ SWVENC_STATUS omx_venc::swvenc_empty_buffer_done_cb
         error = OMX_ErrorUndefined;
     }
 
+    /* The encoder is done reading, the mapping may be evicted again */
+    omx_venc *venc = static_cast<omx_venc*>(omx);
+    if (venc->meta_mode_enable)
+    {
+       venc->m_map_cache.release(p_ipbuffer->p_buffer);
+    }
+
     omx->omx_release_meta_buffer(omxhdr);
 
     omx->post_event ((unsigned long)omxhdr,error,OMX_COMPONENT_GENERATE_EBD);
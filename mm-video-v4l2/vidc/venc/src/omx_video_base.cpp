@@ -99,25 +99,11 @@ typedef struct OMXComponentCapabilityFlagsType {
 void* enc_message_thread(void *input)
 {
     omx_video* omx = reinterpret_cast<omx_video*>(input);
-    unsigned char id;
-    int n;
 
     DEBUG_PRINT_LOW("omx_venc: message thread start");
     prctl(PR_SET_NAME, (unsigned long)"VideoEncMsgThread", 0, 0, 0);
-    while (1) {
-        n = read(omx->m_pipe_in, &id, 1);
-        if (0 == n) {
-            break;
-        }
-
-        if (1 == n) {
-            omx->process_event_cb(omx, id);
-        }
-#ifdef QLE_BUILD
-        if (n < 0) break;
-#else
-        if ((n < 0) && (errno != EINTR)) break;
-#endif
+    while (omx->m_msg_notifier.wait()) {
+        omx->process_event_cb(omx, 0);
     }
     DEBUG_PRINT_LOW("omx_venc: message thread stop");
     return 0;
@@ -125,8 +111,8 @@ void* enc_message_thread(void *input)
 
 void post_message(omx_video *omx, unsigned char id)
 {
-    DEBUG_PRINT_LOW("omx_venc: post_message %d", id);
-    write(omx->m_pipe_out, &id, 1);
+    bool woken = omx->m_msg_notifier.notify();
+    DEBUG_PRINT_LOW("omx_venc: post_message %d wake %d", id, woken);
 }
 
 // omx_cmd_queue destructor
@@ -216,8 +202,6 @@ omx_video::omx_video():
     pdest_frame(NULL),
     secure_session(false),
     mEmptyEosBuffer(NULL),
-    m_pipe_in(-1),
-    m_pipe_out(-1),
     m_pInput_pmem(NULL),
     m_pOutput_pmem(NULL),
 #ifdef USE_ION
@@ -249,12 +233,16 @@ omx_video::omx_video():
     DEBUG_PRINT_HIGH("omx_video(): Inside Constructor()");
     memset(&m_cmp,0,sizeof(m_cmp));
     memset(&m_pCallbacks,0,sizeof(m_pCallbacks));
+    memset(&m_sParamInputBatch,0,sizeof(m_sParamInputBatch));
     async_thread_created = false;
     msg_thread_created = false;
 
     mUsesColorConversion = false;
     pthread_mutex_init(&m_lock, NULL);
     sem_init(&m_cmd_lock,0,0);
+#ifdef USE_ION
+    vidc_buffer_pool::instance()->attach();
+#endif
     DEBUG_PRINT_LOW("meta_buffer_hdr = %p", meta_buffer_hdr);
 }
 
@@ -275,8 +263,7 @@ omx_video::omx_video():
 omx_video::~omx_video()
 {
     DEBUG_PRINT_HIGH("~omx_video(): Inside Destructor()");
-    if (m_pipe_in >= 0) close(m_pipe_in);
-    if (m_pipe_out >= 0) close(m_pipe_out);
+    m_msg_notifier.stop();
     DEBUG_PRINT_HIGH("omx_video: Waiting on Msg Thread exit");
     if (msg_thread_created)
         pthread_join(msg_thread_id,NULL);
@@ -289,6 +276,9 @@ omx_video::~omx_video()
 #endif
     pthread_mutex_destroy(&m_lock);
     sem_destroy(&m_cmd_lock);
+#ifdef USE_ION
+    vidc_buffer_pool::instance()->detach();
+#endif
     DEBUG_PRINT_HIGH("m_etb_count = %" PRIu64 ", m_fbd_count = %" PRIu64, m_etb_count,
             m_fbd_count);
     DEBUG_PRINT_HIGH("omx_video: Destructor exit");
@@ -1890,8 +1880,8 @@ OMX_ERRORTYPE  omx_video::get_parameter(OMX_IN OMX_HANDLETYPE     hComp,
                 OMX_PARAM_U32TYPE* batch =
                     reinterpret_cast<OMX_PARAM_U32TYPE *>(paramData);
 
-                // This is just around for API compatibility, just fill in something and return it
-                batch->nU32 = 0;
+                // 0 until the client configures input batching
+                batch->nU32 = m_sParamInputBatch.nU32;
                 batch->nPortIndex = PORT_INDEX_IN;
                 break;
             }
@@ -2065,6 +2055,11 @@ OMX_ERRORTYPE  omx_video::get_extension_index(OMX_IN OMX_HANDLETYPE      hComp,
         *indexType = (OMX_INDEXTYPE)OMX_QcomIndexParamBatchSize;
         return OMX_ErrorNone;
     }
+    if (!strncmp(paramName, OMX_QTI_INDEX_PARAM_VIDEO_EXTRADATA_PASSTHROUGH,
+            sizeof(OMX_QTI_INDEX_PARAM_VIDEO_EXTRADATA_PASSTHROUGH) - 1)) {
+        *indexType = (OMX_INDEXTYPE)OMX_QTIIndexParamVideoExtradataPassthrough;
+        return OMX_ErrorNone;
+    }
     return OMX_ErrorNotImplemented;
 }
 
@@ -2576,6 +2571,11 @@ OMX_ERRORTYPE omx_video::free_input_buffer(OMX_BUFFERHEADERTYPE *bufferHdr)
     }
 
     if (index < m_sInPortDef.nBufferCountActual && m_pInput_pmem) {
+#ifdef _ANDROID_ICS_
+        // The color converter may still hold a GPU mapping of this buffer
+        if (m_pInput_pmem[index].fd > 0)
+            c2d_conv.release_buffer(m_pInput_pmem[index].fd, m_pInput_pmem[index].buffer);
+#endif
         if (m_pInput_pmem[index].fd > 0 && input_use_buffer == false) {
             DEBUG_PRINT_LOW("FreeBuffer:: i/p AllocateBuffer case");
             if(!secure_session) {
@@ -3339,6 +3339,7 @@ OMX_ERRORTYPE  omx_video::empty_this_buffer(OMX_IN OMX_HANDLETYPE         hComp,
 
     m_etb_count++;
     DEBUG_PRINT_LOW("DBG: i/p nTimestamp = %u", (unsigned)buffer->nTimeStamp);
+    m_trace.record(VIDC_TRACE_ETB, nBufferIndex, buffer->nTimeStamp);
     post_event ((unsigned long)hComp,(unsigned long)buffer,m_input_msg_id);
     return OMX_ErrorNone;
 }
@@ -3421,6 +3422,7 @@ OMX_ERRORTYPE  omx_video::empty_this_buffer_proxy(OMX_IN OMX_HANDLETYPE  hComp,
         }
     }
 
+    m_trace.record(VIDC_TRACE_ETB_PROXY, nBufIndex, buffer->nTimeStamp);
     pending_input_buffers++;
     if (input_flush_progress == true) {
         post_event ((unsigned long)buffer,0,
@@ -3562,6 +3564,7 @@ OMX_ERRORTYPE  omx_video::fill_this_buffer(OMX_IN OMX_HANDLETYPE  hComp,
         return OMX_ErrorIncorrectStateOperation;
     }
 
+    m_trace.record(VIDC_TRACE_FTB, buffer - m_out_mem_ptr, 0);
     post_event((unsigned long) hComp, (unsigned long)buffer,OMX_COMPONENT_GENERATE_FTB);
     return OMX_ErrorNone;
 }
@@ -3995,6 +3998,8 @@ OMX_ERRORTYPE omx_video::fill_buffer_done(OMX_HANDLETYPE hComp,
     }
 
     pending_output_buffers--;
+    if (buffer->nFilledLen)
+        m_trace.record(VIDC_TRACE_FBD, buffer - m_out_mem_ptr, buffer->nTimeStamp);
 
     if(!secure_session) {
         extra_data_handle.create_extra_data(buffer);
@@ -4045,6 +4050,7 @@ OMX_ERRORTYPE omx_video::empty_buffer_done(OMX_HANDLETYPE         hComp,
     }
 
     pending_input_buffers--;
+    m_trace.record(VIDC_TRACE_EBD, buffer_index, buffer->nTimeStamp);
 
     if (mUseProxyColorFormat &&
         (buffer_index >= 0 && (buffer_index < (int)m_sInPortDef.nBufferCountActual))) {
@@ -4301,20 +4307,13 @@ int omx_video::alloc_map_ion_memory(int size,
         struct ion_allocation_data *alloc_data,
         struct ion_fd_data *fd_data,int flag)
 {
-    struct venc_ion buf_ion_info;
-    int ion_device_fd =-1,rc=0,ion_dev_flags = 0;
+    struct vidc_pool_block blk;
+    int ion_device_fd =-1, share_fd = -1;
     if (size <=0 || !alloc_data || !fd_data) {
         DEBUG_PRINT_ERROR("Invalid input to alloc_map_ion_memory");
         return -EINVAL;
     }
 
-    ion_dev_flags = O_RDONLY;
-    ion_device_fd = open (MEM_DEVICE,ion_dev_flags);
-    if (ion_device_fd < 0) {
-        DEBUG_PRINT_ERROR("ERROR: ION Device open() Failed");
-        return ion_device_fd;
-    }
-
     if(secure_session) {
         alloc_data->len = (size + (SZ_1M - 1)) & ~(SZ_1M - 1);
         alloc_data->align = SZ_1M;
@@ -4338,25 +4337,17 @@ int omx_video::alloc_map_ion_memory(int size,
                 alloc_data->flags);
     }
 
-    rc = ioctl(ion_device_fd,ION_IOC_ALLOC,alloc_data);
-    if (rc || !alloc_data->handle) {
-        DEBUG_PRINT_ERROR("ION ALLOC memory failed 0x%x", rc);
+    // Buffers freed by a port reconfig come back from the pool
+    ion_device_fd = vidc_buffer_pool::instance()->acquire(alloc_data->len,
+            alloc_data->align, alloc_data->flags, alloc_data->heap_id_mask,
+            &blk, &share_fd);
+    if (ion_device_fd < 0) {
+        DEBUG_PRINT_ERROR("ION ALLOC memory failed %d", ion_device_fd);
         alloc_data->handle = 0;
-        close(ion_device_fd);
-        ion_device_fd = -1;
-        return ion_device_fd;
-    }
-    fd_data->handle = alloc_data->handle;
-    rc = ioctl(ion_device_fd,ION_IOC_MAP,fd_data);
-    if (rc) {
-        DEBUG_PRINT_ERROR("ION MAP failed ");
-        buf_ion_info.ion_alloc_data = *alloc_data;
-        buf_ion_info.ion_device_fd = ion_device_fd;
-        buf_ion_info.fd_ion_data = *fd_data;
-        free_ion_memory(&buf_ion_info);
-        fd_data->fd =-1;
-        ion_device_fd =-1;
+        fd_data->fd = -1;
+        return -1;
     }
+    vidc_ion_pool_export(blk, share_fd, alloc_data, fd_data);
     return ion_device_fd;
 }
 
@@ -4366,12 +4357,8 @@ void omx_video::free_ion_memory(struct venc_ion *buf_ion_info)
         DEBUG_PRINT_ERROR("Invalid input to free_ion_memory");
         return;
     }
-    if (ioctl(buf_ion_info->ion_device_fd,ION_IOC_FREE,
-                &buf_ion_info->ion_alloc_data.handle)) {
-        DEBUG_PRINT_ERROR("ION free failed ");
-        return;
-    }
-    close(buf_ion_info->ion_device_fd);
+    vidc_buffer_pool::instance()->release(buf_ion_info->ion_device_fd,
+            (unsigned long)buf_ion_info->ion_alloc_data.handle);
     buf_ion_info->ion_alloc_data.handle = 0;
     buf_ion_info->ion_device_fd = -1;
     buf_ion_info->fd_ion_data.fd = -1;
@@ -4499,6 +4486,14 @@ bool omx_video::omx_c2d_conv::open(unsigned int height,unsigned int width,
     return status;
 }
 
+void omx_video::omx_c2d_conv::release_buffer(int fd, void *base)
+{
+    pthread_mutex_lock(&c_lock);
+    if (c2dcc)
+        c2dcc->releaseBuffer(fd, base);
+    pthread_mutex_unlock(&c_lock);
+}
+
 void omx_video::omx_c2d_conv::close()
 {
     if (mLibHandle) {
@@ -4740,6 +4735,10 @@ OMX_ERRORTYPE omx_video::convert_queue_buffer(OMX_HANDLETYPE hComp,
                             pdest_frame, (unsigned int)pdest_frame->nFilledLen);
                 }
             }
+            /* The client's buffer is mapped for this call only; its fd and
+               address may name a different buffer on the next frame, so
+               the GPU mapping must not outlive it */
+            c2d_conv.release_buffer(Input_pmem_info.fd, uva);
             munmap(uva,Input_pmem_info.size);
         }
     }
@@ -197,7 +197,6 @@ OMX_ERRORTYPE omx_venc::component_init(OMX_STRING role)
 
     OMX_ERRORTYPE eRet = OMX_ErrorNone;
 
-    int fds[2];
     int r;
 
     OMX_VIDEO_CODINGTYPE codec_type;
@@ -532,6 +531,10 @@ OMX_ERRORTYPE omx_venc::component_init(OMX_STRING role)
     m_sParamLTRCount.nPortIndex = (OMX_U32) PORT_INDEX_OUT;
     m_sParamLTRCount.nCount = 0;
 
+    OMX_INIT_STRUCT(&m_sParamInputBatch, OMX_PARAM_U32TYPE);
+    m_sParamInputBatch.nPortIndex = (OMX_U32) PORT_INDEX_IN;
+    m_sParamInputBatch.nU32 = 0;
+
     OMX_INIT_STRUCT(&m_sConfigDeinterlace, OMX_VIDEO_CONFIG_DEINTERLACE);
     m_sConfigDeinterlace.nPortIndex = (OMX_U32) PORT_INDEX_OUT;
     m_sConfigDeinterlace.nEnable = OMX_FALSE;
@@ -545,20 +548,9 @@ OMX_ERRORTYPE omx_venc::component_init(OMX_STRING role)
     m_sExtraData = 0;
 
     if (eRet == OMX_ErrorNone) {
-        if (pipe(fds)) {
-            DEBUG_PRINT_ERROR("ERROR: pipe creation failed");
+        if (!m_msg_notifier.init()) {
+            DEBUG_PRINT_ERROR("ERROR: eventfd creation failed");
             eRet = OMX_ErrorInsufficientResources;
-        } else {
-            if (fds[0] == 0 || fds[1] == 0) {
-                if (pipe(fds)) {
-                    DEBUG_PRINT_ERROR("ERROR: pipe creation failed");
-                    eRet = OMX_ErrorInsufficientResources;
-                }
-            }
-            if (eRet == OMX_ErrorNone) {
-                m_pipe_in = fds[0];
-                m_pipe_out = fds[1];
-            }
         }
         msg_thread_created = true;
         r = pthread_create(&msg_thread_id,0, enc_message_thread, this);
@@ -1505,13 +1497,40 @@ OMX_ERRORTYPE  omx_venc::set_parameter(OMX_IN OMX_HANDLETYPE     hComp,
                 }
                 break;
             }
+        case OMX_QTIIndexParamVideoExtradataPassthrough:
+            {
+                if (m_state != OMX_StateLoaded) {
+                    DEBUG_PRINT_ERROR("Extradata passthrough can only be set in loaded state");
+                    return OMX_ErrorIncorrectStateOperation;
+                }
+                if (!handle->venc_set_param(paramData,
+                            (OMX_INDEXTYPE)OMX_QTIIndexParamVideoExtradataPassthrough)) {
+                    DEBUG_PRINT_ERROR("Setting extradata passthrough failed");
+                    return OMX_ErrorUnsupportedSetting;
+                }
+                break;
+            }
         case OMX_QcomIndexParamBatchSize:
             {
+                OMX_PARAM_U32TYPE* pParam = (OMX_PARAM_U32TYPE*)paramData;
+                if (m_state != OMX_StateLoaded) {
+                    DEBUG_PRINT_ERROR("Input batch size can only be set in loaded state");
+                    return OMX_ErrorIncorrectStateOperation;
+                }
                if(!handle->venc_set_param(paramData,
                          (OMX_INDEXTYPE)OMX_QcomIndexParamBatchSize)) {
                    DEBUG_PRINT_ERROR("Attempting to set batch size failed");
                    return OMX_ErrorUnsupportedSetting;
                 }
+                m_sParamInputBatch.nU32 = pParam->nU32;
+                // A batched byte-buffer holds nU32 frames, refresh the input size
+                if (!dev_get_buf_req(&m_sInPortDef.nBufferCountMin,
+                            &m_sInPortDef.nBufferCountActual,
+                            &m_sInPortDef.nBufferSize,
+                            m_sInPortDef.nPortIndex)) {
+                    DEBUG_PRINT_ERROR("Failed to update input buffer requirements");
+                    return OMX_ErrorUnsupportedSetting;
+                }
                 break;
             }
         case OMX_IndexParamVideoSliceFMO:
@@ -38,6 +38,7 @@ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <linux/msm_ion.h>
 #endif
 #include <media/msm_media_info.h>
+#include "vidc_stride_conv.h"
 #include <cutils/properties.h>
 #include <media/hardware/HardwareAPI.h>
 
@@ -227,6 +228,7 @@ venc_dev::venc_dev(class omx_venc *venc_class)
     pthread_mutex_init(&pause_resume_mlock, NULL);
     pthread_cond_init(&pause_resume_cond, NULL);
     memset(&extradata_info, 0, sizeof(extradata_info));
+    extradata_passthrough = false;
     memset(&idrperiod, 0, sizeof(idrperiod));
     memset(&multislice, 0, sizeof(multislice));
     memset (&slice_mode, 0 , sizeof(slice_mode));
@@ -269,7 +271,12 @@ venc_dev::venc_dev(class omx_venc *venc_class)
     snprintf(m_debug.log_loc, PROPERTY_VALUE_MAX,
              "%s", BUFFER_LOG_LOC);
 
+    property_get("vidc.enc.debug.trace", property_value, "0");
+    if (!venc_handle->m_trace.init(atoi(property_value)))
+        DEBUG_PRINT_ERROR("Failed to allocate the latency trace");
+
     mInputBatchMode = false;
+    mBatchSize = 0;
 }
 
 venc_dev::~venc_dev()
@@ -343,6 +350,9 @@ void* venc_dev::async_venc_message_thread (void *input)
             v4l2_buf.m.planes = plane;
 
             while (!ioctl(pfd.fd, VIDIOC_DQBUF, &v4l2_buf)) {
+                if (v4l2_buf.m.planes->bytesused)
+                    omx_venc_base->m_trace.record(VIDC_TRACE_DQBUF_OUT, v4l2_buf.index,
+                            ((int64_t)v4l2_buf.timestamp.tv_sec * 1000000) + v4l2_buf.timestamp.tv_usec);
                 venc_msg.msgcode=VEN_MSG_OUTPUT_BUFFER_DONE;
                 venc_msg.statuscode=VEN_S_SUCCESS;
                 omxhdr=omx_venc_base->m_out_mem_ptr+v4l2_buf.index;
@@ -391,6 +401,8 @@ void* venc_dev::async_venc_message_thread (void *input)
             v4l2_buf.length = 1;
 
             while (!ioctl(pfd.fd, VIDIOC_DQBUF, &v4l2_buf)) {
+                omx_venc_base->m_trace.record(VIDC_TRACE_DQBUF_IN, v4l2_buf.index,
+                        ((int64_t)v4l2_buf.timestamp.tv_sec * 1000000) + v4l2_buf.timestamp.tv_usec);
                 venc_msg.msgcode=VEN_MSG_INPUT_BUFFER_DONE;
                 venc_msg.statuscode=VEN_S_SUCCESS;
 
@@ -403,8 +415,8 @@ void* venc_dev::async_venc_message_thread (void *input)
                     if (omx->handle->mBatchInfo.isPending(bufIndex)) {
                         DEBUG_PRINT_LOW(" EBD for %d [v4l2-id=%d].. batch still pending",
                                 bufIndex, v4l2_buf.index);
-                        //do not return to client yet
-                        break;
+                        //do not return to client yet, keep draining the queue
+                        continue;
                     }
                     v4l2_buf.index = bufIndex;
                 }
@@ -534,10 +546,28 @@ int venc_dev::append_mbi_extradata(void *dst, struct msm_vidc_extradata_header*
     return mbi->nDataSize + sizeof(*mbi);
 }
 
+/* Points the client at the MB info in the driver's extradata slot */
+int venc_dev::append_mbi_ref_extradata(void *dst, struct msm_vidc_extradata_header* src)
+{
+    OMX_QCOM_EXTRADATA_MBINFO_REF *ref = (OMX_QCOM_EXTRADATA_MBINFO_REF *)dst;
+
+    if (!dst || !src)
+        return 0;
+
+    ref->nFormat = 1;
+    ref->nFd = extradata_info.ion.fd_ion_data.fd;
+    ref->nOffset = (char *)src->data - extradata_info.uaddr;
+    ref->nDataSize = src->data_size;
+    ref->nMapSize = extradata_info.size;
+
+    return sizeof(*ref);
+}
+
 bool venc_dev::handle_extradata(void *buffer, int index)
 {
     OMX_BUFFERHEADERTYPE *p_bufhdr = (OMX_BUFFERHEADERTYPE *) buffer;
     OMX_OTHER_EXTRADATATYPE *p_extra = NULL;
+    char *p_end = NULL;
 
     if (!extradata_info.uaddr) {
         DEBUG_PRINT_ERROR("Extradata buffers not allocated");
@@ -546,8 +576,11 @@ bool venc_dev::handle_extradata(void *buffer, int index)
 
     p_extra = (OMX_OTHER_EXTRADATATYPE *)ALIGN(p_bufhdr->pBuffer +
                 p_bufhdr->nOffset + p_bufhdr->nFilledLen, 4);
+    p_end = (char *)p_bufhdr->pBuffer + p_bufhdr->nAllocLen;
 
-    if (extradata_info.buffer_size >
+    /* Passthrough only writes small fixed size records, which are checked
+     * one by one below */
+    if (!extradata_passthrough && extradata_info.buffer_size >
             p_bufhdr->nAllocLen - ALIGN(p_bufhdr->nOffset + p_bufhdr->nFilledLen, 4)) {
         DEBUG_PRINT_ERROR("Insufficient buffer size for extradata");
         p_extra = NULL;
@@ -564,14 +597,32 @@ bool venc_dev::handle_extradata(void *buffer, int index)
             ((char *)p_extradata) + p_extradata->size :
             extradata_info.uaddr + index * extradata_info.buffer_size);
 
+        if ((char *)p_extra + sizeof(OMX_OTHER_EXTRADATATYPE) > p_end) {
+            DEBUG_PRINT_ERROR("Insufficient buffer size for extradata");
+            return false;
+        }
+
         switch (p_extradata->type) {
             case MSM_VIDC_EXTRADATA_METADATA_MBI:
             {
-                OMX_U32 payloadSize = append_mbi_extradata(&p_extra->data, p_extradata);
+                OMX_U32 payloadSize;
+
+                if (extradata_passthrough) {
+                    if ((char *)p_extra + ALIGN(sizeof(OMX_OTHER_EXTRADATATYPE) +
+                                sizeof(OMX_QCOM_EXTRADATA_MBINFO_REF), 4) +
+                            sizeof(OMX_OTHER_EXTRADATATYPE) > p_end) {
+                        DEBUG_PRINT_ERROR("No space for MB info reference, dropping it");
+                        continue;
+                    }
+                    payloadSize = append_mbi_ref_extradata(&p_extra->data, p_extradata);
+                    p_extra->eType = (OMX_EXTRADATATYPE)OMX_ExtraDataVideoEncoderMBInfoRef;
+                } else {
+                    payloadSize = append_mbi_extradata(&p_extra->data, p_extradata);
+                    p_extra->eType = (OMX_EXTRADATATYPE)OMX_ExtraDataVideoEncoderMBInfo;
+                }
                 p_extra->nSize = ALIGN(sizeof(OMX_OTHER_EXTRADATATYPE) + payloadSize, 4);
                 p_extra->nVersion.nVersion = OMX_SPEC_VERSION;
                 p_extra->nPortIndex = OMX_DirOutput;
-                p_extra->eType = (OMX_EXTRADATATYPE)OMX_ExtraDataVideoEncoderMBInfo;
                 p_extra->nDataSize = payloadSize;
                 break;
             }
@@ -599,21 +650,12 @@ bool venc_dev::handle_extradata(void *buffer, int index)
                 continue;
         }
 
-        p_extra = (OMX_OTHER_EXTRADATATYPE *)(((char *)p_extra) + p_extra->nSize);
-    } while (p_extradata->type != MSM_VIDC_EXTRADATA_NONE);
-
-    /* Just for debugging: Traverse the list of extra datas  and spit it out onto log */
-    p_extra = (OMX_OTHER_EXTRADATATYPE *)ALIGN(p_bufhdr->pBuffer +
-                p_bufhdr->nOffset + p_bufhdr->nFilledLen, 4);
-    while(p_extra->eType != OMX_ExtraDataNone)
-    {
         DEBUG_PRINT_LOW("[%p/%u] found extradata type %x of size %u (%u) at %p",
                 p_bufhdr->pBuffer, (unsigned int)p_bufhdr->nFilledLen, p_extra->eType,
                 (unsigned int)p_extra->nSize, (unsigned int)p_extra->nDataSize, p_extra);
 
-        p_extra = (OMX_OTHER_EXTRADATATYPE *) (((OMX_U8 *) p_extra) +
-                p_extra->nSize);
-    }
+        p_extra = (OMX_OTHER_EXTRADATATYPE *)(((char *)p_extra) + p_extra->nSize);
+    } while (p_extradata->type != MSM_VIDC_EXTRADATA_NONE);
 
     return true;
 }
@@ -1059,6 +1101,7 @@ bool venc_dev::venc_open(OMX_U32 codec)
     }
 
     mInputBatchMode = false;
+    mBatchSize = 0;
     sess_priority.priority = 1; /* default to non-real-time */
     if (venc_set_session_priority(sess_priority.priority)) {
         DEBUG_PRINT_ERROR("Setting session priority failed");
@@ -1127,7 +1170,16 @@ void venc_dev::venc_close()
         fclose(m_debug.extradatafile);
         m_debug.extradatafile = NULL;
     }
+
+    if (venc_handle->m_trace.enabled()) {
+        char trace_name[PROPERTY_VALUE_MAX + 64];
+        snprintf(trace_name, sizeof(trace_name), "%s/trace_enc_%d_%p.json",
+                m_debug.log_loc, getpid(), this);
+        venc_handle->m_trace.log_summary((const char *)venc_handle->m_cRole);
+        venc_handle->m_trace.dump(trace_name, (const char *)venc_handle->m_cRole);
+    }
     mInputBatchMode = false;
+    mBatchSize = 0;
 }
 
 bool venc_dev::venc_set_buf_req(OMX_U32 *min_buff_count,
@@ -1222,7 +1274,7 @@ bool venc_dev::venc_get_buf_req(OMX_U32 *min_buff_count,
         int actualCount = bufreq.count;
         // Request VB2_MAX_FRAME (64) buffers from V4L2 in anticipation of batch mode.
         // Keep the original count for the client
-        if (metadatamode) {
+        if (metadatamode || mBatchSize > 1) {
             bufreq.count = MAX_v4L2_INPUT_BUFS;
         }
 
@@ -1244,6 +1296,9 @@ bool venc_dev::venc_get_buf_req(OMX_U32 *min_buff_count,
         m_sInput_buff_property.datasize = ALIGN(m_sInput_buff_property.datasize, SZ_4K);
 #endif
         *buff_size = m_sInput_buff_property.datasize;
+        // Batched byte-buffers carry mBatchSize frames, each datasize apart
+        if (!metadatamode && mBatchSize > 1)
+            *buff_size *= mBatchSize;
     } else {
         unsigned int extra_idx = 0;
         fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
@@ -1909,6 +1964,18 @@ bool venc_dev::venc_set_param(void *paramData, OMX_INDEXTYPE index)
                 }
                 break;
             }
+        case OMX_QTIIndexParamVideoExtradataPassthrough:
+            {
+                QOMX_ENABLETYPE *pParam = (QOMX_ENABLETYPE *)paramData;
+
+                if (pParam->bEnable && venc_handle->is_secure_session()) {
+                    DEBUG_PRINT_ERROR("Extradata passthrough not supported in secure session");
+                    return false;
+                }
+                DEBUG_PRINT_LOW("set extradata passthrough: %d", pParam->bEnable);
+                extradata_passthrough = pParam->bEnable == OMX_TRUE;
+                break;
+            }
         case OMX_QcomIndexParamBatchSize:
             {
                 OMX_PARAM_U32TYPE* pParam =
@@ -1917,10 +1984,17 @@ bool venc_dev::venc_set_param(void *paramData, OMX_INDEXTYPE index)
                 if (pParam->nPortIndex == PORT_INDEX_OUT) {
                     DEBUG_PRINT_ERROR("For the moment, client-driven batching not supported"
                             " on output port");
-                    return OMX_ErrorUnsupportedSetting;
+                    return false;
                 }
 
-                /* Nothing else to do, this is just here for API compatibility */
+                if (pParam->nU32 > (OMX_U32)kMaxBuffersInBatch) {
+                    DEBUG_PRINT_ERROR("Batch size %u exceeds max %d",
+                            (unsigned int)pParam->nU32, kMaxBuffersInBatch);
+                    return false;
+                }
+
+                mBatchSize = pParam->nU32;
+                DEBUG_PRINT_HIGH("Input batch size set to %u", (unsigned int)mBatchSize);
                 break;
             }
         case OMX_IndexParamVideoSliceFMO:
@@ -2566,34 +2640,18 @@ bool venc_dev::venc_free_buf(void *buf_addr, unsigned port)
 bool venc_dev::venc_color_align(OMX_BUFFERHEADERTYPE *buffer,
         OMX_U32 width, OMX_U32 height)
 {
-    OMX_U32 y_stride = VENUS_Y_STRIDE(COLOR_FMT_NV12, width),
-            y_scanlines = VENUS_Y_SCANLINES(COLOR_FMT_NV12, height),
-            uv_stride = VENUS_UV_STRIDE(COLOR_FMT_NV12, width),
-            uv_scanlines = VENUS_UV_SCANLINES(COLOR_FMT_NV12, height),
-            src_chroma_offset = width * height;
-
-    if (buffer->nAllocLen >= VENUS_BUFFER_SIZE(COLOR_FMT_NV12, width, height)) {
-        OMX_U8* src_buf = buffer->pBuffer, *dst_buf = buffer->pBuffer;
-        //Do chroma first, so that we can convert it in-place
-        src_buf += width * height;
-        dst_buf += y_stride * y_scanlines;
-        for (int line = height / 2 - 1; line >= 0; --line) {
-            memmove(dst_buf + line * uv_stride,
-                    src_buf + line * width,
-                    width);
-        }
-
-        dst_buf = src_buf = buffer->pBuffer;
-        //Copy the Y next
-        for (int line = height - 1; line > 0; --line) {
-            memmove(dst_buf + line * y_stride,
-                    src_buf + line * width,
-                    width);
-        }
-    } else {
-        DEBUG_PRINT_ERROR("Failed to align Chroma. from %u to %u : \
-                Insufficient bufferLen=%u v/s Required=%u",
-                (unsigned int)(width*height), (unsigned int)src_chroma_offset, (unsigned int)buffer->nAllocLen,
+    struct vidc_nv12_layout layout;
+
+    layout.y_stride = VENUS_Y_STRIDE(COLOR_FMT_NV12, width);
+    layout.y_scanlines = VENUS_Y_SCANLINES(COLOR_FMT_NV12, height);
+    layout.uv_stride = VENUS_UV_STRIDE(COLOR_FMT_NV12, width);
+    layout.uv_scanlines = VENUS_UV_SCANLINES(COLOR_FMT_NV12, height);
+
+    if (buffer->nAllocLen < VENUS_BUFFER_SIZE(COLOR_FMT_NV12, width, height) ||
+            !vidc_stride_conv::align_in_place(buffer->pBuffer, buffer->nAllocLen,
+                width, height, layout)) {
+        DEBUG_PRINT_ERROR("Failed to align %ux%u: Insufficient bufferLen=%u v/s Required=%u",
+                (unsigned int)width, (unsigned int)height, (unsigned int)buffer->nAllocLen,
                 VENUS_BUFFER_SIZE(COLOR_FMT_NV12, width, height));
         return false;
     }
@@ -2657,6 +2715,13 @@ bool venc_dev::venc_empty_buf(void *buffer, void *pmem_data_buf, unsigned index,
 
     DEBUG_PRINT_LOW("Input buffer length %u", (unsigned int)bufhdr->nFilledLen);
 
+    // Setting batch mode is sticky. We do not expect the source to change
+    // between batch and normal modes at runtime.
+    if (mInputBatchMode || venc_is_batch_buffer(bufhdr)) {
+        mInputBatchMode = true;
+        return venc_empty_batch(bufhdr, pmem_data_buf, index, fd);
+    }
+
     if (pmem_data_buf) {
         DEBUG_PRINT_LOW("Internal PMEM addr for i/p Heap UseBuf: %p", pmem_data_buf);
         plane.m.userptr = (unsigned long)pmem_data_buf;
@@ -2689,17 +2754,6 @@ bool venc_dev::venc_empty_buf(void *buffer, void *pmem_data_buf, unsigned index,
             } else if (!color_format) {
 
                 if (meta_buf->buffer_type == kMetadataBufferTypeCameraSource) {
-                    native_handle_t *hnd = (native_handle_t*)meta_buf->meta_handle;
-                    // Setting batch mode is sticky. We do not expect camera to change
-                    // between batch and normal modes at runtime.
-                    if (hnd->numFds > 1) {
-                        mInputBatchMode = true;
-                    }
-
-                    if (mInputBatchMode) {
-                        return venc_empty_batch ((OMX_BUFFERHEADERTYPE*)buffer, index);
-                    }
-
                     if (meta_buf->meta_handle->numFds + meta_buf->meta_handle->numInts > 3 &&
                         meta_buf->meta_handle->data[3] & private_handle_t::PRIV_FLAGS_ITU_R_709)
                         buf.flags = V4L2_MSM_BUF_FLAG_YUV_601_709_CLAMP;
@@ -2768,6 +2822,7 @@ bool venc_dev::venc_empty_buf(void *buffer, void *pmem_data_buf, unsigned index,
 
     buf.timestamp.tv_sec = bufhdr->nTimeStamp / 1000000;
     buf.timestamp.tv_usec = (bufhdr->nTimeStamp % 1000000);
+    venc_handle->m_trace.record(VIDC_TRACE_QBUF_IN, index, bufhdr->nTimeStamp);
     rc = ioctl(m_nDriver_fd, VIDIOC_QBUF, &buf);
 
     if (rc) {
@@ -2800,12 +2855,28 @@ bool venc_dev::venc_empty_buf(void *buffer, void *pmem_data_buf, unsigned index,
     return true;
 }
 
-bool venc_dev::venc_empty_batch(OMX_BUFFERHEADERTYPE *bufhdr, unsigned index)
+bool venc_dev::venc_is_batch_buffer(OMX_BUFFERHEADERTYPE *bufhdr)
+{
+    if (!metadatamode)
+        return mBatchSize > 1;
+
+    encoder_media_buffer_type *meta_buf = (encoder_media_buffer_type *)bufhdr->pBuffer;
+    if (color_format || !meta_buf)
+        return false;
+
+    if (meta_buf->buffer_type == kMetadataBufferTypeCameraSource)
+        return meta_buf->meta_handle && meta_buf->meta_handle->numFds > 1;
+    if (meta_buf->buffer_type == kMetadataBufferTypeGrallocSource)
+        return mBatchSize > 1;
+    return false;
+}
+
+bool venc_dev::venc_empty_batch(OMX_BUFFERHEADERTYPE *bufhdr, void *pmem_data_buf,
+        unsigned index, unsigned fd)
 {
     struct v4l2_buffer buf;
     struct v4l2_plane plane;
     int rc = 0;
-    struct v4l2_control control;
     encoder_media_buffer_type * meta_buf = NULL;
 
     memset (&buf, 0, sizeof(buf));
@@ -2818,47 +2889,90 @@ bool venc_dev::venc_empty_batch(OMX_BUFFERHEADERTYPE *bufhdr, unsigned index)
         return false;
     }
 
+    // Camera batches describe each frame in the meta handle. Gralloc and
+    // byte-buffer batches pack up to mBatchSize frames in one buffer, each
+    // m_sInput_buff_property.datasize apart, timestamped at the frame rate.
+    int numBufs = 1;
+    unsigned long userptr = 0;
+    unsigned int frameOffset = 0, frameLen = 0, frameAlloc = 0, frameStride = 0;
+    OMX_TICKS frameDelta = 0;
+
     bool status = true;
-    if (metadatamode) {
-        plane.m.userptr = index;
+    if (pmem_data_buf) {
+        userptr = (unsigned long)pmem_data_buf;
+        frameOffset = bufhdr->nOffset;
+        frameAlloc = bufhdr->nAllocLen;
+        frameLen = bufhdr->nFilledLen;
+    } else if (metadatamode) {
+        userptr = index;
         meta_buf = (encoder_media_buffer_type *)bufhdr->pBuffer;
 
-        if (!color_format) {
-            if (meta_buf->buffer_type == kMetadataBufferTypeCameraSource) {
-                hnd = (native_handle_t*)meta_buf->meta_handle;
-                if (!hnd) {
-                    DEBUG_PRINT_ERROR("venc_empty_batch: invalid handle !");
-                    status = false;
-                } else if (hnd->numFds > kMaxBuffersInBatch) {
-                    DEBUG_PRINT_ERROR("venc_empty_batch: Too many buffers (%d) in batch. "
-                            "Max = %d", hnd->numFds, kMaxBuffersInBatch);
-                    status = false;
-                }
-                DEBUG_PRINT_LOW("venc_empty_batch: Batch of %d bufs", hnd->numFds);
+        if (!meta_buf) {
+            if (!bufhdr->nFilledLen && (bufhdr->nFlags & OMX_BUFFERFLAG_EOS)) {
+                frameOffset = bufhdr->nOffset;
+                frameAlloc = bufhdr->nAllocLen;
+                DEBUG_PRINT_LOW("venc_empty_batch: empty EOS buffer");
             } else {
-                DEBUG_PRINT_ERROR("Batch supported for CameraSource buffers only !");
                 status = false;
             }
+        } else if (color_format) {
+            frameOffset = bufhdr->nOffset;
+            frameAlloc = bufhdr->nAllocLen;
+            frameLen = bufhdr->nFilledLen;
+        } else if (meta_buf->buffer_type == kMetadataBufferTypeCameraSource) {
+            userptr = (unsigned long)meta_buf;
+            hnd = (native_handle_t*)meta_buf->meta_handle;
+            if (!hnd) {
+                DEBUG_PRINT_ERROR("venc_empty_batch: invalid handle !");
+                status = false;
+            } else if (hnd->numFds > kMaxBuffersInBatch) {
+                DEBUG_PRINT_ERROR("venc_empty_batch: Too many buffers (%d) in batch. "
+                        "Max = %d", hnd->numFds, kMaxBuffersInBatch);
+                status = false;
+            } else {
+                numBufs = hnd->numFds;
+            }
+        } else if (meta_buf->buffer_type == kMetadataBufferTypeGrallocSource) {
+            private_handle_t *handle = (private_handle_t *)meta_buf->meta_handle;
+            if (!handle) {
+                DEBUG_PRINT_ERROR("venc_empty_batch: invalid gralloc handle !");
+                status = false;
+            } else {
+                fd = handle->fd;
+                frameAlloc = frameLen = handle->size;
+            }
         } else {
-            DEBUG_PRINT_ERROR("Batch supported for Camera buffers only !");
+            DEBUG_PRINT_ERROR("venc_empty_batch: unsupported meta buffer type %d",
+                    meta_buf->buffer_type);
             status = false;
         }
     } else {
-        DEBUG_PRINT_ERROR("Batch supported for metabuffer mode only !");
-        status = false;
+        frameOffset = bufhdr->nOffset;
+        frameAlloc = bufhdr->nAllocLen;
+        frameLen = bufhdr->nFilledLen;
     }
 
+    if (status && !hnd && mBatchSize > 1 &&
+            frameLen > m_sInput_buff_property.datasize) {
+        frameStride = m_sInput_buff_property.datasize;
+        numBufs = (frameLen + frameStride - 1) / frameStride;
+        if (numBufs > (int)mBatchSize)
+            numBufs = mBatchSize;
+        if (m_sVenc_cfg.fps_num)
+            frameDelta = (OMX_TICKS)m_sVenc_cfg.fps_den * 1000000 / m_sVenc_cfg.fps_num;
+    }
+    DEBUG_PRINT_LOW("venc_empty_batch: Batch of %d bufs", numBufs);
+
     if (status) {
         OMX_TICKS bufTimeStamp = 0ll;
-        int numBufs = hnd->numFds;
         int v4l2Ids[kMaxBuffersInBatch] = {-1};
         for (int i = 0; i < numBufs; ++i) {
             v4l2Ids[i] = mBatchInfo.registerBuffer(index);
             if (v4l2Ids[i] < 0) {
                 DEBUG_PRINT_ERROR("Failed to register buffer");
-                // TODO: cleanup the map and purge all slots of current index
-                status = false;
-                break;
+                while (i--)
+                    mBatchInfo.retrieveBufferAt(v4l2Ids[i]);
+                return false;
             }
         }
         for (int i = 0; i < numBufs; ++i) {
@@ -2867,11 +2981,30 @@ bool venc_dev::venc_empty_batch(OMX_BUFFERHEADERTYPE *bufhdr, unsigned index)
             buf.index = (unsigned)v4l2Id;
             buf.type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
             buf.memory = V4L2_MEMORY_USERPTR;
-            plane.reserved[0] = BatchInfo::getFdAt(hnd, i);
+            buf.flags = 0;
+            plane.m.userptr = userptr;
             plane.reserved[1] = 0;
-            plane.data_offset = BatchInfo::getOffsetAt(hnd, i);
-            plane.m.userptr = (unsigned long)meta_buf;
-            plane.length = plane.bytesused = BatchInfo::getSizeAt(hnd, i);
+            if (hnd) {
+                plane.reserved[0] = BatchInfo::getFdAt(hnd, i);
+                plane.data_offset = BatchInfo::getOffsetAt(hnd, i);
+                plane.length = plane.bytesused = BatchInfo::getSizeAt(hnd, i);
+                // timestamp differences from camera are in nano-seconds
+                bufTimeStamp = bufhdr->nTimeStamp + BatchInfo::getTimeStampAt(hnd, i) / 1000;
+            } else if (frameStride) {
+                unsigned int start = i * frameStride;
+                plane.reserved[0] = fd;
+                plane.data_offset = frameOffset + start;
+                plane.length = frameStride;
+                plane.bytesused = frameLen - start < frameStride ?
+                        frameLen - start : frameStride;
+                bufTimeStamp = bufhdr->nTimeStamp + i * frameDelta;
+            } else {
+                plane.reserved[0] = fd;
+                plane.data_offset = frameOffset;
+                plane.length = frameAlloc;
+                plane.bytesused = frameLen;
+                bufTimeStamp = bufhdr->nTimeStamp;
+            }
             buf.m.planes = &plane;
             buf.length = 1;
 
@@ -2879,24 +3012,30 @@ bool venc_dev::venc_empty_batch(OMX_BUFFERHEADERTYPE *bufhdr, unsigned index)
             if (rc)
                 DEBUG_PRINT_LOW("VIDIOC_PREPARE_BUF Failed");
 
-            if (bufhdr->nFlags & OMX_BUFFERFLAG_EOS)
+            // EOS belongs to the last frame of the batch only
+            if ((bufhdr->nFlags & OMX_BUFFERFLAG_EOS) && i == numBufs - 1)
                 buf.flags |= V4L2_QCOM_BUF_FLAG_EOS;
 
-            // timestamp differences from camera are in nano-seconds
-            bufTimeStamp = bufhdr->nTimeStamp + BatchInfo::getTimeStampAt(hnd, i) / 1000;
-
-            DEBUG_PRINT_LOW(" Q Batch [%d of %d] : buf=%x fd=%d len=%d TS=%lld",
+            DEBUG_PRINT_LOW(" Q Batch [%d of %d] : buf=%p fd=%d len=%d TS=%lld",
                 i, numBufs, bufhdr, plane.reserved[0], plane.length, bufTimeStamp);
             buf.timestamp.tv_sec = bufTimeStamp / 1000000;
             buf.timestamp.tv_usec = (bufTimeStamp % 1000000);
 
+            venc_handle->m_trace.record(VIDC_TRACE_QBUF_IN, buf.index, bufTimeStamp);
             rc = ioctl(m_nDriver_fd, VIDIOC_QBUF, &buf);
             if (rc) {
                 DEBUG_PRINT_ERROR("Failed to qbuf (etb) to driver");
+                // frames already queued come back through DQBUF, drop the rest
+                for (int j = i; j < numBufs; ++j)
+                    mBatchInfo.retrieveBufferAt(v4l2Ids[j]);
                 return false;
             }
 
             etb++;
+            // the logger reads one frame from the buffer start, skip packed batches
+            if (m_debug.in_buffer_log && !hnd && !frameStride) {
+                venc_input_log_buffers(bufhdr, plane.reserved[0], plane.data_offset);
+            }
         }
     }
 
@@ -2970,6 +3109,7 @@ bool venc_dev::venc_fill_buf(void *buffer, void *pmem_data_buf,unsigned index,un
         return false;
     }
 
+    venc_handle->m_trace.record(VIDC_TRACE_QBUF_OUT, index, 0);
     rc = ioctl(m_nDriver_fd, VIDIOC_QBUF, &buf);
 
     if (rc) {
@@ -5476,23 +5616,31 @@ bool venc_dev::venc_is_video_session_supported(unsigned long width,
 }
 
 venc_dev::BatchInfo::BatchInfo()
-    : mNumPending(0) {
+    : mNumFree(kMaxBufs),
+      mNumPending(0) {
     pthread_mutex_init(&mLock, NULL);
     for (int i = 0; i < kMaxBufs; ++i) {
         mBufMap[i] = kBufIDFree;
+        mPendingCount[i] = 0;
+        // lowest ids on top, so small batches keep reusing the same slots
+        mFreeIds[i] = kMaxBufs - 1 - i;
     }
 }
 
 int venc_dev::BatchInfo::registerBuffer(int bufferId) {
+    if (bufferId < 0 || bufferId >= kMaxBufs) {
+        DEBUG_PRINT_ERROR("Batch: invalid buffer id %d", bufferId);
+        return -1;
+    }
     pthread_mutex_lock(&mLock);
-    int availId = 0;
-    for( ; availId < kMaxBufs && mBufMap[availId] != kBufIDFree; ++availId);
-    if (availId >= kMaxBufs) {
+    if (!mNumFree) {
         DEBUG_PRINT_ERROR("Failed to find free entry !");
         pthread_mutex_unlock(&mLock);
         return -1;
     }
+    int availId = mFreeIds[--mNumFree];
     mBufMap[availId] = bufferId;
+    mPendingCount[bufferId]++;
     mNumPending++;
     pthread_mutex_unlock(&mLock);
     return availId;
@@ -5512,17 +5660,20 @@ int venc_dev::BatchInfo::retrieveBufferAt(int v4l2Id) {
     }
     int bufferId = mBufMap[v4l2Id];
     mBufMap[v4l2Id] = kBufIDFree;
+    mFreeIds[mNumFree++] = v4l2Id;
+    mPendingCount[bufferId]--;
     mNumPending--;
     pthread_mutex_unlock(&mLock);
     return bufferId;
 }
 
 bool venc_dev::BatchInfo::isPending(int bufferId) {
+    if (bufferId < 0 || bufferId >= kMaxBufs)
+        return false;
     pthread_mutex_lock(&mLock);
-    int existsId = 0;
-    for(; existsId < kMaxBufs && mBufMap[existsId] != bufferId; ++existsId);
+    bool pending = mPendingCount[bufferId] > 0;
     pthread_mutex_unlock(&mLock);
-    return existsId < kMaxBufs;
+    return pending;
 }
 
 int venc_dev::BatchInfo::getFdAt(native_handle_t *hnd, int index) {
@@ -56,6 +56,7 @@ LOCAL_C_INCLUDES                += $(libmm-vidpp-inc)
 
 LOCAL_PRELINK_MODULE    := false
 LOCAL_SHARED_LIBRARIES  := liblog libutils libbinder libcutils libdl libc
+LOCAL_STATIC_LIBRARIES  := libOmxVidcCommon
 
 LOCAL_SRC_FILES         += src/omx_vdpp.cpp
 
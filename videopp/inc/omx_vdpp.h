@@ -98,6 +98,9 @@ extern "C"{
 #include "OMX_CoreExt.h"
 #include "OMX_IndexExt.h"
 #include "qc_omx_component.h"
+#include "vidc_ts_heap.h"
+#include "vidc_ion_pool.h"
+#include "vidc_msg_notifier.h"
 #include <linux/android_pmem.h>
 #include <dlfcn.h>
 
@@ -555,8 +558,7 @@ public:
     struct video_vpu_context drv_ctx;
     int update_resolution(uint32_t width, uint32_t height, uint32_t stride, uint32_t scan_lines);
 
-    int  m_pipe_in;
-    int  m_pipe_out;
+    vidc_msg_notifier m_msg_notifier;
     int  m_ctrl_in;
     int  m_ctrl_out;
 
@@ -641,26 +643,6 @@ private:
         MAX_PORT
     };
 
-#ifdef _ANDROID_
-    struct ts_entry
-    {
-        OMX_TICKS timestamp;
-        bool valid;
-    };
-
-    struct ts_arr_list
-    {
-        ts_entry m_ts_arr_list[MAX_NUM_INPUT_OUTPUT_BUFFERS];
-
-        ts_arr_list();
-        ~ts_arr_list();
-
-        bool insert_ts(OMX_TICKS ts);
-        bool pop_min_ts(OMX_TICKS &ts);
-        bool reset_ts_list();
-    };
-#endif
-
     bool allocate_done(void);
     bool allocate_input_done(void);
     bool allocate_output_done(void);
@@ -856,7 +838,7 @@ private:
     unsigned int m_inp_err_count;
 #ifdef _ANDROID_
     // Timestamp list
-    ts_arr_list           m_timestamp_list;
+    vidc_ts_heap          m_timestamp_list;
 #endif
 
     bool input_flush_progress;
@@ -374,30 +374,12 @@ void* async_message_thread (void *input)
 void* message_thread(void *input)
 {
   omx_vdpp* omx = reinterpret_cast<omx_vdpp*>(input);
-  unsigned char id;
-  int n;
 
   DEBUG_PRINT_LOW("omx_vdpp: message thread start\n");
   prctl(PR_SET_NAME, (unsigned long)"VideoPostProcessingMsgThread", 0, 0, 0);
-  while (1)
+  while (omx->m_msg_notifier.wait())
   {
-
-    n = read(omx->m_pipe_in, &id, 1);
-
-    if(0 == n)
-    {
-      break;
-    }
-
-    if (1 == n)
-    {
-        omx->process_event_cb(omx, id);
-    }
-    if ((n < 0) && (errno != EINTR))
-    {
-      DEBUG_PRINT_ERROR("ERROR: read from pipe failed, ret %d errno %d", n, errno);
-      break;
-    }
+    omx->process_event_cb(omx, 0);
   }
   DEBUG_PRINT_HIGH("omx_vdpp: message thread stop\n");
   return 0;
@@ -405,10 +387,8 @@ void* message_thread(void *input)
 
 void post_message(omx_vdpp *omx, unsigned char id)
 {
-      int ret_value;
-      //DEBUG_PRINT_LOW("omx_vdpp: post_message %d pipe out 0x%x\n", id,omx->m_pipe_out);
-      ret_value = write(omx->m_pipe_out, &id, 1);
-      //DEBUG_PRINT_HIGH("post_message to pipe done %d\n",ret_value);
+      //DEBUG_PRINT_LOW("omx_vdpp: post_message %d\n", id);
+      omx->m_msg_notifier.notify();
 }
 
 // omx_cmd_queue destructor
@@ -477,107 +457,6 @@ unsigned omx_vdpp::omx_cmd_queue::get_q_msg_type()
     return m_q[m_read].id;
 }
 
-#ifdef _ANDROID_
-omx_vdpp::ts_arr_list::ts_arr_list()
-{
-  //initialize timestamps array
-  memset(m_ts_arr_list, 0, ( sizeof(ts_entry) * MAX_NUM_INPUT_OUTPUT_BUFFERS) );
-}
-omx_vdpp::ts_arr_list::~ts_arr_list()
-{
-  //free m_ts_arr_list?
-}
-
-bool omx_vdpp::ts_arr_list::insert_ts(OMX_TICKS ts)
-{
-  bool ret = true;
-  bool duplicate_ts = false;
-  int idx = 0;
-
-  //insert at the first available empty location
-  for ( ; idx < MAX_NUM_INPUT_OUTPUT_BUFFERS; idx++)
-  {
-    if (!m_ts_arr_list[idx].valid)
-    {
-      //found invalid or empty entry, save timestamp
-      m_ts_arr_list[idx].valid = true;
-      m_ts_arr_list[idx].timestamp = ts;
-      DEBUG_PRINT_LOW("Insert_ts(): Inserting TIMESTAMP (%lld) at idx (%d)",
-                       ts, idx);
-      break;
-    }
-  }
-
-  if (idx == MAX_NUM_INPUT_OUTPUT_BUFFERS)
-  {
-    DEBUG_PRINT_LOW("Timestamp array list is FULL. Unsuccessful insert");
-    ret = false;
-  }
-  return ret;
-}
-
-bool omx_vdpp::ts_arr_list::pop_min_ts(OMX_TICKS &ts)
-{
-  bool ret = true;
-  int min_idx = -1;
-  OMX_TICKS min_ts = 0;
-  int idx = 0;
-
-  for ( ; idx < MAX_NUM_INPUT_OUTPUT_BUFFERS; idx++)
-  {
-
-    if (m_ts_arr_list[idx].valid)
-    {
-      //found valid entry, save index
-      if (min_idx < 0)
-      {
-        //first valid entry
-        min_ts = m_ts_arr_list[idx].timestamp;
-        min_idx = idx;
-      }
-      else if (m_ts_arr_list[idx].timestamp < min_ts)
-      {
-        min_ts = m_ts_arr_list[idx].timestamp;
-        min_idx = idx;
-      }
-    }
-
-  }
-
-  if (min_idx < 0)
-  {
-    //no valid entries found
-    DEBUG_PRINT_LOW("Timestamp array list is empty. Unsuccessful pop");
-    ts = 0;
-    ret = false;
-  }
-  else
-  {
-    ts = m_ts_arr_list[min_idx].timestamp;
-    m_ts_arr_list[min_idx].valid = false;
-    DEBUG_PRINT_LOW("Pop_min_ts:Timestamp (%lld), index(%d)",
-                     ts, min_idx);
-  }
-
-  return ret;
-
-}
-
-
-bool omx_vdpp::ts_arr_list::reset_ts_list()
-{
-  bool ret = true;
-  int idx = 0;
-
-  DEBUG_PRINT_LOW("reset_ts_list(): Resetting timestamp array list");
-  for ( ; idx < MAX_NUM_INPUT_OUTPUT_BUFFERS; idx++)
-  {
-    m_ts_arr_list[idx].valid = false;
-  }
-  return ret;
-}
-#endif
-
 // factory function executed by the core to create instances
 void *get_omx_component_factory_fn(void)
 {
@@ -674,6 +553,9 @@ omx_vdpp::omx_vdpp(): m_ar_callback_setup(false),
   drv_ctx.thread_exit = false;
   sem_init(&(drv_ctx.async_lock),0,0);
 #endif
+#ifdef USE_ION
+  vidc_buffer_pool::instance()->attach();
+#endif
 }
 
 static OMX_ERRORTYPE subscribe_to_events(int fd)
@@ -740,10 +622,7 @@ omx_vdpp::~omx_vdpp()
 {
   m_pmem_info = NULL;
   DEBUG_PRINT_HIGH("In OMX vdpp Destructor");
-  if(m_pipe_in) close(m_pipe_in);
-  if(m_pipe_out) close(m_pipe_out);
-  m_pipe_in = -1;
-  m_pipe_out = -1;
+  m_msg_notifier.stop();
   DEBUG_PRINT_HIGH("Waiting on OMX Msg Thread exit");
   if (msg_thread_created)
     pthread_join(msg_thread_id,NULL);
@@ -775,6 +654,9 @@ omx_vdpp::~omx_vdpp()
   if(m_ctrl_out) close(m_ctrl_out);
   m_ctrl_in = -1;
   m_ctrl_out = -1;
+#ifdef USE_ION
+  vidc_buffer_pool::instance()->detach();
+#endif
   DEBUG_PRINT_HIGH("Exit OMX vdpp Destructor");
 }
 
@@ -1446,7 +1328,6 @@ OMX_ERRORTYPE omx_vdpp::component_init(OMX_STRING role)
 
 	OMX_ERRORTYPE eRet = OMX_ErrorNone;
 	struct v4l2_format fmt;
-	int fds[2];
     int fctl[2];
 	int ret=0;
     int i = 0;
@@ -1710,27 +1591,14 @@ OMX_ERRORTYPE omx_vdpp::component_init(OMX_STRING role)
         DEBUG_PRINT_HIGH("Input Buffer Size =%d \n ",drv_ctx.ip_buf.buffer_size);
         get_buffer_req(&drv_ctx.op_buf);
 
-        /* create pipes for message thread*/
-		if(pipe(fds))
+        /* create the wakeup eventfd for message thread*/
+		if(!m_msg_notifier.init())
 		{
-			DEBUG_PRINT_ERROR("pipe creation failed\n");
+			DEBUG_PRINT_ERROR("eventfd creation failed\n");
 			eRet = OMX_ErrorInsufficientResources;
 		}
 		else
 		{
-			int temp1[2];
-			if(fds[0] == 0 || fds[1] == 0)
-			{
-				if (pipe (temp1))
-				{
-					DEBUG_PRINT_ERROR("pipe creation failed\n");
-					return OMX_ErrorInsufficientResources;
-				}
-				fds[0] = temp1 [0];
-				fds[1] = temp1 [1];
-			}
-			m_pipe_in = fds[0];
-			m_pipe_out = fds[1];
 			msg_thread_created = true;
 			ret = pthread_create(&msg_thread_id,0,message_thread,this);
 
@@ -2578,7 +2446,7 @@ bool omx_vdpp::execute_input_flush()
 #ifdef _ANDROID_
   if (m_debug_timestamp)
   {
-    m_timestamp_list.reset_ts_list();
+    m_timestamp_list.reset();
   }
 #endif
 
@@ -5938,7 +5806,7 @@ OMX_ERRORTYPE  omx_vdpp::component_deinit(OMX_IN OMX_HANDLETYPE hComp)
 #ifdef _ANDROID_
     if (m_debug_timestamp)
     {
-      m_timestamp_list.reset_ts_list();
+      m_timestamp_list.reset();
     }
 #endif
 
@@ -6576,19 +6444,12 @@ int omx_vdpp::alloc_map_ion_memory(OMX_U32 buffer_size,
 	      struct ion_fd_data *fd_data, int flag)
 {
   int fd = -EINVAL;
-  int rc = -EINVAL;
-  int ion_dev_flag;
-  struct vdpp_ion ion_buf_info;
+  int share_fd = -1;
+  struct vidc_pool_block blk;
   if (!alloc_data || buffer_size <= 0 || !fd_data) {
      DEBUG_PRINT_ERROR("Invalid arguments to alloc_map_ion_memory\n");
      return -EINVAL;
   }
-  ion_dev_flag = (O_RDONLY | O_DSYNC);
-  fd = open (MEM_DEVICE, ion_dev_flag);
-  if (fd < 0) {
-    DEBUG_PRINT_ERROR("opening ion device failed with fd = %d\n", fd);
-    return fd;
-  }
 
   alloc_data->len = buffer_size;
 
@@ -6597,26 +6458,16 @@ int omx_vdpp::alloc_map_ion_memory(OMX_U32 buffer_size,
   alloc_data->heap_id_mask = ION_HEAP(ION_IOMMU_HEAP_ID);
   alloc_data->flags = 0;
 
-  rc = ioctl(fd,ION_IOC_ALLOC,alloc_data);
-  if (rc || !alloc_data->handle) {
+  // port reconfigs get their previous buffers back from the pool
+  fd = vidc_buffer_pool::instance()->acquire(alloc_data->len, alloc_data->align,
+          alloc_data->flags, alloc_data->heap_id_mask, &blk, &share_fd);
+  if (fd < 0) {
     DEBUG_PRINT_ERROR(" ION ALLOC memory failed ");
     alloc_data->handle = NULL;
-    close(fd);
-    fd = -ENOMEM;
-    return fd;
-  }
-  fd_data->handle = alloc_data->handle;
-  rc = ioctl(fd,ION_IOC_MAP,fd_data);
-  if (rc) {
-    DEBUG_PRINT_ERROR(" ION MAP failed ");
-    ion_buf_info.ion_alloc_data = *alloc_data;
-    ion_buf_info.ion_device_fd = fd;
-    ion_buf_info.fd_ion_data = *fd_data;
-    free_ion_memory(&ion_buf_info);
-    fd_data->fd =-1;
-    close(fd);
-    fd = -ENOMEM;
+    fd_data->fd = -1;
+    return -ENOMEM;
   }
+  vidc_ion_pool_export(blk, share_fd, alloc_data, fd_data);
 
   return fd;
 }
@@ -6627,11 +6478,8 @@ void omx_vdpp::free_ion_memory(struct vdpp_ion *buf_ion_info) {
        DEBUG_PRINT_ERROR(" ION: free called with invalid fd/allocdata");
        return;
      }
-     if(ioctl(buf_ion_info->ion_device_fd,ION_IOC_FREE,
-             &buf_ion_info->ion_alloc_data.handle)) {
-       DEBUG_PRINT_ERROR(" ION: free failed" );
-     }
-     close(buf_ion_info->ion_device_fd);
+     vidc_buffer_pool::instance()->release(buf_ion_info->ion_device_fd,
+             (unsigned long)buf_ion_info->ion_alloc_data.handle);
      buf_ion_info->ion_device_fd = -1;
      buf_ion_info->ion_alloc_data.handle = NULL;
      buf_ion_info->fd_ion_data.fd = -1;
@@ -7573,6 +7421,7 @@ int omx_vdpp::openInput(const char* inputName)
         }
         else
         {
+            name[result] = '\0';
             if(!strcmp(name, inputName))
             {
                 close(fd_devname);